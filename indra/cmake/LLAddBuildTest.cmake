@@ -51,6 +51,32 @@ MACRO(ADD_BUILD_TEST name parent)
 ENDMACRO(ADD_BUILD_TEST name parent)
 
 
+MACRO(ADD_HEADER_BUILD_TEST name parent)
+    # Like ADD_BUILD_TEST, for classes that have no ${name}.cpp: either
+    # header-only or implemented in another source file of the library.
+    SET(more_source_files "${ARGN}")
+
+    IF (EXISTS "${CMAKE_CURRENT_SOURCE_DIR}/tests/${name}_test.cpp")
+
+        SET(header_libraries
+            ${LLCOMMON_LIBRARIES}
+            ${APRUTIL_LIBRARIES}
+            ${APR_LIBRARIES}
+            ${PTHREAD_LIBRARY}
+            ${WINDOWS_LIBRARIES}
+            )
+        SET(header_source_files
+            tests/${name}_test.cpp
+            ${CMAKE_SOURCE_DIR}/test/test.cpp
+            ${CMAKE_SOURCE_DIR}/test/lltut.cpp
+            ${more_source_files}
+            )
+        ADD_BUILD_TEST_INTERNAL("${name}" "${parent}" "${header_libraries}" "${header_source_files}")
+
+    ENDIF (EXISTS "${CMAKE_CURRENT_SOURCE_DIR}/tests/${name}_test.cpp")
+ENDMACRO(ADD_HEADER_BUILD_TEST name parent)
+
+
 MACRO(ADD_VIEWER_BUILD_TEST name parent)
     # This is just like the generic ADD_BUILD_TEST, but we implicitly
     # add the necessary precompiled header .cpp file (anyone else find that
@@ -31,10 +31,6 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifdef __SSE__
-#include <xmmintrin.h>
-#endif
-
 #include "opj_includes.h"
 
 /** @defgroup DWT DWT - Implementation of a discrete wavelet transform */
@@ -119,6 +115,10 @@ static void dwt_encode_stepsize(int stepsize, int numbps, opj_stepsize_t *bandno
 Inverse wavelet transform in 2-D.
 */
 static void dwt_decode_tile(opj_tcd_tilecomp_t* tilec, int i, DWT1DFN fn);
+/**
+Largest width or height of resolution levels 1 to numres - 1
+*/
+static int dwt_decode_max_resolution(opj_tcd_resolution_t* restrict r, int numres);
 
 /*@}*/
 
@@ -268,6 +268,195 @@ static void dwt_decode_1(dwt_t *v) {
 	dwt_decode_1_(v->mem, v->dn, v->sn, v->cas);
 }
 
+#ifdef OPJ_HAVE_SSE2
+
+#define VS(i) a[(i)*2]
+#define VD(i) a[(1+(i)*2)]
+#define VS_(i) ((i)<0?VS(0):((i)>=sn?VS(sn-1):VS(i)))
+#define VD_(i) ((i)<0?VD(0):((i)>=dn?VD(dn-1):VD(i)))
+#define VSS_(i) ((i)<0?VS(0):((i)>=dn?VS(dn-1):VS(i)))
+#define VDD_(i) ((i)<0?VD(0):((i)>=sn?VD(sn-1):VD(i)))
+
+/* <summary>                                              */
+/* Inverse 5-3 wavelet transform in 1-D, of 4 lines at    */
+/* once. Same arithmetic as dwt_decode_1_ in each lane.   */
+/* </summary>                                             */
+static void dwt_decode_1_sse2(__m128i* restrict a, int dn, int sn, int cas) {
+	const __m128i two = _mm_set1_epi32(2);
+	int i;
+
+	if (!cas) {
+		if ((dn > 0) || (sn > 1)) { /* NEW :  CASE ONE ELEMENT */
+			for (i = 0; i < sn; i++) VS(i) = _mm_sub_epi32(VS(i), _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(VD_(i - 1), VD_(i)), two), 2));
+			for (i = 0; i < dn; i++) VD(i) = _mm_add_epi32(VD(i), _mm_srai_epi32(_mm_add_epi32(VS_(i), VS_(i + 1)), 1));
+		}
+	} else {
+		if (!sn  && dn == 1) {         /* NEW :  CASE ONE ELEMENT */
+			/* S(0) /= 2, rounding towards zero */
+			VS(0) = _mm_srai_epi32(_mm_add_epi32(VS(0), _mm_srli_epi32(VS(0), 31)), 1);
+		} else {
+			for (i = 0; i < sn; i++) VD(i) = _mm_sub_epi32(VD(i), _mm_srai_epi32(_mm_add_epi32(_mm_add_epi32(VSS_(i), VSS_(i + 1)), two), 2));
+			for (i = 0; i < dn; i++) VS(i) = _mm_add_epi32(VS(i), _mm_srai_epi32(_mm_add_epi32(VDD_(i), VDD_(i - 1)), 1));
+		}
+	}
+}
+
+static INLINE void dwt_transpose4_sse2(__m128i* r0, __m128i* r1, __m128i* r2, __m128i* r3) {
+	__m128i t0 = _mm_unpacklo_epi32(*r0, *r1);
+	__m128i t1 = _mm_unpacklo_epi32(*r2, *r3);
+	__m128i t2 = _mm_unpackhi_epi32(*r0, *r1);
+	__m128i t3 = _mm_unpackhi_epi32(*r2, *r3);
+	*r0 = _mm_unpacklo_epi64(t0, t1);
+	*r1 = _mm_unpackhi_epi64(t0, t1);
+	*r2 = _mm_unpacklo_epi64(t2, t3);
+	*r3 = _mm_unpackhi_epi64(t2, t3);
+}
+
+/* <summary>                                              */
+/* Inverse lazy transform (horizontal) of 4 rows:         */
+/* b[2*i] gets element i of the 4 rows starting at a.     */
+/* </summary>                                             */
+static void dwt_interleave_h_sse2(__m128i* restrict b, const int* a, int x, int count) {
+	const int* a1 = a + x;
+	const int* a2 = a1 + x;
+	const int* a3 = a2 + x;
+	int i;
+	for (i = 0; i + 3 < count; i += 4) {
+		__m128i v0 = _mm_loadu_si128((const __m128i*) &a[i]);
+		__m128i v1 = _mm_loadu_si128((const __m128i*) &a1[i]);
+		__m128i v2 = _mm_loadu_si128((const __m128i*) &a2[i]);
+		__m128i v3 = _mm_loadu_si128((const __m128i*) &a3[i]);
+		dwt_transpose4_sse2(&v0, &v1, &v2, &v3);
+		b[2 * i] = v0;
+		b[2 * i + 2] = v1;
+		b[2 * i + 4] = v2;
+		b[2 * i + 6] = v3;
+	}
+	for (; i < count; i++) {
+		b[2 * i] = _mm_set_epi32(a3[i], a2[i], a1[i], a[i]);
+	}
+}
+
+/* <summary>                                              */
+/* Stores the 4 rows held in b back to a.                 */
+/* </summary>                                             */
+static void dwt_store_h_sse2(const __m128i* restrict b, int* a, int x, int count) {
+	int* a1 = a + x;
+	int* a2 = a1 + x;
+	int* a3 = a2 + x;
+	int i;
+	for (i = 0; i + 3 < count; i += 4) {
+		__m128i v0 = b[i];
+		__m128i v1 = b[i + 1];
+		__m128i v2 = b[i + 2];
+		__m128i v3 = b[i + 3];
+		dwt_transpose4_sse2(&v0, &v1, &v2, &v3);
+		_mm_storeu_si128((__m128i*) &a[i], v0);
+		_mm_storeu_si128((__m128i*) &a1[i], v1);
+		_mm_storeu_si128((__m128i*) &a2[i], v2);
+		_mm_storeu_si128((__m128i*) &a3[i], v3);
+	}
+	for (; i < count; i++) {
+		union {
+			__m128i v;
+			int i[4];
+		} lanes;
+		lanes.v = b[i];
+		a[i] = lanes.i[0];
+		a1[i] = lanes.i[1];
+		a2[i] = lanes.i[2];
+		a3[i] = lanes.i[3];
+	}
+}
+
+/* <summary>                                              */
+/* Inverse lazy transform (vertical) of 4 columns.        */
+/* </summary>                                             */
+static void dwt_interleave_v_sse2(__m128i* restrict b, const int* a, int x, int dn, int sn, int cas) {
+	int i;
+	for (i = 0; i < sn; i++) {
+		b[cas + 2 * i] = _mm_loadu_si128((const __m128i*) &a[i * x]);
+	}
+	a += sn * x;
+	for (i = 0; i < dn; i++) {
+		b[1 - cas + 2 * i] = _mm_loadu_si128((const __m128i*) &a[i * x]);
+	}
+}
+
+/* <summary>                                              */
+/* Inverse 5-3 wavelet transform in 2-D, 4 rows or 4      */
+/* columns at a time.                                     */
+/* </summary>                                             */
+static void dwt_decode_tile_sse2(opj_tcd_tilecomp_t* tilec, int numres) {
+	dwt_t h;
+	dwt_t v;
+	__m128i* mem;
+
+	opj_tcd_resolution_t* tr = tilec->resolutions;
+
+	int rw = tr->x1 - tr->x0;	/* width of the resolution level computed */
+	int rh = tr->y1 - tr->y0;	/* height of the resolution level computed */
+
+	int w = tilec->x1 - tilec->x0;
+	int mr = dwt_decode_max_resolution(tr, numres);
+
+	mem = (__m128i*) opj_aligned_malloc(mr * sizeof(__m128i));
+	/* Rows and columns left over by the groups of 4 go through the scalar code */
+	h.mem = (int*) opj_aligned_malloc(mr * sizeof(int));
+	v.mem = h.mem;
+
+	while( --numres) {
+		int * restrict tiledp = tilec->data;
+		int j;
+
+		++tr;
+		h.sn = rw;
+		v.sn = rh;
+
+		rw = tr->x1 - tr->x0;
+		rh = tr->y1 - tr->y0;
+
+		h.dn = rw - h.sn;
+		h.cas = tr->x0 % 2;
+
+		for(j = 0; j + 3 < rh; j += 4) {
+			dwt_interleave_h_sse2(mem + h.cas, &tiledp[j*w], w, h.sn);
+			dwt_interleave_h_sse2(mem + 1 - h.cas, &tiledp[j*w + h.sn], w, h.dn);
+			dwt_decode_1_sse2(mem, h.dn, h.sn, h.cas);
+			dwt_store_h_sse2(mem, &tiledp[j*w], w, rw);
+		}
+		for(; j < rh; ++j) {
+			dwt_interleave_h(&h, &tiledp[j*w]);
+			dwt_decode_1(&h);
+			memcpy(&tiledp[j*w], h.mem, rw * sizeof(int));
+		}
+
+		v.dn = rh - v.sn;
+		v.cas = tr->y0 % 2;
+
+		for(j = 0; j + 3 < rw; j += 4){
+			int k;
+			dwt_interleave_v_sse2(mem, &tiledp[j], w, v.dn, v.sn, v.cas);
+			dwt_decode_1_sse2(mem, v.dn, v.sn, v.cas);
+			for(k = 0; k < rh; ++k) {
+				_mm_storeu_si128((__m128i*) &tiledp[k * w + j], mem[k]);
+			}
+		}
+		for(; j < rw; ++j){
+			int k;
+			dwt_interleave_v(&v, &tiledp[j], w);
+			dwt_decode_1(&v);
+			for(k = 0; k < rh; ++k) {
+				tiledp[k * w + j] = v.mem[k];
+			}
+		}
+	}
+	opj_aligned_free(h.mem);
+	opj_aligned_free(mem);
+}
+
+#endif /* OPJ_HAVE_SSE2 */
+
 /* <summary>                             */
 /* Forward 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
@@ -380,6 +569,12 @@ void dwt_encode(opj_tcd_tilecomp_t * tilec) {
 /* Inverse 5-3 wavelet transform in 2-D. */
 /* </summary>                           */
 void dwt_decode(opj_tcd_tilecomp_t* tilec, int numres) {
+#ifdef OPJ_HAVE_SSE2
+	if (opj_cpu_features & OPJ_CPU_SSE2) {
+		dwt_decode_tile_sse2(tilec, numres);
+		return;
+	}
+#endif
 	dwt_decode_tile(tilec, numres, &dwt_decode_1);
 }
 
@@ -618,7 +813,7 @@ static void v4dwt_interleave_v(v4dwt_t* restrict v , float* restrict a , int x){
 	}
 }
 
-#ifdef __SSE__
+#ifdef OPJ_HAVE_SSE2
 
 static void v4dwt_decode_step1_sse(v4* w, int count, const __m128 c){
 	__m128* restrict vw = (__m128*) w;
@@ -667,7 +862,7 @@ static void v4dwt_decode_step2_sse(v4* l, v4* w, int k, int m, __m128 c){
 	}
 }
 
-#else
+#endif
 
 static void v4dwt_decode_step1(v4* w, int count, const float c){
 	float* restrict fw = (float*) w;
@@ -732,8 +927,6 @@ static void v4dwt_decode_step2(v4* l, v4* w, int k, int m, float c){
 	}
 }
 
-#endif
-
 /* <summary>                             */
 /* Inverse 9-7 wavelet transform in 1-D. */
 /* </summary>                            */
@@ -752,21 +945,23 @@ static void v4dwt_decode(v4dwt_t* restrict dwt){
 		a = 1;
 		b = 0;
 	}
-#ifdef __SSE__
-	v4dwt_decode_step1_sse(dwt->wavelet+a, dwt->sn, _mm_set1_ps(K));
-	v4dwt_decode_step1_sse(dwt->wavelet+b, dwt->dn, _mm_set1_ps(c13318));
-	v4dwt_decode_step2_sse(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, int_min(dwt->sn, dwt->dn-a), _mm_set1_ps(dwt_delta));
-	v4dwt_decode_step2_sse(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, int_min(dwt->dn, dwt->sn-b), _mm_set1_ps(dwt_gamma));
-	v4dwt_decode_step2_sse(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, int_min(dwt->sn, dwt->dn-a), _mm_set1_ps(dwt_beta));
-	v4dwt_decode_step2_sse(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, int_min(dwt->dn, dwt->sn-b), _mm_set1_ps(dwt_alpha));
-#else
+#ifdef OPJ_HAVE_SSE2
+	if (opj_cpu_features & OPJ_CPU_SSE2) {
+		v4dwt_decode_step1_sse(dwt->wavelet+a, dwt->sn, _mm_set1_ps(K));
+		v4dwt_decode_step1_sse(dwt->wavelet+b, dwt->dn, _mm_set1_ps(c13318));
+		v4dwt_decode_step2_sse(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, int_min(dwt->sn, dwt->dn-a), _mm_set1_ps(dwt_delta));
+		v4dwt_decode_step2_sse(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, int_min(dwt->dn, dwt->sn-b), _mm_set1_ps(dwt_gamma));
+		v4dwt_decode_step2_sse(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, int_min(dwt->sn, dwt->dn-a), _mm_set1_ps(dwt_beta));
+		v4dwt_decode_step2_sse(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, int_min(dwt->dn, dwt->sn-b), _mm_set1_ps(dwt_alpha));
+		return;
+	}
+#endif
 	v4dwt_decode_step1(dwt->wavelet+a, dwt->sn, K);
 	v4dwt_decode_step1(dwt->wavelet+b, dwt->dn, c13318);
 	v4dwt_decode_step2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, int_min(dwt->sn, dwt->dn-a), dwt_delta);
 	v4dwt_decode_step2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, int_min(dwt->dn, dwt->sn-b), dwt_gamma);
 	v4dwt_decode_step2(dwt->wavelet+b, dwt->wavelet+a+1, dwt->sn, int_min(dwt->sn, dwt->dn-a), dwt_beta);
 	v4dwt_decode_step2(dwt->wavelet+a, dwt->wavelet+b+1, dwt->dn, int_min(dwt->dn, dwt->sn-b), dwt_alpha);
-#endif
 }
 
 /* <summary>                             */
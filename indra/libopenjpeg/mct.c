@@ -29,10 +29,6 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifdef __SSE__
-#include <xmmintrin.h>
-#endif
-
 #include "opj_includes.h"
 
 /* <summary> */
@@ -78,6 +74,23 @@ void mct_decode(
 		int n)
 {
 	int i;
+#ifdef OPJ_HAVE_SSE2
+	if (opj_cpu_features & OPJ_CPU_SSE2) {
+		for (i = 0; i + 3 < n; i += 4) {
+			__m128i y = _mm_loadu_si128((const __m128i*) &c0[i]);
+			__m128i u = _mm_loadu_si128((const __m128i*) &c1[i]);
+			__m128i v = _mm_loadu_si128((const __m128i*) &c2[i]);
+			__m128i g = _mm_sub_epi32(y, _mm_srai_epi32(_mm_add_epi32(u, v), 2));
+			_mm_storeu_si128((__m128i*) &c0[i], _mm_add_epi32(v, g));
+			_mm_storeu_si128((__m128i*) &c1[i], g);
+			_mm_storeu_si128((__m128i*) &c2[i], _mm_add_epi32(u, g));
+		}
+		c0 += i;
+		c1 += i;
+		c2 += i;
+		n -= i;
+	}
+#endif
 	for (i = 0; i < n; ++i) {
 		int y = c0[i];
 		int u = c1[i];
@@ -131,43 +144,45 @@ void mct_decode_real(
 		int n)
 {
 	int i;
-#ifdef __SSE__
-	__m128 vrv, vgu, vgv, vbu;
-	vrv = _mm_set1_ps(1.402f);
-	vgu = _mm_set1_ps(0.34413f);
-	vgv = _mm_set1_ps(0.71414f);
-	vbu = _mm_set1_ps(1.772f);
-	for (i = 0; i < (n >> 3); ++i) {
-		__m128 vy, vu, vv;
-		__m128 vr, vg, vb;
+#ifdef OPJ_HAVE_SSE2
+	if (opj_cpu_features & OPJ_CPU_SSE2) {
+		__m128 vrv, vgu, vgv, vbu;
+		vrv = _mm_set1_ps(1.402f);
+		vgu = _mm_set1_ps(0.34413f);
+		vgv = _mm_set1_ps(0.71414f);
+		vbu = _mm_set1_ps(1.772f);
+		for (i = 0; i < (n >> 3); ++i) {
+			__m128 vy, vu, vv;
+			__m128 vr, vg, vb;
 
-		vy = _mm_load_ps(c0);
-		vu = _mm_load_ps(c1);
-		vv = _mm_load_ps(c2);
-		vr = _mm_add_ps(vy, _mm_mul_ps(vv, vrv));
-		vg = _mm_sub_ps(_mm_sub_ps(vy, _mm_mul_ps(vu, vgu)), _mm_mul_ps(vv, vgv));
-		vb = _mm_add_ps(vy, _mm_mul_ps(vu, vbu));
-		_mm_store_ps(c0, vr);
-		_mm_store_ps(c1, vg);
-		_mm_store_ps(c2, vb);
-		c0 += 4;
-		c1 += 4;
-		c2 += 4;
+			vy = _mm_load_ps(c0);
+			vu = _mm_load_ps(c1);
+			vv = _mm_load_ps(c2);
+			vr = _mm_add_ps(vy, _mm_mul_ps(vv, vrv));
+			vg = _mm_sub_ps(_mm_sub_ps(vy, _mm_mul_ps(vu, vgu)), _mm_mul_ps(vv, vgv));
+			vb = _mm_add_ps(vy, _mm_mul_ps(vu, vbu));
+			_mm_store_ps(c0, vr);
+			_mm_store_ps(c1, vg);
+			_mm_store_ps(c2, vb);
+			c0 += 4;
+			c1 += 4;
+			c2 += 4;
 
-		vy = _mm_load_ps(c0);
-		vu = _mm_load_ps(c1);
-		vv = _mm_load_ps(c2);
-		vr = _mm_add_ps(vy, _mm_mul_ps(vv, vrv));
-		vg = _mm_sub_ps(_mm_sub_ps(vy, _mm_mul_ps(vu, vgu)), _mm_mul_ps(vv, vgv));
-		vb = _mm_add_ps(vy, _mm_mul_ps(vu, vbu));
-		_mm_store_ps(c0, vr);
-		_mm_store_ps(c1, vg);
-		_mm_store_ps(c2, vb);
-		c0 += 4;
-		c1 += 4;
-		c2 += 4;
-	}
+			vy = _mm_load_ps(c0);
+			vu = _mm_load_ps(c1);
+			vv = _mm_load_ps(c2);
+			vr = _mm_add_ps(vy, _mm_mul_ps(vv, vrv));
+			vg = _mm_sub_ps(_mm_sub_ps(vy, _mm_mul_ps(vu, vgu)), _mm_mul_ps(vv, vgv));
+			vb = _mm_add_ps(vy, _mm_mul_ps(vu, vbu));
+			_mm_store_ps(c0, vr);
+			_mm_store_ps(c1, vg);
+			_mm_store_ps(c2, vb);
+			c0 += 4;
+			c1 += 4;
+			c2 += 4;
+		}
 	n &= 7;
+	}
 #endif
 	for(i = 0; i < n; ++i) {
 		float y = c0[i];
@@ -62,10 +62,21 @@ const char* OPJ_CALLCONV opj_version(void) {
     return PACKAGE_VERSION;
 }
 
+int opj_cpu_features = OPJ_CPU_COMPILED;
+
+void OPJ_CALLCONV opj_set_cpu_features(int features) {
+	opj_cpu_features = features & OPJ_CPU_COMPILED;
+}
+
+int OPJ_CALLCONV opj_get_cpu_features(void) {
+	return opj_cpu_features;
+}
+
 opj_dinfo_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT format) {
 	opj_dinfo_t *dinfo = (opj_dinfo_t*)opj_calloc(1, sizeof(opj_dinfo_t));
 	if(!dinfo) return NULL;
 	dinfo->is_decompressor = OPJ_TRUE;
+	dinfo->parallel_jobs = 1;
 	switch(format) {
 		case CODEC_J2K:
 		case CODEC_JPT:
@@ -95,26 +106,87 @@ opj_dinfo_t* OPJ_CALLCONV opj_create_decompress(OPJ_CODEC_FORMAT format) {
 	return dinfo;
 }
 
+static void opj_destroy_decompress_codec(opj_dinfo_t *dinfo) {
+	switch(dinfo->codec_format) {
+		case CODEC_J2K:
+		case CODEC_JPT:
+			j2k_destroy_decompress((opj_j2k_t*)dinfo->j2k_handle);
+			dinfo->j2k_handle = NULL;
+			break;
+		case CODEC_JP2:
+			jp2_destroy_decompress((opj_jp2_t*)dinfo->jp2_handle);
+			dinfo->jp2_handle = NULL;
+			break;
+		case CODEC_UNKNOWN:
+		default:
+			break;
+	}
+}
+
 void OPJ_CALLCONV opj_destroy_decompress(opj_dinfo_t *dinfo) {
 	if(dinfo) {
+		int i;
 		/* destroy the codec */
-		switch(dinfo->codec_format) {
-			case CODEC_J2K:
-			case CODEC_JPT:
-				j2k_destroy_decompress((opj_j2k_t*)dinfo->j2k_handle);
-				break;
-			case CODEC_JP2:
-				jp2_destroy_decompress((opj_jp2_t*)dinfo->jp2_handle);
-				break;
-			case CODEC_UNKNOWN:
-			default:
-				break;
+		opj_destroy_decompress_codec(dinfo);
+		for (i = 0; i < OPJ_T1_CACHE_SIZE; i++) {
+			t1_destroy((opj_t1_t*)dinfo->t1_cache[i]);
 		}
 		/* destroy the decompressor */
 		opj_free(dinfo);
 	}
 }
 
+opj_bool OPJ_CALLCONV opj_reset_decompress(opj_dinfo_t *dinfo) {
+	if(!dinfo) return OPJ_FALSE;
+	opj_destroy_decompress_codec(dinfo);
+	dinfo->refinement = NULL;
+	switch(dinfo->codec_format) {
+		case CODEC_J2K:
+		case CODEC_JPT:
+			dinfo->j2k_handle = (void*)j2k_create_decompress((opj_common_ptr)dinfo);
+			return dinfo->j2k_handle ? OPJ_TRUE : OPJ_FALSE;
+		case CODEC_JP2:
+			dinfo->jp2_handle = (void*)jp2_create_decompress((opj_common_ptr)dinfo);
+			return dinfo->jp2_handle ? OPJ_TRUE : OPJ_FALSE;
+		case CODEC_UNKNOWN:
+		default:
+			return OPJ_FALSE;
+	}
+}
+
+void OPJ_CALLCONV opj_set_decode_parallel(opj_dinfo_t *dinfo, opj_parallel_for_fn parallel_for, void *client, int jobs) {
+	if(dinfo) {
+		dinfo->parallel_for = parallel_for;
+		dinfo->parallel_client = client;
+		dinfo->parallel_jobs = jobs > 0 ? jobs : 1;
+	}
+}
+
+void OPJ_CALLCONV opj_set_decode_refinement(opj_dinfo_t *dinfo, opj_refinement_t *refinement) {
+	if(dinfo) {
+		dinfo->refinement = refinement;
+	}
+}
+
+opj_refinement_t* OPJ_CALLCONV opj_refinement_create(int max_samples) {
+	opj_refinement_t *refinement = (opj_refinement_t*)opj_calloc(1, sizeof(opj_refinement_t));
+	if(refinement) {
+		refinement->max_samples = max_samples;
+	}
+	return refinement;
+}
+
+void OPJ_CALLCONV opj_refinement_destroy(opj_refinement_t *refinement) {
+	if(refinement) {
+		int compno;
+		for (compno = 0; compno < refinement->numcomps; compno++) {
+			opj_free(refinement->comps[compno].data);
+		}
+		opj_free(refinement->comps);
+		opj_free(refinement);
+	}
+}
+
 void OPJ_CALLCONV opj_set_default_decoder_parameters(opj_dparameters_t *parameters) {
 	if(parameters) {
 		memset(parameters, 0, sizeof(opj_dparameters_t));
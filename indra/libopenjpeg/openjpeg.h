@@ -446,13 +446,63 @@ typedef struct opj_cinfo {
 	/* other specific fields go here */
 } opj_cinfo_t;
 
+/**
+Job run by a parallel decoder, index goes from 0 to the job count - 1
+*/
+typedef void (*opj_job_fn)(void *job_data, int index);
+/**
+Callback that runs job(job_data, i) for i in 0 .. count - 1, possibly concurrently,
+and returns when all of them are done
+*/
+typedef void (*opj_parallel_for_fn)(void *client, int count, opj_job_fn job, void *job_data);
+
+/**
+Coefficients of one component kept between decodes of the same codestream
+*/
+typedef struct opj_refinement_comp {
+	/** resolution level of the coefficients, -1 if there are none */
+	int resno;
+	/** width and height of that resolution level */
+	int w, h;
+	/** reconstructed coefficients of that level, before the MCT and DC level shift */
+	int *data;
+} opj_refinement_comp_t;
+
+/**
+Progressive refinement state.
+When a codestream is decoded again with more data (or with less resolution levels
+discarded), the resolution levels that were already complete are not decoded again.
+Only used for single tile images in a resolution-major progression order.
+The application must only use it with growing prefixes of the same codestream.
+*/
+typedef struct opj_refinement {
+	/** largest resolution level worth keeping, in samples per component; 0 for no limit */
+	int max_samples;
+	/** number of components */
+	int numcomps;
+	/** components */
+	opj_refinement_comp_t *comps;
+} opj_refinement_t;
+
+/** Number of T1 contexts kept by a decompressor */
+#define OPJ_T1_CACHE_SIZE 16
+
 /**
 Decompression context info
 */
 typedef struct opj_dinfo {
 	/** Fields shared with opj_cinfo_t */
 	opj_common_fields;	
-	/* other specific fields go here */
+	/** runs the decoding jobs of a tile, NULL to decode on the calling thread */
+	opj_parallel_for_fn parallel_for;
+	/** client passed to parallel_for */
+	void *parallel_client;
+	/** number of jobs that parallel_for can run concurrently */
+	int parallel_jobs;
+	/** T1 contexts, kept across decodes */
+	void *t1_cache[OPJ_T1_CACHE_SIZE];
+	/** progressive refinement state of the next decode, NULL for none */
+	opj_refinement_t *refinement;
 } opj_dinfo_t;
 
 /* 
@@ -731,6 +781,27 @@ extern "C" {
 
 OPJ_API const char * OPJ_CALLCONV opj_version(void);
 
+/* 
+==========================================================
+   processor features
+==========================================================
+*/
+
+/** SSE2 kernels for the inverse DWT, MCT, T1 code-block copy and DC level shift */
+#define OPJ_CPU_SSE2	0x0001
+
+/**
+Select the SIMD kernels used by the decoder. All the kernels give the same
+results as the scalar code. Kernels that were not compiled in are ignored.
+Defaults to all the compiled kernels; call before decoding.
+@param features OPJ_CPU_* flags supported by the processor
+*/
+OPJ_API void OPJ_CALLCONV opj_set_cpu_features(int features);
+/**
+@return Returns the OPJ_CPU_* flags of the kernels in use
+*/
+OPJ_API int OPJ_CALLCONV opj_get_cpu_features(void);
+
 /* 
 ==========================================================
    image functions definitions
@@ -815,6 +886,39 @@ Destroy a decompressor handle
 */
 OPJ_API void OPJ_CALLCONV opj_destroy_decompress(opj_dinfo_t *dinfo);
 /**
+Reset a decompressor handle, so that it can decode another codestream.
+Cached T1 contexts and the parallel decoding setup are kept; the refinement state is cleared.
+@param dinfo decompressor handle to reset
+@return Returns OPJ_TRUE if successful, OPJ_FALSE otherwise (the handle must then be destroyed)
+*/
+OPJ_API opj_bool OPJ_CALLCONV opj_reset_decompress(opj_dinfo_t *dinfo);
+/**
+Decode the tiles with several threads.
+The T1 code-blocks, DWT, MCT and DC level shift of each tile are split in jobs given to parallel_for.
+@param dinfo decompressor handle
+@param parallel_for callback running the jobs, NULL to decode on the calling thread
+@param client passed to parallel_for
+@param jobs number of jobs parallel_for can run concurrently
+*/
+OPJ_API void OPJ_CALLCONV opj_set_decode_parallel(opj_dinfo_t *dinfo, opj_parallel_for_fn parallel_for, void *client, int jobs);
+/**
+Use a progressive refinement state for the next decode.
+@param dinfo decompressor handle
+@param refinement state, created by opj_refinement_create, NULL for none
+*/
+OPJ_API void OPJ_CALLCONV opj_set_decode_refinement(opj_dinfo_t *dinfo, opj_refinement_t *refinement);
+/**
+Create an empty progressive refinement state
+@param max_samples largest resolution level worth keeping, in samples per component; 0 for no limit
+@return Returns a new refinement state, NULL on failure
+*/
+OPJ_API opj_refinement_t* OPJ_CALLCONV opj_refinement_create(int max_samples);
+/**
+Destroy a progressive refinement state
+@param refinement state to destroy
+*/
+OPJ_API void OPJ_CALLCONV opj_refinement_destroy(opj_refinement_t *refinement);
+/**
 Set decoding parameters to default values
 @param parameters Decompression parameters
 */
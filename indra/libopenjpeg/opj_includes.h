@@ -86,6 +86,18 @@ Most compilers implement their own version of this keyword ...
 	#endif
 #endif
 
+/* SSE2 kernels are compiled in when the compiler targets SSE2, and used when opj_cpu_features allows it */
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define OPJ_HAVE_SSE2
+	#include <emmintrin.h>
+	#define OPJ_CPU_COMPILED OPJ_CPU_SSE2
+#else
+	#define OPJ_CPU_COMPILED 0
+#endif
+
+/** OPJ_CPU_* flags of the kernels in use, see opj_set_cpu_features */
+extern int opj_cpu_features;
+
 /* MSVC and Borland C do not have lrintf */
 #if defined(_MSC_VER) || defined(__BORLANDC__)
 static INLINE long lrintf(float f){
@@ -1491,6 +1491,105 @@ void t1_encode_cblks(
 	} /* compno  */
 }
 
+/**
+Decode a code-block and copy its coefficients into the tile component
+*/
+static void t1_decode_cblk_to_tile(
+		opj_t1_t* t1,
+		opj_tcd_tilecomp_t* tilec,
+		opj_tccp_t* tccp,
+		int resno,
+		opj_tcd_band_t* band,
+		opj_tcd_cblk_dec_t* cblk)
+{
+	int tile_w = tilec->x1 - tilec->x0;
+	int* restrict datap;
+	int cblk_w, cblk_h;
+	int x, y;
+	int i, j;
+
+	t1_decode_cblk(
+			t1,
+			cblk,
+			band->bandno,
+			tccp->roishift,
+			tccp->cblksty);
+
+	x = cblk->x0 - band->x0;
+	y = cblk->y0 - band->y0;
+	if (band->bandno & 1) {
+		opj_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
+		x += pres->x1 - pres->x0;
+	}
+	if (band->bandno & 2) {
+		opj_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
+		y += pres->y1 - pres->y0;
+	}
+
+	datap=t1->data;
+	cblk_w = t1->w;
+	cblk_h = t1->h;
+
+	if (tccp->roishift) {
+		int thresh = 1 << tccp->roishift;
+		for (j = 0; j < cblk_h; ++j) {
+			for (i = 0; i < cblk_w; ++i) {
+				int val = datap[(j * cblk_w) + i];
+				int mag = abs(val);
+				if (mag >= thresh) {
+					mag >>= tccp->roishift;
+					datap[(j * cblk_w) + i] = val < 0 ? -mag : mag;
+				}
+			}
+		}
+	}
+
+	if (tccp->qmfbid == 1) {
+		int* restrict tiledp = &tilec->data[(y * tile_w) + x];
+		for (j = 0; j < cblk_h; ++j) {
+			i = 0;
+#ifdef OPJ_HAVE_SSE2
+			if (opj_cpu_features & OPJ_CPU_SSE2) {
+				for (; i + 3 < cblk_w; i += 4) {
+					__m128i tmp = _mm_loadu_si128((const __m128i*) &datap[(j * cblk_w) + i]);
+					/* tmp / 2, rounding towards zero */
+					tmp = _mm_srai_epi32(_mm_add_epi32(tmp, _mm_srli_epi32(tmp, 31)), 1);
+					_mm_storeu_si128((__m128i*) &tiledp[(j * tile_w) + i], tmp);
+				}
+			}
+#endif
+			for (; i < cblk_w; ++i) {
+				int tmp = datap[(j * cblk_w) + i];
+				((int*)tiledp)[(j * tile_w) + i] = tmp / 2;
+			}
+		}
+	} else {		/* if (tccp->qmfbid == 0) */
+		float* restrict tiledp = (float*) &tilec->data[(y * tile_w) + x];
+		for (j = 0; j < cblk_h; ++j) {
+			float* restrict tiledp2 = tiledp;
+			i = 0;
+#ifdef OPJ_HAVE_SSE2
+			if (opj_cpu_features & OPJ_CPU_SSE2) {
+				__m128 stepsize = _mm_set1_ps(band->stepsize);
+				for (; i + 3 < cblk_w; i += 4) {
+					__m128 tmp = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*) datap));
+					_mm_storeu_ps(tiledp2, _mm_mul_ps(tmp, stepsize));
+					datap += 4;
+					tiledp2 += 4;
+				}
+			}
+#endif
+			for (; i < cblk_w; ++i) {
+				float tmp = *datap * band->stepsize;
+				*tiledp2 = tmp;
+				datap++;
+				tiledp2++;
+			}
+			tiledp += tile_w;
+		}
+	}
+}
+
 void t1_decode_cblks(
 		opj_t1_t* t1,
 		opj_tcd_tilecomp_t* tilec,
@@ -1498,8 +1597,6 @@ void t1_decode_cblks(
 {
 	int resno, bandno, precno, cblkno;
 
-	int tile_w = tilec->x1 - tilec->x0;
-
 	for (resno = 0; resno < tilec->numresolutions; ++resno) {
 		opj_tcd_resolution_t* res = &tilec->resolutions[resno];
 
@@ -1511,68 +1608,9 @@ void t1_decode_cblks(
 
 				for (cblkno = 0; cblkno < precinct->cw * precinct->ch; ++cblkno) {
 					opj_tcd_cblk_dec_t* cblk = &precinct->cblks.dec[cblkno];
-					int* restrict datap;
-					int cblk_w, cblk_h;
-					int x, y;
-					int i, j;
-
-					t1_decode_cblk(
-							t1,
-							cblk,
-							band->bandno,
-							tccp->roishift,
-							tccp->cblksty);
-
-					x = cblk->x0 - band->x0;
-					y = cblk->y0 - band->y0;
-					if (band->bandno & 1) {
-						opj_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
-						x += pres->x1 - pres->x0;
-					}
-					if (band->bandno & 2) {
-						opj_tcd_resolution_t* pres = &tilec->resolutions[resno - 1];
-						y += pres->y1 - pres->y0;
-					}
 
-					datap=t1->data;
-					cblk_w = t1->w;
-					cblk_h = t1->h;
-
-					if (tccp->roishift) {
-						int thresh = 1 << tccp->roishift;
-						for (j = 0; j < cblk_h; ++j) {
-							for (i = 0; i < cblk_w; ++i) {
-								int val = datap[(j * cblk_w) + i];
-								int mag = abs(val);
-								if (mag >= thresh) {
-									mag >>= tccp->roishift;
-									datap[(j * cblk_w) + i] = val < 0 ? -mag : mag;
-								}
-							}
-						}
-					}
+					t1_decode_cblk_to_tile(t1, tilec, tccp, resno, band, cblk);
 
-					if (tccp->qmfbid == 1) {
-						int* restrict tiledp = &tilec->data[(y * tile_w) + x];
-						for (j = 0; j < cblk_h; ++j) {
-							for (i = 0; i < cblk_w; ++i) {
-								int tmp = datap[(j * cblk_w) + i];
-								((int*)tiledp)[(j * tile_w) + i] = tmp / 2;
-							}
-						}
-					} else {		/* if (tccp->qmfbid == 0) */
-						float* restrict tiledp = (float*) &tilec->data[(y * tile_w) + x];
-						for (j = 0; j < cblk_h; ++j) {
-							float* restrict tiledp2 = tiledp;
-							for (i = 0; i < cblk_w; ++i) {
-								float tmp = *datap * band->stepsize;
-								*tiledp2 = tmp;
-								datap++;
-								tiledp2++;
-							}
-							tiledp += tile_w;
-						}
-					}
 					opj_free(cblk->data);
 					opj_free(cblk->segs);
 				} /* cblkno */
@@ -1583,3 +1621,50 @@ void t1_decode_cblks(
 	} /* resno */
 }
 
+void t1_decode_cblks_part(
+		opj_t1_t* t1,
+		opj_tcd_tilecomp_t* tilec,
+		opj_tccp_t* tccp,
+		int firstres,
+		int lastres,
+		int part,
+		int numparts)
+{
+	int resno, bandno, precno, cblkno;
+	int n = 0;
+
+	if (lastres > tilec->numresolutions - 1) {
+		lastres = tilec->numresolutions - 1;
+	}
+
+	for (resno = firstres; resno <= lastres; ++resno) {
+		opj_tcd_resolution_t* res = &tilec->resolutions[resno];
+
+		for (bandno = 0; bandno < res->numbands; ++bandno) {
+			opj_tcd_band_t* restrict band = &res->bands[bandno];
+
+			for (precno = 0; precno < res->pw * res->ph; ++precno) {
+				opj_tcd_precinct_t* precinct = &band->precincts[precno];
+
+				if (!precinct->cblks.dec) {
+					continue;
+				}
+				for (cblkno = 0; cblkno < precinct->cw * precinct->ch; ++cblkno, ++n) {
+					opj_tcd_cblk_dec_t* cblk = &precinct->cblks.dec[cblkno];
+
+					if (n % numparts != part) {
+						continue;
+					}
+					t1_decode_cblk_to_tile(t1, tilec, tccp, resno, band, cblk);
+
+					/* The precinct arrays are shared with the other parts, they are freed with the tile */
+					opj_free(cblk->data);
+					cblk->data = NULL;
+					opj_free(cblk->segs);
+					cblk->segs = NULL;
+				} /* cblkno */
+			} /* precno */
+		} /* bandno */
+	} /* resno */
+}
+
@@ -139,6 +139,19 @@ Decode the code-blocks of a tile
 @param tccp Tile coding parameters
 */
 void t1_decode_cblks(opj_t1_t* t1, opj_tcd_tilecomp_t* tilec, opj_tccp_t* tccp);
+/**
+Decode one part of the code-blocks of resolution levels firstres to lastres of a tile component.
+The code-blocks are dealt round-robin to numparts parts, so that the parts can be decoded
+concurrently, each with its own T1 handle. The precincts are left for tcd_free_decode_tile.
+@param t1 T1 handle
+@param tilec The tile component to decode
+@param tccp Tile coding parameters
+@param firstres First resolution level to decode
+@param lastres Last resolution level to decode
+@param part Part to decode, 0 to numparts - 1
+@param numparts Number of parts
+*/
+void t1_decode_cblks_part(opj_t1_t* t1, opj_tcd_tilecomp_t* tilec, opj_tccp_t* tccp, int firstres, int lastres, int part, int numparts);
 /* ----------------------------------------------------------------------- */
 /*@}*/
 
@@ -714,10 +714,13 @@ int t2_decode_packets(opj_t2_t *t2, unsigned char *src, int len, int tileno, opj
 	int pino, e = 0;
 	int n = 0, curtp = 0;
 	int tp_start_packno;
+	opj_bool resolution_major;
 
 	opj_image_t *image = t2->image;
 	opj_cp_t *cp = t2->cp;
 	
+	tile->resno_complete = -1;
+
 	/* create a packet iterator */
 	pi = pi_create_decode(image, cp, tileno);
 	if(!pi) {
@@ -726,6 +729,12 @@ int t2_decode_packets(opj_t2_t *t2, unsigned char *src, int len, int tileno, opj
 	}
 
 	tp_start_packno = 0;
+
+	/* In a resolution-major progression all the packets of a resolution level come before
+	   the packets of the next one, so a truncated stream still holds complete lower levels. */
+	resolution_major = cp->layer == 0 && cp->tcps[tileno].numpocs == 0 &&
+		(cp->tcps[tileno].prg == RLCP || cp->tcps[tileno].prg == RPCL);
+	tile->resno_complete = resolution_major ? J2K_MAXRLVLS : -1;
 	
 	for (pino = 0; pino <= cp->tcps[tileno].numpocs; pino++) {
 		while (pi_next(&pi[pino])) {
@@ -741,6 +750,9 @@ int t2_decode_packets(opj_t2_t *t2, unsigned char *src, int len, int tileno, opj
 			}
             if(e == -999)
             {
+                if (resolution_major) {
+                    tile->resno_complete = pi[pino].resno - 1;
+                }
                 pi_destroy(pi, cp, tileno);
                 return -999;
             }
@@ -1327,14 +1327,273 @@ int tcd_encode_tile(opj_tcd_t *tcd, int tileno, unsigned char *dest, int len, op
 	return l;
 }
 
+/* ----------------------------------------------------------------------- */
+/* Tile decoding jobs */
+
+/** Decoding plan of a tile component */
+typedef struct opj_tcd_decode_comp {
+	/** first resolution level to decode, the lower ones come from the refinement state */
+	int firstres;
+	/** resolution level to reconstruct */
+	int lastres;
+	/** resolution level to store in the refinement state, -1 for none */
+	int saveres;
+} opj_tcd_decode_comp_t;
+
+/** Shared state of the jobs decoding a tile */
+typedef struct opj_tcd_decode_job {
+	opj_tcd_t *tcd;
+	opj_tcd_tile_t *tile;
+	/** decompressor, owns the T1 contexts and the parallel_for */
+	opj_dinfo_t *dinfo;
+	opj_refinement_t *refinement;
+	opj_tcd_decode_comp_t *comps;
+	/** T1 jobs per component */
+	int t1_parts;
+	/** samples per MCT job, and samples to transform */
+	int mct_chunk;
+	int mct_n;
+	/** set by a job that ran out of memory */
+	int error;
+} opj_tcd_decode_job_t;
+
+static void tcd_parallel_for(opj_tcd_decode_job_t *job, int count, opj_job_fn fn) {
+	if (count > 1 && job->dinfo && job->dinfo->parallel_for) {
+		job->dinfo->parallel_for(job->dinfo->parallel_client, count, fn, job);
+	} else {
+		int i;
+		for (i = 0; i < count; i++) {
+			fn(job, i);
+		}
+	}
+}
+
+static void tcd_free_decode_data(opj_tcd_tile_t *tile, int numcomps) {
+	int compno;
+	for (compno = 0; compno < numcomps; compno++) {
+		opj_aligned_free(tile->comps[compno].data);
+		tile->comps[compno].data = NULL;
+	}
+}
+
+static void tcd_load_refinement(opj_refinement_comp_t *refc, opj_tcd_tilecomp_t *tilec) {
+	int tw = tilec->x1 - tilec->x0;
+	int j;
+	for (j = 0; j < refc->h; j++) {
+		memcpy(&tilec->data[j * tw], &refc->data[j * refc->w], refc->w * sizeof(int));
+	}
+}
+
+static void tcd_save_refinement(opj_refinement_comp_t *refc, opj_tcd_tilecomp_t *tilec, int resno) {
+	opj_tcd_resolution_t *res = &tilec->resolutions[resno];
+	int tw = tilec->x1 - tilec->x0;
+	int w = res->x1 - res->x0;
+	int h = res->y1 - res->y0;
+	int *data = (int*) opj_realloc(refc->data, w * h * sizeof(int));
+	int j;
+	if (data == NULL) {
+		/* Keep the previous coefficients */
+		return;
+	}
+	for (j = 0; j < h; j++) {
+		memcpy(&data[j * w], &tilec->data[j * tw], w * sizeof(int));
+	}
+	refc->data = data;
+	refc->resno = resno;
+	refc->w = w;
+	refc->h = h;
+}
+
+/* Inverse DWT of resolution levels fromres + 1 to tores, fromres being already reconstructed */
+static void tcd_dwt_decode(opj_tcd_tilecomp_t *tilec, int qmfbid, int fromres, int tores) {
+	opj_tcd_resolution_t *resolutions = tilec->resolutions;
+	if (tores <= fromres) {
+		return;
+	}
+	tilec->resolutions += fromres;
+	if (qmfbid == 1) {
+		dwt_decode(tilec, tores - fromres + 1);
+	} else {
+		dwt_decode_real(tilec, tores - fromres + 1);
+	}
+	tilec->resolutions = resolutions;
+}
+
+static opj_t1_t* tcd_get_t1(opj_tcd_decode_job_t *job, int index) {
+	opj_t1_t *t1;
+	if (!job->dinfo) {
+		return NULL;
+	}
+	index %= OPJ_T1_CACHE_SIZE;
+	t1 = (opj_t1_t*) job->dinfo->t1_cache[index];
+	if (!t1) {
+		t1 = t1_create(job->tcd->cinfo);
+		job->dinfo->t1_cache[index] = t1;
+	}
+	return t1;
+}
+
+static void tcd_t1_job(void *data, int index) {
+	opj_tcd_decode_job_t *job = (opj_tcd_decode_job_t*) data;
+	int compno = index / job->t1_parts;
+	opj_tcd_decode_comp_t *plan = &job->comps[compno];
+	opj_t1_t *t1 = tcd_get_t1(job, index);
+	if (!t1) {
+		job->error = 1;
+		return;
+	}
+	t1_decode_cblks_part(t1, &job->tile->comps[compno], &job->tcd->tcp->tccps[compno],
+		plan->firstres, plan->lastres, index % job->t1_parts, job->t1_parts);
+}
+
+static void tcd_dwt_job(void *data, int compno) {
+	opj_tcd_decode_job_t *job = (opj_tcd_decode_job_t*) data;
+	opj_tcd_decode_comp_t *plan = &job->comps[compno];
+	opj_tcd_tilecomp_t *tilec = &job->tile->comps[compno];
+	int qmfbid = job->tcd->tcp->tccps[compno].qmfbid;
+	int fromres = int_max(plan->firstres - 1, 0);
+
+	if (plan->lastres < 0) {
+		return;
+	}
+	if (plan->saveres >= 0) {
+		tcd_dwt_decode(tilec, qmfbid, fromres, plan->saveres);
+		tcd_save_refinement(&job->refinement->comps[compno], tilec, plan->saveres);
+		fromres = int_max(fromres, plan->saveres);
+	}
+	tcd_dwt_decode(tilec, qmfbid, fromres, plan->lastres);
+}
+
+static void tcd_mct_job(void *data, int index) {
+	opj_tcd_decode_job_t *job = (opj_tcd_decode_job_t*) data;
+	opj_tcd_tile_t *tile = job->tile;
+	int offset = index * job->mct_chunk;
+	int n = int_min(job->mct_chunk, job->mct_n - offset);
+
+	if (job->tcd->tcp->tccps[0].qmfbid == 1) {
+		mct_decode(
+				tile->comps[0].data + offset,
+				tile->comps[1].data + offset,
+				tile->comps[2].data + offset,
+				n);
+	} else {
+		mct_decode_real(
+				(float*)tile->comps[0].data + offset,
+				(float*)tile->comps[1].data + offset,
+				(float*)tile->comps[2].data + offset,
+				n);
+	}
+}
+
+#ifdef OPJ_HAVE_SSE2
+/* Same as int_clamp in each lane */
+static INLINE __m128i tcd_clamp_sse2(__m128i v, __m128i min, __m128i max) {
+	__m128i mask = _mm_cmplt_epi32(v, min);
+	v = _mm_or_si128(_mm_and_si128(mask, min), _mm_andnot_si128(mask, v));
+	mask = _mm_cmpgt_epi32(v, max);
+	return _mm_or_si128(_mm_and_si128(mask, max), _mm_andnot_si128(mask, v));
+}
+
+/* Same as lrintf in each lane */
+static INLINE __m128i tcd_lrintf_sse2(__m128 v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+	/* The lrintf of opj_includes.h rounds halves away from zero */
+	__m128 half = _mm_or_ps(_mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x80000000))), _mm_set1_ps(0.5f));
+	return _mm_cvttps_epi32(_mm_add_ps(v, half));
+#else
+	return _mm_cvtps_epi32(v);
+#endif
+}
+#endif
+
+static void tcd_dc_shift_job(void *data, int compno) {
+	opj_tcd_decode_job_t *job = (opj_tcd_decode_job_t*) data;
+	opj_tcd_t *tcd = job->tcd;
+	opj_tcd_tilecomp_t* tilec = &job->tile->comps[compno];
+	opj_image_comp_t* imagec = &tcd->image->comps[compno];
+	opj_tcd_resolution_t* res = &tilec->resolutions[imagec->resno_decoded];
+	int adjust = imagec->sgnd ? 0 : 1 << (imagec->prec - 1);
+	int min = imagec->sgnd ? -(1 << (imagec->prec - 1)) : 0;
+	int max = imagec->sgnd ?  (1 << (imagec->prec - 1)) - 1 : (1 << imagec->prec) - 1;
+
+	int tw = tilec->x1 - tilec->x0;
+	int w = imagec->w;
+
+	int offset_x = int_ceildivpow2(imagec->x0, imagec->factor);
+	int offset_y = int_ceildivpow2(imagec->y0, imagec->factor);
+
+	int i, j;
+	if(!imagec->data){
+		imagec->data = (int*) opj_malloc(imagec->w * imagec->h * sizeof(int));
+	}
+	if (!imagec->data)
+	{
+		job->error = 1;
+		opj_aligned_free(tilec->data);
+		tilec->data = NULL;
+		return;
+	}
+	if(tcd->tcp->tccps[compno].qmfbid == 1) {
+		for(j = res->y0; j < res->y1; ++j) {
+			const int* src = &tilec->data[(j - res->y0) * tw];
+			int* dst = &imagec->data[(res->x0 - offset_x) + (j - offset_y) * w];
+			int n = res->x1 - res->x0;
+			i = 0;
+#ifdef OPJ_HAVE_SSE2
+			if (opj_cpu_features & OPJ_CPU_SSE2) {
+				__m128i vadjust = _mm_set1_epi32(adjust);
+				__m128i vmin = _mm_set1_epi32(min);
+				__m128i vmax = _mm_set1_epi32(max);
+				for(; i + 3 < n; i += 4) {
+					__m128i v = _mm_add_epi32(_mm_loadu_si128((const __m128i*) &src[i]), vadjust);
+					_mm_storeu_si128((__m128i*) &dst[i], tcd_clamp_sse2(v, vmin, vmax));
+				}
+			}
+#endif
+			for(; i < n; ++i) {
+				int v = src[i];
+				v += adjust;
+				dst[i] = int_clamp(v, min, max);
+			}
+		}
+	}else{
+		for(j = res->y0; j < res->y1; ++j) {
+			const float* src = &((float*)tilec->data)[(j - res->y0) * tw];
+			int* dst = &imagec->data[(res->x0 - offset_x) + (j - offset_y) * w];
+			int n = res->x1 - res->x0;
+			i = 0;
+#ifdef OPJ_HAVE_SSE2
+			if (opj_cpu_features & OPJ_CPU_SSE2) {
+				__m128i vadjust = _mm_set1_epi32(adjust);
+				__m128i vmin = _mm_set1_epi32(min);
+				__m128i vmax = _mm_set1_epi32(max);
+				for(; i + 3 < n; i += 4) {
+					__m128i v = _mm_add_epi32(tcd_lrintf_sse2(_mm_loadu_ps(&src[i])), vadjust);
+					_mm_storeu_si128((__m128i*) &dst[i], tcd_clamp_sse2(v, vmin, vmax));
+				}
+			}
+#endif
+			for(; i < n; ++i) {
+				float tmp = src[i];
+				int v = lrintf(tmp);
+				v += adjust;
+				dst[i] = int_clamp(v, min, max);
+			}
+		}
+	}
+	opj_aligned_free(tilec->data);
+	tilec->data = NULL;
+}
+
 opj_bool tcd_decode_tile(opj_tcd_t *tcd, unsigned char *src, int len, int tileno, opj_codestream_info_t *cstr_info) {
 	int l;
 	int compno;
 	int eof = 0;
 	double tile_time, t1_time, dwt_time;
 	opj_tcd_tile_t *tile = NULL;
+	opj_tcd_decode_job_t job;
+	int jobs;
 
-	opj_t1_t *t1 = NULL;		/* T1 component */
 	opj_t2_t *t2 = NULL;		/* T2 component */
 	
 	tcd->tcd_tileno = tileno;
@@ -1383,44 +1642,46 @@ opj_bool tcd_decode_tile(opj_tcd_t *tcd, unsigned char *src, int len, int tileno
 		opj_event_msg(tcd->cinfo, EVT_ERROR, "tcd_decode: incomplete bistream\n");
 	}
 	
-	/*------------------TIER1-----------------*/
-	
-	t1_time = opj_clock();	/* time needed to decode a tile */
-	t1 = t1_create(tcd->cinfo);
-    if (t1 == NULL)
-    {
-        opj_event_msg(tcd->cinfo, EVT_ERROR, "Out of memory\n");
-        t1_destroy(t1);
-        return OPJ_FALSE;
-    }
-
-	for (compno = 0; compno < tile->numcomps; ++compno) {
-		opj_tcd_tilecomp_t* tilec = &tile->comps[compno];
-		/* The +3 is headroom required by the vectorized DWT */
-		tilec->data = (int*) opj_aligned_malloc((((tilec->x1 - tilec->x0) * (tilec->y1 - tilec->y0))+3) * sizeof(int));
-        if (tilec->data == NULL)
-        {
-            opj_event_msg(tcd->cinfo, EVT_ERROR, "Out of memory\n");
-            return OPJ_FALSE;
-        }
+	/*------------------PLAN------------------*/
+
+	job.tcd = tcd;
+	job.tile = tile;
+	job.dinfo = tcd->cinfo->is_decompressor ? (opj_dinfo_t*)tcd->cinfo : NULL;
+	job.refinement = (job.dinfo && tcd->cp->tw * tcd->cp->th == 1) ? job.dinfo->refinement : NULL;
+	job.error = 0;
+	job.comps = (opj_tcd_decode_comp_t*) opj_malloc(tile->numcomps * sizeof(opj_tcd_decode_comp_t));
+	if (job.comps == NULL) {
+		opj_event_msg(tcd->cinfo, EVT_ERROR, "Out of memory\n");
+		return OPJ_FALSE;
+	}
+	jobs = (job.dinfo && job.dinfo->parallel_for) ? job.dinfo->parallel_jobs : 1;
 
-		t1_decode_cblks(t1, tilec, &tcd->tcp->tccps[compno]);
+	if (job.refinement && job.refinement->numcomps != tile->numcomps) {
+		opj_refinement_comp_t *comps = (opj_refinement_comp_t*) opj_calloc(tile->numcomps, sizeof(opj_refinement_comp_t));
+		if (comps) {
+			for (compno = 0; compno < job.refinement->numcomps; compno++) {
+				opj_free(job.refinement->comps[compno].data);
+			}
+			opj_free(job.refinement->comps);
+			job.refinement->comps = comps;
+			job.refinement->numcomps = tile->numcomps;
+			for (compno = 0; compno < tile->numcomps; compno++) {
+				comps[compno].resno = -1;
+			}
+		} else {
+			job.refinement = NULL;
+		}
 	}
-	t1_destroy(t1);
-	t1_time = opj_clock() - t1_time;
-	opj_event_msg(tcd->cinfo, EVT_INFO, "- tiers-1 took %f s\n", t1_time);
-	
-	/*----------------DWT---------------------*/
 
-	dwt_time = opj_clock();	/* time needed to decode a tile */
 	for (compno = 0; compno < tile->numcomps; compno++) {
 		opj_tcd_tilecomp_t *tilec = &tile->comps[compno];
-		int numres2decode;
+		opj_tcd_decode_comp_t *plan = &job.comps[compno];
 
 		if (tcd->cp->reduce != 0) {
 			if ( tile->comps[compno].numresolutions < ( tcd->cp->reduce - 1 ) ) {				
 				opj_event_msg(tcd->cinfo, EVT_ERROR, "Error decoding tile. The number of resolutions to remove [%d+1] is higher than the number "
 					" of resolutions in the original codestream [%d]\nModify the cp_reduce parameter.\n", tcd->cp->reduce, tile->comps[compno].numresolutions);
+				opj_free(job.comps);
 				return OPJ_FALSE;
 			}
       else {
@@ -1429,37 +1690,89 @@ opj_bool tcd_decode_tile(opj_tcd_t *tcd, unsigned char *src, int len, int tileno
       }
 		}
 
-		numres2decode = tcd->image->comps[compno].resno_decoded + 1;
-		if(numres2decode > 0){
-			if (tcd->tcp->tccps[compno].qmfbid == 1) {
-				dwt_decode(tilec, numres2decode);
-			} else {
-				dwt_decode_real(tilec, numres2decode);
+		/* Resolution levels above the one we reconstruct are not needed, skip their code-blocks */
+		plan->lastres = tcd->image->comps[compno].resno_decoded;
+		plan->firstres = 0;
+		plan->saveres = -1;
+
+		if (job.refinement && plan->lastres >= 0) {
+			opj_refinement_comp_t *refc = &job.refinement->comps[compno];
+			int saveres = int_min(plan->lastres, tile->resno_complete);
+			if (refc->resno >= tilec->numresolutions ||
+				(refc->resno >= 0 &&
+				 (refc->w != tilec->resolutions[refc->resno].x1 - tilec->resolutions[refc->resno].x0 ||
+				  refc->h != tilec->resolutions[refc->resno].y1 - tilec->resolutions[refc->resno].y0))) {
+				/* Not the same codestream */
+				refc->resno = -1;
+			}
+			if (refc->resno >= 0 && refc->resno <= plan->lastres) {
+				plan->firstres = refc->resno + 1;
+			}
+			if (saveres > refc->resno) {
+				opj_tcd_resolution_t *res = &tilec->resolutions[saveres];
+				int samples = (res->x1 - res->x0) * (res->y1 - res->y0);
+				if (samples > 0 && (job.refinement->max_samples == 0 || samples <= job.refinement->max_samples)) {
+					plan->saveres = saveres;
+				}
 			}
 		}
+
+		/* The +3 is headroom required by the vectorized DWT */
+		tilec->data = (int*) opj_aligned_malloc((((tilec->x1 - tilec->x0) * (tilec->y1 - tilec->y0))+3) * sizeof(int));
+		if (tilec->data == NULL)
+		{
+			opj_event_msg(tcd->cinfo, EVT_ERROR, "Out of memory\n");
+			tcd_free_decode_data(tile, compno);
+			opj_free(job.comps);
+			return OPJ_FALSE;
+		}
+		if (plan->firstres > 0) {
+			tcd_load_refinement(&job.refinement->comps[compno], tilec);
+		}
 	}
+	
+	/*------------------TIER1-----------------*/
+	
+	t1_time = opj_clock();	/* time needed to decode a tile */
+	/* Code-blocks of a component are dealt to several jobs, each job uses its own T1 context */
+	job.t1_parts = 1;
+	if (jobs > 1 && tile->numcomps < OPJ_T1_CACHE_SIZE) {
+		job.t1_parts = int_min((2 * jobs + tile->numcomps - 1) / tile->numcomps, OPJ_T1_CACHE_SIZE / tile->numcomps);
+		tcd_parallel_for(&job, tile->numcomps * job.t1_parts, tcd_t1_job);
+	} else {
+		for (compno = 0; compno < tile->numcomps; ++compno) {
+			tcd_t1_job(&job, compno);
+		}
+	}
+	t1_time = opj_clock() - t1_time;
+	opj_event_msg(tcd->cinfo, EVT_INFO, "- tiers-1 took %f s\n", t1_time);
+	if (job.error) {
+		opj_event_msg(tcd->cinfo, EVT_ERROR, "Out of memory\n");
+		tcd_free_decode_data(tile, tile->numcomps);
+		opj_free(job.comps);
+		return OPJ_FALSE;
+	}
+	
+	/*----------------DWT---------------------*/
+
+	dwt_time = opj_clock();	/* time needed to decode a tile */
+	tcd_parallel_for(&job, tile->numcomps, tcd_dwt_job);
 	dwt_time = opj_clock() - dwt_time;
 	opj_event_msg(tcd->cinfo, EVT_INFO, "- dwt took %f s\n", dwt_time);
 
 	/*----------------MCT-------------------*/
 
 	if (tcd->tcp->mct) {
-		int n = (tile->comps[0].x1 - tile->comps[0].x0) * (tile->comps[0].y1 - tile->comps[0].y0);
-
 		if (tile->numcomps >= 3 ){
-			if (tcd->tcp->tccps[0].qmfbid == 1) {
-				mct_decode(
-						tile->comps[0].data,
-						tile->comps[1].data,
-						tile->comps[2].data,
-						n);
-			} else {
-				mct_decode_real(
-						(float*)tile->comps[0].data,
-						(float*)tile->comps[1].data,
-						(float*)tile->comps[2].data,
-						n);
-			}
+			/* Only the rows of the reconstructed resolution level are needed */
+			opj_tcd_tilecomp_t *tilec = &tile->comps[0];
+			int resno = tcd->image->comps[0].resno_decoded;
+			int rows = (resno >= 0) ? tilec->resolutions[resno].y1 - tilec->resolutions[resno].y0 : tilec->y1 - tilec->y0;
+			job.mct_n = rows * (tilec->x1 - tilec->x0);
+			/* Chunks are multiples of 16 samples to keep the SSE loads aligned */
+			job.mct_chunk = ((job.mct_n + jobs - 1) / jobs + 15) & ~15;
+			job.mct_chunk = int_max(job.mct_chunk, 4096);
+			tcd_parallel_for(&job, (job.mct_n + job.mct_chunk - 1) / job.mct_chunk, tcd_mct_job);
 		} else{
 			opj_event_msg(tcd->cinfo, EVT_WARNING,"Number of components (%d) is inconsistent with a MCT. Skip the MCT step.\n",tile->numcomps);
 		}
@@ -1467,48 +1780,11 @@ opj_bool tcd_decode_tile(opj_tcd_t *tcd, unsigned char *src, int len, int tileno
 
 	/*---------------TILE-------------------*/
 
-	for (compno = 0; compno < tile->numcomps; ++compno) {
-		opj_tcd_tilecomp_t* tilec = &tile->comps[compno];
-		opj_image_comp_t* imagec = &tcd->image->comps[compno];
-		opj_tcd_resolution_t* res = &tilec->resolutions[imagec->resno_decoded];
-		int adjust = imagec->sgnd ? 0 : 1 << (imagec->prec - 1);
-		int min = imagec->sgnd ? -(1 << (imagec->prec - 1)) : 0;
-		int max = imagec->sgnd ?  (1 << (imagec->prec - 1)) - 1 : (1 << imagec->prec) - 1;
-
-		int tw = tilec->x1 - tilec->x0;
-		int w = imagec->w;
-
-		int offset_x = int_ceildivpow2(imagec->x0, imagec->factor);
-		int offset_y = int_ceildivpow2(imagec->y0, imagec->factor);
-
-		int i, j;
-		if(!imagec->data){
-			imagec->data = (int*) opj_malloc(imagec->w * imagec->h * sizeof(int));
-		}
-        if (!imagec->data)
-        {
-            opj_event_msg(tcd->cinfo, EVT_ERROR, "Out of memory\n");
-            return OPJ_FALSE;
-        }
-		if(tcd->tcp->tccps[compno].qmfbid == 1) {
-			for(j = res->y0; j < res->y1; ++j) {
-				for(i = res->x0; i < res->x1; ++i) {
-					int v = tilec->data[i - res->x0 + (j - res->y0) * tw];
-					v += adjust;
-					imagec->data[(i - offset_x) + (j - offset_y) * w] = int_clamp(v, min, max);
-				}
-			}
-		}else{
-			for(j = res->y0; j < res->y1; ++j) {
-				for(i = res->x0; i < res->x1; ++i) {
-					float tmp = ((float*)tilec->data)[i - res->x0 + (j - res->y0) * tw];
-					int v = lrintf(tmp);
-					v += adjust;
-					imagec->data[(i - offset_x) + (j - offset_y) * w] = int_clamp(v, min, max);
-				}
-			}
-		}
-		opj_aligned_free(tilec->data);
+	tcd_parallel_for(&job, tile->numcomps, tcd_dc_shift_job);
+	opj_free(job.comps);
+	if (job.error) {
+		opj_event_msg(tcd->cinfo, EVT_ERROR, "Out of memory\n");
+		return OPJ_FALSE;
 	}
 
 	tile_time = opj_clock() - tile_time;	/* time needed to decode a tile */
@@ -157,6 +157,8 @@ typedef struct opj_tcd_tile {
   double distolayer[100];	/* add fixed_quality */
   /** packet number */
   int packno;
+  /** last resolution level whose packets were all decoded, -1 if unknown (see t2_decode_packets) */
+  int resno_complete;
 } opj_tcd_tile_t;
 
 /**
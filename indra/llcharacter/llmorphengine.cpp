@@ -0,0 +1,180 @@
+/**
+ * @file llmorphengine.cpp
+ * @brief Applies the morph targets of an avatar mesh in one pass
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmorphengine.h"
+
+#include "llworkerpool.h"
+
+const F32 LLMorphEngine::NORMAL_SOFTEN_FACTOR = 0.65f;
+
+// Moves vertex v of the mesh by the i-th delta of the morph.
+static inline void add_delta(const LLMorphEngine::Mesh& mesh, const LLMorphEngine::Morph& morph, U32 i, U32 v,
+							 F32 delta_weight, F32 mask_weight, bool clothing)
+{
+	LLVector4a pos = morph.mCoords[i];
+	pos.mul(delta_weight * mask_weight);
+	mesh.mCoords[v].add(pos);
+
+	if (clothing)
+	{
+		LLVector4a clothing_offset = morph.mCoords[i];
+		clothing_offset.mul(delta_weight * mask_weight);
+		LLVector4a* clothing_weight = &mesh.mClothingWeights[v];
+		clothing_weight->add(clothing_offset);
+		clothing_weight->getF32ptr()[VW] = mask_weight;
+	}
+
+	LLVector4a norm = morph.mNormals[i];
+	norm.mul(delta_weight * mask_weight * LLMorphEngine::NORMAL_SOFTEN_FACTOR);
+	mesh.mScaledNormals[v].add(norm);
+
+	LLVector4a binorm = morph.mBinormals[i];
+	binorm.mul(delta_weight * mask_weight * LLMorphEngine::NORMAL_SOFTEN_FACTOR);
+	mesh.mScaledBinormals[v].add(binorm);
+
+	mesh.mTexCoords[v] += morph.mTexCoords[i] * delta_weight * mask_weight;
+}
+
+// The normal and binormal of vertex v from the sums of their deltas.
+static inline void renormalize(const LLMorphEngine::Mesh& mesh, U32 v)
+{
+	LLVector4a norm = mesh.mScaledNormals[v];
+	norm.normalize3fast();
+	mesh.mNormals[v] = norm;
+
+	LLVector4a tangent;
+	tangent.setCross3(mesh.mScaledBinormals[v], norm);
+	LLVector4a& normalized_binormal = mesh.mBinormals[v];
+	normalized_binormal.setCross3(norm, tangent);
+	normalized_binormal.normalize3fast();
+}
+
+LLMorphEngine::LLMorphEngine(const Mesh& mesh)
+:	mMesh(mesh),
+	mVertices(0),
+	mTouched(mesh.mNumVertices, 0),
+	mFirstTouched(mesh.mNumVertices),
+	mLastTouched(0)
+{
+}
+
+void LLMorphEngine::add(const Morph& morph, F32 delta_weight, const F32* mask_weights, bool clothing)
+{
+	if (!morph.mNumIndices || delta_weight == 0.f)
+	{
+		return;
+	}
+	Entry entry;
+	entry.mMorph = morph;
+	entry.mWeight = delta_weight;
+	entry.mMaskWeights = mask_weights;
+	entry.mClothing = clothing && mMesh.mClothingWeights;
+	mEntries.push_back(entry);
+	mVertices += morph.mNumIndices;
+}
+
+void LLMorphEngine::apply()
+{
+	// Sum the deltas of all the morphs, in the order they were added.
+	for (U32 e = 0; e < mEntries.size(); ++e)
+	{
+		const Entry& entry = mEntries[e];
+		const Morph& morph = entry.mMorph;
+		for (U32 i = 0; i < morph.mNumIndices; ++i)
+		{
+			U32 v = morph.mVertexIndices[i];
+			if (v >= mMesh.mNumVertices)
+			{
+				continue;
+			}
+			add_delta(mMesh, morph, i, v, entry.mWeight, entry.mMaskWeights ? entry.mMaskWeights[i] : 1.f,
+					  entry.mClothing);
+			mTouched[v] = 1;
+			mFirstTouched = llmin(mFirstTouched, v);
+			mLastTouched = llmax(mLastTouched, v);
+		}
+	}
+
+	// Then renormalize each vertex they moved once, in memory order.
+	for (U32 v = mFirstTouched; v <= mLastTouched && v < mMesh.mNumVertices; ++v)
+	{
+		if (mTouched[v])
+		{
+			renormalize(mMesh, v);
+			mTouched[v] = 0;
+		}
+	}
+
+	mEntries.clear();
+	mVertices = 0;
+	mFirstTouched = mMesh.mNumVertices;
+	mLastTouched = 0;
+}
+
+//static
+void LLMorphEngine::applyReference(const Mesh& mesh, const Morph& morph, F32 delta_weight, const F32* mask_weights,
+								   bool clothing)
+{
+	clothing = clothing && mesh.mClothingWeights;
+	for (U32 i = 0; i < morph.mNumIndices; ++i)
+	{
+		U32 v = morph.mVertexIndices[i];
+		add_delta(mesh, morph, i, v, delta_weight, mask_weights ? mask_weights[i] : 1.f, clothing);
+		renormalize(mesh, v);
+	}
+}
+
+//============================================================================
+
+// A job of LLWorkerPool::parallelFor().
+static void apply_engine(void* data, S32 index)
+{
+	((LLMorphEngine* const*)data)[index]->apply();
+}
+
+//static
+void LLMorphEngine::applyAll(LLMorphEngine* const* engines, S32 count)
+{
+	S32 vertices = 0;
+	for (S32 i = 0; i < count; ++i)
+	{
+		vertices += engines[i]->getVertexCount();
+	}
+	LLWorkerPool* pool = LLWorkerPool::getInstance();
+	LLWorkerPool::Subsystem* subsystem = pool ? pool->getSubsystem("morph") : NULL;
+	if (!subsystem || count < 2 || vertices < MIN_PARALLEL_VERTICES)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			engines[i]->apply();
+		}
+		return;
+	}
+
+	pool->parallelFor(subsystem, count, apply_engine, (void*)engines);
+}
@@ -0,0 +1,123 @@
+/**
+ * @file llmorphengine.h
+ * @brief Applies the morph targets of an avatar mesh in one pass
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMORPHENGINE_H
+#define LL_LLMORPHENGINE_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "llvector4a.h"
+#include "v2math.h"
+
+//============================================================================
+// Applies the morph targets of an avatar mesh.
+//
+// A morph target moves the coordinates, normals, binormals and texture
+// coordinates of some vertices of the mesh by its deltas times the change of
+// its weight, after which the normals and binormals of those vertices are
+// renormalized. Done one morph at a time, a full appearance renormalizes
+// most vertices dozens of times; the engine takes the deltas of all the
+// morphs that changed first and then renormalizes each vertex they touched
+// once. Results are the same as one morph at a time, to the bit.
+//
+// The engines of an avatar are independent of each other, so applyAll()
+// runs them on the worker pool ("morph" subsystem).
+
+class LLMorphEngine
+{
+public:
+	// The vertex arrays of a mesh, as LLPolyMesh has them.
+	struct Mesh
+	{
+		LLVector4a* mCoords;
+		LLVector4a* mScaledNormals;		// Sums of the normal deltas.
+		LLVector4a* mNormals;			// Renormalized from the above.
+		LLVector4a* mScaledBinormals;
+		LLVector4a* mBinormals;
+		LLVector4a* mClothingWeights;	// May be NULL.
+		LLVector2* mTexCoords;
+		U32 mNumVertices;
+	};
+
+	// The deltas of a morph target, as LLPolyMorphData has them.
+	struct Morph
+	{
+		const U32* mVertexIndices;
+		const LLVector4a* mCoords;
+		const LLVector4a* mNormals;
+		const LLVector4a* mBinormals;
+		const LLVector2* mTexCoords;
+		U32 mNumIndices;
+	};
+
+	LLMorphEngine(const Mesh& mesh);
+
+	// Queues delta_weight times the morph, times mask_weights[i] for its i-th
+	// vertex when there is a mask. Clothing morphs move the clothing weights
+	// too. The deltas and the mask must stay as they are until apply().
+	void add(const Morph& morph, F32 delta_weight, const F32* mask_weights, bool clothing);
+	// Applies the morphs added since the last time.
+	void apply();
+
+	bool isEmpty() const						{ return mEntries.empty(); }
+	// Vertex deltas queued.
+	S32 getVertexCount() const					{ return mVertices; }
+
+	// MAIN THREAD. Applies count engines, on the worker pool when it is on
+	// and there is enough to do, and on the calling thread too, so that all
+	// of them are done when it returns.
+	static void applyAll(LLMorphEngine* const* engines, S32 count);
+
+	// What LLPolyMorphTarget::apply() did before there was an engine. For
+	// checking the engine against.
+	static void applyReference(const Mesh& mesh, const Morph& morph, F32 delta_weight, const F32* mask_weights,
+							   bool clothing);
+
+	// Part of the normal and binormal deltas that is applied.
+	static const F32 NORMAL_SOFTEN_FACTOR;
+	// Fewer vertex deltas than this are not worth waking the workers for.
+	static const S32 MIN_PARALLEL_VERTICES = 4096;
+
+private:
+	struct Entry
+	{
+		Morph mMorph;
+		F32 mWeight;
+		const F32* mMaskWeights;
+		bool mClothing;
+	};
+
+	Mesh mMesh;
+	std::vector<Entry> mEntries;
+	S32 mVertices;
+	// Vertices to renormalize, between mFirstTouched and mLastTouched.
+	std::vector<U8> mTouched;
+	U32 mFirstTouched;
+	U32 mLastTouched;
+};
+
+#endif // LL_LLMORPHENGINE_H
@@ -58,4 +58,24 @@ private:
 typedef LLAtomic32<U32> LLAtomicU32;
 typedef LLAtomic32<S32> LLAtomicS32;
 
+// Atomic pointer, for building intrusive lock-free lists.
+template <typename Type> class LLAtomicPointer
+{
+public:
+	LLAtomicPointer(Type* x = NULL) : mData(x) { }
+
+	operator Type*() const { return static_cast<Type*>(apr_atomic_casptr(const_cast<volatile void**>(&mData), NULL, NULL)); }
+	// Stores x and returns the previous value.
+	Type* exchange(Type* x) { return static_cast<Type*>(apr_atomic_xchgptr(&mData, x)); }
+	// Stores x if the current value is cmp. Returns the previous value (so the swap happened when it equals cmp).
+	Type* compareAndSwap(Type* x, Type* cmp) { return static_cast<Type*>(apr_atomic_casptr(&mData, x, cmp)); }
+
+private:
+	// No copy constructor or copy assignment.
+	LLAtomicPointer(LLAtomicPointer const&);
+	LLAtomicPointer& operator=(LLAtomicPointer const&);
+
+	volatile void* mData;
+};
+
 #endif
@@ -40,6 +40,10 @@
 // FastTimers should only be used from the main thread and never from another
 // thread.
 //
+// (Timers that are used by other threads anyway don't touch any of the data
+// described below; they are redirected to a ThreadTimers object of their own,
+// see LLFastTimer::ThreadTimers further down.)
+//
 // NamedTimerFactory is a singleton, accessed through NamedTimerFactory::instance().
 //
 // It has four pointer members which are initialized once to point to
@@ -146,9 +150,12 @@
 
 #include "llfasttimer.h"
 
+#include "llatomic.h"
+#include "llfile.h"
 #include "llmemory.h"
 #include "llprocessor.h"
 #include "llsingleton.h"
+#include "llthread.h"
 #include "lltreeiterators.h"
 #include "llsdserialize.h"
 
@@ -191,6 +198,10 @@ const int LLFastTimer::NamedTimer::HISTORY_NUM = 300;
 std::vector<LLFastTimer::FrameState>* LLFastTimer::sTimerInfos = NULL;
 U64				LLFastTimer::sTimerCycles = 0;
 U32				LLFastTimer::sTimerCalls = 0;
+bool			LLFastTimer::sTracing = false;
+
+// Source of NamedTimer::mIndex.
+static U32 sNamedTimerCount = 0;
 
 
 // FIXME: move these declarations to the relevant modules
@@ -424,7 +435,8 @@ LLFastTimer::FrameState::FrameState(LLFastTimer::NamedTimer* timerp)
 
 
 LLFastTimer::NamedTimer::NamedTimer(const std::string& name)
-:	mName(name),
+:	mIndex(sNamedTimerCount++),
+	mName(name),
 	mCollapsed(true),
 	mParent(NULL),
 	mTotalTimeCounter(0),
@@ -844,6 +856,438 @@ std::vector<LLFastTimer::NamedTimer*>& LLFastTimer::NamedTimer::getChildren()
 	return mChildren;
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//
+// Timers of threads other than the main thread.
+//
+// Every other thread that uses a timer gets a ThreadTimers, with a timer stack
+// of its own (the equivalent of sCurTimerData) and counters per NamedTimer,
+// indexed by NamedTimer::getIndex(). Only the owning thread writes its counters
+// and they only ever go up: once a frame, collectThreadTimes() reads them from
+// the main thread and subtracts what it read the frame before, so neither thread
+// ever waits for the other. A timer is counted in the frame during which it stops.
+//
+// The ThreadTimers of all threads are kept in a list that threads only ever push
+// onto. The main thread removes the ThreadTimers of threads that exited.
+//
+
+class LLFastTimer::ThreadTimers
+{
+public:
+	struct Counters
+	{
+		// written by the owning thread only
+		NamedTimer* volatile	mTimer;
+		NamedTimer* volatile	mLastCaller;	// NULL when no other timer of this thread was running
+		volatile U32			mSelfTime;
+		volatile U32			mCalls;
+		// used by collectThreadTimes() only
+		U32						mCollectedSelfTime;
+		U32						mCollectedCalls;
+	};
+
+	enum trace_event_t
+	{
+		TRACE_BEGIN,
+		TRACE_END,
+		TRACE_FRAME
+	};
+
+	struct TraceEvent
+	{
+		U64				mTime;
+		NamedTimer*		mTimer;		// NULL for TRACE_FRAME
+		trace_event_t	mType;
+	};
+
+	// Deleted with the LLThreadLocalData of the thread, while the main thread may be
+	// reading the counters; so this only flags them for deletion by collectThreadTimes().
+	class Owner : public LLThreadLocalDataMember
+	{
+	public:
+		Owner(ThreadTimers* timers) : mTimers(timers) { }
+		/*virtual*/ ~Owner() { mTimers->mExited = true; }
+
+		ThreadTimers* mTimers;
+	};
+
+	ThreadTimers(const std::string& name);
+	~ThreadTimers();
+
+	// the ThreadTimers of the calling thread
+	static ThreadTimers& get();
+
+	// called by the owning thread
+	Counters& getCounters(NamedTimer& timer);
+	void trace(NamedTimer* timer, trace_event_t type);
+
+	// called by the main thread
+	void collect(ThreadTimings& timings);
+	bool hasTrace() const { return mTraceGeneration == sTraceGeneration && mTraceCount > 0; }
+	void writeTrace(std::ostream& os, F64 usec_per_count) const;
+
+	enum
+	{
+		BLOCK_SIZE = 128,
+		MAX_BLOCKS = 64,						// 8192 named timers
+		MAX_TRACE_EVENTS = 256 * 1024			// per thread, 6 MB
+	};
+
+	std::string mName;
+	U32 mID;
+	CurTimerData mCurTimerData;
+	volatile bool mExited;
+	ThreadTimers* mNext;
+
+	// The counters are allocated a block at a time by the owning thread, which
+	// finds them in mOwnBlocks; mBlocks is where the main thread finds them.
+	Counters* mOwnBlocks[MAX_BLOCKS];
+	LLAtomicPointer<Counters> mBlocks[MAX_BLOCKS];
+	Counters mOverflow;
+
+	// Allocated on first use and never moved, so the main thread can read
+	// the first mTraceCount events while the owning thread adds more.
+	TraceEvent* mTraceEvents;
+	LLAtomicU32 mTraceCount;
+	LLAtomicU32 mTraceGeneration;
+
+	static LLAtomicPointer<ThreadTimers> sHead;
+	static LLAtomicU32 sNextID;
+	static thread_timings_list_t sTimings;
+
+	static volatile U32 sTraceGeneration;
+	static S32 sTraceFramesLeft;
+	static U64 sTraceStartTime;
+	static std::string sTraceFileName;
+};
+
+LLAtomicPointer<LLFastTimer::ThreadTimers> LLFastTimer::ThreadTimers::sHead;
+LLAtomicU32 LLFastTimer::ThreadTimers::sNextID(1);
+LLFastTimer::thread_timings_list_t LLFastTimer::ThreadTimers::sTimings;
+volatile U32 LLFastTimer::ThreadTimers::sTraceGeneration = 0;
+S32 LLFastTimer::ThreadTimers::sTraceFramesLeft = 0;
+U64 LLFastTimer::ThreadTimers::sTraceStartTime = 0;
+std::string LLFastTimer::ThreadTimers::sTraceFileName;
+
+LLFastTimer::ThreadTimers::ThreadTimers(const std::string& name)
+:	mName(name),
+	mID(sNextID++),
+	mExited(false),
+	mNext(NULL),
+	mTraceEvents(NULL),
+	mTraceCount(0),
+	mTraceGeneration(0)
+{
+	mCurTimerData.mCurTimer = NULL;
+	mCurTimerData.mNamedTimer = NULL;
+	mCurTimerData.mFrameState = NULL;
+	mCurTimerData.mChildTime = 0;
+	memset(mOwnBlocks, 0, sizeof(mOwnBlocks));
+	memset(&mOverflow, 0, sizeof(mOverflow));
+}
+
+LLFastTimer::ThreadTimers::~ThreadTimers()
+{
+	for (S32 i = 0; i < MAX_BLOCKS; ++i)
+	{
+		delete [] mOwnBlocks[i];
+	}
+	delete [] mTraceEvents;
+}
+
+//static
+LLFastTimer::ThreadTimers& LLFastTimer::ThreadTimers::get()
+{
+	LLThreadLocalData& tldata = LLThreadLocalData::tldata();
+	if (LL_UNLIKELY(!tldata.mFastTimers))
+	{
+		ThreadTimers* timers = new ThreadTimers(tldata.mName);
+		tldata.mFastTimers = new Owner(timers);
+		ThreadTimers* head;
+		do
+		{
+			head = sHead;
+			timers->mNext = head;
+		}
+		while (sHead.compareAndSwap(timers, head) != head);
+	}
+	return *static_cast<Owner*>(tldata.mFastTimers)->mTimers;
+}
+
+LLFastTimer::ThreadTimers::Counters& LLFastTimer::ThreadTimers::getCounters(NamedTimer& timer)
+{
+	U32 block = timer.mIndex / BLOCK_SIZE;
+	if (block >= MAX_BLOCKS)
+	{
+		return mOverflow;
+	}
+	Counters* counters = mOwnBlocks[block];
+	if (!counters)
+	{
+		counters = new Counters[BLOCK_SIZE]();
+		mOwnBlocks[block] = counters;
+		mBlocks[block].exchange(counters);
+	}
+	Counters& result = counters[timer.mIndex % BLOCK_SIZE];
+	if (!result.mTimer)
+	{
+		result.mTimer = &timer;
+	}
+	return result;
+}
+
+void LLFastTimer::ThreadTimers::trace(NamedTimer* timer, trace_event_t type)
+{
+	if (mTraceGeneration != sTraceGeneration)
+	{
+		// first event of a new trace
+		if (!mTraceEvents)
+		{
+			mTraceEvents = new TraceEvent[MAX_TRACE_EVENTS];
+		}
+		mTraceCount = 0;
+		mTraceGeneration = sTraceGeneration;
+	}
+	U32 count = mTraceCount;
+	if (count < MAX_TRACE_EVENTS)
+	{
+		TraceEvent& event = mTraceEvents[count];
+		event.mTime = getCPUClockCount64();
+		event.mTimer = timer;
+		event.mType = type;
+		mTraceCount = count + 1;
+	}
+}
+
+void LLFastTimer::ThreadTimers::collect(ThreadTimings& timings)
+{
+	for (S32 block = 0; block < MAX_BLOCKS; ++block)
+	{
+		Counters* counters = mBlocks[block];
+		if (!counters)
+		{
+			continue;
+		}
+		for (S32 i = 0; i < BLOCK_SIZE; ++i)
+		{
+			Counters& counter = counters[i];
+			U32 calls = counter.mCalls;
+			U32 self_time = counter.mSelfTime;
+			// mTimer is set before the first call is counted
+			if (!counter.mTimer || (calls == counter.mCollectedCalls && self_time == counter.mCollectedSelfTime))
+			{
+				continue;
+			}
+			ThreadTiming timing;
+			timing.mTimer = counter.mTimer;
+			timing.mParent = counter.mLastCaller;
+			timing.mSelfTime = self_time - counter.mCollectedSelfTime;
+			timing.mCalls = calls - counter.mCollectedCalls;
+			timings.mTimings.push_back(timing);
+			counter.mCollectedCalls = calls;
+			counter.mCollectedSelfTime = self_time;
+		}
+	}
+}
+
+static std::string escape_json(const std::string& str)
+{
+	std::string result;
+	for (std::string::const_iterator it = str.begin(); it != str.end(); ++it)
+	{
+		if (*it == '"' || *it == '\\')
+		{
+			result += '\\';
+		}
+		else if ((U8)*it < 0x20)
+		{
+			result += llformat("\\u%04x", (U32)(U8)*it);
+			continue;
+		}
+		result += *it;
+	}
+	return result;
+}
+
+void LLFastTimer::ThreadTimers::writeTrace(std::ostream& os, F64 usec_per_count) const
+{
+	U32 count = mTraceCount;
+	if (count >= MAX_TRACE_EVENTS)
+	{
+		llwarns << "Fast timer trace of " << mName << " is incomplete: more than " << (S32)MAX_TRACE_EVENTS << " events." << llendl;
+	}
+	os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << mID
+	   << ",\"args\":{\"name\":\"" << escape_json(mName) << "\"}}";
+	for (U32 i = 0; i < count; ++i)
+	{
+		const TraceEvent& event = mTraceEvents[i];
+		F64 timestamp = (F64)(S64)(event.mTime - sTraceStartTime) * usec_per_count;
+		if (event.mType == TRACE_FRAME)
+		{
+			os << ",\n{\"name\":\"Frame\",\"ph\":\"i\",\"s\":\"g\"";
+		}
+		else
+		{
+			os << ",\n{\"name\":\"" << escape_json(event.mTimer->getName()) << "\",\"ph\":\"" << (event.mType == TRACE_BEGIN ? 'B' : 'E') << '"';
+		}
+		os << ",\"pid\":0,\"tid\":" << mID << ",\"ts\":" << llformat("%.3f", timestamp) << "}";
+	}
+}
+
+//static
+bool LLFastTimer::inMainThread()
+{
+	return AIThreadID::in_main_thread_inline();
+}
+
+void LLFastTimer::startThreadTimer(NamedTimer& timer)
+{
+	ThreadTimers& timers = ThreadTimers::get();
+	mFrameState = NULL;
+	mStartTime = getCPUClockCount32();
+
+	CurTimerData& cur_timer_data = timers.mCurTimerData;
+	mLastTimerData = cur_timer_data;
+	cur_timer_data.mCurTimer = this;
+	cur_timer_data.mNamedTimer = &timer;
+	cur_timer_data.mChildTime = 0;
+
+	ThreadTimers::Counters& counters = timers.getCounters(timer);
+	counters.mCalls = counters.mCalls + 1;
+
+	if (sTracing)
+	{
+		timers.trace(&timer, ThreadTimers::TRACE_BEGIN);
+	}
+}
+
+void LLFastTimer::stopThreadTimer()
+{
+	ThreadTimers& timers = ThreadTimers::get();
+	CurTimerData& cur_timer_data = timers.mCurTimerData;
+	if (sTracing)
+	{
+		timers.trace(cur_timer_data.mNamedTimer, ThreadTimers::TRACE_END);
+	}
+
+	U32 total_time = getCPUClockCount32() - mStartTime;
+	ThreadTimers::Counters& counters = timers.getCounters(*cur_timer_data.mNamedTimer);
+	counters.mSelfTime = counters.mSelfTime + total_time - cur_timer_data.mChildTime;
+	counters.mLastCaller = mLastTimerData.mNamedTimer;
+
+	mLastTimerData.mChildTime += total_time;
+	cur_timer_data = mLastTimerData;
+}
+
+//static
+void LLFastTimer::collectThreadTimes()
+{
+	ThreadTimers::sTimings.clear();
+	ThreadTimers* prev = NULL;
+	ThreadTimers* timers = ThreadTimers::sHead;
+	while (timers)
+	{
+		// read before collecting, so that we don't miss anything the thread did before it exited
+		bool exited = timers->mExited;
+
+		ThreadTimings timings;
+		timings.mThreadName = timers->mName;
+		timers->collect(timings);
+		if (!timings.mTimings.empty())
+		{
+			ThreadTimers::sTimings.push_back(timings);
+		}
+
+		ThreadTimers* next = timers->mNext;
+		// Only the head is changed by other threads; it'll be removed once it isn't the head anymore.
+		// Keep the events of the last trace until the next one starts.
+		if (exited && prev && !timers->hasTrace())
+		{
+			prev->mNext = next;
+			delete timers;
+		}
+		else
+		{
+			prev = timers;
+		}
+		timers = next;
+	}
+}
+
+//static
+const LLFastTimer::thread_timings_list_t& LLFastTimer::getThreadTimings()
+{
+	return ThreadTimers::sTimings;
+}
+
+//static
+void LLFastTimer::traceMainThread(NamedTimer* timer, bool begin)
+{
+	ThreadTimers::get().trace(timer, begin ? ThreadTimers::TRACE_BEGIN : ThreadTimers::TRACE_END);
+}
+
+//static
+void LLFastTimer::startTrace(S32 frames, const std::string& filename)
+{
+	if (sTracing)
+	{
+		llwarns << "Already recording a fast timer trace." << llendl;
+		return;
+	}
+	llinfos << "Recording a fast timer trace of " << frames << " frames." << llendl;
+	ThreadTimers::sTraceFramesLeft = frames;
+	ThreadTimers::sTraceFileName = filename;
+	ThreadTimers::sTraceStartTime = getCPUClockCount64();
+	++ThreadTimers::sTraceGeneration;
+	sTracing = true;
+	ThreadTimers::get().trace(NULL, ThreadTimers::TRACE_FRAME);
+}
+
+//static
+void LLFastTimer::stopTrace()
+{
+	sTracing = false;
+	if (ThreadTimers::sTraceFileName.empty())
+	{
+		return;
+	}
+	llofstream file(ThreadTimers::sTraceFileName);
+	if (!file.is_open())
+	{
+		llwarns << "Couldn't open " << ThreadTimers::sTraceFileName << " to write the fast timer trace to." << llendl;
+		return;
+	}
+	writeTrace(file);
+	llinfos << "Wrote fast timer trace to " << ThreadTimers::sTraceFileName << llendl;
+}
+
+//static
+void LLFastTimer::writeTrace(std::ostream& os)
+{
+	if (sTracing)
+	{
+		llwarns << "Can't write a fast timer trace while recording it." << llendl;
+		return;
+	}
+	// countsPerSecond() is for the 32-bit timer, which is the 64-bit one shifted by 8 bits
+	F64 usec_per_count = 1000000.0 / ((F64)countsPerSecond() * 256.0);
+	os << "{\"traceEvents\":[\n";
+	bool first = true;
+	for (ThreadTimers* timers = ThreadTimers::sHead; timers; timers = timers->mNext)
+	{
+		if (timers->hasTrace())
+		{
+			if (!first)
+			{
+				os << ",\n";
+			}
+			first = false;
+			timers->writeTrace(os, usec_per_count);
+		}
+	}
+	os << "\n]}\n";
+}
+
 //static
 void LLFastTimer::nextFrame()
 {
@@ -854,9 +1298,19 @@ void LLFastTimer::nextFrame()
 		llinfos << "Slow frame, fast timers inaccurate" << llendl;
 	}
 
+	if (sTracing)
+	{
+		ThreadTimers::get().trace(NULL, ThreadTimers::TRACE_FRAME);
+		if (--ThreadTimers::sTraceFramesLeft <= 0)
+		{
+			stopTrace();
+		}
+	}
+
 	if (!sPauseHistory)
 	{
 		NamedTimer::processTimes();
+		collectThreadTimes();
 		sLastFrameIndex = sCurFrameIndex;
 		++sCurFrameIndex;
 	}
@@ -866,6 +1320,18 @@ void LLFastTimer::nextFrame()
 	sLastFrameTime = frame_time;
 }
 
+static const LLFastTimer::ThreadTiming* find_thread_timing(const std::vector<LLFastTimer::ThreadTiming>& timings, const LLFastTimer::NamedTimer* timer)
+{
+	for (std::vector<LLFastTimer::ThreadTiming>::const_iterator it = timings.begin(); it != timings.end(); ++it)
+	{
+		if (it->mTimer == timer)
+		{
+			return &*it;
+		}
+	}
+	return NULL;
+}
+
 //static
 void LLFastTimer::dumpCurTimes()
 {
@@ -898,6 +1364,38 @@ void LLFastTimer::dumpCurTimes()
 
 		llinfos << out_str.str() << llendl;
 	}
+
+	// the other threads, as collected by the last nextFrame()
+	const thread_timings_list_t& thread_timings = getThreadTimings();
+	for (thread_timings_list_t::const_iterator thread_it = thread_timings.begin(); thread_it != thread_timings.end(); ++thread_it)
+	{
+		llinfos << thread_it->mThreadName << llendl;
+		const std::vector<ThreadTiming>& timings = thread_it->mTimings;
+		for (std::vector<ThreadTiming>::const_iterator it = timings.begin(); it != timings.end(); ++it)
+		{
+			F64 self_time_ms = (F64)it->mSelfTime * iclock_freq;
+			if (self_time_ms < 0.1) continue;
+
+			std::ostringstream out_str;
+			out_str << "\t";
+			// indent by the depth in this thread's own hierarchy; mParent is only the last caller, so it can loop
+			S32 depth = 0;
+			const NamedTimer* parent = it->mParent;
+			while (parent && depth < (S32)timings.size())
+			{
+				out_str << "\t";
+				++depth;
+				const ThreadTiming* parent_timing = find_thread_timing(timings, parent);
+				parent = parent_timing ? parent_timing->mParent : NULL;
+			}
+
+			out_str << it->mTimer->getName() << " "
+				<< std::setprecision(3) << self_time_ms << " ms self, "
+				<< it->mCalls << " calls";
+
+			llinfos << out_str.str() << llendl;
+		}
+	}
 }
 
 //static 
@@ -31,7 +31,6 @@
 
 #define FAST_TIMER_ON 1
 #define TIME_FAST_TIMERS 0
-#define DEBUG_FAST_TIMER_THREADS 1
 
 class LLMutex;
 
@@ -91,6 +90,8 @@ public:
 		static NamedTimer& getRootNamedTimer();
 
 		S32 getFrameStateIndex() const { return mFrameStateIndex; }
+		// unlike the frame state index this never changes
+		U32 getIndex() const { return mIndex; }
 
 		FrameState& getFrameState() const;
 
@@ -117,6 +118,7 @@ public:
 		// members
 		//
 		S32			mFrameStateIndex;
+		U32			mIndex;
 
 		std::string	mName;
 
@@ -149,6 +151,22 @@ public:
 		FrameState*		mFrameState;
 	};
 
+	// what the timers of a thread other than the main thread did during the last frame
+	struct ThreadTiming
+	{
+		const NamedTimer*	mTimer;
+		const NamedTimer*	mParent;		// NULL when called with no other timer of that thread running
+		U32					mSelfTime;		// same units as FrameState::mSelfTimeCounter
+		U32					mCalls;
+	};
+
+	struct ThreadTimings
+	{
+		std::string					mThreadName;
+		std::vector<ThreadTiming>	mTimings;	// only the timers that stopped during the frame
+	};
+	typedef std::vector<ThreadTimings> thread_timings_list_t;
+
 public:
 	LLFastTimer(LLFastTimer::FrameState* state);
 
@@ -159,29 +177,37 @@ public:
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
-		LLFastTimer::FrameState* frame_state = mFrameState;
-		mStartTime = getCPUClockCount32();
-
-		frame_state->mActiveCount++;
-		frame_state->mCalls++;
-		// keep current parent as long as it is active when we are
-		frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
-
-		LLFastTimer::CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
-		mLastTimerData = *cur_timer_data;
-		cur_timer_data->mCurTimer = this;
-		cur_timer_data->mNamedTimer = &timer.mTimer;
-		cur_timer_data->mFrameState = frame_state;
-		cur_timer_data->mChildTime = 0;
+		if (LL_UNLIKELY(!inMainThread()))
+		{
+			// other threads have a timer stack of their own
+			startThreadTimer(timer.mTimer);
+		}
+		else
+		{
+			LLFastTimer::FrameState* frame_state = mFrameState;
+			mStartTime = getCPUClockCount32();
+
+			frame_state->mActiveCount++;
+			frame_state->mCalls++;
+			// keep current parent as long as it is active when we are
+			frame_state->mMoveUpTree |= (frame_state->mParent->mActiveCount == 0);
+
+			LLFastTimer::CurTimerData* cur_timer_data = &LLFastTimer::sCurTimerData;
+			mLastTimerData = *cur_timer_data;
+			cur_timer_data->mCurTimer = this;
+			cur_timer_data->mNamedTimer = &timer.mTimer;
+			cur_timer_data->mFrameState = frame_state;
+			cur_timer_data->mChildTime = 0;
+
+			if (LL_UNLIKELY(sTracing))
+			{
+				traceMainThread(&timer.mTimer, true);
+			}
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
 		sTimerCycles += timer_end - timer_start;
-#endif
-#if DEBUG_FAST_TIMER_THREADS
-#if !LL_RELEASE
-		assert_main_thread();
-#endif
 #endif
 	}
 
@@ -191,20 +217,33 @@ public:
 		U64 timer_start = getCPUClockCount64();
 #endif
 #if FAST_TIMER_ON
-		LLFastTimer::FrameState* frame_state = mFrameState;
-		U32 total_time = getCPUClockCount32() - mStartTime;
-
-		frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
-		frame_state->mActiveCount--;
-
-		// store last caller to bootstrap tree creation
-		// do this in the destructor in case of recursion to get topmost caller
-		frame_state->mLastCaller = mLastTimerData.mNamedTimer;
-
-		// we are only tracking self time, so subtract our total time delta from parents
-		mLastTimerData.mChildTime += total_time;
-
-		LLFastTimer::sCurTimerData = mLastTimerData;
+		// startThreadTimer() leaves mFrameState NULL
+		if (LL_UNLIKELY(!mFrameState))
+		{
+			stopThreadTimer();
+		}
+		else
+		{
+			if (LL_UNLIKELY(sTracing))
+			{
+				traceMainThread(LLFastTimer::sCurTimerData.mNamedTimer, false);
+			}
+
+			LLFastTimer::FrameState* frame_state = mFrameState;
+			U32 total_time = getCPUClockCount32() - mStartTime;
+
+			frame_state->mSelfTimeCounter += total_time - LLFastTimer::sCurTimerData.mChildTime;
+			frame_state->mActiveCount--;
+
+			// store last caller to bootstrap tree creation
+			// do this in the destructor in case of recursion to get topmost caller
+			frame_state->mLastCaller = mLastTimerData.mNamedTimer;
+
+			// we are only tracking self time, so subtract our total time delta from parents
+			mLastTimerData.mChildTime += total_time;
+
+			LLFastTimer::sCurTimerData = mLastTimerData;
+		}
 #endif
 #if TIME_FAST_TIMERS
 		U64 timer_end = getCPUClockCount64();
@@ -248,6 +287,16 @@ public:
 	static void writeLog(std::ostream& os);
 	static const NamedTimer* getTimerByName(const std::string& name);
 
+	// timings of all other threads that used a timer, collected by nextFrame()
+	static const thread_timings_list_t& getThreadTimings();
+
+	// record every timer of every thread during the next 'frames' frames, then write
+	// them as Chrome trace event JSON (chrome://tracing) to filename, unless it is empty
+	static void startTrace(S32 frames, const std::string& filename);
+	static bool isTracing() { return sTracing; }
+	// write whatever the last trace recorded
+	static void writeTrace(std::ostream& os);
+
 	struct CurTimerData
 	{
 		LLFastTimer*	mCurTimer;
@@ -259,13 +308,23 @@ public:
 	static std::string sClockType;
 
 private:
+	class ThreadTimers;
+
 	static U32 getCPUClockCount32();
 	static U64 getCPUClockCount64();
 
+	static bool inMainThread();
+	void startThreadTimer(NamedTimer& timer);
+	void stopThreadTimer();
+	static void collectThreadTimes();
+	static void traceMainThread(NamedTimer* timer, bool begin);
+	static void stopTrace();
+
 	static S32				sCurFrameIndex;
 	static S32				sLastFrameIndex;
 	static U64				sLastFrameTime;
 	static info_list_t*		sTimerInfos;
+	static bool				sTracing;
 
 	U32							mStartTime;
 	LLFastTimer::FrameState*	mFrameState;
@@ -135,6 +135,20 @@ int	LLFile::rename(const std::string& filename, const std::string& newname)
 #endif
 }
 
+int	LLFile::replace(const std::string& filename, const std::string& newname)
+{
+#if	LL_WINDOWS
+	std::string utf8filename = filename;
+	std::string utf8newname = newname;
+	llutf16string utf16filename = utf8str_to_utf16str(utf8filename);
+	llutf16string utf16newname = utf8str_to_utf16str(utf8newname);
+	return MoveFileExW(utf16filename.c_str(), utf16newname.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) ? 0 : -1;
+#else
+	// POSIX rename() already replaces an existing file atomically.
+	return ::rename(filename.c_str(),newname.c_str());
+#endif
+}
+
 int	LLFile::stat(const std::string& filename, llstat* filestatus)
 {
 #if LL_WINDOWS
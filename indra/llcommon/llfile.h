@@ -86,6 +86,9 @@ public:
 	static	int		rmdir(const std::string& filename);
 	static	int		remove(const std::string& filename);
 	static	int		rename(const std::string& filename,const std::string&	newname);
+	// Like rename(), but replaces newname if it exists, in one step: newname
+	// is either the old or the new file, even after a crash.
+	static	int		replace(const std::string& filename,const std::string&	newname);
 	static	int		stat(const std::string&	filename,llstat*	file_status);
 	static	bool	isdir(const std::string&	filename);
 	static	bool	isfile(const std::string&	filename);
@@ -0,0 +1,281 @@
+/**
+ * @file llopenhashmap.h
+ * @brief Open addressing hash map for UUID and 64 bit integer keys
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOPENHASHMAP_H
+#define LL_LLOPENHASHMAP_H
+
+#include <utility>
+#include <vector>
+
+#include "lluuid.h"
+
+// Hash functions for LLOpenHashMap. Keys made of a region or circuit index
+// and a local id differ in their low bits only, so every bit is mixed in
+// (the MurmurHash3 finalizer).
+template <typename KEY> struct LLOpenHash;
+
+template <> struct LLOpenHash<U64>
+{
+	static U64 hash(U64 key)
+	{
+		key ^= key >> 33;
+		key *= 0xff51afd7ed558ccdULL;
+		key ^= key >> 33;
+		key *= 0xc4ceb9fe1a85ec53ULL;
+		key ^= key >> 33;
+		return key;
+	}
+};
+
+template <> struct LLOpenHash<U32>
+{
+	static U64 hash(U32 key) { return LLOpenHash<U64>::hash(key); }
+};
+
+template <> struct LLOpenHash<LLUUID>
+{
+	static U64 hash(const LLUUID& id)
+	{
+		U64 low, high;
+		memcpy(&low, id.mData, sizeof(low));	/* Flawfinder: ignore */
+		memcpy(&high, id.mData + sizeof(low), sizeof(high));	/* Flawfinder: ignore */
+		return LLOpenHash<U64>::hash(low ^ (high * 0x9e3779b97f4a7c15ULL));
+	}
+};
+
+//
+// LLOpenHashMap
+//
+// A hash map with the interface of the std::map calls that LLViewerObjectList
+// makes (find, operator[], insert, erase, size, clear). The entries live in
+// one array, at most half full, and are found by linear probing: a lookup
+// usually reads one or two neighbouring slots instead of walking the nodes
+// of a tree. Erasing shifts the following entries back, so there are no
+// tombstones to slow lookups down.
+//
+// Unlike std::map, inserting or erasing invalidates all the iterators and
+// the order of iteration is arbitrary.
+//
+template <typename KEY, typename VALUE, typename HASH = LLOpenHash<KEY> >
+class LLOpenHashMap
+{
+public:
+	typedef KEY key_type;
+	typedef VALUE mapped_type;
+	typedef std::pair<KEY, VALUE> value_type;	// Don't change the key through an iterator.
+	typedef size_t size_type;
+
+	template <typename MAP, typename ENTRY>
+	class iterator_base
+	{
+	public:
+		iterator_base() : mMap(NULL), mIndex(0) { }
+		iterator_base(MAP* map, size_type index) : mMap(map), mIndex(index) { }
+		// iterator to const_iterator
+		template <typename OTHER_MAP, typename OTHER_ENTRY>
+		iterator_base(const iterator_base<OTHER_MAP, OTHER_ENTRY>& other) : mMap(other.getMap()), mIndex(other.getIndex()) { }
+
+		ENTRY& operator*() const	{ return mMap->mSlots[mIndex]; }
+		ENTRY* operator->() const	{ return &mMap->mSlots[mIndex]; }
+		iterator_base& operator++()	{ mIndex = mMap->nextUsed(mIndex + 1); return *this; }
+		iterator_base operator++(int)	{ iterator_base old = *this; ++*this; return old; }
+
+		bool operator==(const iterator_base& other) const { return mIndex == other.mIndex && mMap == other.mMap; }
+		bool operator!=(const iterator_base& other) const { return !(*this == other); }
+
+		MAP* getMap() const			{ return mMap; }
+		size_type getIndex() const	{ return mIndex; }
+
+	private:
+		MAP* mMap;
+		size_type mIndex;
+	};
+	typedef iterator_base<LLOpenHashMap, value_type> iterator;
+	typedef iterator_base<const LLOpenHashMap, const value_type> const_iterator;
+
+	LLOpenHashMap() : mSize(0) { }
+
+	iterator begin()				{ return iterator(this, nextUsed(0)); }
+	iterator end()					{ return iterator(this, mSlots.size()); }
+	const_iterator begin() const	{ return const_iterator(this, nextUsed(0)); }
+	const_iterator end() const		{ return const_iterator(this, mSlots.size()); }
+
+	size_type size() const			{ return mSize; }
+	bool empty() const				{ return !mSize; }
+	size_type capacity() const		{ return mSlots.size(); }
+
+	iterator find(const KEY& key)				{ return iterator(this, findIndex(key)); }
+	const_iterator find(const KEY& key) const	{ return const_iterator(this, findIndex(key)); }
+	size_type count(const KEY& key) const		{ return findIndex(key) != mSlots.size() ? 1 : 0; }
+
+	VALUE& operator[](const KEY& key)
+	{
+		return insert(value_type(key, VALUE())).first->second;
+	}
+
+	std::pair<iterator, bool> insert(const value_type& entry)
+	{
+		size_type index = findIndex(entry.first);
+		if (index != mSlots.size())
+		{
+			return std::make_pair(iterator(this, index), false);
+		}
+		if ((mSize + 1) * 2 > mSlots.size())
+		{
+			rehash(mSlots.empty() ? (size_type)MIN_CAPACITY : mSlots.size() * 2);
+		}
+		size_type mask = mSlots.size() - 1;
+		index = HASH::hash(entry.first) & mask;
+		while (mUsed[index])
+		{
+			index = (index + 1) & mask;
+		}
+		mSlots[index] = entry;
+		mUsed[index] = 1;
+		++mSize;
+		return std::make_pair(iterator(this, index), true);
+	}
+
+	size_type erase(const KEY& key)
+	{
+		size_type index = findIndex(key);
+		if (index == mSlots.size())
+		{
+			return 0;
+		}
+		eraseIndex(index);
+		return 1;
+	}
+
+	void erase(iterator iter)
+	{
+		eraseIndex(iter.getIndex());
+	}
+
+	void clear()
+	{
+		std::vector<value_type>().swap(mSlots);
+		std::vector<U8>().swap(mUsed);
+		mSize = 0;
+	}
+
+	// Makes room for count entries without growing again.
+	void reserve(size_type count)
+	{
+		size_type capacity = (size_type)MIN_CAPACITY;
+		while (capacity < count * 2)
+		{
+			capacity *= 2;
+		}
+		if (capacity > mSlots.size())
+		{
+			rehash(capacity);
+		}
+	}
+
+private:
+	enum { MIN_CAPACITY = 16 };
+
+	// Returns mSlots.size() when key is not in the map.
+	size_type findIndex(const KEY& key) const
+	{
+		if (!mSize)
+		{
+			return mSlots.size();
+		}
+		size_type mask = mSlots.size() - 1;
+		for (size_type index = HASH::hash(key) & mask; mUsed[index]; index = (index + 1) & mask)
+		{
+			if (mSlots[index].first == key)
+			{
+				return index;
+			}
+		}
+		return mSlots.size();
+	}
+
+	size_type nextUsed(size_type index) const
+	{
+		while (index < mSlots.size() && !mUsed[index])
+		{
+			++index;
+		}
+		return index;
+	}
+
+	void eraseIndex(size_type index)
+	{
+		// Move back every following entry of the run that may live in the hole.
+		size_type mask = mSlots.size() - 1;
+		for (size_type next = (index + 1) & mask; mUsed[next]; next = (next + 1) & mask)
+		{
+			size_type home = HASH::hash(mSlots[next].first) & mask;
+			if (((next - home) & mask) >= ((next - index) & mask))
+			{
+				mSlots[index] = mSlots[next];
+				index = next;
+			}
+		}
+		mSlots[index] = value_type();	// Releases what the value holds.
+		mUsed[index] = 0;
+		--mSize;
+	}
+
+	void rehash(size_type capacity)
+	{
+		std::vector<value_type> slots(capacity);
+		std::vector<U8> used(capacity, 0);
+		slots.swap(mSlots);
+		used.swap(mUsed);
+		size_type mask = capacity - 1;
+		for (size_type i = 0; i < slots.size(); ++i)
+		{
+			if (used[i])
+			{
+				size_type index = HASH::hash(slots[i].first) & mask;
+				while (mUsed[index])
+				{
+					index = (index + 1) & mask;
+				}
+				mSlots[index] = slots[i];
+				mUsed[index] = 1;
+			}
+		}
+	}
+
+private:
+	std::vector<value_type> mSlots;
+	std::vector<U8> mUsed;		// Parallel to mSlots, so probing reads one byte per slot.
+	size_type mSize;
+};
+
+#endif // LL_LLOPENHASHMAP_H
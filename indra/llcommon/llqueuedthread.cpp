@@ -37,15 +37,41 @@
 
 //============================================================================
 
+//static
+LLQueuedThread::queue_t LLQueuedThread::sDefaultQueueType = LLQueuedThread::QUEUE_SORTED;
+
 // MAIN THREAD
-LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool should_pause) :
+LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool should_pause, queue_t queue_type) :
 	LLThread(name),
 	mThreaded(threaded),
 	mIdleThread(TRUE),
 	mNextHandle(0),
-	mStarted(FALSE)
+	mStarted(FALSE),
+	mQueueType(queue_type == QUEUE_DEFAULT ? sDefaultQueueType : queue_type),
+	mRequestMutex(NULL),
+	mPoolSubsystem(NULL),
+	mPoolTasks(0),
+	mQueuedCount(0),
+	mBucketMask(0),
+	mLockFreeNextHandle(1),
+	mHandlesWrapped(FALSE)
 {
-	if (mThreaded)
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		mRequestMutex = new LLMutex;
+	}
+	LLWorkerPool* pool = LLWorkerPool::getInstance();
+	if (mThreaded && pool)
+	{
+		mPoolSubsystem = pool->getSubsystem(name);
+	}
+	if (mPoolSubsystem)
+	{
+		// No thread of our own; we're "running" as long as we accept requests.
+		// should_pause is ignored: pool tasks are only submitted when there is work.
+		mStatus = RUNNING;
+	}
+	else if (mThreaded)
 	{
 		if(should_pause)
 		{
@@ -59,11 +85,12 @@ LLQueuedThread::LLQueuedThread(const std::string& name, bool threaded, bool shou
 // MAIN THREAD
 LLQueuedThread::~LLQueuedThread()
 {
-	if (!mThreaded)
+	if (!mThreaded || mPoolSubsystem)
 	{
 		endThread();
 	}
 	shutdown();
+	delete mRequestMutex;
 	// ~LLThread() will be called here
 }
 
@@ -72,7 +99,24 @@ void LLQueuedThread::shutdown()
 	setQuitting();
 
 	unpause(); // MAIN THREAD
-	if (mThreaded)
+	if (mPoolSubsystem)
+	{
+		// Our pool tasks abort everything that is still queued now that we're quitting.
+		// A task that is still queued or running uses this object and our requests,
+		// so unlike our own thread we can't give up on them: keep waiting.
+		S32 timeout = 100;
+		while (mPoolTasks)
+		{
+			ms_sleep(100);
+			if (--timeout == 0)
+			{
+				llwarns << "~LLQueuedThread (" << mName << ") still waiting for " << (S32)mPoolTasks << " worker pool tasks!" << llendl;
+				timeout = 100;
+			}
+		}
+		mStatus = STOPPED;
+	}
+	else if (mThreaded)
 	{
 		S32 timeout = 100;
 		for ( ; timeout>0; timeout--)
@@ -94,6 +138,11 @@ void LLQueuedThread::shutdown()
 		mStatus = STOPPED;
 	}
 
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		// Requests still on mIngress aren't in mRequestHash yet.
+		drainIngress();
+	}
 	QueuedRequest* req;
 	S32 active_count = 0;
 	while ( (req = (QueuedRequest*)mRequestHash.pop_element()) )
@@ -109,6 +158,9 @@ void LLQueuedThread::shutdown()
 	{
 		llwarns << "~LLQueuedThread() called with active requests: " << active_count << llendl;
 	}
+	// All requests are deleted; drop the dangling pointers to them.
+	mRequestQueue.clear();
+	clearIngress();
 }
 
 //----------------------------------------------------------------------------
@@ -119,7 +171,7 @@ S32 LLQueuedThread::update(F32 max_time_ms)
 {
 	if (!mStarted)
 	{
-		if (!mThreaded)
+		if (!mThreaded || mPoolSubsystem)
 		{
 			startThread();
 			mStarted = TRUE;
@@ -135,7 +187,15 @@ S32 LLQueuedThread::updateQueue(F32 max_time_ms)
 	S32 pending = 1;
 
 	// Frame Update
-	if (mThreaded)
+	if (mPoolSubsystem)
+	{
+		pending = getPending();
+		if (pending > 0)
+		{
+			submitPoolTasks();
+		}
+	}
+	else if (mThreaded)
 	{
 		pending = getPending();
 		if(pending > 0)
@@ -158,7 +218,11 @@ S32 LLQueuedThread::updateQueue(F32 max_time_ms)
 void LLQueuedThread::incQueue()
 {
 	// Something has been added to the queue
-	if (!isPaused())
+	if (mPoolSubsystem)
+	{
+		submitPoolTasks();
+	}
+	else if (!isPaused())
 	{
 		if (mThreaded)
 		{
@@ -171,13 +235,46 @@ void LLQueuedThread::incQueue()
 // May be called from any thread
 S32 LLQueuedThread::getPending()
 {
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		return getQueuedCount();
+	}
 	S32 res;
 	lockData();
-	res = mRequestQueue.size();
+	res = getQueuedCount();
 	unlockData();
 	return res;
 }
 
+// May be called from any thread
+S32 LLQueuedThread::getQueuedCount() const
+{
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		return mQueuedCount;
+	}
+	return (S32)mRequestQueue.size();
+}
+
+// May be called from any thread
+void LLQueuedThread::getQueuedRequests(std::vector<QueuedRequest*>& requests)
+{
+	requests.clear();
+	lockRequests();
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		for (S32 bucket = PRIORITY_BUCKETS - 1; bucket >= 0; --bucket)
+		{
+			requests.insert(requests.end(), mBuckets[bucket].begin(), mBuckets[bucket].end());
+		}
+	}
+	else
+	{
+		requests.assign(mRequestQueue.begin(), mRequestQueue.end());
+	}
+	unlockRequests();
+}
+
 // MAIN thread
 void LLQueuedThread::waitOnPending()
 {
@@ -185,7 +282,7 @@ void LLQueuedThread::waitOnPending()
 	{
 		update(0);
 
-		if (mIdleThread)
+		if (mPoolSubsystem ? (mPoolTasks == 0 && getPending() == 0) : (bool)mIdleThread)
 		{
 			break;
 		}
@@ -200,6 +297,19 @@ void LLQueuedThread::waitOnPending()
 // MAIN thread
 void LLQueuedThread::printQueueStats()
 {
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		S32 pending = getQueuedCount();
+		if (pending)
+		{
+			llinfos << llformat("Pending Requests:%d", pending) << llendl;
+		}
+		else
+		{
+			llinfos << "Queued Thread Idle" << llendl;
+		}
+		return;
+	}
 	lockData();
 	if (!mRequestQueue.empty())
 	{
@@ -216,13 +326,31 @@ void LLQueuedThread::printQueueStats()
 // MAIN thread
 LLQueuedThread::handle_t LLQueuedThread::generateHandle()
 {
-	lockData();
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		// A handle can only still be in use after the counter wrapped around.
+		handle_t res = mLockFreeNextHandle++;
+		if (res != nullHandle() && !mHandlesWrapped)
+		{
+			return res;
+		}
+		mHandlesWrapped = TRUE;
+		lockRequests();
+		while ((res == nullHandle()) || (mRequestHash.find(res)))
+		{
+			res = mLockFreeNextHandle++;
+		}
+		unlockRequests();
+		return res;
+	}
+
+	lockRequests();
 	while ((mNextHandle == nullHandle()) || (mRequestHash.find(mNextHandle)))
 	{
 		mNextHandle++;
 	}
 	const LLQueuedThread::handle_t res = mNextHandle++;
-	unlockData();
+	unlockRequests();
 	return res;
 }
 
@@ -234,14 +362,25 @@ bool LLQueuedThread::addRequest(QueuedRequest* req)
 		return false;
 	}
 	
-	lockData();
+	if (mQueueType == QUEUE_LOCKFREE)
+	{
+		// Nobody else can see req until it is on mIngress.
+		req->setStatus(STATUS_QUEUED);
+		// Counted before it becomes visible to the worker, so the count never goes negative.
+		mQueuedCount++;
+		pushIngress(req);
+		incQueue();
+		return true;
+	}
+
+	lockRequests();
 	req->setStatus(STATUS_QUEUED);
 	mRequestQueue.insert(req);
 	mRequestHash.insert(req);
 #if _DEBUG
 // 	llinfos << llformat("LLQueuedThread::Added req [%08d]",handle) << llendl;
 #endif
-	unlockData();
+	unlockRequests();
 
 	incQueue();
 
@@ -258,7 +397,7 @@ bool LLQueuedThread::waitForResult(LLQueuedThread::handle_t handle, bool auto_co
 	while(!done)
 	{
 		update(0); // unpauses
-		lockData();
+		lockRequests();
 		QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
 		if (!req)
 		{
@@ -275,7 +414,7 @@ bool LLQueuedThread::waitForResult(LLQueuedThread::handle_t handle, bool auto_co
 			}
 			done = true;
 		}
-		unlockData();
+		unlockRequests();
 		
 		if (!done && mThreaded)
 		{
@@ -296,51 +435,51 @@ LLQueuedThread::QueuedRequest* LLQueuedThread::getRequest(handle_t handle)
 	{
 		return 0;
 	}
-	lockData();
+	lockRequests();
 	QueuedRequest* res = (QueuedRequest*)mRequestHash.find(handle);
-	unlockData();
+	unlockRequests();
 	return res;
 }
 
 LLQueuedThread::status_t LLQueuedThread::getRequestStatus(handle_t handle)
 {
 	status_t res = STATUS_EXPIRED;
-	lockData();
+	lockRequests();
 	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
 	if (req)
 	{
 		res = req->getStatus();
 	}
-	unlockData();
+	unlockRequests();
 	return res;
 }
 
 void LLQueuedThread::abortRequest(handle_t handle, bool autocomplete)
 {
-	lockData();
+	lockRequests();
 	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
 	if (req)
 	{
 		req->setFlags(FLAG_ABORT | (autocomplete ? FLAG_AUTO_COMPLETE : 0));
 	}
-	unlockData();
+	unlockRequests();
 }
 
 // MAIN thread
 void LLQueuedThread::setFlags(handle_t handle, U32 flags)
 {
-	lockData();
+	lockRequests();
 	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
 	if (req)
 	{
 		req->setFlags(flags);
 	}
-	unlockData();
+	unlockRequests();
 }
 
 void LLQueuedThread::setPriority(handle_t handle, U32 priority)
 {
-	lockData();
+	lockRequests();
 	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
 	if (req)
 	{
@@ -352,18 +491,18 @@ void LLQueuedThread::setPriority(handle_t handle, U32 priority)
 		else if(req->getStatus() == STATUS_QUEUED)
 		{
 			// remove from list then re-insert
-			llverify(mRequestQueue.erase(req) == 1);
+			queueErase(req);
 			req->setPriority(priority);
-			mRequestQueue.insert(req);
+			queueInsert(req);
 		}
 	}
-	unlockData();
+	unlockRequests();
 }
 
 bool LLQueuedThread::completeRequest(handle_t handle)
 {
 	bool res = false;
-	lockData();
+	lockRequests();
 	QueuedRequest* req = (QueuedRequest*)mRequestHash.find(handle);
 	if (req)
 	{
@@ -385,7 +524,7 @@ bool LLQueuedThread::completeRequest(handle_t handle)
  		}
 		res = true;
 	}
-	unlockData();
+	unlockRequests();
 	return res;
 }
 
@@ -413,19 +552,29 @@ bool LLQueuedThread::check()
 // Runs on its OWN thread
 
 S32 LLQueuedThread::processNextRequest()
+{
+	bool backoff;
+	S32 pending = processNextRequest(backoff);
+	if (backoff && mThreaded && !mPoolSubsystem)
+	{
+		ms_sleep(1); // sleep the thread a little
+	}
+	return pending;
+}
+
+S32 LLQueuedThread::processNextRequest(bool& backoff)
 {
 	QueuedRequest *req;
+	backoff = false;
 	// Get next request from pool
-	lockData();
+	lockRequests();
 	while(1)
 	{
-		req = NULL;
-		if (mRequestQueue.empty())
+		req = queuePop();
+		if (!req)
 		{
 			break;
 		}
-		req = *mRequestQueue.begin();
-		mRequestQueue.erase(mRequestQueue.begin());
 		if ((req->getFlags() & FLAG_ABORT) || (mStatus == QUITTING))
 		{
 			req->setStatus(STATUS_ABORTED);
@@ -455,18 +604,18 @@ S32 LLQueuedThread::processNextRequest()
 			// 8) LLQueuedThread::setPriority -- doesn't access req with status STATUS_ABORTED, STATUS_COMPLETE or STATUS_INPROGRESS.
 			// 9) LLQueuedThread::completeRequest -- now sets FLAG_AUTO_COMPLETE instead of deleting the req, if FLAG_LOCKED is set, so that deletion happens here when finishRequest returns.
 			req->setFlags(FLAG_LOCKED);
-			unlockData();
+			unlockRequests();
 			req->finishRequest(false);
-			lockData();
+			lockRequests();
 			req->resetFlags(FLAG_LOCKED);
 			if ((req->getFlags() & FLAG_AUTO_COMPLETE))
 			{
 				req->resetFlags(FLAG_AUTO_COMPLETE);
 				mRequestHash.erase(req);
 // 				check();
-				unlockData();
+				unlockRequests();
 				req->deleteRequest();
-				lockData();
+				lockRequests();
 			}
 			continue;
 		}
@@ -479,7 +628,7 @@ S32 LLQueuedThread::processNextRequest()
 		req->setStatus(STATUS_INPROGRESS);
 		start_priority = req->getPriority();
 	}
-	unlockData();
+	unlockRequests();
 
 	// This is the only place we will call req->setStatus() after
 	// it has initially been seet to STATUS_QUEUED, so it is
@@ -491,19 +640,19 @@ S32 LLQueuedThread::processNextRequest()
 
 		if (complete)
 		{
-			lockData();
+			lockRequests();
 			req->setStatus(STATUS_COMPLETE);
 			req->setFlags(FLAG_LOCKED);
-			unlockData();
+			unlockRequests();
 			req->finishRequest(true);
 			if ((req->getFlags() & FLAG_AUTO_COMPLETE))
 			{
-				lockData();
+				lockRequests();
 				req->resetFlags(FLAG_AUTO_COMPLETE);
 				mRequestHash.erase(req);
 // 				check();
 				req->resetFlags(FLAG_LOCKED);
-				unlockData();
+				unlockRequests();
 				req->deleteRequest();
 			}
 			else
@@ -513,14 +662,11 @@ S32 LLQueuedThread::processNextRequest()
 		}
 		else
 		{
-			lockData();
+			lockRequests();
 			req->setStatus(STATUS_QUEUED);
-			mRequestQueue.insert(req);
-			unlockData();
-			if (mThreaded && start_priority < PRIORITY_NORMAL)
-			{
-				ms_sleep(1); // sleep the thread a little
-			}
+			queueInsert(req);
+			unlockRequests();
+			backoff = start_priority < PRIORITY_NORMAL;
 		}
 	}
 
@@ -533,7 +679,7 @@ S32 LLQueuedThread::processNextRequest()
 bool LLQueuedThread::runCondition()
 {
 	// mRunCondition must be locked here
-	if (mRequestQueue.empty() && mIdleThread)
+	if (getQueuedCount() == 0 && mIdleThread)
 		return false;
 	else
 		return true;
@@ -573,6 +719,163 @@ void LLQueuedThread::run()
 	llinfos << "LLQueuedThread " << mName << " EXITING." << llendl;
 }
 
+//----------------------------------------------------------------------------
+// Worker pool
+
+// Processes one request per run; stays in the pool while there is more work.
+// When a low priority request had to be put back unfinished, the task leaves
+// the pool instead of spinning on it; updateQueue() submits a new one.
+class LLQueuedThread::PoolTask : public LLWorkerPool::Task
+{
+public:
+	PoolTask(LLQueuedThread* thread) :
+		LLWorkerPool::Task(thread->mPoolSubsystem),
+		mThread(thread)
+	{
+		mThread->mPoolTasks++;
+	}
+	/*virtual*/ ~PoolTask()
+	{
+		--mThread->mPoolTasks;
+	}
+
+	/*virtual*/ bool run()
+	{
+		bool backoff;
+		S32 pending = mThread->processNextRequest(backoff);
+		return pending > 0 && !backoff;
+	}
+
+private:
+	LLQueuedThread* mThread;
+};
+
+// Any thread. Submits tasks until every pending request has one, or the subsystem is at its maximum.
+void LLQueuedThread::submitPoolTasks()
+{
+	LLWorkerPool* pool = LLWorkerPool::getInstance();
+	S32 wanted = getPending() - mPoolTasks;
+	while (wanted-- > 0)
+	{
+		PoolTask* task = new PoolTask(this);
+		if (!pool->submit(task))
+		{
+			delete task;
+			break;
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Request queue
+
+void LLQueuedThread::queueInsert(QueuedRequest* req)
+{
+	if (mQueueType != QUEUE_LOCKFREE)
+	{
+		mRequestQueue.insert(req);
+		return;
+	}
+	// Priorities with bit 31 set (not used by any of the priority_t values) end up in the top bucket too.
+	S32 bucket = llmin((S32)(req->getPriority() >> 28), (S32)PRIORITY_BUCKETS - 1);
+	mBuckets[bucket].insert(req);
+	mBucketMask |= 1 << bucket;
+	req->mBucket = bucket;
+	mQueuedCount++;
+}
+
+void LLQueuedThread::queueErase(QueuedRequest* req)
+{
+	if (mQueueType != QUEUE_LOCKFREE)
+	{
+		llverify(mRequestQueue.erase(req) == 1);
+		return;
+	}
+	request_queue_t& queue = mBuckets[req->mBucket];
+	llverify(queue.erase(req) == 1);
+	if (queue.empty())
+	{
+		mBucketMask &= ~(1 << req->mBucket);
+	}
+	req->mBucket = -1;
+	--mQueuedCount;
+}
+
+LLQueuedThread::QueuedRequest* LLQueuedThread::queuePop()
+{
+	if (mQueueType != QUEUE_LOCKFREE)
+	{
+		if (mRequestQueue.empty())
+		{
+			return NULL;
+		}
+		QueuedRequest* req = *mRequestQueue.begin();
+		mRequestQueue.erase(mRequestQueue.begin());
+		return req;
+	}
+	if (!mBucketMask)
+	{
+		return NULL;
+	}
+	S32 bucket = PRIORITY_BUCKETS - 1;
+	while (!(mBucketMask & (1 << bucket)))
+	{
+		--bucket;
+	}
+	request_queue_t& queue = mBuckets[bucket];
+	QueuedRequest* req = *queue.begin();
+	queue.erase(queue.begin());
+	if (queue.empty())
+	{
+		mBucketMask &= ~(1 << bucket);
+	}
+	req->mBucket = -1;
+	--mQueuedCount;
+	return req;
+}
+
+// Any thread. A plain Treiber stack push: drainIngress() takes the whole
+// list at once with exchange(), so there is no ABA problem.
+void LLQueuedThread::pushIngress(QueuedRequest* req)
+{
+	QueuedRequest* head;
+	do
+	{
+		head = mIngress;
+		req->mIngressNext = head;
+	}
+	while (mIngress.compareAndSwap(req, head) != head);
+}
+
+// Any thread, with mRequestMutex locked.
+void LLQueuedThread::drainIngress()
+{
+	QueuedRequest* req = mIngress.exchange(NULL);
+	while (req)
+	{
+		QueuedRequest* next = req->mIngressNext;
+		req->mIngressNext = NULL;
+		mRequestHash.insert(req);
+		// Already counted by addRequest().
+		--mQueuedCount;
+		queueInsert(req);
+		req = next;
+	}
+}
+
+void LLQueuedThread::clearIngress()
+{
+	mIngress.exchange(NULL);
+	for (S32 i = 0; i < PRIORITY_BUCKETS; ++i)
+	{
+		mBuckets[i].clear();
+	}
+	mBucketMask = 0;
+	mQueuedCount = 0;
+}
+
+//----------------------------------------------------------------------------
+
 // virtual
 void LLQueuedThread::startThread()
 {
@@ -594,7 +897,9 @@ LLQueuedThread::QueuedRequest::QueuedRequest(LLQueuedThread::handle_t handle, U3
 	LLSimpleHashEntry<LLQueuedThread::handle_t>(handle),
 	mStatus(STATUS_UNKNOWN),
 	mPriority(priority),
-	mFlags(flags)
+	mFlags(flags),
+	mIngressNext(NULL),
+	mBucket(-1)
 {
 }
 
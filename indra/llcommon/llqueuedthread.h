@@ -37,11 +37,14 @@
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
 
 #include "llapr.h"
+#include "llatomic.h"
 
 #include "llthread.h"
 #include "llsimplehash.h"
+#include "llworkerpool.h"
 
 //============================================================================
 // Note: ~LLQueuedThread is O(N) N=# of queued requests, assumed to be small
@@ -75,6 +78,11 @@ public:
 		FLAG_ABORT = 4,
 		FLAG_LOCKED = 8
 	};
+	enum queue_t {
+		QUEUE_DEFAULT = -1,		// Use the type set with setDefaultQueueType().
+		QUEUE_SORTED = 0,		// One std::set sorted on priority, protected by the thread's mutex.
+		QUEUE_LOCKFREE = 1		// Priority buckets fed by a lock-free multi-producer stack (see mIngress).
+	};
 
 	typedef U32 handle_t;
 	
@@ -143,6 +151,11 @@ public:
 		LLAtomic32<status_t> mStatus;
 		U32 mPriority;
 		U32 mFlags;
+
+	private:
+		// Only used by QUEUE_LOCKFREE.
+		QueuedRequest* mIngressNext;	// Link in LLQueuedThread::mIngress.
+		S32 mBucket;					// Index of the priority bucket we're in, or -1. Only accessed with the request lock held.
 	};
 
 protected:
@@ -160,9 +173,16 @@ public:
 	static handle_t nullHandle() { return handle_t(0); }
 	
 public:
-	LLQueuedThread(const std::string& name, bool threaded = true, bool should_pause = false);
+	LLQueuedThread(const std::string& name, bool threaded = true, bool should_pause = false, queue_t queue_type = QUEUE_DEFAULT);
 	virtual ~LLQueuedThread();	
 	virtual void shutdown();
+
+	// Queue type used by threads that are created with QUEUE_DEFAULT.
+	static void setDefaultQueueType(queue_t queue_type) { sDefaultQueueType = queue_type; }
+	static queue_t getDefaultQueueType() { return sDefaultQueueType; }
+	queue_t getQueueType() const { return mQueueType; }
+	// True when requests are processed by LLWorkerPool instead of our own thread.
+	bool usesWorkerPool() const { return mPoolSubsystem != NULL; }
 	
 private:
 	// No copy constructor or copy assignment
@@ -181,6 +201,36 @@ protected:
 	S32  processNextRequest(void);
 	void incQueue();
 
+	// Number of requests that are waiting to be processed.
+	// For QUEUE_SORTED the caller must hold the lock on mRunCondition (lockData()).
+	S32 getQueuedCount() const;
+	// Debug: returns the requests that are waiting to be processed, highest priority first.
+	void getQueuedRequests(std::vector<QueuedRequest*>& requests);
+
+private:
+	// Protects mRequestHash and the status and flags of requests.
+	// This is mRunCondition for QUEUE_SORTED, which also protects mRequestQueue.
+	// For QUEUE_LOCKFREE it also moves the requests added since into mRequestHash and mBuckets.
+	void lockRequests() { if (mRequestMutex) { mRequestMutex->lock(); drainIngress(); } else lockData(); }
+	void unlockRequests() { if (mRequestMutex) mRequestMutex->unlock(); else unlockData(); }
+
+	// Sets backoff when an unfinished request below PRIORITY_NORMAL was queued again.
+	S32 processNextRequest(bool& backoff);
+
+	// Queue operations; call with lockRequests() held.
+	void queueInsert(QueuedRequest* req);
+	void queueErase(QueuedRequest* req);
+	QueuedRequest* queuePop();
+
+	// LLWorkerPool support.
+	class PoolTask;
+	void submitPoolTasks();
+
+	// QUEUE_LOCKFREE only.
+	void pushIngress(QueuedRequest* req);
+	void drainIngress();		// Call with mRequestMutex locked.
+	void clearIngress();
+
 public:
 	bool waitForResult(handle_t handle, bool auto_complete = true);
 
@@ -212,13 +262,37 @@ protected:
 	LLAtomic32<BOOL> mIdleThread; // request queue is empty (or we are quitting) and the thread is idle
 	
 	typedef std::set<QueuedRequest*, queued_request_less> request_queue_t;
-	request_queue_t mRequestQueue;
+	request_queue_t mRequestQueue;	// QUEUE_SORTED only; use getQueuedCount() and getQueuedRequests() instead.
 
 	enum { REQUEST_HASH_SIZE = 512 }; // must be power of 2
 	typedef LLSimpleHash<handle_t, REQUEST_HASH_SIZE> request_hash_t;
 	request_hash_t mRequestHash;
 
 	handle_t mNextHandle;
+
+private:
+	static queue_t sDefaultQueueType;
+	queue_t mQueueType;
+	LLMutex* mRequestMutex;						// Non-NULL for QUEUE_LOCKFREE.
+
+	// If the worker pool has a subsystem with our name (when we were created), requests are
+	// processed by up to getMaxConcurrency() pool threads at the same time instead of by our thread.
+	LLWorkerPool::Subsystem* mPoolSubsystem;
+	LLAtomicS32 mPoolTasks;						// Number of our tasks in the pool.
+
+	// QUEUE_LOCKFREE: generateHandle() and addRequest() don't lock; requests are
+	// pushed on mIngress and moved into mRequestHash and mBuckets by whoever
+	// takes the request lock next (see lockRequests()), usually the consumer
+	// looking for work. Everything that looks a request up by its handle takes
+	// that lock, so it never misses a request that was added before.
+	// Bucket N holds the priorities with the upper nibble N, sorted like mRequestQueue.
+	enum { PRIORITY_BUCKETS = 8 };
+	LLAtomicPointer<QueuedRequest> mIngress;
+	LLAtomicS32 mQueuedCount;					// Requests in mIngress plus mBuckets.
+	LLAtomicU32 mLockFreeNextHandle;
+	LLAtomic32<BOOL> mHandlesWrapped;			// Once set, new handles are checked against mRequestHash.
+	request_queue_t mBuckets[PRIORITY_BUCKETS];
+	U32 mBucketMask;							// Bit N is set when mBuckets[N] is not empty.
 };
 
 #endif // LL_LLQUEUEDTHREAD_H
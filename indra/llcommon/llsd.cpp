@@ -33,9 +33,18 @@
 #include "linden_common.h"
 #include "llsd.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#ifdef LL_DARWIN
+#include <pthread.h>
+#endif
+
+#include "llatomic.h"
 #include "llerror.h"
 #include "../llmath/llmath.h"
 #include "llformat.h"
+#include "llsdcompact.h"
 #include "llsdserialize.h"
 
 #ifndef LL_RELEASE_FOR_DOWNLOAD
@@ -56,6 +65,77 @@ namespace
 using namespace LLSDUnnamedNamespace;
 #endif
 
+class LLSDArena
+	/**< Bump allocator for the values of one compact document, see llsdcompact.h.
+		 Every value allocated from it holds a reference, so it is freed when
+		 the last value of the document is destroyed; by whatever thread.
+	*/
+{
+public:
+	LLSDArena();
+
+	void* allocate(size_t size);
+
+	void addRef()								{ mRefCount++; }
+	void release()								{ if (!--mRefCount) delete this; }
+
+	size_t getBytesUsed() const					{ return mBytesUsed; }
+	// Unique for the life time of the process, unlike the address.
+	U32 getSerial() const						{ return mSerial; }
+
+	// The arena that values created by this thread are allocated from, if any.
+	// Skips the thread local lookup while no thread has an arena.
+	static LLSDArena* getActive()				{ return sScopes ? getCurrent() : NULL; }
+	static LLAtomicS32 sScopes;					// Number of LLSDArenaScopes.
+#ifdef LL_DARWIN
+	// Darwin does not support thread-local data, see llpreprocessor.h.
+	static LLSDArena* getCurrent()				{ return (LLSDArena*)pthread_getspecific(getCurrentKey()); }
+	static void setCurrent(LLSDArena* arena)	{ pthread_setspecific(getCurrentKey(), arena); }
+#else
+	static LLSDArena* getCurrent()				{ return sCurrent; }
+	static void setCurrent(LLSDArena* arena)	{ sCurrent = arena; }
+#endif
+
+private:
+	~LLSDArena();
+
+	enum
+	{
+		FIRST_CHUNK_SIZE = 1024,
+		MAX_CHUNK_SIZE = 64 * 1024,
+		ALIGNMENT = 8
+	};
+
+	struct Chunk
+	{
+		Chunk* mNext;
+		size_t mSize;
+		// Followed by mSize bytes of data.
+	};
+
+	LLAtomicU32 mRefCount;
+	U32 mSerial;
+	Chunk* mChunks;
+	char* mFree;
+	size_t mLeft;
+	size_t mBytesUsed;
+	size_t mNextChunkSize;
+
+	static LLAtomicU32 sNextSerial;
+#ifdef LL_DARWIN
+	static pthread_key_t getCurrentKey();
+#else
+	static ll_thread_local LLSDArena* sCurrent;
+#endif
+};
+
+struct LLSDCompactKey
+{
+	U32 mLength;
+	U32 mHash;
+	char mString[1];	// mLength characters plus a terminating null.
+};
+
 class LLSD::Impl
 	/**< This class is the abstract base class of the implementation of LLSD
 		 It provides the reference counting implementation, and the default
@@ -79,8 +159,25 @@ protected:
 	virtual ~Impl();
 	
 	bool shared() const							{ return mUseCount > 1; }
+
+	static void destroy(Impl* impl);
 	
 public:
+	static void* operator new(size_t size);
+	static void operator delete(void* p);
+		///< allocate from the current arena of this thread, if any; the block
+		//   starts with a header that says which arena, so that neither the
+		//   constructor nor operator delete has to look it up again
+		
+	struct Extra
+	{
+		explicit Extra(size_t bytes) : mBytes(bytes) { }
+		size_t mBytes;
+	};
+	static void* operator new(size_t size, const Extra& extra)	{ return Impl::operator new(size + extra.mBytes); }
+	static void operator delete(void* p, const Extra&)			{ Impl::operator delete(p); }
+		///< for subclasses with variable sized data following the object
+
 	static void reset(Impl*& var, Impl* impl);
 		///< safely set var to refer to the new impl (possibly shared)
 		
@@ -92,6 +189,9 @@ public:
 	virtual ImplMap& makeMap(Impl*& var);
 	virtual ImplArray& makeArray(Impl*& var);
 		///< sure var is a modifiable, non-shared map or array
+
+	virtual LLSD& makeRef(Impl*& var, const String& k);
+		///< modifiable value of key k; makes var a modifiable map if needed
 	
 	virtual LLSD::Type type() const				{ return LLSD::TypeUndefined; }
 	
@@ -260,10 +360,10 @@ namespace
 		return (int)asReal();
 	}
 	
-	LLSD::Real		ImplString::asReal() const
+	LLSD::Real string_to_real(const LLSD::String& value)
 	{
 		F64 v = 0.0;
-		std::istringstream i_stream(mValue);
+		std::istringstream i_stream(value);
 		i_stream >> v;
 
 		// we would probably like to ignore all trailing whitespace as
@@ -275,6 +375,55 @@ namespace
 		int c = i_stream.get();
 		return ((EOF ==c) ? v : 0.0);
 	}
+
+	LLSD::Real		ImplString::asReal() const
+	{
+		return string_to_real(mValue);
+	}
+
+
+	class ImplCompactString : public LLSD::Impl
+		///< A string of a compact document (see llsdcompact.h), with the
+		//   characters following the object in memory.
+	{
+	public:
+		ImplCompactString(const LLSD::String& v)
+			: mLength(v.size()), mCapacity(v.size())
+			{ memcpy(data(), v.data(), mLength); }
+
+		virtual LLSD::Type type() const { return LLSD::TypeString; }
+
+		using LLSD::Impl::assign;
+		virtual void assign(LLSD::Impl*& var, const LLSD::String& v);
+
+		virtual LLSD::Boolean	asBoolean() const	{ return mLength != 0; }
+		virtual LLSD::Integer	asInteger() const	{ return (int)asReal(); }
+		virtual LLSD::Real		asReal() const		{ return string_to_real(asString()); }
+		virtual LLSD::String	asString() const	{ return LLSD::String(data(), mLength); }
+		virtual LLSD::UUID		asUUID() const		{ return LLUUID(asString()); }
+		virtual LLSD::Date		asDate() const		{ return LLDate(asString()); }
+		virtual LLSD::URI		asURI() const		{ return LLURI(asString()); }
+
+	private:
+		char* data() { return reinterpret_cast<char*>(this + 1); }
+		const char* data() const { return reinterpret_cast<const char*>(this + 1); }
+
+		U32 mLength;
+		U32 mCapacity;
+	};
+
+	void ImplCompactString::assign(LLSD::Impl*& var, const LLSD::String& v)
+	{
+		if (shared() || v.size() > mCapacity)
+		{
+			Impl::assign(var, v);
+		}
+		else
+		{
+			mLength = v.size();
+			memcpy(data(), v.data(), mLength);
+		}
+	}
 	
 
 	class ImplUUID
@@ -420,6 +569,195 @@ namespace
 		return i->second;
 	}
 
+
+	class ImplFlatMap : public LLSD::Impl
+		///< A map of a compact document (see llsdcompact.h): the entries
+		//   follow the object in memory, sorted on their interned key.
+		//   Keys can't be added or removed; that turns it into an ImplMap.
+	{
+	public:
+		struct Entry
+		{
+			const LLSDCompactKey* mKey;
+			LLSD mValue;
+		};
+
+		static Extra extraBytes(S32 size) { return Extra(size * sizeof(Entry)); }
+
+		// Allocate with new (extraBytes(size)). The keys must be allocated from key_arena.
+		ImplFlatMap(S32 size, LLSDArena* key_arena);
+		virtual ~ImplFlatMap();
+
+		Entry* entries() { return reinterpret_cast<Entry*>(this + 1); }
+		const Entry* entries() const { return reinterpret_cast<const Entry*>(this + 1); }
+
+		virtual ImplMap& makeMap(LLSD::Impl*&);
+		virtual LLSD& makeRef(LLSD::Impl*& var, const LLSD::String& k);
+
+		virtual LLSD::Type type() const { return LLSD::TypeMap; }
+
+		virtual LLSD::Boolean asBoolean() const { return mSize != 0; }
+
+		virtual bool has(const LLSD::String& k) const { return find(k) != NULL; }
+
+		using LLSD::Impl::get; // Unhiding get(LLSD::Integer)
+		using LLSD::Impl::ref; // Unhiding ref(LLSD::Integer)
+		virtual LLSD get(const LLSD::String&) const;
+		virtual const LLSD& ref(const LLSD::String&) const;
+
+		virtual int size() const { return mSize; }
+
+		virtual LLSD::map_const_iterator beginMap() const { return expanded().begin(); }
+		virtual LLSD::map_const_iterator endMap() const { return expanded().end(); }
+
+	private:
+		const Entry* find(const LLSD::String& k) const;
+		const std::map<LLSD::String, LLSD>& expanded() const;
+
+		S32 mSize;
+		LLSDArena* mKeyArena;
+		// Copy for const iteration, made on demand and kept while we live, so that
+		// changing a value doesn't invalidate iterators. The keys never change.
+		mutable std::map<LLSD::String, LLSD>* mExpanded;
+		mutable bool mExpandedStale;	// A value may have changed since the copy.
+	};
+
+	// Same order as std::string::compare.
+	int compare_key(const LLSDCompactKey* key, const char* str, size_t len)
+	{
+		int result = memcmp(key->mString, str, llmin((size_t)key->mLength, len));
+		if (result == 0)
+		{
+			result = key->mLength < len ? -1 : (key->mLength > len ? 1 : 0);
+		}
+		return result;
+	}
+
+	ImplFlatMap::ImplFlatMap(S32 size, LLSDArena* key_arena)
+		: mSize(size), mKeyArena(key_arena), mExpanded(NULL), mExpandedStale(false)
+	{
+		mKeyArena->addRef();
+		Entry* entry = entries();
+		for (S32 i = 0; i < mSize; ++i)
+		{
+			new (entry + i) Entry;
+		}
+	}
+
+	ImplFlatMap::~ImplFlatMap()
+	{
+		delete mExpanded;
+		Entry* entry = entries();
+		for (S32 i = 0; i < mSize; ++i)
+		{
+			entry[i].~Entry();
+		}
+		mKeyArena->release();
+	}
+
+	ImplMap& ImplFlatMap::makeMap(LLSD::Impl*& var)
+	{
+		ImplMap* i = new ImplMap;
+		const Entry* entry = entries();
+		for (S32 n = 0; n < mSize; ++n, ++entry)
+		{
+			i->insert(LLSD::String(entry->mKey->mString, entry->mKey->mLength), entry->mValue);
+		}
+		Impl::assign(var, i);
+		return *i;
+	}
+
+	LLSD& ImplFlatMap::makeRef(LLSD::Impl*& var, const LLSD::String& k)
+	{
+		const Entry* entry = find(k);
+		if (!entry)
+		{
+			// Adding a key.
+			return makeMap(var).ref(k);
+		}
+		ImplFlatMap* self = this;
+		if (shared())
+		{
+			// Copy on write, which is still much cheaper than converting to an ImplMap.
+			self = new (extraBytes(mSize)) ImplFlatMap(mSize, mKeyArena);
+			for (S32 n = 0; n < mSize; ++n)
+			{
+				self->entries()[n].mKey = entries()[n].mKey;
+				self->entries()[n].mValue = entries()[n].mValue;
+			}
+			entry = self->entries() + (entry - entries());
+			Impl::assign(var, self);
+		}
+		else
+		{
+			// The caller may change the value; refreshed by the next beginMap().
+			mExpandedStale = true;
+		}
+		return const_cast<Entry*>(entry)->mValue;
+	}
+
+	const ImplFlatMap::Entry* ImplFlatMap::find(const LLSD::String& k) const
+	{
+		const Entry* first = entries();
+		S32 count = mSize;
+		while (count > 0)
+		{
+			S32 half = count >> 1;
+			const Entry* middle = first + half;
+			if (compare_key(middle->mKey, k.data(), k.size()) < 0)
+			{
+				first = middle + 1;
+				count -= half + 1;
+			}
+			else
+			{
+				count = half;
+			}
+		}
+		if (first == entries() + mSize || compare_key(first->mKey, k.data(), k.size()) != 0)
+		{
+			return NULL;
+		}
+		return first;
+	}
+
+	LLSD ImplFlatMap::get(const LLSD::String& k) const
+	{
+		const Entry* entry = find(k);
+		return entry ? entry->mValue : LLSD();
+	}
+
+	const LLSD& ImplFlatMap::ref(const LLSD::String& k) const
+	{
+		const Entry* entry = find(k);
+		return entry ? entry->mValue : undef();
+	}
+
+	const std::map<LLSD::String, LLSD>& ImplFlatMap::expanded() const
+	{
+		if (!mExpanded)
+		{
+			mExpanded = new std::map<LLSD::String, LLSD>;
+			const Entry* entry = entries();
+			for (S32 n = 0; n < mSize; ++n, ++entry)
+			{
+				mExpanded->insert(mExpanded->end(),
+					std::make_pair(LLSD::String(entry->mKey->mString, entry->mKey->mLength), entry->mValue));
+			}
+		}
+		else if (mExpandedStale)
+		{
+			// Same keys in the same order: update the values in place.
+			const Entry* entry = entries();
+			for (std::map<LLSD::String, LLSD>::iterator iter = mExpanded->begin(); iter != mExpanded->end(); ++iter, ++entry)
+			{
+				iter->second = entry->mValue;
+			}
+		}
+		mExpandedStale = false;
+		return *mExpanded;
+	}
+
 	class ImplArray : public LLSD::Impl
 	{
 	private:
@@ -573,11 +911,52 @@ void LLSD::Impl::reset(Impl*& var, Impl* impl)
 	if (impl) ++impl->mUseCount;
 	if (var  &&  --var->mUseCount == 0)
 	{
-		delete var;
+		destroy(var);
 	}
 	var = impl;
 }
 
+void LLSD::Impl::destroy(Impl* impl)
+{
+	delete impl;
+}
+
+// Every block starts with the arena it was allocated from, or NULL for the
+// heap; 8 bytes, to keep the alignment of the arena.
+const size_t IMPL_HEADER_SIZE = 8;
+
+void* LLSD::Impl::operator new(size_t size)
+{
+	LLSDArena* arena = LLSDArena::getActive();
+	char* block;
+	if (arena)
+	{
+		block = (char*)arena->allocate(IMPL_HEADER_SIZE + size);
+		arena->addRef();
+	}
+	else
+	{
+		block = (char*)::operator new(IMPL_HEADER_SIZE + size);
+	}
+	*(LLSDArena**)block = arena;
+	return block + IMPL_HEADER_SIZE;
+}
+
+void LLSD::Impl::operator delete(void* p)
+{
+	char* block = (char*)p - IMPL_HEADER_SIZE;
+	LLSDArena* arena = *(LLSDArena**)block;
+	if (arena)
+	{
+		// The memory goes with the arena.
+		arena->release();
+	}
+	else
+	{
+		::operator delete(block);
+	}
+}
+
 LLSD::Impl& LLSD::Impl::safe(Impl* impl)
 {
 	static Impl theUndefined(STATIC);
@@ -604,6 +983,11 @@ ImplArray& LLSD::Impl::makeArray(Impl*& var)
 	return *ia;
 }
 
+LLSD& LLSD::Impl::makeRef(Impl*& var, const String& k)
+{
+	return makeMap(var).ref(k);
+}
+
 
 void LLSD::Impl::assign(Impl*& var, const Impl* other)
 {
@@ -632,7 +1016,14 @@ void LLSD::Impl::assign(Impl*& var, LLSD::Real v)
 
 void LLSD::Impl::assign(Impl*& var, const LLSD::String& v)
 {
-	reset(var, new ImplString(v));
+	if (LLSDArena::getActive() && v.size() <= LLSD_COMPACT_STRING_MAX)
+	{
+		reset(var, new (Extra(v.size())) ImplCompactString(v));
+	}
+	else
+	{
+		reset(var, new ImplString(v));
+	}
 }
 
 void LLSD::Impl::assign(Impl*& var, const LLSD::UUID& v)
@@ -759,7 +1150,7 @@ LLSD& LLSD::with(const String& k, const LLSD& v)
 void LLSD::erase(const String& k)		{ makeMap(impl).erase(k); }
 
 LLSD&		LLSD::operator[](const String& k)
-										{ return makeMap(impl).ref(k); }
+										{ return safe(impl).makeRef(impl, k); }
 const LLSD& LLSD::operator[](const String& k) const
 										{ return safe(impl).ref(k); }
 
@@ -846,3 +1237,253 @@ LLSD::array_iterator		LLSD::beginArray()		{ return makeArray(impl).beginArray();
 LLSD::array_iterator		LLSD::endArray()		{ return makeArray(impl).endArray(); }
 LLSD::array_const_iterator	LLSD::beginArray() const{ return safe(impl).beginArray(); }
 LLSD::array_const_iterator	LLSD::endArray() const	{ return safe(impl).endArray(); }
+
+//============================================================================
+// Compact documents, see llsdcompact.h.
+
+LLAtomicU32 LLSDArena::sNextSerial(1);
+LLAtomicS32 LLSDArena::sScopes(0);
+#ifdef LL_DARWIN
+namespace
+{
+	pthread_key_t sCurrentArenaKey;
+	pthread_once_t sCurrentArenaKeyOnce = PTHREAD_ONCE_INIT;
+
+	void create_current_arena_key()
+	{
+		pthread_key_create(&sCurrentArenaKey, NULL);
+	}
+}
+
+//static
+pthread_key_t LLSDArena::getCurrentKey()
+{
+	pthread_once(&sCurrentArenaKeyOnce, create_current_arena_key);
+	return sCurrentArenaKey;
+}
+#else
+ll_thread_local LLSDArena* LLSDArena::sCurrent;
+#endif
+
+LLSDArena::LLSDArena()
+	: mRefCount(1), mSerial(sNextSerial++), mChunks(NULL), mFree(NULL), mLeft(0), mBytesUsed(0),
+	  mNextChunkSize(FIRST_CHUNK_SIZE)
+{
+}
+
+LLSDArena::~LLSDArena()
+{
+	while (mChunks)
+	{
+		Chunk* next = mChunks->mNext;
+		::operator delete(mChunks);
+		mChunks = next;
+	}
+}
+
+void* LLSDArena::allocate(size_t size)
+{
+	size = (size + ALIGNMENT - 1) & ~(size_t)(ALIGNMENT - 1);
+	if (size > mLeft)
+	{
+		size_t chunk_size = llmax(mNextChunkSize, size);
+		Chunk* chunk = (Chunk*)::operator new(sizeof(Chunk) + chunk_size);
+		chunk->mNext = mChunks;
+		chunk->mSize = chunk_size;
+		mChunks = chunk;
+		mFree = (char*)(chunk + 1);
+		mLeft = chunk_size;
+		mNextChunkSize = llmin(mNextChunkSize * 2, (size_t)MAX_CHUNK_SIZE);
+	}
+	void* p = mFree;
+	mFree += size;
+	mLeft -= size;
+	mBytesUsed += size;
+	return p;
+}
+
+LLSDArenaScope::LLSDArenaScope()
+	: mArena(new LLSDArena), mPrevious(LLSDArena::getCurrent())
+{
+	LLSDArena::sScopes++;
+	LLSDArena::setCurrent(mArena);
+}
+
+LLSDArenaScope::~LLSDArenaScope()
+{
+	LLSDArena::setCurrent(mPrevious);
+	--LLSDArena::sScopes;
+	mArena->release();
+}
+
+size_t LLSDArenaScope::getBytesUsed() const
+{
+	return mArena->getBytesUsed();
+}
+
+LLSDMapBuilder::LLSDMapBuilder()
+	: mKeyCount(0), mGeneration(1), mKeySerial(0)
+{
+}
+
+LLSDMapBuilder::~LLSDMapBuilder()
+{
+}
+
+void LLSDMapBuilder::reset()
+{
+	mEntries.clear();
+	mMarks.clear();
+	mKeySerial = 0;
+}
+
+void LLSDMapBuilder::beginMap()
+{
+	LLSDArena* arena = LLSDArena::getCurrent();
+	llassert_always(arena);
+	if (arena->getSerial() != mKeySerial)
+	{
+		// New document; drop whatever a failed parse of the previous one left behind.
+		mEntries.clear();
+		mMarks.clear();
+		beginDocument(arena);
+	}
+	mMarks.push_back(mEntries.size());
+}
+
+LLSD& LLSDMapBuilder::addKey(const std::string& key)
+{
+	llassert(!mMarks.empty());
+	mEntries.push_back(Entry());
+	Entry& entry = mEntries.back();
+	entry.mKey = intern(key);
+	return entry.mValue;
+}
+
+struct LLSDMapBuilder::EntryLess
+{
+	EntryLess(const std::deque<Entry>& entries) : mEntries(entries) { }
+
+	bool operator()(U32 lhs, U32 rhs) const
+	{
+		const LLSDCompactKey* lkey = mEntries[lhs].mKey;
+		const LLSDCompactKey* rkey = mEntries[rhs].mKey;
+		if (lkey != rkey)
+		{
+			// Interned, so these are different strings.
+			return compare_key(lkey, rkey->mString, rkey->mLength) < 0;
+		}
+		return lhs < rhs;
+	}
+
+	const std::deque<Entry>& mEntries;
+};
+
+void LLSDMapBuilder::endMap(LLSD& map, bool keep_last)
+{
+	LLSDArena* arena = LLSDArena::getCurrent();
+	llassert_always(arena && !mMarks.empty());
+	U32 first = mMarks.back();
+	mMarks.pop_back();
+	U32 count = mEntries.size() - first;
+
+	// Sort on key, with the order of insertion between duplicates.
+	mOrder.resize(count);
+	for (U32 i = 0; i < count; ++i)
+	{
+		mOrder[i] = first + i;
+	}
+	std::sort(mOrder.begin(), mOrder.end(), EntryLess(mEntries));
+	U32 unique = 0;
+	for (U32 i = 0; i < count; ++i)
+	{
+		if (unique > 0 && mEntries[mOrder[unique - 1]].mKey == mEntries[mOrder[i]].mKey)
+		{
+			if (keep_last)
+			{
+				mOrder[unique - 1] = mOrder[i];
+			}
+			continue;
+		}
+		mOrder[unique++] = mOrder[i];
+	}
+
+	ImplFlatMap* flat = new (ImplFlatMap::extraBytes(unique)) ImplFlatMap(unique, arena);
+	ImplFlatMap::Entry* entry = flat->entries();
+	for (U32 i = 0; i < unique; ++i, ++entry)
+	{
+		const Entry& source = mEntries[mOrder[i]];
+		entry->mKey = source.mKey;
+		entry->mValue = source.mValue;
+	}
+	mEntries.erase(mEntries.begin() + first, mEntries.end());
+	LLSD::Impl::assign(map.impl, flat);
+}
+
+void LLSDMapBuilder::beginDocument(LLSDArena* arena)
+{
+	// Forget the keys of the previous document.
+	mKeySerial = arena->getSerial();
+	mKeyCount = 0;
+	if (++mGeneration == 0)
+	{
+		for (std::vector<Slot>::iterator iter = mKeys.begin(); iter != mKeys.end(); ++iter)
+		{
+			iter->mGeneration = 0;
+		}
+		mGeneration = 1;
+	}
+}
+
+const LLSDCompactKey* LLSDMapBuilder::intern(const std::string& key)
+{
+	LLSDArena* arena = LLSDArena::getCurrent();
+	llassert_always(arena);
+	llassert(arena->getSerial() == mKeySerial);
+	if ((mKeyCount + 1) * 2 > mKeys.size())
+	{
+		// Grow to keep the load factor below one half.
+		std::vector<Slot> keys(llmax((size_t)64, mKeys.size() * 2));
+		U32 mask = keys.size() - 1;
+		for (std::vector<Slot>::iterator iter = mKeys.begin(); iter != mKeys.end(); ++iter)
+		{
+			if (iter->mGeneration == mGeneration)
+			{
+				U32 i = iter->mKey->mHash & mask;
+				while (keys[i].mGeneration == mGeneration)
+				{
+					i = (i + 1) & mask;
+				}
+				keys[i] = *iter;
+			}
+		}
+		mKeys.swap(keys);
+	}
+
+	// FNV-1a
+	U32 hash = 2166136261u;
+	for (std::string::const_iterator iter = key.begin(); iter != key.end(); ++iter)
+	{
+		hash = (hash ^ (U8)*iter) * 16777619u;
+	}
+	U32 mask = mKeys.size() - 1;
+	U32 i = hash & mask;
+	while (mKeys[i].mGeneration == mGeneration)
+	{
+		const LLSDCompactKey* interned = mKeys[i].mKey;
+		if (interned->mHash == hash && interned->mLength == key.size() && !memcmp(interned->mString, key.data(), key.size()))
+		{
+			return interned;
+		}
+		i = (i + 1) & mask;
+	}
+	LLSDCompactKey* interned = (LLSDCompactKey*)arena->allocate(offsetof(LLSDCompactKey, mString) + key.size() + 1);
+	interned->mLength = key.size();
+	interned->mHash = hash;
+	memcpy(interned->mString, key.data(), key.size());
+	interned->mString[key.size()] = '\0';
+	mKeys[i].mGeneration = mGeneration;
+	mKeys[i].mKey = interned;
+	++mKeyCount;
+	return interned;
+}
@@ -329,6 +329,7 @@ public:
 		class Impl;
 private:
 		Impl* impl;
+		friend class LLSDMapBuilder;	// Assigns compact maps, see llsdcompact.h.
 	//@}
 	
 	/** @name Unit Testing Interface */
@@ -0,0 +1,153 @@
+/**
+ * @file llsdcompact.h
+ * @brief Arena allocated, flat LLSD maps for parsed documents
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSDCOMPACT_H
+#define LL_LLSDCOMPACT_H
+
+#include <deque>
+#include <vector>
+
+#include "llsd.h"
+
+class LLSDArena;
+struct LLSDCompactKey;
+
+// Compact LLSD documents.
+//
+// A parser that knows its result will mostly be read, like a mesh header or
+// an inventory fetch response, can build the whole document in one arena:
+//
+// - While an LLSDArenaScope is alive, every LLSD value that is created by
+//   the current thread is allocated from the scope's arena instead of from
+//   the heap. The current arena is a thread local lookup per value, made
+//   only while some thread has a scope. Strings up to LLSD_COMPACT_STRING_MAX bytes are stored inline
+//   in their value.
+// - Maps that are built with an LLSDMapBuilder are one block in the arena: a
+//   vector of (key, value) pairs sorted on the key. The keys are interned per
+//   document, so every item of an inventory response shares the same "name".
+//
+// The arena is freed when the last value allocated from it is destroyed, so
+// keeping a small part of a large document keeps the whole document alive.
+//
+// Compact maps behave like any other map, with these exceptions:
+// - Adding or erasing a key or getting non-const iterators turns the map
+//   into a normal std::map based one. References to values of the compact
+//   map that were obtained before that are then no longer valid.
+// - Const iteration (beginMap() const) makes a std::map copy on first use,
+//   which lives as long as the map. Its iterators stay valid when values are
+//   changed, but only see the changes from the next beginMap() on.
+// The implementation lives in llsd.cpp, next to the other LLSD::Impl classes.
+
+// Strings longer than this are allocated from the heap, as usual.
+const U32 LLSD_COMPACT_STRING_MAX = 127;
+
+class LL_COMMON_API LLSDArenaScope
+{
+public:
+	// Creates a new arena and makes it the current one of this thread.
+	LLSDArenaScope();
+	// Restores the previous arena. Values that were allocated keep the arena alive.
+	~LLSDArenaScope();
+
+	// Number of bytes allocated from the arena so far.
+	size_t getBytesUsed() const;
+
+private:
+	// Not copyable.
+	LLSDArenaScope(const LLSDArenaScope&);
+	LLSDArenaScope& operator=(const LLSDArenaScope&);
+
+	LLSDArena* mArena;
+	LLSDArena* mPrevious;
+};
+
+// Builds compact maps; must be used inside an LLSDArenaScope.
+// Nested maps are built by nesting beginMap() / endMap() pairs:
+//
+//   builder.beginMap();
+//   LLSD& value = builder.addKey("name");	// Parse the value into this.
+//   ...
+//   builder.endMap(map);
+//
+// Can be reused for any number of documents, each in its own LLSDArenaScope.
+// Maps left unfinished by a failed parse are dropped when the next document begins.
+class LL_COMMON_API LLSDMapBuilder
+{
+public:
+	LLSDMapBuilder();
+	~LLSDMapBuilder();
+
+	// Forgets the interned keys and any unfinished maps.
+	void reset();
+
+	void beginMap();
+	// The returned reference stays valid until the endMap() of this map.
+	LLSD& addKey(const std::string& key);
+	// Assigns the entries added since the matching beginMap() to map.
+	// Of duplicate keys the first value is kept, or the last one with keep_last.
+	void endMap(LLSD& map, bool keep_last = false);
+
+	// Number of maps that were begun but not ended.
+	S32 getDepth() const { return (S32)mMarks.size(); }
+
+private:
+	// Not copyable.
+	LLSDMapBuilder(const LLSDMapBuilder&);
+	LLSDMapBuilder& operator=(const LLSDMapBuilder&);
+
+	void beginDocument(LLSDArena* arena);
+	const LLSDCompactKey* intern(const std::string& key);
+
+	struct Entry
+	{
+		const LLSDCompactKey* mKey;
+		LLSD mValue;
+	};
+	std::deque<Entry> mEntries;				// Entries of all unfinished maps. A deque, so references stay valid.
+	std::vector<U32> mMarks;				// Index in mEntries of the first entry of each unfinished map.
+	std::vector<U32> mOrder;				// Scratch space for sorting.
+
+	// Open addressing hash table of the keys interned in the current arena.
+	struct Slot
+	{
+		U32 mGeneration;
+		const LLSDCompactKey* mKey;
+	};
+	std::vector<Slot> mKeys;
+	U32 mKeyCount;
+	U32 mGeneration;						// Slots of an older generation are empty.
+	U32 mKeySerial;							// Serial number of the arena that the keys were allocated from.
+
+	struct EntryLess;
+};
+
+#endif // LL_LLSDCOMPACT_H
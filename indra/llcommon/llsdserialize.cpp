@@ -34,6 +34,7 @@
 
 #include "linden_common.h"
 #include "llsdserialize.h"
+#include "llmemorystream.h"
 #include "llpointer.h"
 #include "llstreamtools.h" // for fullread
 
@@ -257,6 +258,16 @@ int deserialize_string(std::istream& istr, std::string& value, S32 max_bytes);
  */
 int deserialize_string_delim(std::istream& istr, std::string& value, char d);
 
+/**
+ * @brief Parse a delimited string out of a buffer.
+ *
+ * @param input The input to read from, with the delimiter already popped.
+ * @param value [out] The string which was found.
+ * @param d The delimiter to use.
+ * @return Returns number of bytes read. Returns PARSE_FAILURE (-1) on failure.
+ */
+int deserialize_string_delim(LLSDInput& input, std::string& value, char d);
+
 /**
  * @brief Read a raw string off the stream.
  *
@@ -309,11 +320,69 @@ static const char BINARY_TRUE_SERIAL = '1';
 static const char BINARY_FALSE_SERIAL = '0';
 
 
+/**
+ * LLSDInput
+ */
+bool LLSDInput::read(void* dest, S32 n)
+{
+	U8* out = (U8*)dest;
+	while (n > 0)
+	{
+		if (mCur == mEnd && !nextBlock())
+		{
+			return false;
+		}
+		S32 count = llmin(n, (S32)(mEnd - mCur));
+		memcpy(out, mCur, count);
+		mCur += count;
+		out += count;
+		n -= count;
+	}
+	return true;
+}
+
+bool LLSDInput::read(std::string& value, S32 n)
+{
+	if (mEnd - mCur >= n)
+	{
+		// The common case; straight out of the buffer.
+		value.assign((const char*)mCur, n);
+		mCur += n;
+		return true;
+	}
+	value.clear();
+	value.reserve(n);
+	while (n > 0)
+	{
+		if (mCur == mEnd && !nextBlock())
+		{
+			return false;
+		}
+		S32 count = llmin(n, (S32)(mEnd - mCur));
+		value.append((const char*)mCur, count);
+		mCur += count;
+		n -= count;
+	}
+	return true;
+}
+
+bool LLSDInput::getBlock(const U8*& data, S32& size)
+{
+	if (mCur == mEnd && !nextBlock())
+	{
+		return false;
+	}
+	data = mCur;
+	size = (S32)(mEnd - mCur);
+	mCur = mEnd;
+	return true;
+}
+
 /**
  * LLSDParser
  */
 LLSDParser::LLSDParser()
-	: mCheckLimits(true), mMaxBytesLeft(0), mParseLines(false)
+	: mCheckLimits(true), mMaxBytesLeft(0), mParseLines(false), mCompact(false)
 {
 }
 
@@ -325,6 +394,11 @@ S32 LLSDParser::parse(std::istream& istr, LLSD& data, S32 max_bytes)
 {
 	mCheckLimits = (LLSDSerialize::SIZE_UNLIMITED == max_bytes) ? false : true;
 	mMaxBytesLeft = max_bytes;
+	if (mCompact)
+	{
+		LLSDArenaScope scope;
+		return doParse(istr, data);
+	}
 	return doParse(istr, data);
 }
 
@@ -334,9 +408,64 @@ S32 LLSDParser::parseLines(std::istream& istr, LLSD& data)
 {
 	mCheckLimits = false;
 	mParseLines = true;
+	if (mCompact)
+	{
+		LLSDArenaScope scope;
+		return doParse(istr, data);
+	}
 	return doParse(istr, data);
 }
 
+S32 LLSDParser::parse(const U8* buf, S32 size, LLSD& data, S32* bytes_read)
+{
+	LLSDInput input(buf, size);
+	S32 parse_count = parse(input, data);
+	if (bytes_read)
+	{
+		*bytes_read = input.getBytesRead();
+	}
+	return parse_count;
+}
+
+S32 LLSDParser::parse(LLSDInput& input, LLSD& data)
+{
+	// Only used by the stream based parsing of doParseBuffer().
+	mCheckLimits = true;
+	mMaxBytesLeft = input.getMaxBytesLeft();
+	if (mCompact)
+	{
+		LLSDArenaScope scope;
+		return doParseBuffer(input, data);
+	}
+	return doParseBuffer(input, data);
+}
+
+// virtual
+S32 LLSDParser::doParseBuffer(LLSDInput& input, LLSD& data) const
+{
+	const U8* buf;
+	S32 size;
+	std::string copy;
+	if (input.isContiguous())
+	{
+		if (!input.getBlock(buf, size))
+		{
+			return 0;
+		}
+	}
+	else
+	{
+		while (input.getBlock(buf, size))
+		{
+			copy.append((const char*)buf, size);
+		}
+		buf = (const U8*)copy.data();
+		size = copy.size();
+	}
+	LLMemoryStream stream(buf, size);
+	return doParse(stream, data);
+}
+
 
 int LLSDParser::get(std::istream& istr) const
 {
@@ -863,6 +992,84 @@ bool LLSDNotationParser::parseBinary(std::istream& istr, LLSD& data) const
 /**
  * LLSDBinaryParser
  */
+
+/**
+ * What parseValue() and friends read from when parsing an istream. Reads
+ * go through the LLSDParser helpers or account() for the limit checks.
+ */
+class LLSDBinaryParser::StreamSource
+{
+public:
+	StreamSource(const LLSDBinaryParser& parser, std::istream& istr)
+		: mParser(parser), mStream(istr) { }
+
+	bool get(char& c)
+	{
+		c = (char)mParser.get(mStream);
+		return mStream.good();
+	}
+
+	bool peek(char& c)
+	{
+		c = (char)mStream.peek();
+		return mStream.good();
+	}
+
+	bool read(void* dest, S32 n)
+	{
+		mParser.account(fullread(mStream, (char*)dest, n));
+		return !mStream.fail();
+	}
+
+	bool read(std::string& value, S32 n)
+	{
+		value.resize(n);
+		return !n || read(&value[0], n);
+	}
+
+	bool hasBytes(S32 n) const
+	{
+		return !mParser.mCheckLimits || (n <= mParser.mMaxBytesLeft);
+	}
+
+	S32 readDelimited(std::string& value, char delim)
+	{
+		int cnt = deserialize_string_delim(mStream, value, delim);
+		if(PARSE_FAILURE != cnt)
+		{
+			mParser.account(cnt);
+		}
+		return cnt;
+	}
+
+private:
+	const LLSDBinaryParser& mParser;
+	std::istream& mStream;
+};
+
+/**
+ * What parseValue() and friends read from when parsing an LLSDInput.
+ */
+class LLSDBinaryParser::BufferSource
+{
+public:
+	BufferSource(LLSDInput& input) : mInput(input) { }
+
+	bool get(char& c) { return mInput.get(c); }
+	bool peek(char& c) { return mInput.peek(c); }
+	bool read(void* dest, S32 n) { return mInput.read(dest, n); }
+	bool read(std::string& value, S32 n) { return mInput.read(value, n); }
+	bool hasBytes(S32 n) const { return n <= mInput.getMaxBytesLeft(); }
+
+	S32 readDelimited(std::string& value, char delim)
+	{
+		return deserialize_string_delim(mInput, value, delim);
+	}
+
+private:
+	LLSDInput& mInput;
+};
+
 LLSDBinaryParser::LLSDBinaryParser()
 {
 }
@@ -874,6 +1081,20 @@ LLSDBinaryParser::~LLSDBinaryParser()
 
 // virtual
 S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
+{
+	StreamSource source(*this, istr);
+	return parseValue(source, data);
+}
+
+// virtual
+S32 LLSDBinaryParser::doParseBuffer(LLSDInput& input, LLSD& data) const
+{
+	BufferSource source(input);
+	return parseValue(source, data);
+}
+
+template<class SOURCE>
+S32 LLSDBinaryParser::parseValue(SOURCE& source, LLSD& data) const
 {
 /**
  * Undefined: '!'<br>
@@ -892,8 +1113,7 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
  *  notation format.
  */
 	char c;
-	c = get(istr);
-	if(!istr.good())
+	if(!source.get(c))
 	{
 		return 0;
 	}
@@ -902,39 +1122,31 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
 	{
 	case '{':
 	{
-		S32 child_count = parseMap(istr, data);
+		S32 child_count = parseMap(source, data);
 		if((child_count == PARSE_FAILURE) || data.isUndefined())
 		{
+			llinfos << "STREAM FAILURE reading binary map." << llendl;
 			parse_count = PARSE_FAILURE;
 		}
 		else
 		{
 			parse_count += child_count;
 		}
-		if(istr.fail())
-		{
-			llinfos << "STREAM FAILURE reading binary map." << llendl;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
 	case '[':
 	{
-		S32 child_count = parseArray(istr, data);
+		S32 child_count = parseArray(source, data);
 		if((child_count == PARSE_FAILURE) || data.isUndefined())
 		{
+			llinfos << "STREAM FAILURE reading binary array." << llendl;
 			parse_count = PARSE_FAILURE;
 		}
 		else
 		{
 			parse_count += child_count;
 		}
-		if(istr.fail())
-		{
-			llinfos << "STREAM FAILURE reading binary array." << llendl;
-			parse_count = PARSE_FAILURE;
-		}
 		break;
 	}
 
@@ -953,36 +1165,39 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
 	case 'i':
 	{
 		U32 value_nbo = 0;
-		read(istr, (char*)&value_nbo, sizeof(U32));	 /*Flawfinder: ignore*/
-		data = (S32)ntohl(value_nbo);
-		if(istr.fail())
+		if(!source.read(&value_nbo, sizeof(U32)))
 		{
 			llinfos << "STREAM FAILURE reading binary integer." << llendl;
+			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = (S32)ntohl(value_nbo);
 		break;
 	}
 
 	case 'r':
 	{
 		F64 real_nbo = 0.0;
-		read(istr, (char*)&real_nbo, sizeof(F64));	 /*Flawfinder: ignore*/
-		data = ll_ntohd(real_nbo);
-		if(istr.fail())
+		if(!source.read(&real_nbo, sizeof(F64)))
 		{
 			llinfos << "STREAM FAILURE reading binary real." << llendl;
+			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = ll_ntohd(real_nbo);
 		break;
 	}
 
 	case 'u':
 	{
 		LLUUID id;
-		read(istr, (char*)(&id.mData), UUID_BYTES);	 /*Flawfinder: ignore*/
-		data = id;
-		if(istr.fail())
+		if(!source.read(id.mData, UUID_BYTES))
 		{
 			llinfos << "STREAM FAILURE reading binary uuid." << llendl;
+			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = id;
 		break;
 	}
 
@@ -990,73 +1205,53 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
 	case '"':
 	{
 		std::string value;
-		int cnt = deserialize_string_delim(istr, value, c);
-		if(PARSE_FAILURE == cnt)
-		{
-			parse_count = PARSE_FAILURE;
-		}
-		else
-		{
-			data = value;
-			account(cnt);
-		}
-		if(istr.fail())
+		if(PARSE_FAILURE == source.readDelimited(value, c))
 		{
 			llinfos << "STREAM FAILURE reading binary (notation-style) string."
 				<< llendl;
 			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = value;
 		break;
 	}
 
 	case 's':
 	{
 		std::string value;
-		if(parseString(istr, value))
-		{
-			data = value;
-		}
-		else
-		{
-			parse_count = PARSE_FAILURE;
-		}
-		if(istr.fail())
+		if(!parseString(source, value))
 		{
 			llinfos << "STREAM FAILURE reading binary string." << llendl;
 			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = value;
 		break;
 	}
 
 	case 'l':
 	{
 		std::string value;
-		if(parseString(istr, value))
-		{
-			data = LLURI(value);
-		}
-		else
-		{
-			parse_count = PARSE_FAILURE;
-		}
-		if(istr.fail())
+		if(!parseString(source, value))
 		{
 			llinfos << "STREAM FAILURE reading binary link." << llendl;
 			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = LLURI(value);
 		break;
 	}
 
 	case 'd':
 	{
 		F64 real = 0.0;
-		read(istr, (char*)&real, sizeof(F64));	 /*Flawfinder: ignore*/
-		data = LLDate(real);
-		if(istr.fail())
+		if(!source.read(&real, sizeof(F64)))
 		{
 			llinfos << "STREAM FAILURE reading binary date." << llendl;
 			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = LLDate(real);
 		break;
 	}
 
@@ -1065,27 +1260,25 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
 		// We probably have a valid raw binary stream. determine
 		// the size, and read it.
 		U32 size_nbo = 0;
-		read(istr, (char*)&size_nbo, sizeof(U32));	/*Flawfinder: ignore*/
-		S32 size = (S32)ntohl(size_nbo);
-		if(mCheckLimits && (size > mMaxBytesLeft))
+		S32 size = -1;
+		if(source.read(&size_nbo, sizeof(U32)))
 		{
-			parse_count = PARSE_FAILURE;
+			size = (S32)ntohl(size_nbo);
 		}
-		else
+		if(size < 0 || !source.hasBytes(size))
 		{
-			std::vector<U8> value;
-			if(size > 0)
-			{
-				value.resize(size);
-				account(fullread(istr, (char*)&value[0], size));
-			}
-			data = value;
+			llinfos << "STREAM FAILURE reading binary." << llendl;
+			parse_count = PARSE_FAILURE;
+			break;
 		}
-		if(istr.fail())
+		std::vector<U8> value(size);
+		if(size > 0 && !source.read(&value[0], size))
 		{
 			llinfos << "STREAM FAILURE reading binary." << llendl;
 			parse_count = PARSE_FAILURE;
+			break;
 		}
+		data = value;
 		break;
 	}
 
@@ -1102,50 +1295,73 @@ S32 LLSDBinaryParser::doParse(std::istream& istr, LLSD& data) const
 	return parse_count;
 }
 
-S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map) const
+template<class SOURCE>
+S32 LLSDBinaryParser::parseMap(SOURCE& source, LLSD& map) const
 {
 	map = LLSD::emptyMap();
 	U32 value_nbo = 0;
-	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	if(!source.read(&value_nbo, sizeof(U32)))
+	{
+		return PARSE_FAILURE;
+	}
 	S32 size = (S32)ntohl(value_nbo);
 	S32 parse_count = 0;
 	S32 count = 0;
-	char c = get(istr);
-	while(c != '}' && (count < size) && istr.good())
+	if (mCompact)
 	{
-		std::string name;
+		mMapBuilder.beginMap();
+	}
+	std::string name;
+	char c = 0;
+	if(!source.get(c))
+	{
+		return PARSE_FAILURE;
+	}
+	while(c != '}' && (count < size))
+	{
+		name.clear();
 		switch(c)
 		{
 		case 'k':
-			if(!parseString(istr, name))
+			if(!parseString(source, name))
 			{
 				return PARSE_FAILURE;
 			}
 			break;
 		case '\'':
 		case '"':
-		{
-			int cnt = deserialize_string_delim(istr, name, c);
-			if(PARSE_FAILURE == cnt) return PARSE_FAILURE;
-			account(cnt);
+			if(PARSE_FAILURE == source.readDelimited(name, c))
+			{
+				return PARSE_FAILURE;
+			}
 			break;
 		}
-		}
-		LLSD child;
-		S32 child_count = doParse(istr, child);
-		if(child_count > 0)
+		S32 child_count;
+		if (mCompact)
 		{
-			// There must be a value for every key, thus child_count
-			// must be greater than 0.
-			parse_count += child_count;
-			map.insert(name, child);
+			// Parse straight into the entry; duplicates are dropped by endMap().
+			child_count = parseValue(source, mMapBuilder.addKey(name));
 		}
 		else
 		{
+			LLSD child;
+			child_count = parseValue(source, child);
+			if(child_count > 0)
+			{
+				map.insert(name, child);
+			}
+		}
+		if(child_count <= 0)
+		{
+			// There must be a value for every key.
 			return PARSE_FAILURE;
 		}
+		parse_count += child_count;
 		++count;
-		c = get(istr);
+		if(!source.get(c))
+		{
+			return PARSE_FAILURE;
+		}
 	}
 	if((c != '}') || (count < size))
 	{
@@ -1153,14 +1369,22 @@ S32 LLSDBinaryParser::parseMap(std::istream& istr, LLSD& map) const
 		// as were said to be there.
 		return PARSE_FAILURE;
 	}
+	if (mCompact)
+	{
+		mMapBuilder.endMap(map);
+	}
 	return parse_count;
 }
 
-S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array) const
+template<class SOURCE>
+S32 LLSDBinaryParser::parseArray(SOURCE& source, LLSD& array) const
 {
 	array = LLSD::emptyArray();
 	U32 value_nbo = 0;
-	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	if(!source.read(&value_nbo, sizeof(U32)))
+	{
+		return PARSE_FAILURE;
+	}
 	S32 size = (S32)ntohl(value_nbo);
 
 	// *FIX: This would be a good place to reserve some space in the
@@ -1168,11 +1392,11 @@ S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array) const
 
 	S32 parse_count = 0;
 	S32 count = 0;
-	char c = istr.peek();
-	while((c != ']') && (count < size) && istr.good())
+	char c = 0;
+	while(source.peek(c) && (c != ']') && (count < size))
 	{
 		LLSD child;
-		S32 child_count = doParse(istr, child);
+		S32 child_count = parseValue(source, child);
 		if(PARSE_FAILURE == child_count)
 		{
 			return PARSE_FAILURE;
@@ -1183,10 +1407,8 @@ S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array) const
 			array.append(child);
 		}
 		++count;
-		c = istr.peek();
 	}
-	c = get(istr);
-	if((c != ']') || (count < size))
+	if(!source.get(c) || (c != ']') || (count < size))
 	{
 		// Make sure it is correctly terminated and we parsed as many
 		// as were said to be there.
@@ -1195,23 +1417,20 @@ S32 LLSDBinaryParser::parseArray(std::istream& istr, LLSD& array) const
 	return parse_count;
 }
 
-bool LLSDBinaryParser::parseString(
-	std::istream& istr,
-	std::string& value) const
+template<class SOURCE>
+bool LLSDBinaryParser::parseString(SOURCE& source, std::string& value) const
 {
-	// *FIX: This is memory inefficient.
 	U32 value_nbo = 0;
-	read(istr, (char*)&value_nbo, sizeof(U32));		 /*Flawfinder: ignore*/
+	if(!source.read(&value_nbo, sizeof(U32)))
+	{
+		return false;
+	}
 	S32 size = (S32)ntohl(value_nbo);
-	if(mCheckLimits && (size > mMaxBytesLeft)) return false;
-	std::vector<char> buf;
-	if(size)
+	if(size < 0 || !source.hasBytes(size))
 	{
-		buf.resize(size);
-		account(fullread(istr, &buf[0], size));
-		value.assign(buf.begin(), buf.end());
+		return false;
 	}
-	return true;
+	return source.read(value, size);
 }
 
 
@@ -1644,6 +1863,96 @@ int deserialize_string_delim(
 	return count;
 }
 
+int deserialize_string_delim(
+	LLSDInput& input,
+	std::string& value,
+	char delim)
+{
+	// Same escapes as the istream version above.
+	value.clear();
+	bool found_escape = false;
+	bool found_hex = false;
+	bool found_digit = false;
+	U8 byte = 0;
+	int count = 0;
+	char next_char;
+
+	while (input.get(next_char))
+	{
+		++count;
+		if(found_escape)
+		{
+			if(found_hex)
+			{
+				if(found_digit)
+				{
+					found_digit = false;
+					found_hex = false;
+					found_escape = false;
+					byte = byte << 4;
+					byte |= hex_as_nybble(next_char);
+					value += (char)byte;
+					byte = 0;
+				}
+				else
+				{
+					found_digit = true;
+					byte = hex_as_nybble(next_char);
+				}
+			}
+			else if(next_char == 'x')
+			{
+				found_hex = true;
+			}
+			else
+			{
+				switch(next_char)
+				{
+				case 'a':
+					value += '\a';
+					break;
+				case 'b':
+					value += '\b';
+					break;
+				case 'f':
+					value += '\f';
+					break;
+				case 'n':
+					value += '\n';
+					break;
+				case 'r':
+					value += '\r';
+					break;
+				case 't':
+					value += '\t';
+					break;
+				case 'v':
+					value += '\v';
+					break;
+				default:
+					value += next_char;
+					break;
+				}
+				found_escape = false;
+			}
+		}
+		else if(next_char == '\\')
+		{
+			found_escape = true;
+		}
+		else if(next_char == delim)
+		{
+			return count;
+		}
+		else
+		{
+			value += next_char;
+		}
+	}
+	// Ran out of input.
+	return LLSDParser::PARSE_FAILURE;
+}
+
 int deserialize_string_raw(
 	std::istream& istr,
 	std::string& value,
@@ -2083,98 +2392,137 @@ std::string zip_llsd(LLSD& data)
 	return result;
 }
 
-//decompress a block of LLSD from provided istream
-// not very efficient -- creats a copy of decompressed LLSD block in memory
-// and deserializes from that copy using LLSDSerialize
-bool unzip_llsd(LLSD& data, std::istream& is, S32 size)
+namespace
 {
-	U8* result = NULL;
-	U32 cur_size = 0;
-	z_stream strm;
-		
-	const U32 CHUNK = 65536;
+	// Inflates zlib compressed data a chunk at a time, for unzip_llsd().
+	class LLSDInflateInput : public LLSDInput
+	{
+	public:
+		LLSDInflateInput(const U8* in, S32 size);
+		virtual ~LLSDInflateInput();
 
-	U8 *in = new U8[size];
-	is.read((char*) in, size); 
+		// Inflates what is left and verifies the checksum.
+		bool finish();
 
-	U8 out[CHUNK];
-		
-	strm.zalloc = Z_NULL;
-	strm.zfree = Z_NULL;
-	strm.opaque = Z_NULL;
-	strm.avail_in = size;
-	strm.next_in = in;
+		/*virtual*/ bool isContiguous() const	{ return false; }
+		/*virtual*/ S32 getMaxBytesLeft() const;
 
-	S32 ret = inflateInit(&strm);
+	protected:
+		/*virtual*/ bool fill();
 
-	do
+	private:
+		enum { CHUNK = 16384 };
+
+		z_stream mStream;
+		bool mInitialized;
+		bool mStreamEnd;
+		bool mFailed;
+		U8 mChunk[CHUNK];
+	};
+
+	LLSDInflateInput::LLSDInflateInput(const U8* in, S32 size)
+		: LLSDInput(NULL, 0), mStreamEnd(false), mFailed(false)
 	{
-		strm.avail_out = CHUNK;
-		strm.next_out = out;
-		ret = inflate(&strm, Z_NO_FLUSH);
-		if (ret == Z_STREAM_ERROR)
+		mStream.zalloc = Z_NULL;
+		mStream.zfree = Z_NULL;
+		mStream.opaque = Z_NULL;
+		mStream.avail_in = size;
+		mStream.next_in = (Bytef*)in;
+		mInitialized = (inflateInit(&mStream) == Z_OK);
+	}
+
+	LLSDInflateInput::~LLSDInflateInput()
+	{
+		if (mInitialized)
+		{
+			inflateEnd(&mStream);
+		}
+	}
+
+	bool LLSDInflateInput::fill()
+	{
+		if (!mInitialized || mStreamEnd || mFailed)
 		{
-			inflateEnd(&strm);
-			free(result);
-			delete [] in;
 			return false;
 		}
-		
+		mStream.avail_out = CHUNK;
+		mStream.next_out = mChunk;
+		S32 ret = inflate(&mStream, Z_NO_FLUSH);
 		switch (ret)
 		{
-		case Z_NEED_DICT:
-			ret = Z_DATA_ERROR;
-		case Z_DATA_ERROR:
-		case Z_MEM_ERROR:
-			inflateEnd(&strm);
-			free(result);
-			delete [] in;
-			return false;
+		case Z_OK:
 			break;
+		case Z_STREAM_END:
+			mStreamEnd = true;
+			break;
+		default:
+			// Includes Z_BUF_ERROR: the input ended before the stream did.
+			mFailed = true;
+			return false;
 		}
+		setBlock(mChunk, CHUNK - mStream.avail_out);
+		return true;
+	}
 
-		U32 have = CHUNK-strm.avail_out;
-
-		result = (U8*) realloc(result, cur_size + have);
-		memcpy(result+cur_size, out, have);
-		cur_size += have;
-
-	} while (ret == Z_OK);
-
-	inflateEnd(&strm);
-	delete [] in;
-
-	if (ret != Z_STREAM_END)
+	bool LLSDInflateInput::finish()
 	{
-		free(result);
-		return false;
+		const U8* data;
+		S32 size;
+		while (getBlock(data, size))
+		{
+		}
+		return mStreamEnd;
 	}
 
-	//result now points to the decompressed LLSD block
+	S32 LLSDInflateInput::getMaxBytesLeft() const
 	{
-		std::string res_str((char*) result, cur_size);
+		// Deflate can't compress better than about 1:1032.
+		const U64 MAX_RATIO = 1032;
+		U64 max_left = LLSDInput::getMaxBytesLeft() + (U64)mStream.avail_in * MAX_RATIO + CHUNK;
+		return (S32)llmin(max_left, (U64)S32_MAX);
+	}
+}
 
-		std::string deprecated_header("<? LLSD/Binary ?>");
+//decompress a block of LLSD from provided istream
+bool unzip_llsd(LLSD& data, std::istream& is, S32 size)
+{
+	std::vector<U8> in(size);
+	if (size > 0)
+	{
+		is.read((char*)&in[0], size);
+	}
+	return unzip_llsd(data, size > 0 ? &in[0] : NULL, size);
+}
 
-		if (res_str.substr(0, deprecated_header.size()) == deprecated_header)
-		{
-			res_str = res_str.substr(deprecated_header.size()+1, cur_size);
-		}
-		cur_size = res_str.size();
+//decompress and parse a block of LLSD in one pass, a chunk at a time
+bool unzip_llsd(LLSD& data, const U8* in, S32 size)
+{
+	LLSDInflateInput input(in, size);
 
-		std::istringstream istr(res_str);
-		
-		if (!LLSDSerialize::fromBinary(data, istr, cur_size))
+	// Skip the deprecated header and the character after it.
+	static const std::string deprecated_header("<? LLSD/Binary ?>");
+	char c;
+	if (input.peek(c) && c == deprecated_header[0])
+	{
+		std::string header;
+		if (!input.read(header, deprecated_header.size() + 1) ||
+			header.compare(0, deprecated_header.size(), deprecated_header) != 0)
 		{
 			llwarns << "Failed to unzip LLSD block" << llendl;
-			free(result);
 			return false;
 		}
 	}
 
-	free(result);
+	LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+	if (parser->parse(input, data) <= 0 || !input.finish())
+	{
+		llwarns << "Failed to unzip LLSD block" << llendl;
+		data.clear();
+		return false;
+	}
 	return true;
 }
+
 //This unzip function will only work with a gzip header and trailer - while the contents
 //of the actual compressed data is the same for either format (gzip vs zlib ), the headers
 //and trailers are different for the formats.
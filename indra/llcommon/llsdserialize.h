@@ -39,6 +39,106 @@
 #include "llpointer.h"
 #include "llrefcount.h"
 #include "llsd.h"
+#include "llsdcompact.h"
+
+/** 
+ * @class LLSDInput
+ * @brief Contiguous input for the buffer parsers.
+ *
+ * Hands out the bytes of a buffer in place. Subclasses can produce the
+ * data a block at a time by implementing fill(), like the inflating
+ * input of unzip_llsd().
+ */
+class LL_COMMON_API LLSDInput
+{
+public:
+	LLSDInput(const U8* buf, S32 size)
+		: mCur(buf), mEnd(buf + size), mBlockStart(buf), mBlockOffset(0) { }
+	virtual ~LLSDInput() { }
+
+	/** 
+	 * @brief Get the next byte, returns false at the end of the input.
+	 */
+	bool get(char& c)
+	{
+		if (mCur == mEnd && !nextBlock()) return false;
+		c = (char)*mCur++;
+		return true;
+	}
+
+	/** 
+	 * @brief Get the next byte without consuming it.
+	 */
+	bool peek(char& c)
+	{
+		if (mCur == mEnd && !nextBlock()) return false;
+		c = (char)*mCur;
+		return true;
+	}
+
+	/** 
+	 * @brief Copy the next n bytes to dest, returns false if there aren't that many.
+	 */
+	bool read(void* dest, S32 n);
+
+	/** 
+	 * @brief Assign the next n bytes to value, returns false if there aren't that many.
+	 */
+	bool read(std::string& value, S32 n);
+
+	/** 
+	 * @brief Consume all bytes that are buffered, reading a new block if needed.
+	 *
+	 * @param data[out] The start of the bytes.
+	 * @param size[out] The number of bytes.
+	 * @return Returns false at the end of the input.
+	 */
+	bool getBlock(const U8*& data, S32& size);
+
+	/** 
+	 * @brief Number of bytes that were consumed so far.
+	 */
+	S32 getBytesRead() const { return mBlockOffset + (S32)(mCur - mBlockStart); }
+
+	/** 
+	 * @brief Whether the whole input is buffered.
+	 */
+	virtual bool isContiguous() const { return true; }
+
+	/** 
+	 * @brief Upper bound of the number of bytes left, to reject
+	 * impossible sizes before allocating anything.
+	 */
+	virtual S32 getMaxBytesLeft() const { return (S32)(mEnd - mCur); }
+
+protected:
+	/** 
+	 * @brief Make the next block the current one, returns false at the end.
+	 */
+	virtual bool fill() { return false; }
+
+	void setBlock(const U8* buf, S32 size)
+	{
+		mBlockOffset += (S32)(mEnd - mBlockStart);
+		mCur = mBlockStart = buf;
+		mEnd = buf + size;
+	}
+
+private:
+	bool nextBlock()
+	{
+		while (fill())
+		{
+			if (mCur != mEnd) return true;
+		}
+		return false;
+	}
+
+	const U8* mCur;
+	const U8* mEnd;
+	const U8* mBlockStart;
+	S32 mBlockOffset;		// Bytes in the blocks before the current one.
+};
 
 /** 
  * @class LLSDParser
@@ -91,11 +191,41 @@ public:
 	 */
 	S32 parseLines(std::istream& istr, LLSD& data);
 
+	/** 
+	 * @brief Call this method to parse a contiguous buffer for LLSD.
+	 *
+	 * Like parse(), but reads the buffer in place instead of through
+	 * an istream. The binary and XML parsers never copy the data;
+	 * the notation parser reads it through an LLMemoryStream.
+	 * @param buf The data to parse.
+	 * @param size The number of bytes in buf.
+	 * @param data[out] The newly parse structured data.
+	 * @param bytes_read[out] If not NULL, the number of bytes used.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	S32 parse(const U8* buf, S32 size, LLSD& data, S32* bytes_read = NULL);
+
+	/** 
+	 * @brief Parse LLSD out of an LLSDInput, see llsdserialize.cpp.
+	 */
+	S32 parse(LLSDInput& input, LLSD& data);
+
 	/** 
 	 * @brief Resets the parser so parse() or parseLines() can be called again for another <llsd> chunk.
 	 */
 	void reset()	{ doReset();	};
 
+	/** 
+	 * @brief Parse into compact documents, see llsdcompact.h.
+	 *
+	 * Every value of a document is allocated from one arena and maps
+	 * are sorted flat vectors with interned keys. Use this for large
+	 * documents that are mostly read, like mesh headers.
+	 * Only the binary and XML parsers build compact maps.
+	 */
+	void setCompact(bool compact)	{ mCompact = compact; }
+
 
 protected:
 	/** 
@@ -114,6 +244,17 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const = 0;
 
+	/** 
+	 * @brief Virtual default function for parsing a buffer.
+	 *
+	 * Wraps the input in an LLMemoryStream and calls doParse().
+	 * @param input The input to parse.
+	 * @param data[out] The newly parse structured data.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns PARSE_FAILURE (-1) on parse failure.
+	 */
+	virtual S32 doParseBuffer(LLSDInput& input, LLSD& data) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -215,6 +356,11 @@ protected:
 	 * @brief Use line-based reading to get text
 	 */
 	bool mParseLines;
+
+	/**
+	 * @brief Build compact documents.
+	 */
+	bool mCompact;
 };
 
 /** 
@@ -325,6 +471,11 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Feeds the buffered input to expat as it is.
+	 */
+	virtual S32 doParseBuffer(LLSDInput& input, LLSD& data) const;
+
 	/** 
 	 * @brief Virtual default function for resetting the parser
 	 */
@@ -373,33 +524,67 @@ protected:
 	 */
 	virtual S32 doParse(std::istream& istr, LLSD& data) const;
 
+	/** 
+	 * @brief Parses the buffer in place, see doParse().
+	 */
+	virtual S32 doParseBuffer(LLSDInput& input, LLSD& data) const;
+
 private:
 	/** 
-	 * @brief Parse a map from the istream
+	 * @brief Reads from an istream for doParse(), see llsdserialize.cpp.
+	 */
+	class StreamSource;
+
+	/** 
+	 * @brief Reads from an LLSDInput for doParseBuffer(), see llsdserialize.cpp.
+	 */
+	class BufferSource;
+
+	/** 
+	 * @brief Parse one value, the body of doParse() and doParseBuffer().
 	 *
-	 * @param istr The input stream.
+	 * @param source The StreamSource or BufferSource to read from.
+	 * @param data[out] The newly parse structured data.
+	 * @return Returns the number of LLSD objects parsed into
+	 * data. Returns -1 on parse failure.
+	 */
+	template<class SOURCE>
+	S32 parseValue(SOURCE& source, LLSD& data) const;
+
+	/** 
+	 * @brief Parse a map from the source.
+	 *
+	 * @param source The source to read from.
 	 * @param map The map to add the parsed data.
 	 * @return Returns The number of LLSD objects parsed into data.
 	 */
-	S32 parseMap(std::istream& istr, LLSD& map) const;
+	template<class SOURCE>
+	S32 parseMap(SOURCE& source, LLSD& map) const;
 
 	/** 
-	 * @brief Parse an array from the istream.
+	 * @brief Parse an array from the source.
 	 *
-	 * @param istr The input stream.
+	 * @param source The source to read from.
 	 * @param array The array to append the parsed data.
 	 * @return Returns The number of LLSD objects parsed into data.
 	 */
-	S32 parseArray(std::istream& istr, LLSD& array) const;
+	template<class SOURCE>
+	S32 parseArray(SOURCE& source, LLSD& array) const;
 
 	/** 
-	 * @brief Parse a string from the istream and assign it to data.
+	 * @brief Parse a string from the source and assign it to data.
 	 *
-	 * @param istr The input stream.
+	 * @param source The source to read from.
 	 * @param value[out] The string to assign.
 	 * @return Retuns true if a complete string was parsed.
 	 */
-	bool parseString(std::istream& istr, std::string& value) const;
+	template<class SOURCE>
+	bool parseString(SOURCE& source, std::string& value) const;
+
+	/**
+	 * @brief Builds the maps when parsing compact documents.
+	 */
+	mutable LLSDMapBuilder mMapBuilder;
 };
 
 
@@ -733,6 +918,11 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	static S32 fromNotation(LLSD& sd, const U8* buf, S32 size)
+	{
+		LLPointer<LLSDNotationParser> p = new LLSDNotationParser;
+		return p->parse(buf, size, sd);
+	}
 	
 	/*
 	 * XML Methods
@@ -768,6 +958,12 @@ public:
 		return fromXMLEmbedded(sd, str);
 //		return fromXMLDocument(sd, str);
 	}
+	// Parses the buffer in place, without an istream.
+	static S32 fromXML(LLSD& sd, const U8* buf, S32 size)
+	{
+		LLPointer<LLSDXMLParser> p = new LLSDXMLParser;
+		return p->parse(buf, size, sd);
+	}
 
 	/*
 	 * Binary Methods
@@ -789,10 +985,18 @@ public:
 		(void)p->parse(str, sd, max_bytes);
 		return sd;
 	}
+	// Parses the buffer in place, without an istream.
+	static S32 fromBinary(LLSD& sd, const U8* buf, S32 size)
+	{
+		LLPointer<LLSDBinaryParser> p = new LLSDBinaryParser;
+		return p->parse(buf, size, sd);
+	}
 };
 
 //dirty little zip functions -- yell at davep
 LL_COMMON_API std::string zip_llsd(LLSD& data);
 LL_COMMON_API bool unzip_llsd(LLSD& data, std::istream& is, S32 size);
+// Inflates and parses in one pass, without copying the compressed or the inflated data.
+LL_COMMON_API bool unzip_llsd(LLSD& data, const U8* in, S32 size);
 LL_COMMON_API U8* unzip_llsdNavMesh( bool& valid, unsigned int& outsize,std::istream& is, S32 size);
 #endif // LL_LLSDSERIALIZE_H
@@ -263,8 +263,11 @@ public:
 	Impl();
 	~Impl();
 	
+	void setCompact(bool compact)	{ mCompact = compact; }
+
 	S32 parse(std::istream& input, LLSD& data);
 	S32 parseLines(std::istream& input, LLSD& data);
+	S32 parseBuffer(LLSDInput& input, LLSD& data);
 
 	void parsePart(const char *buf, int len);
 	
@@ -322,10 +325,15 @@ private:
 	
 	std::string mCurrentKey;		// Current XML <tag>
 	std::string mCurrentContent;	// String data between <tag> and </tag>
+
+	bool mCompact;					// Build compact maps, see llsdcompact.h
+	LLSDMapBuilder mMapBuilder;
+	LLSD mBuildingMap;				// Stands in for compact maps until they are ended
 };
 
 
 LLSDXMLParser::Impl::Impl()
+	: mCompact(false), mBuildingMap(LLSD::emptyMap())
 {
 	mParser = XML_ParserCreate(NULL);
 	reset();
@@ -497,6 +505,38 @@ S32 LLSDXMLParser::Impl::parseLines(std::istream& input, LLSD& data)
 }
 
 
+S32 LLSDXMLParser::Impl::parseBuffer(LLSDInput& input, LLSD& data)
+{
+	XML_Status status = XML_STATUS_OK;
+	const U8* buffer;
+	S32 size;
+	while (!mGracefullStop && input.getBlock(buffer, size))
+	{
+		// Expat reads the block in place; no copy into its own buffer.
+		status = XML_Parse(mParser, (const char*)buffer, size, false);
+		if (status == XML_STATUS_ERROR)
+		{
+			break;
+		}
+	}
+
+	if (status != XML_STATUS_ERROR && !mGracefullStop)
+	{	// Parse last bit
+		status = XML_Parse(mParser, NULL, 0, true);
+	}
+
+	if (status == XML_STATUS_ERROR && !mGracefullStop)
+	{
+		llinfos << "LLSDXMLParser::Impl::parseBuffer: XML_STATUS_ERROR" << llendl;
+		data = LLSD();
+		return LLSDParser::PARSE_FAILURE;
+	}
+
+	data = mResult;
+	return mParseCount;
+}
+
+
 void LLSDXMLParser::Impl::reset()
 {
 	mResult.clear();
@@ -508,6 +548,7 @@ void LLSDXMLParser::Impl::reset()
 	mGracefullStop = false;
 
 	mStack.clear();
+	mMapBuilder.reset();
 	
 	mSkipping = false;
 	
@@ -640,9 +681,16 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 	{
 		if (mCurrentKey.empty()) { return startSkipping(); }
 		
-		LLSD& map = *mStack.back();
-		LLSD& newElement = map[mCurrentKey];
-		mStack.push_back(&newElement);		
+		if (mCompact)
+		{
+			mStack.push_back(&mMapBuilder.addKey(mCurrentKey));
+		}
+		else
+		{
+			LLSD& map = *mStack.back();
+			LLSD& newElement = map[mCurrentKey];
+			mStack.push_back(&newElement);
+		}
 
 #if( LL_WINDOWS || __GNUC__ > 2)
 		mCurrentKey.clear();
@@ -666,7 +714,15 @@ void LLSDXMLParser::Impl::startElementHandler(const XML_Char* name, const XML_Ch
 	switch (element)
 	{
 		case ELEMENT_MAP:
-			*mStack.back() = LLSD::emptyMap();
+			if (mCompact)
+			{
+				mMapBuilder.beginMap();
+				*mStack.back() = mBuildingMap;
+			}
+			else
+			{
+				*mStack.back() = LLSD::emptyMap();
+			}
 			break;
 		
 		case ELEMENT_ARRAY:
@@ -802,6 +858,14 @@ void LLSDXMLParser::Impl::endElementHandler(const XML_Char* name)
 		case ELEMENT_UNKNOWN:
 			value.clear();
 			break;
+
+		case ELEMENT_MAP:
+			if (mCompact)
+			{
+				// A repeated <key> replaces the earlier value, like operator[] does.
+				mMapBuilder.endMap(value, true);
+			}
+			break;
 			
 		default:
 			// other values, map and array, have already been set
@@ -924,6 +988,8 @@ LLSDXMLParser::~LLSDXMLParser()
 
 void LLSDXMLParser::parsePart(const char *buf, int len)
 {
+	// Not parsed inside an arena.
+	impl.setCompact(false);
 	impl.parsePart(buf, len);
 }
 
@@ -934,6 +1000,7 @@ S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data) const
 	XML_Timer timer( &parseTime );
 	#endif	// XML_PARSER_PERFORMANCE_TESTS
 
+	impl.setCompact(mCompact);
 	if (mParseLines)
 	{
 		// Use line-based reading (faster code)
@@ -943,6 +1010,13 @@ S32 LLSDXMLParser::doParse(std::istream& input, LLSD& data) const
 	return impl.parse(input, data);
 }
 
+// virtual
+S32 LLSDXMLParser::doParseBuffer(LLSDInput& input, LLSD& data) const
+{
+	impl.setCompact(mCompact);
+	return impl.parseBuffer(input, data);
+}
+
 //	virtual 
 void LLSDXMLParser::doReset()
 {
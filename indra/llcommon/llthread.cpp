@@ -303,7 +303,7 @@ void LLThread::wakeLocked()
 // The thread private handle to access the LLThreadLocalData instance.
 apr_threadkey_t* LLThreadLocalData::sThreadLocalDataKey;
 
-LLThreadLocalData::LLThreadLocalData(char const* name) : mCurlMultiHandle(NULL), mCurlErrorBuffer(NULL), mName(name)
+LLThreadLocalData::LLThreadLocalData(char const* name) : mCurlMultiHandle(NULL), mCurlErrorBuffer(NULL), mFastTimers(NULL), mName(name)
 {
 }
 
@@ -311,6 +311,7 @@ LLThreadLocalData::~LLThreadLocalData()
 {
   delete mCurlMultiHandle;
   delete [] mCurlErrorBuffer;
+  delete mFastTimers;
 }
 
 //static
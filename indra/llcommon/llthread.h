@@ -68,6 +68,7 @@ public:
 	LLVolatileAPRPool mVolatileAPRPool;
 	LLThreadLocalDataMember* mCurlMultiHandle;	// Initialized by AICurlMultiHandle::getInstance
 	char* mCurlErrorBuffer;						// NULL, or pointing to a buffer used by libcurl.
+	LLThreadLocalDataMember* mFastTimers;		// Initialized by LLFastTimer::ThreadTimers::get().
 	std::string mName;							// "main thread", or a copy of LLThread::mName.
 
 	static void init(void);
@@ -0,0 +1,448 @@
+/**
+ * @file llworkerpool.cpp
+ * @brief Work-stealing thread pool shared by LLQueuedThread subclasses
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llworkerpool.h"
+
+#include "llstl.h"
+#include "lltimer.h"	// ms_sleep()
+
+#if LL_WINDOWS
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+//============================================================================
+
+class LLWorkerPool::Worker : public LLThread
+{
+public:
+	Worker(LLWorkerPool* pool, S32 index) :
+		LLThread(llformat("WorkerPool %d", index)),
+		mPool(pool),
+		mIndex(index)
+	{
+		for (S32 i = 0; i < PRIORITY_CLASS_COUNT; ++i)
+		{
+			mCounts[i] = 0;
+		}
+	}
+
+	/*virtual*/ void run()
+	{
+		mPool->runTasks(mIndex);
+	}
+
+	LLWorkerPool* mPool;
+	S32 mIndex;
+	LLMutex mMutex;
+	std::deque<Task*> mQueues[PRIORITY_CLASS_COUNT];
+	// Sizes of mQueues, changed with mMutex locked; read without it to skip empty queues.
+	LLAtomicS32 mCounts[PRIORITY_CLASS_COUNT];
+};
+
+//----------------------------------------------------------------------------
+
+LLWorkerPool::Subsystem::Subsystem(const std::string& name, EPriorityClass priority_class, S32 max_concurrency) :
+	mName(name),
+	mPriorityClass(priority_class),
+	mMaxConcurrency(max_concurrency),
+	mActive(0),
+	mRuns(0)
+{
+}
+
+//----------------------------------------------------------------------------
+
+//static
+LLWorkerPool* LLWorkerPool::sInstance = NULL;
+
+//static
+void LLWorkerPool::initClass(S32 threads)
+{
+	llassert(sInstance == NULL);
+	if (threads > 0)
+	{
+		sInstance = new LLWorkerPool(threads);
+		llinfos << "Started worker pool with " << threads << " threads." << llendl;
+	}
+}
+
+//static
+void LLWorkerPool::cleanupClass()
+{
+	if (sInstance)
+	{
+		sInstance->dumpStats();
+		if (sInstance->stop())
+		{
+			delete sInstance;
+		}
+		else
+		{
+			// A task that is still running uses the pool: leak it rather than pull it from under the task.
+			llwarns << "Worker pool threads did not stop, leaking the pool." << llendl;
+		}
+		sInstance = NULL;
+	}
+}
+
+//static
+S32 LLWorkerPool::getDefaultThreadCount()
+{
+#if LL_WINDOWS
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	S32 processors = (S32)info.dwNumberOfProcessors;
+#else
+	S32 processors = (S32)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	return llmax(processors - 1, 1);
+}
+
+LLWorkerPool::LLWorkerPool(S32 threads) :
+	mQueued(0),
+	mSleeping(0),
+	mNextWorker(0),
+	mSteals(0),
+	mQuitting(false)
+{
+	for (S32 i = 0; i < threads; ++i)
+	{
+		mWorkers.push_back(new Worker(this, i));
+	}
+	for (S32 i = 0; i < threads; ++i)
+	{
+		mWorkers[i]->start();
+	}
+}
+
+// Waits at most this long, in all, for the workers to finish their current task.
+const F32 MAX_STOP_WAIT = 10.f;
+
+bool LLWorkerPool::stop()
+{
+	mWorkCondition.lock();
+	mQuitting = true;
+	mWorkCondition.broadcast();
+	mWorkCondition.unlock();
+
+	bool stopped = true;
+	LLTimer timer;
+	for (std::vector<Worker*>::iterator iter = mWorkers.begin(); iter != mWorkers.end(); ++iter)
+	{
+		Worker* worker = *iter;
+		while (!worker->isStopped() && timer.getElapsedTimeF32() < MAX_STOP_WAIT)
+		{
+			ms_sleep(10);
+		}
+		if (!worker->isStopped())
+		{
+			llwarns << "Worker pool thread " << worker->mIndex << " did not stop!" << llendl;
+			stopped = false;
+		}
+	}
+	return stopped;
+}
+
+// The workers must have been stopped.
+LLWorkerPool::~LLWorkerPool()
+{
+	// Tasks that never ran. Subsystems should have been shut down before the pool, so normally there are none.
+	S32 dropped = 0;
+	for (std::vector<Worker*>::iterator iter = mWorkers.begin(); iter != mWorkers.end(); ++iter)
+	{
+		Worker* worker = *iter;
+		for (S32 i = 0; i < PRIORITY_CLASS_COUNT; ++i)
+		{
+			dropped += worker->mQueues[i].size();
+			for_each(worker->mQueues[i].begin(), worker->mQueues[i].end(), DeletePointer());
+			worker->mQueues[i].clear();
+			worker->mCounts[i] = 0;
+		}
+	}
+	if (dropped)
+	{
+		llwarns << "Worker pool destroyed with " << dropped << " queued tasks." << llendl;
+	}
+	for_each(mWorkers.begin(), mWorkers.end(), DeletePointer());
+	mWorkers.clear();
+	for_each(mSubsystems.begin(), mSubsystems.end(), DeletePairedPointer());
+	mSubsystems.clear();
+}
+
+LLWorkerPool::Subsystem* LLWorkerPool::addSubsystem(const std::string& name, EPriorityClass priority_class, S32 max_concurrency)
+{
+	LLMutexLock lock(&mSubsystemMutex);
+	Subsystem*& subsystem = mSubsystems[name];
+	if (!subsystem)
+	{
+		subsystem = new Subsystem(name, priority_class, llmax(max_concurrency, 1));
+	}
+	else
+	{
+		subsystem->mPriorityClass = priority_class;
+		subsystem->mMaxConcurrency = llmax(max_concurrency, 1);
+	}
+	return subsystem;
+}
+
+LLWorkerPool::Subsystem* LLWorkerPool::getSubsystem(const std::string& name)
+{
+	LLMutexLock lock(&mSubsystemMutex);
+	subsystem_map_t::iterator iter = mSubsystems.find(name);
+	return iter == mSubsystems.end() ? NULL : iter->second;
+}
+
+bool LLWorkerPool::submit(Task* task)
+{
+	Subsystem* subsystem = task->getSubsystem();
+	if ((S32)subsystem->mActive++ >= subsystem->mMaxConcurrency || mQuitting)
+	{
+		--subsystem->mActive;
+		return false;
+	}
+	push(mNextWorker++ % mWorkers.size(), task);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+
+// The jobs of one parallelFor() call, shared by the calling thread and the
+// tasks that help it; the last one to let go deletes it.
+class LLParallelJobs
+{
+public:
+	LLParallelJobs(S32 count, LLWorkerPool::job_fn_t fn, void* data)
+	:	mFn(fn), mData(data), mCount(count)
+	{
+		mNext = 0;
+		mDone = 0;
+		mRefs = 1;
+	}
+
+	// Returns false when all the jobs have been started.
+	bool runOne()
+	{
+		S32 index = mNext++;
+		if (index >= mCount)
+		{
+			return false;
+		}
+		mFn(mData, index);
+		mDone++;
+		return true;
+	}
+
+	bool isDone() const	{ return mDone >= mCount; }
+	void ref()			{ mRefs++; }
+	void unref()		{ if (!--mRefs) delete this; }
+
+private:
+	LLWorkerPool::job_fn_t mFn;
+	void* mData;
+	S32 mCount;
+	LLAtomicS32 mNext;
+	LLAtomicS32 mDone;
+	LLAtomicS32 mRefs;
+};
+
+class LLParallelTask : public LLWorkerPool::Task
+{
+public:
+	LLParallelTask(LLWorkerPool::Subsystem* subsystem, LLParallelJobs* jobs)
+	:	LLWorkerPool::Task(subsystem), mJobs(jobs)
+	{
+		mJobs->ref();
+	}
+	/*virtual*/ ~LLParallelTask()
+	{
+		mJobs->unref();
+	}
+
+	/*virtual*/ bool run()
+	{
+		while (mJobs->runOne())
+		{
+		}
+		return false;
+	}
+
+private:
+	LLParallelJobs* mJobs;
+};
+
+void LLWorkerPool::parallelFor(Subsystem* subsystem, S32 count, job_fn_t fn, void* data)
+{
+	LLParallelJobs* jobs = new LLParallelJobs(count, fn, data);
+	S32 helpers = llmin(count - 1, getThreadCount());
+	for (S32 i = 0; i < helpers; ++i)
+	{
+		LLParallelTask* task = new LLParallelTask(subsystem, jobs);
+		if (!submit(task))
+		{
+			delete task;
+			break;
+		}
+	}
+	while (jobs->runOne())
+	{
+	}
+	// Wait for the jobs that the workers are still running.
+	while (!jobs->isDone())
+	{
+		ms_sleep(0);
+	}
+	jobs->unref();
+}
+
+//----------------------------------------------------------------------------
+
+void LLWorkerPool::push(S32 worker, Task* task)
+{
+	Worker* target = mWorkers[worker];
+	EPriorityClass priority_class = task->getSubsystem()->getPriorityClass();
+	target->mMutex.lock();
+	target->mQueues[priority_class].push_back(task);
+	target->mCounts[priority_class]++;
+	target->mMutex.unlock();
+	// The worker going to sleep increments mSleeping before it looks at mQueued,
+	// so either we see the sleeper here or it sees our task.
+	mQueued++;
+	if (mSleeping)
+	{
+		mWorkCondition.lock();
+		mWorkCondition.signal();
+		mWorkCondition.unlock();
+	}
+}
+
+// Pool thread. Own queue newest first, then steal the oldest task of the
+// other workers, for one priority class at a time.
+LLWorkerPool::Task* LLWorkerPool::pop(S32 worker)
+{
+	S32 count = (S32)mWorkers.size();
+	for (S32 priority_class = 0; priority_class < PRIORITY_CLASS_COUNT; ++priority_class)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			Worker* victim = mWorkers[(worker + i) % count];
+			std::deque<Task*>& queue = victim->mQueues[priority_class];
+			if (victim->mCounts[priority_class] == 0)	// Unlocked peek; rechecked below.
+			{
+				continue;
+			}
+			Task* task = NULL;
+			victim->mMutex.lock();
+			if (!queue.empty())
+			{
+				--victim->mCounts[priority_class];
+				if (i == 0)
+				{
+					task = queue.back();
+					queue.pop_back();
+				}
+				else
+				{
+					task = queue.front();
+					queue.pop_front();
+				}
+			}
+			victim->mMutex.unlock();
+			if (task)
+			{
+				--mQueued;
+				if (i != 0)
+				{
+					mSteals++;
+				}
+				return task;
+			}
+		}
+	}
+	return NULL;
+}
+
+// Pool thread.
+void LLWorkerPool::waitForWork()
+{
+	mWorkCondition.lock();
+	mSleeping++;
+	while (!mQueued && !mQuitting)
+	{
+		mWorkCondition.wait();
+	}
+	--mSleeping;
+	mWorkCondition.unlock();
+}
+
+// Pool thread.
+void LLWorkerPool::runTasks(S32 worker)
+{
+	while (!mQuitting)
+	{
+		Task* task = pop(worker);
+		if (!task)
+		{
+			waitForWork();
+			continue;
+		}
+		Subsystem* subsystem = task->getSubsystem();
+		subsystem->mRuns++;
+		if (task->run() && !mQuitting)
+		{
+			// Keep the slot of the subsystem, but give other tasks a turn.
+			push(worker, task);
+		}
+		else
+		{
+			delete task;
+			--subsystem->mActive;
+		}
+	}
+}
+
+void LLWorkerPool::dumpStats()
+{
+	llinfos << "Worker pool: " << mWorkers.size() << " threads, " << (S32)mQueued << " queued, "
+			<< (U32)mSteals << " steals." << llendl;
+	LLMutexLock lock(&mSubsystemMutex);
+	for (subsystem_map_t::iterator iter = mSubsystems.begin(); iter != mSubsystems.end(); ++iter)
+	{
+		Subsystem* subsystem = iter->second;
+		llinfos << "  " << subsystem->getName() << ": class " << (S32)subsystem->getPriorityClass()
+				<< ", max " << subsystem->getMaxConcurrency() << ", active " << subsystem->getActive()
+				<< ", runs " << subsystem->getRuns() << llendl;
+	}
+}
@@ -0,0 +1,160 @@
+/**
+ * @file llworkerpool.h
+ * @brief Work-stealing thread pool shared by LLQueuedThread subclasses
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLWORKERPOOL_H
+#define LL_LLWORKERPOOL_H
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "llatomic.h"
+#include "llthread.h"
+
+//============================================================================
+// A pool of threads that run tasks for several subsystems.
+//
+// Every worker has its own deques (one per priority class). A worker takes
+// its own newest task first and, when it has nothing left, steals the oldest
+// task of another worker; higher priority classes are always looked at
+// before lower ones. Each subsystem has a cap on the number of its tasks that
+// may be queued or running at the same time.
+//
+// LLQueuedThread uses the pool instead of its own thread when a subsystem
+// with the same name as the thread is registered before the thread is created.
+
+class LL_COMMON_API LLWorkerPool
+{
+public:
+	enum EPriorityClass
+	{
+		PRIORITY_CLASS_HIGH = 0,
+		PRIORITY_CLASS_NORMAL,
+		PRIORITY_CLASS_LOW,
+		PRIORITY_CLASS_COUNT
+	};
+
+	class LL_COMMON_API Subsystem
+	{
+	public:
+		Subsystem(const std::string& name, EPriorityClass priority_class, S32 max_concurrency);
+
+		const std::string& getName() const		{ return mName; }
+		EPriorityClass getPriorityClass() const	{ return mPriorityClass; }
+		S32 getMaxConcurrency() const			{ return mMaxConcurrency; }
+		S32 getActive() const					{ return mActive; }
+		U32 getRuns() const						{ return mRuns; }
+
+	private:
+		friend class LLWorkerPool;
+		std::string mName;
+		EPriorityClass mPriorityClass;
+		S32 mMaxConcurrency;
+		LLAtomicS32 mActive;		// Tasks queued or running.
+		LLAtomicU32 mRuns;			// Number of times a task of this subsystem was run.
+	};
+
+	class LL_COMMON_API Task
+	{
+	public:
+		Task(Subsystem* subsystem) : mSubsystem(subsystem) { }
+		virtual ~Task() { }
+
+		// Called on a pool thread. Return true to be queued again (keeping
+		// the slot of the subsystem), false when done; the task is deleted then.
+		virtual bool run() = 0;
+
+		Subsystem* getSubsystem() const { return mSubsystem; }
+
+	private:
+		Subsystem* mSubsystem;
+	};
+
+public:
+	// threads <= 0 disables the pool: getInstance() will return NULL.
+	static void initClass(S32 threads);
+	static void cleanupClass();
+	static LLWorkerPool* getInstance() { return sInstance; }
+	// One thread per processor, minus one for the main thread.
+	static S32 getDefaultThreadCount();
+
+	// Registers (or updates the limits of) a subsystem; MAIN THREAD, before its tasks are submitted.
+	Subsystem* addSubsystem(const std::string& name, EPriorityClass priority_class, S32 max_concurrency);
+	// Returns NULL if no subsystem with that name was added.
+	Subsystem* getSubsystem(const std::string& name);
+
+	// Any thread. Takes ownership of task, unless false is returned because
+	// the subsystem already has its maximum number of tasks queued or running.
+	bool submit(Task* task);
+
+	// A job of parallelFor(); index goes from 0 to the job count - 1.
+	typedef void (*job_fn_t)(void* data, S32 index);
+
+	// Any thread. Calls fn(data, index) for every index below count, on the
+	// calling thread and on up to count - 1 tasks of subsystem, and returns
+	// when all calls have returned. The calling thread runs jobs too, so
+	// this completes even when the subsystem or the workers are all busy.
+	void parallelFor(Subsystem* subsystem, S32 count, job_fn_t fn, void* data);
+
+	S32 getThreadCount() const { return (S32)mWorkers.size(); }
+	void dumpStats();
+
+private:
+	LLWorkerPool(S32 threads);
+	~LLWorkerPool();
+	// Tells the workers to quit and waits a bounded time for them. Returns false if some didn't stop.
+	bool stop();
+
+	class Worker;
+	void push(S32 worker, Task* task);
+	Task* pop(S32 worker);
+	void waitForWork();
+	void runTasks(S32 worker);
+
+private:
+	static LLWorkerPool* sInstance;
+
+	std::vector<Worker*> mWorkers;
+	LLCondition mWorkCondition;		// Signalled when tasks are queued.
+	LLAtomicS32 mQueued;			// Number of tasks in all deques.
+	LLAtomicS32 mSleeping;			// Number of workers waiting on mWorkCondition.
+	LLAtomicU32 mNextWorker;		// Round robin index for submits from outside the pool.
+	LLAtomicU32 mSteals;
+	volatile bool mQuitting;
+
+	LLMutex mSubsystemMutex;
+	typedef std::map<std::string, Subsystem*> subsystem_map_t;
+	subsystem_map_t mSubsystems;
+};
+
+#endif // LL_LLWORKERPOOL_H
@@ -40,8 +40,8 @@
 //============================================================================
 // Run on MAIN thread
 
-LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, bool should_pause) :
-	LLQueuedThread(name, threaded, should_pause)
+LLWorkerThread::LLWorkerThread(const std::string& name, bool threaded, bool should_pause, queue_t queue_type) :
+	LLQueuedThread(name, threaded, should_pause, queue_type)
 {
 	mDeleteMutex = new LLMutex;
 }
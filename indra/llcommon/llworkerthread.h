@@ -89,7 +89,7 @@ private:
 	LLMutex* mDeleteMutex;
 	
 public:
-	LLWorkerThread(const std::string& name, bool threaded = true, bool should_pause = false);
+	LLWorkerThread(const std::string& name, bool threaded = true, bool should_pause = false, queue_t queue_type = QUEUE_DEFAULT);
 	~LLWorkerThread();
 
 	/*virtual*/ S32 update(F32 max_time_ms);
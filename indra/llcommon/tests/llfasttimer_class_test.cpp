@@ -0,0 +1,187 @@
+/**
+ * @file llfasttimer_class_test.cpp
+ * @brief Tests for fast timers in other threads
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "../linden_common.h"
+#include <sstream>
+// Class to test
+#include "../llfasttimer.h"
+#include "../llthread.h"
+#include "../lltimer.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	LLFastTimer::DeclareTimer FTM_TEST_OUTER("Fast timer test outer");
+	LLFastTimer::DeclareTimer FTM_TEST_INNER("Fast timer test inner");
+
+	void nested_timers(S32 iterations)
+	{
+		for (S32 i = 0; i < iterations; ++i)
+		{
+			LLFastTimer outer(FTM_TEST_OUTER);
+			{
+				LLFastTimer inner(FTM_TEST_INNER);
+			}
+		}
+	}
+
+	class TimerThread : public LLThread
+	{
+	public:
+		TimerThread(const std::string& name, S32 iterations) :
+			LLThread(name), mIterations(iterations)
+		{
+		}
+
+		/*virtual*/ void run()
+		{
+			nested_timers(mIterations);
+		}
+
+		// Runs the thread to completion.
+		void runToCompletion()
+		{
+			start();
+			while (!isStopped())
+			{
+				ms_sleep(1);
+			}
+		}
+
+		S32 mIterations;
+	};
+
+	const LLFastTimer::ThreadTimings* find_thread(const std::string& name)
+	{
+		const LLFastTimer::thread_timings_list_t& threads = LLFastTimer::getThreadTimings();
+		for (LLFastTimer::thread_timings_list_t::const_iterator it = threads.begin(); it != threads.end(); ++it)
+		{
+			if (it->mThreadName == name)
+			{
+				return &*it;
+			}
+		}
+		return NULL;
+	}
+
+	const LLFastTimer::ThreadTiming* find_timing(const LLFastTimer::ThreadTimings& thread, const std::string& name)
+	{
+		const LLFastTimer::NamedTimer* timer = LLFastTimer::getTimerByName(name);
+		for (std::vector<LLFastTimer::ThreadTiming>::const_iterator it = thread.mTimings.begin(); it != thread.mTimings.end(); ++it)
+		{
+			if (it->mTimer == timer)
+			{
+				return &*it;
+			}
+		}
+		return NULL;
+	}
+
+	S32 count(const std::string& str, const std::string& what)
+	{
+		S32 result = 0;
+		for (std::string::size_type pos = str.find(what); pos != std::string::npos; pos = str.find(what, pos + 1))
+		{
+			++result;
+		}
+		return result;
+	}
+}
+
+namespace tut
+{
+	struct fasttimer_test
+	{
+		fasttimer_test()
+		{
+			LLFastTimer::reset();
+		}
+	};
+
+	typedef test_group<fasttimer_test> fasttimer_t;
+	typedef fasttimer_t::object fasttimer_object_t;
+	tut::fasttimer_t tut_fasttimer("fasttimer");
+
+	// Timers in other threads are collected per thread, with their own hierarchy.
+	template<> template<>
+	void fasttimer_object_t::test<1>()
+	{
+		TimerThread thread("FastTimerTest", 1000);
+		thread.runToCompletion();
+		nested_timers(10);
+		LLFastTimer::nextFrame();
+
+		const LLFastTimer::ThreadTimings* timings = find_thread("FastTimerTest");
+		ensure("thread collected", timings != NULL);
+		ensure("main thread not collected", find_thread("main thread") == NULL);
+		const LLFastTimer::ThreadTiming* outer = find_timing(*timings, "Fast timer test outer");
+		const LLFastTimer::ThreadTiming* inner = find_timing(*timings, "Fast timer test inner");
+		ensure("outer", outer != NULL);
+		ensure("inner", inner != NULL);
+		ensure_equals("outer calls", outer->mCalls, 1000U);
+		ensure_equals("inner calls", inner->mCalls, 1000U);
+		ensure("outer parent", outer->mParent == NULL);
+		ensure("inner parent", inner->mParent == outer->mTimer);
+
+		// Only what happened since the last frame is collected, and the thread has exited.
+		LLFastTimer::nextFrame();
+		ensure("nothing new", find_thread("FastTimerTest") == NULL);
+	}
+
+	// A trace holds the timers of every thread, between frame markers.
+	template<> template<>
+	void fasttimer_object_t::test<2>()
+	{
+		LLFastTimer::startTrace(2, "");
+		ensure("tracing", LLFastTimer::isTracing());
+		nested_timers(3);
+		TimerThread thread("FastTimerTrace", 3);
+		thread.runToCompletion();
+		LLFastTimer::nextFrame();
+		nested_timers(1);
+		LLFastTimer::nextFrame();
+		ensure("stopped", !LLFastTimer::isTracing());
+		nested_timers(1);
+
+		std::ostringstream trace;
+		LLFastTimer::writeTrace(trace);
+		std::string json = trace.str();
+		ensure("json", json.find("{\"traceEvents\":[") == 0);
+		ensure("thread name", json.find("\"args\":{\"name\":\"FastTimerTrace\"}") != std::string::npos);
+		ensure_equals("frames", count(json, "\"name\":\"Frame\""), 3);
+		ensure_equals("outer begin", count(json, "\"name\":\"Fast timer test outer\",\"ph\":\"B\""), 7);
+		ensure_equals("outer end", count(json, "\"name\":\"Fast timer test outer\",\"ph\":\"E\""), 7);
+		ensure_equals("inner begin", count(json, "\"name\":\"Fast timer test inner\",\"ph\":\"B\""), 7);
+	}
+}
@@ -0,0 +1,139 @@
+/**
+ * @file llopenhashmap_test.cpp
+ * @brief Tests for LLOpenHashMap
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "../linden_common.h"
+#include <map>
+#include <vector>
+// Class to test
+#include "../llopenhashmap.h"
+#include "../llpointer.h"
+#include "../llrefcount.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	class TestObject : public LLRefCount
+	{
+	};
+
+	typedef LLOpenHashMap<LLUUID, LLPointer<TestObject> > uuid_hash_map_t;
+
+	// (region index, local id) keys like LLViewerObjectList::setUUIDAndLocal() makes.
+	U64 make_index_key(U32 region, U32 local_id)
+	{
+		return (((U64)region) << 32) | (U64)local_id;
+	}
+}
+
+namespace tut
+{
+	struct openhashmap_test
+	{
+	};
+
+	typedef test_group<openhashmap_test> openhashmap_t;
+	typedef openhashmap_t::object openhashmap_object_t;
+	tut::openhashmap_t tut_openhashmap("openhashmap");
+
+	// Random inserts and erases give the same contents as std::map.
+	template<> template<>
+	void openhashmap_object_t::test<1>()
+	{
+		LLOpenHashMap<U64, U32> hash_map;
+		std::map<U64, U32> map;
+		U32 rand = 1;
+		for (S32 i = 0; i < 200000; ++i)
+		{
+			rand = rand * 1103515245 + 12345;
+			// Few regions and dense local ids, so that runs of slots form.
+			U64 key = make_index_key((rand >> 28) & 3, (rand >> 8) & 4095);
+			if (rand & 0x40)
+			{
+				hash_map[key] = i;
+				map[key] = i;
+			}
+			else
+			{
+				ensure_equals("erase", hash_map.erase(key), map.erase(key));
+			}
+			if ((i & 1023) == 0)
+			{
+				ensure_equals("size", hash_map.size(), map.size());
+				for (std::map<U64, U32>::iterator iter = map.begin(); iter != map.end(); ++iter)
+				{
+					LLOpenHashMap<U64, U32>::const_iterator found = hash_map.find(iter->first);
+					ensure("found", found != hash_map.end());
+					ensure_equals("value", found->second, iter->second);
+				}
+				size_t iterated = 0;
+				for (LLOpenHashMap<U64, U32>::iterator iter = hash_map.begin(); iter != hash_map.end(); ++iter)
+				{
+					ensure_equals("iterated value", map[iter->first], iter->second);
+					++iterated;
+				}
+				ensure_equals("iterated", iterated, map.size());
+			}
+		}
+		ensure("at most half full", hash_map.size() * 2 <= hash_map.capacity());
+		hash_map.clear();
+		ensure("cleared", hash_map.empty() && hash_map.find(0) == hash_map.end());
+	}
+
+	// Erasing and clearing release the values.
+	template<> template<>
+	void openhashmap_object_t::test<2>()
+	{
+		LLPointer<TestObject> object = new TestObject;
+		uuid_hash_map_t hash_map;
+		std::vector<LLUUID> ids(100);
+		for (size_t i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			hash_map[ids[i]] = object;
+		}
+		ensure_equals("referenced", object->getNumRefs(), 101);
+		ensure_equals("missing", hash_map.count(LLUUID::null), (size_t)0);
+		for (size_t i = 0; i < ids.size(); i += 2)
+		{
+			hash_map.erase(hash_map.find(ids[i]));
+		}
+		ensure_equals("erased", object->getNumRefs(), 51);
+		for (size_t i = 1; i < ids.size(); i += 2)
+		{
+			ensure("kept", hash_map.find(ids[i]) != hash_map.end());
+		}
+		hash_map.clear();
+		ensure_equals("cleared", object->getNumRefs(), 1);
+	}
+}
@@ -0,0 +1,309 @@
+/**
+ * @file llqueuedthread_test.cpp
+ * @brief Tests for LLQueuedThread
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "../linden_common.h"
+#include <vector>
+// Class to test
+#include "../llqueuedthread.h"
+#include "../lltimer.h"
+#include "../llworkerpool.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 MAX_PRODUCERS = 8;
+	const S32 REQUESTS_PER_PRODUCER = 2000;
+
+	// RetryRequests that finished; outlives the queue.
+	LLAtomicS32 sRetriesDone(0);
+
+	class TestQueuedThread : public LLQueuedThread
+	{
+	public:
+		class TestRequest : public QueuedRequest
+		{
+		public:
+			TestRequest(handle_t handle, U32 priority, TestQueuedThread* thread) :
+				QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+				mThread(thread)
+			{
+			}
+
+			/*virtual*/ bool processRequest()
+			{
+				mThread->mProcessed++;
+				if (!mThread->mThreaded)
+				{
+					mThread->mOrder.push_back(getPriority());
+				}
+				return true;
+			}
+
+			TestQueuedThread* mThread;
+		};
+
+		// Isn't done until mRelease is set; takes mDelay ms per attempt.
+		class RetryRequest : public QueuedRequest
+		{
+		public:
+			RetryRequest(handle_t handle, U32 priority, TestQueuedThread* thread) :
+				QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+				mThread(thread)
+			{
+			}
+
+			/*virtual*/ bool processRequest()
+			{
+				mThread->mAttempts++;
+				if (mThread->mDelay)
+				{
+					ms_sleep(mThread->mDelay);
+				}
+				if (!mThread->mRelease)
+				{
+					return false;
+				}
+				mThread->mProcessed++;
+				sRetriesDone++;
+				return true;
+			}
+
+			TestQueuedThread* mThread;
+		};
+
+		TestQueuedThread(bool threaded, queue_t queue_type) :
+			LLQueuedThread("QueuedThreadTest", threaded, false, queue_type),
+			mProcessed(0),
+			mAttempts(0),
+			mDelay(0),
+			mRelease(false)
+		{
+		}
+
+		handle_t addRetry(U32 priority)
+		{
+			handle_t handle = generateHandle();
+			addRequest(new RetryRequest(handle, priority, this));
+			return handle;
+		}
+
+		handle_t add(U32 priority)
+		{
+			handle_t handle = generateHandle();
+			addRequest(new TestRequest(handle, priority, this));
+			return handle;
+		}
+
+		LLAtomicS32 mProcessed;
+		std::vector<U32> mOrder;	// Only filled when not threaded.
+		LLAtomicS32 mAttempts;		// RetryRequest::processRequest() calls.
+		U32 mDelay;
+		volatile bool mRelease;
+	};
+
+	// Adds requests as fast as it can, bumping the priority of every fourth one
+	// like LLTextureFetch does when a texture becomes more important.
+	class ProducerThread : public LLThread
+	{
+	public:
+		ProducerThread(TestQueuedThread* queue, S32 seed) :
+			LLThread("QueuedThreadProducer"), mQueue(queue), mSeed(seed), mDone(false)
+		{
+		}
+
+		/*virtual*/ void run()
+		{
+			U32 rand = mSeed;
+			for (S32 i = 0; i < REQUESTS_PER_PRODUCER; ++i)
+			{
+				rand = rand * 1103515245 + 12345;
+				LLQueuedThread::handle_t handle = mQueue->add(LLQueuedThread::PRIORITY_LOW + (rand >> 8) % LLQueuedThread::PRIORITY_HIGH);
+				if ((i & 3) == 0)
+				{
+					mQueue->setPriority(handle, LLQueuedThread::PRIORITY_HIGH | (rand & LLQueuedThread::PRIORITY_LOWBITS));
+				}
+			}
+			mDone = true;
+		}
+
+		TestQueuedThread* mQueue;
+		S32 mSeed;
+		volatile bool mDone;
+	};
+
+	// Returns the number of requests processed with the given number of producers.
+	S32 run_producers(LLQueuedThread::queue_t queue_type, S32 producers)
+	{
+		TestQueuedThread queue(true, queue_type);
+		std::vector<ProducerThread*> threads;
+		for (S32 i = 0; i < producers; ++i)
+		{
+			threads.push_back(new ProducerThread(&queue, i + 1));
+		}
+		LLTimer timer;
+		for (S32 i = 0; i < producers; ++i)
+		{
+			threads[i]->start();
+		}
+		S32 total = producers * REQUESTS_PER_PRODUCER;
+		while (queue.mProcessed < total && timer.getElapsedTimeF32() < 60.f)
+		{
+			queue.update(0);
+			ms_sleep(1);
+		}
+		for (S32 i = 0; i < producers; ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		return queue.mProcessed;
+	}
+}
+
+namespace tut
+{
+	struct queuedthread_test
+	{
+	};
+
+	typedef test_group<queuedthread_test> queuedthread_t;
+	typedef queuedthread_t::object queuedthread_object_t;
+	tut::queuedthread_t tut_queuedthread("queuedthread");
+
+	// Both queue types hand out requests highest priority first, including after setPriority().
+	template<> template<>
+	void queuedthread_object_t::test<1>()
+	{
+		for (S32 type = LLQueuedThread::QUEUE_SORTED; type <= LLQueuedThread::QUEUE_LOCKFREE; ++type)
+		{
+			TestQueuedThread queue(false, (LLQueuedThread::queue_t)type);
+			queue.add(LLQueuedThread::PRIORITY_LOW + 5);
+			queue.add(LLQueuedThread::PRIORITY_URGENT);
+			LLQueuedThread::handle_t handle = queue.add(LLQueuedThread::PRIORITY_NORMAL + 7);
+			queue.add(LLQueuedThread::PRIORITY_NORMAL + 9);
+			queue.add(LLQueuedThread::PRIORITY_LOW);
+			ensure_equals("found right after adding", queue.getRequestStatus(handle), LLQueuedThread::STATUS_QUEUED);
+			queue.setPriority(handle, LLQueuedThread::PRIORITY_HIGH);
+			ensure_equals("getPending", queue.getPending(), 5);
+
+			queue.update(0);
+			ensure_equals("all processed", (S32)queue.mProcessed, 5);
+			ensure_equals("nothing pending", queue.getPending(), 0);
+			ensure_equals("order size", queue.mOrder.size(), (size_t)5);
+			ensure_equals("order 0", queue.mOrder[0], (U32)LLQueuedThread::PRIORITY_URGENT);
+			ensure_equals("order 1", queue.mOrder[1], (U32)LLQueuedThread::PRIORITY_HIGH);
+			ensure_equals("order 2", queue.mOrder[2], (U32)LLQueuedThread::PRIORITY_NORMAL + 9);
+			ensure_equals("order 3", queue.mOrder[3], (U32)LLQueuedThread::PRIORITY_LOW + 5);
+			ensure_equals("order 4", queue.mOrder[4], (U32)LLQueuedThread::PRIORITY_LOW);
+		}
+	}
+
+	// With 1..N producer threads every request is processed exactly once.
+	template<> template<>
+	void queuedthread_object_t::test<2>()
+	{
+		for (S32 producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+		{
+			ensure_equals("QUEUE_SORTED: processed", run_producers(LLQueuedThread::QUEUE_SORTED, producers),
+						  producers * REQUESTS_PER_PRODUCER);
+			ensure_equals("QUEUE_LOCKFREE: processed", run_producers(LLQueuedThread::QUEUE_LOCKFREE, producers),
+						  producers * REQUESTS_PER_PRODUCER);
+		}
+	}
+
+	// Requests are spread over the worker pool when a subsystem with the thread's name exists.
+	template<> template<>
+	void queuedthread_object_t::test<3>()
+	{
+		const S32 POOL_THREADS = 4;
+		LLWorkerPool::initClass(POOL_THREADS);
+		LLWorkerPool::getInstance()->addSubsystem("QueuedThreadTest", LLWorkerPool::PRIORITY_CLASS_NORMAL, POOL_THREADS);
+		for (S32 type = LLQueuedThread::QUEUE_SORTED; type <= LLQueuedThread::QUEUE_LOCKFREE; ++type)
+		{
+			ensure_equals("pooled: processed", run_producers((LLQueuedThread::queue_t)type, MAX_PRODUCERS),
+						  MAX_PRODUCERS * REQUESTS_PER_PRODUCER);
+		}
+		LLWorkerPool::cleanupClass();
+	}
+
+	// On the pool an unfinished low priority request waits for the next update()
+	// instead of being retried in a loop, and destruction waits for running tasks.
+	template<> template<>
+	void queuedthread_object_t::test<4>()
+	{
+		LLWorkerPool::initClass(2);
+		LLWorkerPool::Subsystem* subsystem =
+			LLWorkerPool::getInstance()->addSubsystem("QueuedThreadTest", LLWorkerPool::PRIORITY_CLASS_NORMAL, 2);
+		{
+			TestQueuedThread queue(true, LLQueuedThread::QUEUE_LOCKFREE);
+			queue.addRetry(LLQueuedThread::PRIORITY_LOW);
+			queue.update(0);
+			// A task that retried in a loop would never leave the pool.
+			LLTimer timer;
+			while ((queue.mAttempts == 0 || subsystem->getActive()) && timer.getElapsedTimeF32() < 10.f)
+			{
+				ms_sleep(1);
+			}
+			ensure_equals("backed off", subsystem->getActive(), 0);
+			ensure("attempted", queue.mAttempts >= 1 && queue.mAttempts <= 2);
+			ensure_equals("not processed", (S32)queue.mProcessed, 0);
+			queue.mRelease = true;
+			timer.reset();
+			while (queue.mProcessed == 0 && timer.getElapsedTimeF32() < 10.f)
+			{
+				queue.update(0);
+				ms_sleep(1);
+			}
+			ensure_equals("processed after update", (S32)queue.mProcessed, 1);
+		}
+		sRetriesDone = 0;
+		TestQueuedThread* queue = new TestQueuedThread(true, LLQueuedThread::QUEUE_LOCKFREE);
+		queue->mDelay = 200;
+		queue->mRelease = true;
+		queue->addRetry(LLQueuedThread::PRIORITY_NORMAL);
+		queue->update(0);
+		LLTimer timer;
+		while (queue->mAttempts == 0 && timer.getElapsedTimeF32() < 10.f)
+		{
+			ms_sleep(1);
+		}
+		ensure_equals("request running", (S32)queue->mAttempts, 1);
+		delete queue;	// Must not return before the request has finished.
+		ensure_equals("finished before delete returned", (S32)sRetriesDone, 1);
+		LLWorkerPool::cleanupClass();
+	}
+}
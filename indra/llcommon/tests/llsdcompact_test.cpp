@@ -0,0 +1,282 @@
+/**
+ * @file llsdcompact_test.cpp
+ * @brief Tests for compact LLSD documents
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "../linden_common.h"
+#include <sstream>
+// Class to test
+#include "../llsdcompact.h"
+#include "../llsdserialize.h"
+#include "../lluuid.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 INVENTORY_ITEMS = 100;
+
+	const char* const MESH_LODS[] = { "lowest_lod", "low_lod", "medium_lod", "high_lod", "physics_convex", "physics_mesh", "skin" };
+	const S32 MESH_LOD_COUNT = LL_ARRAY_SIZE(MESH_LODS);
+
+	// What LLMeshRepoThread::headerReceived() gets.
+	LLSD make_mesh_header()
+	{
+		LLSD header;
+		S32 offset = 0;
+		for (S32 i = 0; i < MESH_LOD_COUNT; ++i)
+		{
+			header[MESH_LODS[i]]["offset"] = offset;
+			header[MESH_LODS[i]]["size"] = 1000 + i * 517;
+			offset += 1000 + i * 517;
+		}
+		header["version"] = 1;
+		header["creator"] = LLUUID::generateNewID();
+		header["date"] = LLDate(1325376000.0);
+		return header;
+	}
+
+	// What a FetchInventoryDescendents2 capability returns for one folder.
+	LLSD make_inventory_response()
+	{
+		LLSD folder;
+		folder["folder_id"] = LLUUID::generateNewID();
+		folder["owner_id"] = LLUUID::generateNewID();
+		folder["agent_id"] = folder["owner_id"];
+		folder["version"] = 42;
+		folder["descendents"] = INVENTORY_ITEMS;
+		folder["categories"] = LLSD::emptyArray();
+		for (S32 i = 0; i < INVENTORY_ITEMS; ++i)
+		{
+			LLSD item;
+			item["item_id"] = LLUUID::generateNewID();
+			item["parent_id"] = folder["folder_id"];
+			item["asset_id"] = LLUUID::generateNewID();
+			item["name"] = llformat("Inventory item %d", i);
+			item["desc"] = "(No Description)";
+			item["type"] = 6;
+			item["inv_type"] = 6;
+			item["flags"] = 0;
+			item["created_at"] = 1325376000 + i;
+			item["sale_info"]["sale_price"] = 10;
+			item["sale_info"]["sale_type"] = 0;
+			LLSD& permissions = item["permissions"];
+			permissions["creator_id"] = folder["owner_id"];
+			permissions["owner_id"] = folder["owner_id"];
+			permissions["last_owner_id"] = folder["owner_id"];
+			permissions["group_id"] = LLUUID::null;
+			permissions["is_owner_group"] = false;
+			permissions["base_mask"] = (S32)0x7fffffff;
+			permissions["owner_mask"] = (S32)0x7fffffff;
+			permissions["group_mask"] = 0;
+			permissions["everyone_mask"] = 0;
+			permissions["next_owner_mask"] = (S32)0x82000;
+			folder["items"].append(item);
+		}
+		LLSD response;
+		response["folders"].append(folder);
+		return response;
+	}
+
+	LLSD parse(const std::string& data, bool xml, bool compact)
+	{
+		std::istringstream stream(data);
+		LLPointer<LLSDParser> parser;
+		if (xml)
+		{
+			parser = new LLSDXMLParser;
+		}
+		else
+		{
+			parser = new LLSDBinaryParser;
+		}
+		parser->setCompact(compact);
+		LLSD result;
+		parser->parse(stream, result, data.size());
+		return result;
+	}
+
+	std::string to_notation(const LLSD& sd)
+	{
+		std::ostringstream stream;
+		LLSDSerialize::toNotation(sd, stream);
+		return stream.str();
+	}
+
+	// The lookups LLMeshRepoThread does on a header.
+	S32 read_mesh_header(const LLSD& header)
+	{
+		S32 total = header["version"].asInteger();
+		for (S32 i = 0; i < MESH_LOD_COUNT; ++i)
+		{
+			const LLSD& lod = header[MESH_LODS[i]];
+			total += lod["offset"].asInteger() + lod["size"].asInteger();
+		}
+		return total;
+	}
+
+	// The lookups LLInventoryModelFetchDescendentsResponder does on a response.
+	S32 read_inventory_response(const LLSD& response)
+	{
+		S32 total = 0;
+		const LLSD& folder = response["folders"][0];
+		total += folder["version"].asInteger();
+		const LLSD& items = folder["items"];
+		for (LLSD::array_const_iterator iter = items.beginArray(); iter != items.endArray(); ++iter)
+		{
+			const LLSD& item = *iter;
+			total += item["item_id"].asUUID().isNull() ? 0 : 1;
+			total += item["name"].asString().size();
+			total += item["type"].asInteger() + item["inv_type"].asInteger() + item["flags"].asInteger();
+			total += item["sale_info"]["sale_price"].asInteger();
+			total += item["permissions"]["owner_mask"].asInteger() & 0xff;
+		}
+		return total;
+	}
+}
+
+namespace tut
+{
+	struct sdcompact_test
+	{
+	};
+
+	typedef test_group<sdcompact_test> sdcompact_t;
+	typedef sdcompact_t::object sdcompact_object_t;
+	tut::sdcompact_t tut_sdcompact("sdcompact");
+
+	// A compact parse gives the same document as a normal one, for both formats.
+	template<> template<>
+	void sdcompact_object_t::test<1>()
+	{
+		LLSD header = make_mesh_header();
+		LLSD response = make_inventory_response();
+		std::ostringstream binary;
+		LLSDSerialize::toBinary(header, binary);
+		std::ostringstream xml;
+		LLSDSerialize::toXML(response, xml);
+
+		LLSD compact_header = parse(binary.str(), false, true);
+		ensure_equals("binary", to_notation(compact_header), to_notation(header));
+		ensure_equals("binary lookups", read_mesh_header(compact_header), read_mesh_header(header));
+		ensure("has", compact_header.has("skin") && !compact_header.has("skinny"));
+		ensure_equals("size", compact_header.size(), MESH_LOD_COUNT + 3);
+
+		LLSD compact_response = parse(xml.str(), true, true);
+		ensure_equals("xml", to_notation(compact_response), to_notation(response));
+		ensure_equals("xml lookups", read_inventory_response(compact_response), read_inventory_response(response));
+
+		std::ostringstream inventory_binary;
+		LLSDSerialize::toBinary(response, inventory_binary);
+		compact_response = parse(inventory_binary.str(), false, true);
+		ensure_equals("binary inventory", to_notation(compact_response), to_notation(response));
+	}
+
+	// Writes copy on write and adding a key turns a compact map into a normal one.
+	template<> template<>
+	void sdcompact_object_t::test<2>()
+	{
+		std::ostringstream binary;
+		LLSDSerialize::toBinary(make_mesh_header(), binary);
+		LLSD header = parse(binary.str(), false, true);
+		LLSD copy = header;
+		copy["skin"]["size"] = 1;
+		ensure_equals("copy changed", copy["skin"]["size"].asInteger(), 1);
+		ensure("original unchanged", header["skin"]["size"].asInteger() != 1);
+
+		copy["404"] = 1;
+		ensure_equals("added", copy["404"].asInteger(), 1);
+		ensure_equals("added size", copy.size(), header.size() + 1);
+		copy.erase("version");
+		ensure("erased", !copy.has("version") && header.has("version"));
+
+		// A value outlives the rest of its document.
+		LLSD lod = header["high_lod"];
+		header.clear();
+		copy.clear();
+		ensure_equals("kept value", lod["offset"].asInteger() + lod["size"].asInteger() > 0, true);
+	}
+
+	// Duplicate keys: binary keeps the first value like map.insert(), XML the last one like operator[].
+	template<> template<>
+	void sdcompact_object_t::test<3>()
+	{
+		std::string xml("<llsd><map><key>a</key><integer>1</integer><key>a</key><integer>2</integer>"
+						"<key>long</key><string>" + std::string(500, 'x') + "</string></map></llsd>");
+		LLSD normal = parse(xml, true, false);
+		LLSD compact = parse(xml, true, true);
+		ensure_equals("xml duplicate", compact["a"].asInteger(), normal["a"].asInteger());
+		ensure_equals("xml long string", compact["long"].asString(), normal["long"].asString());
+
+		const char duplicates[] = "{\0\0\0\2k\0\0\0\1ai\0\0\0\1k\0\0\0\1ai\0\0\0\2}";
+		std::string binary(duplicates, sizeof(duplicates) - 1);
+		normal = parse(binary, false, false);
+		compact = parse(binary, false, true);
+		ensure_equals("binary duplicate", compact["a"].asInteger(), normal["a"].asInteger());
+
+		// A failed parse doesn't leak into the next document of the same parser.
+		LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+		parser->setCompact(true);
+		std::istringstream truncated(binary.substr(0, 20));
+		LLSD result;
+		ensure("truncated", parser->parse(truncated, result, 20) <= 0);
+		std::istringstream complete(binary);
+		ensure("complete", parser->parse(complete, result, binary.size()) > 0);
+		ensure_equals("after failure", result.size(), 1);
+	}
+
+	// Changing values of a compact map doesn't invalidate its const iterators,
+	// and the next iteration sees the new values.
+	template<> template<>
+	void sdcompact_object_t::test<4>()
+	{
+		std::ostringstream binary;
+		LLSDSerialize::toBinary(make_mesh_header(), binary);
+		LLSD header = parse(binary.str(), false, true);
+		const LLSD& const_header = header;
+		S32 count = 0;
+		for (LLSD::map_const_iterator iter = const_header.beginMap(); iter != const_header.endMap(); ++iter, ++count)
+		{
+			header["version"] = count;
+			ensure("key", !iter->first.empty());
+		}
+		ensure_equals("iterated", count, header.size());
+		ensure_equals("changed", header["version"].asInteger(), count - 1);
+
+		LLSD::map_const_iterator iter = const_header.beginMap();
+		while (iter != const_header.endMap() && iter->first != "version")
+		{
+			++iter;
+		}
+		ensure("found", iter != const_header.endMap());
+		ensure_equals("iterated value", iter->second.asInteger(), count - 1);
+	}
+}
@@ -0,0 +1,236 @@
+/**
+ * @file llsdserialize_test.cpp
+ * @brief Tests for parsing LLSD out of buffers
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "../linden_common.h"
+#include <sstream>
+// Class to test
+#include "../llsdserialize.h"
+#include "../lluuid.h"
+#ifdef LL_STANDALONE
+# include <zlib.h>
+#else
+# include "zlib/zlib.h"
+#endif
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	// A FetchInventoryDescendents2 like response with every LLSD type in it.
+	LLSD make_document(S32 items)
+	{
+		LLSD folder;
+		folder["folder_id"] = LLUUID::generateNewID();
+		folder["version"] = 42;
+		folder["date"] = LLDate(1325376000.0);
+		folder["uri"] = LLURI("http://example.com/cap/0123");
+		folder["undefined"] = LLSD();
+		folder["real"] = 3.25;
+		for (S32 i = 0; i < items; ++i)
+		{
+			LLSD item;
+			item["item_id"] = LLUUID::generateNewID();
+			item["name"] = llformat("Item %d with an \"escaped\"\tname", i);
+			item["type"] = i % 24;
+			item["is_owner_group"] = (i & 1) != 0;
+			item["permissions"]["owner_mask"] = (S32)0x7fffffff;
+			item["permissions"]["group_mask"] = 0;
+			folder["items"].append(item);
+		}
+		return folder;
+	}
+
+	// What a mesh LOD block holds: faces with binary vertex data.
+	LLSD make_mesh_lod(S32 faces)
+	{
+		LLSD lod;
+		for (S32 i = 0; i < faces; ++i)
+		{
+			LLSD face;
+			// Quantized positions compress about as badly as noise does.
+			std::vector<U8> positions(6 * 1024);
+			U32 rand = i + 1;
+			for (U32 j = 0; j < positions.size(); ++j)
+			{
+				rand = rand * 1103515245 + 12345;
+				positions[j] = (U8)(rand >> 16);
+			}
+			face["Position"] = positions;
+			face["PositionDomain"]["Min"].append(-0.5);
+			face["PositionDomain"]["Max"].append(0.5);
+			std::vector<U8> triangles(3 * 1024);
+			for (U32 j = 0; j < triangles.size(); ++j)
+			{
+				triangles[j] = (U8)(j / 3 + j % 3);
+			}
+			face["TriangleList"] = triangles;
+			lod.append(face);
+		}
+		return lod;
+	}
+
+	std::string to_notation(const LLSD& sd)
+	{
+		std::ostringstream stream;
+		LLSDSerialize::toNotation(sd, stream);
+		return stream.str();
+	}
+
+	std::string to_binary(const LLSD& sd)
+	{
+		std::ostringstream stream;
+		LLSDSerialize::toBinary(sd, stream);
+		return stream.str();
+	}
+
+	const U8* bytes(const std::string& str)
+	{
+		return (const U8*)str.data();
+	}
+
+	// Like zip_llsd(), with the header that old uploads have in front of the LLSD.
+	std::string zip_llsd_with_header(const LLSD& sd)
+	{
+		std::string raw = "<? LLSD/Binary ?>\n" + to_binary(sd);
+		uLongf size = compressBound(raw.size());
+		std::string zipped(size, '\0');
+		compress((Bytef*)&zipped[0], &size, bytes(raw), raw.size());
+		zipped.resize(size);
+		return zipped;
+	}
+
+	// What callers did before: copy the data into a string and unzip an istringstream.
+	bool unzip_stream(const std::string& data, LLSD& sd)
+	{
+		std::string copy(data);
+		std::istringstream stream(copy);
+		return unzip_llsd(sd, stream, copy.size());
+	}
+}
+
+namespace tut
+{
+	struct sdserialize_test
+	{
+	};
+
+	typedef test_group<sdserialize_test> sdserialize_t;
+	typedef sdserialize_t::object sdserialize_object_t;
+	tut::sdserialize_t tut_sdserialize("sdserialize");
+
+	// Parsing a buffer gives the same result as parsing a stream, for every format.
+	template<> template<>
+	void sdserialize_object_t::test<1>()
+	{
+		LLSD document = make_document(20);
+		std::string expected = to_notation(document);
+
+		std::string binary = to_binary(document);
+		LLSD sd;
+		ensure("binary", LLSDSerialize::fromBinary(sd, bytes(binary), binary.size()) > 0);
+		ensure_equals("binary result", to_notation(sd), expected);
+
+		// Notation-style strings and keys inside binary LLSD.
+		std::string quoted("{\0\0\0\1'k\\x41'\"a\\tb\"}", 19);
+		ensure("quoted", LLSDSerialize::fromBinary(sd, bytes(quoted), quoted.size()) > 0);
+		ensure_equals("quoted result", sd["kA"].asString(), std::string("a\tb"));
+
+		std::ostringstream xml;
+		LLSDSerialize::toXML(document, xml);
+		ensure("xml", LLSDSerialize::fromXML(sd, bytes(xml.str()), xml.str().size()) > 0);
+		ensure_equals("xml result", to_notation(sd), expected);
+
+		ensure("notation", LLSDSerialize::fromNotation(sd, bytes(expected), expected.size()) > 0);
+		ensure_equals("notation result", to_notation(sd), expected);
+	}
+
+	// bytes_read stops at the end of the document, like the stream position does.
+	template<> template<>
+	void sdserialize_object_t::test<2>()
+	{
+		std::string binary = to_binary(make_document(3));
+		std::string data = binary + "trailing LOD data";
+		LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+		LLSD sd;
+		S32 bytes_read = 0;
+		ensure("parse", parser->parse(bytes(data), data.size(), sd, &bytes_read) > 0);
+		ensure_equals("bytes_read", bytes_read, (S32)binary.size());
+
+		// Every truncation fails cleanly.
+		for (U32 size = 0; size < binary.size(); ++size)
+		{
+			ensure(llformat("truncated at %d", size).c_str(), LLSDSerialize::fromBinary(sd, bytes(binary), size) <= 0);
+		}
+
+		// A string size that can't be right is rejected before allocating it.
+		std::string bogus("s\x7f\xff\xff\xffabc", 8);
+		ensure("bogus size", LLSDSerialize::fromBinary(sd, bytes(bogus), bogus.size()) <= 0);
+
+		// Streams go through the same parser code and fail the same way.
+		for (U32 size = 0; size < binary.size(); ++size)
+		{
+			std::istringstream stream(binary.substr(0, size));
+			ensure(llformat("truncated stream at %d", size).c_str(), LLSDSerialize::fromBinary(sd, stream, size) <= 0);
+		}
+		std::istringstream bogus_stream(bogus);
+		ensure("bogus size stream", LLSDSerialize::fromBinary(sd, bogus_stream, bogus.size()) <= 0);
+		std::istringstream stream(data);
+		ensure("stream", LLSDSerialize::fromBinary(sd, stream, data.size()) > 0);
+		ensure_equals("stream position", (S32)stream.tellg(), (S32)binary.size());
+	}
+
+	// unzip_llsd() from a buffer inflates and parses in one pass.
+	template<> template<>
+	void sdserialize_object_t::test<3>()
+	{
+		LLSD lod = make_mesh_lod(4);
+		std::string zipped = zip_llsd(lod);
+		LLSD sd;
+		ensure("unzip", unzip_llsd(sd, bytes(zipped), zipped.size()));
+		ensure_equals("unzip result", to_notation(sd), to_notation(lod));
+		ensure("unzip stream", unzip_stream(zipped, sd));
+		ensure_equals("unzip stream result", to_notation(sd), to_notation(lod));
+
+		// With the deprecated header in front of the binary LLSD.
+		LLSD small = make_document(2);
+		std::string with_header = zip_llsd_with_header(small);
+		ensure("deprecated header", unzip_llsd(sd, bytes(with_header), with_header.size()));
+		ensure_equals("deprecated header result", to_notation(sd), to_notation(small));
+
+		// Truncated or corrupt compressed data fails.
+		ensure("truncated", !unzip_llsd(sd, bytes(zipped), zipped.size() / 2));
+		std::string corrupt(zipped);
+		corrupt[corrupt.size() / 2] ^= 0x55;
+		ensure("corrupt", !unzip_llsd(sd, bytes(corrupt), corrupt.size()));
+	}
+}
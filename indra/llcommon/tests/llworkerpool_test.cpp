@@ -0,0 +1,129 @@
+/**
+ * @file llworkerpool_test.cpp
+ * @brief Tests for LLWorkerPool
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "../linden_common.h"
+#include <vector>
+// Class to test
+#include "../lltimer.h"
+#include "../llworkerpool.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	// Counts how often every index was run.
+	void count_job(void* data, S32 index)
+	{
+		(*(std::vector<S32>*)data)[index]++;
+	}
+
+	// Returns true if every one of count indices was run exactly once.
+	bool run_parallel_for(LLWorkerPool::Subsystem* subsystem, S32 count)
+	{
+		std::vector<S32> runs(count + 1, 0);
+		LLWorkerPool::getInstance()->parallelFor(subsystem, count, count_job, &runs);
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (runs[i] != 1)
+			{
+				return false;
+			}
+		}
+		return runs[count] == 0;
+	}
+
+	// Keeps the only slot of its subsystem until released.
+	class BlockingTask : public LLWorkerPool::Task
+	{
+	public:
+		BlockingTask(LLWorkerPool::Subsystem* subsystem, volatile bool* release) :
+			LLWorkerPool::Task(subsystem), mRelease(release)
+		{
+		}
+
+		/*virtual*/ bool run()
+		{
+			while (!*mRelease)
+			{
+				ms_sleep(1);
+			}
+			return false;
+		}
+
+		volatile bool* mRelease;
+	};
+}
+
+namespace tut
+{
+	struct workerpool_test
+	{
+	};
+
+	typedef test_group<workerpool_test> workerpool_t;
+	typedef workerpool_t::object workerpool_object_t;
+	tut::workerpool_t tut_workerpool("workerpool");
+
+	// parallelFor() runs every job exactly once, also when no task can be
+	// submitted and the calling thread has to run all of them.
+	template<> template<>
+	void workerpool_object_t::test<1>()
+	{
+		LLWorkerPool::initClass(4);
+		LLWorkerPool* pool = LLWorkerPool::getInstance();
+		LLWorkerPool::Subsystem* subsystem = pool->addSubsystem("WorkerPoolTest", LLWorkerPool::PRIORITY_CLASS_NORMAL, 4);
+		ensure("no jobs", run_parallel_for(subsystem, 0));
+		ensure("one job", run_parallel_for(subsystem, 1));
+		for (S32 i = 0; i < 100; ++i)
+		{
+			ensure("many jobs", run_parallel_for(subsystem, 1000));
+		}
+
+		LLWorkerPool::Subsystem* full = pool->addSubsystem("WorkerPoolTestFull", LLWorkerPool::PRIORITY_CLASS_NORMAL, 1);
+		volatile bool release = false;
+		ensure("blocking task submitted", pool->submit(new BlockingTask(full, &release)));
+		ensure("calling thread only", run_parallel_for(full, 1000));
+		release = true;
+
+		// Helpers that found no job left still leave the pool by themselves.
+		LLTimer timer;
+		while ((subsystem->getActive() || full->getActive()) && timer.getElapsedTimeF32() < 10.f)
+		{
+			ms_sleep(1);
+		}
+		ensure_equals("helpers done", subsystem->getActive(), 0);
+		ensure_equals("only the blocking task ran", full->getRuns(), 1U);
+		LLWorkerPool::cleanupClass();
+	}
+}
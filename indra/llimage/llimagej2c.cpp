@@ -62,6 +62,8 @@ apr_dso_handle_t *j2cimpl_dso_handle;
 LLImageJ2CImpl* fallbackCreateLLImageJ2CImpl();
 void fallbackDestroyLLImageJ2CImpl(LLImageJ2CImpl* impl);
 const char* fallbackEngineInfoLLImageJ2CImpl();
+void fallbackInitLLImageJ2CImpl();
+void fallbackCleanupLLImageJ2CImpl();
 
 //static
 //Loads the required "create", "destroy" and "engineinfo" functions needed
@@ -164,11 +166,14 @@ void LLImageJ2C::openDSO()
 
 		j2cimpl_dso_memory_pool.destroy();
 	}
+
+	fallbackInitLLImageJ2CImpl();
 }
 
 //static
 void LLImageJ2C::closeDSO()
 {
+	fallbackCleanupLLImageJ2CImpl();
 	if ( j2cimpl_dso_handle ) apr_dso_unload(j2cimpl_dso_handle);
 	j2cimpl_dso_memory_pool.destroy();
 }
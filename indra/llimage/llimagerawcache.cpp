@@ -0,0 +1,421 @@
+/**
+ * @file llimagerawcache.cpp
+ * @brief Persistent cache of decoded images
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llimagerawcache.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+
+#ifdef LL_STANDALONE
+# include <zlib.h>
+#else
+# include "zlib/zlib.h"
+#endif
+
+// Smaller images are cheaper to decode again than to read back from a file.
+const S32 MIN_CACHED_PIXELS = 64 * 64;
+const U32 RAW_CACHE_MAGIC = 0x57524c4c;		// "LLRW"
+const U32 RAW_CACHE_VERSION = 1;
+
+struct LLImageRawCacheHeader
+{
+	U32 mMagic;
+	U32 mVersion;
+	S32 mDataSize;			// Codestream bytes this was decoded from.
+	S32 mDiscard;
+	U16 mWidth;
+	U16 mHeight;
+	S32 mComponents;
+	U32 mPayloadSize;		// Bytes following the header.
+	U32 mCompressed;		// zlib stream if non-zero.
+};
+
+//----------------------------------------------------------------------------
+
+class LLImageRawCache::WriteRequest : public LLQueuedThread::QueuedRequest
+{
+protected:
+	virtual ~WriteRequest() { }		// use deleteRequest()
+
+public:
+	WriteRequest(handle_t handle, LLImageRawCache* cache, const key_t& key, S32 data_size, LLImageRaw* raw)
+	:	QueuedRequest(handle, LLQueuedThread::PRIORITY_LOW, FLAG_AUTO_COMPLETE),
+		mCache(cache), mKey(key), mDataSize(data_size), mRaw(raw)
+	{
+	}
+
+	/*virtual*/ bool processRequest()
+	{
+		mCache->writeFile(mKey, mDataSize, mRaw);
+		mRaw = NULL;
+		return true;
+	}
+
+private:
+	LLImageRawCache* mCache;
+	key_t mKey;
+	S32 mDataSize;
+	LLPointer<LLImageRaw> mRaw;
+};
+
+//----------------------------------------------------------------------------
+
+LLImageRawCache::LLImageRawCache(bool threaded)
+:	LLQueuedThread("ImageRawCache", threaded),
+	mMaxSize(0),
+	mCompress(false),
+	mUsage(0),
+	mHits(0),
+	mMisses(0)
+{
+}
+
+LLImageRawCache::~LLImageRawCache()
+{
+	shutdown();
+}
+
+void LLImageRawCache::initCache(const std::string& dirname, S64 max_size, bool compress)
+{
+	LLMutexLock lock(&mIndexMutex);
+	mDirName = dirname;
+	mCompress = compress;
+	mMaxSize = max_size;
+	mLRU.clear();
+	mEntries.clear();
+	mUsage = 0;
+	if (!mMaxSize)
+	{
+		return;
+	}
+
+	LLFile::mkdir(mDirName);
+	const char* subdirs = "0123456789abcdef";
+	for (S32 i = 0; i < 16; i++)
+	{
+		LLFile::mkdir(mDirName + gDirUtilp->getDirDelimiter() + subdirs[i]);
+	}
+	scanDirectory();
+	evict();
+	llinfos << "Decoded image cache: " << mEntries.size() << " entries, " << (mUsage >> 20)
+			<< " of " << (mMaxSize >> 20) << " MB" << (mCompress ? ", compressed" : "") << llendl;
+}
+
+// Files are named <uuid>_<discard>.raw, in a subdirectory per first hex digit
+// like the texture cache, so the index can be rebuilt from the directory alone.
+std::string LLImageRawCache::getFileName(const key_t& key) const
+{
+	std::string idstr = key.first.asString();
+	std::string delem = gDirUtilp->getDirDelimiter();
+	return mDirName + delem + idstr[0] + delem + idstr + llformat("_%d.raw", key.second);
+}
+
+LLPointer<LLImageRaw> LLImageRawCache::read(const LLUUID& id, S32 discard, S32 data_size)
+{
+	key_t key(id, discard);
+	{
+		LLMutexLock lock(&mIndexMutex);
+		if (!mMaxSize)
+		{
+			return NULL;
+		}
+		entry_map_t::iterator iter = mEntries.find(key);
+		if (iter == mEntries.end())
+		{
+			mMisses++;
+			return NULL;
+		}
+		mLRU.splice(mLRU.begin(), mLRU, iter->second);
+	}
+
+	// A missing file is just a miss: the writer may be replacing it right now.
+	LLPointer<LLImageRaw> raw;
+	bool corrupt = false;
+	LLFILE* fp = LLFile::fopen(getFileName(key), "rb");
+	if (fp)
+	{
+		corrupt = true;
+		LLImageRawCacheHeader header;
+		if (fread(&header, sizeof(header), 1, fp) == 1 &&
+			header.mMagic == RAW_CACHE_MAGIC && header.mVersion == RAW_CACHE_VERSION &&
+			header.mDiscard == discard && header.mComponents > 0 && header.mComponents <= 4)
+		{
+			S32 raw_size = (S32)header.mWidth * header.mHeight * header.mComponents;
+			if (header.mDataSize != data_size)
+			{
+				// Decoded from another amount of data; not ours to use, but not corrupt.
+				corrupt = false;
+			}
+			else if (raw_size > 0 && (header.mCompressed || header.mPayloadSize == (U32)raw_size))
+			{
+				raw = new LLImageRaw(header.mWidth, header.mHeight, header.mComponents);
+				if (!raw->getData())
+				{
+					raw = NULL;
+					corrupt = false;
+				}
+				else if (header.mCompressed)
+				{
+					std::vector<U8> payload(header.mPayloadSize);
+					uLongf dest_len = raw_size;
+					corrupt = payload.empty() ||
+							  fread(&payload[0], payload.size(), 1, fp) != 1 ||
+							  uncompress(raw->getData(), &dest_len, &payload[0], payload.size()) != Z_OK ||
+							  dest_len != (uLongf)raw_size;
+				}
+				else
+				{
+					corrupt = fread(raw->getData(), raw_size, 1, fp) != 1;
+				}
+			}
+		}
+		LLFile::close(fp);
+	}
+
+	if (corrupt)
+	{
+		llwarns << "Decoded image cache entry " << id << " discard " << discard << " is corrupt, removing it." << llendl;
+		LLMutexLock lock(&mIndexMutex);
+		entry_map_t::iterator iter = mEntries.find(key);
+		if (iter != mEntries.end())
+		{
+			removeEntry(iter);
+		}
+		raw = NULL;
+	}
+	if (raw.isNull())
+	{
+		mMisses++;
+		return NULL;
+	}
+	mHits++;
+	return raw;
+}
+
+void LLImageRawCache::write(const LLUUID& id, S32 discard, S32 data_size, const LLImageRaw* raw)
+{
+	if (!raw || !raw->getData() || raw->getWidth() * raw->getHeight() < MIN_CACHED_PIXELS)
+	{
+		return;
+	}
+	{
+		LLMutexLock lock(&mIndexMutex);
+		if (!mMaxSize)
+		{
+			return;
+		}
+	}
+	// The caller keeps using raw, so the thread gets its own copy.
+	LLPointer<LLImageRaw> copy = new LLImageRaw(const_cast<U8*>(raw->getData()), raw->getWidth(), raw->getHeight(), raw->getComponents());
+	if (!copy->getData())
+	{
+		return;
+	}
+	WriteRequest* req = new WriteRequest(generateHandle(), this, key_t(id, discard), data_size, copy);
+	if (!addRequest(req))
+	{
+		llwarns << "LLImageRawCache::write called after shutdown" << llendl;
+	}
+}
+
+bool LLImageRawCache::writeFile(const key_t& key, S32 data_size, const LLImageRaw* raw)
+{
+	S32 raw_size = raw->getWidth() * raw->getHeight() * raw->getComponents();
+	LLImageRawCacheHeader header;
+	header.mMagic = RAW_CACHE_MAGIC;
+	header.mVersion = RAW_CACHE_VERSION;
+	header.mDataSize = data_size;
+	header.mDiscard = key.second;
+	header.mWidth = raw->getWidth();
+	header.mHeight = raw->getHeight();
+	header.mComponents = raw->getComponents();
+	header.mPayloadSize = raw_size;
+	header.mCompressed = 0;
+
+	const U8* payload = raw->getData();
+	std::vector<U8> compressed;
+	if (mCompress)
+	{
+		uLongf dest_len = compressBound(raw_size);
+		compressed.resize(dest_len);
+		if (compress2(&compressed[0], &dest_len, payload, raw_size, Z_BEST_SPEED) == Z_OK &&
+			dest_len < (uLongf)raw_size)
+		{
+			payload = &compressed[0];
+			header.mPayloadSize = dest_len;
+			header.mCompressed = 1;
+		}
+	}
+
+	// Write a temporary file first, so that readers never see a partial entry.
+	std::string filename = getFileName(key);
+	std::string tmpname = filename + ".tmp";
+	LLFILE* fp = LLFile::fopen(tmpname, "wb");
+	if (!fp)
+	{
+		return false;
+	}
+	bool ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+			  fwrite(payload, header.mPayloadSize, 1, fp) == 1;
+	ok = LLFile::close(fp) == 0 && ok;
+
+	LLMutexLock lock(&mIndexMutex);
+	entry_map_t::iterator iter = mEntries.find(key);
+	if (iter != mEntries.end())
+	{
+		mUsage -= iter->second->mSize;
+		mLRU.erase(iter->second);
+		mEntries.erase(iter);
+	}
+	LLFile::remove(filename);
+	if (!ok || LLFile::rename(tmpname, filename) != 0)
+	{
+		LLFile::remove(tmpname);
+		return false;
+	}
+	addEntry(key, sizeof(header) + header.mPayloadSize);
+	evict();
+	return true;
+}
+
+void LLImageRawCache::remove(const LLUUID& id)
+{
+	LLMutexLock lock(&mIndexMutex);
+	entry_map_t::iterator iter = mEntries.lower_bound(key_t(id, 0));
+	while (iter != mEntries.end() && iter->first.first == id)
+	{
+		removeEntry(iter++);
+	}
+}
+
+void LLImageRawCache::purgeCache(const std::string& dirname)
+{
+	LLMutexLock lock(&mIndexMutex);
+	if (dirname == mDirName)
+	{
+		while (!mEntries.empty())
+		{
+			removeEntry(mEntries.begin());
+		}
+	}
+	const char* subdirs = "0123456789abcdef";
+	for (S32 i = 0; i < 16; i++)
+	{
+		gDirUtilp->deleteFilesInDir(dirname + gDirUtilp->getDirDelimiter() + subdirs[i], "*");
+	}
+}
+
+U32 LLImageRawCache::getEntries()
+{
+	LLMutexLock lock(&mIndexMutex);
+	return (U32)mEntries.size();
+}
+
+S64 LLImageRawCache::getUsage()
+{
+	LLMutexLock lock(&mIndexMutex);
+	return mUsage;
+}
+
+//----------------------------------------------------------------------------
+// mIndexMutex must be locked for the following functions!
+
+void LLImageRawCache::scanDirectory()
+{
+	typedef std::pair<time_t, std::pair<key_t, S64> > file_info_t;
+	std::vector<file_info_t> files;
+	std::string delem = gDirUtilp->getDirDelimiter();
+	const char* subdirs = "0123456789abcdef";
+	for (S32 i = 0; i < 16; i++)
+	{
+		std::string dirname = mDirName + delem + subdirs[i];
+		std::string name;
+		LLDirIterator tmp_iter(dirname, "*.tmp");
+		while (tmp_iter.next(name))
+		{
+			// Left over by a write that didn't finish.
+			LLFile::remove(dirname + delem + name);
+		}
+		LLDirIterator iter(dirname, "*.raw");
+		while (iter.next(name))
+		{
+			std::string path = dirname + delem + name;
+			S32 discard = -1;
+			llstat stat_data;
+			if (name.size() < 42 || name[36] != '_' || !LLUUID::validate(name.substr(0, 36)) ||
+				sscanf(name.c_str() + 37, "%d", &discard) != 1 || discard < 0 || discard > MAX_DISCARD_LEVEL ||
+				LLFile::stat(path, &stat_data) != 0)
+			{
+				LLFile::remove(path);
+				continue;
+			}
+			files.push_back(file_info_t(stat_data.st_mtime, std::make_pair(key_t(LLUUID(name.substr(0, 36)), discard), (S64)stat_data.st_size)));
+		}
+	}
+	// Newest first, like they would have been used.
+	std::sort(files.begin(), files.end());
+	for (std::vector<file_info_t>::reverse_iterator iter = files.rbegin(); iter != files.rend(); ++iter)
+	{
+		mLRU.push_back(Entry(iter->second.first, iter->second.second));
+		mEntries[iter->second.first] = --mLRU.end();
+		mUsage += iter->second.second;
+	}
+}
+
+void LLImageRawCache::addEntry(const key_t& key, S64 size)
+{
+	mLRU.push_front(Entry(key, size));
+	mEntries[key] = mLRU.begin();
+	mUsage += size;
+}
+
+void LLImageRawCache::removeEntry(entry_map_t::iterator iter)
+{
+	LLFile::remove(getFileName(iter->first));
+	mUsage -= iter->second->mSize;
+	mLRU.erase(iter->second);
+	mEntries.erase(iter);
+}
+
+void LLImageRawCache::evict()
+{
+	while (mUsage > mMaxSize && !mLRU.empty())
+	{
+		removeEntry(mEntries.find(mLRU.back().mKey));
+	}
+}
@@ -0,0 +1,119 @@
+/**
+ * @file llimagerawcache.h
+ * @brief Persistent cache of decoded images
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLIMAGERAWCACHE_H
+#define LL_LLIMAGERAWCACHE_H
+
+#include <list>
+#include <map>
+#include "llatomic.h"
+#include "llimage.h"
+#include "llpointer.h"
+#include "llqueuedthread.h"
+#include "lluuid.h"
+
+// Second tier cache behind the codestream cache: keeps decoded images on disk,
+// so that textures seen in a previous session don't have to be decoded again.
+//
+// An entry is keyed by UUID and discard level, and remembers how many bytes of
+// codestream it was decoded from; a lookup only hits for the same amount of
+// data, so a cached image is always identical to what the decoder would return.
+// Entries are optionally zlib compressed, and evicted least recently used
+// first when the cache grows beyond its budget.
+//
+// Lookups are synchronous and may be done from any thread; stores are copied
+// and written by this thread.
+class LLImageRawCache : public LLQueuedThread
+{
+	class WriteRequest;
+
+public:
+	LLImageRawCache(bool threaded = true);
+	~LLImageRawCache();
+
+	// Opens the cache in dirname, creating it if needed. Until this is called,
+	// and when max_size is 0, the cache is disabled and every lookup misses.
+	void initCache(const std::string& dirname, S64 max_size, bool compress);
+	bool isEnabled() const						{ return mMaxSize > 0; }
+
+	// Returns the image decoded at discard from data_size bytes of the
+	// codestream of id, or NULL.
+	LLPointer<LLImageRaw> read(const LLUUID& id, S32 discard, S32 data_size);
+	// Stores a copy of raw, decoded at discard from data_size bytes of codestream.
+	void write(const LLUUID& id, S32 discard, S32 data_size, const LLImageRaw* raw);
+	// Removes all the discard levels of id.
+	void remove(const LLUUID& id);
+	// Removes everything stored in dirname.
+	void purgeCache(const std::string& dirname);
+
+	// Statistics
+	U32 getHits() const							{ return mHits; }
+	U32 getMisses() const						{ return mMisses; }
+	U32 getEntries();
+	S64 getUsage();
+	S64 getMaxUsage() const						{ return mMaxSize; }
+
+private:
+	typedef std::pair<LLUUID, S32> key_t;
+	struct Entry
+	{
+		Entry(const key_t& key, S64 size) : mKey(key), mSize(size) { }
+		key_t mKey;
+		S64 mSize;				// File size.
+	};
+	typedef std::list<Entry> lru_list_t;	// Most recently used first.
+	typedef std::map<key_t, lru_list_t::iterator> entry_map_t;
+
+	std::string getFileName(const key_t& key) const;
+	bool writeFile(const key_t& key, S32 data_size, const LLImageRaw* raw);
+	void scanDirectory();
+
+	// The following functions must be called with mIndexMutex locked.
+	void addEntry(const key_t& key, S64 size);
+	void removeEntry(entry_map_t::iterator iter);
+	void evict();
+
+private:
+	std::string mDirName;
+	S64 mMaxSize;
+	bool mCompress;
+
+	LLMutex mIndexMutex;
+	lru_list_t mLRU;
+	entry_map_t mEntries;
+	S64 mUsage;
+
+	LLAtomicU32 mHits;
+	LLAtomicU32 mMisses;
+};
+
+#endif // LL_LLIMAGERAWCACHE_H
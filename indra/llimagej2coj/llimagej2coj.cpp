@@ -31,11 +31,25 @@
 #include "openjpeg.h"
 
 #include "lltimer.h"
+#include "llcrc.h"
+#include "llprocessor.h"
+#include "llworkerpool.h"
 //#include "llmemory.h"
 
+// Largest resolution level kept for progressive refinement, in pixels. The
+// levels a texture goes through while it loads are small; bigger ones would
+// cost more memory than decoding them again is worth.
+const S32 MAX_REFINEMENT_SAMPLES = 256 * 256;
+// Bytes at the start and at the end of a codestream checked to recognize it.
+const S32 REFINEMENT_CRC_BYTES = 256;
+
+LLMutex LLImageJ2COJ::sDecompressorMutex;
+std::vector<opj_dinfo_t*> LLImageJ2COJ::sDecompressors;
+
 const char* fallbackEngineInfoLLImageJ2CImpl()
 {
-	static std::string version_string = std::string("OpenJPEG: ") + opj_version();
+	static std::string version_string = std::string("OpenJPEG: ") + opj_version() +
+		((opj_get_cpu_features() & OPJ_CPU_SSE2) ? " (SSE2)" : "");
 	return version_string.c_str();
 }
 
@@ -50,6 +64,16 @@ void fallbackDestroyLLImageJ2CImpl(LLImageJ2CImpl* impl)
 	impl = NULL;
 }
 
+void fallbackInitLLImageJ2CImpl()
+{
+	LLImageJ2COJ::initClass();
+}
+
+void fallbackCleanupLLImageJ2CImpl()
+{
+	LLImageJ2COJ::cleanupClass();
+}
+
 // Return string from message, eliminating final \n if present
 static std::string chomp(const char* msg)
 {
@@ -94,15 +118,130 @@ int ceildivpow2(int a, int b)
 	return (a + (1 << b) - 1) >> b;
 }
 
+// Runs the jobs of a tile decode on the worker pool, see opj_set_decode_parallel.
+static void parallel_for(void* client, int count, opj_job_fn job, void* job_data)
+{
+	LLWorkerPool::getInstance()->parallelFor((LLWorkerPool::Subsystem*)client, count, job, job_data);
+}
+
+//static
+opj_dinfo_t* LLImageJ2COJ::getDecompressor()
+{
+	opj_dinfo_t* dinfo = NULL;
+	{
+		LLMutexLock lock(&sDecompressorMutex);
+		if (!sDecompressors.empty())
+		{
+			dinfo = sDecompressors.back();
+			sDecompressors.pop_back();
+		}
+	}
+	if (dinfo && !opj_reset_decompress(dinfo))
+	{
+		opj_destroy_decompress(dinfo);
+		dinfo = NULL;
+	}
+	if (!dinfo)
+	{
+		static opj_event_mgr_t event_mgr = { error_callback, warning_callback, info_callback };
+		dinfo = opj_create_decompress(CODEC_J2K);
+		if (dinfo)
+		{
+			/* catch events using our callbacks and give a local context */
+			opj_set_event_mgr((opj_common_ptr)dinfo, &event_mgr, stderr);
+		}
+	}
+	if (dinfo)
+	{
+		LLWorkerPool* pool = LLWorkerPool::getInstance();
+		LLWorkerPool::Subsystem* subsystem = pool ? pool->getSubsystem("j2cdecode") : NULL;
+		if (subsystem)
+		{
+			opj_set_decode_parallel(dinfo, parallel_for, subsystem, pool->getThreadCount() + 1);
+		}
+		else
+		{
+			opj_set_decode_parallel(dinfo, NULL, NULL, 1);
+		}
+	}
+	return dinfo;
+}
+
+//static
+void LLImageJ2COJ::releaseDecompressor(opj_dinfo_t* dinfo)
+{
+	LLMutexLock lock(&sDecompressorMutex);
+	sDecompressors.push_back(dinfo);
+}
+
+//static
+void LLImageJ2COJ::initClass()
+{
+	// The library only enables what it was compiled with; ask the CPU about the rest.
+	LLProcessorInfo cpu_info;
+	// This runs from LLImageJ2C::openDSO(), too early for llinfos; the engine info reports it.
+	opj_set_cpu_features(cpu_info.hasSSE2() ? OPJ_CPU_SSE2 : 0);
+}
+
+//static
+void LLImageJ2COJ::cleanupClass()
+{
+	LLMutexLock lock(&sDecompressorMutex);
+	for (std::vector<opj_dinfo_t*>::iterator iter = sDecompressors.begin(); iter != sDecompressors.end(); ++iter)
+	{
+		opj_destroy_decompress(*iter);
+	}
+	sDecompressors.clear();
+}
+
+opj_refinement_t* LLImageJ2COJ::getRefinement(LLImageJ2C &base)
+{
+	// The texture fetcher decodes the same image again each time more of it
+	// has arrived; the new data starts with the data decoded before.
+	S32 data_size = base.getDataSize();
+	U32 crc = 0;
+	if (mRefinement && data_size >= mRefinementDataSize)
+	{
+		S32 head = llmin(REFINEMENT_CRC_BYTES, mRefinementDataSize);
+		S32 tail = llmin(REFINEMENT_CRC_BYTES, mRefinementDataSize - head);
+		LLCRC checksum;
+		checksum.update(base.getData(), head);
+		checksum.update(base.getData() + mRefinementDataSize - tail, tail);
+		crc = checksum.getCRC();
+	}
+	if (mRefinement && (data_size < mRefinementDataSize || crc != mRefinementCRC))
+	{
+		opj_refinement_destroy(mRefinement);
+		mRefinement = NULL;
+	}
+	if (!mRefinement)
+	{
+		mRefinement = opj_refinement_create(MAX_REFINEMENT_SAMPLES);
+	}
+
+	S32 head = llmin(REFINEMENT_CRC_BYTES, data_size);
+	S32 tail = llmin(REFINEMENT_CRC_BYTES, data_size - head);
+	LLCRC checksum;
+	checksum.update(base.getData(), head);
+	checksum.update(base.getData() + data_size - tail, tail);
+	mRefinementDataSize = data_size;
+	mRefinementCRC = checksum.getCRC();
+	return mRefinement;
+}
+
 
 LLImageJ2COJ::LLImageJ2COJ()
-	: LLImageJ2CImpl()
+	: LLImageJ2CImpl(),
+	  mRefinement(NULL),
+	  mRefinementDataSize(0),
+	  mRefinementCRC(0)
 {
 }
 
 
 LLImageJ2COJ::~LLImageJ2COJ()
 {
+	opj_refinement_destroy(mRefinement);
 }
 
 
@@ -115,19 +254,12 @@ BOOL LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
 	LLTimer decode_timer;
 
 	opj_dparameters_t parameters;	/* decompression parameters */
-	opj_event_mgr_t event_mgr;		/* event manager */
 	opj_image_t *image = NULL;
 
 	opj_dinfo_t* dinfo = NULL;	/* handle to a decompressor */
 	opj_cio_t *cio = NULL;
 
 
-	/* configure the event callbacks (not required) */
-	memset(&event_mgr, 0, sizeof(opj_event_mgr_t));
-	event_mgr.error_handler = error_callback;
-	event_mgr.warning_handler = warning_callback;
-	event_mgr.info_handler = info_callback;
-
 	/* set decoding parameters to default values */
 	opj_set_default_decoder_parameters(&parameters);
 
@@ -138,15 +270,21 @@ BOOL LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
 
 	/* JPEG-2000 codestream */
 
-	/* get a decoder handle */
-	dinfo = opj_create_decompress(CODEC_J2K);
-
-	/* catch events using our callbacks and give a local context */
-	opj_set_event_mgr((opj_common_ptr)dinfo, &event_mgr, stderr);			
+	/* get a decoder handle, with the event callbacks set */
+	dinfo = getDecompressor();
+	if (!dinfo)
+	{
+		LL_WARNS("Texture") << "ERROR -> decodeImpl: failed to create decompressor!" << LL_ENDL;
+		base.decodeFailed();
+		return TRUE; // done
+	}
 
 	/* setup the decoder decoding parameters using user parameters */
 	opj_setup_decoder(dinfo, &parameters);
 
+	/* reuse the resolution levels decoded the previous time */
+	opj_set_decode_refinement(dinfo, getRefinement(base));
+
 	/* open a byte stream */
 #if 0
 	std::vector<U8> data(base.getData(), base.getData()+base.getDataSize());
@@ -168,10 +306,14 @@ BOOL LLImageJ2COJ::decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decod
 	/* close the byte stream */
 	opj_cio_close(cio);
 
-	/* free remaining structures */
-	if(dinfo)
+	/* give the decompressor back to the pool */
+	releaseDecompressor(dinfo);
+
+	// Nothing is left to refine once the full resolution has been decoded.
+	if (base.getRawDiscardLevel() == 0)
 	{
-		opj_destroy_decompress(dinfo);
+		opj_refinement_destroy(mRefinement);
+		mRefinement = NULL;
 	}
 
 	// The image decode failed if the return was NULL or the component
@@ -33,14 +33,23 @@
 #ifndef LL_LLIMAGEJ2COJ_H
 #define LL_LLIMAGEJ2COJ_H
 
+#include <vector>
 #include "llimagej2c.h"
 
+struct opj_dinfo;
+struct opj_refinement;
+
 class LLImageJ2COJ : public LLImageJ2CImpl
 {	
 public:
 	LLImageJ2COJ();
 	virtual ~LLImageJ2COJ();
 
+	// Selects the SIMD kernels of OpenJPEG that this CPU supports.
+	static void initClass();
+	// Frees the pooled decompressors.
+	static void cleanupClass();
+
 protected:
 	/*virtual*/ BOOL getMetadata(LLImageJ2C &base);
 	/*virtual*/ BOOL decodeImpl(LLImageJ2C &base, LLImageRaw &raw_image, F32 decode_time, S32 first_channel, S32 max_channel_count);
@@ -52,6 +61,22 @@ protected:
 		return (a + (1 << b) - 1) >> b;
 	}
 
+private:
+	static struct opj_dinfo* getDecompressor();
+	static void releaseDecompressor(struct opj_dinfo* dinfo);
+	// Returns the refinement state to use for a decode of the data of base.
+	struct opj_refinement* getRefinement(LLImageJ2C &base);
+
+private:
+	// Coefficients of the resolution levels decoded so far, reused when the
+	// same codestream is decoded again with more data or a lower discard level.
+	struct opj_refinement* mRefinement;
+	S32 mRefinementDataSize;	// Size of the codestream mRefinement was made from.
+	U32 mRefinementCRC;			// CRC of the start and end of that codestream.
+
+	// Decompressors (and their T1 contexts) are reused between decodes.
+	static LLMutex sDecompressorMutex;
+	static std::vector<struct opj_dinfo*> sDecompressors;
 };
 
 #endif
@@ -0,0 +1,388 @@
+/**
+ * @file llskinning.cpp
+ * @brief Software skinning of rigged mesh vertices
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llskinning.h"
+
+#include "llmemory.h"
+#include "llworkerpool.h"
+#include "v4math.h"
+
+#if LL_WINDOWS
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#endif
+
+// From llskinningavx.cpp; NULL when the compiler wasn't asked for AVX there.
+extern LLSkinning::kernel_t ll_skinning_avx_kernel();
+
+// Vertices whose influences are decoded at a time, on the stack.
+static const S32 BLOCK_VERTICES = 64;
+
+LLSkinning::EKernel LLSkinning::sKernel = LLSkinning::KERNEL_SSE2;
+LLSkinning::kernel_t LLSkinning::sKernels[LLSkinning::KERNEL_COUNT];
+
+// LLProcessorInfo doesn't know about AVX, nor whether the OS saves the YMM
+// registers on a context switch, which it must for AVX to be usable.
+static bool cpu_has_avx()
+{
+	const U32 OSXSAVE = 1 << 27;
+	const U32 AVX = 1 << 28;
+#if LL_WINDOWS
+	int info[4];
+	__cpuid(info, 1);
+	if ((info[2] & (OSXSAVE | AVX)) != (OSXSAVE | AVX))
+	{
+		return false;
+	}
+	return (_xgetbv(0) & 6) == 6;
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || (ecx & (OSXSAVE | AVX)) != (OSXSAVE | AVX))
+	{
+		return false;
+	}
+	unsigned int xcr0, xcr0_high;
+	__asm__ __volatile__ ("xgetbv" : "=a" (xcr0), "=d" (xcr0_high) : "c" (0));
+	return (xcr0 & 6) == 6;
+#else
+	return false;
+#endif
+}
+
+// final_mat += m * w, row by row.
+static inline void add_influence(LLMatrix4a& final_mat, const LLMatrix4a& m, const LLVector4a& w)
+{
+	for (S32 r = 0; r < 4; ++r)
+	{
+		LLVector4a t;
+		t.setMul(m.mMatrix[r], w);
+		final_mat.mMatrix[r].add(t);
+	}
+}
+
+// One vertex at a time, four rows at a time.
+static void skin_sse2(const LLMatrix4a* palette, const S32* joints, const LLVector4a* weights,
+					  const LLVector4a* positions, const LLVector4a* normals, S32 count,
+					  LLVector4a* out_positions, LLVector4a* out_normals)
+{
+	for (S32 i = 0; i < count; ++i, joints += 4)
+	{
+		const LLVector4a& w = weights[i];
+		LLMatrix4a final_mat;
+		LLVector4a w0 = _mm_shuffle_ps(w, w, _MM_SHUFFLE(0, 0, 0, 0));
+		const LLMatrix4a& m0 = palette[joints[0]];
+		for (S32 r = 0; r < 4; ++r)
+		{
+			final_mat.mMatrix[r].setMul(m0.mMatrix[r], w0);
+		}
+		add_influence(final_mat, palette[joints[1]], _mm_shuffle_ps(w, w, _MM_SHUFFLE(1, 1, 1, 1)));
+		add_influence(final_mat, palette[joints[2]], _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 2, 2, 2)));
+		add_influence(final_mat, palette[joints[3]], _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 3, 3)));
+
+		final_mat.affineTransform(positions[i], out_positions[i]);
+		if (normals)
+		{
+			final_mat.rotate(normals[i], out_normals[i]);
+		}
+	}
+}
+
+// The influences of count vertices as joint indices, four per vertex, and
+// weights that add up to one. Four vertices at a time are transposed so that
+// each register holds one influence of all of them.
+static void decode_weights(const LLVector4a* weights, S32 count, S32* joints, LLVector4a* out_weights)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 max_joint = _mm_set1_ps((F32)(LLSkinning::MAX_JOINTS - 1));
+
+	S32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 w0 = weights[i];
+		__m128 w1 = weights[i + 1];
+		__m128 w2 = weights[i + 2];
+		__m128 w3 = weights[i + 3];
+		_MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+
+		// Weights are never negative, so truncating is floorf().
+		__m128 j0 = _mm_cvtepi32_ps(_mm_cvttps_epi32(w0));
+		__m128 j1 = _mm_cvtepi32_ps(_mm_cvttps_epi32(w1));
+		__m128 j2 = _mm_cvtepi32_ps(_mm_cvttps_epi32(w2));
+		__m128 j3 = _mm_cvtepi32_ps(_mm_cvttps_epi32(w3));
+		w0 = _mm_sub_ps(w0, j0);
+		w1 = _mm_sub_ps(w1, j1);
+		w2 = _mm_sub_ps(w2, j2);
+		w3 = _mm_sub_ps(w3, j3);
+
+		// Summed in the order of the reference.
+		__m128 scale = _mm_div_ps(one, _mm_add_ps(_mm_add_ps(_mm_add_ps(w0, w1), w2), w3));
+		w0 = _mm_mul_ps(w0, scale);
+		w1 = _mm_mul_ps(w1, scale);
+		w2 = _mm_mul_ps(w2, scale);
+		w3 = _mm_mul_ps(w3, scale);
+		_MM_TRANSPOSE4_PS(w0, w1, w2, w3);
+		out_weights[i] = w0;
+		out_weights[i + 1] = w1;
+		out_weights[i + 2] = w2;
+		out_weights[i + 3] = w3;
+
+		j0 = _mm_min_ps(_mm_max_ps(j0, zero), max_joint);
+		j1 = _mm_min_ps(_mm_max_ps(j1, zero), max_joint);
+		j2 = _mm_min_ps(_mm_max_ps(j2, zero), max_joint);
+		j3 = _mm_min_ps(_mm_max_ps(j3, zero), max_joint);
+		_MM_TRANSPOSE4_PS(j0, j1, j2, j3);
+		S32* dst = joints + i * 4;
+		_mm_storeu_si128((__m128i*)dst, _mm_cvttps_epi32(j0));
+		_mm_storeu_si128((__m128i*)(dst + 4), _mm_cvttps_epi32(j1));
+		_mm_storeu_si128((__m128i*)(dst + 8), _mm_cvttps_epi32(j2));
+		_mm_storeu_si128((__m128i*)(dst + 12), _mm_cvttps_epi32(j3));
+	}
+
+	for (; i < count; ++i)
+	{
+		F32 w[4];
+		F32 scale = 0.f;
+		for (S32 k = 0; k < 4; ++k)
+		{
+			F32 wk = weights[i][k];
+			joints[i * 4 + k] = llclamp((S32)floorf(wk), 0, LLSkinning::MAX_JOINTS - 1);
+			w[k] = wk - floorf(wk);
+			scale += w[k];
+		}
+		scale = 1.f / scale;
+		out_weights[i].set(w[0] * scale, w[1] * scale, w[2] * scale, w[3] * scale);
+	}
+}
+
+//static
+void LLSkinning::initClass()
+{
+	sKernels[KERNEL_SSE2] = skin_sse2;
+	sKernels[KERNEL_AVX] = cpu_has_avx() ? ll_skinning_avx_kernel() : NULL;
+	sKernel = hasKernel(KERNEL_AVX) ? KERNEL_AVX : KERNEL_SSE2;
+	llinfos << "Software skinning with " << getKernelName(sKernel) << llendl;
+}
+
+//static
+bool LLSkinning::hasKernel(EKernel kernel)
+{
+	return kernel == KERNEL_SSE2 || (kernel < KERNEL_COUNT && sKernels[kernel]);
+}
+
+//static
+void LLSkinning::setKernel(EKernel kernel)
+{
+	if (hasKernel(kernel))
+	{
+		sKernel = kernel;
+	}
+}
+
+//static
+const char* LLSkinning::getKernelName(EKernel kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SSE2:	return "SSE2";
+	case KERNEL_AVX:	return "AVX";
+	default:			return "unknown";
+	}
+}
+
+//static
+void LLSkinning::foldBindShape(const LLMatrix4a& bind_shape, const LLMatrix4a* joints, S32 count, LLMatrix4a* palette)
+{
+	for (S32 j = 0; j < count; ++j)
+	{
+		for (S32 r = 0; r < 4; ++r)
+		{
+			joints[j].rotate4(bind_shape.mMatrix[r], palette[j].mMatrix[r]);
+		}
+	}
+}
+
+//static
+void LLSkinning::skin(const LLMatrix4a* palette, const LLVector4a* weights, const LLVector4a* positions,
+					  const LLVector4a* normals, S32 count, LLVector4a* out_positions, LLVector4a* out_normals)
+{
+	kernel_t kernel = sKernels[sKernel] ? sKernels[sKernel] : skin_sse2;
+	if (!out_normals)
+	{
+		normals = NULL;
+	}
+
+	LL_ALIGN_16(S32 joints[BLOCK_VERTICES * 4]);
+	LLVector4a block_weights[BLOCK_VERTICES];
+	for (S32 i = 0; i < count; i += BLOCK_VERTICES)
+	{
+		S32 block = llmin(count - i, BLOCK_VERTICES);
+		decode_weights(weights + i, block, joints, block_weights);
+		kernel(palette, joints, block_weights, positions + i, normals ? normals + i : NULL, block,
+			   out_positions + i, normals ? out_normals + i : NULL);
+	}
+}
+
+//static
+void LLSkinning::skinReference(const LLMatrix4a* joints, const LLMatrix4a& bind_shape, const LLVector4a* weights,
+							   const LLVector4a* positions, const LLVector4a* normals, S32 count,
+							   LLVector4a* out_positions, LLVector4a* out_normals)
+{
+	for (S32 j = 0; j < count; ++j)
+	{
+		LLMatrix4a final_mat;
+		final_mat.clear();
+
+		S32 idx[4];
+
+		LLVector4 wght;
+
+		F32 scale = 0.f;
+		for (U32 k = 0; k < 4; k++)
+		{
+			F32 w = weights[j][k];
+
+			idx[k] = llclamp((S32) floorf(w), 0, 63);
+			wght[k] = w - floorf(w);
+			scale += wght[k];
+		}
+
+		// Not wght *= 1.f/scale, which leaves out the fourth weight.
+		scale = 1.f/scale;
+
+		for (U32 k = 0; k < 4; k++)
+		{
+			F32 w = wght[k] * scale;
+
+			LLMatrix4a src;
+			src.setMul(joints[idx[k]], w);
+
+			final_mat.add(src);
+		}
+
+		LLVector4a t;
+		bind_shape.affineTransform(positions[j], t);
+		final_mat.affineTransform(t, out_positions[j]);
+
+		if (normals && out_normals)
+		{
+			bind_shape.rotate(normals[j], t);
+			final_mat.rotate(t, out_normals[j]);
+		}
+	}
+}
+
+//============================================================================
+
+LLSkinningPalettes::~LLSkinningPalettes()
+{
+	for (U32 i = 0; i < mPalettes.size(); ++i)
+	{
+		ll_aligned_free_16(mPalettes[i]);
+	}
+}
+
+LLMatrix4a* LLSkinningPalettes::allocate()
+{
+	if (mUsed == mPalettes.size())
+	{
+		mPalettes.push_back((LLMatrix4a*)ll_aligned_malloc_16(sizeof(LLMatrix4a) * LLSkinning::MAX_JOINTS));
+	}
+	return mPalettes[mUsed++];
+}
+
+//============================================================================
+
+// A job of LLWorkerPool::parallelFor().
+static void skin_job(void* data, S32 index)
+{
+	const LLSkinningBatch::Job& job = ((const LLSkinningBatch::Job*)data)[index];
+	LLSkinning::skin(job.mPalette, job.mWeights, job.mPositions, job.mNormals, job.mCount,
+					 job.mOutPositions, job.mOutNormals);
+}
+
+LLSkinningBatch::LLSkinningBatch()
+:	mVertices(0),
+	mUseWorkerPool(true)
+{
+}
+
+const LLMatrix4a* LLSkinningBatch::addPalette(const LLMatrix4a& bind_shape, const LLMatrix4a* joints, S32 count)
+{
+	LLMatrix4a* palette = mPalettes.allocate();
+	LLSkinning::foldBindShape(bind_shape, joints, llmin(count, (S32)LLSkinning::MAX_JOINTS), palette);
+	return palette;
+}
+
+void LLSkinningBatch::add(const LLMatrix4a* palette, const LLVector4a* weights, const LLVector4a* positions,
+						  const LLVector4a* normals, S32 count, LLVector4a* out_positions, LLVector4a* out_normals)
+{
+	for (S32 start = 0; start < count; start += CHUNK_VERTICES)
+	{
+		Job job;
+		job.mPalette = palette;
+		job.mWeights = weights + start;
+		job.mPositions = positions + start;
+		job.mNormals = normals && out_normals ? normals + start : NULL;
+		job.mOutPositions = out_positions + start;
+		job.mOutNormals = normals && out_normals ? out_normals + start : NULL;
+		job.mCount = llmin(count - start, CHUNK_VERTICES);
+		mJobs.push_back(job);
+	}
+	mVertices += count;
+}
+
+void LLSkinningBatch::run()
+{
+	S32 count = (S32)mJobs.size();
+	LLWorkerPool* pool = mUseWorkerPool ? LLWorkerPool::getInstance() : NULL;
+	LLWorkerPool::Subsystem* subsystem = pool ? pool->getSubsystem("skinning") : NULL;
+	if (!subsystem || count < 2 || mVertices < MIN_PARALLEL_VERTICES)
+	{
+		for (S32 i = 0; i < count; ++i)
+		{
+			const Job& job = mJobs[i];
+			LLSkinning::skin(job.mPalette, job.mWeights, job.mPositions, job.mNormals, job.mCount,
+							 job.mOutPositions, job.mOutNormals);
+		}
+		clear();
+		return;
+	}
+
+	pool->parallelFor(subsystem, count, skin_job, &mJobs[0]);
+	clear();
+}
+
+void LLSkinningBatch::clear()
+{
+	mJobs.clear();
+	mPalettes.clear();
+	mVertices = 0;
+}
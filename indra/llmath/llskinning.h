@@ -0,0 +1,169 @@
+/**
+ * @file llskinning.h
+ * @brief Software skinning of rigged mesh vertices
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSKINNING_H
+#define LL_LLSKINNING_H
+
+#include <vector>
+
+#include "llmath.h"
+#include "llmatrix4a.h"
+
+//============================================================================
+// Software skinning of rigged mesh vertices, for when the vertex shaders
+// don't do it.
+//
+// A vertex weight holds four influences, each the index of a joint plus a
+// weight in [0, 1), as LLVolume unpacks them. Positions are moved by the bind
+// shape matrix and then by the weighted sum of the joint matrices (inverse
+// bind matrix times world matrix) of the influences; normals are rotated by
+// the same matrices.
+//
+// Palettes have the bind shape matrix folded into the joint matrices, which
+// saves a transform per vertex. Weights are decoded four vertices at a time,
+// as four structure-of-arrays registers, and the kernel that blends the
+// matrices and transforms the vertices is chosen at run time: SSE2, which
+// the viewer requires anyway, or AVX, which does two vertices at a time.
+
+class LLSkinning
+{
+public:
+	enum
+	{
+		MAX_JOINTS = 64
+	};
+
+	enum EKernel
+	{
+		KERNEL_SSE2 = 0,
+		KERNEL_AVX,
+		KERNEL_COUNT
+	};
+
+	// Picks the best kernel the build and the processor support.
+	static void initClass();
+	static bool hasKernel(EKernel kernel);
+	static void setKernel(EKernel kernel);		// Ignored if !hasKernel(kernel).
+	static EKernel getKernel()					{ return sKernel; }
+	static const char* getKernelName(EKernel kernel);
+
+	// palette[j] = the bind shape matrix followed by joints[j], for j < count.
+	static void foldBindShape(const LLMatrix4a& bind_shape, const LLMatrix4a* joints, S32 count, LLMatrix4a* palette);
+
+	// Skins count vertices with a palette from foldBindShape(). normals and
+	// out_normals may be NULL. The output may be a mapped vertex buffer.
+	static void skin(const LLMatrix4a* palette, const LLVector4a* weights, const LLVector4a* positions,
+					 const LLVector4a* normals, S32 count, LLVector4a* out_positions, LLVector4a* out_normals);
+
+	// What LLDrawPoolAvatar::updateRiggedFaceVertexBuffer() did before
+	// there was a palette with the bind shape folded in, one vertex and one
+	// matrix at a time, except that all four weights are normalized, as in
+	// the vertex shaders: it used to leave out the fourth. For checking the
+	// kernels against.
+	static void skinReference(const LLMatrix4a* joints, const LLMatrix4a& bind_shape, const LLVector4a* weights,
+							  const LLVector4a* positions, const LLVector4a* normals, S32 count,
+							  LLVector4a* out_positions, LLVector4a* out_normals);
+
+	// Blends and transforms count vertices whose influences were decoded
+	// (normalized weights and clamped joint indices).
+	typedef void (*kernel_t)(const LLMatrix4a* palette, const S32* joints, const LLVector4a* weights,
+							 const LLVector4a* positions, const LLVector4a* normals, S32 count,
+							 LLVector4a* out_positions, LLVector4a* out_normals);
+
+private:
+	static EKernel sKernel;
+	static kernel_t sKernels[KERNEL_COUNT];
+};
+
+//============================================================================
+// Palettes of LLSkinning::MAX_JOINTS matrices that keep their address until
+// clear(), which keeps the memory for the next ones.
+
+class LLSkinningPalettes
+{
+public:
+	LLSkinningPalettes() : mUsed(0) { }
+	~LLSkinningPalettes();
+
+	LLMatrix4a* allocate();
+	void clear()				{ mUsed = 0; }
+
+private:
+	std::vector<LLMatrix4a*> mPalettes;
+	U32 mUsed;
+};
+
+//============================================================================
+// Rigged faces to skin in one go: split in chunks that run on the worker
+// pool ("skinning" subsystem) when it is on and there are enough vertices,
+// and on the calling thread too, so that run() returns with every face done.
+
+class LLSkinningBatch
+{
+public:
+	LLSkinningBatch();
+
+	// Returns a palette for add(), valid until clear(), with the bind shape
+	// folded into the count joint matrices.
+	const LLMatrix4a* addPalette(const LLMatrix4a& bind_shape, const LLMatrix4a* joints, S32 count);
+	// The arrays must stay valid until run() returns.
+	void add(const LLMatrix4a* palette, const LLVector4a* weights, const LLVector4a* positions,
+			 const LLVector4a* normals, S32 count, LLVector4a* out_positions, LLVector4a* out_normals);
+
+	// MAIN THREAD. Skins everything added, then clears the batch.
+	void run();
+	void clear();
+
+	bool isEmpty() const						{ return mJobs.empty(); }
+	S32 getVertexCount() const					{ return mVertices; }
+
+	// Off skins everything on the calling thread, for comparing.
+	void setUseWorkerPool(bool use_pool)		{ mUseWorkerPool = use_pool; }
+
+	// Vertices per job; faces with more are split.
+	static const S32 CHUNK_VERTICES = 2048;
+	// Fewer vertices than this are not worth waking the workers for.
+	static const S32 MIN_PARALLEL_VERTICES = 8192;
+
+	struct Job
+	{
+		const LLMatrix4a* mPalette;
+		const LLVector4a* mWeights;
+		const LLVector4a* mPositions;
+		const LLVector4a* mNormals;
+		LLVector4a* mOutPositions;
+		LLVector4a* mOutNormals;
+		S32 mCount;
+	};
+
+private:
+	std::vector<Job> mJobs;
+	LLSkinningPalettes mPalettes;
+	S32 mVertices;
+	bool mUseWorkerPool;
+};
+
+#endif // LL_LLSKINNING_H
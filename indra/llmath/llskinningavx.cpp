@@ -0,0 +1,127 @@
+/**
+ * @file llskinningavx.cpp
+ * @brief AVX kernel of LLSkinning, in its own file to be compiled with AVX enabled
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+// Only intrinsics and plain pointers in here: an inline function of a shared
+// header that this file used would be compiled with AVX too, and the linker
+// may pick that copy for callers that run on processors without it.
+
+#include "linden_common.h"
+
+#include "llskinning.h"
+
+#if defined(__AVX__)
+
+#include <immintrin.h>
+
+// Rows r of the palette matrices of two vertices, one per 128 bit lane.
+static inline __m256 load_rows(const F32* a, const F32* b, S32 r)
+{
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(a + r * 4)), _mm_load_ps(b + r * 4), 1);
+}
+
+static inline void add_influence(__m256* row, const F32* a, const F32* b, __m256 w)
+{
+	for (S32 r = 0; r < 4; ++r)
+	{
+		row[r] = _mm256_add_ps(row[r], _mm256_mul_ps(load_rows(a, b, r), w));
+	}
+}
+
+// Two vertices at a time, one in each lane, with the operations in the order
+// of skin_sse2() so that both give the same results.
+static void skin_avx(const LLMatrix4a* palette, const S32* joints, const LLVector4a* weights,
+					 const LLVector4a* positions, const LLVector4a* normals, S32 count,
+					 LLVector4a* out_positions, LLVector4a* out_normals)
+{
+	const F32* matrices = (const F32*)palette;
+	const S32 MATRIX_FLOATS = 16;
+
+	for (S32 i = 0; i < count; i += 2, joints += 8)
+	{
+		bool pair = i + 1 < count;
+		const S32* joints_b = pair ? joints + 4 : joints;
+		S32 b = pair ? i + 1 : i;
+
+		__m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps((const F32*)(weights + i))),
+										_mm_load_ps((const F32*)(weights + b)), 1);
+		const F32* ma = matrices + joints[0] * MATRIX_FLOATS;
+		const F32* mb = matrices + joints_b[0] * MATRIX_FLOATS;
+		__m256 wk = _mm256_permute_ps(w, _MM_SHUFFLE(0, 0, 0, 0));
+		__m256 row[4];
+		for (S32 r = 0; r < 4; ++r)
+		{
+			row[r] = _mm256_mul_ps(load_rows(ma, mb, r), wk);
+		}
+		add_influence(row, matrices + joints[1] * MATRIX_FLOATS, matrices + joints_b[1] * MATRIX_FLOATS,
+					  _mm256_permute_ps(w, _MM_SHUFFLE(1, 1, 1, 1)));
+		add_influence(row, matrices + joints[2] * MATRIX_FLOATS, matrices + joints_b[2] * MATRIX_FLOATS,
+					  _mm256_permute_ps(w, _MM_SHUFFLE(2, 2, 2, 2)));
+		add_influence(row, matrices + joints[3] * MATRIX_FLOATS, matrices + joints_b[3] * MATRIX_FLOATS,
+					  _mm256_permute_ps(w, _MM_SHUFFLE(3, 3, 3, 3)));
+
+		__m256 v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps((const F32*)(positions + i))),
+										_mm_load_ps((const F32*)(positions + b)), 1);
+		__m256 x = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)), row[0]);
+		__m256 y = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), row[1]);
+		__m256 z = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), row[2]);
+		__m256 res = _mm256_add_ps(_mm256_add_ps(x, y), _mm256_add_ps(z, row[3]));
+		_mm_store_ps((F32*)(out_positions + i), _mm256_castps256_ps128(res));
+		if (pair)
+		{
+			_mm_store_ps((F32*)(out_positions + b), _mm256_extractf128_ps(res, 1));
+		}
+
+		if (normals)
+		{
+			v = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps((const F32*)(normals + i))),
+									 _mm_load_ps((const F32*)(normals + b)), 1);
+			x = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(0, 0, 0, 0)), row[0]);
+			y = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(1, 1, 1, 1)), row[1]);
+			z = _mm256_mul_ps(_mm256_permute_ps(v, _MM_SHUFFLE(2, 2, 2, 2)), row[2]);
+			res = _mm256_add_ps(_mm256_add_ps(x, y), z);
+			_mm_store_ps((F32*)(out_normals + i), _mm256_castps256_ps128(res));
+			if (pair)
+			{
+				_mm_store_ps((F32*)(out_normals + b), _mm256_extractf128_ps(res, 1));
+			}
+		}
+	}
+	_mm256_zeroupper();
+}
+
+LLSkinning::kernel_t ll_skinning_avx_kernel()
+{
+	return skin_avx;
+}
+
+#else
+
+LLSkinning::kernel_t ll_skinning_avx_kernel()
+{
+	return NULL;
+}
+
+#endif
@@ -2401,7 +2401,22 @@ bool LLVolume::unpackVolumeFaces(std::istream& is, S32 size)
 		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD, will probably fetch from sim again." << llendl;
 		return false;
 	}
-	
+	return unpackVolumeFaces(mdl);
+}
+
+bool LLVolume::unpackVolumeFaces(const U8* data, S32 size)
+{
+	LLSD mdl;
+	if (!unzip_llsd(mdl, data, size))
+	{
+		LL_DEBUGS("MeshStreaming") << "Failed to unzip LLSD blob for LoD, will probably fetch from sim again." << llendl;
+		return false;
+	}
+	return unpackVolumeFaces(mdl);
+}
+
+bool LLVolume::unpackVolumeFaces(LLSD& mdl)
+{
 	{
 		U32 face_count = mdl.size();
 
@@ -1069,8 +1069,11 @@ private:
 protected:
 	BOOL generate();
 	void createVolumeFaces();
+	bool unpackVolumeFaces(LLSD& mdl);
 public:
 	virtual bool unpackVolumeFaces(std::istream& is, S32 size);
+	// Same, straight from a buffer.
+	bool unpackVolumeFaces(const U8* data, S32 size);
 
 	virtual void setMeshAssetLoaded(BOOL loaded);
 	virtual BOOL isMeshAssetLoaded();
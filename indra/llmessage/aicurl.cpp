@@ -483,6 +483,8 @@ void Stats::print(void)
 	}
   }
   llcont << llendl;
+  llinfos_nf << "  Per host:" << llendl;
+  AICurlPrivate::PerHostRequestQueue::printStats();
   llinfos_nf << "========= END OF CURL STATS =========" << llendl;
   // Leak tests.
   // There is one easy handle per CurlEasyHandle, and BufferedCurlEasyRequest is derived from that.
@@ -933,6 +935,7 @@ void CurlEasyRequest::resetState(void)
   mTimeout = NULL;
   mHandleEventsTarget = NULL;
   mResult = CURLE_FAILED_INIT;
+  mPerHostPriority = 0;
   applyDefaultOptions();
 }
 
@@ -1367,6 +1370,8 @@ void BufferedCurlEasyRequest::prepRequest(AICurlEasyRequest_wat& curl_easy_reque
 
   // Keep responder alive.
   mResponder = responder;
+  // Position in the per-host queue, in case it has to wait.
+  mPerHostPriority = responder->getPerHostPriority();
   // Send header events to responder if needed.
   if (mResponder->needsHeaders())
   {
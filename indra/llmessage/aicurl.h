@@ -156,6 +156,7 @@ struct Stats {
 // Called to handle changes in Debug Settings.
 bool handleCurlMaxTotalConcurrentConnections(LLSD const& newvalue);
 bool handleCurlConcurrentConnectionsPerHost(LLSD const& newvalue);
+bool handleCurlAdaptiveConcurrencyPerHost(LLSD const& newvalue);
 bool handleNoVerifySSLCert(LLSD const& newvalue);
 
 // Called once at start of application (from newview/llappviewer.cpp by main thread (before threads are created)),
@@ -163,12 +164,17 @@ bool handleNoVerifySSLCert(LLSD const& newvalue);
 void initCurl(void);
 
 // Called once at start of application (from LLAppViewer::initThreads), starts AICurlThread.
-void startCurlThread(U32 CurlMaxTotalConcurrentConnections, U32 CurlConcurrentConnectionsPerHost, bool NoVerifySSLCert);
+// CurlUseEpoll is only used on linux, where it makes the thread use epoll() instead of select().
+// If CurlAdaptiveConcurrencyPerHost is set, CurlConcurrentConnectionsPerHost is the maximum of a limit that adapts to the latency of each host.
+void startCurlThread(U32 CurlMaxTotalConcurrentConnections, U32 CurlConcurrentConnectionsPerHost, bool CurlAdaptiveConcurrencyPerHost, bool NoVerifySSLCert, bool CurlUseEpoll);
 
 // Called once at end of application (from newview/llappviewer.cpp by main thread),
 // with purpose to stop curl threads, free curl resources and deinitialize curl.
 void cleanupCurl(void);
 
+// Returns the per-host statistics (concurrency limit, latency, connection reuse, ...), as a map with the hostname as key.
+void getPerHostStats(LLSD& stats);
+
 // Called from indra/newview/llfloaterabout.cpp for the About floater, and
 // from newview/llappviewer.cpp in behalf of debug output.
 // Just returns curl_version().
@@ -31,6 +31,7 @@
 #include "sys.h"
 #include "aicurlperhost.h"
 #include "aicurlthread.h"
+#include "llsd.h"
 
 #undef AICurlPrivate
 
@@ -38,6 +39,91 @@ namespace AICurlPrivate {
 
 PerHostRequestQueue::threadsafe_instance_map_type PerHostRequestQueue::sInstanceMap;
 U32 curl_concurrent_connections_per_host;
+bool curl_adaptive_concurrency_per_host = true;
+
+//-----------------------------------------------------------------------------
+// PerHostConcurrency
+
+namespace {
+
+int const INITIAL_WINDOW = 2;				// Start with two connections per host (like browsers did).
+F64 const DECREASE_FACTOR = 0.7;			// Multiplicative decrease of the limit after a failure.
+F64 const MIN_DECREASE_FACTOR = 0.5;		// Lower bound of the latency based decrease (base latency / average latency).
+F64 const LATENCY_TOLERANCE = 2.0;			// Decrease when the average latency is more than this times the base latency,
+F64 const LATENCY_SLACK = 0.01;				// plus this many seconds (to ignore jitter on very fast connections).
+F64 const LATENCY_SMOOTHING = 0.125;		// Weight of a new sample in the average latency.
+
+} // namespace
+
+PerHostConcurrency::PerHostConcurrency(void) :
+	mWindow(INITIAL_WINDOW), mSlowStart(true), mRecovery(0), mAvgLatency(0), mBaseLatency(0),
+	mCompleted(0), mFailed(0), mReusedConnections(0), mDecreases(0), mSizeDownload(0), mTransferTime(0)
+{
+}
+
+int PerHostConcurrency::limit(int max_limit) const
+{
+  return llclamp((int)mWindow, 1, llmax(max_limit, 1));
+}
+
+void PerHostConcurrency::completed(Sample const& sample, int in_flight)
+{
+  ++mCompleted;
+  if (sample.mReusedConnection)
+	++mReusedConnections;
+  mSizeDownload += sample.mSizeDownload;
+  mTransferTime += sample.mTotalTime;
+  if (mRecovery > 0)
+	--mRecovery;
+
+  if (!sample.mSuccess)
+  {
+	++mFailed;
+	decrease(in_flight, DECREASE_FACTOR);
+	return;
+  }
+
+  if (in_flight == 1 || mCompleted == 1)
+  {
+	// Nothing of ours was queued at the server, so this is the base latency, even if it went up.
+	mBaseLatency = sample.mLatency;
+	if (mWindow < 2)
+	  mSlowStart = true;			// Probably a different server or route; find the new limit quickly.
+  }
+  else if (sample.mLatency < mBaseLatency)
+  {
+	// Do not let the base latency go up otherwise: while requests are queued at the server, we only see higher latencies.
+	mBaseLatency = sample.mLatency;
+  }
+  mAvgLatency = (mCompleted == 1) ? sample.mLatency : mAvgLatency + LATENCY_SMOOTHING * (sample.mLatency - mAvgLatency);
+
+  if (mAvgLatency > mBaseLatency * LATENCY_TOLERANCE + LATENCY_SLACK)
+  {
+	// Requests are waiting at the server; more concurrency won't help. Decrease the limit in proportion,
+	// so that the queue at the server drains (which also lets us see the base latency again).
+	// If the base latency really went up then this continues until only one request is in flight.
+	decrease(in_flight, llmax(mBaseLatency / mAvgLatency, MIN_DECREASE_FACTOR));
+  }
+  else if (in_flight >= (int)mWindow)
+  {
+	// Only grow when the limit was reached: one extra request per round trip (or per request during slow start).
+	mWindow += mSlowStart ? 1.0 : 1.0 / mWindow;
+  }
+}
+
+void PerHostConcurrency::decrease(int in_flight, F64 factor)
+{
+  // Only decrease once per round trip: the requests that are still in flight were sent with the old limit.
+  if (mRecovery > 0)
+	return;
+  mSlowStart = false;
+  mWindow = llmax(mWindow * factor, 1.0);
+  mRecovery = in_flight;
+  ++mDecreases;
+}
+
+//-----------------------------------------------------------------------------
+// PerHostRequestQueue
 
 //static
 PerHostRequestQueuePtr PerHostRequestQueue::instance(std::string const& hostname)
@@ -92,8 +178,11 @@ void PerHostRequestQueue::release(PerHostRequestQueuePtr& instance)
 
 bool PerHostRequestQueue::throttled() const
 {
-  llassert(mAdded <= int(curl_concurrent_connections_per_host));
-  return mAdded == int(curl_concurrent_connections_per_host);
+  int max_added = curl_concurrent_connections_per_host;
+  if (curl_adaptive_concurrency_per_host)
+	max_added = mConcurrency.limit(max_added);
+  // mAdded can be larger than max_added after the limit was decreased.
+  return mAdded >= max_added;
 }
 
 void PerHostRequestQueue::added_to_multi_handle(void)
@@ -108,15 +197,43 @@ void PerHostRequestQueue::removed_from_multi_handle(void)
   llassert(mAdded >= 0);
 }
 
-void PerHostRequestQueue::queue(AICurlEasyRequest const& easy_request)
+PerHostRequestQueue::QueuedRequest::QueuedRequest(BufferedCurlEasyRequestPtr const& request, U32 priority) : mRequest(request), mPriority(priority)
+{
+}
+
+void PerHostRequestQueue::QueuedRequest::swap(QueuedRequest& other)
 {
-  mQueuedRequests.push_back(easy_request.get_ptr());
+  mRequest.swap(other.mRequest);
+  std::swap(mPriority, other.mPriority);
+}
+
+void PerHostRequestQueue::completed(PerHostConcurrency::Sample const& sample)
+{
+  mConcurrency.completed(sample, mAdded);
+}
+
+void PerHostRequestQueue::queue(AICurlEasyRequest const& easy_request, U32 priority)
+{
+  mQueuedRequests.push_back(QueuedRequest(easy_request.get_ptr(), priority));
+  // Move it forward past the requests with a lower priority, using swap for the same reason as cancel() does.
+  queued_request_type::iterator cur = mQueuedRequests.end();
+  --cur;
+  while (cur != mQueuedRequests.begin())
+  {
+	queued_request_type::iterator prev = cur;
+	if ((--prev)->mPriority >= priority)
+	  break;
+	prev->swap(*cur);
+	cur = prev;
+  }
 }
 
 bool PerHostRequestQueue::cancel(AICurlEasyRequest const& easy_request)
 {
   queued_request_type::iterator const end = mQueuedRequests.end();
-  queued_request_type::iterator cur = std::find(mQueuedRequests.begin(), end, easy_request.get_ptr());
+  queued_request_type::iterator cur = mQueuedRequests.begin();
+  while (cur != end && cur->mRequest != easy_request.get_ptr())
+	++cur;
 
   if (cur == end)
 	return false;		// Not found.
@@ -137,15 +254,6 @@ bool PerHostRequestQueue::cancel(AICurlEasyRequest const& easy_request)
   return true;
 }
 
-void PerHostRequestQueue::add_queued_to(curlthread::MultiHandle* multi_handle)
-{
-  if (!mQueuedRequests.empty())
-  {
-	multi_handle->add_easy_request(mQueuedRequests.front());
-	mQueuedRequests.pop_front();
-  }
-}
-
 //static
 void PerHostRequestQueue::purge(void)
 {
@@ -157,6 +265,47 @@ void PerHostRequestQueue::purge(void)
   }
 }
 
+//static
+void PerHostRequestQueue::getStats(LLSD& stats)
+{
+  stats = LLSD::emptyMap();
+  instance_map_rat instance_map_r(sInstanceMap);
+  for (const_iterator host = instance_map_r->begin(); host != instance_map_r->end(); ++host)
+  {
+	PerHostRequestQueue_rat per_host_r(*host->second);
+	PerHostConcurrency const& concurrency(per_host_r->mConcurrency);
+	LLSD& entry = stats[host->first];
+	entry["active"] = per_host_r->mAdded;
+	entry["queued"] = (LLSD::Integer)per_host_r->mQueuedRequests.size();
+	entry["limit"] = curl_adaptive_concurrency_per_host ?
+		concurrency.limit(curl_concurrent_connections_per_host) : (int)curl_concurrent_connections_per_host;
+	entry["completed"] = (LLSD::Integer)concurrency.getCompleted();
+	entry["failed"] = (LLSD::Integer)concurrency.getFailed();
+	entry["reused_connections"] = (LLSD::Integer)concurrency.getReusedConnections();
+	entry["decreases"] = (LLSD::Integer)concurrency.getDecreases();
+	entry["latency_ms"] = concurrency.getAverageLatency() * 1000.0;
+	entry["base_latency_ms"] = concurrency.getBaseLatency() * 1000.0;
+	entry["bytes_per_second"] = concurrency.getBytesPerSecond();
+  }
+}
+
+//static
+void PerHostRequestQueue::printStats(void)
+{
+  LLSD stats;
+  getStats(stats);
+  for (LLSD::map_const_iterator host = stats.beginMap(); host != stats.endMap(); ++host)
+  {
+	LLSD const& entry = host->second;
+	llinfos_nf << "  " << host->first << ": limit " << entry["limit"].asInteger()
+			   << ", active/queued " << entry["active"].asInteger() << "/" << entry["queued"].asInteger()
+			   << ", failed/completed " << entry["failed"].asInteger() << "/" << entry["completed"].asInteger()
+			   << ", reused connections " << entry["reused_connections"].asInteger()
+			   << ", latency (base) " << entry["latency_ms"].asReal() << " (" << entry["base_latency_ms"].asReal() << ") ms"
+			   << ", " << entry["bytes_per_second"].asReal() / 1024.0 << " kB/s" << llendl;
+  }
+}
+
 // Friend functions of RefCountedThreadSafePerHostRequestQueue
 
 void intrusive_ptr_add_ref(RefCountedThreadSafePerHostRequestQueue* per_host)
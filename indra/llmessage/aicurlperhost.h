@@ -39,6 +39,7 @@
 #include "aithreadsafe.h"
 
 class AICurlEasyRequest;
+class LLSD;
 
 namespace AICurlPrivate {
 namespace curlthread { class MultiHandle; }
@@ -61,6 +62,66 @@ typedef AIAccess<PerHostRequestQueue> PerHostRequestQueue_wat;
 // Therefore, use an intrusive pointer for the threadsafe type.
 typedef boost::intrusive_ptr<RefCountedThreadSafePerHostRequestQueue> PerHostRequestQueuePtr;
 
+//-----------------------------------------------------------------------------
+// PerHostConcurrency
+
+// Adaptive limit on the number of concurrent requests for a single host.
+//
+// The limit grows while the latency of the requests (the time until the first byte
+// of the reply, which excludes connecting) stays near the lowest latency seen recently,
+// and is decreased multiplicatively when it doesn't (the extra requests are then queued
+// by the server instead of processed in parallel), or when requests fail or the server
+// replies that it is overloaded (AIMD). Initially it doubles every round trip (slow start).
+// The base latency is the lowest latency seen since the last time that only one request
+// was in flight, when it is reset to the latency of that request.
+//
+// This class does no locking; it is a member of PerHostRequestQueue.
+class PerHostConcurrency {
+  public:
+	struct Sample {
+	  bool mSuccess;					// False for curl errors and HTTP status 429 and 503.
+	  F64 mLatency;						// Seconds between sending the request and receiving the first byte.
+	  F64 mTotalTime;					// Seconds for the whole transfer.
+	  F64 mSizeDownload;				// Number of bytes received.
+	  bool mReusedConnection;			// True when no new connection had to be made (keep-alive).
+	};
+
+	PerHostConcurrency(void);
+
+	// Return the current limit, but at least 1 and at most max_limit.
+	int limit(int max_limit) const;
+
+	// Called for every finished request; in_flight is the number of requests that were
+	// active for this host, including the one that finished.
+	void completed(Sample const& sample, int in_flight);
+
+	// Statistics.
+	F64 getWindow(void) const { return mWindow; }
+	F64 getAverageLatency(void) const { return mAvgLatency; }
+	F64 getBaseLatency(void) const { return mBaseLatency; }
+	U32 getCompleted(void) const { return mCompleted; }
+	U32 getFailed(void) const { return mFailed; }
+	U32 getReusedConnections(void) const { return mReusedConnections; }
+	U32 getDecreases(void) const { return mDecreases; }
+	F64 getBytesPerSecond(void) const { return mTransferTime > 0 ? mSizeDownload / mTransferTime : 0; }
+
+  private:
+	void decrease(int in_flight, F64 factor);
+
+	F64 mWindow;						// The limit; the fraction counts completions for additive increase.
+	bool mSlowStart;					// True until the first decrease.
+	int mRecovery;						// Number of completions before the next decrease is allowed.
+	F64 mAvgLatency;					// Exponentially weighted moving average of Sample::mLatency.
+	F64 mBaseLatency;					// The latency without queueing at the server.
+
+	U32 mCompleted;
+	U32 mFailed;
+	U32 mReusedConnections;
+	U32 mDecreases;
+	F64 mSizeDownload;
+	F64 mTransferTime;
+};
+
 //-----------------------------------------------------------------------------
 // PerHostRequestQueue
 
@@ -94,27 +155,62 @@ class PerHostRequestQueue {
 	// Remove everything. Called upon viewer exit.
 	static void purge(void);
 
+	// Return the statistics of all hosts, as a map with the hostname as key.
+	static void getStats(LLSD& stats);
+
+	// Print the statistics of all hosts to the log.
+	static void printStats(void);
+
   private:
-	typedef std::deque<BufferedCurlEasyRequestPtr> queued_request_type;
+	struct QueuedRequest {
+	  BufferedCurlEasyRequestPtr mRequest;
+	  U32 mPriority;
+
+	  QueuedRequest(BufferedCurlEasyRequestPtr const& request, U32 priority);
+	  void swap(QueuedRequest& other);
+	};
+	typedef std::deque<QueuedRequest> queued_request_type;
 
 	int mAdded;									// Number of active easy handles with this host.
-	queued_request_type mQueuedRequests;		// Waiting (throttled) requests.
+	queued_request_type mQueuedRequests;		// Waiting (throttled) requests, highest priority first.
+	PerHostConcurrency mConcurrency;			// Adaptive limit of mAdded.
 
   public:
 	void added_to_multi_handle(void);					// Called when an easy handle for this host has been added to the multi handle.
 	void removed_from_multi_handle(void);				// Called when an easy handle for this host is removed again from the multi handle.
 	bool throttled(void) const;							// Returns true if the maximum number of allowed requests for this host have been added to the multi handle.
+	void completed(PerHostConcurrency::Sample const& sample);	// Called when an easy handle for this host finished, before it is removed from the multi handle.
 
-	void queue(AICurlEasyRequest const& easy_request);	// Add easy_request to the queue.
+	// Add easy_request to the queue, behind the requests with the same or a higher priority.
+	void queue(AICurlEasyRequest const& easy_request, U32 priority);
 	bool cancel(AICurlEasyRequest const& easy_request);	// Remove easy_request from the queue (if it's there).
 
-    void add_queued_to(curlthread::MultiHandle* mh);	// Add queued easy handle (if any) to the multi handle. The request is removed from the queue,
-														// followed by either a call to added_to_multi_handle() or to queue() to add it back.
+	// Add queued easy handles (if any) to the multi handle, until throttled. Each request is removed from the queue,
+	// followed by either a call to added_to_multi_handle() or to queue() to add it back.
+	// MULTI_HANDLE is curlthread::MultiHandle; this is a template only so that the tests can drive it.
+	template<class MULTI_HANDLE>
+	void add_queued_to(MULTI_HANDLE* multi_handle);
   private:
 	// Disallow copying.
 	PerHostRequestQueue(PerHostRequestQueue const&) { }
 };
 
+template<class MULTI_HANDLE>
+void PerHostRequestQueue::add_queued_to(MULTI_HANDLE* multi_handle)
+{
+  // The adaptive limit can have grown by more than one since the last call,
+  // so add as many requests as it allows now.
+  while (!mQueuedRequests.empty() && !throttled())
+  {
+	int added = mAdded;
+	// If the request can't be added after all it is queued again, behind the front (same priority).
+	multi_handle->add_easy_request(mQueuedRequests.front().mRequest);
+	mQueuedRequests.pop_front();
+	if (mAdded == added)
+	  break;			// Throttled by the total number of connections.
+  }
+}
+
 class RefCountedThreadSafePerHostRequestQueue : public threadsafe_PerHostRequestQueue {
   public:
 	RefCountedThreadSafePerHostRequestQueue(void) : mReferenceCount(0) { }
@@ -129,6 +225,7 @@ class RefCountedThreadSafePerHostRequestQueue : public threadsafe_PerHostRequest
 };
 
 extern U32 curl_concurrent_connections_per_host;
+extern bool curl_adaptive_concurrency_per_host;			// Use PerHostConcurrency; if false, always allow curl_concurrent_connections_per_host.
 
 } // namespace AICurlPrivate
 
@@ -199,6 +199,14 @@ int ioctlsocket(int fd, int, unsigned long* nonblocking_enable)
 
 #define WINDOWS_CODE (LL_WINDOWS || DEBUG_WINDOWS_CODE_ON_LINUX)
 
+// Wait for curl sockets with epoll(7) instead of select() (see EPollSet), when curl_use_epoll is set.
+#if LL_LINUX && !WINDOWS_CODE
+#define HAVE_EPOLL 1
+#include <sys/epoll.h>
+#else
+#define HAVE_EPOLL 0
+#endif
+
 #undef AICurlPrivate
 
 namespace AICurlPrivate {
@@ -697,6 +705,147 @@ bool MergeIterator::next(curl_socket_t& fd_out, int& ev_bitmask_out)
   return true;
 }
 
+#if HAVE_EPOLL
+//-----------------------------------------------------------------------------
+// EPollSet
+//
+// Used instead of the two PollSet's and select() when epoll(7) is available
+// (and curl_use_epoll is set): a single epoll instance holds every curl socket
+// with the events that curl is interested in. There is no limit on the number
+// or the value of the filedescriptors, and the kernel returns just the ready
+// ones, so a wake up costs O(ready sockets) instead of O(all sockets).
+//
+// This is level-triggered on purpose: libcurl does not promise to read or write
+// until EAGAIN in one call to curl_multi_socket_action, so with edge-triggered
+// notification a socket with data left in its buffer would never be reported again.
+
+class EPollSet
+{
+  public:
+	EPollSet(void);
+	~EPollSet();
+
+	// Returns false if epoll_create failed; use the PollSet's then.
+	bool is_valid(void) const { return mEPollFd != -1; }
+
+	// Change the CURL_POLL_* events that we wait for on s from old_action to action.
+	// CURL_POLL_NONE removes s; any events of s still to be returned by get() are dropped.
+	void set(curl_socket_t s, int old_action, int action);
+
+	// Wait at most timeout_ms for events. Returns the number of events, or -1 on error.
+	int wait(long timeout_ms);
+
+	// Return the filedescriptor of event i (0 <= i < the last value returned by wait()),
+	// or CURL_SOCKET_BAD if it was removed after wait() returned.
+	curl_socket_t get(int i) const { return mEvents[i].data.fd; }
+
+	// Return the CURL_CSELECT_* bitmask of event i.
+	int get_ev_bitmask(int i) const;
+
+	// Return the number of filedescriptors in the set.
+	int size(void) const { return mNrFds; }
+
+  private:
+	int mEPollFd;
+	int mNrFds;
+	int mNrEvents;							// The value returned by the last call to wait().
+	std::vector<struct epoll_event> mEvents;
+};
+
+// The maximum number of events returned by one call to wait();
+// any others are returned by the next call.
+static int const EPOLL_MAXEVENTS = 256;
+
+static bool curl_use_epoll = true;								// Initialized on start up by startCurlThread().
+
+EPollSet::EPollSet(void) : mNrFds(0), mNrEvents(0), mEvents(EPOLL_MAXEVENTS)
+{
+  mEPollFd = epoll_create(EPOLL_MAXEVENTS);		// The argument is ignored, but must be larger than zero.
+  if (mEPollFd == -1)
+  {
+	llwarns << "epoll_create: " << strerror(errno) << llendl;
+  }
+  else
+  {
+	fcntl(mEPollFd, F_SETFD, FD_CLOEXEC);
+  }
+}
+
+EPollSet::~EPollSet()
+{
+  if (mEPollFd != -1)
+	close(mEPollFd);
+}
+
+void EPollSet::set(curl_socket_t s, int old_action, int action)
+{
+  int op;
+  if (action == CURL_POLL_NONE)
+  {
+	if (old_action == CURL_POLL_NONE)
+	  return;
+	op = EPOLL_CTL_DEL;
+	--mNrFds;
+	// Like PollSet::remove, make sure we won't call curl_multi_socket_action for a socket
+	// that curl told us to remove (which might even be reused for a new socket already).
+	for (int i = 0; i < mNrEvents; ++i)
+	  if (mEvents[i].data.fd == s)
+		mEvents[i].data.fd = CURL_SOCKET_BAD;
+  }
+  else if (old_action == CURL_POLL_NONE)
+  {
+	op = EPOLL_CTL_ADD;
+	++mNrFds;
+  }
+  else
+  {
+	op = EPOLL_CTL_MOD;
+  }
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  if ((action & CURL_POLL_IN))
+	event.events |= EPOLLIN;
+  if ((action & CURL_POLL_OUT))
+	event.events |= EPOLLOUT;
+  event.data.fd = s;
+  if (epoll_ctl(mEPollFd, op, s, &event) == -1)
+  {
+	// Curl might already have closed the socket, which removes it from the epoll set too.
+	if (op != EPOLL_CTL_DEL || (errno != EBADF && errno != ENOENT))
+	{
+	  llwarns << "epoll_ctl(" << op << ", " << s << "): " << strerror(errno) << llendl;
+	}
+  }
+}
+
+int EPollSet::wait(long timeout_ms)
+{
+  mNrEvents = epoll_wait(mEPollFd, &mEvents[0], EPOLL_MAXEVENTS, timeout_ms);
+  if (mNrEvents == -1)
+  {
+	int error = errno;
+	mNrEvents = 0;
+	errno = error;
+	return -1;
+  }
+  return mNrEvents;
+}
+
+int EPollSet::get_ev_bitmask(int i) const
+{
+  U32 events = mEvents[i].events;
+  int ev_bitmask = 0;
+  // Hang up and errors are reported as readable, like select() does: curl finds out what happened when reading.
+  if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+	ev_bitmask |= CURL_CSELECT_IN;
+  if ((events & EPOLLOUT))
+	ev_bitmask |= CURL_CSELECT_OUT;
+  if ((events & EPOLLERR))
+	ev_bitmask |= CURL_CSELECT_ERR;
+  return ev_bitmask;
+}
+#endif // HAVE_EPOLL
+
 //-----------------------------------------------------------------------------
 // CurlSocketInfo
 
@@ -787,22 +936,32 @@ void CurlSocketInfo::set_action(int action)
 {
   Dout(dc::curl, "CurlSocketInfo::set_action(" << action_str(mAction) << " --> " << action_str(action) << ") [" << (void*)mEasyRequest.get_ptr().get() << "]");
   int toggle_action = mAction ^ action; 
-  mAction = action;
-  if ((toggle_action & CURL_POLL_IN))
+#if HAVE_EPOLL
+  if (mMultiHandle.mEPollSet)
+	mMultiHandle.mEPollSet->set(mSocketFd, mAction, action);
+  else
+#endif
   {
-	if ((action & CURL_POLL_IN))
-	  mMultiHandle.mReadPollSet->add(mSocketFd);
-	else
-	  mMultiHandle.mReadPollSet->remove(mSocketFd);
+	if ((toggle_action & CURL_POLL_IN))
+	{
+	  if ((action & CURL_POLL_IN))
+		mMultiHandle.mReadPollSet->add(mSocketFd);
+	  else
+		mMultiHandle.mReadPollSet->remove(mSocketFd);
+	}
+	if ((toggle_action & CURL_POLL_OUT))
+	{
+	  if ((action & CURL_POLL_OUT))
+		mMultiHandle.mWritePollSet->add(mSocketFd);
+	  else
+		mMultiHandle.mWritePollSet->remove(mSocketFd);
+	}
   }
+  mAction = action;
   if ((toggle_action & CURL_POLL_OUT))
   {
-	if ((action & CURL_POLL_OUT))
-	  mMultiHandle.mWritePollSet->add(mSocketFd);
-	else
+	if (!(action & CURL_POLL_OUT))
 	{
-	  mMultiHandle.mWritePollSet->remove(mSocketFd);
-
 	  // The following is a bit of a hack, needed because of the lack of proper timeout callbacks in libcurl.
 	  // The removal of CURL_POLL_OUT could be part of the SSL handshake, therefore check if we're already connected:
 	  AICurlEasyRequest_wat curl_easy_request_w(*mEasyRequest);
@@ -1262,29 +1421,52 @@ void AICurlThread::run(void)
 
   {
 	AICurlMultiHandle_wat multi_handle_w(AICurlMultiHandle::getInstance());
+#if HAVE_EPOLL
+	// When using epoll, the wake up fd is added to the epoll set once, and select() is not used at all.
+	EPollSet* epoll_set = multi_handle_w->mEPollSet;
+	if (epoll_set && mWakeUpFd != CURL_SOCKET_BAD)
+	  epoll_set->set(mWakeUpFd, CURL_POLL_NONE, CURL_POLL_IN);
+#endif
 	while(mRunning)
 	{
 	  // If mRunning is true then we can only get here if mWakeUpFd != CURL_SOCKET_BAD.
 	  llassert(mWakeUpFd != CURL_SOCKET_BAD);
-	  // Copy the next batch of file descriptors from the PollSets mFiledescriptors into their mFdSet.
-	  multi_handle_w->mReadPollSet->refresh();
-	  refresh_t wres = multi_handle_w->mWritePollSet->refresh();
-	  // Add wake up fd if any, and pass NULL to select() if a set is empty.
-	  fd_set* read_fd_set = multi_handle_w->mReadPollSet->access();
-	  FD_SET(mWakeUpFd, read_fd_set);
-	  fd_set* write_fd_set = ((wres & empty)) ? NULL : multi_handle_w->mWritePollSet->access();
-	  // Calculate nfds (ignored on windows).
+	  fd_set* read_fd_set = NULL;
+	  fd_set* write_fd_set = NULL;
 #if !WINDOWS_CODE
-	  curl_socket_t const max_rfd = llmax(multi_handle_w->mReadPollSet->get_max_fd(), mWakeUpFd);
-	  curl_socket_t const max_wfd = multi_handle_w->mWritePollSet->get_max_fd();
-	  int nfds = llmax(max_rfd, max_wfd) + 1;
-	  llassert(0 <= nfds && nfds <= FD_SETSIZE);
-	  llassert((max_rfd == -1) == (read_fd_set == NULL) &&
-			   (max_wfd == -1) == (write_fd_set == NULL));	// Needed on Windows.
-	  llassert((max_rfd == -1 || multi_handle_w->mReadPollSet->is_set(max_rfd)) &&
-			   (max_wfd == -1 || multi_handle_w->mWritePollSet->is_set(max_wfd)));
+	  int nfds = 0;
 #else
 	  int nfds = 64;
+#endif
+#if HAVE_EPOLL
+	  if (!epoll_set)
+#endif
+	  {
+		// Copy the next batch of file descriptors from the PollSets mFiledescriptors into their mFdSet.
+		multi_handle_w->mReadPollSet->refresh();
+		refresh_t wres = multi_handle_w->mWritePollSet->refresh();
+		// Add wake up fd if any, and pass NULL to select() if a set is empty.
+		read_fd_set = multi_handle_w->mReadPollSet->access();
+		FD_SET(mWakeUpFd, read_fd_set);
+		write_fd_set = ((wres & empty)) ? NULL : multi_handle_w->mWritePollSet->access();
+		// Calculate nfds (ignored on windows).
+#if !WINDOWS_CODE
+		curl_socket_t const max_rfd = llmax(multi_handle_w->mReadPollSet->get_max_fd(), mWakeUpFd);
+		curl_socket_t const max_wfd = multi_handle_w->mWritePollSet->get_max_fd();
+		nfds = llmax(max_rfd, max_wfd) + 1;
+		llassert(0 <= nfds && nfds <= FD_SETSIZE);
+		llassert((max_rfd == -1) == (read_fd_set == NULL) &&
+				 (max_wfd == -1) == (write_fd_set == NULL));	// Needed on Windows.
+		llassert((max_rfd == -1 || multi_handle_w->mReadPollSet->is_set(max_rfd)) &&
+				 (max_wfd == -1 || multi_handle_w->mWritePollSet->is_set(max_wfd)));
+#endif
+	  }
+#if HAVE_EPOLL
+	  else
+	  {
+		// Only used for debug output.
+		nfds = epoll_set->size();
+	  }
 #endif
 	  int ready = 0;
 	  // Process every command in command_queue before entering select().
@@ -1353,6 +1535,11 @@ void AICurlThread::run(void)
 		++same_count;
 	  }
 #endif
+#endif
+#if HAVE_EPOLL
+	  if (epoll_set)
+		ready = epoll_set->wait(timeout_ms);
+	  else
 #endif
 	  ready = select(nfds, read_fd_set, write_fd_set, NULL, &timeout);
 	  mWakeUpMutex.unlock();
@@ -1393,6 +1580,26 @@ void AICurlThread::run(void)
 		multi_handle_w->socket_action(CURL_SOCKET_TIMEOUT, 0);
 		multi_handle_w->handle_stalls();
 	  }
+#if HAVE_EPOLL
+	  else if (epoll_set)
+	  {
+		// Handle all active filedescriptors. If libcurl (or processing the commands) removes
+		// a filedescriptor then its events in this batch are replaced with CURL_SOCKET_BAD.
+		for (int i = 0; i < ready; ++i)
+		{
+		  curl_socket_t fd = epoll_set->get(i);
+		  if (fd == mWakeUpFd)
+		  {
+			// Process commands from main-thread. This can add or remove filedescriptors from the epoll set.
+			wakeup(multi_handle_w);
+		  }
+		  else if (fd != CURL_SOCKET_BAD)
+		  {
+			multi_handle_w->socket_action(fd, epoll_set->get_ev_bitmask(i));
+		  }
+		}
+	  }
+#endif
 	  else
 	  {
 		if (multi_handle_w->mReadPollSet->is_set(mWakeUpFd))
@@ -1427,10 +1634,22 @@ void AICurlThread::run(void)
 //-----------------------------------------------------------------------------
 // MultiHandle
 
-MultiHandle::MultiHandle(void) : mTimeout(-1), mReadPollSet(NULL), mWritePollSet(NULL)
+MultiHandle::MultiHandle(void) : mTimeout(-1), mReadPollSet(NULL), mWritePollSet(NULL), mEPollSet(NULL)
 {
   mReadPollSet = new PollSet;
   mWritePollSet = new PollSet;
+#if HAVE_EPOLL
+  if (curl_use_epoll)
+  {
+	mEPollSet = new EPollSet;
+	if (!mEPollSet->is_valid())
+	{
+	  delete mEPollSet;
+	  mEPollSet = NULL;
+	}
+  }
+  llinfos << "Curl thread uses " << (mEPollSet ? "epoll()" : "select()") << " to wait for sockets." << llendl;
+#endif
   check_multi_code(curl_multi_setopt(mMultiHandle, CURLMOPT_SOCKETFUNCTION, &MultiHandle::socket_callback));
   check_multi_code(curl_multi_setopt(mMultiHandle, CURLMOPT_SOCKETDATA, this));
   check_multi_code(curl_multi_setopt(mMultiHandle, CURLMOPT_TIMERFUNCTION, &MultiHandle::timer_callback));
@@ -1448,6 +1667,9 @@ MultiHandle::~MultiHandle()
 	finish_easy_request(*iter, CURLE_OK);	// Error code is not used anyway.
 	remove_easy_request(*iter);
   }
+#if HAVE_EPOLL
+  delete mEPollSet;
+#endif
   delete mWritePollSet;
   delete mReadPollSet;
 }
@@ -1544,9 +1766,11 @@ void MultiHandle::add_easy_request(AICurlEasyRequest const& easy_request)
 {
   bool throttled = true;		// Default.
   PerHostRequestQueuePtr per_host;
+  U32 priority;
   {
 	AICurlEasyRequest_wat curl_easy_request_w(*easy_request);
 	per_host = curl_easy_request_w->getPerHostPtr();
+	priority = curl_easy_request_w->getPerHostPriority();
 	PerHostRequestQueue_wat per_host_w(*per_host);
 	if (mAddedEasyRequests.size() < curl_max_total_concurrent_connections && !per_host_w->throttled())
 	{
@@ -1566,7 +1790,7 @@ void MultiHandle::add_easy_request(AICurlEasyRequest const& easy_request)
 	return;
   }
   // The request could not be added, we have to queue it.
-  PerHostRequestQueue_wat(*per_host)->queue(easy_request);
+  PerHostRequestQueue_wat(*per_host)->queue(easy_request, priority);
 #ifdef SHOW_ASSERT
   // Not active yet, but it's no longer an error if next we try to remove the request.
   AICurlEasyRequest_wat(*easy_request)->mRemovedPerCommand = false;
@@ -1717,6 +1941,22 @@ void MultiHandle::finish_easy_request(AICurlEasyRequest const& easy_request, CUR
   Dout(dc::finish, "pretransfer_time: " << pretransfer_time << ", starttransfer_time: " << starttransfer_time <<
 	  ". [CURLINFO_PRIVATE = " << (void*)easy_request.get_ptr().get() << "]");
 #endif
+  // Let the per-host concurrency limit adapt to how fast this request was served.
+  PerHostConcurrency::Sample sample;
+  long http_status = 0;
+  long num_connects = 0;
+  double pretransfer, starttransfer;
+  curl_easy_request_w->getinfo(CURLINFO_RESPONSE_CODE, &http_status);
+  curl_easy_request_w->getinfo(CURLINFO_NUM_CONNECTS, &num_connects);
+  curl_easy_request_w->getinfo(CURLINFO_PRETRANSFER_TIME, &pretransfer);
+  curl_easy_request_w->getinfo(CURLINFO_STARTTRANSFER_TIME, &starttransfer);
+  curl_easy_request_w->getinfo(CURLINFO_TOTAL_TIME, &sample.mTotalTime);
+  curl_easy_request_w->getinfo(CURLINFO_SIZE_DOWNLOAD, &sample.mSizeDownload);
+  // 429 (Too Many Requests) and 503 (Service Unavailable) are what servers reply when they are overloaded.
+  sample.mSuccess = result == CURLE_OK && http_status != 429 && http_status != 503;
+  sample.mLatency = llmax(starttransfer - pretransfer, 0.0);
+  sample.mReusedConnection = num_connects == 0;
+  PerHostRequestQueue_wat(*curl_easy_request_w->getPerHostPtr())->completed(sample);
   // Signal that this easy handle finished.
   curl_easy_request_w->done(curl_easy_request_w, result);
 }
@@ -2587,7 +2827,7 @@ void AICurlEasyRequest::removeRequest(void)
 
 namespace AICurlInterface {
 
-void startCurlThread(U32 CurlMaxTotalConcurrentConnections, U32 CurlConcurrentConnectionsPerHost, bool NoVerifySSLCert)
+void startCurlThread(U32 CurlMaxTotalConcurrentConnections, U32 CurlConcurrentConnectionsPerHost, bool CurlAdaptiveConcurrencyPerHost, bool NoVerifySSLCert, bool CurlUseEpoll)
 {
   using namespace AICurlPrivate;
   using namespace AICurlPrivate::curlthread;
@@ -2597,7 +2837,11 @@ void startCurlThread(U32 CurlMaxTotalConcurrentConnections, U32 CurlConcurrentCo
   // Cache Debug Settings.
   curl_max_total_concurrent_connections = CurlMaxTotalConcurrentConnections;
   curl_concurrent_connections_per_host = CurlConcurrentConnectionsPerHost;
+  curl_adaptive_concurrency_per_host = CurlAdaptiveConcurrencyPerHost;
   gNoVerifySSLCert = NoVerifySSLCert;
+#if HAVE_EPOLL
+  curl_use_epoll = CurlUseEpoll;
+#endif
 
   AICurlThread::sInstance = new AICurlThread;
   AICurlThread::sInstance->start();
@@ -2621,6 +2865,20 @@ bool handleCurlConcurrentConnectionsPerHost(LLSD const& newvalue)
   return true;
 }
 
+bool handleCurlAdaptiveConcurrencyPerHost(LLSD const& newvalue)
+{
+  using namespace AICurlPrivate;
+
+  curl_adaptive_concurrency_per_host = newvalue.asBoolean();
+  llinfos << "CurlAdaptiveConcurrencyPerHost set to " << curl_adaptive_concurrency_per_host << llendl;
+  return true;
+}
+
+void getPerHostStats(LLSD& stats)
+{
+  AICurlPrivate::PerHostRequestQueue::getStats(stats);
+}
+
 bool handleNoVerifySSLCert(LLSD const& newvalue)
 {
   gNoVerifySSLCert = newvalue.asBoolean();
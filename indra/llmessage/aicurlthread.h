@@ -40,6 +40,7 @@ namespace AICurlPrivate {
 namespace curlthread {
 
 class PollSet;
+class EPollSet;
 
 // For ordering a std::set with AICurlEasyRequest objects.
 struct AICurlEasyRequestCompare {
@@ -102,6 +103,7 @@ class MultiHandle : public CurlMultiHandle
 
 	PollSet* mReadPollSet;
 	PollSet* mWritePollSet;
+	EPollSet* mEPollSet;		// Used instead of the PollSet's when not NULL (Linux only).
 };
 
 } // namespace curlthread
@@ -166,6 +166,10 @@ public:
 		// Timeout policy to use.
 		virtual AIHTTPTimeoutPolicy const& getHTTPTimeoutPolicy(void) const = 0;
 
+		// When too many requests to the same host are active, requests are queued.
+		// Requests with a higher priority are taken from that queue first. The default is 0.
+		virtual U32 getPerHostPriority(void) const { return 0; }
+
 	protected:
 		// Derived classes can override this to get the HTML headers that were received, when the message is completed.
 		// Only actually called for classes that implement a needsHeaders() that returns true.
@@ -1,5 +1,7 @@
 // <edit>
+#include "linden_common.h"
 #include "llmessagelog.h"
+#include "net.h"
 
 LLMessageLogEntry::LLMessageLogEntry(EType type, LLHost from_host, LLHost to_host, U8* data, S32 data_size)
 :	mType(type),
@@ -51,4 +53,76 @@ std::deque<LLMessageLogEntry> LLMessageLog::getDeque()
 {
 	return sDeque;
 }
+
+// Capture file layout, in host byte order: the magic and version, then per packet
+// the sender address, port and packet size followed by the packet itself.
+static const char CAPTURE_MAGIC[8] = { 'L', 'L', 'U', 'D', 'P', 'C', 'A', 'P' };
+static const U32 CAPTURE_VERSION = 1;
+LLFILE* LLMessageLog::sCaptureFile = NULL;
+bool LLMessageLog::startCapture(const std::string& filename)
+{
+	stopCapture();
+	sCaptureFile = LLFile::fopen(filename, "wb");
+	if(!sCaptureFile)
+	{
+		llwarns << "Can't open message capture file " << filename << llendl;
+		return false;
+	}
+	fwrite(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC), 1, sCaptureFile);
+	fwrite(&CAPTURE_VERSION, sizeof(CAPTURE_VERSION), 1, sCaptureFile);
+	llinfos << "Capturing incoming messages to " << filename << llendl;
+	return true;
+}
+void LLMessageLog::stopCapture()
+{
+	if(sCaptureFile)
+	{
+		fclose(sCaptureFile);
+		sCaptureFile = NULL;
+	}
+}
+void LLMessageLog::capture(const LLHost& from_host, const U8* data, S32 data_size)
+{
+	if(!sCaptureFile || data_size <= 0) return;
+	U32 header[3] = { from_host.getAddress(), from_host.getPort(), (U32)data_size };
+	fwrite(header, sizeof(header), 1, sCaptureFile);
+	fwrite(data, data_size, 1, sCaptureFile);
+}
+bool LLMessageLog::loadCapture(const std::string& filename, std::deque<LLMessageLogEntry>& entries)
+{
+	LLFILE* file = LLFile::fopen(filename, "rb");
+	if(!file)
+	{
+		llwarns << "Can't open message capture file " << filename << llendl;
+		return false;
+	}
+	char magic[sizeof(CAPTURE_MAGIC)];
+	U32 version = 0;
+	if(fread(magic, sizeof(magic), 1, file) != 1 || memcmp(magic, CAPTURE_MAGIC, sizeof(magic)) ||
+	   fread(&version, sizeof(version), 1, file) != 1 || version != CAPTURE_VERSION)
+	{
+		llwarns << filename << " is not a message capture file" << llendl;
+		fclose(file);
+		return false;
+	}
+	U32 header[3];
+	std::vector<U8> data;
+	while(fread(header, sizeof(header), 1, file) == 1)
+	{
+		if(!header[2] || header[2] > NET_BUFFER_SIZE)
+		{
+			llwarns << "Bad packet size " << header[2] << " in " << filename << llendl;
+			break;
+		}
+		data.resize(header[2]);
+		if(fread(&data[0], data.size(), 1, file) != 1)
+		{
+			llwarns << "Truncated message capture file " << filename << llendl;
+			break;
+		}
+		entries.push_back(LLMessageLogEntry(LLMessageLogEntry::TEMPLATE, LLHost(header[0], header[1]), LLHost(), data, data.size()));
+	}
+	fclose(file);
+	return true;
+}
 // </edit>
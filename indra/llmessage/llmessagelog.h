@@ -3,6 +3,7 @@
 #define LL_LLMESSAGELOG_H
 #include "stdtypes.h"
 #include "llhost.h"
+#include "llfile.h"
 #include <queue>
 #include <string.h>
 
@@ -32,8 +33,17 @@ public:
 	static void setCallback(void (*callback)(LLMessageLogEntry));
 	static void log(LLHost from_host, LLHost to_host, U8* data, S32 data_size);
 	static std::deque<LLMessageLogEntry> getDeque();
+	// Capture files: every packet LLPacketRing receives, as it came off the wire, for
+	// replaying with test_apps/llmessagereplaybench.
+	static bool startCapture(const std::string& filename);
+	static void stopCapture();
+	static bool isCapturing() { return sCaptureFile != NULL; }
+	static void capture(const LLHost& from_host, const U8* data, S32 data_size);
+	// Appends the packets of a capture file to entries, as TEMPLATE entries without a to host.
+	static bool loadCapture(const std::string& filename, std::deque<LLMessageLogEntry>& entries);
 private:
 	static U32 sMaxSize;
+	static LLFILE* sCaptureFile;
 	static void (*sCallback)(LLMessageLogEntry);
 	static std::deque<LLMessageLogEntry> sDeque;
 };
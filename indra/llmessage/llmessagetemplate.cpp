@@ -190,3 +190,55 @@ void LLMessageTemplate::banUdp()
 	}
 }
 
+
+void LLMessageTemplate::buildDecodeTables()
+{
+	mDecodeBlocks.clear();
+	mDecodeVariables.clear();
+	mMaxFixedSize = 0;
+	for (message_block_map_t::const_iterator iter = mMemberBlocks.begin(); iter != mMemberBlocks.end(); ++iter)
+	{
+		const LLMessageBlock* block = *iter;
+		DecodeBlock decode_block;
+		decode_block.mName = block->mName;
+		decode_block.mType = block->mType;
+		decode_block.mNumber = block->mNumber;
+		decode_block.mFirstVariable = mDecodeVariables.size();
+		for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = block->mMemberVariables.begin();
+			 var_iter != block->mMemberVariables.end(); ++var_iter)
+		{
+			const LLMessageVariable* variable = *var_iter;
+			DecodeVariable decode_variable;
+			decode_variable.mName = variable->getName();
+			decode_variable.mType = variable->getType();
+			decode_variable.mSize = variable->getSize();
+			decode_variable.mBlock = mDecodeBlocks.size();
+			mDecodeVariables.push_back(decode_variable);
+			if (variable->getType() != MVT_VARIABLE)
+			{
+				mMaxFixedSize = llmax(mMaxFixedSize, variable->getSize());
+			}
+		}
+		decode_block.mVariableCount = mDecodeVariables.size() - decode_block.mFirstVariable;
+		mDecodeBlocks.push_back(decode_block);
+	}
+
+	// Open addressing with linear probing, at most half full.
+	U32 bits = 3;
+	while ((1U << bits) < 2 * mDecodeVariables.size())
+	{
+		++bits;
+	}
+	mDecodeHashShift = 32 - bits;
+	mDecodeHash.assign(1U << bits, -1);
+	for (S32 i = 0; i < (S32)mDecodeVariables.size(); ++i)
+	{
+		U32 slot = decodeSlot(mDecodeBlocks[mDecodeVariables[i].mBlock].mName, mDecodeVariables[i].mName);
+		while (mDecodeHash[slot] >= 0)
+		{
+			slot = (slot + 1) & (mDecodeHash.size() - 1);
+		}
+		mDecodeHash[slot] = i;
+	}
+	mDecodeTablesBuilt = true;
+}
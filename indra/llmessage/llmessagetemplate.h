@@ -286,7 +286,10 @@ public:
 		mBanFromTrusted(false),
 		mBanFromUntrusted(false),
 		mHandlerFunc(NULL), 
-		mUserData(NULL)
+		mUserData(NULL),
+		mDecodeTablesBuilt(false),
+		mDecodeHashShift(32),
+		mMaxFixedSize(0)
 	{ 
 		mName = LLMessageStringTable::getInstance()->getString(name);
 	}
@@ -305,6 +308,7 @@ public:
 				<< "has already been used as a block name!" << llendl;
 		}
 		*member_blockp = blockp;
+		mDecodeTablesBuilt = false;
 		if (  (mTotalSize != -1)
 			&&(blockp->mTotalSize != -1)
 			&&(  (blockp->mType == MBT_SINGLE)
@@ -391,6 +395,70 @@ public:
 		return iter != mMemberBlocks.end()? *iter : NULL;
 	}
 
+	// Flat tables for LLTemplateMessageReader: the blocks and their variables in
+	// template order, and a hash from (block name, variable name) to variable.
+	struct DecodeBlock
+	{
+		char*				mName;
+		EMsgBlockType		mType;
+		S32					mNumber;
+		S32					mFirstVariable;		// index in getDecodeVariables()
+		S32					mVariableCount;
+	};
+
+	struct DecodeVariable
+	{
+		char*				mName;
+		EMsgVariableType	mType;
+		S32					mSize;				// for MVT_VARIABLE the size of the length in front of the data
+		S32					mBlock;				// index in getDecodeBlocks()
+	};
+
+	typedef std::vector<DecodeBlock> decode_block_list_t;
+	typedef std::vector<DecodeVariable> decode_variable_list_t;
+
+	// Builds the tables if a block was added since the last time.
+	void prepareDecodeTables()
+	{
+		if (!mDecodeTablesBuilt)
+		{
+			buildDecodeTables();
+		}
+	}
+
+	const decode_block_list_t& getDecodeBlocks() const			{ return mDecodeBlocks; }
+	const decode_variable_list_t& getDecodeVariables() const	{ return mDecodeVariables; }
+	// Largest size of a variable that isn't MVT_VARIABLE.
+	S32 getMaxFixedSize() const									{ return mMaxFixedSize; }
+
+	// Index in getDecodeBlocks(), or -1.
+	S32 findDecodeBlock(const char* block) const
+	{
+		for (S32 i = 0; i < (S32)mDecodeBlocks.size(); ++i)
+		{
+			if (mDecodeBlocks[i].mName == block)
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	// Index in getDecodeVariables(), or -1. Names must be canonical strings.
+	S32 findDecodeVariable(const char* block, const char* var) const
+	{
+		U32 mask = mDecodeHash.size() - 1;
+		for (U32 slot = decodeSlot(block, var); ; slot = (slot + 1) & mask)
+		{
+			S32 index = mDecodeHash[slot];
+			if (index < 0 ||
+				(mDecodeVariables[index].mName == var && mDecodeBlocks[mDecodeVariables[index].mBlock].mName == block))
+			{
+				return index;
+			}
+		}
+	}
+
 public:
 	typedef LLDynamicArrayIndexed<LLMessageBlock*, char*, 8> message_block_map_t;
 	message_block_map_t						mMemberBlocks;
@@ -416,6 +484,22 @@ private:
 	// message handler function (this is set by each application)
 	void									(*mHandlerFunc)(LLMessageSystem *msgsystem, void **user_data);
 	void									**mUserData;
+
+	void buildDecodeTables();
+
+	U32 decodeSlot(const char* block, const char* var) const
+	{
+		// The names are interned, so their addresses identify them.
+		U32 key = (U32)(size_t)block * 31 + (U32)(size_t)var;
+		return (key * 2654435761u) >> mDecodeHashShift;
+	}
+
+	bool									mDecodeTablesBuilt;
+	decode_block_list_t						mDecodeBlocks;
+	decode_variable_list_t					mDecodeVariables;
+	std::vector<S32>						mDecodeHash;		// indices in mDecodeVariables, -1 for free slots
+	U32										mDecodeHashShift;
+	S32										mMaxFixedSize;
 };
 
 #endif // LL_LLMESSAGETEMPLATE_H
@@ -0,0 +1,255 @@
+/**
+ * @file llobjectcachefile.cpp
+ * @brief On disk format of the object cache of one region
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llobjectcachefile.h"
+
+#include "llcrc.h"
+#include "llfile.h"
+
+// Header fields, in this order.
+static const S32 OFFSET_MAGIC = 0;
+static const S32 OFFSET_VERSION = 4;
+static const S32 OFFSET_REGION_ID = 8;
+static const S32 OFFSET_ENTRY_COUNT = OFFSET_REGION_ID + UUID_BYTES;
+static const S32 OFFSET_BODY_SIZE = OFFSET_ENTRY_COUNT + 4;
+static const S32 OFFSET_CRC = OFFSET_BODY_SIZE + 4;
+
+// The cache stays on the machine that wrote it, so fields are in native order.
+static inline U32 get_u32(const U8* p)
+{
+	U32 value;
+	memcpy(&value, p, sizeof(U32));
+	return value;
+}
+
+static inline void put_u32(U8* p, U32 value)
+{
+	memcpy(p, &value, sizeof(U32));
+}
+
+static U32 body_crc(const std::vector<U8>& image)
+{
+	LLCRC crc;
+	if (image.size() > (size_t)LLObjectCacheFile::HEADER_SIZE)
+	{
+		crc.update(&image[LLObjectCacheFile::HEADER_SIZE], image.size() - LLObjectCacheFile::HEADER_SIZE);
+	}
+	return crc.getCRC();
+}
+
+LLObjectCacheFile::LLObjectCacheFile()
+:	mEntryCount(0),
+	mValid(false)
+{
+}
+
+void LLObjectCacheFile::clear(const LLUUID& region_id)
+{
+	mRegionID = region_id;
+	mEntryCount = 0;
+	mImage.clear();
+	mImage.resize(HEADER_SIZE);
+	mValid = true;
+}
+
+bool LLObjectCacheFile::addEntry(const Entry& entry)
+{
+	llassert(mValid);
+	if (entry.mSize < 1 || entry.mSize > MAX_ENTRY_SIZE || !entry.mData)
+	{
+		return false;
+	}
+
+	size_t offset = mImage.size();
+	mImage.resize(offset + ENTRY_HEADER_SIZE + entry.mSize);
+	U8* p = &mImage[offset];
+	put_u32(p, entry.mLocalID);
+	put_u32(p + 4, entry.mCRC);
+	put_u32(p + 8, (U32)entry.mHitCount);
+	put_u32(p + 12, (U32)entry.mDupeCount);
+	put_u32(p + 16, (U32)entry.mCRCChangeCount);
+	put_u32(p + 20, (U32)entry.mSize);
+	memcpy(p + ENTRY_HEADER_SIZE, entry.mData, entry.mSize);
+	++mEntryCount;
+	return true;
+}
+
+void LLObjectCacheFile::updateHeader()
+{
+	U8* p = &mImage[0];
+	put_u32(p + OFFSET_MAGIC, MAGIC);
+	put_u32(p + OFFSET_VERSION, FORMAT_VERSION);
+	memcpy(p + OFFSET_REGION_ID, mRegionID.mData, UUID_BYTES);
+	put_u32(p + OFFSET_ENTRY_COUNT, (U32)mEntryCount);
+	put_u32(p + OFFSET_BODY_SIZE, (U32)(mImage.size() - HEADER_SIZE));
+	put_u32(p + OFFSET_CRC, body_crc(mImage));
+}
+
+S32 LLObjectCacheFile::write(const std::string& filename)
+{
+	if (!mValid)
+	{
+		return 0;
+	}
+	updateHeader();
+
+	LLFILE* fp = LLFile::fopen(filename, "wb");
+	if (!fp)
+	{
+		llwarns << "Unable to open " << filename << " for writing" << llendl;
+		return 0;
+	}
+	size_t written = fwrite(&mImage[0], 1, mImage.size(), fp);
+	bool success = written == mImage.size();
+	if (LLFile::close(fp) != 0)
+	{
+		success = false;
+	}
+	if (!success)
+	{
+		llwarns << "Short write of " << filename << llendl;
+		return 0;
+	}
+	return (S32)mImage.size();
+}
+
+bool LLObjectCacheFile::read(const std::string& filename)
+{
+	mValid = false;
+	mEntryCount = 0;
+	mImage.clear();
+
+	LLFILE* fp = LLFile::fopen(filename, "rb");
+	if (!fp)
+	{
+		return false;
+	}
+	// One read of the whole file; the header is checked against it afterwards.
+	std::vector<U8> image;
+	bool success = fseek(fp, 0, SEEK_END) == 0;
+	long size = success ? ftell(fp) : -1;
+	success = size >= HEADER_SIZE && fseek(fp, 0, SEEK_SET) == 0;
+	if (success)
+	{
+		image.resize(size);
+		success = fread(&image[0], 1, size, fp) == (size_t)size;
+	}
+	LLFile::close(fp);
+
+	if (!success)
+	{
+		llwarns << "Unable to read object cache file " << filename << llendl;
+		return false;
+	}
+	return assign(image);
+}
+
+bool LLObjectCacheFile::assign(std::vector<U8>& image)
+{
+	mValid = false;
+	mEntryCount = 0;
+	mImage.swap(image);
+	image.clear();
+
+	if (mImage.size() < (size_t)HEADER_SIZE)
+	{
+		mImage.clear();
+		return false;
+	}
+	if (!validate())
+	{
+		mImage.clear();
+		mEntryCount = 0;
+		return false;
+	}
+	mValid = true;
+	return true;
+}
+
+bool LLObjectCacheFile::validate()
+{
+	const U8* p = &mImage[0];
+	if (get_u32(p + OFFSET_MAGIC) != MAGIC ||
+		get_u32(p + OFFSET_VERSION) != FORMAT_VERSION)
+	{
+		llinfos << "Object cache file of another format, ignoring" << llendl;
+		return false;
+	}
+	if (get_u32(p + OFFSET_BODY_SIZE) != mImage.size() - HEADER_SIZE)
+	{
+		llwarns << "Object cache file size mismatch" << llendl;
+		return false;
+	}
+	if (get_u32(p + OFFSET_CRC) != body_crc(mImage))
+	{
+		llwarns << "Object cache file CRC mismatch" << llendl;
+		return false;
+	}
+	memcpy(mRegionID.mData, p + OFFSET_REGION_ID, UUID_BYTES);
+	mEntryCount = (S32)get_u32(p + OFFSET_ENTRY_COUNT);
+
+	// The CRC only says the file is what was written: check that the entries
+	// add up so that nextEntry() has nothing left to fail on.
+	S32 offset = 0;
+	Entry entry;
+	S32 count = 0;
+	while (nextEntry(offset, entry))
+	{
+		++count;
+	}
+	if (count != mEntryCount || HEADER_SIZE + offset != (S32)mImage.size())
+	{
+		llwarns << "Object cache file entries don't add up" << llendl;
+		return false;
+	}
+	return true;
+}
+
+bool LLObjectCacheFile::nextEntry(S32& offset, Entry& entry) const
+{
+	S32 pos = HEADER_SIZE + offset;
+	if (pos + ENTRY_HEADER_SIZE > (S32)mImage.size())
+	{
+		return false;
+	}
+	const U8* p = &mImage[pos];
+	entry.mLocalID = get_u32(p);
+	entry.mCRC = get_u32(p + 4);
+	entry.mHitCount = (S32)get_u32(p + 8);
+	entry.mDupeCount = (S32)get_u32(p + 12);
+	entry.mCRCChangeCount = (S32)get_u32(p + 16);
+	entry.mSize = (S32)get_u32(p + 20);
+	if (entry.mSize < 1 || entry.mSize > MAX_ENTRY_SIZE ||
+		pos + ENTRY_HEADER_SIZE + entry.mSize > (S32)mImage.size())
+	{
+		return false;
+	}
+	entry.mData = p + ENTRY_HEADER_SIZE;
+	offset += ENTRY_HEADER_SIZE + entry.mSize;
+	return true;
+}
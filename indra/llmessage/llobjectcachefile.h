@@ -0,0 +1,100 @@
+/**
+ * @file llobjectcachefile.h
+ * @brief On disk format of the object cache of one region
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTCACHEFILE_H
+#define LL_LLOBJECTCACHEFILE_H
+
+#include <string>
+#include <vector>
+
+#include "lluuid.h"
+
+// The cached objects of a region as one block: a fixed size header holding
+// the region id, the number of entries and a CRC of everything after the
+// header, followed by the entries, each a fixed size record and its data.
+// Nothing in it is a pointer or depends on where it is loaded, so the file
+// is read with a single read (or could be mapped) and checked as a whole
+// before a single entry is looked at.
+//
+// Reading only touches the object itself and the file, so it can be done on
+// any thread.
+class LLObjectCacheFile
+{
+public:
+	struct Entry
+	{
+		U32 mLocalID;
+		U32 mCRC;
+		S32 mHitCount;
+		S32 mDupeCount;
+		S32 mCRCChangeCount;
+		S32 mSize;
+		const U8* mData;	// mSize bytes, owned by the LLObjectCacheFile.
+	};
+
+	enum
+	{
+		MAGIC = 0x434f4c53,				// "SLOC"
+		FORMAT_VERSION = 1,
+		HEADER_SIZE = 5 * 4 + UUID_BYTES,
+		ENTRY_HEADER_SIZE = 6 * 4,
+		MAX_ENTRY_SIZE = 10000			// Anything bigger is corruption.
+	};
+
+	LLObjectCacheFile();
+
+	// Starts a new image for region_id, dropping what was read or added.
+	void clear(const LLUUID& region_id);
+	// Returns false (and adds nothing) if entry is empty or too big.
+	bool addEntry(const Entry& entry);
+	// Writes the image; returns the size of the file, 0 on failure.
+	S32 write(const std::string& filename);
+
+	// Loads the whole file; false if it is missing, truncated, of another
+	// format version or does not match its CRC.
+	bool read(const std::string& filename);
+	// Same checks on an image that is already in memory (takes its content).
+	bool assign(std::vector<U8>& image);
+
+	const LLUUID& getRegionID() const		{ return mRegionID; }
+	S32 getEntryCount() const				{ return mEntryCount; }
+	S32 getSize() const						{ return (S32)mImage.size(); }
+
+	// Walks the entries: start with offset 0. Returns false past the last entry.
+	bool nextEntry(S32& offset, Entry& entry) const;
+
+private:
+	bool validate();
+	void updateHeader();
+
+private:
+	std::vector<U8> mImage;
+	LLUUID mRegionID;
+	S32 mEntryCount;
+	bool mValid;
+};
+
+#endif // LL_LLOBJECTCACHEFILE_H
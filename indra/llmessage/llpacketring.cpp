@@ -60,7 +60,15 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mInjectedData(NULL),
+	mInjectedSize(0),
+	mUseBatchedIO(FALSE),
+	mBatchingSends(FALSE),
+	mReceivedCount(0),
+	mReceivedNext(0),
+	mSendBatchCount(0),
+	mSendBatchSocket(-1)
 {
 }
 
@@ -88,6 +96,10 @@ void LLPacketRing::cleanup ()
 		delete packetp;
 		mSendQueue.pop();
 	}
+
+	mReceivedCount = mReceivedNext = 0;
+	mSendBatchCount = 0;
+	mBatchingSends = FALSE;
 }
 
 ///////////////////////////////////////////////////////////
@@ -121,6 +133,73 @@ void LLPacketRing::setOutBandwidth(const F32 bps)
 {
 	mOutThrottle.setRate(bps);
 }
+
+void LLPacketRing::setUseBatchedIO(const BOOL use_batched_io)
+{
+	mUseBatchedIO = use_batched_io;
+	if (mUseBatchedIO && mReceiveSlab.empty())
+	{
+		mReceiveSlab.resize(NET_MAX_BATCH * NET_BUFFER_SIZE);
+		mSendSlab.resize(NET_MAX_BATCH * NET_BUFFER_SIZE);
+		for (S32 i = 0; i < NET_MAX_BATCH; ++i)
+		{
+			mReceived[i].mData = &mReceiveSlab[i * NET_BUFFER_SIZE];
+			mSendBatch[i].mData = &mSendSlab[i * NET_BUFFER_SIZE];
+		}
+	}
+}
+
+void LLPacketRing::beginSendBatch()
+{
+	mBatchingSends = mUseBatchedIO;
+}
+
+void LLPacketRing::endSendBatch()
+{
+	sendBatch();
+	mBatchingSends = FALSE;
+}
+
+BOOL LLPacketRing::receiveBatch(S32 socket)
+{
+	mReceivedNext = 0;
+	mReceivedCount = receive_packets(socket, mReceived, NET_MAX_BATCH);
+	if (mReceivedCount < 0)
+	{
+		// Can't batch here, go back to a packet at a time.
+		mReceivedCount = 0;
+		mUseBatchedIO = FALSE;
+	}
+	return mReceivedCount > 0;
+}
+
+void LLPacketRing::queueSend(int h_socket, const char* send_buffer, S32 buf_size, const LLHost& host)
+{
+	if (mSendBatchCount == NET_MAX_BATCH || (mSendBatchCount && h_socket != mSendBatchSocket))
+	{
+		sendBatch();
+	}
+	mSendBatchSocket = h_socket;
+
+	LLNetDatagram& datagram = mSendBatch[mSendBatchCount++];
+	memcpy(datagram.mData, send_buffer, buf_size);	/*Flawfinder: ignore*/
+	datagram.mSize = buf_size;
+	datagram.mAddress = host.getAddress();
+	datagram.mPort = host.getPort();
+}
+
+void LLPacketRing::sendBatch()
+{
+	if (mSendBatchCount)
+	{
+		S32 sent = send_packets(mSendBatchSocket, mSendBatch, mSendBatchCount);
+		if (sent < mSendBatchCount)
+		{
+			llwarns << "Failed to send " << mSendBatchCount - sent << " of " << mSendBatchCount << " batched packets" << llendl;
+		}
+		mSendBatchCount = 0;
+	}
+}
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 {
@@ -158,11 +237,29 @@ S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 	return packet_size;
 }
 
+///////////////////////////////////////////////////////////
+void LLPacketRing::injectPacket(const LLHost& sender, const char* datap, S32 size)
+{
+	mInjectedData = datap;
+	mInjectedSize = size;
+	mInjectedSender = sender;
+}
+
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 {
 	S32 packet_size = 0;
 
+	if (mInjectedData)
+	{
+		packet_size = mInjectedSize;
+		memcpy(datap, mInjectedData, packet_size);	/*Flawfinder: ignore*/
+		mLastSender = mInjectedSender;
+		mLastReceivingIF = LLHost();
+		mInjectedData = NULL;
+		return packet_size;
+	}
+
 	// If using the throttle, simulate a limited size input buffer.
 	if (mUseInThrottle)
 	{
@@ -248,15 +345,23 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 			{
 				packet_size = 0;
 			}
+			mLastReceivingIF = ::get_receiving_interface();
 		}
-		else
+		else if (mReceivedNext < mReceivedCount || (mUseBatchedIO && receiveBatch(socket)))
+		{
+			const LLNetDatagram& datagram = mReceived[mReceivedNext++];
+			packet_size = datagram.mSize;
+			memcpy(datap, datagram.mData, packet_size);	/*Flawfinder: ignore*/
+			mLastSender = LLHost(datagram.mAddress, datagram.mPort);
+			mLastReceivingIF = LLHost(datagram.mReceivingIFAddr, INVALID_PORT);
+		}
+		else if (!mUseBatchedIO)
 		{
 			packet_size = receive_packet(socket, datap);
 			mLastSender = ::get_sender();
+			mLastReceivingIF = ::get_receiving_interface();
 		}
 
-		mLastReceivingIF = ::get_receiving_interface();
-
 		if (packet_size)  // did we actually get a packet?
 		{
 			if (mDropPercentage && (ll_frand(100.f) < mDropPercentage))
@@ -272,6 +377,13 @@ S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 		}
 	}
 
+	//<edit>
+	if (packet_size > 0 && LLMessageLog::isCapturing())
+	{
+		LLMessageLog::capture(mLastSender, (U8*)datap, packet_size);
+	}
+	//</edit>
+
 	return packet_size;
 }
 
@@ -358,6 +470,11 @@ BOOL LLPacketRing::sendPacketImpl(int h_socket, const char * send_buffer, S32 bu
 	
 	if (!LLProxy::isSOCKSProxyEnabled())
 	{
+		if (mBatchingSends && buf_size <= NET_BUFFER_SIZE)
+		{
+			queueSend(h_socket, send_buffer, buf_size, host);
+			return TRUE;
+		}
 		return send_packet(h_socket, send_buffer, buf_size, host.getAddress(), host.getPort());
 	}
 
@@ -29,6 +29,7 @@
 #define LL_LLPACKETRING_H
 
 #include <queue>
+#include <vector>
 
 #include "llhost.h"
 #include "llpacketbuffer.h"
@@ -50,8 +51,19 @@ public:
 	void setUseOutThrottle(const BOOL use_throttle);
 	void setInBandwidth(const F32 bps);
 	void setOutBandwidth(const F32 bps);
+	// Read all waiting packets (up to NET_MAX_BATCH) with one system call and
+	// hand them out one receivePacket() at a time, and allow send batches.
+	// Turns itself off where the platform can't batch.
+	void setUseBatchedIO(const BOOL use_batched_io);
+	// Packets sent between these two are queued and go out together at the end,
+	// with as few system calls as possible. sendPacket() returns TRUE for them.
+	void beginSendBatch();
+	void endSendBatch();
 	S32  receivePacket (S32 socket, char *datap);
 	S32  receiveFromRing (S32 socket, char *datap);
+	// The next receivePacket() returns this packet instead of reading the socket.
+	// datap is not copied until then. For replaying captured traffic.
+	void injectPacket(const LLHost& sender, const char* datap, S32 size);
 
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
 
@@ -83,8 +95,29 @@ protected:
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
 
+	const char* mInjectedData;
+	S32 mInjectedSize;
+	LLHost mInjectedSender;
+
+	BOOL mUseBatchedIO;
+	BOOL mBatchingSends;
+
+	// NET_MAX_BATCH packets of NET_BUFFER_SIZE bytes each, allocated on first use
+	std::vector<char> mReceiveSlab;
+	LLNetDatagram mReceived[NET_MAX_BATCH];
+	S32 mReceivedCount;
+	S32 mReceivedNext;
+
+	std::vector<char> mSendSlab;
+	LLNetDatagram mSendBatch[NET_MAX_BATCH];
+	S32 mSendBatchCount;
+	int mSendBatchSocket;
+
 private:
 	BOOL sendPacketImpl(int h_socket, const char * send_buffer, S32 buf_size, LLHost host);
+	BOOL receiveBatch(S32 socket);
+	void queueSend(int h_socket, const char* send_buffer, S32 buf_size, const LLHost& host);
+	void sendBatch();
 };
 
 
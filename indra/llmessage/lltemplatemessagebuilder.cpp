@@ -31,6 +31,7 @@
 #include "llmessagetemplate.h"
 #include "llmath.h"
 #include "llquaternion.h"
+#include "llzerocode.h"
 #include "u64.h"
 #include "v3dmath.h"
 #include "v3math.h"
@@ -500,63 +501,13 @@ static S32 zero_code(U8 **data, U32 *data_size)
 	// coding can potentially increase the size of the send data.
 	static U8 encodedSendBuffer[2 * MAX_BUFFER_SIZE];
 
-	S32 count = *data_size;
-	
-	S32 net_gain = 0;
-	U8 num_zeroes = 0;
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)encodedSendBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE ; ++ii)
-	{
-		count--;
-		*outptr++ = *inptr++;
-	}
-
-// build encoded packet, keeping track of net size gain
+	// skip the packet id field
+	memcpy(encodedSendBuffer, *data, LL_PACKET_ID_SIZE);		/* Flawfinder: ignore */
 
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (!(*inptr))   // in a zero count
-		{
-			if (num_zeroes)
-			{
-				if (++num_zeroes > 254)
-				{
-					*outptr++ = num_zeroes;
-					num_zeroes = 0;
-				}
-				net_gain--;   // subseqent zeroes save one
-			}
-			else
-			{
-				*outptr++ = 0;
-				net_gain++;  // starting a zero count adds one
-				num_zeroes = 1;
-			}
-			inptr++;
-		}
-		else
-		{
-			if (num_zeroes)
-			{
-				*outptr++ = num_zeroes;
-				num_zeroes = 0;
-			}
-			*outptr++ = *inptr++;
-		}
-	}
-
-	if (num_zeroes)
-	{
-		*outptr++ = num_zeroes;
-	}
+	// build encoded packet, keeping track of net size gain
+	S32 encoded_size = zero_code_encode(*data + LL_PACKET_ID_SIZE, *data_size - LL_PACKET_ID_SIZE,
+										encodedSendBuffer + LL_PACKET_ID_SIZE);
+	S32 net_gain = encoded_size + LL_PACKET_ID_SIZE - (S32)*data_size;
 
 	if (net_gain < 0)
 	{
@@ -42,25 +42,55 @@ LLTemplateMessageReader::LLTemplateMessageReader(message_template_number_map_t&
 												 number_template_map) :
 	mReceiveSize(0),
 	mCurrentRMessageTemplate(NULL),
-	mCurrentRMessageData(NULL),
-	mMessageNumbers(number_template_map)
+	mMessageNumbers(number_template_map),
+	mDecoded(false)
 {
 }
 
 //virtual 
 LLTemplateMessageReader::~LLTemplateMessageReader()
 {
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
 }
 
 //virtual
+U8* LLTemplateMessageReader::getPacketBuffer(S32 size)
+{
+	if ((S32)mBuffer.size() < size)
+	{
+		mBuffer.resize(size);
+	}
+	return &mBuffer[0];
+}
+
 void LLTemplateMessageReader::clearMessage()
 {
 	mReceiveSize = -1;
 	mCurrentRMessageTemplate = NULL;
-	delete mCurrentRMessageData;
-	mCurrentRMessageData = NULL;
+	mDecoded = false;
+}
+
+S32 LLTemplateMessageReader::findField(const char *blockname, S32 blocknum, const char *varname) const
+{
+	S32 var_index = mCurrentRMessageTemplate->findDecodeVariable(blockname, varname);
+	if (var_index < 0)
+	{
+		// Tell the two apart for the error messages.
+		S32 block_index = mCurrentRMessageTemplate->findDecodeBlock(blockname);
+		if (block_index < 0 || blocknum < 0 || blocknum >= mDecodedBlocks[block_index].mCount)
+		{
+			return FIELD_NO_BLOCK;
+		}
+		return FIELD_NO_VARIABLE;
+	}
+
+	const LLMessageTemplate::DecodeVariable& var = mCurrentRMessageTemplate->getDecodeVariables()[var_index];
+	const DecodedBlock& decoded_block = mDecodedBlocks[var.mBlock];
+	if (blocknum < 0 || blocknum >= decoded_block.mCount)
+	{
+		return FIELD_NO_BLOCK;
+	}
+	const LLMessageTemplate::DecodeBlock& block = mCurrentRMessageTemplate->getDecodeBlocks()[var.mBlock];
+	return decoded_block.mFirstField + blocknum * block.mVariableCount + var_index - block.mFirstVariable;
 }
 
 void LLTemplateMessageReader::getData(const char *blockname, const char *varname, void *datap, S32 size, S32 blocknum, S32 max_size)
@@ -72,77 +102,85 @@ void LLTemplateMessageReader::getData(const char *blockname, const char *varname
 		return;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{
-		llerrs << "Invalid mCurrentMessageData in getData!" << llendl;
+		llerrs << "No decoded message in getData!" << llendl;
 		return;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; // this works because it's just a hash.  The bnamep is never derefference
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 index = findField(blockname, blocknum, varname);
+	if (index == FIELD_NO_BLOCK)
 	{
 		llerrs << "Block " << blockname << " #" << blocknum
-			<< " not in message " << mCurrentRMessageData->mName << llendl;
+			<< " not in message " << mCurrentRMessageTemplate->mName << llendl;
 		return;
 	}
-
-	LLMsgBlkData *msg_block_data = iter->second;
-	LLMsgVarData& vardata = msg_block_data->mMemberVarData[vnamep];
-
-	if (!vardata.getName())
+	if (index == FIELD_NO_VARIABLE)
 	{
-		llerrs << "Variable "<< vnamep << " not in message "
-			<< mCurrentRMessageData->mName<< " block " << bnamep << llendl;
+		llerrs << "Variable "<< varname << " not in message "
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << llendl;
 		return;
 	}
 
-	if (size && size != vardata.getSize())
+	const DecodedField& field = mDecodedFields[index];
+	const S32 vardata_size = field.mSize;
+	if (size && size != vardata_size)
 	{
-		llerrs << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		llerrs << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << vardata_size
 			<< " but copying into buffer of size " << size
 			<< llendl;
 		return;
 	}
 
-
-	const S32 vardata_size = vardata.getSize();
+	const U8* data = &mBuffer[0] + field.mOffset;
+#ifdef LL_BIG_ENDIAN
+	// mBuffer is in network order, like the packet
+	if( max_size >= vardata_size )
+	{
+		S32 var_index = mCurrentRMessageTemplate->findDecodeVariable(blockname, varname);
+		htonmemcpy(datap, data, mCurrentRMessageTemplate->getDecodeVariables()[var_index].mType, vardata_size);
+		return;
+	}
+#endif
 	if( max_size >= vardata_size )
 	{   
+		// The packet has no alignment; constant sizes still become single moves.
 		switch( vardata_size )
 		{ 
 		case 1:
-			*((U8*)datap) = *((U8*)vardata.getData());
+			*((U8*)datap) = *data;
 			break;
 		case 2:
-			*((U16*)datap) = *((U16*)vardata.getData());
+			memcpy(datap, data, 2);
 			break;
 		case 4:
-			*((U32*)datap) = *((U32*)vardata.getData());
+			memcpy(datap, data, 4);
 			break;
 		case 8:
-			((U32*)datap)[0] = ((U32*)vardata.getData())[0];
-			((U32*)datap)[1] = ((U32*)vardata.getData())[1];
+			memcpy(datap, data, 8);
+			break;
+		case 12:
+			memcpy(datap, data, 12);
+			break;
+		case 16:
+			memcpy(datap, data, 16);
 			break;
 		default:
-			memcpy(datap, vardata.getData(), vardata_size);
+			memcpy(datap, data, vardata_size);
 			break;
 		}
 	}
 	else
 	{
-		llwarns << "Msg " << mCurrentRMessageData->mName 
-			<< " variable " << vnamep
-			<< " is size " << vardata.getSize()
+		llwarns << "Msg " << mCurrentRMessageTemplate->mName 
+			<< " variable " << varname
+			<< " is size " << vardata_size
 			<< " but truncated to max size of " << max_size
 			<< llendl;
 
-		memcpy(datap, vardata.getData(), max_size);
+		memcpy(datap, data, max_size);
 	}
 }
 
@@ -155,22 +193,19 @@ S32 LLTemplateMessageReader::getNumberOfBlocks(const char *blockname)
 		return -1;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
+		llerrs << "No decoded message in getNumberOfBlocks!" << llendl;
 		return -1;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 block_index = mCurrentRMessageTemplate->findDecodeBlock(blockname);
+	if (block_index < 0)
 	{
 		return 0;
 	}
 
-	return (iter->second)->mBlockNumber;
+	return mDecodedBlocks[block_index].mCount;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
@@ -182,43 +217,35 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, const char *varname)
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{	// This is a serious error - crash
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
+		llerrs << "No decoded message in getSize!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 index = findField(blockname, 0, varname);
+	if (index == FIELD_NO_BLOCK)
 	{	// don't crash
-		llinfos << "Block " << bnamep << " not in message "
-			<< mCurrentRMessageData->mName << llendl;
+		llinfos << "Block " << blockname << " not in message "
+			<< mCurrentRMessageTemplate->mName << llendl;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
-
-	char *vnamep = (char *)varname; 
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	if (index == FIELD_NO_VARIABLE)
 	{	// don't crash
 		llinfos << "Variable " << varname << " not in message "
-			<< mCurrentRMessageData->mName << " block " << bnamep << llendl;
+			<< mCurrentRMessageTemplate->mName << " block " << blockname << llendl;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	if (mCurrentRMessageTemplate->mMemberBlocks[bnamep]->mType != MBT_SINGLE)
+	S32 block_index = mCurrentRMessageTemplate->findDecodeBlock(blockname);
+	if (mCurrentRMessageTemplate->getDecodeBlocks()[block_index].mType != MBT_SINGLE)
 	{	// This is a serious error - crash
-		llerrs << "Block " << bnamep << " isn't type MBT_SINGLE,"
+		llerrs << "Block " << blockname << " isn't type MBT_SINGLE,"
 			" use getSize with blocknum argument!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	return vardata.getSize();
+	return mDecodedFields[index].mSize;
 }
 
 S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const char *varname)
@@ -230,35 +257,27 @@ S32 LLTemplateMessageReader::getSize(const char *blockname, S32 blocknum, const
 		return LL_MESSAGE_ERROR;
 	}
 
-	if (!mCurrentRMessageData)
+	if (!mDecoded)
 	{	// This is a serious error - crash
-		llerrs << "Invalid mCurrentRMessageData in getData!" << llendl;
+		llerrs << "No decoded message in getSize!" << llendl;
 		return LL_MESSAGE_ERROR;
 	}
 
-	char *bnamep = (char *)blockname + blocknum; 
-	char *vnamep = (char *)varname; 
-
-	LLMsgData::msg_blk_data_map_t::const_iterator iter = mCurrentRMessageData->mMemberBlocks.find(bnamep);
-	
-	if (iter == mCurrentRMessageData->mMemberBlocks.end())
+	S32 index = findField(blockname, blocknum, varname);
+	if (index == FIELD_NO_BLOCK)
 	{	// don't crash
-		llinfos << "Block " << bnamep << " not in message " 
-			<< mCurrentRMessageData->mName << llendl;
+		llinfos << "Block " << blockname << " #" << blocknum << " not in message " 
+			<< mCurrentRMessageTemplate->mName << llendl;
 		return LL_BLOCK_NOT_IN_MESSAGE;
 	}
-
-	LLMsgBlkData* msg_data = iter->second;
-	LLMsgVarData& vardata = msg_data->mMemberVarData[vnamep];
-	
-	if (!vardata.getName())
+	if (index == FIELD_NO_VARIABLE)
 	{	// don't crash
-		llinfos << "Variable " << vnamep << " not in message "
-			<<  mCurrentRMessageData->mName << " block " << bnamep << llendl;
+		llinfos << "Variable " << varname << " not in message "
+			<<  mCurrentRMessageTemplate->mName << " block " << blockname << llendl;
 		return LL_VARIABLE_NOT_IN_BLOCK;
 	}
 
-	return vardata.getSize();
+	return mDecodedFields[index].mSize;
 }
 
 void LLTemplateMessageReader::getBinaryData(const char *blockname, 
@@ -535,40 +554,58 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 {
 	llassert( mReceiveSize >= 0 );
 	llassert( mCurrentRMessageTemplate);
-	llassert( !mCurrentRMessageData );
-	delete mCurrentRMessageData; // just to make sure
+	llassert( !mDecoded );
+
+	mCurrentRMessageTemplate->prepareDecodeTables();
+	const LLMessageTemplate::decode_block_list_t& blocks = mCurrentRMessageTemplate->getDecodeBlocks();
+	const LLMessageTemplate::decode_variable_list_t& variables = mCurrentRMessageTemplate->getDecodeVariables();
+
+	// Copy the packet, so that callers can reuse theirs while the message is read,
+	// unless it is in getPacketBuffer() already. Fixed size variables that run off
+	// its end read the zeros behind it.
+	const S32 zeros_pos = mReceiveSize;
+	const S32 zeros_size = llmax(mCurrentRMessageTemplate->getMaxFixedSize(), 1);
+	const bool in_place = !mBuffer.empty() && buffer == &mBuffer[0];
+	if ((S32)mBuffer.size() < zeros_pos + zeros_size)
+	{
+		mBuffer.resize(zeros_pos + zeros_size);
+	}
+	if (!in_place)
+	{
+		memcpy(&mBuffer[0], buffer, mReceiveSize);
+	}
+	memset(&mBuffer[zeros_pos], 0, zeros_size);
+	buffer = &mBuffer[0];
 
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
 	S32 decode_pos = LL_PACKET_ID_SIZE + (S32)(mCurrentRMessageTemplate->mFrequency) + offset;
 
-	// create base working data set
-	mCurrentRMessageData = new LLMsgData(mCurrentRMessageTemplate->mName);
-	
-	// loop through the template building the data structure as we go
-	LLMessageTemplate::message_block_map_t::const_iterator iter;
-	for(iter = mCurrentRMessageTemplate->mMemberBlocks.begin();
-		iter != mCurrentRMessageTemplate->mMemberBlocks.end();
-		++iter)
+	mDecodedBlocks.resize(blocks.size());
+	mDecodedFields.clear();
+	mDecoded = true;
+	S32 total_blocks = 0;
+
+	// loop through the template recording where each variable is as we go
+	for (S32 block_index = 0; block_index < (S32)blocks.size(); ++block_index)
 	{
-		LLMessageBlock* mbci = *iter;
-		U8	repeat_number;
-		S32	i;
+		const LLMessageTemplate::DecodeBlock& block = blocks[block_index];
+		S32 repeat_number;
 
 		// how many of this block?
 
-		if (mbci->mType == MBT_SINGLE)
+		if (block.mType == MBT_SINGLE)
 		{
 			// just one
 			repeat_number = 1;
 		}
-		else if (mbci->mType == MBT_MULTIPLE)
+		else if (block.mType == MBT_MULTIPLE)
 		{
 			// a known number
-			repeat_number = mbci->mNumber;
+			repeat_number = block.mNumber;
 		}
-		else if (mbci->mType == MBT_VARIABLE)
+		else if (block.mType == MBT_VARIABLE)
 		{
 			// need to read the number from the message
 			// repeat number is a single byte
@@ -594,42 +631,25 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 			return FALSE;
 		}
 
-		LLMsgBlkData* cur_data_block = NULL;
+		DecodedBlock& decoded_block = mDecodedBlocks[block_index];
+		decoded_block.mCount = repeat_number;
+		decoded_block.mFirstField = mDecodedFields.size();
+		total_blocks += repeat_number;
 
 		// now loop through the block
-		for (i = 0; i < repeat_number; i++)
+		for (S32 i = 0; i < repeat_number; i++)
 		{
-			if (i)
-			{
-				// build new name to prevent collisions
-				// TODO: This should really change to a vector
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-				cur_data_block->mName = mbci->mName + i;
-			}
-			else
-			{
-				cur_data_block = new LLMsgBlkData(mbci->mName, repeat_number);
-			}
-
-			// add the block to the message
-			mCurrentRMessageData->addBlock(cur_data_block);
-
 			// now read the variables
-			for (LLMessageBlock::message_variable_map_t::const_iterator iter = 
-					 mbci->mMemberVariables.begin();
-				 iter != mbci->mMemberVariables.end(); iter++)
+			for (S32 var_index = block.mFirstVariable; var_index < block.mFirstVariable + block.mVariableCount; ++var_index)
 			{
-				const LLMessageVariable& mvci = **iter;
-
-				// ok, build out the variables
-				// add variable block
-				cur_data_block->addVariable(mvci.getName(), mvci.getType());
+				const LLMessageTemplate::DecodeVariable& var = variables[var_index];
+				DecodedField field;
 
 				// what type of variable?
-				if (mvci.getType() == MVT_VARIABLE)
+				if (var.mType == MVT_VARIABLE)
 				{
 					// variable, get the number of bytes to read from the template
-					S32 data_size = mvci.getSize();
+					S32 data_size = var.mSize;
 					U8 tsizeb = 0;
 					U16 tsizeh = 0;
 					U32 tsize = 0;
@@ -664,39 +684,42 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 					}
 					decode_pos += data_size;
 
-					cur_data_block->addData(mvci.getName(), &buffer[decode_pos], tsize, mvci.getType());
+					if (tsize > (U32)llmax(mReceiveSize - decode_pos, 0))
+					{
+						// don't read past the packet, keep what there is
+						if (!custom)
+							logRanOffEndOfPacket(sender, decode_pos, tsize);
+
+						tsize = llmax(mReceiveSize - decode_pos, 0);
+					}
+					field.mOffset = tsize ? decode_pos : zeros_pos;
+					field.mSize = tsize;
 					decode_pos += tsize;
 				}
 				else
 				{
 					// fixed!
-					// so, copy data pointer and set data size to fixed size
-					if ((decode_pos + mvci.getSize()) > mReceiveSize)
+					if ((decode_pos + var.mSize) > mReceiveSize)
 					{
 						if(!custom)
-							logRanOffEndOfPacket(sender, decode_pos, mvci.getSize());
+							logRanOffEndOfPacket(sender, decode_pos, var.mSize);
 
 						// default to 0s.
-						U32 size = mvci.getSize();
-						std::vector<U8> data(size, 0);
-						cur_data_block->addData(mvci.getName(), &(data[0]), 
-												size, mvci.getType());
+						field.mOffset = zeros_pos;
 					}
 					else
 					{
-						cur_data_block->addData(mvci.getName(), 
-												&buffer[decode_pos], 
-												mvci.getSize(), 
-												mvci.getType());
+						field.mOffset = decode_pos;
 					}
-					decode_pos += mvci.getSize();
+					field.mSize = var.mSize;
+					decode_pos += var.mSize;
 				}
+				mDecodedFields.push_back(field);
 			}
 		}
 	}
 
-	if (mCurrentRMessageData->mMemberBlocks.empty()
-		&& !mCurrentRMessageTemplate->mMemberBlocks.empty())
+	if (!total_blocks && !blocks.empty())
 	{
 		lldebugs << "Empty message '" << mCurrentRMessageTemplate->mName << "' (no blocks)" << llendl;
 		return FALSE;
@@ -827,9 +850,33 @@ bool LLTemplateMessageReader::isUdpBanned() const
 //virtual 
 void LLTemplateMessageReader::copyToBuilder(LLMessageBuilder& builder) const
 {
-	if(NULL == mCurrentRMessageTemplate)
+	if(NULL == mCurrentRMessageTemplate || !mDecoded)
     {
         return;
     }
-	builder.copyFromMessageData(*mCurrentRMessageData);
+
+	// The builders copy from LLMsgData; build one like decodeData() used to.
+	LLMsgData data(mCurrentRMessageTemplate->mName);
+	const LLMessageTemplate::decode_block_list_t& blocks = mCurrentRMessageTemplate->getDecodeBlocks();
+	const LLMessageTemplate::decode_variable_list_t& variables = mCurrentRMessageTemplate->getDecodeVariables();
+	for (S32 block_index = 0; block_index < (S32)blocks.size(); ++block_index)
+	{
+		const LLMessageTemplate::DecodeBlock& block = blocks[block_index];
+		const DecodedBlock& decoded_block = mDecodedBlocks[block_index];
+		const DecodedField* field = &mDecodedFields[0] + decoded_block.mFirstField;
+		for (S32 i = 0; i < decoded_block.mCount; ++i)
+		{
+			LLMsgBlkData* block_data = new LLMsgBlkData(block.mName, decoded_block.mCount);
+			// repeated blocks are told apart by name
+			block_data->mName = block.mName + i;
+			data.addBlock(block_data);
+			for (S32 var_index = block.mFirstVariable; var_index < block.mFirstVariable + block.mVariableCount; ++var_index, ++field)
+			{
+				const LLMessageTemplate::DecodeVariable& var = variables[var_index];
+				block_data->addVariable(var.mName, var.mType);
+				block_data->addData(var.mName, &mBuffer[0] + field->mOffset, field->mSize, var.mType);
+			}
+		}
+	}
+	builder.copyFromMessageData(data);
 }
@@ -30,9 +30,9 @@
 #include "llmessagereader.h"
 
 #include <map>
+#include <vector>
 
 class LLMessageTemplate;
-class LLMsgData;
 
 class LLTemplateMessageReader : public LLMessageReader
 {
@@ -102,6 +102,10 @@ public:
 						 const LLHost& sender, bool trusted = false, bool custom = false);
 	BOOL readMessage(const U8* buffer, const LLHost& sender);
 
+	// Room for a packet of size bytes, which validateMessage() and readMessage()
+	// then read without copying it. Overwritten by the next message.
+	U8* getPacketBuffer(S32 size);
+
 	bool isTrusted() const;
 	bool isBanned(bool trusted_source) const;
 	bool isUdpBanned() const;
@@ -111,6 +115,10 @@ private:
 	void getData(const char *blockname, const char *varname, void *datap, 
 				 S32 size = 0, S32 blocknum = 0, S32 max_size = S32_MAX);
 
+	enum { FIELD_NO_BLOCK = -1, FIELD_NO_VARIABLE = -2 };
+	// Index in mDecodedFields, or FIELD_NO_BLOCK / FIELD_NO_VARIABLE.
+	S32 findField(const char *blockname, S32 blocknum, const char *varname) const;
+
 	BOOL decodeTemplate(const U8* buffer, S32 buffer_size,  // inputs
 						LLMessageTemplate** msg_template,   // outputs
 						bool custom = false);
@@ -121,8 +129,27 @@ private:
 
 	S32	mReceiveSize;
 	LLMessageTemplate* mCurrentRMessageTemplate;
-	LLMsgData* mCurrentRMessageData;
 	message_template_number_map_t& mMessageNumbers;
+
+	// The decoded message: a copy of the packet, followed by zeros for the fixed
+	// size variables past its end, and where every variable of every block is in it.
+	// Only grows, so decoding doesn't allocate once it has seen the largest message.
+	struct DecodedBlock
+	{
+		S32 mCount;
+		S32 mFirstField;	// index in mDecodedFields, then one field per variable per block
+	};
+
+	struct DecodedField
+	{
+		S32 mOffset;		// in mBuffer
+		S32 mSize;
+	};
+
+	bool mDecoded;
+	std::vector<U8> mBuffer;
+	std::vector<DecodedBlock> mDecodedBlocks;
+	std::vector<DecodedField> mDecodedFields;
 	friend class LLFloaterMessageLogItem;
 };
 
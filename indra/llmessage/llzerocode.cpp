@@ -0,0 +1,235 @@
+/**
+ * @file llzerocode.cpp
+ * @brief Zero coding of message packets
+ *
+ * $LicenseInfo:firstyear=2001&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llzerocode.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define LL_ZERO_CODE_SSE2 1
+#include <emmintrin.h>
+#if LL_WINDOWS
+#include <intrin.h>
+#endif
+#else
+#define LL_ZERO_CODE_SSE2 0
+#endif
+
+namespace
+{
+	bool sVectorized = LL_ZERO_CODE_SSE2;
+
+#if LL_ZERO_CODE_SSE2
+	// Bit n of the result is set when byte n of chunk is zero.
+	inline U32 zero_mask(const U8* chunk)
+	{
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)chunk), _mm_setzero_si128()));
+	}
+
+	inline S32 first_set_bit(U32 mask)
+	{
+#if LL_WINDOWS
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return (S32)index;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+#endif
+
+	// Returns the first zero byte at or after in, or end.
+	const U8* find_zero(const U8* in, const U8* end)
+	{
+#if LL_ZERO_CODE_SSE2
+		if (sVectorized)
+		{
+			for (; end - in >= 16; in += 16)
+			{
+				U32 mask = zero_mask(in);
+				if (mask)
+				{
+					return in + first_set_bit(mask);
+				}
+			}
+		}
+#endif
+		while (in < end && *in)
+		{
+			++in;
+		}
+		return in;
+	}
+
+	// Returns the first non zero byte at or after in, or end.
+	const U8* find_non_zero(const U8* in, const U8* end)
+	{
+#if LL_ZERO_CODE_SSE2
+		if (sVectorized)
+		{
+			for (; end - in >= 16; in += 16)
+			{
+				U32 mask = zero_mask(in) ^ 0xffff;
+				if (mask)
+				{
+					return in + first_set_bit(mask);
+				}
+			}
+		}
+#endif
+		while (in < end && !*in)
+		{
+			++in;
+		}
+		return in;
+	}
+}
+
+void zero_code_set_vectorized(bool vectorized)
+{
+	sVectorized = vectorized && LL_ZERO_CODE_SSE2;
+}
+
+bool zero_code_is_vectorized()
+{
+	return sVectorized;
+}
+
+S32 zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_size)
+{
+	const U8* in_end = in + in_size;
+	U8* const out_begin = out;
+	U8* const out_end = out + out_size;
+
+	while (in < in_end)
+	{
+		// copy everything up to the next zero
+#if LL_ZERO_CODE_SSE2
+		if (sVectorized)
+		{
+			// Whole chunks are stored while there is room for them; the bytes
+			// from the zero on are overwritten by what follows.
+			while (in_end - in >= 16 && out_end - out >= 16)
+			{
+				__m128i chunk = _mm_loadu_si128((const __m128i*)in);
+				_mm_storeu_si128((__m128i*)out, chunk);
+				U32 mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_setzero_si128()));
+				if (mask)
+				{
+					S32 length = first_set_bit(mask);
+					in += length;
+					out += length;
+					break;
+				}
+				in += 16;
+				out += 16;
+			}
+		}
+#endif
+		const U8* zero = find_zero(in, in_end);
+		S32 length = (S32)(zero - in);
+		if (length > out_end - out)
+		{
+			return -1;
+		}
+		memcpy(out, in, length);
+		out += length;
+		in = zero;
+		if (in == in_end)
+		{
+			break;
+		}
+
+		// a zero, then 256 more for every extra zero, then the count of the rest
+		S32 zeroes = 1;
+		++in;
+		while (in < in_end && !*in)
+		{
+			zeroes += 256;
+			++in;
+		}
+		if (in < in_end)
+		{
+			zeroes += *in - 1;
+			++in;
+		}
+		if (zeroes > out_end - out)
+		{
+			return -1;
+		}
+		memset(out, 0, zeroes);
+		out += zeroes;
+	}
+	return (S32)(out - out_begin);
+}
+
+S32 zero_code_encode(const U8* in, S32 in_size, U8* out)
+{
+	const U8* in_end = in + in_size;
+	U8* const out_begin = out;
+
+	while (in < in_end)
+	{
+		const U8* zero = find_zero(in, in_end);
+		memcpy(out, in, zero - in);
+		out += zero - in;
+		if (zero == in_end)
+		{
+			break;
+		}
+
+		// counts are at most 255, longer runs take several
+		in = find_non_zero(zero, in_end);
+		S32 zeroes = (S32)(in - zero);
+		for (; zeroes > 255; zeroes -= 255)
+		{
+			*out++ = 0;
+			*out++ = 255;
+		}
+		*out++ = 0;
+		*out++ = (U8)zeroes;
+	}
+	return (S32)(out - out_begin);
+}
+
+S32 zero_code_net_gain(const U8* in, S32 in_size)
+{
+	const U8* in_end = in + in_size;
+	S32 net_gain = 0;
+
+	while (in < in_end)
+	{
+		const U8* zero = find_zero(in, in_end);
+		if (zero == in_end)
+		{
+			break;
+		}
+		in = find_non_zero(zero, in_end);
+		S32 zeroes = (S32)(in - zero);
+		net_gain += 2 * ((zeroes + 254) / 255) - zeroes;
+	}
+	return net_gain;
+}
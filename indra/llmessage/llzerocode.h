@@ -0,0 +1,52 @@
+/**
+ * @file llzerocode.h
+ * @brief Zero coding of message packets
+ *
+ * $LicenseInfo:firstyear=2001&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2010, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLZEROCODE_H
+#define LL_LLZEROCODE_H
+
+#include "stdtypes.h"
+
+// Sequential zero bytes are encoded as 0 [U8 count], with 0 0 [count]
+// representing wrap (256 more zeroes for every extra 0). These work on the
+// data after the packet header, which is never zero coded.
+
+// Expands in_size bytes of zero coded data into out. Returns the expanded
+// size, or -1 if it would need more than out_size bytes.
+S32 zero_code_expand(const U8* in, S32 in_size, U8* out, S32 out_size);
+
+// Zero codes in_size bytes into out, which needs room for 2 * in_size bytes.
+// Returns the coded size.
+S32 zero_code_encode(const U8* in, S32 in_size, U8* out);
+
+// How many bytes zero coding in_size bytes would add: negative when it saves some.
+S32 zero_code_net_gain(const U8* in, S32 in_size);
+
+// The functions above scan 16 bytes at a time with SSE2 when the build targets it.
+// Turning that off is for comparing with the byte loops.
+void zero_code_set_vectorized(bool vectorized);
+bool zero_code_is_vectorized();
+
+#endif // LL_LLZEROCODE_H
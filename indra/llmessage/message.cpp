@@ -82,6 +82,8 @@
 #include "lltransfertargetvfile.h"
 #include "llmemtype.h"
 #include "llpacketring.h"
+#include "llmessagelog.h"
+#include "llzerocode.h"
 
 class AIHTTPTimeoutPolicy;
 extern AIHTTPTimeoutPolicy fnPtrResponder_timeout;
@@ -268,6 +270,8 @@ LLMessageSystem::LLMessageSystem(const std::string& filename, U32 port,
 	// default to blocking trusted connections on a public interface if one is specified
 	mBlockUntrustedInterface = true;
 
+	mDecodeInPlace = true;
+
 	mSendPacketFailureCount = 0;
 
 	mCircuitPrintFreq = 60.f;		// seconds
@@ -605,7 +609,16 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count )
 			}
 
 			// process the message as normal
-			mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			if (mDecodeInPlace)
+			{
+				mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size,
+														 mTemplateMessageReader->getPacketBuffer(MAX_BUFFER_SIZE),
+														 MAX_BUFFER_SIZE);
+			}
+			else
+			{
+				mIncomingCompressedSize = zeroCodeExpand(&buffer, &receive_size);
+			}
 			mCurrentRecvPacketID = ntohl(*((U32*)(&buffer[1])));
 			host = getSender();
 
@@ -819,12 +832,17 @@ void LLMessageSystem::processAcks()
 		// Check the status of circuits
 		mCircuitInfo.updateWatchDogTimers(this);
 
+		// the resends and the acks of all circuits go out together
+		mPacketRing->beginSendBatch();
+
 		//resend any necessary packets
 		mCircuitInfo.resendUnackedPackets(mUnackedListDepth, mUnackedListSize);
 
 		//cycle through ack list for each host we need to send acks to
 		mCircuitInfo.sendAcks();
 
+		mPacketRing->endSendBatch();
+
 		if (!mDenyTrustedCircuitSet.empty())
 		{
 			LL_INFOS("Messaging") << "Sending queued DenyTrustedCircuit messages." << llendl;
@@ -2697,6 +2715,7 @@ void end_messaging_system(bool print_summary)
 {
 	gTransferManager.cleanup();
 	LLTransferTargetVFile::updateQueue(true); // shutdown LLTransferTargetVFile
+	LLMessageLog::stopCapture();
 	if (gMessageSystem)
 	{
 		gMessageSystem->stopLogging();
@@ -2819,54 +2838,8 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 	// TODO: babbage: remove this horror
 	mMessageBuilder->setBuilt(FALSE);
 
-	S32 count = mSendSize;
-	
-	S32 net_gain = 0;
-	U8 num_zeroes = 0;
-	
-	U8 *inptr = (U8 *)mSendBuffer;
-
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
-	{
-		count--;
-		inptr++;
-	}
-
-// don't actually build, just test
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (!(*inptr))   // in a zero count
-		{
-			if (num_zeroes)
-			{
-				if (++num_zeroes > 254)
-				{
-					num_zeroes = 0;
-				}
-				net_gain--;   // subseqent zeroes save one
-			}
-			else
-			{
-				net_gain++;  // starting a zero count adds one
-				num_zeroes = 1;
-			}
-			inptr++;
-		}
-		else
-		{
-			if (num_zeroes)
-			{
-				num_zeroes = 0;
-			}
-			inptr++;
-		}
-	}
+	// skip the packet id field, don't actually build, just test
+	S32 net_gain = zero_code_net_gain(mSendBuffer + LL_PACKET_ID_SIZE, mSendSize - LL_PACKET_ID_SIZE);
 	if (net_gain < 0)
 	{
 		return net_gain;
@@ -2880,6 +2853,11 @@ S32 LLMessageSystem::zeroCodeAdjustCurrentSendTotal()
 
 
 S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
+{
+	return zeroCodeExpand(data, data_size, mEncodedRecvBuffer, MAX_BUFFER_SIZE);
+}
+
+S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size, U8* out, S32 out_size)
 {
 	if ((*data_size ) < LL_MINIMUM_VALID_PACKET_SIZE)
 	{
@@ -2901,72 +2879,21 @@ S32 LLMessageSystem::zeroCodeExpand(U8** data, S32* data_size)
 	
 	*data[0] &= (~LL_ZERO_CODE_FLAG);
 
-	S32 count = (*data_size);  
-	
-	U8 *inptr = (U8 *)*data;
-	U8 *outptr = (U8 *)mEncodedRecvBuffer;
+	// skip the packet id field
+	memcpy(out, *data, LL_PACKET_ID_SIZE);		/* Flawfinder: ignore */
 
-// skip the packet id field
-
-	for (U32 ii = 0; ii < LL_PACKET_ID_SIZE; ++ii)
+	// reconstruct encoded packet
+	S32 expanded_size = zero_code_expand(*data + LL_PACKET_ID_SIZE, in_size - LL_PACKET_ID_SIZE,
+										 out + LL_PACKET_ID_SIZE, out_size - LL_PACKET_ID_SIZE);
+	if (expanded_size < 0)
 	{
-		count--;
-		*outptr++ = *inptr++;
+		LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size" << llendl;
+		callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
+		expanded_size = -LL_PACKET_ID_SIZE;
 	}
 
-// reconstruct encoded packet, keeping track of net size gain
-
-// sequential zero bytes are encoded as 0 [U8 count] 
-// with 0 0 [count] representing wrap (>256 zeroes)
-
-	while (count--)
-	{
-		if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-1]))
-		{
-			LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 1" << llendl;
-			callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-			outptr = mEncodedRecvBuffer;					
-			break;
-		}
-		if (!((*outptr++ = *inptr++)))
-		{
-			while (((count--)) && (!(*inptr)))
-			{
-				*outptr++ = *inptr++;
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-256]))
-  				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 2" << llendl;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;
-					count = -1;
-					break;
-  				}
-				memset(outptr,0,255);
-				outptr += 255;
-			}
-			
-			if (count < 0)
-			{
-				break;
-			}
-
-			else
-			{
-  				if (outptr > (&mEncodedRecvBuffer[MAX_BUFFER_SIZE-(*inptr)]))
-				{
-  					LL_WARNS("Messaging") << "attempt to write past reasonable encoded buffer size 3" << llendl;
-					callExceptionFunc(MX_WROTE_PAST_BUFFER_SIZE);
-					outptr = mEncodedRecvBuffer;					
-				}
-				memset(outptr,0,(*inptr) - 1);
-				outptr += ((*inptr) - 1);
-				inptr++;
-			}
-		}		
-	}
-	
-	*data = mEncodedRecvBuffer;
-	*data_size = (S32)(outptr - mEncodedRecvBuffer);
+	*data = out;
+	*data_size = LL_PACKET_ID_SIZE + expanded_size;
 	mUncompressedBytesIn += *data_size;
 
 	return(in_size);
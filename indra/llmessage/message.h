@@ -218,6 +218,8 @@ class LLMessageSystem : public LLMessageSenderInterface
 	bool				mBlockUntrustedInterface;
 	LLHost				mUntrustedInterface;
 
+	bool				mDecodeInPlace;
+
  public:
 	LLPacketRing*				mPacketRing;
 	LLReliablePacketParams			mReliablePacketParams;
@@ -466,6 +468,7 @@ public:
 
 	S32     zeroCode(U8 **data, S32 *data_size);
 	S32		zeroCodeExpand(U8 **data, S32 *data_size);
+	S32		zeroCodeExpand(U8 **data, S32 *data_size, U8 *out, S32 out_size);
 	S32		zeroCodeAdjustCurrentSendTotal();
 
 	// Uses ping-based retry
@@ -621,6 +624,11 @@ public:
 	void setBlockUntrustedInterface( bool block ) { mBlockUntrustedInterface = block; } // Throw a switch to allow, sending warnings only
 	bool getBlockUntrustedInterface() const { return mBlockUntrustedInterface; }
 
+	// Expand zero coded packets straight into the template reader, which then
+	// reads them where they are, instead of into mEncodedRecvBuffer first.
+	void setDecodeInPlace(bool in_place) { mDecodeInPlace = in_place; }
+	bool getDecodeInPlace() const { return mDecodeInPlace; }
+
 	// Change this message to be UDP black listed.
 	void banUdpMessage(const std::string& name);
 
@@ -75,6 +75,7 @@ typedef int socklen_t;
 #endif
 
 static U32 gsnReceivingIFAddr = INVALID_HOST_IP_ADDRESS; // Address to which datagram was sent
+static U32 sNetCallCount = 0; // Socket system calls made by the functions below
 
 const char* LOOPBACK_ADDRESS_STRING = "127.0.0.1";
 const char* BROADCAST_ADDRESS_STRING = "255.255.255.255";
@@ -328,6 +329,7 @@ S32 receive_packet(int hSocket, char * receiveBuffer)
 	int nRet;
 	int addr_size = sizeof(struct sockaddr_in);
 
+	++sNetCallCount;
 	nRet = recvfrom(hSocket, receiveBuffer, NET_BUFFER_SIZE, 0, (struct sockaddr*)&stSrcAddr, &addr_size);
 	if (nRet == SOCKET_ERROR ) 
 	{
@@ -353,6 +355,7 @@ BOOL send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, i
 	stDstAddr.sin_port = htons(nPort);
 	do
 	{
+		++sNetCallCount;
 		nRet = sendto(hSocket, sendBuffer, size, 0, (struct sockaddr*)&stDstAddr, sizeof(stDstAddr));					
 
 		if (nRet == SOCKET_ERROR ) 
@@ -526,12 +529,31 @@ void end_net(S32& socket_out)
 }
 
 #if LL_LINUX
+// Sets dstip to the address the datagram received into msg was sent to, if the
+// socket has IP_PKTINFO on.
+static void get_destip(struct msghdr* msg, U32* dstip)
+{
+	for (struct cmsghdr* cmsgptr = CMSG_FIRSTHDR(msg); cmsgptr != NULL; cmsgptr = CMSG_NXTHDR(msg, cmsgptr))
+	{
+		if( cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO )
+		{
+			in_pktinfo *pktinfo = (in_pktinfo *)CMSG_DATA(cmsgptr);
+			if( pktinfo )
+			{
+				// Two choices. routed and specified. ipi_addr is routed, ipi_spec_dst is
+				// routed. We should stay with specified until we go to multiple
+				// interfaces
+				*dstip = pktinfo->ipi_spec_dst.s_addr;
+			}
+		}
+	}
+}
+
 static int recvfrom_destip( int socket, void *buf, int len, struct sockaddr *from, socklen_t *fromlen, U32 *dstip )
 {
 	int size;
 	struct iovec iov[1];
 	char cmsg[CMSG_SPACE(sizeof(struct in_pktinfo))];
-	struct cmsghdr *cmsgptr;
 	struct msghdr msg = {0};
 
 	iov[0].iov_base = buf;
@@ -552,20 +574,7 @@ static int recvfrom_destip( int socket, void *buf, int len, struct sockaddr *fro
 		return -1;
 	}
 
-	for (cmsgptr = CMSG_FIRSTHDR(&msg); cmsgptr != NULL; cmsgptr = CMSG_NXTHDR( &msg, cmsgptr))
-	{
-		if( cmsgptr->cmsg_level == SOL_IP && cmsgptr->cmsg_type == IP_PKTINFO )
-		{
-			in_pktinfo *pktinfo = (in_pktinfo *)CMSG_DATA(cmsgptr);
-			if( pktinfo )
-			{
-				// Two choices. routed and specified. ipi_addr is routed, ipi_spec_dst is
-				// routed. We should stay with specified until we go to multiple
-				// interfaces
-				*dstip = pktinfo->ipi_spec_dst.s_addr;
-			}
-		}
-	}
+	get_destip(&msg, dstip);
 
 	return size;
 }
@@ -581,6 +590,7 @@ int receive_packet(int hSocket, char * receiveBuffer)
 	socklen_t addr_size = sizeof(struct sockaddr_in);
 
 	gsnReceivingIFAddr = INVALID_HOST_IP_ADDRESS;
+	++sNetCallCount;
 
 #if LL_LINUX
 	nRet = recvfrom_destip(hSocket, receiveBuffer, NET_BUFFER_SIZE, (struct sockaddr*)&stSrcAddr, &addr_size, &gsnReceivingIFAddr);
@@ -613,6 +623,7 @@ BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient,
 
 	do
 	{
+		++sNetCallCount;
 		ret = sendto(hSocket, sendBuffer, size, 0,	(struct sockaddr*)&stDstAddr, sizeof(stDstAddr));
 		send_attempts++;
 
@@ -663,4 +674,156 @@ BOOL send_packet(int hSocket, const char * sendBuffer, int size, U32 recipient,
 
 #endif
 
+//////////////////////////////////////////////////////////////////////////////////////////
+// Batched Versions
+//////////////////////////////////////////////////////////////////////////////////////////
+
+#if LL_LINUX && defined(MSG_WAITFORONE)
+#define LL_NET_MMSG 1
+#else
+#define LL_NET_MMSG 0
+#endif
+
+#if LL_NET_MMSG
+// Set when the kernel turns out to be older than recvmmsg() or sendmmsg().
+static bool sNoRecvMMsg = false;
+static bool sNoSendMMsg = false;
+
+// Headers for the system calls; the packet data itself belongs to the caller.
+static struct mmsghdr sMsgs[NET_MAX_BATCH];
+static struct iovec sIOVecs[NET_MAX_BATCH];
+static struct sockaddr_in sAddrs[NET_MAX_BATCH];
+static char sControl[NET_MAX_BATCH][CMSG_SPACE(sizeof(struct in_pktinfo))];
+#endif
+
+S32 receive_packets(int hSocket, LLNetDatagram* datagrams, S32 count)
+{
+#if LL_NET_MMSG
+	if (sNoRecvMMsg)
+	{
+		return -1;
+	}
+
+	count = llmin(count, NET_MAX_BATCH);
+	for (S32 i = 0; i < count; ++i)
+	{
+		sIOVecs[i].iov_base = datagrams[i].mData;
+		sIOVecs[i].iov_len = NET_BUFFER_SIZE;
+
+		struct msghdr& msg = sMsgs[i].msg_hdr;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = &sAddrs[i];
+		msg.msg_namelen = sizeof(sAddrs[i]);
+		msg.msg_iov = &sIOVecs[i];
+		msg.msg_iovlen = 1;
+		msg.msg_control = sControl[i];
+		msg.msg_controllen = sizeof(sControl[i]);
+	}
+
+	++sNetCallCount;
+	int received = recvmmsg(hSocket, sMsgs, count, MSG_DONTWAIT, NULL);
+	if (received == -1)
+	{
+		if (errno == ENOSYS)
+		{
+			llinfos << "recvmmsg() not available, receiving one packet at a time" << llendl;
+			sNoRecvMMsg = true;
+			return -1;
+		}
+		// Nothing waiting, or an error receive_packet() would have returned zero for.
+		return 0;
+	}
+
+	for (S32 i = 0; i < received; ++i)
+	{
+		LLNetDatagram& datagram = datagrams[i];
+		datagram.mSize = sMsgs[i].msg_len;
+		datagram.mAddress = sAddrs[i].sin_addr.s_addr;
+		datagram.mPort = ntohs(sAddrs[i].sin_port);
+		datagram.mReceivingIFAddr = INVALID_HOST_IP_ADDRESS;
+		get_destip(&sMsgs[i].msg_hdr, &datagram.mReceivingIFAddr);
+	}
+	return received;
+#else
+	return -1;
+#endif
+}
+
+S32 send_packets(int hSocket, const LLNetDatagram* datagrams, S32 count)
+{
+	S32 sent = 0;
+	S32 next = 0;
+
+#if LL_NET_MMSG
+	while (next < count && !sNoSendMMsg)
+	{
+		S32 batch = llmin(count - next, NET_MAX_BATCH);
+		for (S32 i = 0; i < batch; ++i)
+		{
+			const LLNetDatagram& datagram = datagrams[next + i];
+			sIOVecs[i].iov_base = datagram.mData;
+			sIOVecs[i].iov_len = datagram.mSize;
+			sAddrs[i].sin_family = AF_INET;
+			sAddrs[i].sin_addr.s_addr = datagram.mAddress;
+			sAddrs[i].sin_port = htons(datagram.mPort);
+
+			struct msghdr& msg = sMsgs[i].msg_hdr;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_name = &sAddrs[i];
+			msg.msg_namelen = sizeof(sAddrs[i]);
+			msg.msg_iov = &sIOVecs[i];
+			msg.msg_iovlen = 1;
+		}
+
+		++sNetCallCount;
+		int ret = sendmmsg(hSocket, sMsgs, batch, 0);
+		if (ret > 0)
+		{
+			// Stops at the first datagram that fails, which the next round gets to.
+			sent += ret;
+			next += ret;
+		}
+		else if (ret == 0)
+		{
+			// Nothing sent, but no error either, so errno is stale: send the
+			// first datagram on its own, which fails or gets us going again.
+			const LLNetDatagram& datagram = datagrams[next++];
+			if (send_packet(hSocket, datagram.mData, datagram.mSize, datagram.mAddress, datagram.mPort))
+			{
+				++sent;
+			}
+		}
+		else if (errno == ENOSYS)
+		{
+			llinfos << "sendmmsg() not available, sending one packet at a time" << llendl;
+			sNoSendMMsg = true;
+		}
+		else
+		{
+			// Let send_packet() retry or report the failing datagram like any other send.
+			const LLNetDatagram& datagram = datagrams[next++];
+			if (send_packet(hSocket, datagram.mData, datagram.mSize, datagram.mAddress, datagram.mPort))
+			{
+				++sent;
+			}
+		}
+	}
+#endif
+
+	for (; next < count; ++next)
+	{
+		const LLNetDatagram& datagram = datagrams[next];
+		if (send_packet(hSocket, datagram.mData, datagram.mSize, datagram.mAddress, datagram.mPort))
+		{
+			++sent;
+		}
+	}
+	return sent;
+}
+
+U32 get_net_call_count()
+{
+	return sNetCallCount;
+}
+
 //EOF
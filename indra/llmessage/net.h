@@ -45,6 +45,32 @@ S32		receive_packet(int hSocket, char * receiveBuffer);
 
 BOOL	send_packet(int hSocket, const char *sendBuffer, int size, U32 recipient, int nPort);	// Returns TRUE on success.
 
+// A datagram of receive_packets() and send_packets(). Addresses are in network
+// byte order and ports in host byte order, like LLHost.
+struct LLNetDatagram
+{
+	char*	mData;				// room for NET_BUFFER_SIZE bytes when receiving
+	S32		mSize;
+	U32		mAddress;			// sender when receiving, recipient when sending
+	U32		mPort;
+	U32		mReceivingIFAddr;	// only set when receiving
+};
+
+// Most datagrams a single receive_packets() or send_packets() system call handles.
+const S32 NET_MAX_BATCH = 32;
+
+// Receives up to count datagrams (at most NET_MAX_BATCH) with one recvmmsg().
+// Returns how many were received, or -1 when the platform or kernel can't
+// receive in batches and receive_packet() has to be used instead.
+S32		receive_packets(int hSocket, LLNetDatagram* datagrams, S32 count);
+
+// Sends the datagrams with as few sendmmsg() calls as possible, or one
+// send_packet() each where that isn't available. Returns how many were sent.
+S32		send_packets(int hSocket, const LLNetDatagram* datagrams, S32 count);
+
+// How many socket system calls the functions above made so far, for benchmarks.
+U32		get_net_call_count();
+
 //void	get_sender(char * tmp);
 LLHost	get_sender();
 U32		get_sender_port();
@@ -0,0 +1,336 @@
+/**
+ * @file aicurlperhost_test.cpp
+ * @brief Tests for the adaptive per-host concurrency limit (PerHostConcurrency)
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <set>
+#include <vector>
+
+#include "../aicurlperhost.h"
+#include "../aicurlthread.h"
+
+#include "../test/lltut.h"
+
+#undef AICurlPrivate
+
+using AICurlPrivate::PerHostConcurrency;
+using AICurlPrivate::PerHostRequestQueue;
+using AICurlPrivate::PerHostRequestQueuePtr;
+using AICurlPrivate::PerHostRequestQueue_wat;
+
+namespace
+{
+	// A server with a number of workers that each take a fixed time per request,
+	// behind a connection with a fixed round trip time. Requests that arrive while
+	// all workers are busy wait: that is the latency that PerHostConcurrency must detect.
+	class SimulatedServer
+	{
+	public:
+		SimulatedServer(S32 workers, F64 service_time, F64 round_trip_time) :
+			mFree(workers, 0.0), mServiceTime(service_time), mRoundTripTime(round_trip_time), mNow(0)
+		{
+		}
+
+		// Send a request now.
+		void send()
+		{
+			F64 arrival = mNow + mRoundTripTime / 2;
+			std::vector<F64>::iterator worker = std::min_element(mFree.begin(), mFree.end());
+			F64 start = llmax(arrival, *worker);
+			*worker = start + mServiceTime;
+			mInFlight.insert(std::make_pair(*worker + mRoundTripTime / 2, mNow));
+		}
+
+		// Advance the time to the next reply and return its latency.
+		F64 receive()
+		{
+			std::multiset<std::pair<F64, F64> >::iterator first = mInFlight.begin();
+			mNow = first->first;
+			F64 latency = first->first - first->second;
+			mInFlight.erase(first);
+			return latency;
+		}
+
+		S32 inFlight() const { return (S32)mInFlight.size(); }
+		F64 now() const { return mNow; }
+
+	private:
+		std::vector<F64> mFree;							// Time at which each worker is free again.
+		F64 mServiceTime;
+		F64 mRoundTripTime;
+		F64 mNow;
+		std::multiset<std::pair<F64, F64> > mInFlight;	// Time of the reply, time sent.
+	};
+
+	PerHostConcurrency::Sample make_sample(F64 latency, bool success = true)
+	{
+		PerHostConcurrency::Sample sample;
+		sample.mSuccess = success;
+		sample.mLatency = latency;
+		sample.mTotalTime = latency;
+		sample.mSizeDownload = 1000;
+		sample.mReusedConnection = true;
+		return sample;
+	}
+
+	// Run requests against server, limited by concurrency, and return the number of requests per second.
+	F64 run(SimulatedServer& server, PerHostConcurrency& concurrency, S32 max_limit, S32 requests, F64* average_latency)
+	{
+		F64 total_latency = 0;
+		F64 start = server.now();
+		for (S32 done = 0; done < requests; ++done)
+		{
+			while (server.inFlight() < concurrency.limit(max_limit))
+			{
+				server.send();
+			}
+			S32 in_flight = server.inFlight();
+			F64 latency = server.receive();
+			total_latency += latency;
+			concurrency.completed(make_sample(latency), in_flight);
+		}
+		*average_latency = total_latency / requests;
+		return requests / (server.now() - start);
+	}
+
+	// Stand-in for curlthread::MultiHandle, for a single host. The requests are never
+	// performed; only the bookkeeping of add_easy_request and remove_easy_request is copied.
+	class TestMultiHandle
+	{
+	public:
+		TestMultiHandle(PerHostRequestQueuePtr const& per_host, S32 max_total) :
+			mPerHost(per_host), mMaxTotal(max_total), mAdded(0)
+		{
+		}
+
+		void add_easy_request(AICurlEasyRequest const& easy_request)
+		{
+			PerHostRequestQueue_wat per_host_w(*mPerHost);
+			if (mAdded < mMaxTotal && !per_host_w->throttled())
+			{
+				per_host_w->added_to_multi_handle();
+				++mAdded;
+				return;
+			}
+			per_host_w->queue(easy_request, 0);
+		}
+
+		// A request finished with the given latency.
+		void remove_easy_request(F64 latency)
+		{
+			PerHostRequestQueue_wat per_host_w(*mPerHost);
+			per_host_w->completed(make_sample(latency));
+			per_host_w->removed_from_multi_handle();
+			--mAdded;
+			per_host_w->add_queued_to(this);
+		}
+
+		S32 getAdded() const { return mAdded; }
+
+	private:
+		PerHostRequestQueuePtr mPerHost;
+		S32 mMaxTotal;
+		S32 mAdded;
+	};
+}
+
+namespace tut
+{
+	struct aicurlperhost_data
+	{
+	};
+	typedef test_group<aicurlperhost_data> aicurlperhost_test;
+	typedef aicurlperhost_test::object aicurlperhost_object;
+	tut::aicurlperhost_test aicurlperhost_testcase("AICurlPerHost");
+
+	template<> template<>
+	void aicurlperhost_object::test<1>()
+	{
+		set_test_name("Limit grows to the maximum while the latency is constant");
+		PerHostConcurrency concurrency;
+		ensure_equals("initial limit", concurrency.limit(16), 2);
+		S32 in_flight = concurrency.limit(16);
+		for (S32 i = 0; i < 1000; ++i)
+		{
+			concurrency.completed(make_sample(0.1), in_flight);
+			in_flight = concurrency.limit(16);
+		}
+		ensure_equals("limit", concurrency.limit(16), 16);
+		ensure_equals("limit is clamped", concurrency.limit(4), 4);
+		ensure_equals("no decreases", concurrency.getDecreases(), 0U);
+	}
+
+	template<> template<>
+	void aicurlperhost_object::test<2>()
+	{
+		set_test_name("Limit does not grow when it is not used");
+		PerHostConcurrency concurrency;
+		for (S32 i = 0; i < 1000; ++i)
+		{
+			concurrency.completed(make_sample(0.1), 1);
+		}
+		ensure_equals("limit", concurrency.limit(16), 2);
+	}
+
+	template<> template<>
+	void aicurlperhost_object::test<3>()
+	{
+		set_test_name("Failures decrease the limit once per round trip");
+		PerHostConcurrency concurrency;
+		S32 in_flight = 2;
+		for (S32 i = 0; i < 100; ++i)
+		{
+			concurrency.completed(make_sample(0.1), in_flight);
+			in_flight = concurrency.limit(64);
+		}
+		S32 before = concurrency.limit(64);
+		ensure("grown", before > 16);
+		// All requests in flight fail; that is one event.
+		for (S32 i = 0; i < before; ++i)
+		{
+			concurrency.completed(make_sample(0, false), before - i);
+		}
+		ensure_equals("one decrease", concurrency.getDecreases(), 1U);
+		ensure_equals("failed", concurrency.getFailed(), (U32)before);
+		ensure("decreased", concurrency.limit(64) < before);
+		// Next failure, after the recovery period, decreases again.
+		concurrency.completed(make_sample(0, false), 1);
+		ensure_equals("two decreases", concurrency.getDecreases(), 2U);
+		for (S32 i = 0; i < 100; ++i)
+		{
+			concurrency.completed(make_sample(0, false), 1);
+		}
+		ensure_equals("never below one", concurrency.limit(64), 1);
+	}
+
+	template<> template<>
+	void aicurlperhost_object::test<4>()
+	{
+		set_test_name("Limit converges on a server that queues requests");
+		// 8 workers, 20 ms per request, 50 ms round trip: at most 400 requests/s,
+		// which needs 8 * (20 + 50) / 20 = 28 requests in flight.
+		SimulatedServer server(8, 0.02, 0.05);
+		PerHostConcurrency concurrency;
+		F64 latency;
+		run(server, concurrency, 256, 2000, &latency);		// Converge.
+		F64 rate = run(server, concurrency, 256, 10000, &latency);
+		ensure("throughput " + llformat("%.1f", rate), rate > 0.9 * 400);
+		ensure("latency " + llformat("%.3f", latency), latency < 3 * 0.07);
+		ensure("limit " + llformat("%d", concurrency.limit(256)), concurrency.limit(256) < 128);
+		ensure("decreases", concurrency.getDecreases() > 0);
+
+		// A fixed limit of 256 would saturate the server too, but with a much higher latency.
+		SimulatedServer fixed_server(8, 0.02, 0.05);
+		F64 fixed_latency = 0;
+		for (S32 i = 0; i < 256; ++i)
+		{
+			fixed_server.send();
+		}
+		for (S32 i = 0; i < 10000; ++i)
+		{
+			fixed_latency += fixed_server.receive();
+			fixed_server.send();
+		}
+		fixed_latency /= 10000;
+		ensure("lower latency than fixed limit", latency * 2 < fixed_latency);
+	}
+
+	template<> template<>
+	void aicurlperhost_object::test<5>()
+	{
+		set_test_name("Base latency follows the server");
+		SimulatedServer fast(4, 0.01, 0.02);
+		PerHostConcurrency concurrency;
+		F64 latency;
+		F64 fast_rate = run(fast, concurrency, 64, 5000, &latency);
+		// The same host becomes slower (for example a different CDN node): the limit must not collapse to one.
+		SimulatedServer slow(4, 0.01, 0.2);
+		F64 slow_rate = run(slow, concurrency, 64, 5000, &latency);
+		slow_rate = run(slow, concurrency, 64, 5000, &latency);
+		ensure("fast throughput " + llformat("%.1f", fast_rate), fast_rate > 0.9 * 400);
+		ensure("slow throughput " + llformat("%.1f", slow_rate), slow_rate > 0.7 * 400);
+		ensure("base latency " + llformat("%.3f", concurrency.getBaseLatency()), concurrency.getBaseLatency() > 0.2);
+	}
+
+	template<> template<>
+	void aicurlperhost_object::test<6>()
+	{
+		set_test_name("Statistics");
+		PerHostConcurrency concurrency;
+		PerHostConcurrency::Sample sample = make_sample(0.5);
+		concurrency.completed(sample, 1);
+		sample.mReusedConnection = false;
+		concurrency.completed(sample, 1);
+		ensure_equals("completed", concurrency.getCompleted(), 2U);
+		ensure_equals("reused", concurrency.getReusedConnections(), 1U);
+		ensure_distance("bytes per second", concurrency.getBytesPerSecond(), 2000.0, 0.001);
+		ensure_distance("latency", concurrency.getAverageLatency(), 0.5, 0.001);
+		ensure_distance("base latency", concurrency.getBaseLatency(), 0.5, 0.001);
+	}
+
+	template<> template<>
+	void aicurlperhost_object::test<7>()
+	{
+		set_test_name("Queued requests fill the window after it grew");
+		AICurlPrivate::curl_concurrent_connections_per_host = 16;
+		AICurlPrivate::curl_adaptive_concurrency_per_host = true;
+		PerHostRequestQueuePtr per_host = PerHostRequestQueue::instance("aicurlperhost.test");
+		TestMultiHandle multi_handle(per_host, 12);
+		for (S32 i = 0; i < 100; ++i)
+		{
+			multi_handle.add_easy_request(AICurlEasyRequest(AICurlPrivate::BufferedCurlEasyRequestPtr()));
+		}
+		ensure_equals("initial window", multi_handle.getAdded(), 2);
+
+		// Slow start: every completion makes room for two queued requests.
+		multi_handle.remove_easy_request(0.1);
+		ensure_equals("window grew by one", multi_handle.getAdded(), 3);
+		multi_handle.remove_easy_request(0.1);
+		multi_handle.remove_easy_request(0.1);
+		ensure_equals("backlog drains faster than one per completion", multi_handle.getAdded(), 5);
+
+		// Until the total number of connections is the limit; the rest stays queued.
+		for (S32 i = 0; i < 20; ++i)
+		{
+			multi_handle.remove_easy_request(0.1);
+		}
+		ensure_equals("limited by the total", multi_handle.getAdded(), 12);
+		ensure("host window is larger than the total", !PerHostRequestQueue_wat(*per_host)->throttled());
+
+		PerHostRequestQueue::purge();
+		while (multi_handle.getAdded())
+		{
+			multi_handle.remove_easy_request(0.1);
+		}
+		PerHostRequestQueue::release(per_host);
+	}
+}
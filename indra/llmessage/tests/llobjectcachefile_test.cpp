@@ -0,0 +1,195 @@
+/**
+ * @file llobjectcachefile_test.cpp
+ * @brief Tests of the on disk format of the object cache
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "../llobjectcachefile.h"
+#include "llfile.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 NUM_ENTRIES = 50;
+
+	std::vector<U8> make_data(U32 seed)
+	{
+		std::vector<U8> data(1 + seed * 37 % 900);
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			seed = seed * 1103515245 + 12345;
+			data[i] = (U8)(seed >> 16);
+		}
+		return data;
+	}
+
+	void fill(LLObjectCacheFile& file, const LLUUID& region_id)
+	{
+		file.clear(region_id);
+		for (S32 i = 0; i < NUM_ENTRIES; ++i)
+		{
+			std::vector<U8> data = make_data(i + 1);
+			LLObjectCacheFile::Entry entry;
+			entry.mLocalID = 1000 + i;
+			entry.mCRC = 7 * i;
+			entry.mHitCount = i;
+			entry.mDupeCount = 2 * i;
+			entry.mCRCChangeCount = 3 * i;
+			entry.mSize = (S32)data.size();
+			entry.mData = &data[0];
+			tut::ensure("added", file.addEntry(entry));
+		}
+	}
+
+	std::string temp_filename()
+	{
+		return std::string(LLFile::tmpdir()) + "llobjectcachefile_test.slc";
+	}
+
+	std::vector<U8> read_bytes(const std::string& filename)
+	{
+		std::vector<U8> bytes;
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (fp)
+		{
+			U8 buffer[4096];
+			size_t count;
+			while ((count = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+			{
+				bytes.insert(bytes.end(), buffer, buffer + count);
+			}
+			LLFile::close(fp);
+		}
+		return bytes;
+	}
+}
+
+namespace tut
+{
+	struct objectcachefile_data
+	{
+		~objectcachefile_data()
+		{
+			LLFile::remove(temp_filename());
+		}
+	};
+	typedef test_group<objectcachefile_data> objectcachefile_test;
+	typedef objectcachefile_test::object objectcachefile_object;
+	tut::objectcachefile_test objectcachefile("LLObjectCacheFile");
+
+	// Write, read back and walk the entries.
+	template<> template<>
+	void objectcachefile_object::test<1>()
+	{
+		LLUUID region_id;
+		region_id.generate();
+		LLObjectCacheFile file;
+		fill(file, region_id);
+		S32 size = file.write(temp_filename());
+		ensure("written", size > 0);
+
+		LLObjectCacheFile loaded;
+		ensure("read", loaded.read(temp_filename()));
+		ensure_equals("size", loaded.getSize(), size);
+		ensure_equals("region", loaded.getRegionID(), region_id);
+		ensure_equals("count", loaded.getEntryCount(), NUM_ENTRIES);
+
+		S32 offset = 0;
+		LLObjectCacheFile::Entry entry;
+		for (S32 i = 0; i < NUM_ENTRIES; ++i)
+		{
+			ensure("next", loaded.nextEntry(offset, entry));
+			std::vector<U8> data = make_data(i + 1);
+			ensure_equals("local id", entry.mLocalID, (U32)(1000 + i));
+			ensure_equals("crc", entry.mCRC, (U32)(7 * i));
+			ensure_equals("hits", entry.mHitCount, i);
+			ensure_equals("dupes", entry.mDupeCount, 2 * i);
+			ensure_equals("changes", entry.mCRCChangeCount, 3 * i);
+			ensure_equals("data size", entry.mSize, (S32)data.size());
+			ensure("data", !memcmp(entry.mData, &data[0], data.size()));
+		}
+		ensure("end", !loaded.nextEntry(offset, entry));
+	}
+
+	// Any damage makes the whole file invalid.
+	template<> template<>
+	void objectcachefile_object::test<2>()
+	{
+		LLUUID region_id;
+		region_id.generate();
+		LLObjectCacheFile file;
+		fill(file, region_id);
+		ensure("written", file.write(temp_filename()) > 0);
+		const std::vector<U8> good = read_bytes(temp_filename());
+
+		LLObjectCacheFile loaded;
+		std::vector<U8> image = good;
+		ensure("intact", loaded.assign(image));
+
+		image = good;
+		image[good.size() / 2] ^= 0x10;
+		ensure("flipped bit", !loaded.assign(image));
+		ensure_equals("no entries", loaded.getEntryCount(), 0);
+
+		image = good;
+		image.resize(good.size() - 1);
+		ensure("truncated", !loaded.assign(image));
+
+		image = good;
+		image.resize(LLObjectCacheFile::HEADER_SIZE - 1);
+		ensure("no header", !loaded.assign(image));
+
+		image = good;
+		image[4] ^= 0xff;
+		ensure("format version", !loaded.assign(image));
+
+		LLFile::remove(temp_filename());
+		ensure("missing", !loaded.read(temp_filename()));
+	}
+
+	// Entries that can't be valid aren't written.
+	template<> template<>
+	void objectcachefile_object::test<3>()
+	{
+		LLObjectCacheFile file;
+		file.clear(LLUUID::null);
+		std::vector<U8> data(LLObjectCacheFile::MAX_ENTRY_SIZE + 1);
+		LLObjectCacheFile::Entry entry;
+		entry.mLocalID = 1;
+		entry.mCRC = 0;
+		entry.mHitCount = entry.mDupeCount = entry.mCRCChangeCount = 0;
+		entry.mData = &data[0];
+		entry.mSize = 0;
+		ensure("empty", !file.addEntry(entry));
+		entry.mSize = (S32)data.size();
+		ensure("too big", !file.addEntry(entry));
+		entry.mSize = LLObjectCacheFile::MAX_ENTRY_SIZE;
+		ensure("biggest", file.addEntry(entry));
+		ensure_equals("count", file.getEntryCount(), 1);
+	}
+}
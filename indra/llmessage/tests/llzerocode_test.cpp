@@ -0,0 +1,175 @@
+/**
+ * @file llzerocode_test.cpp
+ * @brief Tests of the zero coding of message packets
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "../llzerocode.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Object update like data: runs of zeroes of every length between random bytes.
+	std::vector<U8> make_data(U32 seed, S32 size)
+	{
+		std::vector<U8> data;
+		while ((S32)data.size() < size)
+		{
+			seed = seed * 1103515245 + 12345;
+			S32 length = (seed >> 16) % 40;
+			U8 value = 0;
+			if ((seed >> 8) & 1)
+			{
+				value = (U8)(seed >> 24) | 1;
+			}
+			else if (((seed >> 9) & 7) == 0)
+			{
+				length *= 20;	// some runs of more than 255 zeroes
+			}
+			for (S32 i = 0; i < length && (S32)data.size() < size; ++i)
+			{
+				data.push_back(value ? (U8)(value + i) | 1 : 0);
+			}
+		}
+		return data;
+	}
+
+	// What LLMessageSystem::zeroCodeExpand() did a byte at a time.
+	S32 expand_bytes(const U8* in, S32 count, U8* out)
+	{
+		U8* outptr = out;
+		while (count--)
+		{
+			if (!((*outptr++ = *in++)))
+			{
+				while ((count--) && (!(*in)))
+				{
+					*outptr++ = *in++;
+					memset(outptr, 0, 255);
+					outptr += 255;
+				}
+				if (count < 0)
+				{
+					break;
+				}
+				memset(outptr, 0, (*in) - 1);
+				outptr += (*in) - 1;
+				in++;
+			}
+		}
+		return (S32)(outptr - out);
+	}
+
+	void check_round_trip(const std::vector<U8>& data, const char* what)
+	{
+		std::vector<U8> encoded(2 * data.size() + 2);
+		S32 encoded_size = zero_code_encode(data.empty() ? NULL : &data[0], data.size(), &encoded[0]);
+		tut::ensure_equals(what, zero_code_net_gain(data.empty() ? NULL : &data[0], data.size()),
+						   encoded_size - (S32)data.size());
+
+		std::vector<U8> expanded(data.size() + 1);
+		S32 expanded_size = zero_code_expand(&encoded[0], encoded_size, &expanded[0], expanded.size());
+		tut::ensure_equals(what, expanded_size, (S32)data.size());
+		tut::ensure(what, std::equal(data.begin(), data.end(), expanded.begin()));
+
+		std::vector<U8> reference(data.size() + 512);
+		tut::ensure_equals(what, expand_bytes(&encoded[0], encoded_size, &reference[0]), expanded_size);
+		tut::ensure(what, std::equal(data.begin(), data.end(), reference.begin()));
+	}
+}
+
+namespace tut
+{
+	struct zerocode_data
+	{
+		~zerocode_data()
+		{
+			zero_code_set_vectorized(true);
+		}
+	};
+	typedef test_group<zerocode_data> zerocode_test;
+	typedef zerocode_test::object zerocode_object;
+	tut::zerocode_test zerocode("LLZeroCode");
+
+	// Round trips, with and without SSE2.
+	template<> template<>
+	void zerocode_object::test<1>()
+	{
+		for (S32 vectorized = 0; vectorized < 2; ++vectorized)
+		{
+			zero_code_set_vectorized(vectorized != 0);
+			check_round_trip(std::vector<U8>(), "empty");
+			check_round_trip(std::vector<U8>(1, 0), "one zero");
+			check_round_trip(std::vector<U8>(255, 0), "255 zeroes");
+			check_round_trip(std::vector<U8>(256, 0), "256 zeroes");
+			check_round_trip(std::vector<U8>(1000, 0), "1000 zeroes");
+			check_round_trip(std::vector<U8>(37, 0xff), "no zeroes");
+			for (U32 seed = 1; seed < 200; ++seed)
+			{
+				check_round_trip(make_data(seed, seed * 7), "random");
+			}
+		}
+	}
+
+	// The encoding of the old byte loops.
+	template<> template<>
+	void zerocode_object::test<2>()
+	{
+		const U8 data[] = { 1, 0, 0, 0, 2 };
+		U8 encoded[10];
+		ensure_equals("size", zero_code_encode(data, sizeof(data), encoded), 4);
+		ensure("encoded", encoded[0] == 1 && encoded[1] == 0 && encoded[2] == 3 && encoded[3] == 2);
+		ensure_equals("net gain", zero_code_net_gain(data, sizeof(data)), -1);
+		ensure_equals("one zero costs one", zero_code_net_gain(data, 2), 1);
+	}
+
+	// Wrapped runs, a zero at the end without a count, and running out of room.
+	template<> template<>
+	void zerocode_object::test<3>()
+	{
+		for (S32 vectorized = 0; vectorized < 2; ++vectorized)
+		{
+			zero_code_set_vectorized(vectorized != 0);
+			U8 out[1024];
+			const U8 wrapped[] = { 7, 0, 0, 0, 3, 7 };
+			ensure_equals("wrapped", zero_code_expand(wrapped, sizeof(wrapped), out, sizeof(out)), 1 + 512 + 3 + 1);
+			ensure_equals("wrapped reference", expand_bytes(wrapped, sizeof(wrapped), out), 1 + 512 + 3 + 1);
+
+			const U8 trailing[] = { 7, 0 };
+			ensure_equals("trailing zero", zero_code_expand(trailing, sizeof(trailing), out, sizeof(out)), 2);
+			ensure_equals("trailing zero", (S32)out[1], 0);
+
+			std::vector<U8> data = make_data(42, 900);
+			std::vector<U8> encoded(2 * data.size());
+			S32 encoded_size = zero_code_encode(&data[0], data.size(), &encoded[0]);
+			ensure_equals("fits", zero_code_expand(&encoded[0], encoded_size, out, data.size()), (S32)data.size());
+			ensure_equals("too small", zero_code_expand(&encoded[0], encoded_size, out, data.size() - 1), -1);
+		}
+	}
+}
@@ -0,0 +1,205 @@
+/**
+ * @file net_test.cpp
+ * @brief Tests of the batched datagram sends and receives
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../net.h"
+#include "lltimer.h"
+
+#include "../test/lltut.h"
+
+namespace
+{
+	// Too big for UDP: sending a datagram this size fails with EMSGSIZE.
+	const S32 OVERSIZED = 70000;
+
+	// Datagram i of a test: its size and every byte depend on i.
+	S32 datagram_size(S32 i)
+	{
+		return 1 + i * 97 % 1400;
+	}
+
+	char datagram_byte(S32 i, S32 offset)
+	{
+		return (char)(i * 31 + offset);
+	}
+
+	// A socket on an OS assigned port, and datagrams for it to send itself.
+	struct Loopback
+	{
+		Loopback() : mSocket(-1), mPort(NET_USE_OS_ASSIGNED_PORT)
+		{
+			mOK = start_net(mSocket, mPort) == 0;
+		}
+
+		~Loopback()
+		{
+			if (mOK)
+			{
+				end_net(mSocket);
+			}
+		}
+
+		// Builds count datagrams to ourselves; the ones in bad are oversized.
+		void make(S32 count, const std::vector<S32>& bad)
+		{
+			mBuffers.assign(count, std::vector<char>());
+			mDatagrams.assign(count, LLNetDatagram());
+			for (S32 i = 0; i < count; ++i)
+			{
+				bool oversized = std::find(bad.begin(), bad.end(), i) != bad.end();
+				S32 size = oversized ? OVERSIZED : datagram_size(i);
+				mBuffers[i].resize(size);
+				for (S32 j = 0; j < size; ++j)
+				{
+					mBuffers[i][j] = datagram_byte(i, j);
+				}
+				LLNetDatagram& datagram = mDatagrams[i];
+				datagram.mData = &mBuffers[i][0];
+				datagram.mSize = size;
+				datagram.mAddress = ip_string_to_u32(LOOPBACK_ADDRESS_STRING);
+				datagram.mPort = mPort;
+			}
+		}
+
+		// Receives until count datagrams arrived or nothing came for a while,
+		// with receive_packets() or, where that isn't available, receive_packet().
+		std::vector<std::string> receive(S32 count)
+		{
+			std::vector<std::string> received;
+			std::vector<std::vector<char> > buffers(NET_MAX_BATCH, std::vector<char>(NET_BUFFER_SIZE));
+			LLNetDatagram datagrams[NET_MAX_BATCH];
+			for (S32 i = 0; i < NET_MAX_BATCH; ++i)
+			{
+				datagrams[i].mData = &buffers[i][0];
+			}
+			LLTimer timer;
+			while ((S32)received.size() < count && timer.getElapsedTimeF32() < 2.f)
+			{
+				S32 got = receive_packets(mSocket, datagrams, NET_MAX_BATCH);
+				if (got < 0)
+				{
+					got = receive_packet(mSocket, datagrams[0].mData);
+					if (got > 0)
+					{
+						received.push_back(std::string(datagrams[0].mData, got));
+						timer.reset();
+					}
+				}
+				else
+				{
+					for (S32 i = 0; i < got; ++i)
+					{
+						tut::ensure_equals("sender address", datagrams[i].mAddress, ip_string_to_u32(LOOPBACK_ADDRESS_STRING));
+						tut::ensure_equals("sender port", (S32)datagrams[i].mPort, mPort);
+						received.push_back(std::string(datagrams[i].mData, datagrams[i].mSize));
+					}
+					if (got)
+					{
+						timer.reset();
+					}
+				}
+				if (got <= 0)
+				{
+					ms_sleep(1);
+				}
+			}
+			return received;
+		}
+
+		// Checks that the datagrams that aren't in bad arrived, in order.
+		void check(const std::vector<std::string>& received, const std::vector<S32>& bad)
+		{
+			size_t next = 0;
+			for (S32 i = 0; i < (S32)mDatagrams.size(); ++i)
+			{
+				if (std::find(bad.begin(), bad.end(), i) != bad.end())
+				{
+					continue;
+				}
+				tut::ensure("datagram received", next < received.size());
+				tut::ensure("datagram intact", received[next++] == std::string(mDatagrams[i].mData, mDatagrams[i].mSize));
+			}
+			tut::ensure_equals("nothing else received", received.size(), next);
+		}
+
+		S32 mSocket;
+		int mPort;
+		bool mOK;
+		std::vector<std::vector<char> > mBuffers;
+		std::vector<LLNetDatagram> mDatagrams;
+	};
+}
+
+namespace tut
+{
+	struct net_data
+	{
+	};
+	typedef test_group<net_data> net_test;
+	typedef net_test::object net_object;
+	tut::net_test net("net");
+
+	// More datagrams than fit in one batch all arrive, in order, and with
+	// fewer system calls than datagrams where batching is available.
+	template<> template<>
+	void net_object::test<1>()
+	{
+		Loopback loopback;
+		ensure("start_net", loopback.mOK);
+		const S32 COUNT = NET_MAX_BATCH + NET_MAX_BATCH / 2;
+		std::vector<S32> bad;
+		loopback.make(COUNT, bad);
+		U32 calls = get_net_call_count();
+		ensure_equals("all sent", send_packets(loopback.mSocket, &loopback.mDatagrams[0], COUNT), COUNT);
+		ensure("sent with at most one call per datagram", get_net_call_count() - calls <= (U32)COUNT);
+		loopback.check(loopback.receive(COUNT), bad);
+	}
+
+	// A datagram that can't be sent doesn't stop the ones before or after it,
+	// also when it is the first of a batch, and isn't counted as sent.
+	template<> template<>
+	void net_object::test<2>()
+	{
+		Loopback loopback;
+		ensure("start_net", loopback.mOK);
+		const S32 COUNT = NET_MAX_BATCH + 8;
+		std::vector<S32> bad;
+		bad.push_back(0);
+		bad.push_back(5);
+		bad.push_back(6);
+		bad.push_back(NET_MAX_BATCH + 7);
+		loopback.make(COUNT, bad);
+		ensure_equals("failed datagrams not counted", send_packets(loopback.mSocket, &loopback.mDatagrams[0], COUNT),
+					  COUNT - (S32)bad.size());
+		loopback.check(loopback.receive(COUNT - bad.size()), bad);
+	}
+}
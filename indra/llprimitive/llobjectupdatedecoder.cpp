@@ -0,0 +1,276 @@
+/**
+ * @file llobjectupdatedecoder.cpp
+ * @brief Decodes the blocks of object update messages on worker threads
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llobjectupdatedecoder.h"
+
+#include "lldatapacker.h"
+#include "llpartdata.h"
+#include "llvolumemessage.h"
+#include "llworkerpool.h"
+#include "message.h"
+#include "v3math.h"
+
+LLDecodedObjectUpdate::LLDecodedObjectUpdate()
+:	mPCode(0),
+	mHasTEs(false),
+	mHasVolumeParams(false),
+	mVolumeOffset(-1),
+	mEndOffset(-1)
+{
+	mTEs.face_count = 0;
+}
+
+void LLDecodedObjectUpdate::decode(bool compressed)
+{
+	mHasTEs = false;
+	mHasVolumeParams = false;
+	mVolumeOffset = -1;
+	mEndOffset = -1;
+
+	if (compressed)
+	{
+		decodeCompressed();
+	}
+	else
+	{
+		decodeTEs(mData.empty() ? NULL : &mData[0], (S32)mData.size());
+	}
+}
+
+// Reads past everything LLViewerObject::processUpdateMessage() unpacks of an
+// OUT_FULL_COMPRESSED update, in the same order, to get to the volume.
+void LLDecodedObjectUpdate::decodeCompressed()
+{
+	if (mData.empty())
+	{
+		return;
+	}
+	LLDataPackerBinaryBuffer dp(&mData[0], (S32)mData.size());
+	// No binary field of the data is bigger than the data.
+	mScratch.resize(mData.size());
+	S32 size;
+
+	U32 local_id;
+	dp.unpackUUID(mID, "ID");
+	dp.unpackU32(local_id, "LocalID");
+	dp.unpackU8(mPCode, "PCode");
+	if (mPCode != LL_PCODE_VOLUME)
+	{
+		return;
+	}
+
+	U8 state, material, click_action;
+	U32 crc;
+	LLVector3 vec;
+	LLUUID owner_id;
+	dp.unpackU8(state, "State");
+	dp.unpackU32(crc, "CRC");
+	dp.unpackU8(material, "Material");
+	dp.unpackU8(click_action, "ClickAction");
+	dp.unpackVector3(vec, "Scale");
+	dp.unpackVector3(vec, "Pos");
+	dp.unpackVector3(vec, "Rot");
+
+	U32 value;
+	dp.unpackU32(value, "SpecialCode");
+	dp.unpackUUID(owner_id, "Owner");
+
+	if (value & 0x80)
+	{
+		dp.unpackVector3(vec, "Omega");
+	}
+	if (value & 0x20)
+	{
+		U32 parent_id;
+		dp.unpackU32(parent_id, "ParentID");
+	}
+	if (value & 0x2)
+	{
+		U8 tree_data;
+		dp.unpackU8(tree_data, "TreeData");
+	}
+	else if (value & 0x1)
+	{
+		U32 scratch_pad_size;
+		dp.unpackU32(scratch_pad_size, "ScratchPadSize");
+		dp.unpackBinaryData(&mScratch[0], size, "PartData");
+	}
+
+	std::string text;
+	if (value & 0x4)
+	{
+		U8 color[4];
+		dp.unpackString(text, "Text");
+		dp.unpackBinaryDataFixed(color, 4, "Color");
+	}
+	if (value & 0x200)
+	{
+		dp.unpackString(text, "MediaURL");
+	}
+	if (value & 0x8)
+	{
+		LLPartSysData part_sys_data;
+		part_sys_data.unpack(dp);
+	}
+
+	U8 num_parameters;
+	dp.unpackU8(num_parameters, "num_params");
+	for (U8 param = 0; param < num_parameters; ++param)
+	{
+		U16 param_type;
+		dp.unpackU16(param_type, "param_type");
+		dp.unpackBinaryData(&mScratch[0], size, "param_data");
+	}
+
+	if (value & 0x10)
+	{
+		LLUUID sound_uuid;
+		F32 gain, cutoff;
+		U8 sound_flags;
+		dp.unpackUUID(sound_uuid, "SoundUUID");
+		dp.unpackF32(gain, "SoundGain");
+		dp.unpackU8(sound_flags, "SoundFlags");
+		dp.unpackF32(cutoff, "SoundRadius");
+	}
+	if (value & 0x100)
+	{
+		dp.unpackString(text, "NV");
+	}
+
+	// LLVOVolume::processUpdateMessage()
+	mVolumeOffset = dp.getCurrentSize();
+	if (!LLVolumeMessage::unpackVolumeParams(&mVolumeParams, dp))
+	{
+		mVolumeOffset = -1;
+		return;
+	}
+	mHasVolumeParams = true;
+
+	if (dp.unpackBinaryData(&mScratch[0], size, "TextureEntry"))
+	{
+		decodeTEs(&mScratch[0], size);
+		mEndOffset = dp.getCurrentSize();
+	}
+}
+
+void LLDecodedObjectUpdate::decodeTEs(U8* packed_buffer, S32 size)
+{
+	if (size > 0)
+	{
+		LLPrimitive::parseTEMessage(packed_buffer, size, LLTEContents::MAX_TES, mTEs);
+	}
+	else
+	{
+		// An empty field changes nothing.
+		mTEs.face_count = 0;
+	}
+	mHasTEs = true;
+}
+
+//============================================================================
+
+// The blocks of one message, for LLWorkerPool::parallelFor().
+class LLObjectUpdateDecodeJobs
+{
+public:
+	LLObjectUpdateDecodeJobs(LLDecodedObjectUpdate* blocks, bool compressed)
+	:	mBlocks(blocks), mCompressed(compressed)
+	{
+	}
+
+	static void decodeBlock(void* data, S32 index)
+	{
+		LLObjectUpdateDecodeJobs* jobs = (LLObjectUpdateDecodeJobs*)data;
+		jobs->mBlocks[index].decode(jobs->mCompressed);
+	}
+
+private:
+	LLDecodedObjectUpdate* mBlocks;
+	bool mCompressed;
+};
+
+LLObjectUpdateDecoder::LLObjectUpdateDecoder()
+:	mCount(0),
+	mUseWorkerPool(true)
+{
+}
+
+void LLObjectUpdateDecoder::decode(LLMessageSystem* msg, bool compressed)
+{
+	mCount = msg->getNumberOfBlocksFast(_PREHASH_ObjectData);
+	if (mCount <= 0)
+	{
+		mCount = 0;
+		return;
+	}
+	if (mCount > (S32)mBlocks.size())
+	{
+		mBlocks.resize(mCount);
+	}
+
+	// Only the main thread reads the message.
+	const char* field = compressed ? _PREHASH_Data : _PREHASH_TextureEntry;
+	for (S32 i = 0; i < mCount; ++i)
+	{
+		LLDecodedObjectUpdate& block = mBlocks[i];
+		S32 size = llmax(msg->getSizeFast(_PREHASH_ObjectData, i, field), 0);
+		block.mData.resize(size);
+		if (size)
+		{
+			msg->getBinaryDataFast(_PREHASH_ObjectData, field, &block.mData[0], size, i, size);
+		}
+		if (!compressed)
+		{
+			msg->getUUIDFast(_PREHASH_ObjectData, _PREHASH_FullID, block.mID, i);
+			msg->getU8Fast(_PREHASH_ObjectData, _PREHASH_PCode, block.mPCode, i);
+		}
+	}
+
+	LLWorkerPool* pool = mUseWorkerPool ? LLWorkerPool::getInstance() : NULL;
+	LLWorkerPool::Subsystem* subsystem = pool ? pool->getSubsystem("objectupdate") : NULL;
+	if (!subsystem || mCount < MIN_PARALLEL_BLOCKS)
+	{
+		for (S32 i = 0; i < mCount; ++i)
+		{
+			mBlocks[i].decode(compressed);
+		}
+		return;
+	}
+
+	LLObjectUpdateDecodeJobs jobs(&mBlocks[0], compressed);
+	pool->parallelFor(subsystem, mCount, LLObjectUpdateDecodeJobs::decodeBlock, &jobs);
+}
+
+const LLDecodedObjectUpdate* LLObjectUpdateDecoder::getBlock(S32 block) const
+{
+	if (block < 0 || block >= mCount)
+	{
+		return NULL;
+	}
+	return &mBlocks[block];
+}
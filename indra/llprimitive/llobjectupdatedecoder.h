@@ -0,0 +1,100 @@
+/**
+ * @file llobjectupdatedecoder.h
+ * @brief Decodes the blocks of object update messages on worker threads
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLOBJECTUPDATEDECODER_H
+#define LL_LLOBJECTUPDATEDECODER_H
+
+#include <vector>
+
+#include "llprimitive.h"
+#include "llvolume.h"
+
+class LLMessageSystem;
+
+// What can be decoded of one ObjectData block of an ObjectUpdate or
+// ObjectUpdateCompressed message without touching any viewer object: the
+// texture entries and, for compressed volumes, the volume parameters.
+class LLDecodedObjectUpdate
+{
+public:
+	LLDecodedObjectUpdate();
+
+	LLUUID mID;
+	LLPCode mPCode;
+
+	bool mHasTEs;
+	LLTEContents mTEs;
+
+	// Compressed volumes only. The volume parameters start mVolumeOffset bytes
+	// into the Data field and the texture entries end mEndOffset bytes into it;
+	// mVolumeOffset is -1 when the data could not be read that far.
+	bool mHasVolumeParams;
+	LLVolumeParams mVolumeParams;
+	S32 mVolumeOffset;
+	S32 mEndOffset;
+
+private:
+	friend class LLObjectUpdateDecoder;
+	friend class LLObjectUpdateDecodeJobs;
+
+	void decode(bool compressed);
+	void decodeCompressed();
+	void decodeTEs(U8* packed_buffer, S32 size);
+
+	std::vector<U8> mData;		// The Data (compressed) or TextureEntry field of the block.
+	std::vector<U8> mScratch;	// Where the binary fields of mData are unpacked.
+};
+
+// Decodes all the ObjectData blocks of a message at once, on the worker pool
+// ("objectupdate" subsystem) when it is on and there are enough blocks, so
+// that the main thread only has to apply the results.
+class LLObjectUpdateDecoder
+{
+public:
+	LLObjectUpdateDecoder();
+
+	// MAIN THREAD. Decodes the current message of msg, an ObjectUpdate or
+	// (if compressed) ObjectUpdateCompressed with full updates.
+	void decode(LLMessageSystem* msg, bool compressed);
+	void clear()								{ mCount = 0; }
+
+	S32 getBlockCount() const					{ return mCount; }
+	// Returns NULL if block was not decoded.
+	const LLDecodedObjectUpdate* getBlock(S32 block) const;
+
+	// Off decodes every block on the calling thread, for comparing.
+	void setUseWorkerPool(bool use_pool)		{ mUseWorkerPool = use_pool; }
+
+	// Fewer blocks than this are not worth waking the workers for.
+	static const S32 MIN_PARALLEL_BLOCKS = 4;
+
+private:
+	std::vector<LLDecodedObjectUpdate> mBlocks;
+	S32 mCount;
+	bool mUseWorkerPool;
+};
+
+#endif // LL_LLOBJECTUPDATEDECODER_H
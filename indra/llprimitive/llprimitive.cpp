@@ -1035,6 +1035,12 @@ S32 LLPrimitive::unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 dat
 {
 	U8 *start_loc = cur_ptr;
 	U64 i;
+	if (buffer_end - cur_ptr < data_size)
+	{
+		// Truncated field: nothing to read, not even the default value.
+		memset(data_ptr, 0, face_count * data_size);
+		return 0;
+	}
 	htonmemcpy(data_ptr,cur_ptr, type,data_size);
 	cur_ptr += data_size;
 
@@ -1048,12 +1054,18 @@ S32 LLPrimitive::unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 dat
 	{
 //		llinfos << "TE exception" << llendl;
 		i = 0;
-		while (*cur_ptr & 0x80)
+		while ((cur_ptr < buffer_end) && (*cur_ptr & 0x80))
 		{
 			i |= ((*cur_ptr++) & 0x7F);
 			i = i << 7;
 		}
 
+		if (buffer_end - cur_ptr < 1 + data_size)
+		{
+			// Truncated exception: ignore it.
+			cur_ptr = buffer_end;
+			break;
+		}
 		i |= *cur_ptr++;
 
 		for (S32 j = 0; j < face_count; j++)
@@ -1242,27 +1254,10 @@ S32 LLPrimitive::unpackTEMessage(LLMessageSystem* mesgsys, char const* block_nam
 {
 	// use a negative block_num to indicate a single-block read (a non-variable block)
 	S32 retval = 0;
-	const U32 MAX_TES = 32;
-
-	// Avoid construction of 32 UUIDs per call. JC
-
-	U8     image_data[MAX_TES*16];
-	U8	  colors[MAX_TES*4];
-	F32    scale_s[MAX_TES];
-	F32    scale_t[MAX_TES];
-	S16    offset_s[MAX_TES];
-	S16    offset_t[MAX_TES];
-	S16    image_rot[MAX_TES];
-	U8	   bump[MAX_TES];
-	U8	   media_flags[MAX_TES];
-    U8     glow[MAX_TES];
-	
 	const U32 MAX_TE_BUFFER = 4096;
 	U8 packed_buffer[MAX_TE_BUFFER];
-	U8 *cur_ptr = packed_buffer;
 
 	U32 size;
-	U32 face_count = 0;
 
 	if (block_num < 0)
 	{
@@ -1287,82 +1282,18 @@ S32 LLPrimitive::unpackTEMessage(LLMessageSystem* mesgsys, char const* block_nam
 		mesgsys->getBinaryDataFast(block_name, _PREHASH_TextureEntry, packed_buffer, 0, block_num, MAX_TE_BUFFER);
 	}
 
-	face_count = getNumTEs();
-
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)image_data, 16, face_count, MVT_LLUUID);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)colors, 4, face_count, MVT_U8);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)scale_s, 4, face_count, MVT_F32);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)scale_t, 4, face_count, MVT_F32);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)offset_s, 2, face_count, MVT_S16Array);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)offset_t, 2, face_count, MVT_S16Array);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)image_rot, 2, face_count, MVT_S16Array);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)bump, 1, face_count, MVT_U8);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)media_flags, 1, face_count, MVT_U8);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)glow, 1, face_count, MVT_U8);
-	
-	LLColor4 color;
-	LLColor4U coloru;
-	for (U32 i = 0; i < face_count; i++)
-	{
-		retval |= setTETexture(i, ((LLUUID*)image_data)[i]);
-		retval |= setTEScale(i, scale_s[i], scale_t[i]);
-		retval |= setTEOffset(i, (F32)offset_s[i] / (F32)0x7FFF, (F32) offset_t[i] / (F32) 0x7FFF);
-		retval |= setTERotation(i, ((F32)image_rot[i] / TEXTURE_ROTATION_PACK_FACTOR) * F_TWO_PI);
-		retval |= setTEBumpShinyFullbright(i, bump[i]);
-		retval |= setTEMediaTexGen(i, media_flags[i]);
-		retval |= setTEGlow(i, (F32)glow[i] / (F32)0xFF);
-		coloru = LLColor4U(colors + 4*i);
-
-		// Note:  This is an optimization to send common colors (1.f, 1.f, 1.f, 1.f)
-		// as all zeros.  However, the subtraction and addition must be done in unsigned
-		// byte space, not in float space, otherwise off-by-one errors occur. JC
-		color.mV[VRED]		= F32(255 - coloru.mV[VRED])   / 255.f;
-		color.mV[VGREEN]	= F32(255 - coloru.mV[VGREEN]) / 255.f;
-		color.mV[VBLUE]		= F32(255 - coloru.mV[VBLUE])  / 255.f;
-		color.mV[VALPHA]	= F32(255 - coloru.mV[VALPHA]) / 255.f;
-
-		retval |= setTEColor(i, color);
-
-	}
-
-	return retval;
+	LLTEContents tec;
+	parseTEMessage(packed_buffer, llmin(size, MAX_TE_BUFFER), getNumTEs(), tec);
+	return applyParsedTEMessage(tec);
 }
 
 S32 LLPrimitive::unpackTEMessage(LLDataPacker &dp)
 {
-	// use a negative block_num to indicate a single-block read (a non-variable block)
 	S32 retval = 0;
-	const U32 MAX_TES = 32;
-
-	// Avoid construction of 32 UUIDs per call
-	static LLUUID image_ids[MAX_TES];
-
-	U8     image_data[MAX_TES*16];
-	U8	   colors[MAX_TES*4];
-	F32    scale_s[MAX_TES];
-	F32    scale_t[MAX_TES];
-	S16    offset_s[MAX_TES];
-	S16    offset_t[MAX_TES];
-	S16    image_rot[MAX_TES];
-	U8	   bump[MAX_TES];
-	U8	   media_flags[MAX_TES];
-    U8     glow[MAX_TES];
-
 	const U32 MAX_TE_BUFFER = 4096;
 	U8 packed_buffer[MAX_TE_BUFFER];
-	U8 *cur_ptr = packed_buffer;
 
 	S32 size;
-	U32 face_count = 0;
 
 	if (!dp.unpackBinaryData(packed_buffer, size, "TextureEntry"))
 	{
@@ -1376,46 +1307,65 @@ S32 LLPrimitive::unpackTEMessage(LLDataPacker &dp)
 		return retval;
 	}
 
-	face_count = llmin((U32) getNumTEs(), MAX_TES);
-	U32 i;
+	LLTEContents tec;
+	parseTEMessage(packed_buffer, size, getNumTEs(), tec);
+	return applyParsedTEMessage(tec);
+}
 
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)image_data, 16, face_count, MVT_LLUUID);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)colors, 4, face_count, MVT_U8);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)scale_s, 4, face_count, MVT_F32);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)scale_t, 4, face_count, MVT_F32);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)offset_s, 2, face_count, MVT_S16Array);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)offset_t, 2, face_count, MVT_S16Array);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)image_rot, 2, face_count, MVT_S16Array);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)bump, 1, face_count, MVT_U8);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)media_flags, 1, face_count, MVT_U8);
-	cur_ptr++;
-	cur_ptr += unpackTEField(cur_ptr, packed_buffer+size, (U8 *)glow, 1, face_count, MVT_U8);
-
-	for (i = 0; i < face_count; i++)
-	{
-		memcpy(image_ids[i].mData,&image_data[i*16],16);	/* Flawfinder: ignore */ 	
-	}
-	
+// Steps over the zero that ends a field, if the buffer has it.
+static inline U8* skipTEFieldEnd(U8* cur_ptr, U8* buffer_end)
+{
+	return cur_ptr < buffer_end ? cur_ptr + 1 : cur_ptr;
+}
+
+//static
+void LLPrimitive::parseTEMessage(U8* packed_buffer, U32 size, U32 face_count, LLTEContents& tec)
+{
+	U8 *cur_ptr = packed_buffer;
+	U8 *buffer_end = packed_buffer + size;
+
+	tec.face_count = (U8)llmin(face_count, LLTEContents::MAX_TES);
+
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.image_data, 16, tec.face_count, MVT_LLUUID);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.colors, 4, tec.face_count, MVT_U8);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.scale_s, 4, tec.face_count, MVT_F32);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.scale_t, 4, tec.face_count, MVT_F32);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.offset_s, 2, tec.face_count, MVT_S16Array);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.offset_t, 2, tec.face_count, MVT_S16Array);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.image_rot, 2, tec.face_count, MVT_S16Array);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.bump, 1, tec.face_count, MVT_U8);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.media_flags, 1, tec.face_count, MVT_U8);
+	cur_ptr = skipTEFieldEnd(cur_ptr, buffer_end);
+	cur_ptr += unpackTEField(cur_ptr, buffer_end, (U8 *)tec.glow, 1, tec.face_count, MVT_U8);
+}
+
+S32 LLPrimitive::applyParsedTEMessage(const LLTEContents& tec)
+{
+	S32 retval = 0;
+	U32 face_count = llmin((U32)getNumTEs(), (U32)tec.face_count);
+
+	LLUUID image_id;
 	LLColor4 color;
 	LLColor4U coloru;
-	for (i = 0; i < face_count; i++)
-	{
-		retval |= setTETexture(i, image_ids[i]);
-		retval |= setTEScale(i, scale_s[i], scale_t[i]);
-		retval |= setTEOffset(i, (F32)offset_s[i] / (F32)0x7FFF, (F32) offset_t[i] / (F32) 0x7FFF);
-		retval |= setTERotation(i, ((F32)image_rot[i] / TEXTURE_ROTATION_PACK_FACTOR) * F_TWO_PI);
-		retval |= setTEBumpShinyFullbright(i, bump[i]);
-		retval |= setTEMediaTexGen(i, media_flags[i]);
-		retval |= setTEGlow(i, (F32)glow[i] / (F32)0xFF);
-		coloru = LLColor4U(colors + 4*i);
+	for (U32 i = 0; i < face_count; i++)
+	{
+		memcpy(image_id.mData, &tec.image_data[i*16], 16);	/* Flawfinder: ignore */
+		retval |= setTETexture(i, image_id);
+		retval |= setTEScale(i, tec.scale_s[i], tec.scale_t[i]);
+		retval |= setTEOffset(i, (F32)tec.offset_s[i] / (F32)0x7FFF, (F32) tec.offset_t[i] / (F32) 0x7FFF);
+		retval |= setTERotation(i, ((F32)tec.image_rot[i] / TEXTURE_ROTATION_PACK_FACTOR) * F_TWO_PI);
+		retval |= setTEBumpShinyFullbright(i, tec.bump[i]);
+		retval |= setTEMediaTexGen(i, tec.media_flags[i]);
+		retval |= setTEGlow(i, (F32)tec.glow[i] / (F32)0xFF);
+		coloru = LLColor4U(tec.colors + 4*i);
 
 		// Note:  This is an optimization to send common colors (1.f, 1.f, 1.f, 1.f)
 		// as all zeros.  However, the subtraction and addition must be done in unsigned
@@ -295,6 +295,25 @@ public:
 };
 
 
+// The texture entries of an update, decoded but not yet applied to a
+// primitive. Decoding needs no primitive, so it can run on any thread.
+struct LLTEContents
+{
+	static const U32 MAX_TES = 32;
+
+	U8		image_data[MAX_TES*16];
+	U8		colors[MAX_TES*4];
+	F32		scale_s[MAX_TES];
+	F32		scale_t[MAX_TES];
+	S16		offset_s[MAX_TES];
+	S16		offset_t[MAX_TES];
+	S16		image_rot[MAX_TES];
+	U8		bump[MAX_TES];
+	U8		media_flags[MAX_TES];
+	U8		glow[MAX_TES];
+	U8		face_count;
+};
+
 class LLPrimitive : public LLXform
 {
 public:
@@ -363,12 +382,16 @@ public:
 
 	void copyTEs(const LLPrimitive *primitive);
 	S32 packTEField(U8 *cur_ptr, U8 *data_ptr, U8 data_size, U8 last_face_index, EMsgVariableType type) const;
-	S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
+	static S32 unpackTEField(U8 *cur_ptr, U8 *buffer_end, U8 *data_ptr, U8 data_size, U8 face_count, EMsgVariableType type);
 	BOOL packTEMessage(LLMessageSystem *mesgsys) const;
 	BOOL packTEMessage(LLDataPacker &dp) const;
 	S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name);
 	S32 unpackTEMessage(LLMessageSystem* mesgsys, char const* block_name, const S32 block_num); // Variable num of blocks
 	BOOL unpackTEMessage(LLDataPacker &dp);
+	// Decodes size bytes of a TextureEntry field for the first face_count faces (at most MAX_TES).
+	static void parseTEMessage(U8* packed_buffer, U32 size, U32 face_count, LLTEContents& tec);
+	// Applies the decoded faces that this primitive has; returns the TEM_CHANGE_* flags.
+	S32 applyParsedTEMessage(const LLTEContents& tec);
 	
 #ifdef CHECK_FOR_FINITE
 	inline void setPosition(const LLVector3& pos);
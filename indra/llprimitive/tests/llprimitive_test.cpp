@@ -0,0 +1,148 @@
+/**
+ * @file llprimitive_test.cpp
+ * @brief Tests of the texture entry decoding of LLPrimitive
+ *
+ * $LicenseInfo:firstyear=2012&license=viewerlgpl$
+ * Second Life Viewer Source Code
+ * Copyright (C) 2012, Linden Research, Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation;
+ * version 2.1 of the License only.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * Linden Research, Inc., 945 Battery Street, San Francisco, CA  94111  USA
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "../llprimitive.h"
+#include "lldatapacker.h"
+#include "v4color.h"
+
+#include "../test/lltut.h"
+
+// Set by the viewer (llgl.cpp, llspatialpartition.cpp); llvolume uses them.
+BOOL gDebugGL = FALSE;
+U32 gOctreeMaxCapacity = 128;
+U32 gOctreeReserveCapacity = 4;
+
+namespace
+{
+	const U8 NUM_TES = 6;
+
+	// A primitive whose faces differ in every field, so that each field has exceptions.
+	void make_prim(LLPrimitive& prim)
+	{
+		prim.setNumTEs(NUM_TES);
+		for (U8 i = 0; i < NUM_TES; ++i)
+		{
+			LLUUID id;
+			id.mData[0] = (i & 1) ? 1 : 2;
+			id.mData[15] = i;
+			prim.setTETexture(i, id);
+			prim.setTEColor(i, LLColor4(0.1f * i, 0.5f, 1.f, (i % 3) ? 1.f : 0.5f));
+			prim.setTEScale(i, 1.f + (i % 2), 2.f - 0.25f * i);
+			prim.setTEOffset(i, 0.125f * (i % 4), -0.25f);
+			prim.setTERotation(i, (i == 3) ? 1.f : 0.f);
+			prim.setTEBumpShinyFullbright(i, i);
+			prim.setTEMediaTexGen(i, (i == 5) ? 2 : 0);
+			prim.setTEGlow(i, (i > 3) ? 0.5f : 0.f);
+		}
+	}
+
+	// The packed TextureEntry field of prim.
+	std::vector<U8> pack_tes(const LLPrimitive& prim)
+	{
+		std::vector<U8> buffer(4096);
+		LLDataPackerBinaryBuffer dp(&buffer[0], buffer.size());
+		prim.packTEMessage(dp);
+		dp.reset();
+		std::vector<U8> field(4096);
+		S32 size;
+		dp.unpackBinaryData(&field[0], size, "TextureEntry");
+		field.resize(size);
+		return field;
+	}
+
+	// Decodes the first size bytes of field both ways and checks that the results are the same.
+	void check_same(const std::vector<U8>& field, S32 size, const char* what)
+	{
+		std::vector<U8> buffer(4096);
+		LLDataPackerBinaryBuffer dp(&buffer[0], buffer.size());
+		dp.packBinaryData(&field[0], size, "TextureEntry");
+		dp.reset();
+		LLPrimitive unpacked;
+		unpacked.setNumTEs(NUM_TES);
+		unpacked.unpackTEMessage(dp);
+
+		// Exactly size bytes, like the Data field LLDecodedObjectUpdate passes on.
+		std::vector<U8> exact(field.begin(), field.begin() + size);
+		LLTEContents tec;
+		LLPrimitive::parseTEMessage(&exact[0], size, NUM_TES, tec);
+		LLPrimitive parsed;
+		parsed.setNumTEs(NUM_TES);
+		parsed.applyParsedTEMessage(tec);
+
+		for (U8 i = 0; i < NUM_TES; ++i)
+		{
+			tut::ensure(what, *parsed.getTE(i) == *unpacked.getTE(i));
+		}
+	}
+}
+
+namespace tut
+{
+	struct primitive_data
+	{
+	};
+	typedef test_group<primitive_data> primitive_test;
+	typedef primitive_test::object primitive_object;
+	tut::primitive_test primitive("LLPrimitive");
+
+	// Parsing and applying separately gives what unpackTEMessage() gives.
+	template<> template<>
+	void primitive_object::test<1>()
+	{
+		LLPrimitive prim;
+		make_prim(prim);
+		std::vector<U8> field = pack_tes(prim);
+		ensure("packed", !field.empty());
+
+		check_same(field, field.size(), "whole field");
+
+		LLTEContents tec;
+		LLPrimitive::parseTEMessage(&field[0], field.size(), NUM_TES, tec);
+		LLPrimitive parsed;
+		parsed.setNumTEs(NUM_TES);
+		parsed.applyParsedTEMessage(tec);
+		// The values are quantized when packed, so compare packed.
+		ensure("round trip", pack_tes(parsed) == field);
+	}
+
+	// A field cut anywhere, also in the middle of a value or an exception,
+	// is decoded the same both ways and never read past its end.
+	template<> template<>
+	void primitive_object::test<2>()
+	{
+		LLPrimitive prim;
+		make_prim(prim);
+		std::vector<U8> field = pack_tes(prim);
+		for (S32 size = 1; size < (S32)field.size(); ++size)
+		{
+			check_same(field, size, "truncated field");
+		}
+	}
+}
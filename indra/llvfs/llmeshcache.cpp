@@ -0,0 +1,705 @@
+/**
+ * @file llmeshcache.cpp
+ * @brief Disk cache of mesh assets with an index of their headers
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#if LL_WINDOWS
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "linden_common.h"
+
+#include "llmeshcache.h"
+
+#include <vector>
+
+#include "llcrc.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+
+// Index file layout:
+//
+//   U32 magic, U32 version, U32 entry count, U32 CRC of the records
+//   records, most recently used first:
+//     U8[16] uuid, S32 header size, S32 version, U32 stored blobs,
+//     S32 stored bytes, S32[BLOB_COUNT] offsets, S32[BLOB_COUNT] sizes
+//
+// The index stays on the machine that wrote it, so fields are in native order.
+
+const U32 INDEX_MAGIC = 0x434d4c4c;			// "LLMC"
+const U32 INDEX_VERSION = 1;
+const S32 INDEX_HEADER_SIZE = 16;
+const S32 INDEX_RECORD_SIZE = UUID_BYTES + 4 * 4 + 2 * 4 * LLMeshCache::BLOB_COUNT;
+// Beyond this the header or the file is corrupt.
+const S32 MAX_ASSET_SIZE = 64 * 1024 * 1024;
+
+static const char* BLOB_NAMES[LLMeshCache::BLOB_COUNT] =
+{
+	"lowest_lod",
+	"low_lod",
+	"medium_lod",
+	"high_lod",
+	"skin",
+	"physics_convex",
+	"physics_mesh"
+};
+
+static inline U32 get_u32(const U8* p)
+{
+	U32 value;
+	memcpy(&value, p, sizeof(U32));
+	return value;
+}
+
+static inline void put_u32(U8* p, U32 value)
+{
+	memcpy(p, &value, sizeof(U32));
+}
+
+// Files kept open for reading.
+const size_t MAX_OPEN_FILES = 32;
+
+#if LL_WINDOWS
+//static
+const LLMeshCache::file_handle_t LLMeshCache::INVALID_FILE = INVALID_HANDLE_VALUE;
+
+static HANDLE open_file(const std::string& filename)
+{
+	// Shared, so that blobs can still be written and the file removed.
+	return CreateFileW(utf8str_to_utf16str(filename).c_str(), GENERIC_READ,
+					   FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+}
+
+static void close_file(HANDLE file)
+{
+	CloseHandle(file);
+}
+
+// Reads size bytes at offset with a single positioned read.
+static bool read_at(HANDLE file, S32 offset, U8* buffer, S32 size)
+{
+	OVERLAPPED overlapped;
+	memset(&overlapped, 0, sizeof(overlapped));
+	overlapped.Offset = (DWORD)offset;
+	DWORD bytes_read = 0;
+	return ReadFile(file, buffer, (DWORD)size, &bytes_read, &overlapped) && bytes_read == (DWORD)size;
+}
+#else
+//static
+const LLMeshCache::file_handle_t LLMeshCache::INVALID_FILE = -1;
+
+static int open_file(const std::string& filename)
+{
+	int fd = ::open(filename.c_str(), O_RDONLY);
+#if LL_LINUX
+	if (fd >= 0)
+	{	// The other blobs of the asset are usually wanted next.
+		posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+	}
+#endif
+	return fd;
+}
+
+static void close_file(int fd)
+{
+	::close(fd);
+}
+
+// Reads size bytes at offset with a single positioned read.
+static bool read_at(int fd, S32 offset, U8* buffer, S32 size)
+{
+	return pread(fd, buffer, size, offset) == (ssize_t)size;
+}
+#endif
+
+//----------------------------------------------------------------------------
+
+LLMeshCache::Header::Header()
+:	mHeaderSize(0),
+	mVersion(0)
+{
+	for (S32 i = 0; i < BLOB_COUNT; ++i)
+	{
+		mOffset[i] = mSize[i] = 0;
+	}
+}
+
+void LLMeshCache::Header::fromLLSD(const LLSD& header, S32 header_size)
+{
+	mHeaderSize = header_size;
+	mVersion = header["version"].asInteger();
+	for (S32 i = 0; i < BLOB_COUNT; ++i)
+	{
+		mOffset[i] = mSize[i] = 0;
+		if (header.has(BLOB_NAMES[i]))
+		{
+			const LLSD& blob = header[BLOB_NAMES[i]];
+			mOffset[i] = blob["offset"].asInteger();
+			mSize[i] = blob["size"].asInteger();
+			if (mOffset[i] < 0 || mSize[i] < 0 || mSize[i] > MAX_ASSET_SIZE - mOffset[i])
+			{
+				mOffset[i] = mSize[i] = 0;
+			}
+		}
+	}
+}
+
+LLSD LLMeshCache::Header::asLLSD() const
+{
+	LLSD header;
+	header["version"] = mVersion;
+	for (S32 i = 0; i < BLOB_COUNT; ++i)
+	{
+		if (mSize[i] > 0)
+		{
+			header[BLOB_NAMES[i]]["offset"] = mOffset[i];
+			header[BLOB_NAMES[i]]["size"] = mSize[i];
+		}
+	}
+	return header;
+}
+
+//static
+const char* LLMeshCache::getBlobName(EBlob blob)
+{
+	return BLOB_NAMES[blob];
+}
+
+//----------------------------------------------------------------------------
+
+LLMeshCache::OpenFile::~OpenFile()
+{
+	close_file(mFile);
+}
+
+LLMeshCache::LLMeshCache()
+:	mMaxSize(0),
+	mUsage(0),
+	mDirty(false),
+	mNextSerial(0),
+	mHits(0),
+	mMisses(0)
+{
+}
+
+LLMeshCache::~LLMeshCache()
+{
+	saveIndex();
+	LLMutexLock lock(&mIndexMutex);
+	closeFiles();
+}
+
+void LLMeshCache::initCache(const std::string& dirname, S64 max_size)
+{
+	LLMutexLock lock(&mIndexMutex);
+	closeFiles();
+	mDirName = dirname;
+	mMaxSize = max_size;
+	mLRU.clear();
+	mEntries.clear();
+	mUsage = 0;
+	mDirty = false;
+	if (!mMaxSize)
+	{
+		return;
+	}
+
+	LLFile::mkdir(mDirName);
+	if (!loadIndex())
+	{
+		// Whatever files there are, nothing says what is in them.
+		mLRU.clear();
+		mEntries.clear();
+		mUsage = 0;
+		mDirty = true;
+	}
+	removeUnlistedFiles();
+	evict();
+	llinfos << "Mesh cache: " << mEntries.size() << " assets, " << (mUsage >> 20)
+			<< " of " << (mMaxSize >> 20) << " MB" << llendl;
+}
+
+#if LL_WINDOWS
+const char DIR_DELIMITER = '\\';
+#else
+const char DIR_DELIMITER = '/';
+#endif
+
+std::string LLMeshCache::getFileName(const LLUUID& id) const
+{
+	return mDirName + DIR_DELIMITER + id.asString() + ".mesh";
+}
+
+std::string LLMeshCache::getIndexName() const
+{
+	return mDirName + DIR_DELIMITER + "meshcache.idx";
+}
+
+bool LLMeshCache::loadIndex()
+{
+	std::string filename = getIndexName();
+	LLFILE* fp = LLFile::fopen(filename, "rb");
+	if (!fp)
+	{
+		return false;
+	}
+	std::vector<U8> image;
+	bool success = fseek(fp, 0, SEEK_END) == 0;
+	long size = success ? ftell(fp) : -1;
+	success = size >= INDEX_HEADER_SIZE && fseek(fp, 0, SEEK_SET) == 0;
+	if (success)
+	{
+		image.resize(size);
+		success = fread(&image[0], 1, size, fp) == (size_t)size;
+	}
+	LLFile::close(fp);
+
+	U32 count = success ? get_u32(&image[8]) : 0;
+	success = success && get_u32(&image[0]) == INDEX_MAGIC && get_u32(&image[4]) == INDEX_VERSION &&
+			  (size - INDEX_HEADER_SIZE) / INDEX_RECORD_SIZE == (long)count &&
+			  (size - INDEX_HEADER_SIZE) % INDEX_RECORD_SIZE == 0;
+	if (success)
+	{
+		LLCRC crc;
+		crc.update(&image[INDEX_HEADER_SIZE], size - INDEX_HEADER_SIZE);
+		success = crc.getCRC() == get_u32(&image[12]);
+	}
+	if (!success)
+	{
+		llwarns << "Mesh cache index " << filename << " is missing or corrupt, starting empty." << llendl;
+		return false;
+	}
+
+	const U8* p = &image[INDEX_HEADER_SIZE];
+	for (U32 i = 0; i < count; ++i, p += INDEX_RECORD_SIZE)
+	{
+		LLUUID id;
+		memcpy(id.mData, p, UUID_BYTES);
+		const U8* fields = p + UUID_BYTES;
+		Header header;
+		header.mHeaderSize = (S32)get_u32(fields);
+		header.mVersion = (S32)get_u32(fields + 4);
+		for (S32 blob = 0; blob < BLOB_COUNT; ++blob)
+		{
+			header.mOffset[blob] = (S32)get_u32(fields + 16 + 4 * blob);
+			header.mSize[blob] = (S32)get_u32(fields + 16 + 4 * (BLOB_COUNT + blob));
+		}
+		mLRU.push_back(Entry(id, header));
+		Entry& entry = mLRU.back();
+		entry.mSerial = ++mNextSerial;
+		entry.mPresent = get_u32(fields + 8);
+		entry.mSize = (S32)get_u32(fields + 12);
+		mEntries[id] = --mLRU.end();
+		mUsage += entry.mSize;
+	}
+	return true;
+}
+
+bool LLMeshCache::saveIndex()
+{
+	std::vector<U8> image;
+	std::string filename;
+	{
+		LLMutexLock lock(&mIndexMutex);
+		if (!mMaxSize || !mDirty)
+		{
+			return true;
+		}
+		image.resize(INDEX_HEADER_SIZE + mLRU.size() * INDEX_RECORD_SIZE);
+		U8* p = &image[INDEX_HEADER_SIZE];
+		for (lru_list_t::const_iterator iter = mLRU.begin(); iter != mLRU.end(); ++iter, p += INDEX_RECORD_SIZE)
+		{
+			memcpy(p, iter->mID.mData, UUID_BYTES);
+			U8* fields = p + UUID_BYTES;
+			put_u32(fields, (U32)iter->mHeader.mHeaderSize);
+			put_u32(fields + 4, (U32)iter->mHeader.mVersion);
+			put_u32(fields + 8, iter->mPresent);
+			put_u32(fields + 12, (U32)iter->mSize);
+			for (S32 blob = 0; blob < BLOB_COUNT; ++blob)
+			{
+				put_u32(fields + 16 + 4 * blob, (U32)iter->mHeader.mOffset[blob]);
+				put_u32(fields + 16 + 4 * (BLOB_COUNT + blob), (U32)iter->mHeader.mSize[blob]);
+			}
+		}
+		put_u32(&image[0], INDEX_MAGIC);
+		put_u32(&image[4], INDEX_VERSION);
+		put_u32(&image[8], (U32)mLRU.size());
+		LLCRC crc;
+		if (image.size() > (size_t)INDEX_HEADER_SIZE)
+		{
+			crc.update(&image[INDEX_HEADER_SIZE], image.size() - INDEX_HEADER_SIZE);
+		}
+		put_u32(&image[12], crc.getCRC());
+		filename = getIndexName();
+		mDirty = false;
+	}
+
+	// Write a temporary file first, so that a crash leaves the old index.
+	std::string tmpname = filename + ".tmp";
+	LLFILE* fp = LLFile::fopen(tmpname, "wb");
+	bool success = fp != NULL;
+	if (fp)
+	{
+		success = fwrite(&image[0], 1, image.size(), fp) == image.size();
+		success = LLFile::close(fp) == 0 && success;
+	}
+	if (success)
+	{
+		success = LLFile::replace(tmpname, filename) == 0;
+	}
+	if (!success)
+	{
+		llwarns << "Unable to write mesh cache index " << filename << llendl;
+		LLFile::remove(tmpname);
+		LLMutexLock lock(&mIndexMutex);
+		mDirty = true;
+	}
+	return success;
+}
+
+void LLMeshCache::clear()
+{
+	LLMutexLock lock(&mIndexMutex);
+	while (!mEntries.empty())
+	{
+		removeEntry(mEntries.begin());
+	}
+}
+
+bool LLMeshCache::getHeader(const LLUUID& id, Header& header)
+{
+	LLMutexLock lock(&mIndexMutex);
+	entry_map_t::iterator iter = mEntries.find(id);
+	if (iter == mEntries.end())
+	{
+		mMisses++;
+		return false;
+	}
+	mHits++;
+	mLRU.splice(mLRU.begin(), mLRU, iter->second);
+	header = iter->second->mHeader;
+	return true;
+}
+
+bool LLMeshCache::writeHeader(const LLUUID& id, const Header& header, const U8* data, S32 data_size)
+{
+	if (!data || data_size < header.mHeaderSize || header.mHeaderSize <= 0)
+	{
+		return false;
+	}
+
+	std::string filename;
+	{
+		LLMutexLock lock(&mIndexMutex);
+		if (!mMaxSize || mEntries.find(id) != mEntries.end() || !mWriting.insert(id).second)
+		{
+			return false;
+		}
+		filename = getFileName(id);
+	}
+
+	// Replaces whatever was left by a session that didn't save its index.
+	LLFILE* fp = LLFile::fopen(filename, "wb");
+	bool success = fp != NULL;
+	if (fp)
+	{
+		success = fwrite(data, 1, data_size, fp) == (size_t)data_size;
+		success = LLFile::close(fp) == 0 && success;
+		if (!success)
+		{
+			LLFile::remove(filename);
+		}
+	}
+
+	LLMutexLock lock(&mIndexMutex);
+	mWriting.erase(id);
+	if (!success || !mMaxSize)
+	{
+		return false;
+	}
+	mLRU.push_front(Entry(id, header));
+	Entry& entry = mLRU.front();
+	mEntries[id] = mLRU.begin();
+	entry.mSerial = ++mNextSerial;
+	entry.mSize = data_size;
+	for (S32 blob = 0; blob < BLOB_COUNT; ++blob)
+	{
+		if (header.mSize[blob] > 0 && header.mHeaderSize + header.mOffset[blob] + header.mSize[blob] <= data_size)
+		{
+			entry.mPresent |= 1 << blob;
+		}
+	}
+	mUsage += data_size;
+	mDirty = true;
+	evict();
+	return true;
+}
+
+U8* LLMeshCache::readBlob(const LLUUID& id, EBlob blob, S32& size)
+{
+	LLPointer<OpenFile> file;
+	std::string filename;
+	S32 offset;
+	U32 serial;
+	{
+		LLMutexLock lock(&mIndexMutex);
+		entry_map_t::iterator iter = mEntries.find(id);
+		if (iter == mEntries.end() || !(iter->second->mPresent & (1 << blob)))
+		{
+			mMisses++;
+			return NULL;
+		}
+		mLRU.splice(mLRU.begin(), mLRU, iter->second);
+		Entry& entry = *iter->second;
+		size = entry.mHeader.mSize[blob];
+		offset = entry.mHeader.mHeaderSize + entry.mHeader.mOffset[blob];
+		serial = entry.mSerial;
+		if (entry.mFile.notNull())
+		{
+			mOpenFiles.splice(mOpenFiles.begin(), mOpenFiles, entry.mOpenIter);
+			file = entry.mFile;
+		}
+		else
+		{
+			filename = getFileName(id);
+		}
+	}
+
+	if (file.isNull())
+	{
+		file_handle_t handle = open_file(filename);
+		if (handle != INVALID_FILE)
+		{
+			file = new OpenFile(handle);
+			LLMutexLock lock(&mIndexMutex);
+			entry_map_t::iterator iter = findEntry(id, serial);
+			if (iter != mEntries.end())
+			{
+				keepOpen(*iter->second, file);
+			}
+		}
+	}
+
+	U8* data = NULL;
+	if (file.notNull())
+	{
+		data = new U8[size];
+		if (!read_at(file->mFile, offset, data, size))
+		{
+			delete [] data;
+			data = NULL;
+		}
+	}
+	if (!data)
+	{
+		// Lost with an index that wasn't saved, or removed by hand.
+		LLMutexLock lock(&mIndexMutex);
+		entry_map_t::iterator iter = findEntry(id, serial);
+		if (iter != mEntries.end())
+		{
+			removeEntry(iter);
+		}
+		mMisses++;
+		return NULL;
+	}
+	mHits++;
+	return data;
+}
+
+bool LLMeshCache::writeBlob(const LLUUID& id, EBlob blob, const U8* data, S32 size)
+{
+	if (!data)
+	{
+		return false;
+	}
+
+	std::string filename;
+	S32 offset;
+	U32 serial;
+	{
+		LLMutexLock lock(&mIndexMutex);
+		entry_map_t::iterator iter = mEntries.find(id);
+		if (iter == mEntries.end())
+		{
+			return false;
+		}
+		Entry& entry = *iter->second;
+		if (entry.mHeader.mSize[blob] != size)
+		{
+			return false;
+		}
+		if (entry.mPresent & (1 << blob))
+		{	// It replaces a blob that didn't decode: a miss until it is written.
+			entry.mPresent &= ~(1 << blob);
+			entry.mSize -= size;
+			mUsage -= size;
+		}
+		offset = entry.mHeader.mHeaderSize + entry.mHeader.mOffset[blob];
+		serial = entry.mSerial;
+		filename = getFileName(id);
+	}
+
+	LLFILE* fp = LLFile::fopen(filename, "r+b");
+	bool success = fp != NULL;
+	if (fp)
+	{
+		success = fseek(fp, offset, SEEK_SET) == 0 && fwrite(data, 1, size, fp) == (size_t)size;
+		success = LLFile::close(fp) == 0 && success;
+	}
+
+	LLMutexLock lock(&mIndexMutex);
+	entry_map_t::iterator iter = findEntry(id, serial);
+	if (iter == mEntries.end())
+	{	// Removed while it was written.
+		return false;
+	}
+	if (!success)
+	{
+		removeEntry(iter);
+		return false;
+	}
+	Entry& entry = *iter->second;
+	if (!(entry.mPresent & (1 << blob)))
+	{
+		entry.mPresent |= 1 << blob;
+		entry.mSize += size;
+		mUsage += size;
+	}
+	mLRU.splice(mLRU.begin(), mLRU, iter->second);
+	mDirty = true;
+	evict();
+	return true;
+}
+
+void LLMeshCache::remove(const LLUUID& id)
+{
+	LLMutexLock lock(&mIndexMutex);
+	entry_map_t::iterator iter = mEntries.find(id);
+	if (iter != mEntries.end())
+	{
+		removeEntry(iter);
+	}
+}
+
+U32 LLMeshCache::getEntries()
+{
+	LLMutexLock lock(&mIndexMutex);
+	return (U32)mEntries.size();
+}
+
+S64 LLMeshCache::getUsage()
+{
+	LLMutexLock lock(&mIndexMutex);
+	return mUsage;
+}
+
+//----------------------------------------------------------------------------
+// mIndexMutex must be locked for the following functions!
+
+// Removes the asset files that the index doesn't list: all of them when it
+// couldn't be loaded, else those of the assets stored after its last save.
+void LLMeshCache::removeUnlistedFiles()
+{
+	LLDirIterator iter(mDirName, "*.mesh");
+	std::string filename;
+	while (iter.next(filename))
+	{
+		LLUUID id;
+		if (!id.set(filename.substr(0, filename.size() - 5), FALSE) || mEntries.find(id) == mEntries.end())
+		{
+			LLFile::remove(mDirName + DIR_DELIMITER + filename);
+		}
+	}
+}
+
+LLMeshCache::entry_map_t::iterator LLMeshCache::findEntry(const LLUUID& id, U32 serial)
+{
+	entry_map_t::iterator iter = mEntries.find(id);
+	if (iter != mEntries.end() && iter->second->mSerial != serial)
+	{
+		iter = mEntries.end();
+	}
+	return iter;
+}
+
+void LLMeshCache::removeEntry(entry_map_t::iterator iter)
+{
+	closeFile(*iter->second);
+	LLFile::remove(getFileName(iter->first));
+	mUsage -= iter->second->mSize;
+	mLRU.erase(iter->second);
+	mEntries.erase(iter);
+	mDirty = true;
+}
+
+void LLMeshCache::evict()
+{
+	while (mUsage > mMaxSize && !mLRU.empty())
+	{
+		removeEntry(mEntries.find(mLRU.back().mID));
+	}
+}
+
+void LLMeshCache::keepOpen(Entry& entry, OpenFile* file)
+{
+	if (entry.mFile.notNull())
+	{	// Opened by another read meanwhile.
+		return;
+	}
+	while (mOpenFiles.size() >= MAX_OPEN_FILES)
+	{
+		closeFile(*mEntries[mOpenFiles.back()]);
+	}
+	entry.mFile = file;
+	mOpenFiles.push_front(entry.mID);
+	entry.mOpenIter = mOpenFiles.begin();
+}
+
+void LLMeshCache::closeFile(Entry& entry)
+{
+	if (entry.mFile.notNull())
+	{
+		// Closed now, or by the last read still using it.
+		entry.mFile = NULL;
+		mOpenFiles.erase(entry.mOpenIter);
+	}
+}
+
+void LLMeshCache::closeFiles()
+{
+	while (!mOpenFiles.empty())
+	{
+		closeFile(*mEntries[mOpenFiles.back()]);
+	}
+}
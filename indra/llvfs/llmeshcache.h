@@ -0,0 +1,196 @@
+/**
+ * @file llmeshcache.h
+ * @brief Disk cache of mesh assets with an index of their headers
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLMESHCACHE_H
+#define LL_LLMESHCACHE_H
+
+#include <list>
+#include <map>
+#include <set>
+#include "llatomic.h"
+#include "llpointer.h"
+#include "llsd.h"
+#include "llthread.h"
+#include "lluuid.h"
+
+// Cache of mesh assets, apart from the VFS: one file per asset, holding the
+// bytes of the asset at their own offsets, and an index of where the blobs
+// (LODs, skin, physics) of every cached asset are, which is kept in memory
+// and saved as a single binary file.
+//
+// Mesh headers are answered from the index without touching the disk and a
+// blob costs a single positioned read of its file, which is kept open for
+// the next blob of the asset. The index also records
+// which blobs have been stored, so a blob that was never fetched is a miss
+// and not a block of zeroes. Assets are evicted least recently used first
+// when the cache grows beyond its budget.
+//
+// The index is only saved by saveIndex(): assets stored after the last save
+// are forgotten by a crash (initCache() removes their files) and assets
+// evicted after it are misses on their first read.
+//
+// All functions may be called from any thread. The index is only locked to
+// look up or update entries; the files are read and written outside the lock,
+// so a slow disk doesn't hold up header lookups or the reads of other assets.
+class LLMeshCache
+{
+public:
+	enum EBlob
+	{
+		BLOB_LOWEST_LOD = 0,
+		BLOB_LOW_LOD,
+		BLOB_MEDIUM_LOD,
+		BLOB_HIGH_LOD,
+		BLOB_SKIN,
+		BLOB_PHYSICS_CONVEX,
+		BLOB_PHYSICS_MESH,
+		BLOB_COUNT
+	};
+
+	// What the mesh repository uses of the LLSD header of an asset.
+	struct Header
+	{
+		Header();
+
+		// Takes the fields of a parsed asset header of header_size bytes.
+		void fromLLSD(const LLSD& header, S32 header_size);
+		// The same fields as LLSD again.
+		LLSD asLLSD() const;
+
+		S32 mHeaderSize;		// Bytes of the header; blob offsets are relative to its end.
+		S32 mVersion;
+		S32 mOffset[BLOB_COUNT];
+		S32 mSize[BLOB_COUNT];	// 0 if the asset has no such blob.
+	};
+
+	// The key of blob in the asset header, "lowest_lod" to "physics_mesh".
+	static const char* getBlobName(EBlob blob);
+
+	LLMeshCache();
+	~LLMeshCache();
+
+	// Opens the cache in dirname, creating it if needed. Until this is called,
+	// and when max_size is 0, the cache is disabled and every lookup misses.
+	void initCache(const std::string& dirname, S64 max_size);
+	bool isEnabled() const						{ return mMaxSize > 0; }
+	// Writes the index if it changed since the last save.
+	bool saveIndex();
+	// Removes every asset.
+	void clear();
+
+	// Returns false if id isn't cached.
+	bool getHeader(const LLUUID& id, Header& header);
+	// Stores the first data_size bytes of asset id, which start with header.
+	// The blobs that are all in them are cached too. Returns false if nothing
+	// was stored.
+	bool writeHeader(const LLUUID& id, const Header& header, const U8* data, S32 data_size);
+	// Returns a new[]'d copy of blob of asset id and sets size, or returns NULL.
+	U8* readBlob(const LLUUID& id, EBlob blob, S32& size);
+	// Stores blob of id, whose header must have been stored, replacing what
+	// was stored of it. Returns false if it wasn't stored.
+	bool writeBlob(const LLUUID& id, EBlob blob, const U8* data, S32 size);
+	void remove(const LLUUID& id);
+
+	// Statistics
+	U32 getHits() const							{ return mHits; }
+	U32 getMisses() const						{ return mMisses; }
+	U32 getEntries();
+	S64 getUsage();
+	S64 getMaxUsage() const						{ return mMaxSize; }
+
+private:
+#if LL_WINDOWS
+	typedef void* file_handle_t;			// HANDLE
+#else
+	typedef int file_handle_t;
+#endif
+	static const file_handle_t INVALID_FILE;
+	typedef std::list<LLUUID> open_list_t;	// Most recently used first.
+
+	// A file open for reading, closed when the last reader lets go of it:
+	// removing an entry doesn't close the file under a read in progress.
+	class OpenFile : public LLThreadSafeRefCount
+	{
+	public:
+		OpenFile(file_handle_t file) : mFile(file) { }
+		file_handle_t mFile;
+	protected:
+		~OpenFile();
+	};
+
+	struct Entry
+	{
+		Entry(const LLUUID& id, const Header& header) : mID(id), mHeader(header), mPresent(0), mSize(0), mSerial(0) { }
+		LLUUID mID;
+		Header mHeader;
+		U32 mPresent;			// Bit per stored blob.
+		S64 mSize;				// Bytes written to the file.
+		U32 mSerial;			// Tells an entry from a later one of the same asset.
+		LLPointer<OpenFile> mFile;	// NULL when not open.
+		open_list_t::iterator mOpenIter;
+	};
+	typedef std::list<Entry> lru_list_t;	// Most recently used first.
+	typedef std::map<LLUUID, lru_list_t::iterator> entry_map_t;
+
+	std::string getFileName(const LLUUID& id) const;
+	std::string getIndexName() const;
+	bool loadIndex();
+
+	// The following functions must be called with mIndexMutex locked.
+	void removeUnlistedFiles();
+	// Finds the entry of id if it is still the one with serial, else returns mEntries.end().
+	entry_map_t::iterator findEntry(const LLUUID& id, U32 serial);
+	void removeEntry(entry_map_t::iterator iter);
+	void evict();
+	void keepOpen(Entry& entry, OpenFile* file);
+	void closeFile(Entry& entry);
+	void closeFiles();
+
+private:
+	std::string mDirName;
+	S64 mMaxSize;
+
+	LLMutex mIndexMutex;
+	lru_list_t mLRU;
+	entry_map_t mEntries;
+	open_list_t mOpenFiles;
+	S64 mUsage;
+	bool mDirty;
+	U32 mNextSerial;
+	std::set<LLUUID> mWriting;	// Assets whose header is being written.
+
+	LLAtomicU32 mHits;
+	LLAtomicU32 mMisses;
+};
+
+#endif // LL_LLMESHCACHE_H
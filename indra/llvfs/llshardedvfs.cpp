@@ -0,0 +1,1456 @@
+/**
+ * @file llshardedvfs.cpp
+ * @brief Implementation of the sharded virtual file system backend
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llshardedvfs.h"
+
+#include <set>
+
+#include "llapr.h"
+#include "llstl.h"
+#include "lltimer.h"
+
+// Shard file layout:
+//
+//   shard header (SHARD_HEADER_SIZE bytes):
+//     U32 magic, U32 version, U32 shard index, U32 shard count
+//   records, back to back:
+//     U32 magic, U32 sequence, U8[16] uuid, S16 type, U16 flags,
+//     S32 size, S32 max size, S32 extent
+//     followed by extent bytes of payload.
+//   zeroes (preallocated, not yet used).
+//
+// The extent is the number of payload bytes reserved in the log and never
+// changes once the record is appended, except when the record is at the
+// end of the log and grows in place.  All other header fields are rewritten
+// in place when the vfile changes; the sequence number is bumped every time
+// so that, after a crash between writing a moved copy and killing the
+// original, replay keeps the newest one.
+//
+// All integers are stored little endian.
+
+const U32 SHARD_MAGIC = 0x53534656;			// "VFSS"
+const U32 SHARD_VERSION = 1;
+const U32 SHARD_HEADER_SIZE = 16;
+const U32 RECORD_MAGIC = 0x52534656;		// "VFSR"
+const U32 RECORD_HEADER_SIZE = 40;
+const U32 RECORD_EXTENT_OFFSET = 36;		// Only written when appending or growing in place.
+const U16 RECORD_DEAD = 0x0001;
+
+const S32 FILE_BLOCK_MASK = 0x000003FF;		// 1024-byte blocks, as LLVFS.
+const S32 BLOCK_LENGTH_INVALID = -1;		// mLength for dummy blocks that only hold locks.
+const U32 SHARD_GROW_SIZE = 1048576;		// Preallocate shard files in 1 MB steps.
+const U32 SHARD_CLEANUP_SIZE = 5242880;		// How much a single LRU pass tries to free up (over all shards).
+const U32 SHARD_MIN_COMPACT_SIZE = 1048576;	// Don't bother compacting less dead space than this.
+
+std::string get_extension(LLAssetType::EType type);	// llvfs.cpp
+
+//============================================================================
+
+static void put_u32(U8* p, U32 v)
+{
+	p[0] = (U8)v;
+	p[1] = (U8)(v >> 8);
+	p[2] = (U8)(v >> 16);
+	p[3] = (U8)(v >> 24);
+}
+
+static void put_u16(U8* p, U16 v)
+{
+	p[0] = (U8)v;
+	p[1] = (U8)(v >> 8);
+}
+
+static U32 get_u32(const U8* p)
+{
+	return (U32)p[0] | ((U32)p[1] << 8) | ((U32)p[2] << 16) | ((U32)p[3] << 24);
+}
+
+static U16 get_u16(const U8* p)
+{
+	return (U16)(p[0] | (p[1] << 8));
+}
+
+// A .tmp file next to a shard is a compaction that didn't finish. The shard
+// itself is only replaced once the copy is complete, so the copy can go;
+// unless the shard is missing (older versions removed it before renaming).
+static void recover_compaction(const std::string& filename)
+{
+	std::string tmp_filename = filename + ".tmp";
+	if (!LLFile::isfile(tmp_filename))
+	{
+		return;
+	}
+	if (LLFile::isfile(filename))
+	{
+		LL_INFOS("VFS") << "Removing unfinished compaction " << tmp_filename << LL_ENDL;
+		LLFile::remove(tmp_filename);
+	}
+	else
+	{
+		LL_INFOS("VFS") << "Recovering " << filename << " from " << tmp_filename << LL_ENDL;
+		LLFile::rename(tmp_filename, filename);
+	}
+}
+
+struct LLShardedVFSBlock_less
+{
+	bool operator()(LLVFSFileBlock* const& lhs, LLVFSFileBlock* const& rhs) const
+	{
+		return (LLVFSFileBlock::insertLRU(lhs, rhs)) ? true : false;
+	}
+};
+
+//============================================================================
+
+class LLShardedVFSCompactThread : public LLThread
+{
+public:
+	LLShardedVFSCompactThread(LLShardedVFS* vfs) : LLThread("VFS Compact"), mVFS(vfs) { }
+
+	// Called with the shard mutex locked.
+	void queueShard(U32 index)
+	{
+		lockData();
+		mPending.push_back(index);
+		wakeLocked();
+		unlockData();
+	}
+
+protected:
+	/*virtual*/ bool runCondition()
+	{
+		// mRunCondition is locked.
+		return !mPending.empty();
+	}
+
+	/*virtual*/ void run()
+	{
+		while (1)
+		{
+			checkPause();
+			if (isQuitting())
+			{
+				break;
+			}
+			lockData();
+			U32 index = mPending.front();
+			mPending.pop_front();
+			unlockData();
+
+			mVFS->compactShard(index);
+		}
+	}
+
+private:
+	LLShardedVFS* mVFS;
+	std::deque<U32> mPending;
+};
+
+//============================================================================
+
+LLShardedVFS::Shard::Shard()
+:	mIndex(0),
+	mFP(NULL),
+	mTail(SHARD_HEADER_SIZE),
+	mFileSize(0),
+	mLiveBytes(0),
+	mSequence(0),
+	mCompactPending(false),
+	mCompacting(false)
+{
+	for (S32 i = 0; i < VFSLOCK_COUNT; i++)
+	{
+		mLockCounts[i] = 0;
+	}
+}
+
+LLShardedVFS::Shard::~Shard()
+{
+	for_each(mFileBlocks.begin(), mFileBlocks.end(), DeletePairedPointer());
+	mFileBlocks.clear();
+	mMapping = NULL;
+	if (mFP)
+	{
+		fclose(mFP);
+		mFP = NULL;
+	}
+}
+
+//============================================================================
+
+// static
+LLVFS* LLShardedVFS::createShardedVFS(const std::string& base_filename, const U32 max_size, const U32 shard_count)
+{
+	LLShardedVFS* new_vfs = new LLShardedVFS(base_filename, max_size, shard_count);
+
+	S32 count = 0;
+	while (!new_vfs->isValid() && count < 256)
+	{	// Append '.<number>' to the base name, same as createLLVFS().
+		delete new_vfs;
+		new_vfs = new LLShardedVFS(base_filename + llformat(".%u", count), max_size, shard_count);
+		count++;
+	}
+
+	if (!new_vfs->isValid())
+	{
+		delete new_vfs;
+		new_vfs = NULL;
+	}
+
+	return new_vfs;
+}
+
+LLShardedVFS::LLShardedVFS(const std::string& base_filename, const U32 max_size, const U32 shard_count)
+:	LLVFS(base_filename, FALSE),
+	mShardBudget(0),
+	mCompactThread(NULL)
+{
+	U32 count = llclamp(shard_count, (U32)1, (U32)256);
+	mShardBudget = max_size / count;
+
+	LL_INFOS("VFS") << "Opening sharded VFS " << base_filename << " with " << count << " shards of "
+					<< mShardBudget / 1024 << " KB" << LL_ENDL;
+
+	for (U32 i = 0; i < count; i++)
+	{
+		Shard* shard = new Shard;
+		shard->mIndex = i;
+		shard->mFilename = base_filename + llformat(".%02u", i);
+		mShards.push_back(shard);
+	}
+
+	for (U32 i = 0; i < count; i++)
+	{
+		LLMutexLock lock(&mShards[i]->mMutex);
+		recover_compaction(mShards[i]->mFilename);
+		if (!openShard(*mShards[i]))
+		{
+			mValid = VFSVALID_BAD_CANNOT_CREATE;
+			return;
+		}
+		replayShard(*mShards[i]);
+	}
+	mValid = VFSVALID_OK;
+
+	mCompactThread = new LLShardedVFSCompactThread(this);
+	mCompactThread->start();
+
+	// Compact whatever was left fragmented by the previous session.
+	for (U32 i = 0; i < count; i++)
+	{
+		LLMutexLock lock(&mShards[i]->mMutex);
+		requestCompaction(*mShards[i]);
+	}
+}
+
+LLShardedVFS::~LLShardedVFS()
+{
+	if (mCompactThread)
+	{
+		mCompactThread->shutdown();
+		delete mCompactThread;
+		mCompactThread = NULL;
+	}
+	for_each(mShards.begin(), mShards.end(), DeletePointer());
+	mShards.clear();
+}
+
+U32 LLShardedVFS::getShardIndex(const LLUUID& file_id) const
+{
+	// Asset ids are random, any byte will do.
+	return (U32)file_id.mData[0] % (U32)mShards.size();
+}
+
+//============================================================================
+// Shard file handling; all of these expect shard.mMutex to be locked.
+//============================================================================
+
+bool LLShardedVFS::openShard(Shard& shard)
+{
+	shard.mFP = openAndLock(shard.mFilename, "r+b", FALSE);
+	if (!shard.mFP)
+	{
+		shard.mFP = openAndLock(shard.mFilename, "w+b", FALSE);
+	}
+	if (!shard.mFP)
+	{
+		LL_WARNS("VFS") << "Can't open VFS shard " << shard.mFilename << LL_ENDL;
+		return false;
+	}
+
+	fseek(shard.mFP, 0, SEEK_END);
+	long size = ftell(shard.mFP);
+	shard.mFileSize = size > 0 ? (U32)size : 0;
+	return true;
+}
+
+void LLShardedVFS::replayShard(Shard& shard)
+{
+	bool valid = false;
+	if (shard.mFileSize >= SHARD_HEADER_SIZE)
+	{
+		U8 header[SHARD_HEADER_SIZE];
+		fseek(shard.mFP, 0, SEEK_SET);
+		valid = fread(header, SHARD_HEADER_SIZE, 1, shard.mFP) == 1 &&
+				get_u32(header) == SHARD_MAGIC &&
+				get_u32(header + 4) == SHARD_VERSION &&
+				get_u32(header + 8) == shard.mIndex &&
+				get_u32(header + 12) == (U32)mShards.size();
+	}
+
+	if (!valid)
+	{
+		// New, foreign or incompatible file; start from scratch.
+		if (shard.mFileSize)
+		{
+			LL_WARNS("VFS") << "Discarding incompatible VFS shard " << shard.mFilename << LL_ENDL;
+		}
+		U8 header[SHARD_HEADER_SIZE];
+		put_u32(header, SHARD_MAGIC);
+		put_u32(header + 4, SHARD_VERSION);
+		put_u32(header + 8, shard.mIndex);
+		put_u32(header + 12, (U32)mShards.size());
+		fclose(shard.mFP);
+		shard.mFP = openAndLock(shard.mFilename, "w+b", FALSE);
+		shard.mFileSize = 0;
+		shard.mTail = SHARD_HEADER_SIZE;
+		if (shard.mFP)
+		{
+			fwrite(header, SHARD_HEADER_SIZE, 1, shard.mFP);
+			growFile(shard, SHARD_HEADER_SIZE);
+		}
+		return;
+	}
+
+	LLPointer<LLVFSMapping> mapping = getMapping(shard, shard.mFileSize);
+	if (mapping.isNull())
+	{
+		return;
+	}
+	const U8* data = mapping->getAddress();
+
+	std::map<LLVFSFileSpecifier, U32> sequences;
+	U32 offset = SHARD_HEADER_SIZE;
+	while (offset + RECORD_HEADER_SIZE <= shard.mFileSize)
+	{
+		const U8* header = data + offset;
+		if (get_u32(header) != RECORD_MAGIC)
+		{
+			break;		// End of the log.
+		}
+		U32 sequence = get_u32(header + 4);
+		LLUUID file_id;
+		memcpy(file_id.mData, header + 8, UUID_BYTES);	/* Flawfinder: ignore */
+		LLAssetType::EType file_type = (LLAssetType::EType)(S16)get_u16(header + 24);
+		U16 flags = get_u16(header + 26);
+		S32 size = (S32)get_u32(header + 28);
+		S32 length = (S32)get_u32(header + 32);
+		S32 extent = (S32)get_u32(header + RECORD_EXTENT_OFFSET);
+
+		if (extent < 0 || length < 0 || length > extent || size < 0 || size > length ||
+			(U64)offset + RECORD_HEADER_SIZE + extent > (U64)shard.mFileSize)
+		{
+			LL_WARNS("VFS") << "Truncating VFS shard " << shard.mFilename << " at corrupt record at " << offset << LL_ENDL;
+			break;
+		}
+
+		shard.mSequence = llmax(shard.mSequence, sequence);
+		if (!(flags & RECORD_DEAD) && length > 0)
+		{
+			LLVFSFileSpecifier spec(file_id, file_type);
+			fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+			LLVFSFileBlock* block = NULL;
+			if (it == shard.mFileBlocks.end())
+			{
+				block = new LLVFSFileBlock(file_id, file_type);
+				shard.mFileBlocks.insert(fileblock_map::value_type(spec, block));
+			}
+			else if (sequences[spec] < sequence)
+			{
+				// Crashed while moving this vfile; this is the newer copy.
+				block = it->second;
+				shard.mLiveBytes -= RECORD_HEADER_SIZE + block->mLength;
+			}
+			if (block)
+			{
+				sequences[spec] = sequence;
+				block->mIndexLocation = offset;
+				block->mLocation = offset + RECORD_HEADER_SIZE;
+				block->mLength = length;
+				block->mSize = size;
+				block->mAccessTime = (U32)time(NULL);
+				shard.mLiveBytes += RECORD_HEADER_SIZE + length;
+			}
+		}
+		offset += RECORD_HEADER_SIZE + extent;
+	}
+	shard.mTail = offset;
+}
+
+void LLShardedVFS::writeHeader(Shard& shard, LLVFSFileBlock* block, U16 flags)
+{
+	U8 header[RECORD_HEADER_SIZE];
+	put_u32(header, RECORD_MAGIC);
+	put_u32(header + 4, ++shard.mSequence);
+	memcpy(header + 8, block->mFileID.mData, UUID_BYTES);	/* Flawfinder: ignore */
+	put_u16(header + 24, (U16)(S16)block->mFileType);
+	put_u16(header + 26, flags);
+	put_u32(header + 28, (U32)block->mSize);
+	put_u32(header + 32, (U32)block->mLength);
+
+	// Leave the extent alone; it describes the layout of the log, not the vfile.
+	touchRecord(shard, block->mIndexLocation);
+	fseek(shard.mFP, block->mIndexLocation, SEEK_SET);
+	if (fwrite(header, RECORD_EXTENT_OFFSET, 1, shard.mFP) != 1)
+	{
+		llwarns << "VFS: Short write to " << shard.mFilename << llendl;
+	}
+	fflush(shard.mFP);
+}
+
+bool LLShardedVFS::appendRecord(Shard& shard, LLVFSFileBlock* block, S32 length)
+{
+	U32 end = shard.mTail + RECORD_HEADER_SIZE + length;
+	if (!growFile(shard, end))
+	{
+		return false;
+	}
+
+	block->mIndexLocation = shard.mTail;
+	block->mLocation = shard.mTail + RECORD_HEADER_SIZE;
+	block->mLength = length;
+	block->mAccessTime = (U32)time(NULL);
+
+	U8 extent[4];
+	put_u32(extent, (U32)length);
+	fseek(shard.mFP, shard.mTail + RECORD_EXTENT_OFFSET, SEEK_SET);
+	if (fwrite(extent, sizeof(extent), 1, shard.mFP) != 1)
+	{
+		llwarns << "VFS: Short write to " << shard.mFilename << llendl;
+	}
+	writeHeader(shard, block);
+
+	shard.mTail = end;
+	shard.mLiveBytes += RECORD_HEADER_SIZE + length;
+	return true;
+}
+
+void LLShardedVFS::killRecord(Shard& shard, LLVFSFileBlock* block)
+{
+	if (block->mLength > 0)
+	{
+		writeHeader(shard, block, RECORD_DEAD);
+		shard.mLiveBytes -= RECORD_HEADER_SIZE + block->mLength;
+	}
+	block->mLocation = 0;
+	block->mSize = 0;
+	block->mLength = BLOCK_LENGTH_INVALID;
+	block->mIndexLocation = -1;
+}
+
+void LLShardedVFS::touchRecord(Shard& shard, S32 index_location)
+{
+	if (shard.mCompacting && index_location >= 0)
+	{
+		shard.mDirty.insert((U32)index_location);
+	}
+}
+
+void LLShardedVFS::dropIfUnused(Shard& shard, LLVFSFileBlock* block)
+{
+	// A removed vfile only keeps its (dummy) block while it is locked.
+	if (block->mLength != BLOCK_LENGTH_INVALID)
+	{
+		return;
+	}
+	for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
+	{
+		if (block->mLocks[i])
+		{
+			return;
+		}
+	}
+	shard.mFileBlocks.erase(LLVFSFileSpecifier(block->mFileID, block->mFileType));
+	delete block;
+}
+
+bool LLShardedVFS::growFile(Shard& shard, U32 size)
+{
+	if (size <= shard.mFileSize)
+	{
+		return true;
+	}
+	U32 new_size = ((size + SHARD_GROW_SIZE - 1) / SHARD_GROW_SIZE) * SHARD_GROW_SIZE;
+	U8 zero = 0;
+	fseek(shard.mFP, new_size - 1, SEEK_SET);
+	if (fwrite(&zero, 1, 1, shard.mFP) != 1)
+	{
+		llwarns << "VFS: Failed to grow " << shard.mFilename << " to " << new_size << " bytes" << llendl;
+		return false;
+	}
+	fflush(shard.mFP);
+	shard.mFileSize = new_size;
+	return true;
+}
+
+LLVFSMapping* LLShardedVFS::getMapping(Shard& shard, U32 end)
+{
+	if (shard.mMapping.isNull() || shard.mMapping->getSize() < end)
+	{
+		// Map the whole (preallocated) file, so that we only remap when it grows.
+		// Readers that still hold the old mapping keep it alive.
+		fflush(shard.mFP);
+		shard.mMapping = new LLVFSMapping(shard.mFP, shard.mFileSize);
+		if (!shard.mMapping->isValid() || shard.mMapping->getSize() < end)
+		{
+			shard.mMapping = NULL;
+		}
+	}
+	return shard.mMapping;
+}
+
+bool LLShardedVFS::makeRoom(Shard& shard, S32 size, LLVFSFileBlock* immune)
+{
+	U32 needed = RECORD_HEADER_SIZE + size;
+	if (needed > mShardBudget)
+	{
+		llwarns << "VFS: vfile of " << size << " bytes doesn't fit in a shard of " << mShardBudget << " bytes" << llendl;
+		return false;
+	}
+	if (shard.mLiveBytes + needed <= mShardBudget)
+	{
+		return true;
+	}
+
+	typedef std::set<LLVFSFileBlock*, LLShardedVFSBlock_less> lru_set;
+	lru_set lru_list;
+	for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+	{
+		LLVFSFileBlock* block = it->second;
+		if (block != immune &&
+			block->mLength > 0 &&
+			!block->mLocks[VFSLOCK_READ] &&
+			!block->mLocks[VFSLOCK_APPEND] &&
+			!block->mLocks[VFSLOCK_OPEN])
+		{
+			lru_list.insert(block);
+		}
+	}
+
+	// Free at least a shard's share of SHARD_CLEANUP_SIZE, so we don't come back here on the next store.
+	U32 target = mShardBudget - llmin(mShardBudget, llmax(needed, SHARD_CLEANUP_SIZE / (U32)mShards.size()));
+	for (lru_set::iterator it = lru_list.begin(); it != lru_list.end() && shard.mLiveBytes > target; ++it)
+	{
+		killRecord(shard, *it);
+		dropIfUnused(shard, *it);
+	}
+
+	if (shard.mLiveBytes + needed > mShardBudget)
+	{
+		llwarns << "VFS: Can't make " << size << " bytes of free space in " << shard.mFilename << ", giving up" << llendl;
+		return false;
+	}
+	return true;
+}
+
+void LLShardedVFS::requestCompaction(Shard& shard)
+{
+	U32 dead = shard.mTail - SHARD_HEADER_SIZE - shard.mLiveBytes;
+	if (!shard.mCompactPending && mCompactThread &&
+		dead > SHARD_MIN_COMPACT_SIZE && dead > shard.mLiveBytes / 2)
+	{
+		shard.mCompactPending = true;
+		mCompactThread->queueShard(shard.mIndex);
+	}
+}
+
+// Copies the record at from in data to to in fp, as the given sequence number
+// with the given extent, along with the first size bytes of its payload.
+static bool copy_record(LLFILE* fp, const U8* data, U32 from, U32 to, U32 sequence, S32 extent, S32 size)
+{
+	U8 header[RECORD_HEADER_SIZE];
+	memcpy(header, data + from, RECORD_HEADER_SIZE);	/* Flawfinder: ignore */
+	put_u32(header + 4, sequence);
+	put_u32(header + RECORD_EXTENT_OFFSET, (U32)extent);
+	return fseek(fp, to, SEEK_SET) == 0 &&
+		   fwrite(header, RECORD_HEADER_SIZE, 1, fp) == 1 &&
+		   (size == 0 || fwrite(data + from + RECORD_HEADER_SIZE, size, 1, fp) == 1);
+}
+
+void LLShardedVFS::compactShard(U32 index)
+{
+	Shard& shard = *mShards[index];
+	LLTimer timer;
+	compact_map records;
+	LLPointer<LLVFSMapping> mapping;
+	U32 old_tail;
+	{
+		LLMutexLock lock(&shard.mMutex);
+		shard.mCompactPending = false;
+		if (shard.mCompacting)
+		{
+			return;
+		}
+#if LL_WINDOWS
+		// Windows won't replace a file that is still mapped by a reader.
+		if (shard.mMapping.notNull() && shard.mMapping->getNumRefs() > 1)
+		{
+			return;
+		}
+#endif
+		old_tail = shard.mTail;
+		mapping = getMapping(shard, shard.mTail);
+		if (mapping.isNull())
+		{
+			return;
+		}
+		for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+		{
+			if (it->second->mLength > 0)
+			{
+				records[it->second->mIndexLocation] = CompactRecord(it->second->mLength, it->second->mSize);
+			}
+		}
+		shard.mCompacting = true;
+	}
+
+	// Copy the shard header and then every live record, in log order,
+	// without the lock. Whatever gets written to meanwhile is marked dirty
+	// and copied again below.
+	std::string tmp_filename = shard.mFilename + ".tmp";
+	LLFILE* fp = LLFile::fopen(tmp_filename, "w+b");	/* Flawfinder: ignore */
+	if (!fp)
+	{
+		llwarns << "VFS: Can't create " << tmp_filename << llendl;
+	}
+	bool ok = fp && fwrite(mapping->getAddress(), SHARD_HEADER_SIZE, 1, fp) == 1;
+	U32 offset = SHARD_HEADER_SIZE;
+	U32 sequence = 0;
+	for (compact_map::iterator it = records.begin(); ok && it != records.end(); ++it)
+	{
+		CompactRecord& record = it->second;
+		record.mTo = offset;
+		record.mSequence = ++sequence;
+		ok = copy_record(fp, mapping->getAddress(), it->first, offset, sequence, record.mExtent, record.mSize);
+		offset += RECORD_HEADER_SIZE + record.mExtent;
+	}
+	mapping = NULL;
+
+	LLMutexLock lock(&shard.mMutex);
+	std::vector<std::pair<LLVFSFileBlock*, U32> > moved;
+	ok = ok && catchUpCompaction(shard, fp, records, offset, sequence, moved);
+	shard.mCompacting = false;
+	shard.mDirty.clear();
+	if (fp)
+	{
+		ok = fflush(fp) == 0 && ok;
+		fclose(fp);
+	}
+
+	if (!ok)
+	{
+		llwarns << "VFS: Failed to compact " << shard.mFilename << llendl;
+		LLFile::remove(tmp_filename);
+		return;
+	}
+#if LL_WINDOWS
+	if (shard.mMapping.notNull() && shard.mMapping->getNumRefs() > 1)
+	{
+		LLFile::remove(tmp_filename);
+		return;
+	}
+#endif
+	if (!replaceShard(shard, tmp_filename))
+	{
+		return;
+	}
+
+	for (std::vector<std::pair<LLVFSFileBlock*, U32> >::iterator it = moved.begin(); it != moved.end(); ++it)
+	{
+		it->first->mIndexLocation = it->second;
+		it->first->mLocation = it->second + RECORD_HEADER_SIZE;
+	}
+	shard.mTail = offset;
+	shard.mSequence = sequence;
+	growFile(shard, offset);
+
+	llinfos << "VFS: Compacted " << shard.mFilename << " from " << old_tail << " to " << offset
+			<< " bytes in " << timer.getElapsedTimeF32() << " seconds" << llendl;
+}
+
+bool LLShardedVFS::catchUpCompaction(Shard& shard, LLFILE* fp, compact_map& records, U32& offset, U32& sequence,
+									 std::vector<std::pair<LLVFSFileBlock*, U32> >& moved)
+{
+	LLPointer<LLVFSMapping> mapping = getMapping(shard, shard.mTail);
+	if (mapping.isNull())
+	{
+		return false;
+	}
+	const U8* data = mapping->getAddress();
+
+	bool ok = true;
+	moved.reserve(shard.mFileBlocks.size());
+	for (fileblock_map::iterator it = shard.mFileBlocks.begin(); ok && it != shard.mFileBlocks.end(); ++it)
+	{
+		LLVFSFileBlock* block = it->second;
+		if (block->mLength <= 0)
+		{
+			continue;
+		}
+		compact_map::iterator rec = records.find(block->mIndexLocation);
+		if (rec != records.end() && block->mLength <= rec->second.mExtent)
+		{
+			// Still in the record we copied; copy it again if it was written to.
+			CompactRecord& record = rec->second;
+			record.mClaimed = true;
+			if (shard.mDirty.count(rec->first))
+			{
+				ok = copy_record(fp, data, rec->first, record.mTo, record.mSequence, record.mExtent, block->mSize);
+			}
+			moved.push_back(std::make_pair(block, record.mTo));
+		}
+		else
+		{
+			// Stored, or grown in place at the end of the log, while we were copying.
+			ok = copy_record(fp, data, block->mIndexLocation, offset, ++sequence, block->mLength, block->mSize);
+			moved.push_back(std::make_pair(block, offset));
+			offset += RECORD_HEADER_SIZE + block->mLength;
+		}
+	}
+
+	// Kill the copies of the records that were killed or moved meanwhile.
+	U8 flags[2];
+	put_u16(flags, RECORD_DEAD);
+	for (compact_map::iterator it = records.begin(); ok && it != records.end(); ++it)
+	{
+		if (!it->second.mClaimed)
+		{
+			ok = fseek(fp, it->second.mTo + 26, SEEK_SET) == 0 && fwrite(flags, sizeof(flags), 1, fp) == 1;
+		}
+	}
+	return ok;
+}
+
+bool LLShardedVFS::replaceShard(Shard& shard, const std::string& tmp_filename)
+{
+	// Swap files. Readers holding the old mapping still see the old data.
+	// Replacing the shard in one step means a crash leaves either the old
+	// or the compacted shard, never neither; see recover_compaction().
+	shard.mMapping = NULL;
+	fclose(shard.mFP);
+	shard.mFP = NULL;
+	if (LLFile::replace(tmp_filename, shard.mFilename) != 0)
+	{
+		// The old shard is untouched; keep using it.
+		llwarns << "VFS: Failed to replace " << shard.mFilename << " after compaction" << llendl;
+		LLFile::remove(tmp_filename);
+		if (!openShard(shard))
+		{
+			mValid = VFSVALID_BAD_CORRUPT;
+		}
+		return false;
+	}
+	if (!openShard(shard))
+	{
+		// We lost the shard; start over with an empty one.
+		llwarns << "VFS: Can't reopen " << shard.mFilename << " after compaction" << llendl;
+		for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+		{
+			it->second->mLength = BLOCK_LENGTH_INVALID;
+			it->second->mSize = 0;
+		}
+		shard.mLiveBytes = 0;
+		if (!openShard(shard))
+		{
+			mValid = VFSVALID_BAD_CORRUPT;
+			return false;
+		}
+		replayShard(shard);
+		return false;
+	}
+	return true;
+}
+
+//============================================================================
+// public
+//============================================================================
+
+BOOL LLShardedVFS::getExists(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	Shard& shard = getShard(file_id);
+	LLMutexLock lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == shard.mFileBlocks.end())
+	{
+		return FALSE;
+	}
+	it->second->mAccessTime = (U32)time(NULL);
+	return it->second->mLength > 0;
+}
+
+S32 LLShardedVFS::getSize(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	Shard& shard = getShard(file_id);
+	LLMutexLock lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == shard.mFileBlocks.end())
+	{
+		return 0;
+	}
+	it->second->mAccessTime = (U32)time(NULL);
+	return it->second->mSize;
+}
+
+BOOL LLShardedVFS::checkAvailable(S32 max_size)
+{
+	// Any vfile that fits in a shard can be stored after evicting old ones.
+	return (U32)max_size + RECORD_HEADER_SIZE <= mShardBudget;
+}
+
+S32 LLShardedVFS::getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	Shard& shard = getShard(file_id);
+	LLMutexLock lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == shard.mFileBlocks.end())
+	{
+		return 0;
+	}
+	it->second->mAccessTime = (U32)time(NULL);
+	return it->second->mLength;
+}
+
+BOOL LLShardedVFS::setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	if (max_size <= 0)
+	{
+		llwarns << "VFS: Attempt to assign size " << max_size << " to vfile " << file_id << llendl;
+		return FALSE;
+	}
+
+	// round all sizes upward to KB increments, except textures (see LLVFS::setMaxSize).
+	if (file_type != LLAssetType::AT_TEXTURE && (max_size & FILE_BLOCK_MASK))
+	{
+		max_size += FILE_BLOCK_MASK;
+		max_size &= ~FILE_BLOCK_MASK;
+	}
+
+	Shard& shard = getShard(file_id);
+	LLMutexLock lock(&shard.mMutex);
+
+	LLVFSFileSpecifier spec(file_id, file_type);
+	LLVFSFileBlock* block = NULL;
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
+	{
+		block = it->second;
+	}
+
+	if (block && block->mLength > 0)
+	{
+		block->mAccessTime = (U32)time(NULL);
+		if (max_size == block->mLength)
+		{
+			return TRUE;
+		}
+		if (max_size < block->mLength)
+		{
+			// this file is shrinking; the tail of its record becomes dead space.
+			shard.mLiveBytes -= block->mLength - max_size;
+			block->mLength = max_size;
+			if (block->mLength < block->mSize)
+			{
+				llerrs << "Truncating virtual file " << file_id << " to " << block->mLength << " bytes" << llendl;
+				block->mSize = block->mLength;
+			}
+			writeHeader(shard, block);
+			requestCompaction(shard);
+			return TRUE;
+		}
+
+		// this file is growing
+		S32 size_increase = max_size - block->mLength;
+		if (!makeRoom(shard, size_increase, block))
+		{
+			return FALSE;
+		}
+		if (block->mLocation + block->mLength == shard.mTail)
+		{
+			// Last record in the log (the usual case while appending): grow in place.
+			if (!growFile(shard, shard.mTail + size_increase))
+			{
+				return FALSE;
+			}
+			U8 extent[4];
+			put_u32(extent, (U32)max_size);
+			fseek(shard.mFP, block->mIndexLocation + RECORD_EXTENT_OFFSET, SEEK_SET);
+			if (fwrite(extent, sizeof(extent), 1, shard.mFP) != 1)
+			{
+				llwarns << "VFS: Short write to " << shard.mFilename << llendl;
+			}
+			block->mLength = max_size;
+			writeHeader(shard, block);
+			shard.mTail += size_increase;
+			shard.mLiveBytes += size_increase;
+			return TRUE;
+		}
+
+		// Move the data to a new record at the end of the log.
+		LLPointer<LLVFSMapping> mapping = getMapping(shard, block->mLocation + block->mSize);
+		if (mapping.isNull())
+		{
+			return FALSE;
+		}
+		LLVFSFileBlock old_block(*block);
+		if (!appendRecord(shard, block, max_size))
+		{
+			return FALSE;
+		}
+		if (old_block.mSize > 0)
+		{
+			fseek(shard.mFP, block->mLocation, SEEK_SET);
+			if (fwrite(mapping->getAddress() + old_block.mLocation, old_block.mSize, 1, shard.mFP) != 1)
+			{
+				llwarns << "VFS: Short write to " << shard.mFilename << llendl;
+			}
+			writeHeader(shard, block);
+		}
+		killRecord(shard, &old_block);
+		requestCompaction(shard);
+		return TRUE;
+	}
+
+	if (!makeRoom(shard, max_size, block))
+	{
+		llwarns << "VFS: No space (" << max_size << ") for new virtual file " << file_id << llendl;
+		return FALSE;
+	}
+	if (!block)
+	{
+		// this file doesn't exist, create it
+		block = new LLVFSFileBlock(file_id, file_type);
+		shard.mFileBlocks.insert(fileblock_map::value_type(spec, block));
+	}
+	block->mSize = 0;
+	return appendRecord(shard, block, max_size);
+}
+
+// As LLVFS::renameFile, the block (and with it its locks) moves to the new name.
+void LLShardedVFS::renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
+							  const LLUUID &new_id, const LLAssetType::EType &new_type)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+
+	U32 src_index = getShardIndex(file_id);
+	U32 dst_index = getShardIndex(new_id);
+	Shard& src = *mShards[src_index];
+	Shard& dst = *mShards[dst_index];
+
+	// Always lock shards in index order.
+	LLMutexLock lock1(&mShards[llmin(src_index, dst_index)]->mMutex);
+	LLMutexLock lock2(src_index == dst_index ? NULL : &mShards[llmax(src_index, dst_index)]->mMutex);
+
+	LLVFSFileSpecifier old_spec(file_id, file_type);
+	LLVFSFileSpecifier new_spec(new_id, new_type);
+
+	fileblock_map::iterator it = src.mFileBlocks.find(old_spec);
+	if (it == src.mFileBlocks.end())
+	{
+		llwarns << "VFS: Attempt to rename nonexistent vfile " << file_id << ":" << file_type << llendl;
+		return;
+	}
+	LLVFSFileBlock* src_block = it->second;
+
+	fileblock_map::iterator new_it = dst.mFileBlocks.find(new_spec);
+	if (new_it != dst.mFileBlocks.end())
+	{
+		LLVFSFileBlock* dest_block = new_it->second;
+		for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
+		{
+			if (dest_block->mLocks[i])
+			{
+				llerrs << "Renaming VFS block to a locked file." << llendl;
+			}
+		}
+		killRecord(dst, dest_block);
+		dst.mFileBlocks.erase(new_it);
+		delete dest_block;
+	}
+
+	src.mFileBlocks.erase(it);
+	if (&src == &dst || src_block->mLength <= 0)
+	{
+		src_block->mFileID = new_id;
+		src_block->mFileType = new_type;
+		if (src_block->mLength > 0)
+		{
+			writeHeader(src, src_block);
+		}
+	}
+	else
+	{
+		// Different shard: copy the record over.
+		LLVFSFileBlock old_block(*src_block);
+		LLPointer<LLVFSMapping> mapping = getMapping(src, old_block.mLocation + old_block.mSize);
+		src_block->mFileID = new_id;
+		src_block->mFileType = new_type;
+		src_block->mSize = old_block.mSize;
+		if (mapping.notNull() && appendRecord(dst, src_block, old_block.mLength))
+		{
+			if (old_block.mSize > 0)
+			{
+				fseek(dst.mFP, src_block->mLocation, SEEK_SET);
+				if (fwrite(mapping->getAddress() + old_block.mLocation, old_block.mSize, 1, dst.mFP) != 1)
+				{
+					llwarns << "VFS: Short write to " << dst.mFilename << llendl;
+				}
+				writeHeader(dst, src_block);
+			}
+		}
+		else
+		{
+			llwarns << "VFS: Failed to move vfile " << file_id << " to " << new_id << llendl;
+			src_block->mLocation = 0;
+			src_block->mSize = 0;
+			src_block->mLength = BLOCK_LENGTH_INVALID;
+			src_block->mIndexLocation = -1;
+		}
+		killRecord(src, &old_block);
+		requestCompaction(src);
+	}
+	if (&src != &dst)
+	{
+		for (S32 i = 0; i < (S32)VFSLOCK_COUNT; i++)
+		{
+			src.mLockCounts[i] -= src_block->mLocks[i];
+			dst.mLockCounts[i] += src_block->mLocks[i];
+		}
+	}
+	src_block->mAccessTime = (U32)time(NULL);
+	dst.mFileBlocks.insert(fileblock_map::value_type(new_spec, src_block));
+	dropIfUnused(dst, src_block);
+}
+
+void LLShardedVFS::removeFile(const LLUUID &file_id, const LLAssetType::EType file_type)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+
+	Shard& shard = getShard(file_id);
+	LLMutexLock lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it != shard.mFileBlocks.end())
+	{
+		// Keep the (now dummy) block around only to preserve locks.
+		killRecord(shard, it->second);
+		dropIfUnused(shard, it->second);
+		requestCompaction(shard);
+	}
+	else
+	{
+		llwarns << "VFS: attempting to remove nonexistent file " << file_id << " type " << file_type << llendl;
+	}
+}
+
+S32 LLShardedVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length)
+{
+	LLVFSDataView view;
+	S32 bytesread = getDataView(file_id, file_type, view, location, length);
+	if (bytesread > 0)
+	{
+		// The copy happens outside of the shard lock.
+		memcpy(buffer, view.getData(), bytesread);	/* Flawfinder: ignore */
+	}
+	return bytesread;
+}
+
+S32 LLShardedVFS::getDataView(const LLUUID &file_id, const LLAssetType::EType file_type, LLVFSDataView& view, S32 location, S32 length)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	llassert(location >= 0);
+	llassert(length >= 0);
+
+	view.reset();
+
+	Shard& shard = getShard(file_id);
+	LLMutexLock lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == shard.mFileBlocks.end() || it->second->mLength <= 0)
+	{
+		return 0;
+	}
+	LLVFSFileBlock* block = it->second;
+	block->mAccessTime = (U32)time(NULL);
+
+	if (location > block->mSize)
+	{
+		llwarns << "VFS: Attempt to read location " << location << " in file " << file_id << " of length " << block->mSize << llendl;
+		return 0;
+	}
+	length = llmin(length, block->mSize - location);
+	if (length <= 0)
+	{
+		return 0;
+	}
+
+	LLVFSMapping* mapping = getMapping(shard, block->mLocation + location + length);
+	if (!mapping)
+	{
+		return 0;
+	}
+	view.set(mapping, mapping->getAddress() + block->mLocation + location, length);
+	return length;
+}
+
+S32 LLShardedVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length)
+{
+	if (!isValid())
+	{
+		llerrs << "Attempting to use invalid VFS!" << llendl;
+	}
+	llassert(length > 0);
+
+	Shard& shard = getShard(file_id);
+	LLMutexLock lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it == shard.mFileBlocks.end())
+	{
+		return 0;
+	}
+	LLVFSFileBlock* block = it->second;
+
+	S32 in_loc = location;
+	if (location == -1)
+	{
+		location = block->mSize;
+	}
+	llassert(location >= 0);
+
+	block->mAccessTime = (U32)time(NULL);
+
+	if (block->mLength == BLOCK_LENGTH_INVALID)
+	{
+		// Block was removed, ignore write
+		llwarns << "VFS: Attempt to write to invalid block"
+				<< " in file " << file_id
+				<< " location: " << in_loc
+				<< " bytes: " << length
+				<< llendl;
+		return length;
+	}
+	if (location > block->mLength)
+	{
+		llwarns << "VFS: Attempt to write to location " << location
+				<< " in file " << file_id
+				<< " type " << S32(file_type)
+				<< " of size " << block->mSize
+				<< " block length " << block->mLength
+				<< llendl;
+		return length;
+	}
+	if (length > block->mLength - location)
+	{
+		llwarns << "VFS: Truncating write to virtual file " << file_id << " type " << S32(file_type) << llendl;
+		length = block->mLength - location;
+	}
+
+	touchRecord(shard, block->mIndexLocation);
+	fseek(shard.mFP, block->mLocation + location, SEEK_SET);
+	S32 write_len = (S32)fwrite(buffer, 1, length, shard.mFP);
+	if (write_len != length)
+	{
+		llwarns << llformat("VFS Write Error: %d != %d", write_len, length) << llendl;
+	}
+
+	if (location + length > block->mSize)
+	{
+		block->mSize = location + write_len;
+		writeHeader(shard, block);		// Also flushes, making the data visible through the mapping.
+	}
+	else
+	{
+		fflush(shard.mFP);
+	}
+	return write_len;
+}
+
+void LLShardedVFS::incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
+{
+	Shard& shard = getShard(file_id);
+	LLMutexLock mutex_lock(&shard.mMutex);
+
+	LLVFSFileSpecifier spec(file_id, file_type);
+	LLVFSFileBlock* block;
+	fileblock_map::iterator it = shard.mFileBlocks.find(spec);
+	if (it != shard.mFileBlocks.end())
+	{
+		block = it->second;
+	}
+	else
+	{
+		// Create a dummy block which isn't saved
+		block = new LLVFSFileBlock(file_id, file_type, 0, BLOCK_LENGTH_INVALID);
+		block->mAccessTime = (U32)time(NULL);
+		shard.mFileBlocks.insert(fileblock_map::value_type(spec, block));
+	}
+
+	block->mLocks[lock]++;
+	shard.mLockCounts[lock]++;
+}
+
+void LLShardedVFS::decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
+{
+	Shard& shard = getShard(file_id);
+	LLMutexLock mutex_lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	if (it != shard.mFileBlocks.end())
+	{
+		LLVFSFileBlock* block = it->second;
+		if (block->mLocks[lock] > 0)
+		{
+			block->mLocks[lock]--;
+		}
+		else
+		{
+			llwarns << "VFS: Decrementing zero-value lock " << lock << llendl;
+		}
+		shard.mLockCounts[lock]--;
+		dropIfUnused(shard, block);
+	}
+}
+
+BOOL LLShardedVFS::isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock)
+{
+	Shard& shard = getShard(file_id);
+	LLMutexLock mutex_lock(&shard.mMutex);
+
+	fileblock_map::iterator it = shard.mFileBlocks.find(LLVFSFileSpecifier(file_id, file_type));
+	return it != shard.mFileBlocks.end() && it->second->mLocks[lock] > 0;
+}
+
+void LLShardedVFS::pokeFiles()
+{
+	// Pull the shards into the page cache by mapping them.
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		LLMutexLock lock(&mShards[i]->mMutex);
+		getMapping(*mShards[i], mShards[i]->mTail);
+	}
+}
+
+void LLShardedVFS::audit()
+{
+	// Replay every shard log from disk and compare it with the in-memory index.
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		Shard& shard = *mShards[i];
+		LLMutexLock lock(&shard.mMutex);
+
+		LLPointer<LLVFSMapping> mapping = getMapping(shard, shard.mTail);
+		if (mapping.isNull())
+		{
+			llwarns << "VFS: audit can't map " << shard.mFilename << llendl;
+			continue;
+		}
+		U32 live = 0;
+		S32 bad = 0;
+		for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+		{
+			LLVFSFileBlock* block = it->second;
+			if (block->mLength <= 0)
+			{
+				continue;
+			}
+			live += RECORD_HEADER_SIZE + block->mLength;
+			const U8* header = mapping->getAddress() + block->mIndexLocation;
+			LLUUID file_id;
+			memcpy(file_id.mData, header + 8, UUID_BYTES);	/* Flawfinder: ignore */
+			if (get_u32(header) != RECORD_MAGIC ||
+				(get_u16(header + 26) & RECORD_DEAD) ||
+				file_id != block->mFileID ||
+				(LLAssetType::EType)(S16)get_u16(header + 24) != block->mFileType ||
+				(S32)get_u32(header + 28) != block->mSize ||
+				(S32)get_u32(header + 32) != block->mLength)
+			{
+				llwarns << "VFS: audit mismatch for " << block->mFileID << ":" << block->mFileType
+						<< " in " << shard.mFilename << llendl;
+				bad++;
+			}
+		}
+		if (live != shard.mLiveBytes)
+		{
+			llwarns << "VFS: audit found " << live << " live bytes in " << shard.mFilename
+					<< ", accounted " << shard.mLiveBytes << llendl;
+			bad++;
+		}
+		llinfos << "VFS: audit of " << shard.mFilename << " " << (bad ? "FAILED" : "passed") << llendl;
+	}
+}
+
+void LLShardedVFS::checkMem()
+{
+	// There are no free lists to check.
+}
+
+void LLShardedVFS::dumpMap()
+{
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		Shard& shard = *mShards[i];
+		LLMutexLock lock(&shard.mMutex);
+		llinfos << "Shard " << shard.mFilename << " tail " << shard.mTail << " file size " << shard.mFileSize << llendl;
+		for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+		{
+			LLVFSFileBlock* block = it->second;
+			llinfos << "Location: " << block->mLocation << "\tLength: " << block->mLength
+					<< "\t" << block->mFileID << "\t" << block->mFileType << llendl;
+		}
+	}
+}
+
+void LLShardedVFS::dumpLockCounts()
+{
+	for (S32 lock = 0; lock < VFSLOCK_COUNT; lock++)
+	{
+		S32 count = 0;
+		for (U32 i = 0; i < mShards.size(); i++)
+		{
+			LLMutexLock mutex_lock(&mShards[i]->mMutex);
+			count += mShards[i]->mLockCounts[lock];
+		}
+		llinfos << "LockType: " << lock << ": " << count << llendl;
+	}
+}
+
+void LLShardedVFS::dumpStatistics()
+{
+	U64 total_live = 0;
+	U64 total_log = 0;
+	S32 total_files = 0;
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		Shard& shard = *mShards[i];
+		LLMutexLock lock(&shard.mMutex);
+		S32 files = 0;
+		for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+		{
+			if (it->second->mLength > 0)
+			{
+				files++;
+			}
+		}
+		llinfos << "Shard " << i << ": " << files << " files, " << shard.mLiveBytes << " live bytes, "
+				<< shard.mTail << " bytes of log, " << shard.mFileSize << " bytes on disk" << llendl;
+		total_files += files;
+		total_live += shard.mLiveBytes;
+		total_log += shard.mTail;
+	}
+	llinfos << "Total: " << total_files << " files, " << total_live << " live bytes, "
+			<< total_log - total_live << " dead bytes, budget " << (U64)mShardBudget * mShards.size() << llendl;
+}
+
+void LLShardedVFS::listFiles()
+{
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		Shard& shard = *mShards[i];
+		LLMutexLock lock(&shard.mMutex);
+		for (fileblock_map::iterator it = shard.mFileBlocks.begin(); it != shard.mFileBlocks.end(); ++it)
+		{
+			LLVFSFileBlock* block = it->second;
+			if (block->mLength != BLOCK_LENGTH_INVALID && block->mSize > 0)
+			{
+				llinfos << " File: " << block->mFileID
+						<< " Type: " << LLAssetType::getDesc(block->mFileType)
+						<< " Size: " << block->mSize
+						<< llendl;
+			}
+		}
+	}
+}
+
+LLVFS::fileblock_map LLShardedVFS::getFileList()
+{
+	fileblock_map file_list;
+	for (U32 i = 0; i < mShards.size(); i++)
+	{
+		LLMutexLock lock(&mShards[i]->mMutex);
+		file_list.insert(mShards[i]->mFileBlocks.begin(), mShards[i]->mFileBlocks.end());
+	}
+	return file_list;
+}
+
+void LLShardedVFS::dumpFiles()
+{
+	S32 files_extracted = 0;
+	fileblock_map file_list = getFileList();
+	for (fileblock_map::iterator it = file_list.begin(); it != file_list.end(); ++it)
+	{
+		LLVFSDataView view;
+		// The blocks in file_list may be gone by now; don't touch them.
+		S32 size = getDataView(it->first.mFileID, it->first.mFileType, view, 0,
+							   getSize(it->first.mFileID, it->first.mFileType));
+		if (size > 0)
+		{
+			std::string filename = it->first.mFileID.asString() + get_extension(it->first.mFileType);
+			llinfos << " Writing " << filename << llendl;
+
+			LLAPRFile outfile(filename, LL_APR_WB);
+			outfile.write(view.getData(), size);
+			outfile.close();
+
+			files_extracted++;
+		}
+	}
+	llinfos << "Extracted " << files_extracted << " files out of " << file_list.size() << llendl;
+}
@@ -0,0 +1,167 @@
+/**
+ * @file llshardedvfs.h
+ * @brief Sharded, append-only, memory-mapped virtual file system backend
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLSHARDEDVFS_H
+#define LL_LLSHARDEDVFS_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include "llvfs.h"
+
+class LLShardedVFSCompactThread;
+
+// Alternative LLVFS backend.
+//
+// Instead of one data file with a free block list behind a single mutex,
+// the store is split in N shards (selected by asset UUID), each with its
+// own mutex and its own data file.  A shard file is an append-only log of
+// records (a small header followed by the reserved payload); the in-memory
+// index of a shard is rebuilt by replaying the log at startup.
+//
+// Removing or growing a vfile only marks the old record dead; a background
+// thread compacts shards whose dead space becomes too large.  Reads are
+// served from a read-only memory mapping of the shard file, so that
+// getDataView() can hand out zero-copy views.
+class LLShardedVFS : public LLVFS
+{
+public:
+	// Use this to open a sharded VFS, shard files are named base_filename.00 .. .NN.
+	// Will append digits to base_filename with multiple re-trys, like createLLVFS().
+	static LLVFS* createShardedVFS(const std::string& base_filename,
+								   const U32 max_size,
+								   const U32 shard_count);
+
+	/*virtual*/ ~LLShardedVFS();
+
+	/*virtual*/ BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
+	/*virtual*/ S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+
+	/*virtual*/ BOOL checkAvailable(S32 max_size);
+
+	/*virtual*/ S32  getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+	/*virtual*/ BOOL setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size);
+
+	/*virtual*/ void renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
+		const LLUUID &new_id, const LLAssetType::EType &new_type);
+	/*virtual*/ void removeFile(const LLUUID &file_id, const LLAssetType::EType file_type);
+
+	/*virtual*/ S32 getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length);
+	/*virtual*/ S32 storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length);
+	/*virtual*/ S32 getDataView(const LLUUID &file_id, const LLAssetType::EType file_type, LLVFSDataView& view, S32 location, S32 length);
+
+	/*virtual*/ void incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	/*virtual*/ void decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	/*virtual*/ BOOL isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+
+	/*virtual*/ void pokeFiles();
+	/*virtual*/ void audit();
+	/*virtual*/ void checkMem();
+	/*virtual*/ void dumpMap();
+	/*virtual*/ void dumpLockCounts();
+	/*virtual*/ void dumpStatistics();
+	/*virtual*/ void listFiles();
+	/*virtual*/ void dumpFiles();
+	/*virtual*/ fileblock_map getFileList();
+
+	// Compact the given shard now, on the calling thread.  The records are
+	// copied without holding the shard lock; only what changed meanwhile is
+	// copied again, with the lock held, before the files are swapped.
+	void compactShard(U32 index);
+
+	U32 getShardCount() const		{ return (U32)mShards.size(); }
+
+private:
+	LLShardedVFS(const std::string& base_filename, const U32 max_size, const U32 shard_count);
+
+	struct Shard
+	{
+		Shard();
+		~Shard();
+
+		LLMutex mMutex;
+		U32 mIndex;
+		LLFILE* mFP;
+		std::string mFilename;
+		fileblock_map mFileBlocks;		// mLocation = payload offset, mIndexLocation = record header offset.
+		LLPointer<LLVFSMapping> mMapping;
+		U32 mTail;						// Offset of the end of the log.
+		U32 mFileSize;					// Size of the file on disk (log plus preallocated zeroes).
+		U32 mLiveBytes;					// Bytes in records that are still referenced.
+		U32 mSequence;					// Last record sequence number handed out.
+		S32 mLockCounts[VFSLOCK_COUNT];
+		bool mCompactPending;
+		bool mCompacting;				// compactShard() is copying the shard without the lock.
+		std::set<U32> mDirty;			// Records (by header offset) written to while compacting.
+	};
+
+	// A live record as copied by compactShard().
+	struct CompactRecord
+	{
+		CompactRecord(S32 extent = 0, S32 size = 0) : mTo(0), mSequence(0), mExtent(extent), mSize(size), mClaimed(false) { }
+
+		U32 mTo;						// Header offset in the compacted shard.
+		U32 mSequence;
+		S32 mExtent;
+		S32 mSize;
+		bool mClaimed;					// Still the record of a live block when swapping.
+	};
+	typedef std::map<U32, CompactRecord> compact_map;	// By header offset in the old shard.
+
+	Shard& getShard(const LLUUID& file_id)	{ return *mShards[getShardIndex(file_id)]; }
+	U32 getShardIndex(const LLUUID& file_id) const;
+
+	// The following functions must be called with shard.mMutex locked.
+	bool openShard(Shard& shard);
+	void replayShard(Shard& shard);
+	void writeHeader(Shard& shard, LLVFSFileBlock* block, U16 flags = 0);
+	bool appendRecord(Shard& shard, LLVFSFileBlock* block, S32 length);
+	void killRecord(Shard& shard, LLVFSFileBlock* block);
+	void touchRecord(Shard& shard, S32 index_location);
+	void dropIfUnused(Shard& shard, LLVFSFileBlock* block);
+	bool growFile(Shard& shard, U32 size);
+	LLVFSMapping* getMapping(Shard& shard, U32 end);
+	bool makeRoom(Shard& shard, S32 size, LLVFSFileBlock* immune);
+	bool catchUpCompaction(Shard& shard, LLFILE* fp, compact_map& records, U32& offset, U32& sequence,
+						   std::vector<std::pair<LLVFSFileBlock*, U32> >& moved);
+	bool replaceShard(Shard& shard, const std::string& tmp_filename);
+	void requestCompaction(Shard& shard);
+
+private:
+	std::vector<Shard*> mShards;
+	U32 mShardBudget;					// Maximum number of live bytes per shard.
+	LLShardedVFSCompactThread* mCompactThread;
+
+	friend class LLShardedVFSCompactThread;
+};
+
+#endif // LL_LLSHARDEDVFS_H
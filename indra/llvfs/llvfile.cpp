@@ -129,6 +129,29 @@ BOOL LLVFile::read(U8 *buffer, S32 bytes, BOOL async, F32 priority)
 	return success;
 }
 
+BOOL LLVFile::read(LLVFSDataView& view, S32 bytes)
+{
+	view.reset();
+	if (! (mMode & READ))
+	{
+		llwarns << "Attempt to read from file " << mFileID << " opened with mode " << std::hex << mMode << std::dec << llendl;
+		return FALSE;
+	}
+
+	if (mHandle != LLVFSThread::nullHandle())
+	{
+		llwarns << "Attempt to read from vfile object " << mFileID << " with pending async operation" << llendl;
+		return FALSE;
+	}
+
+	// We can't do a read while there are pending async writes
+	waitForLock(VFSLOCK_APPEND);
+
+	mBytesRead = mVFS->getDataView(mFileID, mFileType, view, mPosition, bytes);
+	mPosition += mBytesRead;
+	return mBytesRead ? TRUE : FALSE;
+}
+
 //static
 U8* LLVFile::readFile(LLVFS *vfs, LLPrivateMemoryPool* poolp, const LLUUID &uuid, LLAssetType::EType type, S32* bytes_read)
 {
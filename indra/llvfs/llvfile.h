@@ -47,6 +47,9 @@ public:
 	~LLVFile();
 
 	BOOL read(U8 *buffer, S32 bytes, BOOL async = FALSE, F32 priority = 128.f);	/* Flawfinder: ignore */ 
+	// Zero-copy synchronous read. Returns FALSE if nothing was read, which is always
+	// the case when the VFS backend can't map its data; use the buffered read() then.
+	BOOL read(LLVFSDataView& view, S32 bytes);
 	static U8* readFile(LLVFS *vfs, LLPrivateMemoryPool* poolp, const LLUUID &uuid, LLAssetType::EType type, S32* bytes_read = 0);
 	void setReadPriority(const F32 priority);
 	BOOL isReadComplete();
@@ -39,12 +39,16 @@
 #include <map>
 #if LL_WINDOWS
 #include <share.h>
+#include <io.h>
+#include <windows.h>
 #elif LL_SOLARIS
 #include <sys/types.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/mman.h>
 #else
 #include <sys/file.h>
+#include <sys/mman.h>
 #endif
     
 #include "llstl.h"
@@ -215,6 +219,80 @@ struct LLVFSFileBlock_less
 
 
 const S32 LLVFSFileBlock::SERIAL_SIZE = 34;
+
+LLVFSMapping::LLVFSMapping(LLFILE* fp, size_t size, bool writable)
+:	mAddress(NULL),
+	mSize(0),
+	mWritable(writable)
+#if LL_WINDOWS
+	, mMapHandle(NULL)
+#endif
+{
+	if (!fp || !size)
+	{
+		return;
+	}
+#if LL_WINDOWS
+	HANDLE file_handle = (HANDLE)_get_osfhandle(_fileno(fp));
+	mMapHandle = CreateFileMapping(file_handle, NULL, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, NULL);
+	if (mMapHandle)
+	{
+		mAddress = (U8*)MapViewOfFile((HANDLE)mMapHandle, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	}
+#else
+	void* address = ::mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fileno(fp), 0);
+	if (address != MAP_FAILED)
+	{
+		mAddress = (U8*)address;
+	}
+#endif
+	if (mAddress)
+	{
+		mSize = size;
+	}
+	else
+	{
+		llwarns << "VFS: Failed to map " << size << " bytes of data file" << llendl;
+	}
+}
+
+LLVFSMapping::~LLVFSMapping()
+{
+#if LL_WINDOWS
+	if (mAddress)
+	{
+		UnmapViewOfFile(mAddress);
+	}
+	if (mMapHandle)
+	{
+		CloseHandle((HANDLE)mMapHandle);
+	}
+#else
+	if (mAddress)
+	{
+		::munmap(mAddress, mSize);
+	}
+#endif
+}
+
+bool LLVFSMapping::flush(size_t offset, size_t size)
+{
+	if (!mAddress || !mWritable || offset >= mSize)
+	{
+		return false;
+	}
+	if (!size || size > mSize - offset)
+	{
+		size = mSize - offset;
+	}
+#if LL_WINDOWS
+	return FlushViewOfFile(mAddress + offset, size) != 0;
+#else
+	// msync() wants a page aligned start.
+	size_t page_offset = offset & ~(size_t)(sysconf(_SC_PAGESIZE) - 1);
+	return ::msync(mAddress + page_offset, size + offset - page_offset, MS_SYNC) == 0;
+#endif
+}
      
 
 LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename, const BOOL read_only, const U32 presize, const BOOL remove_after_crash)
@@ -546,6 +624,22 @@ LLVFS::LLVFS(const std::string& index_filename, const std::string& data_filename
 	mValid = VFSVALID_OK;
 }
     
+LLVFS::LLVFS(const std::string& data_filename, const BOOL read_only)
+:	mDataFP(NULL),
+	mIndexFP(NULL),
+	mRemoveAfterCrash(FALSE)
+{
+	mDataMutex = new LLMutex;
+
+	for (S32 i = 0; i < VFSLOCK_COUNT; i++)
+	{
+		mLockCounts[i] = 0;
+	}
+	mValid = VFSVALID_UNKNOWN;
+	mReadOnly = read_only;
+	mDataFilename = data_filename;
+}
+    
 LLVFS::~LLVFS()
 {
 	if (mDataMutex->isLocked())
@@ -1103,6 +1197,13 @@ S32 LLVFS::getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8
 	return bytesread;
 }
     
+S32 LLVFS::getDataView(const LLUUID &file_id, const LLAssetType::EType file_type, LLVFSDataView& view, S32 location, S32 length)
+{
+	// The monolithic data file is not mapped; use getData().
+	view.reset();
+	return 0;
+}
+    
 S32 LLVFS::storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length)
 {
 	if (!isValid())
@@ -116,6 +116,54 @@ public:
 };
 //<edit>
 
+// Memory mapping of (the start of) a VFS data file, read-only unless writable is set.
+// Reference counted, so that views handed out to readers stay valid
+// even after the store remapped or compacted the underlying file.
+class LLVFSMapping : public LLThreadSafeRefCount
+{
+public:
+	LLVFSMapping(LLFILE* fp, size_t size, bool writable = false);
+
+	bool isValid() const			{ return mAddress != NULL; }
+	const U8* getAddress() const	{ return mAddress; }
+	size_t getSize() const			{ return mSize; }
+
+	// Writable mappings only.
+	U8* getWritableAddress() const	{ return mWritable ? mAddress : NULL; }
+	// Writes changed pages back to the file. Returns false on failure.
+	bool flush(size_t offset = 0, size_t size = 0);
+
+protected:
+	~LLVFSMapping();
+
+private:
+	U8* mAddress;
+	size_t mSize;
+	bool mWritable;
+#if LL_WINDOWS
+	void* mMapHandle;
+#endif
+};
+
+// A zero-copy window into a vfile, as returned by LLVFS::getDataView().
+class LLVFSDataView
+{
+public:
+	LLVFSDataView() : mData(NULL), mSize(0) { }
+
+	void set(LLVFSMapping* mapping, const U8* data, S32 size) { mMapping = mapping; mData = data; mSize = size; }
+	void reset()					{ mMapping = NULL; mData = NULL; mSize = 0; }
+
+	bool isNull() const				{ return mData == NULL; }
+	const U8* getData() const		{ return mData; }
+	S32 getSize() const				{ return mSize; }
+
+private:
+	LLPointer<LLVFSMapping> mMapping;
+	const U8* mData;
+	S32 mSize;
+};
+
 class LLVFS
 {
 private:
@@ -126,8 +174,11 @@ private:
 		  const BOOL read_only, 
 		  const U32 presize, 
 		  const BOOL remove_after_crash);
+protected:
+	// Used by alternative storage backends (see llshardedvfs.h), does not open any files.
+	LLVFS(const std::string& data_filename, const BOOL read_only);
 public:
-	~LLVFS();
+	virtual ~LLVFS();
 
 	// Use this function normally to create LLVFS files
 	// Pass 0 to not presize
@@ -141,40 +192,45 @@ public:
 	EVFSValid getValidState() const	{ return mValid; }
 
 	// ---------- The following fucntions lock/unlock mDataMutex ----------
-	BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
-	S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual BOOL getExists(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual S32	 getSize(const LLUUID &file_id, const LLAssetType::EType file_type);
 
-	BOOL checkAvailable(S32 max_size);
+	virtual BOOL checkAvailable(S32 max_size);
 	
-	S32  getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type);
-	BOOL setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size);
+	virtual S32  getMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual BOOL setMaxSize(const LLUUID &file_id, const LLAssetType::EType file_type, S32 max_size);
 
-	void renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
+	virtual void renameFile(const LLUUID &file_id, const LLAssetType::EType file_type,
 		const LLUUID &new_id, const LLAssetType::EType &new_type);
-	void removeFile(const LLUUID &file_id, const LLAssetType::EType file_type);
+	virtual void removeFile(const LLUUID &file_id, const LLAssetType::EType file_type);
+
+	virtual S32 getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length);
+	virtual S32 storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length);
 
-	S32 getData(const LLUUID &file_id, const LLAssetType::EType file_type, U8 *buffer, S32 location, S32 length);
-	S32 storeData(const LLUUID &file_id, const LLAssetType::EType file_type, const U8 *buffer, S32 location, S32 length);
+	// Zero-copy read: points view at up to length bytes of the file, starting at location.
+	// Returns the number of bytes in the view; 0 if the file doesn't exist or
+	// this backend can't map its data file (the monolithic one can't).
+	virtual S32 getDataView(const LLUUID &file_id, const LLAssetType::EType file_type, LLVFSDataView& view, S32 location, S32 length);
 
-	void incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
-	void decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
-	BOOL isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual void incLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual void decLock(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
+	virtual BOOL isLocked(const LLUUID &file_id, const LLAssetType::EType file_type, EVFSLock lock);
 	// ----------------------------------------------------------------
 
 	// Used to trigger evil WinXP behavior of "preloading" entire file into memory.
-	void pokeFiles();
+	virtual void pokeFiles();
 
 	// Verify that the index file contents match the in-memory file structure
 	// Very slow, do not call routinely. JC
-	void audit();
+	virtual void audit();
 	// Check for uninitialized blocks.  Slow, do not call in release. JC
-	void checkMem();
+	virtual void checkMem();
 	// for debugging, prints a map of the vfs
-	void dumpMap();
-	void dumpLockCounts();
-	void dumpStatistics();
-	void listFiles();
-	void dumpFiles();
+	virtual void dumpMap();
+	virtual void dumpLockCounts();
+	virtual void dumpStatistics();
+	virtual void listFiles();
+	virtual void dumpFiles();
 
 protected:
 	void removeFileBlock(LLVFSFileBlock *fileblock);
@@ -204,7 +260,7 @@ protected:
 //<edit>
 public:
 	typedef std::map<LLVFSFileSpecifier, LLVFSFileBlock*> fileblock_map;
-	std::map<LLVFSFileSpecifier, LLVFSFileBlock*> getFileList();
+	virtual std::map<LLVFSFileSpecifier, LLVFSFileBlock*> getFileList();
 //</edit>
 protected:
 	fileblock_map mFileBlocks;
@@ -0,0 +1,367 @@
+/**
+ * @file llmeshcache_test.cpp
+ * @brief Tests of the mesh asset cache
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "../llcommon/linden_common.h"
+#include <vector>
+// Class to test
+#include "../llmeshcache.h"
+#include "../llcommon/llfile.h"
+#include "../llcommon/llthread.h"
+#include "../llcommon/lltimer.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	const S32 HEADER_SIZE = 100;
+
+	std::string cache_dir()
+	{
+		return std::string(LLFile::tmpdir()) + "llmeshcache_test";
+	}
+
+	// An asset of HEADER_SIZE bytes of header followed by the blobs, back to
+	// back, with a byte pattern derived from the id.
+	LLMeshCache::Header make_asset(const LLUUID& id, S32 blob_size, std::vector<U8>& asset)
+	{
+		LLMeshCache::Header header;
+		header.mHeaderSize = HEADER_SIZE;
+		header.mVersion = 1;
+		S32 offset = 0;
+		for (S32 blob = 0; blob < LLMeshCache::BLOB_COUNT; ++blob)
+		{
+			header.mOffset[blob] = offset;
+			header.mSize[blob] = blob == LLMeshCache::BLOB_SKIN ? 0 : blob_size + blob;
+			offset += header.mSize[blob];
+		}
+		asset.resize(HEADER_SIZE + offset);
+		for (size_t i = 0; i < asset.size(); ++i)
+		{
+			asset[i] = (U8)(id.mData[i % UUID_BYTES] + i);
+		}
+		return header;
+	}
+
+	bool check_blob(LLMeshCache& cache, const LLUUID& id, const LLMeshCache::Header& header,
+					const std::vector<U8>& asset, S32 blob)
+	{
+		S32 size = 0;
+		U8* data = cache.readBlob(id, (LLMeshCache::EBlob)blob, size);
+		bool success = data && size == header.mSize[blob] &&
+					   !memcmp(data, &asset[HEADER_SIZE + header.mOffset[blob]], size);
+		delete [] data;
+		return success;
+	}
+
+	// Stores all assets and reads them back in its own order, several times.
+	class MeshCacheThread : public LLThread
+	{
+	public:
+		MeshCacheThread(LLMeshCache& cache, const std::vector<LLUUID>& ids, S32 seed)
+		:	LLThread("meshcache test"), mCache(cache), mIDs(ids), mSeed(seed), mSuccess(true) { }
+
+		/*virtual*/ void run()
+		{
+			std::vector<U8> asset;
+			for (S32 pass = 0; pass < 20; ++pass)
+			{
+				for (size_t n = 0; n < mIDs.size(); ++n)
+				{
+					const LLUUID& id = mIDs[(n * 7 + mSeed) % mIDs.size()];
+					LLMeshCache::Header header = make_asset(id, 300, asset);
+					// Only the header request stores the first blobs; the others come one by one.
+					mCache.writeHeader(id, header, &asset[0], HEADER_SIZE + 300);
+					S32 blob = 1 + (pass + mSeed) % (LLMeshCache::BLOB_COUNT - 1);
+					if (header.mSize[blob] > 0)
+					{
+						mCache.writeBlob(id, (LLMeshCache::EBlob)blob, &asset[HEADER_SIZE + header.mOffset[blob]], header.mSize[blob]);
+					}
+					S32 size;
+					for (S32 b = 0; b < LLMeshCache::BLOB_COUNT; ++b)
+					{
+						U8* data = mCache.readBlob(id, (LLMeshCache::EBlob)b, size);
+						if (data)
+						{
+							mSuccess = mSuccess && size == header.mSize[b] &&
+									   !memcmp(data, &asset[HEADER_SIZE + header.mOffset[b]], size);
+							delete [] data;
+						}
+					}
+				}
+			}
+		}
+
+		LLMeshCache& mCache;
+		const std::vector<LLUUID>& mIDs;
+		S32 mSeed;
+		bool mSuccess;
+	};
+}
+
+namespace tut
+{
+	struct meshcache_data
+	{
+		meshcache_data()
+		{
+			LLMeshCache cache;
+			cache.initCache(cache_dir(), 1);
+			cache.clear();
+		}
+		~meshcache_data()
+		{
+			LLMeshCache cache;
+			cache.initCache(cache_dir(), 1);
+			cache.clear();
+			cache.saveIndex();
+		}
+	};
+	typedef test_group<meshcache_data> meshcache_test;
+	typedef meshcache_test::object meshcache_object;
+	tut::meshcache_test meshcache("LLMeshCache");
+
+	// The header fields survive a trip through LLSD.
+	template<> template<>
+	void meshcache_object::test<1>()
+	{
+		LLSD sd;
+		sd["version"] = 3;
+		sd["high_lod"]["offset"] = 10;
+		sd["high_lod"]["size"] = 20;
+		sd["physics_mesh"]["offset"] = 30;
+		sd["physics_mesh"]["size"] = 40;
+		sd["skin"]["offset"] = -1;
+		sd["skin"]["size"] = 5;
+
+		LLMeshCache::Header header;
+		header.fromLLSD(sd, 77);
+		ensure_equals("header size", header.mHeaderSize, 77);
+		ensure_equals("version", header.mVersion, 3);
+		ensure_equals("high offset", header.mOffset[LLMeshCache::BLOB_HIGH_LOD], 10);
+		ensure_equals("high size", header.mSize[LLMeshCache::BLOB_HIGH_LOD], 20);
+		ensure_equals("no low", header.mSize[LLMeshCache::BLOB_LOW_LOD], 0);
+		ensure_equals("bad skin", header.mSize[LLMeshCache::BLOB_SKIN], 0);
+
+		LLSD back = header.asLLSD();
+		ensure_equals("version back", back["version"].asInteger(), 3);
+		ensure_equals("high back", back["high_lod"]["size"].asInteger(), 20);
+		ensure_equals("physics back", back["physics_mesh"]["offset"].asInteger(), 30);
+		ensure("no skin back", !back.has("skin"));
+		ensure_equals("name", std::string(LLMeshCache::getBlobName(LLMeshCache::BLOB_PHYSICS_CONVEX)), "physics_convex");
+	}
+
+	// Only the blobs stored are hits, and they are still there after a restart.
+	template<> template<>
+	void meshcache_object::test<2>()
+	{
+		LLUUID id;
+		id.generate();
+		std::vector<U8> asset;
+		LLMeshCache::Header header = make_asset(id, 1000, asset);
+		{
+			LLMeshCache cache;
+			cache.initCache(cache_dir(), 1024 * 1024);
+			LLMeshCache::Header found;
+			ensure("unknown", !cache.getHeader(id, found));
+
+			// As the header request: the header and the lowest LOD fit in the first bytes.
+			cache.writeHeader(id, header, &asset[0], HEADER_SIZE + 1500);
+			ensure("header", cache.getHeader(id, found));
+			ensure_equals("header offset", found.mOffset[LLMeshCache::BLOB_LOW_LOD], header.mOffset[LLMeshCache::BLOB_LOW_LOD]);
+			ensure("lowest lod", check_blob(cache, id, header, asset, LLMeshCache::BLOB_LOWEST_LOD));
+			S32 size;
+			ensure("partial low lod", !cache.readBlob(id, LLMeshCache::BLOB_LOW_LOD, size));
+			ensure("no skin", !cache.readBlob(id, LLMeshCache::BLOB_SKIN, size));
+
+			S32 high = LLMeshCache::BLOB_HIGH_LOD;
+			cache.writeBlob(id, LLMeshCache::BLOB_HIGH_LOD, &asset[HEADER_SIZE + header.mOffset[high]], header.mSize[high] - 1);
+			ensure("wrong size", !cache.readBlob(id, LLMeshCache::BLOB_HIGH_LOD, size));
+			cache.writeBlob(id, LLMeshCache::BLOB_HIGH_LOD, &asset[HEADER_SIZE + header.mOffset[high]], header.mSize[high]);
+			ensure("high lod", check_blob(cache, id, header, asset, high));
+			ensure("saved", cache.saveIndex());
+		}
+
+		LLMeshCache cache;
+		cache.initCache(cache_dir(), 1024 * 1024);
+		ensure_equals("entries", cache.getEntries(), (U32)1);
+		ensure_equals("usage", cache.getUsage(), (S64)(HEADER_SIZE + 1500 + header.mSize[LLMeshCache::BLOB_HIGH_LOD]));
+		ensure("lowest lod again", check_blob(cache, id, header, asset, LLMeshCache::BLOB_LOWEST_LOD));
+		ensure("high lod again", check_blob(cache, id, header, asset, LLMeshCache::BLOB_HIGH_LOD));
+
+		cache.remove(id);
+		LLMeshCache::Header found;
+		ensure("removed", !cache.getHeader(id, found));
+	}
+
+	// The least recently used assets go first.
+	template<> template<>
+	void meshcache_object::test<3>()
+	{
+		const S32 ASSETS = 8;
+		const S32 ASSET_BYTES = HEADER_SIZE + 500;
+		LLMeshCache cache;
+		cache.initCache(cache_dir(), ASSETS * ASSET_BYTES);
+		std::vector<LLUUID> ids(ASSETS + 2);
+		std::vector<U8> asset;
+		for (S32 i = 0; i < ASSETS + 2; ++i)
+		{
+			ids[i].generate();
+			LLMeshCache::Header header = make_asset(ids[i], 100, asset);
+			cache.writeHeader(ids[i], header, &asset[0], ASSET_BYTES);
+			if (i == ASSETS - 1)
+			{
+				// Makes the first one the most recently used.
+				LLMeshCache::Header found;
+				ensure("first", cache.getHeader(ids[0], found));
+			}
+		}
+		ensure_equals("entries", cache.getEntries(), (U32)ASSETS);
+		ensure("usage", cache.getUsage() <= cache.getMaxUsage());
+		LLMeshCache::Header found;
+		ensure("used kept", cache.getHeader(ids[0], found));
+		ensure("oldest evicted", !cache.getHeader(ids[1], found));
+		ensure("next evicted", !cache.getHeader(ids[2], found));
+		ensure("newest kept", cache.getHeader(ids[ASSETS + 1], found));
+	}
+
+	// A damaged index starts an empty cache.
+	template<> template<>
+	void meshcache_object::test<4>()
+	{
+		LLUUID id;
+		id.generate();
+		std::vector<U8> asset;
+		LLMeshCache::Header header = make_asset(id, 200, asset);
+		{
+			LLMeshCache cache;
+			cache.initCache(cache_dir(), 1024 * 1024);
+			cache.writeHeader(id, header, &asset[0], (S32)asset.size());
+			ensure("saved", cache.saveIndex());
+		}
+
+		std::string index = cache_dir() + "/meshcache.idx";
+		LLFILE* fp = LLFile::fopen(index, "r+b");
+		ensure("index", fp != NULL);
+		fseek(fp, 20, SEEK_SET);
+		fputc(0x55, fp);
+		LLFile::close(fp);
+
+		LLMeshCache cache;
+		cache.initCache(cache_dir(), 1024 * 1024);
+		ensure_equals("empty", cache.getEntries(), (U32)0);
+		S32 size;
+		ensure("miss", !cache.readBlob(id, LLMeshCache::BLOB_LOWEST_LOD, size));
+	}
+
+	// Files the index doesn't list are removed when the cache is opened,
+	// and all of them when the index is lost.
+	template<> template<>
+	void meshcache_object::test<5>()
+	{
+		LLUUID id;
+		id.generate();
+		std::vector<U8> asset;
+		LLMeshCache::Header header = make_asset(id, 200, asset);
+		{
+			LLMeshCache cache;
+			cache.initCache(cache_dir(), 1024 * 1024);
+			cache.writeHeader(id, header, &asset[0], (S32)asset.size());
+			ensure("saved", cache.saveIndex());
+		}
+
+		// As left by a session that crashed before saving its index.
+		LLUUID unlisted;
+		unlisted.generate();
+		std::string listed_file = cache_dir() + "/" + id.asString() + ".mesh";
+		std::string unlisted_file = cache_dir() + "/" + unlisted.asString() + ".mesh";
+		std::string junk_file = cache_dir() + "/junk.mesh";
+		const std::string* files[] = { &unlisted_file, &junk_file };
+		for (S32 i = 0; i < 2; ++i)
+		{
+			LLFILE* fp = LLFile::fopen(*files[i], "wb");
+			ensure("stray file", fp != NULL);
+			fwrite(&asset[0], 1, asset.size(), fp);
+			LLFile::close(fp);
+		}
+
+		{
+			LLMeshCache cache;
+			cache.initCache(cache_dir(), 1024 * 1024);
+			ensure_equals("entries", cache.getEntries(), (U32)1);
+			ensure("listed kept", LLFile::isfile(listed_file));
+			ensure("unlisted removed", !LLFile::isfile(unlisted_file));
+			ensure("junk removed", !LLFile::isfile(junk_file));
+			ensure("still cached", check_blob(cache, id, header, asset, LLMeshCache::BLOB_LOWEST_LOD));
+		}
+
+		LLFile::remove(cache_dir() + "/meshcache.idx");
+		LLMeshCache cache;
+		cache.initCache(cache_dir(), 1024 * 1024);
+		ensure_equals("empty", cache.getEntries(), (U32)0);
+		ensure("lost index", !LLFile::isfile(listed_file));
+	}
+
+	// Reads and writes from several threads at once, some of the same assets.
+	template<> template<>
+	void meshcache_object::test<6>()
+	{
+		const S32 ASSETS = 16;
+		LLMeshCache cache;
+		cache.initCache(cache_dir(), 1024 * 1024);
+		std::vector<LLUUID> ids(ASSETS);
+		for (S32 i = 0; i < ASSETS; ++i)
+		{
+			ids[i].generate();
+		}
+
+		const S32 THREADS = 4;
+		MeshCacheThread* threads[THREADS];
+		for (S32 i = 0; i < THREADS; ++i)
+		{
+			threads[i] = new MeshCacheThread(cache, ids, i);
+			threads[i]->start();
+		}
+		bool success = true;
+		for (S32 i = 0; i < THREADS; ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			success = success && threads[i]->mSuccess;
+			delete threads[i];
+		}
+		ensure("threads", success);
+		ensure_equals("entries", cache.getEntries(), (U32)ASSETS);
+	}
+}
@@ -0,0 +1,412 @@
+/**
+ * @file llshardedvfs_test.cpp
+ * @brief Tests for LLShardedVFS
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "../llcommon/linden_common.h"
+#include <vector>
+// Class to test
+#include "../llshardedvfs.h"
+#include "../llcommon/llthread.h"
+#include "../llcommon/lltimer.h"
+#include "../llcommon/llfile.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	const U32 TEST_VFS_SIZE = 64 * 1024 * 1024;
+	const U32 TEST_SHARDS = 16;
+	const S32 STRESS_FILES_PER_THREAD = 64;
+	const S32 STRESS_OPS_PER_THREAD = 1000;
+
+	// Fill buffer with a pattern derived from the file id, so readers can verify what they get.
+	void fill_pattern(const LLUUID& id, std::vector<U8>& buffer)
+	{
+		for (size_t i = 0; i < buffer.size(); ++i)
+		{
+			buffer[i] = (U8)(id.mData[i % UUID_BYTES] + i);
+		}
+	}
+
+	bool check_pattern(const LLUUID& id, const U8* data, S32 size)
+	{
+		for (S32 i = 0; i < size; ++i)
+		{
+			if (data[i] != (U8)(id.mData[i % UUID_BYTES] + i))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void remove_shards(const std::string& base)
+	{
+		for (U32 i = 0; i < TEST_SHARDS; ++i)
+		{
+			LLFile::remove(base + llformat(".%02u", i));
+			LLFile::remove(base + llformat(".%02u.tmp", i));
+		}
+	}
+
+	// Each thread works on its own set of files, storing, reading back and removing
+	// them at random, like the VFS thread and the main thread do in the viewer.
+	class StressThread : public LLThread
+	{
+	public:
+		StressThread(LLVFS* vfs, S32 seed)
+		:	LLThread("VFS stress"), mVFS(vfs), mSeed(seed), mErrors(0), mDone(false)
+		{
+			for (S32 i = 0; i < STRESS_FILES_PER_THREAD; ++i)
+			{
+				mFiles.push_back(LLUUID::generateNewID());
+			}
+		}
+
+		/*virtual*/ void run()
+		{
+			U32 rand = mSeed;
+			std::vector<U8> buffer;
+			for (S32 op = 0; op < STRESS_OPS_PER_THREAD; ++op)
+			{
+				rand = rand * 1103515245 + 12345;
+				const LLUUID& id = mFiles[(rand >> 8) % mFiles.size()];
+				S32 size = 1024 + (S32)((rand >> 4) % (64 * 1024));
+				switch ((rand >> 24) % 4)
+				{
+				case 0:
+				{
+					buffer.resize(size);
+					fill_pattern(id, buffer);
+					if (mVFS->setMaxSize(id, LLAssetType::AT_SOUND, size))
+					{
+						mVFS->storeData(id, LLAssetType::AT_SOUND, &buffer[0], 0, size);
+					}
+					break;
+				}
+				case 3:
+					if (mVFS->getExists(id, LLAssetType::AT_SOUND))
+					{
+						mVFS->removeFile(id, LLAssetType::AT_SOUND);
+					}
+					break;
+				default:
+				{
+					S32 file_size = mVFS->getSize(id, LLAssetType::AT_SOUND);
+					if (file_size > 0)
+					{
+						buffer.resize(file_size);
+						S32 read = mVFS->getData(id, LLAssetType::AT_SOUND, &buffer[0], 0, file_size);
+						if (read != file_size || !check_pattern(id, &buffer[0], read))
+						{
+							mErrors++;
+						}
+					}
+					break;
+				}
+				}
+			}
+			mDone = true;
+		}
+
+		LLVFS* mVFS;
+		S32 mSeed;
+		std::vector<LLUUID> mFiles;
+		S32 mErrors;
+		volatile bool mDone;
+	};
+}
+
+namespace tut
+{
+	struct shardedvfs_test
+	{
+		std::string mBase;
+
+		shardedvfs_test() : mBase("llshardedvfs_test.db2")
+		{
+			remove_shards(mBase);
+		}
+		~shardedvfs_test()
+		{
+			remove_shards(mBase);
+		}
+	};
+
+	typedef test_group<shardedvfs_test> shardedvfs_t;
+	typedef shardedvfs_t::object shardedvfs_object_t;
+	tut::shardedvfs_t tut_shardedvfs("shardedvfs");
+
+	// Store, read back (copying and zero-copy), rename and remove.
+	template<> template<>
+	void shardedvfs_object_t::test<1>()
+	{
+		LLVFS* vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+		ensure("LLShardedVFS: create failed", vfs != NULL);
+
+		LLUUID id = LLUUID::generateNewID();
+		std::vector<U8> data(5000);
+		fill_pattern(id, data);
+
+		ensure("setMaxSize", vfs->setMaxSize(id, LLAssetType::AT_ANIMATION, 5000));
+		ensure_equals("storeData", vfs->storeData(id, LLAssetType::AT_ANIMATION, &data[0], 0, 5000), 5000);
+		ensure_equals("getSize", vfs->getSize(id, LLAssetType::AT_ANIMATION), 5000);
+
+		std::vector<U8> copy(5000);
+		ensure_equals("getData", vfs->getData(id, LLAssetType::AT_ANIMATION, &copy[0], 0, 5000), 5000);
+		ensure("getData content", copy == data);
+
+		LLVFSDataView view;
+		ensure_equals("getDataView", vfs->getDataView(id, LLAssetType::AT_ANIMATION, view, 1000, 100000), 4000);
+		ensure("getDataView content", !memcmp(view.getData(), &data[1000], 4000));
+
+		// Move to a different shard; the old view must stay valid.
+		LLUUID new_id = id;
+		new_id.mData[0]++;
+		vfs->renameFile(id, LLAssetType::AT_ANIMATION, new_id, LLAssetType::AT_ANIMATION);
+		ensure("rename removes old", !vfs->getExists(id, LLAssetType::AT_ANIMATION));
+		ensure_equals("rename keeps size", vfs->getSize(new_id, LLAssetType::AT_ANIMATION), 5000);
+		ensure("old view still valid", !memcmp(view.getData(), &data[1000], 4000));
+
+		vfs->removeFile(new_id, LLAssetType::AT_ANIMATION);
+		ensure("remove", !vfs->getExists(new_id, LLAssetType::AT_ANIMATION));
+		delete vfs;
+	}
+
+	// The index is rebuilt from the shard logs when reopening.
+	template<> template<>
+	void shardedvfs_object_t::test<2>()
+	{
+		std::vector<LLUUID> ids;
+		{
+			LLVFS* vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+			for (S32 i = 0; i < 100; ++i)
+			{
+				LLUUID id = LLUUID::generateNewID();
+				std::vector<U8> data(100 + i * 37);
+				fill_pattern(id, data);
+				vfs->setMaxSize(id, LLAssetType::AT_SOUND, data.size());
+				vfs->storeData(id, LLAssetType::AT_SOUND, &data[0], 0, data.size());
+				// Grow some of them, so that they are moved.
+				if (i % 3 == 0)
+				{
+					vfs->setMaxSize(id, LLAssetType::AT_SOUND, data.size() * 4);
+				}
+				ids.push_back(id);
+			}
+			// Remove every fifth one.
+			for (S32 i = 0; i < 100; i += 5)
+			{
+				vfs->removeFile(ids[i], LLAssetType::AT_SOUND);
+			}
+			delete vfs;
+		}
+
+		LLVFS* vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+		for (S32 i = 0; i < 100; ++i)
+		{
+			S32 expected = (i % 5 == 0) ? 0 : 100 + i * 37;
+			ensure_equals("replayed size", vfs->getSize(ids[i], LLAssetType::AT_SOUND), expected);
+			if (expected)
+			{
+				std::vector<U8> data(expected);
+				vfs->getData(ids[i], LLAssetType::AT_SOUND, &data[0], 0, expected);
+				ensure("replayed content", check_pattern(ids[i], &data[0], expected));
+			}
+		}
+		delete vfs;
+	}
+
+	// Compaction keeps the data, and a .tmp left by an interrupted compaction is
+	// thrown away, or used when the shard itself is missing.
+	template<> template<>
+	void shardedvfs_object_t::test<3>()
+	{
+		std::vector<LLUUID> ids;
+		LLVFS* vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+		for (S32 i = 0; i < 20; ++i)
+		{
+			LLUUID id = LLUUID::generateNewID();
+			id.mData[0] = (U8)(i % 2);	// Shards 0 and 1.
+			std::vector<U8> data(1000 + i * 100);
+			fill_pattern(id, data);
+			vfs->setMaxSize(id, LLAssetType::AT_SOUND, data.size());
+			vfs->storeData(id, LLAssetType::AT_SOUND, &data[0], 0, data.size());
+			ids.push_back(id);
+		}
+		for (S32 i = 0; i < 20; i += 4)
+		{
+			vfs->removeFile(ids[i], LLAssetType::AT_SOUND);
+		}
+		((LLShardedVFS*)vfs)->compactShard(0);
+		((LLShardedVFS*)vfs)->compactShard(1);
+		delete vfs;
+
+		std::string shard0 = mBase + ".00";
+		std::string shard1 = mBase + ".01";
+		ensure("no .tmp after compaction", !LLFile::isfile(shard0 + ".tmp"));
+		LLFILE* fp = LLFile::fopen(shard0 + ".tmp", "wb");
+		ensure("create stale .tmp", fp != NULL);
+		fputs("half written", fp);
+		LLFile::close(fp);
+		ensure_equals("move shard 1 to .tmp", LLFile::rename(shard1, shard1 + ".tmp"), 0);
+
+		vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+		ensure("stale .tmp removed", !LLFile::isfile(shard0 + ".tmp"));
+		ensure("missing shard recovered from .tmp", LLFile::isfile(shard1) && !LLFile::isfile(shard1 + ".tmp"));
+		for (S32 i = 0; i < 20; ++i)
+		{
+			S32 expected = (i % 4 == 0) ? 0 : 1000 + i * 100;
+			ensure_equals("size after recovery", vfs->getSize(ids[i], LLAssetType::AT_SOUND), expected);
+			if (expected)
+			{
+				std::vector<U8> data(expected);
+				vfs->getData(ids[i], LLAssetType::AT_SOUND, &data[0], 0, expected);
+				ensure("content after recovery", check_pattern(ids[i], &data[0], expected));
+			}
+		}
+		delete vfs;
+	}
+
+	// Removed vfiles only keep a (dummy) block while they are locked.
+	template<> template<>
+	void shardedvfs_object_t::test<4>()
+	{
+		LLVFS* vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+		std::vector<U8> data(1000);
+		for (S32 i = 0; i < 50; ++i)
+		{
+			LLUUID id = LLUUID::generateNewID();
+			vfs->setMaxSize(id, LLAssetType::AT_SOUND, data.size());
+			vfs->storeData(id, LLAssetType::AT_SOUND, &data[0], 0, data.size());
+			vfs->removeFile(id, LLAssetType::AT_SOUND);
+		}
+		ensure_equals("unlocked dummies dropped", vfs->getFileList().size(), (size_t)0);
+
+		LLUUID id = LLUUID::generateNewID();
+		vfs->incLock(id, LLAssetType::AT_SOUND, VFSLOCK_OPEN);
+		vfs->setMaxSize(id, LLAssetType::AT_SOUND, data.size());
+		vfs->removeFile(id, LLAssetType::AT_SOUND);
+		ensure_equals("locked dummy kept", vfs->getFileList().size(), (size_t)1);
+		ensure("lock kept", vfs->isLocked(id, LLAssetType::AT_SOUND, VFSLOCK_OPEN));
+		vfs->decLock(id, LLAssetType::AT_SOUND, VFSLOCK_OPEN);
+		ensure_equals("dummy dropped when unlocked", vfs->getFileList().size(), (size_t)0);
+
+		// Evicted vfiles don't leave dummies behind either.
+		const U32 small_size = TEST_SHARDS * 64 * 1024;
+		delete vfs;
+		remove_shards(mBase);
+		vfs = LLShardedVFS::createShardedVFS(mBase, small_size, TEST_SHARDS);
+		for (S32 i = 0; i < 200; ++i)
+		{
+			LLUUID id = LLUUID::generateNewID();
+			id.mData[0] = 0;
+			vfs->setMaxSize(id, LLAssetType::AT_SOUND, data.size());
+		}
+		ensure("evicted dropped", vfs->getFileList().size() <= 64);
+		delete vfs;
+	}
+
+	// Compaction runs while other threads store, read and remove.
+	template<> template<>
+	void shardedvfs_object_t::test<5>()
+	{
+		LLVFS* vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+		std::vector<StressThread*> threads;
+		for (S32 i = 0; i < 4; ++i)
+		{
+			threads.push_back(new StressThread(vfs, i + 1));
+			threads.back()->start();
+		}
+		bool done = false;
+		while (!done)
+		{
+			for (U32 i = 0; i < TEST_SHARDS; ++i)
+			{
+				((LLShardedVFS*)vfs)->compactShard(i);
+			}
+			done = true;
+			for (size_t i = 0; i < threads.size(); ++i)
+			{
+				done = done && threads[i]->mDone;
+			}
+		}
+		S32 errors = 0;
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			errors += threads[i]->mErrors;
+		}
+		ensure_equals("corrupt reads while compacting", errors, 0);
+
+		std::vector<S32> sizes;
+		for (S32 pass = 0; pass < 2; ++pass)
+		{
+			if (pass)
+			{
+				// And the compacted shards replay to the same.
+				delete vfs;
+				vfs = LLShardedVFS::createShardedVFS(mBase, TEST_VFS_SIZE, TEST_SHARDS);
+			}
+			size_t n = 0;
+			for (size_t i = 0; i < threads.size(); ++i)
+			{
+				for (size_t j = 0; j < threads[i]->mFiles.size(); ++j, ++n)
+				{
+					const LLUUID& id = threads[i]->mFiles[j];
+					S32 size = vfs->getSize(id, LLAssetType::AT_SOUND);
+					if (pass)
+					{
+						ensure_equals("size after reopening", size, sizes[n]);
+					}
+					else
+					{
+						sizes.push_back(size);
+					}
+					if (size > 0)
+					{
+						std::vector<U8> buffer(size);
+						ensure_equals("read", vfs->getData(id, LLAssetType::AT_SOUND, &buffer[0], 0, size), size);
+						ensure("content", check_pattern(id, &buffer[0], size));
+					}
+				}
+			}
+		}
+		for (size_t i = 0; i < threads.size(); ++i)
+		{
+			delete threads[i];
+		}
+		delete vfs;
+	}
+}
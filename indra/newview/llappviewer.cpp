@@ -111,10 +111,14 @@
 #include "llnotify.h"
 #include "llviewerkeyboard.h"
 #include "lllfsthread.h"
+#include "llshardedvfs.h"
 #include "llworkerthread.h"
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
+#include "llimagerawcache.h"
 #include "llimageworker.h"
+#include "llworkerpool.h"
+#include "llskinning.h"
 
 // <edit>
 #include "lldelayeduidelete.h"
@@ -385,6 +389,7 @@ void init_default_trans_args()
 // File scope definitons
 const char *VFS_DATA_FILE_BASE = "data.db2.x.";
 const char *VFS_INDEX_FILE_BASE = "index.db2.x.";
+const char *VFS_SHARD_FILE_BASE = "shard.db2";
 
 static std::string gSecondLife;
 static std::string gWindowTitle;
@@ -549,6 +554,7 @@ const std::string LLAppViewer::sPerAccountSettingsName = "PerAccount";
 const std::string LLAppViewer::sCrashSettingsName = "CrashSettings"; 
 
 LLTextureCache* LLAppViewer::sTextureCache = NULL; 
+LLImageRawCache* LLAppViewer::sTextureRawCache = NULL;
 LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL; 
 LLTextureFetch* LLAppViewer::sTextureFetch = NULL; 
 
@@ -1089,6 +1095,12 @@ bool LLAppViewer::mainLoop()
     // point of posting.
     LLSD newFrame;
 
+	// Record a trace of the fast timers of all threads for the first frames, if asked to.
+	S32 trace_frames = gSavedSettings.getS32("FastTimerTraceFrames");
+	if (trace_frames > 0)
+	{
+		LLFastTimer::startTrace(trace_frames, gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "fast_timers_trace.json"));
+	}
 
 	// Handle messages
 	while (!LLApp::isExiting())
@@ -1280,6 +1292,7 @@ bool LLAppViewer::mainLoop()
 					{
 						LLFastTimer ftm(FTM_TEXTURE_CACHE);
  						work_pending += LLAppViewer::getTextureCache()->update(1); // unpauses the texture cache thread
+						work_pending += LLAppViewer::getTextureRawCache()->update(1);
 					}
 					{
 						LLFastTimer ftm(FTM_DECODE);
@@ -1701,6 +1714,7 @@ bool LLAppViewer::cleanup()
 	{
 		S32 pending = 0;
 		pending += LLAppViewer::getTextureCache()->update(1); // unpauses the worker thread
+		pending += LLAppViewer::getTextureRawCache()->update(1);
 		pending += LLAppViewer::getImageDecodeThread()->update(1); // unpauses the image thread
 		pending += LLAppViewer::getTextureFetch()->update(1); // unpauses the texture fetch thread
 		pending += LLVFSThread::updateClass(0);
@@ -1720,15 +1734,19 @@ bool LLAppViewer::cleanup()
 	// shotdown all worker threads before deleting them in case of co-dependencies
 	sTextureFetch->shutdown();
 	sTextureCache->shutdown();
+	sTextureRawCache->shutdown();
 	sImageDecodeThread->shutdown();
 	sTextureFetch->shutDownTextureCacheThread();
 	sTextureFetch->shutDownImageDecodeThread();
 	delete sTextureCache;
     sTextureCache = NULL;
+	delete sTextureRawCache;
+	sTextureRawCache = NULL;
 	delete sTextureFetch;
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	LLWorkerPool::cleanupClass();
 
 
 	llinfos << "Cleaning up Media and Textures" << llendflush;
@@ -1849,17 +1867,40 @@ bool LLAppViewer::initThreads()
 
 	AICurlInterface::startCurlThread(gSavedSettings.getU32("CurlMaxTotalConcurrentConnections"),
 		                             gSavedSettings.getU32("CurlConcurrentConnectionsPerHost"),
-		                             gSavedSettings.getBOOL("NoVerifySSLCert"));
+		                             gSavedSettings.getBOOL("CurlAdaptiveConcurrencyPerHost"),
+		                             gSavedSettings.getBOOL("NoVerifySSLCert"),
+		                             gSavedSettings.getBOOL("CurlUseEpoll"));
 
 	LLImage::initClass();
 	
 	LLVFSThread::initClass(enable_threads && false);
 	LLLFSThread::initClass(enable_threads && false);
 
+	// Shared worker pool; the texture cache and image decode threads use it instead of a thread of their own.
+	// The JPEG2000 decoder splits each decode in jobs that run on it too ("j2cdecode"),
+	// and so do the object updates ("objectupdate"), the software skinning of rigged
+	// meshes ("skinning") and the avatar morph targets ("morph"), which the main thread waits for.
+	S32 pool_threads = gSavedSettings.getS32("WorkerPoolThreads");
+	LLWorkerPool::initClass(pool_threads < 0 ? LLWorkerPool::getDefaultThreadCount() : pool_threads);
+	if (LLWorkerPool* pool = LLWorkerPool::getInstance())
+	{
+		pool->addSubsystem("TextureCache", LLWorkerPool::PRIORITY_CLASS_HIGH, 1);
+		pool->addSubsystem("imagedecode", LLWorkerPool::PRIORITY_CLASS_NORMAL, pool->getThreadCount());
+		pool->addSubsystem("j2cdecode", LLWorkerPool::PRIORITY_CLASS_HIGH, pool->getThreadCount() * 2);
+		pool->addSubsystem("objectupdate", LLWorkerPool::PRIORITY_CLASS_HIGH, pool->getThreadCount());
+		pool->addSubsystem("objectcache", LLWorkerPool::PRIORITY_CLASS_HIGH, 2);
+		pool->addSubsystem("meshdecode", LLWorkerPool::PRIORITY_CLASS_NORMAL, pool->getThreadCount());
+		pool->addSubsystem("skinning", LLWorkerPool::PRIORITY_CLASS_HIGH, pool->getThreadCount());
+		pool->addSubsystem("morph", LLWorkerPool::PRIORITY_CLASS_HIGH, pool->getThreadCount());
+	}
+	LLSkinning::initClass();
+
 	// Image decoding
+	LLQueuedThread::setDefaultQueueType(gSavedSettings.getBOOL("QueuedThreadLockFreeQueue") ? LLQueuedThread::QUEUE_LOCKFREE : LLQueuedThread::QUEUE_SORTED);
 	LLAppViewer::sImageDecodeThread = new LLImageDecodeThread(enable_threads && true);
 	LLAppViewer::sTextureCache = new LLTextureCache(enable_threads && true);
-	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
+	LLAppViewer::sTextureRawCache = new LLImageRawCache(enable_threads && true);
+	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), LLAppViewer::getTextureRawCache(), sImageDecodeThread, enable_threads && true);
 
 
 	// Mesh streaming and caching
@@ -3274,7 +3315,7 @@ U32 LLAppViewer::getObjectCacheVersion()
 {
 	// Viewer object cache version, change if object update
 	// format changes. JC
-	const U32 INDRA_OBJECT_CACHE_VERSION = 14;
+	const U32 INDRA_OBJECT_CACHE_VERSION = 15;
 
 	return INDRA_OBJECT_CACHE_VERSION;
 }
@@ -3364,7 +3405,20 @@ bool LLAppViewer::initCache()
 	S64 extra = LLAppViewer::getTextureCache()->initCache(LL_PATH_CACHE, texture_cache_size, texture_cache_mismatch);
 	texture_cache_size -= extra;
 
-	LLVOCache::getInstance()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("CacheNumberOfRegionsForObjects"), getObjectCacheVersion()) ;
+	// The decoded texture cache has its own budget, on top of CacheSize.
+	std::string raw_cache_dir = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "rawtextures");
+	if (texture_cache_mismatch && !read_only)
+	{
+		LLAppViewer::getTextureRawCache()->purgeCache(raw_cache_dir);
+	}
+	if (gSavedSettings.getBOOL("TextureRawCacheEnabled") && !read_only)
+	{
+		LLAppViewer::getTextureRawCache()->initCache(raw_cache_dir, (S64)gSavedSettings.getU32("TextureRawCacheSize") * MB,
+													  gSavedSettings.getBOOL("TextureRawCacheCompress"));
+	}
+
+	LLVOCache::getInstance()->initCache(LL_PATH_CACHE, gSavedSettings.getU32("CacheNumberOfRegionsForObjects"), getObjectCacheVersion(),
+										llmin(gSavedSettings.getU32("ObjectCacheSize"), (U32)4095) * MB) ;
 
 	LLSplashScreen::update(LLTrans::getString("StartupInitializingVFS"));
 	
@@ -3488,7 +3542,17 @@ bool LLAppViewer::initCache()
 	gSavedSettings.setU32("VFSSalt", new_salt);
 
 	// Don't remove VFS after viewer crashes.  If user has corrupt data, they can reinstall. JC
-	gVFS = LLVFS::createLLVFS(new_vfs_index_file, new_vfs_data_file, false, vfs_size_u32, false);
+	U32 vfs_shards = gSavedSettings.getU32("VFSShardCount");
+	if (vfs_shards)
+	{
+		// Sharded backend; keeps its own files, independent of the salted data/index pair.
+		gVFS = LLShardedVFS::createShardedVFS(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, VFS_SHARD_FILE_BASE),
+											  vfs_size_u32, vfs_shards);
+	}
+	else
+	{
+		gVFS = LLVFS::createLLVFS(new_vfs_index_file, new_vfs_data_file, false, vfs_size_u32, false);
+	}
 	if (!gVFS)
 	{
 		return false;
@@ -3529,8 +3593,10 @@ void LLAppViewer::purgeCache()
 {
 	LL_INFOS("AppCache") << "Purging Cache and Texture Cache..." << LL_ENDL;
 	LLAppViewer::getTextureCache()->purgeCache(LL_PATH_CACHE);
+	LLAppViewer::getTextureRawCache()->purgeCache(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "rawtextures"));
 	LLVOCache::getInstance()->removeCache(LL_PATH_CACHE);
 	std::string mask = "*.*";
+	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "meshes"), mask);
 	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, ""), mask);
 }
 
@@ -38,6 +38,7 @@
 #include "llviewercontrol.h"	// settings_map_type
 
 class LLTextureCache;
+class LLImageRawCache;
 class LLImageDecodeThread;
 class LLTextureFetch;
 class LLWatchdogTimeout;
@@ -94,6 +95,7 @@ public:
     
 	// Thread accessors
 	static LLTextureCache* getTextureCache() { return sTextureCache; }
+	static LLImageRawCache* getTextureRawCache() { return sTextureRawCache; }
 	static LLImageDecodeThread* getImageDecodeThread() { return sImageDecodeThread; }
 	static LLTextureFetch* getTextureFetch() { return sTextureFetch; }
 
@@ -230,6 +232,7 @@ private:
 
 	// Thread objects.
 	static LLTextureCache* sTextureCache; 
+	static LLImageRawCache* sTextureRawCache;
 	static LLImageDecodeThread* sImageDecodeThread; 
 	static LLTextureFetch* sTextureFetch;
 
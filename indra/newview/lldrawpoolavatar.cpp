@@ -108,7 +108,9 @@ S32 cube_channel = -1;
 static LLFastTimer::DeclareTimer FTM_SHADOW_AVATAR("Avatar Shadow");
 
 LLDrawPoolAvatar::LLDrawPoolAvatar() : 
-	LLFacePool(POOL_AVATAR)	
+	LLFacePool(POOL_AVATAR),
+	mJointPaletteAvatar(NULL),
+	mJointPaletteFrame(0)
 {
 }
 
@@ -1268,6 +1270,7 @@ void LLDrawPoolAvatar::updateRiggedFaceVertexBuffer(LLVOAvatar* avatar, LLFace*
 	LLDrawable* drawable = face->getDrawable();
 
 	U32 data_mask = face->getRiggedVertexBufferDataMask();
+	bool rebuilt = false;
 	
 	if (buffer.isNull() || 
 		buffer->getTypeMask() != data_mask ||
@@ -1326,10 +1329,11 @@ void LLDrawPoolAvatar::updateRiggedFaceVertexBuffer(LLVOAvatar* avatar, LLFace*
 		face->getGeometryVolume(*volume, face->getTEOffset(), mat_vert, mat_normal, offset, true);
 
 		buffer->flush();
+		rebuilt = true;
 	}
 
-	if (sShaderLevel <= 0 && face->mLastSkinTime < avatar->getLastSkinTime())
-	{ //perform software vertex skinning for this face
+	if (sShaderLevel <= 0 && (rebuilt || face->mLastSkinTime < avatar->getLastSkinTime()))
+	{ //queue software vertex skinning for this face, updateRiggedVertexBuffers() does it
 		LLStrider<LLVector3> position;
 		LLStrider<LLVector3> normal;
 
@@ -1345,70 +1349,16 @@ void LLDrawPoolAvatar::updateRiggedFaceVertexBuffer(LLVOAvatar* avatar, LLFace*
 
 		LLVector4a* norm = has_normal ? (LLVector4a*) normal.get() : NULL;
 		
-		//build matrix palette
-		LLMatrix4a mp[64];
-		LLMatrix4* mat = (LLMatrix4*) mp;
+		const LLMatrix4a*& palette = mSkinningPaletteMap[skin];
+		if (!palette)
+		{ //faces of the same mesh share it
+			LLMatrix4a bind_shape_matrix;
+			bind_shape_matrix.loadu(skin->mBindShapeMatrix);
 
-		for (U32 j = 0; j < skin->mJointNames.size(); ++j)
-		{
-			LLJoint* joint = avatar->getJoint(skin->mJointNames[j]);
-			if (joint)
-			{
-				mat[j] = skin->mInvBindMatrix[j];
-				mat[j] *= joint->getWorldMatrix();
-			}
-		}
-
-		LLMatrix4a bind_shape_matrix;
-		bind_shape_matrix.loadu(skin->mBindShapeMatrix);
-
-		for (U32 j = 0; j < (U32)buffer->getNumVerts(); ++j)
-		{
-			LLMatrix4a final_mat;
-			final_mat.clear();
-
-			S32 idx[4];
-
-			LLVector4 wght;
-
-			F32 scale = 0.f;
-			for (U32 k = 0; k < 4; k++)
-			{
-				F32 w = weight[j][k];
-
-				idx[k] = llclamp((S32) floorf(w), 0, 63);
-				wght[k] = w - floorf(w);
-				scale += wght[k];
-			}
-
-			wght *= 1.f/scale;
-
-			for (U32 k = 0; k < 4; k++)
-			{
-				F32 w = wght[k];
-
-				LLMatrix4a src;
-				src.setMul(mp[idx[k]], w);
-
-				final_mat.add(src);
-			}
-
-			
-			LLVector4a& v = vol_face.mPositions[j];
-			LLVector4a t;
-			LLVector4a dst;
-			bind_shape_matrix.affineTransform(v, t);
-			final_mat.affineTransform(t, dst);
-			pos[j] = dst;
-
-			if (norm)
-			{
-				LLVector4a& n = vol_face.mNormals[j];
-				bind_shape_matrix.rotate(n, t);
-				final_mat.rotate(t, dst);
-				norm[j] = dst;
-			}
+			palette = mSkinningBatch.addPalette(bind_shape_matrix, getJointPalette(avatar, skin), skin->mJointNames.size());
 		}
+		mSkinningBatch.add(palette, weight, vol_face.mPositions, vol_face.mNormals, buffer->getNumVerts(), pos, norm);
+		face->mLastSkinTime = gFrameTimeSeconds;
 	}
 
 	if (drawable && (face->getTEOffset() == drawable->getNumFaces()-1))
@@ -1477,22 +1427,12 @@ void LLDrawPoolAvatar::renderRigged(LLVOAvatar* avatar, U32 type, bool glow)
 		{
 			if (sShaderLevel > 0)
 			{ //upload matrix palette to shader
-				LLMatrix4 mat[64];
+				const LLMatrix4a* mat = getJointPalette(avatar, skin);
 
-				for (U32 i = 0; i < skin->mJointNames.size(); ++i)
-				{
-					LLJoint* joint = avatar->getJoint(skin->mJointNames[i]);
-					if (joint)
-					{
-						mat[i] = skin->mInvBindMatrix[i];
-						mat[i] *= joint->getWorldMatrix();
-					}
-				}
-				
 				stop_glerror();
 
 				LLDrawPoolAvatar::sVertexProgram->uniformMatrix4fv("matrixPalette", 
-					skin->mJointNames.size(),
+					llmin((S32) skin->mJointNames.size(), (S32) LLSkinning::MAX_JOINTS),
 					FALSE,
 					(GLfloat*) mat[0].mMatrix);
 				
@@ -1599,6 +1539,47 @@ void LLDrawPoolAvatar::updateRiggedVertexBuffers(LLVOAvatar* avatar)
 			updateRiggedFaceVertexBuffer(avatar, face, skin, volume, vol_face);
 		}
 	}
+
+	//skin all the faces at once, on the worker pool if there are enough vertices
+	mSkinningBatch.run();
+	mSkinningPaletteMap.clear();
+}
+
+const LLMatrix4a* LLDrawPoolAvatar::getJointPalette(LLVOAvatar* avatar, const LLMeshSkinInfo* skin)
+{
+	if (avatar != mJointPaletteAvatar || LLFrameTimer::getFrameCount() != mJointPaletteFrame)
+	{ //joints move every frame
+		mJointPaletteMap.clear();
+		mJointPalettes.clear();
+		mJointPaletteAvatar = avatar;
+		mJointPaletteFrame = LLFrameTimer::getFrameCount();
+	}
+
+	joint_palette_map_t::iterator iter = mJointPaletteMap.find(skin);
+	if (iter != mJointPaletteMap.end())
+	{
+		return iter->second;
+	}
+
+	LLMatrix4a* palette = mJointPalettes.allocate();
+	LLMatrix4* mat = (LLMatrix4*) palette;
+	U32 count = llmin((U32) skin->mJointNames.size(), (U32) LLSkinning::MAX_JOINTS);
+	for (U32 j = 0; j < count; ++j)
+	{
+		LLJoint* joint = avatar->getJoint(skin->mJointNames[j]);
+		if (joint)
+		{
+			mat[j] = skin->mInvBindMatrix[j];
+			mat[j] *= joint->getWorldMatrix();
+		}
+		else
+		{
+			mat[j].setIdentity();
+		}
+	}
+
+	mJointPaletteMap[skin] = palette;
+	return palette;
 }
 
 void LLDrawPoolAvatar::renderRiggedSimple(LLVOAvatar* avatar)
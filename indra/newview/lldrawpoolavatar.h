@@ -34,6 +34,7 @@
 #define LL_LLDRAWPOOLAVATAR_H
 
 #include "lldrawpool.h"
+#include "llskinning.h"
 
 class LLVOAvatar;
 class LLGLSLShader;
@@ -141,6 +142,9 @@ public:
 									  LLVolume* volume,
 									  const LLVolumeFace& vol_face);
 	void updateRiggedVertexBuffers(LLVOAvatar* avatar);
+	// Inverse bind times world matrices of the joints of skin, built once per
+	// frame for all the faces and passes that use it.
+	const LLMatrix4a* getJointPalette(LLVOAvatar* avatar, const LLMeshSkinInfo* skin);
 
 	void renderRigged(LLVOAvatar* avatar, U32 type, bool glow = false);
 	void renderRiggedSimple(LLVOAvatar* avatar);
@@ -205,6 +209,21 @@ public:
 
 	std::vector<LLFace*> mRiggedFace[NUM_RIGGED_PASSES];
 
+private:
+	typedef std::map<const LLMeshSkinInfo*, const LLMatrix4a*> joint_palette_map_t;
+
+	// The faces that updateRiggedVertexBuffers() skins in software, and their
+	// palettes with the bind shape matrix folded in.
+	LLSkinningBatch mSkinningBatch;
+	joint_palette_map_t mSkinningPaletteMap;
+
+	joint_palette_map_t mJointPaletteMap;
+	LLSkinningPalettes mJointPalettes;
+	LLVOAvatar* mJointPaletteAvatar;
+	U32 mJointPaletteFrame;
+
+public:
+
 	/*virtual*/ LLViewerTexture *getDebugTexture();
 	/*virtual*/ LLColor3 getDebugColor() const; // For AGP debug display
 
@@ -3275,7 +3275,9 @@ U32 LLModelPreview::calcResourceCost()
 
 			F32 radius = scale.length()*0.5f*debug_scale;
 
-			streaming_cost += LLMeshRepository::getStreamingCost(ret, radius);
+			LLMeshHeader header;
+			header.fromLLSD(ret, 0);
+			streaming_cost += LLMeshRepository::getStreamingCost(header, radius);
 		}
 	}
 
@@ -0,0 +1,98 @@
+/**
+ * @file llmeshdecodetask.cpp
+ * @brief Decoding of fetched mesh blobs on the worker pool
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "llviewerprecompiledheaders.h"
+
+#include "llmeshdecodetask.h"
+
+#include "lltimer.h"
+
+LLAtomicS32 LLMeshDecodeTask::sQueued(0);
+
+//static
+bool LLMeshDecodeTask::queue(LLMeshDecoder* decoder, LLMeshDecoder::EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+							 U8* data, S32 data_size, S32 cache_offset, S32 cache_size)
+{
+	LLWorkerPool* pool = LLWorkerPool::getInstance();
+	LLWorkerPool::Subsystem* subsystem = pool ? pool->getSubsystem("meshdecode") : NULL;
+	if (!subsystem)
+	{
+		return false;
+	}
+
+	LLMeshDecodeTask* task = new LLMeshDecodeTask(subsystem, decoder, type, mesh_params, lod,
+												  data, data_size, cache_offset, cache_size);
+	if (!pool->submit(task))
+	{	//all workers busy with meshes, the caller decodes it
+		task->mData = NULL;
+		delete task;
+		return false;
+	}
+	return true;
+}
+
+LLMeshDecodeTask::LLMeshDecodeTask(LLWorkerPool::Subsystem* subsystem, LLMeshDecoder* decoder,
+								   LLMeshDecoder::EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+								   U8* data, S32 data_size, S32 cache_offset, S32 cache_size)
+:	LLWorkerPool::Task(subsystem), mDecoder(decoder), mType(type), mMeshParams(mesh_params), mLOD(lod),
+	mData(data), mDataSize(data_size), mCacheOffset(cache_offset), mCacheSize(cache_size),
+	mQueuedTime(totalTime())
+{
+	sQueued++;
+}
+
+LLMeshDecodeTask::~LLMeshDecodeTask()
+{
+	delete [] mData;
+	--sQueued;
+}
+
+bool LLMeshDecodeTask::run()
+{
+	U64 start = totalTime();
+	S32 written = 0;
+	bool success = mDecoder->decode(mType, mMeshParams, mLOD, mData, mDataSize);
+	if (mCacheOffset < 0)
+	{
+		if (!success)
+		{
+			mDecoder->decodeFailed(mType, mMeshParams, mLOD);
+		}
+	}
+	else if (success)
+	{	//good fetch from sim, cache it
+		written = mDecoder->cacheDecoded(mType, mMeshParams, mLOD, mCacheOffset, mData, mCacheSize);
+	}
+	mDecoder->addDecodeStats(written, start - mQueuedTime, totalTime() - start);
+	return false;
+}
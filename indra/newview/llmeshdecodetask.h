@@ -0,0 +1,104 @@
+/**
+ * @file llmeshdecodetask.h
+ * @brief Decoding of fetched mesh blobs on the worker pool
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLMESHDECODETASK_H
+#define LL_LLMESHDECODETASK_H
+
+#include "llatomic.h"
+#include "llvolume.h"
+#include "llworkerpool.h"
+
+// What the "meshdecode" workers of the pool call back; LLMeshRepoThread.
+// All functions are called on a worker.
+class LLMeshDecoder
+{
+public:
+	// What the "meshdecode" workers of the pool decode.
+	enum EDecodeType
+	{
+		DECODE_LOD,
+		DECODE_SKIN,
+		DECODE_DECOMPOSITION,
+		DECODE_PHYSICS_SHAPE
+	};
+
+	virtual ~LLMeshDecoder() { }
+
+	// Returns false if data doesn't decode.
+	virtual bool decode(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size) = 0;
+	// A blob read from the cache didn't decode.
+	virtual void decodeFailed(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod) = 0;
+	// Caches a blob received from the sim that decoded; returns the bytes written.
+	virtual S32 cacheDecoded(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+							 S32 cache_offset, const U8* data, S32 cache_size) = 0;
+	// One blob done; times in microseconds.
+	virtual void addDecodeStats(S32 cache_bytes_written, U64 wait_time, U64 decode_time) = 0;
+};
+
+// One LOD, skin, decomposition or physics shape blob to decode on the worker pool.
+class LLMeshDecodeTask : public LLWorkerPool::Task
+{
+public:
+	// Any thread. Hands a blob to the "meshdecode" workers, which take
+	// ownership of data (new[]'d). Data from the network is cached at
+	// cache_offset once it decoded; data read from the cache
+	// (cache_offset < 0) that doesn't decode is passed to
+	// decoder->decodeFailed(). Returns false, keeping data, when there is no
+	// such subsystem or it is full: decode on the calling thread then.
+	static bool queue(LLMeshDecoder* decoder, LLMeshDecoder::EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+					  U8* data, S32 data_size, S32 cache_offset, S32 cache_size);
+
+	/*virtual*/ ~LLMeshDecodeTask();
+
+	/*virtual*/ bool run();
+
+	// Blobs waiting for a worker or decoding.
+	static LLAtomicS32 sQueued;
+
+private:
+	LLMeshDecodeTask(LLWorkerPool::Subsystem* subsystem, LLMeshDecoder* decoder,
+					 LLMeshDecoder::EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+					 U8* data, S32 data_size, S32 cache_offset, S32 cache_size);
+
+	LLMeshDecoder* mDecoder;
+	LLMeshDecoder::EDecodeType mType;
+	LLVolumeParams mMeshParams;
+	S32 mLOD;
+	U8* mData;
+	S32 mDataSize;
+	S32 mCacheOffset;
+	S32 mCacheSize;
+	U64 mQueuedTime;
+};
+
+#endif // LL_LLMESHDECODETASK_H
@@ -36,6 +36,7 @@
 #include "llbufferstream.h"
 #include "llcallbacklist.h"
 #include "lldatapacker.h"
+#include "lldir.h"
 #include "llfasttimer.h"
 #if MESH_IMPORT
 #include "llfloatermodelpreview.h"
@@ -49,6 +50,7 @@
 #include "llsdutil_math.h"
 #include "llsdserialize.h"
 #include "llthread.h"
+#include "lltimer.h"
 #include "llvfile.h"
 #include "llviewercontrol.h"
 #include "llviewerinventory.h"
@@ -87,6 +89,9 @@ LLMeshRepository gMeshRepo;
 
 const U32 MAX_MESH_REQUESTS_PER_SECOND = 100;
 
+// Seconds between saves of the mesh cache index.
+const F32 MESH_CACHE_SAVE_INTERVAL = 300.f;
+
 // Maximum mesh version to support.  Three least significant digits are reserved for the minor version, 
 // with major version changes indicating a format change that is not backwards compatible and should not
 // be parsed by viewers that don't specifically support that version. For example, if the integer "1" is 
@@ -104,6 +109,11 @@ U32 LLMeshRepository::sLODPending = 0;
 U32 LLMeshRepository::sCacheBytesRead = 0;
 U32 LLMeshRepository::sCacheBytesWritten = 0;
 U32 LLMeshRepository::sPeakKbps = 0;
+U32 LLMeshRepository::sLODFetchCount = 0;
+U64 LLMeshRepository::sLODFetchTime = 0;
+U32 LLMeshRepository::sDecodeCount = 0;
+U64 LLMeshRepository::sDecodeWaitTime = 0;
+U64 LLMeshRepository::sDecodeTime = 0;
 	
 
 const U32 MAX_TEXTURE_UPLOAD_RETRIES = 5;
@@ -117,13 +127,14 @@ std::string make_dump_name(std::string prefix, S32 num)
 void dump_llsd_to_file(const LLSD& content, std::string filename);
 LLSD llsd_from_file(std::string filename);
 
-std::string header_lod[] = 
+// Parameters that only name the mesh, for the blobs that aren't a LOD.
+static LLVolumeParams mesh_id_params(const LLUUID& mesh_id)
 {
-	"lowest_lod",
-	"low_lod",
-	"medium_lod",
-	"high_lod"
-};
+	LLVolumeParams volume_params;
+	volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+	volume_params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
+	return volume_params;
+}
 
 
 //get the number of bytes resident in memory for given volume
@@ -231,6 +242,9 @@ public:
 							  const LLIOPipe::buffer_ptr_t& buffer);
 
 	virtual AIHTTPTimeoutPolicy const& getHTTPTimeoutPolicy(void) const { return meshHeaderResponder_timeout; }
+
+	// Headers are small and every other request for the mesh waits for them.
+	virtual U32 getPerHostPriority(void) const { return 1; }
 };
 
 class LLMeshLODResponder : public LLHTTPClient::ResponderWithCompleted
@@ -240,9 +254,11 @@ public:
 	S32 mLOD;
 	U32 mRequestedBytes;
 	U32 mOffset;
+	U64 mStartTime;
 
 	LLMeshLODResponder(const LLVolumeParams& mesh_params, S32 lod, U32 offset, U32 requested_bytes)
-		: mMeshParams(mesh_params), mLOD(lod), mOffset(offset), mRequestedBytes(requested_bytes)
+		: mMeshParams(mesh_params), mLOD(lod), mOffset(offset), mRequestedBytes(requested_bytes),
+		  mStartTime(totalTime())
 	{
 		LLMeshRepoThread::sActiveLODRequests++;
 	}
@@ -522,6 +538,14 @@ void LLMeshRepoThread::run()
 				count = 0;	
 			}
 
+			static F32 last_cache_save = gFrameTimeSeconds;
+
+			if (gFrameTimeSeconds - last_cache_save > MESH_CACHE_SAVE_INTERVAL)
+			{	//assets cached since the last save are forgotten if the viewer crashes
+				last_cache_save = gFrameTimeSeconds;
+				mCache.saveIndex();
+			}
+
 			// NOTE: throttling intentionally favors LOD requests over header requests
 
 			while (!mLODReqQ.empty() && count < MAX_MESH_REQUESTS_PER_SECOND && sActiveLODRequests < (S32)sMaxConcurrentRequests)
@@ -674,8 +698,13 @@ void LLMeshRepoThread::loadMeshPhysicsShape(const LLUUID& mesh_id)
 void LLMeshRepoThread::loadMeshLOD(const LLVolumeParams& mesh_params, S32 lod)
 { //protected by mSignal, no locking needed here
 
-	mesh_header_map::iterator iter = mMeshHeader.find(mesh_params.getSculptID());
-	if (iter != mMeshHeader.end())
+	bool have_header;
+	{	//the repo thread may be rehashing the header map
+		LLMutexLock lock(mHeaderMutex);
+		have_header = mMeshHeader.count(mesh_params.getSculptID()) > 0;
+	}
+
+	if (have_header)
 	{ //if we have the header, request LOD byte range
 		LODRequest req(mesh_params, lod);
 		{
@@ -731,54 +760,45 @@ bool LLMeshRepoThread::fetchMeshSkinInfo(const LLUUID& mesh_id)
 {	//protected by mMutex
 	mHeaderMutex->lock();
 
-	if (mMeshHeader.find(mesh_id) == mMeshHeader.end())
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+	if (iter == mMeshHeader.end())
 	{
 		// We have no header info for this mesh, try again later.
 		mHeaderMutex->unlock();
 		return false;
 	}
 
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	const LLMeshHeader& header = iter->second;
+	U32 header_size = header.mHeaderSize;
 	
 	if (header_size > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id]["skin"]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id]["skin"]["size"].asInteger();
+		S32 version = header.mVersion;
+		S32 offset = header_size + header.mOffset[LLMeshCache::BLOB_SKIN];
+		S32 size = header.mSize[LLMeshCache::BLOB_SKIN];
 
 		mHeaderMutex->unlock();
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh skin info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
-			{
-				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
-				{
-					zero = buffer[i] > 0 ? false : true;
+			//check the cache for mesh skin info
+			U8* buffer = readCachedBlob(mesh_id, LLMeshCache::BLOB_SKIN, offset, size);
+			if (buffer)
+			{	//attempt to parse
+				if (queueDecode(DECODE_SKIN, mesh_id_params(mesh_id), 0, buffer, size))
+				{	//the decode workers own buffer now
+					return true;
 				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (skinInfoReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				if (skinInfoReceived(mesh_id, buffer, size))
+				{
+					delete[] buffer;
+					return true;
 				}
 
 				delete[] buffer;
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from the cache failed for whatever reason, fetch from sim
 			AIHTTPHeaders headers("Accept", "application/octet-stream");
 
 			std::string http_url = constructUrl(mesh_id);
@@ -804,54 +824,45 @@ bool LLMeshRepoThread::fetchMeshDecomposition(const LLUUID& mesh_id)
 {	//protected by mMutex
 	mHeaderMutex->lock();
 
-	if (mMeshHeader.find(mesh_id) == mMeshHeader.end())
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+	if (iter == mMeshHeader.end())
 	{
 		// We have no header info for this mesh, try again later.
 		mHeaderMutex->unlock();
 		return false;
 	}
 
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	const LLMeshHeader& header = iter->second;
+	U32 header_size = header.mHeaderSize;
 	
 	if (header_size > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id]["physics_convex"]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id]["physics_convex"]["size"].asInteger();
+		S32 version = header.mVersion;
+		S32 offset = header_size + header.mOffset[LLMeshCache::BLOB_PHYSICS_CONVEX];
+		S32 size = header.mSize[LLMeshCache::BLOB_PHYSICS_CONVEX];
 
 		mHeaderMutex->unlock();
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh skin info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
-			{
-				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
-				{
-					zero = buffer[i] > 0 ? false : true;
+			//check the cache for mesh decomposition
+			U8* buffer = readCachedBlob(mesh_id, LLMeshCache::BLOB_PHYSICS_CONVEX, offset, size);
+			if (buffer)
+			{	//attempt to parse
+				if (queueDecode(DECODE_DECOMPOSITION, mesh_id_params(mesh_id), 0, buffer, size))
+				{	//the decode workers own buffer now
+					return true;
 				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (decompositionReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				if (decompositionReceived(mesh_id, buffer, size))
+				{
+					delete[] buffer;
+					return true;
 				}
 
 				delete[] buffer;
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from the cache failed for whatever reason, fetch from sim
 			AIHTTPHeaders headers("Accept", "application/octet-stream");
 
 			std::string http_url = constructUrl(mesh_id);
@@ -878,54 +889,45 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 {	//protected by mMutex
 	mHeaderMutex->lock();
 
-	if (mMeshHeader.find(mesh_id) == mMeshHeader.end())
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+	if (iter == mMeshHeader.end())
 	{
 		// We have no header info for this mesh, retry later.
 		mHeaderMutex->unlock();
 		return false;
 	}
 
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	const LLMeshHeader& header = iter->second;
+	U32 header_size = header.mHeaderSize;
 
 	if (header_size > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id]["physics_mesh"]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id]["physics_mesh"]["size"].asInteger();
+		S32 version = header.mVersion;
+		S32 offset = header_size + header.mOffset[LLMeshCache::BLOB_PHYSICS_MESH];
+		S32 size = header.mSize[LLMeshCache::BLOB_PHYSICS_MESH];
 
 		mHeaderMutex->unlock();
 
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
-			//check VFS for mesh physics shape info
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
-			{
-				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
-				{
-					zero = buffer[i] > 0 ? false : true;
+			//check the cache for mesh physics shape info
+			U8* buffer = readCachedBlob(mesh_id, LLMeshCache::BLOB_PHYSICS_MESH, offset, size);
+			if (buffer)
+			{	//attempt to parse
+				if (queueDecode(DECODE_PHYSICS_SHAPE, mesh_id_params(mesh_id), 0, buffer, size))
+				{	//the decode workers own buffer now
+					return true;
 				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (physicsShapeReceived(mesh_id, buffer, size))
-					{
-						delete[] buffer;
-						return true;
-					}
+				if (physicsShapeReceived(mesh_id, buffer, size))
+				{
+					delete[] buffer;
+					return true;
 				}
 
 				delete[] buffer;
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from the cache failed for whatever reason, fetch from sim
 			AIHTTPHeaders headers("Accept", "application/octet-stream");
 
 			std::string http_url = constructUrl(mesh_id);
@@ -954,6 +956,16 @@ bool LLMeshRepoThread::fetchMeshPhysicsShape(const LLUUID& mesh_id)
 //return false if failed to get header
 bool LLMeshRepoThread::fetchMeshHeader(const LLVolumeParams& mesh_params, U32& count)
 {
+	if (mCache.isEnabled())
+	{	//the cache keeps the headers of its assets in memory
+		LLMeshHeader header;
+		if (mCache.getHeader(mesh_params.getSculptID(), header))
+		{
+			setMeshHeader(mesh_params, header);
+			return true;
+		}
+	}
+	else
 	{
 		//look for mesh in asset in vfs
 		LLVFile file(gVFS, mesh_params.getSculptID(), LLAssetType::AT_MESH);
@@ -998,47 +1010,38 @@ void LLMeshRepoThread::fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod,
 
 	LLUUID mesh_id = mesh_params.getSculptID();
 	
-	U32 header_size = mMeshHeaderSize[mesh_id];
+	mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
+	U32 header_size = iter != mMeshHeader.end() ? iter->second.mHeaderSize : 0;
 
 	if (header_size > 0)
 	{
-		S32 version = mMeshHeader[mesh_id]["version"].asInteger();
-		S32 offset = header_size + mMeshHeader[mesh_id][header_lod[lod]]["offset"].asInteger();
-		S32 size = mMeshHeader[mesh_id][header_lod[lod]]["size"].asInteger();
+		const LLMeshHeader& header = iter->second;
+		S32 version = header.mVersion;
+		S32 offset = header_size + header.mOffset[lod];
+		S32 size = header.mSize[lod];
 		mHeaderMutex->unlock();
 				
 		if (version <= MAX_MESH_VERSION && offset >= 0 && size > 0)
 		{
 
-			//check VFS for mesh asset
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
-			if (file.getSize() >= offset+size)
-			{
-				LLMeshRepository::sCacheBytesRead += size;
-				file.seek(offset);
-				U8* buffer = new U8[size];
-				file.read(buffer, size);
-
-				//make sure buffer isn't all 0's (reserved block but not written)
-				bool zero = true;
-				for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
-				{
-					zero = buffer[i] > 0 ? false : true;
+			//check the cache for mesh asset
+			U8* buffer = readCachedBlob(mesh_id, (LLMeshCache::EBlob)lod, offset, size);
+			if (buffer)
+			{	//attempt to parse
+				if (queueDecode(DECODE_LOD, mesh_params, lod, buffer, size))
+				{	//the decode workers own buffer now
+					return;
 				}
-
-				if (!zero)
-				{	//attempt to parse
-					if (lodReceived(mesh_params, lod, buffer, size))
-					{
-						delete[] buffer;
-						return;
-					}
+				if (lodReceived(mesh_params, lod, buffer, size))
+				{
+					delete[] buffer;
+					return;
 				}
 
 				delete[] buffer;
 			}
 
-			//reading from VFS failed for whatever reason, fetch from sim
+			//reading from the cache failed for whatever reason, fetch from sim
 			AIHTTPHeaders headers("Accept", "application/octet-stream");
 
 			std::string http_url = constructUrl(mesh_id);
@@ -1073,26 +1076,25 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 	U32 header_size = 0;
 	if (data_size > 0)
 	{
-		std::string res_str((char*) data, data_size);
+		static const std::string deprecated_header("<? LLSD/Binary ?>");
 
-		std::string deprecated_header("<? LLSD/Binary ?>");
-
-		if (res_str.substr(0, deprecated_header.size()) == deprecated_header)
+		if ((U32)data_size > deprecated_header.size() &&
+			!memcmp(data, deprecated_header.data(), deprecated_header.size()))
 		{
-			res_str = res_str.substr(deprecated_header.size()+1, data_size);
 			header_size = deprecated_header.size()+1;
 		}
-		data_size = res_str.size();
-
-		std::istringstream stream(res_str);
 
-		if (!LLSDSerialize::fromBinary(header, stream, data_size))
+		// Only the blob table is kept, so parse into one arena that goes away with header.
+		LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+		parser->setCompact(true);
+		S32 bytes_read = 0;
+		if (!parser->parse(data + header_size, data_size - header_size, header, &bytes_read))
 		{
 			llwarns << "Mesh header parse error.  Not a valid mesh asset!" << llendl;
 			return false;
 		}
 
-		header_size += stream.tellg();
+		header_size += bytes_read;
 	}
 	else
 	{
@@ -1101,12 +1103,19 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 		header["404"] = 1;
 	}
 
+	LLMeshHeader mesh_header;
+	mesh_header.fromLLSD(header, header_size);
+	setMeshHeader(mesh_params, mesh_header);
+	return true;
+}
+
+void LLMeshRepoThread::setMeshHeader(const LLVolumeParams& mesh_params, const LLMeshHeader& header)
+{
 	{
 		LLUUID mesh_id = mesh_params.getSculptID();
 		
 		{
 			LLMutexLock lock(mHeaderMutex);
-			mMeshHeaderSize[mesh_id] = header_size;
 			mMeshHeader[mesh_id] = header;
 		}
 
@@ -1129,17 +1138,12 @@ bool LLMeshRepoThread::headerReceived(const LLVolumeParams& mesh_params, U8* dat
 		}
 		//		mPendingLOD.erase(iter); // <FS:ND/> avoid crash by moving erase up.
 	}
-
-	return true;
 }
 
 bool LLMeshRepoThread::lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
 {
 	LLPointer<LLVolume> volume = new LLVolume(mesh_params, LLVolumeLODGroup::getVolumeScaleFromDetail(lod));
-	std::string mesh_string((char*) data, data_size);
-	std::istringstream stream(mesh_string);
-
-	if (volume->unpackVolumeFaces(stream, data_size))
+	if (volume->unpackVolumeFaces(data, data_size))
 	{
 		if (volume->getNumFaces() > 0)
 		{
@@ -1161,11 +1165,7 @@ bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 dat
 
 	if (data_size > 0)
 	{
-		std::string res_str((char*) data, data_size);
-
-		std::istringstream stream(res_str);
-
-		if (!unzip_llsd(skin, stream, data_size))
+		if (!unzip_llsd(skin, data, data_size))
 		{
 			llwarns << "Mesh skin info parse error.  Not a valid mesh asset!" << llendl;
 			return false;
@@ -1177,6 +1177,7 @@ bool LLMeshRepoThread::skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 dat
 		info.mMeshID = mesh_id;
 
 		//llinfos<<"info pelvis offset"<<info.mPelvisOffset<<llendl;
+		LLMutexLock lock(mMutex);
 		mSkinInfoQ.push(info);
 	}
 
@@ -1189,11 +1190,7 @@ bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, U8* data, S3
 
 	if (data_size > 0)
 	{ 
-		std::string res_str((char*) data, data_size);
-
-		std::istringstream stream(res_str);
-
-		if (!unzip_llsd(decomp, stream, data_size))
+		if (!unzip_llsd(decomp, data, data_size))
 		{
 			llwarns << "Mesh decomposition parse error.  Not a valid mesh asset!" << llendl;
 			return false;
@@ -1203,6 +1200,7 @@ bool LLMeshRepoThread::decompositionReceived(const LLUUID& mesh_id, U8* data, S3
 	{
 		LLModel::Decomposition* d = new LLModel::Decomposition(decomp);
 		d->mMeshID = mesh_id;
+		LLMutexLock lock(mMutex);
 		mDecompositionQ.push(d);
 	}
 
@@ -1222,14 +1220,8 @@ bool LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32
 	}
 	else
 	{
-		LLVolumeParams volume_params;
-		volume_params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
-		volume_params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
-		LLPointer<LLVolume> volume = new LLVolume(volume_params,0);
-		std::string mesh_string((char*) data, data_size);
-		std::istringstream stream(mesh_string);
-
-		if (volume->unpackVolumeFaces(stream, data_size))
+		LLPointer<LLVolume> volume = new LLVolume(mesh_id_params(mesh_id),0);
+		if (volume->unpackVolumeFaces(data, data_size))
 		{
 			//load volume faces into decomposition buffer
 			S32 vertex_count = 0;
@@ -1262,10 +1254,224 @@ bool LLMeshRepoThread::physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32
 		}
 	}
 
+	LLMutexLock lock(mMutex);
 	mDecompositionQ.push(d);
 	return true;
 }
 
+bool LLMeshRepoThread::queueDecode(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+								   U8* data, S32 data_size, S32 cache_offset, S32 cache_size)
+{
+	return LLMeshDecodeTask::queue(this, type, mesh_params, lod, data, data_size, cache_offset, cache_size);
+}
+
+bool LLMeshRepoThread::decode(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
+{
+	switch (type)
+	{
+	case DECODE_LOD:
+		return lodReceived(mesh_params, lod, data, data_size);
+	case DECODE_SKIN:
+		return skinInfoReceived(mesh_params.getSculptID(), data, data_size);
+	case DECODE_DECOMPOSITION:
+		return decompositionReceived(mesh_params.getSculptID(), data, data_size);
+	case DECODE_PHYSICS_SHAPE:
+		return physicsShapeReceived(mesh_params.getSculptID(), data, data_size);
+	}
+	return false;
+}
+
+void LLMeshRepoThread::decodeFailed(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod)
+{
+	LLUUID mesh_id = mesh_params.getSculptID();
+	llwarns << "Cached mesh " << mesh_id << " doesn't decode, fetching it again." << llendl;
+	//without the cached asset the fetch goes to the sim
+	removeCachedMesh(mesh_id);
+
+	if (type == DECODE_LOD)
+	{
+		LLMutexLock lock(mMutex);
+		mLODReqQ.push(LODRequest(mesh_params, lod));
+		LLMeshRepository::sLODProcessing++;
+	}
+	else
+	{	//the request sets are protected by mSignal
+		mSignal->lock();
+		if (type == DECODE_SKIN)
+		{
+			mSkinRequests.insert(mesh_id);
+		}
+		else if (type == DECODE_DECOMPOSITION)
+		{
+			mDecompositionRequests.insert(mesh_id);
+		}
+		else
+		{
+			mPhysicsShapeRequests.insert(mesh_id);
+		}
+		mSignal->unlock();
+	}
+	mSignal->signal();
+}
+
+S32 LLMeshRepoThread::cacheDecoded(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+									S32 cache_offset, const U8* data, S32 cache_size)
+{
+	return writeCachedBlob(mesh_params.getSculptID(), getCacheBlob(type, lod), cache_offset, data, cache_size);
+}
+
+void LLMeshRepoThread::addDecodeStats(S32 cache_bytes_written, U64 wait_time, U64 decode_time)
+{
+	LLMutexLock lock(mMutex);
+	LLMeshRepository::sCacheBytesWritten += cache_bytes_written;
+	LLMeshRepository::sDecodeCount++;
+	LLMeshRepository::sDecodeWaitTime += wait_time;
+	LLMeshRepository::sDecodeTime += decode_time;
+}
+
+U8* LLMeshRepoThread::readCachedBlob(const LLUUID& mesh_id, LLMeshCache::EBlob blob, S32 offset, S32 size)
+{
+	if (mCache.isEnabled())
+	{	//a single read, of a blob the index says was stored
+		S32 cached_size = 0;
+		U8* buffer = mCache.readBlob(mesh_id, blob, cached_size);
+		if (buffer && cached_size != size)
+		{	//cached with another header
+			delete[] buffer;
+			buffer = NULL;
+		}
+		if (buffer)
+		{
+			LLMeshRepository::sCacheBytesRead += size;
+		}
+		return buffer;
+	}
+
+	LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH);
+	if (file.getSize() < offset+size)
+	{
+		return NULL;
+	}
+	LLMeshRepository::sCacheBytesRead += size;
+	file.seek(offset);
+	U8* buffer = new U8[size];
+	file.read(buffer, size);
+
+	//make sure buffer isn't all 0's (reserved block but not written)
+	bool zero = true;
+	for (S32 i = 0; i < llmin(size, 1024) && zero; ++i)
+	{
+		zero = buffer[i] > 0 ? false : true;
+	}
+	if (zero)
+	{
+		delete[] buffer;
+		return NULL;
+	}
+	return buffer;
+}
+
+S32 LLMeshRepoThread::writeCachedBlob(const LLUUID& mesh_id, LLMeshCache::EBlob blob, S32 offset, const U8* data, S32 size)
+{
+	if (mCache.isEnabled())
+	{
+		return mCache.writeBlob(mesh_id, blob, data, size) ? size : 0;
+	}
+
+	LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH, LLVFile::WRITE);
+	if (file.getSize() >= offset+size)
+	{
+		file.seek(offset);
+		file.write(data, size);
+		return size;
+	}
+	return 0;
+}
+
+S32 LLMeshRepoThread::writeCachedHeader(const LLUUID& mesh_id, const U8* data, S32 data_size)
+{
+	LLMeshHeader header;
+	if (!getMeshHeader(mesh_id, header) || header.m404 || header.mVersion > MAX_MESH_VERSION)
+	{
+		return 0;
+	}
+
+	if (mCache.isEnabled())
+	{	//the blobs that came with the header are cached right away
+		return mCache.writeHeader(mesh_id, header, data, data_size) ? data_size : 0;
+	}
+
+	S32 lod_bytes = 0;
+
+	for (U32 i = 0; i < LLModel::LOD_PHYSICS; ++i)
+	{ //figure out how many bytes we'll need to reserve in the file
+		lod_bytes = llmax(lod_bytes, header.mOffset[i] + header.mSize[i]);
+	}
+
+	//just in case skin info or decomposition is at the end of the file (which it shouldn't be)
+	lod_bytes = llmax(lod_bytes, header.mOffset[LLMeshCache::BLOB_SKIN] + header.mSize[LLMeshCache::BLOB_SKIN]);
+	lod_bytes = llmax(lod_bytes, header.mOffset[LLMeshCache::BLOB_PHYSICS_CONVEX] + header.mSize[LLMeshCache::BLOB_PHYSICS_CONVEX]);
+
+	S32 bytes = lod_bytes + header.mHeaderSize; 
+
+	//it's possible for the remote asset to have more data than is needed for the local cache
+	//only allocate as much space in the VFS as is needed for the local cache
+	data_size = llmin(data_size, bytes);
+
+	LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH, LLVFile::WRITE);
+	if (file.getMaxSize() >= bytes || file.setMaxSize(bytes))
+	{
+		file.write((const U8*) data, data_size);
+
+		//zero out the rest of the file 
+		U8 block[4096];
+		memset(block, 0, 4096);
+
+		while (bytes-file.tell() > 4096)
+		{
+			file.write(block, 4096);
+		}
+
+		S32 remaining = bytes-file.tell();
+
+		if (remaining > 0)
+		{
+			file.write(block, remaining);
+		}
+		return data_size;
+	}
+	return 0;
+}
+
+void LLMeshRepoThread::removeCachedMesh(const LLUUID& mesh_id)
+{
+	if (mCache.isEnabled())
+	{
+		mCache.remove(mesh_id);
+		return;
+	}
+
+	LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH, LLVFile::WRITE);
+	file.remove();
+}
+
+//static
+LLMeshCache::EBlob LLMeshRepoThread::getCacheBlob(EDecodeType type, S32 lod)
+{
+	switch (type)
+	{
+	case DECODE_SKIN:
+		return LLMeshCache::BLOB_SKIN;
+	case DECODE_DECOMPOSITION:
+		return LLMeshCache::BLOB_PHYSICS_CONVEX;
+	case DECODE_PHYSICS_SHAPE:
+		return LLMeshCache::BLOB_PHYSICS_MESH;
+	default:
+		//the LODs are in the same order
+		return (LLMeshCache::EBlob)lod;
+	}
+}
+
 #if MESH_IMPORT
 LLMeshUploadThread::LLMeshUploadThread(LLMeshUploadThread::instance_list& data, LLVector3& scale, bool upload_textures,
 										bool upload_skin, bool upload_joints, std::string upload_url, bool do_upload,
@@ -1674,14 +1880,22 @@ void LLMeshRepoThread::notifyLoadedMeshes()
 
 	while (!mSkinInfoQ.empty())
 	{
-		gMeshRepo.notifySkinInfoReceived(mSkinInfoQ.front());
+		mMutex->lock();
+		LLMeshSkinInfo info = mSkinInfoQ.front();
 		mSkinInfoQ.pop();
+		mMutex->unlock();
+
+		gMeshRepo.notifySkinInfoReceived(info);
 	}
 
 	while (!mDecompositionQ.empty())
 	{
-		gMeshRepo.notifyDecompositionReceived(mDecompositionQ.front());
+		mMutex->lock();
+		LLModel::Decomposition* decomp = mDecompositionQ.front();
 		mDecompositionQ.pop();
+		mMutex->unlock();
+
+		gMeshRepo.notifyDecompositionReceived(decomp);
 	}
 }
 
@@ -1692,27 +1906,23 @@ S32 LLMeshRepoThread::getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lo
 
 	if (iter != mMeshHeader.end())
 	{
-		LLSD& header = iter->second;
-
-		return LLMeshRepository::getActualMeshLOD(header, lod);
+		return LLMeshRepository::getActualMeshLOD(iter->second, lod);
 	}
 
 	return lod;
 }
 
 //static
-S32 LLMeshRepository::getActualMeshLOD(LLSD& header, S32 lod)
+S32 LLMeshRepository::getActualMeshLOD(LLMeshHeader& header, S32 lod)
 {
 	lod = llclamp(lod, 0, 3);
 
-	S32 version = header["version"];
-
-	if (header.has("404") || version > MAX_MESH_VERSION)
+	if (header.m404 || header.mVersion > MAX_MESH_VERSION)
 	{
 		return -1;
 	}
 
-	if (header[header_lod[lod]]["size"].asInteger() > 0)
+	if (header.mSize[lod] > 0)
 	{
 		return lod;
 	}
@@ -1720,7 +1930,7 @@ S32 LLMeshRepository::getActualMeshLOD(LLSD& header, S32 lod)
 	//search down to find the next available lower lod
 	for (S32 i = lod-1; i >= 0; --i)
 	{
-		if (header[header_lod[i]]["size"].asInteger() > 0)
+		if (header.mSize[i] > 0)
 		{
 			return i;
 		}
@@ -1729,21 +1939,26 @@ S32 LLMeshRepository::getActualMeshLOD(LLSD& header, S32 lod)
 	//search up to find then ext available higher lod
 	for (S32 i = lod+1; i < 4; ++i)
 	{
-		if (header[header_lod[i]]["size"].asInteger() > 0)
+		if (header.mSize[i] > 0)
 		{
 			return i;
 		}
 	}
 
 	//header exists and no good lod found, treat as 404
-	header["404"] = 1;
+	header.m404 = true;
 	return -1;
 }
 
 #if MESH_IMPORT
 void LLMeshRepository::cacheOutgoingMesh(LLMeshUploadData& data, LLSD& header)
 {
-	mThread->mMeshHeader[data.mUUID] = header;
+	{
+		LLMeshHeader mesh_header;
+		mesh_header.fromLLSD(header, 0);
+		LLMutexLock lock(mThread->mHeaderMutex);
+		mThread->mMeshHeader[data.mUUID] = mesh_header;
+	}
 
 	// we cache the mesh for default parameters
 	LLVolumeParams volume_params;
@@ -1790,6 +2005,11 @@ void LLMeshLODResponder::completedRaw(U32 status, const std::string& reason,
 	}
 
 	LLMeshRepository::sBytesReceived += mRequestedBytes;
+	{
+		LLMutexLock lock(gMeshRepo.mThread->mMutex);
+		LLMeshRepository::sLODFetchCount++;
+		LLMeshRepository::sLODFetchTime += totalTime() - mStartTime;
+	}
 
 	U8* data = NULL;
 
@@ -1799,20 +2019,16 @@ void LLMeshLODResponder::completedRaw(U32 status, const std::string& reason,
 		buffer->readAfter(channels.in(), NULL, data, data_size);
 	}
 
+	if (gMeshRepo.mThread->queueDecode(LLMeshRepoThread::DECODE_LOD, mMeshParams, mLOD, data, data_size, mOffset, mRequestedBytes))
+	{	//the decode workers own data now, and cache it once it decoded
+		return;
+	}
+
 	if (gMeshRepo.mThread->lodReceived(mMeshParams, mLOD, data, data_size))
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshParams.getSculptID(), LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			file.seek(offset);
-			file.write(data, size);
-			LLMeshRepository::sCacheBytesWritten += size;
-		}
+		//good fetch from sim, cache it
+		LLMeshRepository::sCacheBytesWritten += gMeshRepo.mThread->writeCachedBlob(mMeshParams.getSculptID(), (LLMeshCache::EBlob)mLOD,
+																				   mOffset, data, mRequestedBytes);
 	}
 
 	delete [] data;
@@ -1853,20 +2069,15 @@ void LLMeshSkinInfoResponder::completedRaw(U32 status, const std::string& reason
 		buffer->readAfter(channels.in(), NULL, data, data_size);
 	}
 
+	if (gMeshRepo.mThread->queueDecode(LLMeshRepoThread::DECODE_SKIN, mesh_id_params(mMeshID), 0, data, data_size, mOffset, mRequestedBytes))
+	{	//the decode workers own data now, and cache it once it decoded
+		return;
+	}
+
 	if (gMeshRepo.mThread->skinInfoReceived(mMeshID, data, data_size))
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		//good fetch from sim, cache it
+		LLMeshRepository::sCacheBytesWritten += gMeshRepo.mThread->writeCachedBlob(mMeshID, LLMeshCache::BLOB_SKIN, mOffset, data, mRequestedBytes);
 	}
 
 	delete [] data;
@@ -1907,20 +2118,15 @@ void LLMeshDecompositionResponder::completedRaw(U32 status, const std::string& r
 		buffer->readAfter(channels.in(), NULL, data, data_size);
 	}
 
+	if (gMeshRepo.mThread->queueDecode(LLMeshRepoThread::DECODE_DECOMPOSITION, mesh_id_params(mMeshID), 0, data, data_size, mOffset, mRequestedBytes))
+	{	//the decode workers own data now, and cache it once it decoded
+		return;
+	}
+
 	if (gMeshRepo.mThread->decompositionReceived(mMeshID, data, data_size))
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		//good fetch from sim, cache it
+		LLMeshRepository::sCacheBytesWritten += gMeshRepo.mThread->writeCachedBlob(mMeshID, LLMeshCache::BLOB_PHYSICS_CONVEX, mOffset, data, mRequestedBytes);
 	}
 
 	delete [] data;
@@ -1961,20 +2167,15 @@ void LLMeshPhysicsShapeResponder::completedRaw(U32 status, const std::string& re
 		buffer->readAfter(channels.in(), NULL, data, data_size);
 	}
 
+	if (gMeshRepo.mThread->queueDecode(LLMeshRepoThread::DECODE_PHYSICS_SHAPE, mesh_id_params(mMeshID), 0, data, data_size, mOffset, mRequestedBytes))
+	{	//the decode workers own data now, and cache it once it decoded
+		return;
+	}
+
 	if (gMeshRepo.mThread->physicsShapeReceived(mMeshID, data, data_size))
 	{
-		//good fetch from sim, write to VFS for caching
-		LLVFile file(gVFS, mMeshID, LLAssetType::AT_MESH, LLVFile::WRITE);
-
-		S32 offset = mOffset;
-		S32 size = mRequestedBytes;
-
-		if (file.getSize() >= offset+size)
-		{
-			LLMeshRepository::sCacheBytesWritten += size;
-			file.seek(offset);
-			file.write(data, size);
-		}
+		//good fetch from sim, cache it
+		LLMeshRepository::sCacheBytesWritten += gMeshRepo.mThread->writeCachedBlob(mMeshID, LLMeshCache::BLOB_PHYSICS_MESH, mOffset, data, mRequestedBytes);
 	}
 
 	delete [] data;
@@ -2027,60 +2228,8 @@ void LLMeshHeaderResponder::completedRaw(U32 status, const std::string& reason,
 	}
 	else if (data && data_size > 0)
 	{
-		//header was successfully retrieved from sim, cache in vfs
-		LLUUID mesh_id = mMeshParams.getSculptID();
-		LLSD header = gMeshRepo.mThread->mMeshHeader[mesh_id];
-
-		S32 version = header["version"].asInteger();
-
-		if (version <= MAX_MESH_VERSION)
-		{
-			std::stringstream str;
-
-			S32 lod_bytes = 0;
-
-			for (U32 i = 0; i < LLModel::LOD_PHYSICS; ++i)
-			{ //figure out how many bytes we'll need to reserve in the file
-				std::string lod_name = header_lod[i];
-				lod_bytes = llmax(lod_bytes, header[lod_name]["offset"].asInteger()+header[lod_name]["size"].asInteger());
-			}
-		
-			//just in case skin info or decomposition is at the end of the file (which it shouldn't be)
-			lod_bytes = llmax(lod_bytes, header["skin"]["offset"].asInteger() + header["skin"]["size"].asInteger());
-			lod_bytes = llmax(lod_bytes, header["physics_convex"]["offset"].asInteger() + header["physics_convex"]["size"].asInteger());
-
-			S32 header_bytes = (S32) gMeshRepo.mThread->mMeshHeaderSize[mesh_id];
-			S32 bytes = lod_bytes + header_bytes; 
-
-		
-			//it's possible for the remote asset to have more data than is needed for the local cache
-			//only allocate as much space in the VFS as is needed for the local cache
-			data_size = llmin(data_size, bytes);
-
-			LLVFile file(gVFS, mesh_id, LLAssetType::AT_MESH, LLVFile::WRITE);
-			if (file.getMaxSize() >= bytes || file.setMaxSize(bytes))
-			{
-				LLMeshRepository::sCacheBytesWritten += data_size;
-
-				file.write((const U8*) data, data_size);
-			
-				//zero out the rest of the file 
-				U8 block[4096];
-				memset(block, 0, 4096);
-
-				while (bytes-file.tell() > 4096)
-				{
-					file.write(block, 4096);
-				}
-
-				S32 remaining = bytes-file.tell();
-
-				if (remaining > 0)
-				{
-					file.write(block, remaining);
-				}
-			}
-		}
+		//header was successfully retrieved from sim, cache it
+		LLMeshRepository::sCacheBytesWritten += gMeshRepo.mThread->writeCachedHeader(mMeshParams.getSculptID(), data, data_size);
 	}
 
 	delete [] data;
@@ -2114,6 +2263,11 @@ void LLMeshRepository::init()
 	
 	
 	mThread = new LLMeshRepoThread();
+	U32 cache_size = gSavedSettings.getU32("MeshCacheSize");
+	if (cache_size)
+	{
+		mThread->mCache.initCache(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "meshes"), (S64)cache_size << 20);
+	}
 	mThread->start();
 }
 
@@ -2135,6 +2289,11 @@ void LLMeshRepository::shutdown()
 	{
 		apr_sleep(10);
 	}
+	while (LLMeshDecodeTask::sQueued > 0)
+	{	//the decode workers use mThread
+		apr_sleep(10);
+	}
+	mThread->mCache.saveIndex();
 	delete mThread;
 	mThread = NULL;
 
@@ -2674,8 +2833,8 @@ void LLMeshRepository::buildHull(const LLVolumeParams& params, S32 detail)
 
 bool LLMeshRepository::hasPhysicsShape(const LLUUID& mesh_id)
 {
-	LLSD mesh = mThread->getMeshHeader(mesh_id);
-	if (mesh.has("physics_mesh") && mesh["physics_mesh"].has("size") && (mesh["physics_mesh"]["size"].asInteger() > 0))
+	LLMeshHeader header;
+	if (mThread->getMeshHeader(mesh_id, header) && header.mSize[LLMeshCache::BLOB_PHYSICS_MESH] > 0)
 	{
 		return true;
 	}
@@ -2689,25 +2848,25 @@ bool LLMeshRepository::hasPhysicsShape(const LLUUID& mesh_id)
 	return false;
 }
 
-LLSD& LLMeshRepository::getMeshHeader(const LLUUID& mesh_id)
+bool LLMeshRepository::getMeshHeader(const LLUUID& mesh_id, LLMeshHeader& header)
 {
-	return mThread->getMeshHeader(mesh_id);
+	return mThread->getMeshHeader(mesh_id, header);
 }
 
-LLSD& LLMeshRepoThread::getMeshHeader(const LLUUID& mesh_id)
+bool LLMeshRepoThread::getMeshHeader(const LLUUID& mesh_id, LLMeshHeader& header)
 {
-	static LLSD dummy_ret;
 	if (mesh_id.notNull())
-	{
+	{	//copied out, the map may be rehashed by another thread
 		LLMutexLock lock(mHeaderMutex);
 		mesh_header_map::iterator iter = mMeshHeader.find(mesh_id);
 		if (iter != mMeshHeader.end())
 		{
-			return iter->second;
+			header = iter->second;
+			return true;
 		}
 	}
 
-	return dummy_ret;
+	return false;
 }
 
 #if MESH_IMPORT
@@ -2725,18 +2884,18 @@ S32 LLMeshRepository::getMeshSize(const LLUUID& mesh_id, S32 lod)
 {
 	if (mThread)
 	{
+		LLMutexLock lock(mThread->mHeaderMutex);
 		LLMeshRepoThread::mesh_header_map::iterator iter = mThread->mMeshHeader.find(mesh_id);
 		if (iter != mThread->mMeshHeader.end())
 		{
-			LLSD& header = iter->second;
+			const LLMeshHeader& header = iter->second;
 
-			if (header.has("404"))
+			if (header.m404)
 			{
 				return -1;
 			}
 
-			S32 size = header[header_lod[lod]]["size"].asInteger();
-			return size;
+			return header.mSize[lod];
 		}
 
 	}
@@ -2835,7 +2994,7 @@ void LLMeshRepository::uploadError(LLSD& args)
 }
 
 //static
-F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32* bytes_visible, S32 lod, F32 *unscaled_value)
+F32 LLMeshRepository::getStreamingCost(LLMeshHeader& header, F32 radius, S32* bytes, S32* bytes_visible, S32 lod, F32 *unscaled_value)
 {
 	F32 max_distance = 512.f;
 
@@ -2853,10 +3012,10 @@ F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32
 
 	F32 bytes_per_triangle = (F32) mesh_bytes_per_triangle.get();
 
-	S32 bytes_lowest = header["lowest_lod"]["size"].asInteger();
-	S32 bytes_low = header["low_lod"]["size"].asInteger();
-	S32 bytes_mid = header["medium_lod"]["size"].asInteger();
-	S32 bytes_high = header["high_lod"]["size"].asInteger();
+	S32 bytes_lowest = header.mSize[LLMeshCache::BLOB_LOWEST_LOD];
+	S32 bytes_low = header.mSize[LLMeshCache::BLOB_LOW_LOD];
+	S32 bytes_mid = header.mSize[LLMeshCache::BLOB_MEDIUM_LOD];
+	S32 bytes_high = header.mSize[LLMeshCache::BLOB_HIGH_LOD];
 
 	if (bytes_high == 0)
 	{
@@ -2886,10 +3045,10 @@ F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32
 	if (bytes)
 	{
 		*bytes = 0;
-		*bytes += header["lowest_lod"]["size"].asInteger();
-		*bytes += header["low_lod"]["size"].asInteger();
-		*bytes += header["medium_lod"]["size"].asInteger();
-		*bytes += header["high_lod"]["size"].asInteger();
+		*bytes += header.mSize[LLMeshCache::BLOB_LOWEST_LOD];
+		*bytes += header.mSize[LLMeshCache::BLOB_LOW_LOD];
+		*bytes += header.mSize[LLMeshCache::BLOB_MEDIUM_LOD];
+		*bytes += header.mSize[LLMeshCache::BLOB_HIGH_LOD];
 	}
 
 	if (bytes_visible)
@@ -2897,7 +3056,7 @@ F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32
 		lod = LLMeshRepository::getActualMeshLOD(header, lod);
 		if (lod >= 0 && lod <= 3)
 		{
-			*bytes_visible = header[header_lod[lod]]["size"].asInteger();
+			*bytes_visible = header.mSize[lod];
 		}
 	}
 
@@ -2938,6 +3097,12 @@ F32 LLMeshRepository::getStreamingCost(LLSD& header, F32 radius, S32* bytes, S32
 }
 
 
+void LLMeshHeader::fromLLSD(const LLSD& header, U32 header_size)
+{
+	LLMeshCache::Header::fromLLSD(header, (S32) header_size);
+	m404 = header.has("404");
+}
+
 LLPhysicsDecomp::LLPhysicsDecomp()
 :	LLThread("Physics Decomp")
 {
@@ -28,7 +28,10 @@
 #define LL_MESH_REPOSITORY_H
 
 #include "llassettype.h"
+#include "llmeshcache.h"
+#include "llmeshdecodetask.h"
 #include "llmodel.h"
+#include "llopenhashmap.h"
 #include "lluuid.h"
 #include "llviewertexture.h"
 #include "llvolume.h"
@@ -237,7 +240,21 @@ public:
 
 };
 
-class LLMeshRepoThread : public LLThread
+// What the viewer uses of the LLSD header of a mesh asset, parsed once when
+// it arrives: the offsets and sizes of the blobs (LODs, skin, physics) and
+// whether there is such an asset. A few dozen bytes instead of an LLSD map
+// per mesh, and no string lookups when the render thread picks a LOD.
+struct LLMeshHeader : public LLMeshCache::Header
+{
+	LLMeshHeader() : m404(false) { }
+
+	// header_size is 0 when the asset doesn't exist.
+	void fromLLSD(const LLSD& header, U32 header_size);
+
+	bool m404;			// No such asset, or none of its LODs is usable.
+};
+
+class LLMeshRepoThread : public LLThread, public LLMeshDecoder
 {
 public:
 
@@ -249,11 +266,12 @@ public:
 	LLMutex*		mHeaderMutex;
 	LLCondition*	mSignal;
 
-	//map of known mesh headers
-	typedef std::map<LLUUID, LLSD> mesh_header_map;
+	//map of known mesh headers, protected by mHeaderMutex
+	typedef LLOpenHashMap<LLUUID, LLMeshHeader> mesh_header_map;
 	mesh_header_map mMeshHeader;
-	
-	std::map<LLUUID, U32> mMeshHeaderSize;
+
+	//mesh assets, when they aren't cached in the VFS (MeshCacheSize is 0)
+	LLMeshCache mCache;
 
 	class HeaderRequest
 	{ 
@@ -349,11 +367,40 @@ public:
 	bool fetchMeshHeader(const LLVolumeParams& mesh_params, U32& count);
 	void fetchMeshLOD(const LLVolumeParams& mesh_params, S32 lod, U32& count);
 	bool headerReceived(const LLVolumeParams& mesh_params, U8* data, S32 data_size);
+	void setMeshHeader(const LLVolumeParams& mesh_params, const LLMeshHeader& header);
 	bool lodReceived(const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
 	bool skinInfoReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool decompositionReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
 	bool physicsShapeReceived(const LLUUID& mesh_id, U8* data, S32 data_size);
-	LLSD& getMeshHeader(const LLUUID& mesh_id);
+	// Any thread. Returns false, leaving header alone, if it isn't known (yet).
+	bool getMeshHeader(const LLUUID& mesh_id, LLMeshHeader& header);
+
+	// Any thread. Hands a received blob to the decode workers, which take
+	// ownership of data (new[]'d); see LLMeshDecodeTask::queue(). Cached data
+	// that doesn't decode is dropped from the cache and requested again.
+	// Returns false, keeping data, when there are no workers: call the
+	// *Received() function of type then.
+	bool queueDecode(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+					 U8* data, S32 data_size, S32 cache_offset = -1, S32 cache_size = 0);
+	// Decode worker. The *Received() function of type.
+	/*virtual*/ bool decode(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size);
+	// Decode worker. Drops the cached asset of mesh_params and fetches the blob again.
+	/*virtual*/ void decodeFailed(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod);
+	// Decode worker.
+	/*virtual*/ S32 cacheDecoded(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+								 S32 cache_offset, const U8* data, S32 cache_size);
+	// Decode worker. Updates the LLMeshRepository decode statistics.
+	/*virtual*/ void addDecodeStats(S32 cache_bytes_written, U64 wait_time, U64 decode_time);
+
+	// Any thread. The blob of the cached asset mesh_id that is the size bytes
+	// at offset of the asset, new[]'d, or NULL if it isn't cached.
+	U8* readCachedBlob(const LLUUID& mesh_id, LLMeshCache::EBlob blob, S32 offset, S32 size);
+	// Any thread. Caches a blob received from the sim; returns the bytes written.
+	S32 writeCachedBlob(const LLUUID& mesh_id, LLMeshCache::EBlob blob, S32 offset, const U8* data, S32 size);
+	// Any thread. Caches the first data_size bytes of the asset, received with its header.
+	S32 writeCachedHeader(const LLUUID& mesh_id, const U8* data, S32 data_size);
+	void removeCachedMesh(const LLUUID& mesh_id);
+	static LLMeshCache::EBlob getCacheBlob(EDecodeType type, S32 lod);
 
 	void notifyLoadedMeshes();
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
@@ -468,8 +515,19 @@ public:
 	static U32 sCacheBytesRead;
 	static U32 sCacheBytesWritten;
 	static U32 sPeakKbps;
+	// Fetch stage: LOD byte range requests answered and the time they took
+	// (updated under LLMeshRepoThread::mMutex).
+	static U32 sLODFetchCount;
+	static U64 sLODFetchTime;
+	// Decode stage (worker pool): blobs decoded with the time they waited for
+	// a worker and took to decode, in microseconds (updated under
+	// LLMeshRepoThread::mMutex). LLMeshDecodeTask::sQueued has the blobs
+	// waiting or decoding.
+	static U32 sDecodeCount;
+	static U64 sDecodeWaitTime;
+	static U64 sDecodeTime;
 	
-	static F32 getStreamingCost(LLSD& header, F32 radius, S32* bytes = NULL, S32* visible_bytes = NULL, S32 detail = -1, F32 *unscaled_value = NULL);
+	static F32 getStreamingCost(LLMeshHeader& header, F32 radius, S32* bytes = NULL, S32* visible_bytes = NULL, S32 detail = -1, F32 *unscaled_value = NULL);
 
 	LLMeshRepository();
 
@@ -487,7 +545,8 @@ public:
 	void notifyDecompositionReceived(LLModel::Decomposition* info);
 
 	S32 getActualMeshLOD(const LLVolumeParams& mesh_params, S32 lod);
-	static S32 getActualMeshLOD(LLSD& header, S32 lod);
+	// Marks header as 404 if none of its LODs is usable.
+	static S32 getActualMeshLOD(LLMeshHeader& header, S32 lod);
 	const LLMeshSkinInfo* getSkinInfo(const LLUUID& mesh_id, const LLVOVolume* requesting_obj);
 	LLModel::Decomposition* getDecomposition(const LLUUID& mesh_id);
 	void fetchPhysicsShape(const LLUUID& mesh_id);
@@ -500,7 +559,7 @@ public:
 	bool meshRezEnabled();
 	
 
-	LLSD& getMeshHeader(const LLUUID& mesh_id);
+	bool getMeshHeader(const LLUUID& mesh_id, LLMeshHeader& header);
 
 #if MESH_IMPORT
 	void uploadModel(std::vector<LLModelInstance>& data, LLVector3& scale, bool upload_textures,
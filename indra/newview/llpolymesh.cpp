@@ -774,6 +774,7 @@ LLPolyMesh::LLPolyMesh(LLPolyMeshSharedData *shared_data, LLPolyMesh *reference_
 		mScaledBinormals = reference_mesh->mScaledBinormals;
 		mTexCoords = reference_mesh->mTexCoords;
 		mClothingWeights = reference_mesh->mClothingWeights;
+		mMorphEngine = reference_mesh->mMorphEngine;
 	}
 	else
 	{
@@ -802,6 +803,17 @@ LLPolyMesh::LLPolyMesh(LLPolyMeshSharedData *shared_data, LLPolyMesh *reference_
 		mBinormals			=   (LLVector4a*)(mVertexData + offset); offset += 4*nverts;
 		mScaledBinormals	=   (LLVector4a*)(mVertexData + offset); offset += 4*nverts; 
 		initializeForMorph();
+
+		LLMorphEngine::Mesh mesh;
+		mesh.mCoords = mCoords;
+		mesh.mScaledNormals = mScaledNormals;
+		mesh.mNormals = mNormals;
+		mesh.mScaledBinormals = mScaledBinormals;
+		mesh.mBinormals = mBinormals;
+		mesh.mClothingWeights = mClothingWeights;
+		mesh.mTexCoords = mTexCoords;
+		mesh.mNumVertices = mSharedData->mNumVertices;
+		mMorphEngine = new LLMorphEngine(mesh);
 	}
 }
 
@@ -818,6 +830,11 @@ LLPolyMesh::~LLPolyMesh()
                 mJointRenderData[i] = NULL;
         }
 
+		// LODs share the vertex data and the morph engine of their reference mesh.
+		if (mVertexData)
+		{
+			delete mMorphEngine;
+		}
 		ll_aligned_free_16(mVertexData);
 
 }
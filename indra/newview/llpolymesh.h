@@ -340,6 +340,9 @@ public:
 
 	BOOL	isLOD() { return mSharedData && mSharedData->isLOD(); }
 
+	// Applies the morph targets of this mesh, or of the reference mesh of a LOD.
+	LLMorphEngine* getMorphEngine() { return mMorphEngine; }
+
 	void setAvatar(LLVOAvatar* avatarp) { mAvatarp = avatarp; }
 	LLVOAvatar* getAvatar() { return mAvatarp; }
 
@@ -376,6 +379,8 @@ protected:
 	LLVector4a				*mClothingWeights;
 	// output texture coordinates
 	LLVector2				*mTexCoords;
+	// applies morph targets to the arrays above
+	LLMorphEngine			*mMorphEngine;
 	
 	LLPolyMesh				*mReferenceMesh;
 
@@ -37,7 +37,7 @@
 
 //#include "../tools/imdebug/imdebug.h"
 
-const F32 NORMAL_SOFTEN_FACTOR = 0.65f;
+const F32 NORMAL_SOFTEN_FACTOR = LLMorphEngine::NORMAL_SOFTEN_FACTOR;
 const F32 SIGNIFICANT_DELTA    = 0.0001f;
 
 //-----------------------------------------------------------------------------
@@ -538,6 +538,21 @@ BOOL LLPolyMorphData::setMorphFromMesh(LLPolyMesh *morph)
 	return TRUE;
 }
 
+//-----------------------------------------------------------------------------
+// getMorph()
+//-----------------------------------------------------------------------------
+LLMorphEngine::Morph LLPolyMorphData::getMorph() const
+{
+	LLMorphEngine::Morph morph;
+	morph.mVertexIndices = mVertexIndices;
+	morph.mCoords = mCoords;
+	morph.mNormals = mNormals;
+	morph.mBinormals = mBinormals;
+	morph.mTexCoords = mTexCoords;
+	morph.mNumIndices = mNumIndices;
+	return morph;
+}
+
 //-----------------------------------------------------------------------------
 // LLPolyMorphTargetInfo()
 //-----------------------------------------------------------------------------
@@ -844,62 +859,16 @@ void LLPolyMorphTarget::apply( ESex avatar_sex )
 	if (delta_weight != 0.f)
 	{
 		llassert(!mMesh->isLOD());
-		LLVector4a *coords = mMesh->getWritableCoords();
-
-		LLVector4a *scaled_normals = mMesh->getScaledNormals();
-		LLVector4a *normals = mMesh->getWritableNormals();
-
-		LLVector4a *scaled_binormals = mMesh->getScaledBinormals();
-		LLVector4a *binormals = mMesh->getWritableBinormals();
-
-		LLVector4a *clothing_weights = mMesh->getWritableClothingWeights();
-		LLVector2 *tex_coords = mMesh->getWritableTexCoords();
-
+		LLMorphEngine* engine = mMesh->getMorphEngine();
 		F32 *maskWeightArray = (mVertMask) ? mVertMask->getMorphMaskWeights() : NULL;
+		engine->add(mMorphData->getMorph(), delta_weight, maskWeightArray, getInfo()->mIsClothingMorph);
 
-		for(U32 vert_index_morph = 0; vert_index_morph < mMorphData->mNumIndices; vert_index_morph++)
+		// When the avatar defers morphs, all those that changed are applied
+		// together, see LLVOAvatar::applyMorphs().
+		LLVOAvatar* avatarp = mMesh->getAvatar();
+		if (!avatarp || !avatarp->isDeferringMorphs())
 		{
-			S32 vert_index_mesh = mMorphData->mVertexIndices[vert_index_morph];
-
-			F32 maskWeight = 1.f;
-			if (maskWeightArray)
-			{
-				maskWeight = maskWeightArray[vert_index_morph];
-			}
-
-
-			LLVector4a pos = mMorphData->mCoords[vert_index_morph];
-			pos.mul(delta_weight*maskWeight);
-			coords[vert_index_mesh].add(pos);
-
-			if (getInfo()->mIsClothingMorph && clothing_weights)
-			{
-				LLVector4a clothing_offset = mMorphData->mCoords[vert_index_morph];
-				clothing_offset.mul(delta_weight * maskWeight);
-				LLVector4a* clothing_weight = &clothing_weights[vert_index_mesh];
-				clothing_weight->add(clothing_offset);
-				clothing_weight->getF32ptr()[VW] = maskWeight;
-			}
-
-			// calculate new normals based on half angles
-			LLVector4a norm = mMorphData->mNormals[vert_index_morph];
-			norm.mul(delta_weight*maskWeight*NORMAL_SOFTEN_FACTOR);
-			scaled_normals[vert_index_mesh].add(norm);
-			norm = scaled_normals[vert_index_mesh];
-			norm.normalize3fast();
-			normals[vert_index_mesh] = norm;
-
-			// calculate new binormals
-			LLVector4a binorm = mMorphData->mBinormals[vert_index_morph];
-			binorm.mul(delta_weight*maskWeight*NORMAL_SOFTEN_FACTOR);
-			scaled_binormals[vert_index_mesh].add(binorm);
-			LLVector4a tangent;
-			tangent.setCross3(scaled_binormals[vert_index_mesh], norm);
-			LLVector4a& normalized_binormal = binormals[vert_index_mesh];
-			normalized_binormal.setCross3(norm, tangent); 
-			normalized_binormal.normalize3fast();
-			
-			tex_coords[vert_index_mesh] += mMorphData->mTexCoords[vert_index_morph] * delta_weight * maskWeight;
+			engine->apply();
 		}
 
 		// now apply volume changes
@@ -927,6 +896,9 @@ void	LLPolyMorphTarget::applyMask(U8 *maskTextureData, S32 width, S32 height, S3
 {
 	LLVector4a *clothing_weights = getInfo()->mIsClothingMorph ? mMesh->getWritableClothingWeights() : NULL;
 
+	// Morphs still queued may have been added with the mask changed below.
+	mMesh->getMorphEngine()->apply();
+
 	if (!mVertMask)
 	{
 		mVertMask = new LLPolyVertexMask(mMorphData);
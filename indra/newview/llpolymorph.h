@@ -36,6 +36,7 @@
 #include <string>
 #include <vector>
 
+#include "llmorphengine.h"
 #include "llviewervisualparam.h"
 
 class LLPolyMeshSharedData;
@@ -71,6 +72,9 @@ public:
 	BOOL			saveOBJ(LLFILE *fp);
 	BOOL			setMorphFromMesh(LLPolyMesh *morph);
 
+	// The deltas, for LLMorphEngine.
+	LLMorphEngine::Morph getMorph() const;
+
 public:
 	std::string			mName;
 
@@ -76,6 +76,7 @@
 #include "llmd5.h"
 #include "llmemorystream.h"
 #include "llmessageconfig.h"
+#include "llmessagelog.h"
 #include "llmoveview.h"
 #include "llnotifications.h"
 #include "llnotificationsutil.h"
@@ -617,6 +618,11 @@ bool idle_startup()
 				msg->startLogging();
 			}
 
+			if (gSavedSettings.getBOOL("LogMessagesCapture"))
+			{
+				LLMessageLog::startCapture(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "udp_messages.capture"));
+			}
+
 			// start the xfer system. by default, choke the downloads
 			// a lot...
 			const S32 VIEWER_MAX_XFER = 3;
@@ -633,6 +639,7 @@ bool idle_startup()
 
 			F32 dropPercent = gSavedSettings.getF32("PacketDropPercentage");
 			msg->mPacketRing->setDropPercentage(dropPercent);
+			msg->mPacketRing->setUseBatchedIO(gSavedSettings.getBOOL("BatchedPacketIO"));
 
             F32 inBandwidth = gSavedSettings.getF32("InBandwidth"); 
             F32 outBandwidth = gSavedSettings.getF32("OutBandwidth"); 
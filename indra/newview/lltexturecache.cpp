@@ -34,22 +34,18 @@
 #include "lllfsthread.h"
 #include "llviewercontrol.h"
 
-// Included to allow LLTextureCache::purgeTextures() to pause watchdog timeout
-#include "llappviewer.h" 
 #include "llmemory.h"
 
 // Cache organization:
-// cache/texture.entries
-//  Unordered array of Entry structs
+// cache/texture.index, cache/texture.index.journal
+//  LLTextureCacheIndex: memory mapped hash table of Entry structs
 // cache/texture.cache
-//  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture in texture.entries in same order
+//  First TEXTURE_CACHE_ENTRY_SIZE bytes of each texture, at the index of its slot in texture.index
 // cache/textures/[0-F]/UUID.texture
 //  Actual texture body files
 
 //note: there is no good to define 1024 for TEXTURE_CACHE_ENTRY_SIZE while FIRST_PACKET_SIZE is 600 on sim side.
 const S32 TEXTURE_CACHE_ENTRY_SIZE = FIRST_PACKET_SIZE;//1024;
-const F32 TEXTURE_CACHE_PURGE_AMOUNT = .20f; // % amount to reduce the cache by when it exceeds its limit
-const F32 TEXTURE_CACHE_LRU_SIZE = .10f; // % amount for LRU list (low overhead to regenerate)
 
 class LLTextureCacheWorker : public LLWorkerClass
 {
@@ -737,17 +733,14 @@ void LLTextureCacheWorker::endWork(S32 param, bool aborted)
 
 LLTextureCache::LLTextureCache(bool threaded)
 	: LLWorkerThread("TextureCache", threaded),
-	  mHeaderAPRFile(NULL),
-	  mReadOnly(TRUE), //do not allow to change the texture cache until setReadOnly() is called.
-	  mTexturesSizeTotal(0),
-	  mDoPurge(FALSE)
+	  mReadOnly(TRUE) //do not allow to change the texture cache until setReadOnly() is called.
 {
 }
 
 LLTextureCache::~LLTextureCache()
 {
 	clearDeleteList();
-	writeUpdatedEntries();
+	mIndex.close();
 }
 
 //////////////////////////////////////////////////////////////////////////////
@@ -796,7 +789,7 @@ S32 LLTextureCache::update(F32 max_time_ms)
 	if(!res && timer.getElapsedTimeF32() > MAX_TIME_INTERVAL)
 	{
 		timer.reset();
-		writeUpdatedEntries();
+		mIndex.checkpoint();
 	}
 
 	return res;
@@ -824,10 +817,8 @@ std::string LLTextureCache::getTextureFileName(const LLUUID& id)
 //debug
 BOOL LLTextureCache::isInCache(const LLUUID& id) 
 {
-	LLMutexLock lock(&mHeaderMutex);
-	id_map_t::const_iterator iter = mHeaderIDMap.find(id);
-	
-	return (iter != mHeaderIDMap.end()) ;
+	Entry entry;
+	return mIndex.find(id, entry, false) >= 0;
 }
 
 //debug
@@ -873,10 +864,10 @@ BOOL LLTextureCache::isInLocal(const LLUUID& id)
 
 //static
 const S32 MAX_REASONABLE_FILE_SIZE = 512*1024*1024; // 512 MB
-F32 LLTextureCache::sHeaderCacheVersion = 1.8f;
 U32 LLTextureCache::sCacheMaxEntries = MAX_REASONABLE_FILE_SIZE / TEXTURE_CACHE_ENTRY_SIZE;
 S64 LLTextureCache::sCacheMaxTexturesSize = 0; // no limit
-const char* entries_filename = "texture.entries";
+const char* index_filename = "texture.index";
+const char* entries_filename = "texture.entries"; // replaced by texture.index
 const char* cache_filename = "texture.cache";
 const char* old_textures_dirname = "textures";
 //change the location of the texture cache to prevent from being deleted by old version viewers.
@@ -886,19 +877,16 @@ void LLTextureCache::setDirNames(ELLPath location)
 {
 	std::string delem = gDirUtilp->getDirDelimiter();
 
-	mHeaderEntriesFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, entries_filename);
+	mHeaderIndexFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, index_filename);
 	mHeaderDataFileName = gDirUtilp->getExpandedFilename(location, textures_dirname, cache_filename);
 	mTexturesDirName = gDirUtilp->getExpandedFilename(location, textures_dirname);
 }
 
 void LLTextureCache::purgeCache(ELLPath location)
 {
-	LLMutexLock lock(&mHeaderMutex);
-
 	if (!mReadOnly)
 	{
 		setDirNames(location);
-		llassert_always(mHeaderAPRFile == NULL);
 
 		//remove the legacy cache if exists
 		std::string texture_dir = mTexturesDirName;
@@ -963,548 +951,61 @@ S64 LLTextureCache::initCache(ELLPath location, S64 max_size, BOOL texture_cache
 	
 	if (!mReadOnly)
 	{
-		LLFile::mkdir(mTexturesDirName);
-		
-		const char* subdirs = "0123456789abcdef";
-		for (S32 i=0; i<16; i++)
-		{
-			std::string dirname = mTexturesDirName + gDirUtilp->getDirDelimiter() + subdirs[i];
-			LLFile::mkdir(dirname);
-		}
+		createDirectories();
 	}
-	readHeaderCache();
-	purgeTextures(true); // calc mTexturesSize and make some room in the texture cache if we need it
+	openIndex();
+	purgeTextures(true); // validate some bodies and make some room in the texture cache if we need it
 
 	llassert_always(getPending() == 0); //should not start accessing the texture cache before initialized.
 
 	return max_size; // unused cache space
 }
 
-//----------------------------------------------------------------------------
-// mHeaderMutex must be locked for the following functions!
-
-LLAPRFile* LLTextureCache::openHeaderEntriesFile(bool readonly, S32 offset)
-{
-	llassert_always(mHeaderAPRFile == NULL);
-	apr_int32_t flags = readonly ? APR_READ|APR_BINARY : APR_READ|APR_WRITE|APR_BINARY;
-	// All code calling openHeaderEntriesFile, immediately calls closeHeaderEntriesFile,
-	// so this file is very short-lived.
-	mHeaderAPRFile = new LLAPRFile(mHeaderEntriesFileName, flags);
-	if(offset > 0)
-	{
-	mHeaderAPRFile->seek(APR_SET, offset);
-	}
-	return mHeaderAPRFile;
-}
-
-void LLTextureCache::closeHeaderEntriesFile()
-{
-	if(!mHeaderAPRFile)
-	{
-		return;
-	}
-
-	delete mHeaderAPRFile;
-	mHeaderAPRFile = NULL;
-}
-
-void LLTextureCache::readEntriesHeader()
-{
-	// mHeaderEntriesInfo initializes to default values so safe not to read it
-		llassert_always(mHeaderAPRFile == NULL);
-	if (LLAPRFile::isExist(mHeaderEntriesFileName))
-	{
-		LLAPRFile::readEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
-	}
-	else //create an empty entries header.
-	{
-		mHeaderEntriesInfo.mVersion = sHeaderCacheVersion;
-		mHeaderEntriesInfo.mEntries = 0;
-		writeEntriesHeader();
-	}
-}
-
-void LLTextureCache::writeEntriesHeader()
-{
-	llassert_always(mHeaderAPRFile == NULL);
-	if (!mReadOnly)
-	{
-		LLAPRFile::writeEx(mHeaderEntriesFileName, (U8*)&mHeaderEntriesInfo, 0, sizeof(EntriesInfo));
-	}
-}
-
-//mHeaderMutex is locked before calling this.
-S32 LLTextureCache::openAndReadEntry(const LLUUID& id, Entry& entry, bool create)
-{
-	S32 idx = -1;
-	
-	id_map_t::iterator iter1 = mHeaderIDMap.find(id);
-	if (iter1 != mHeaderIDMap.end())
-	{
-		idx = iter1->second;
-	}
-
-	if (idx < 0)
-	{
-		if (create && !mReadOnly)
-		{
-			if (mHeaderEntriesInfo.mEntries < sCacheMaxEntries)
-			{
-				// Add an entry to the end of the list
-				idx = mHeaderEntriesInfo.mEntries++;
-
-			}
-			else if (!mFreeList.empty())
-			{
-				idx = *(mFreeList.begin());
-				mFreeList.erase(mFreeList.begin());
-			}
-			else
-			{
-				// Look for a still valid entry in the LRU
-				for (std::set<LLUUID>::iterator iter2 = mLRU.begin(); iter2 != mLRU.end();)
-				{
-					std::set<LLUUID>::iterator curiter2 = iter2++;
-					LLUUID oldid = *curiter2;
-					// Erase entry from LRU regardless
-					mLRU.erase(curiter2);
-					// Look up entry and use it if it is valid
-					id_map_t::iterator iter3 = mHeaderIDMap.find(oldid);
-					if (iter3 != mHeaderIDMap.end() && iter3->second >= 0)
-					{
-						idx = iter3->second;
-						removeCachedTexture(oldid);//remove the existing cached texture to release the entry index.
-						break;
-					}
-				}
-				// if (idx < 0) at this point, we will rebuild the LRU 
-				//  and retry if called from setHeaderCacheEntry(),
-				//  otherwise this shouldn't happen and will trigger an error
-			}
-			if (idx >= 0)
-			{
-				entry.mID = id;
-				entry.mImageSize = -1; //mark it is a brand-new entry.					
-				entry.mBodySize = 0;
-			}
-		}
-	}
-	else
-	{
-		// Remove this entry from the LRU if it exists
-		mLRU.erase(id);
-		// Read the entry
-		idx_entry_map_t::iterator iter = mUpdatedEntryMap.find(idx);
-		if(iter != mUpdatedEntryMap.end())
-		{
-			entry = iter->second;
-		}
-		else
-		{
-			readEntryFromHeaderImmediately(idx, entry);
-		}
-		if(entry.mImageSize <= entry.mBodySize)//it happens on 64-bit systems, do not know why
-		{
-			llwarns << "corrupted entry: " << id << " entry image size: " << entry.mImageSize << " entry body size: " << entry.mBodySize << llendl;
-
-			//erase this entry and the cached texture from the cache.
-			std::string tex_filename = getTextureFileName(id);
-			removeEntry(idx, entry, tex_filename);
-			mUpdatedEntryMap.erase(idx);
-			idx = -1;
-		}
-	}
-	return idx;
-}
-
-//mHeaderMutex is locked before calling this.
-void LLTextureCache::writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header)
-{	
-	LLAPRFile* aprfile;
-	S32 bytes_written;
-	S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-	if(write_header)
-	{
-		aprfile = openHeaderEntriesFile(false, 0);		
-		bytes_written = aprfile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo));
-		if(bytes_written != sizeof(EntriesInfo))
-		{
-			clearCorruptedCache(); //clear the cache.
-			idx = -1; //mark the idx invalid.
-			return;
-		}
-
-		mHeaderAPRFile->seek(APR_SET, offset);
-	}
-	else
-	{
-		aprfile = openHeaderEntriesFile(false, offset);
-	}
-	bytes_written = aprfile->write((void*)&entry, (S32)sizeof(Entry));
-	if(bytes_written != sizeof(Entry))
-	{
-		clearCorruptedCache(); //clear the cache.
-		idx = -1; //mark the idx invalid.
-
-		return;
-	}
-
-	closeHeaderEntriesFile();
-	mUpdatedEntryMap.erase(idx);
-}
-
-//mHeaderMutex is locked before calling this.
-void LLTextureCache::readEntryFromHeaderImmediately(S32& idx, Entry& entry)
+void LLTextureCache::createDirectories()
 {
-		S32 offset = sizeof(EntriesInfo) + idx * sizeof(Entry);
-		LLAPRFile* aprfile = openHeaderEntriesFile(true, offset);
-		S32 bytes_read = aprfile->read((void*)&entry, (S32)sizeof(Entry));
-		closeHeaderEntriesFile();
-
-	if(bytes_read != sizeof(Entry))
-	{
-		clearCorruptedCache(); //clear the cache.
-		idx = -1;//mark the idx invalid.
-	}
-}
-
-//mHeaderMutex is locked before calling this.
-//update an existing entry time stamp, delay writing.
-void LLTextureCache::updateEntryTimeStamp(S32 idx, Entry& entry)
-{
-	static const U32 MAX_ENTRIES_WITHOUT_TIME_STAMP = (U32)(LLTextureCache::sCacheMaxEntries * 0.75f);
-
-	if(mHeaderEntriesInfo.mEntries < MAX_ENTRIES_WITHOUT_TIME_STAMP)
-	{
-		return; //there are enough empty entry index space, no need to stamp time.
-	}
-
-	if (idx >= 0)
-	{
-		if (!mReadOnly)
-		{
-			entry.mTime = time(NULL);
-			mUpdatedEntryMap[idx] = entry;
-		}
-	}
-}
-
-//update an existing entry, write to header file immediately.
-bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size)
-{
-	S32 new_body_size = llmax(0, new_data_size - TEXTURE_CACHE_ENTRY_SIZE);
-	
-	if(new_image_size == entry.mImageSize && new_body_size == entry.mBodySize)
-			{
-		return true; //nothing changed.
-			}
-	else 
-	{
-		bool purge = false;
-			
-		lockHeaders();
-
-		bool update_header = false;
-		if(entry.mImageSize < 0) //is a brand-new entry
-			{
-			mHeaderIDMap[entry.mID] = idx;
-			mTexturesSizeMap[entry.mID] = new_body_size;
-			mTexturesSizeTotal += new_body_size;
-			
-			// Update Header
-			update_header = true;
-			}
-		else if (entry.mBodySize != new_body_size)
-		{
-			//already in mHeaderIDMap.
-			mTexturesSizeMap[entry.mID] = new_body_size;
-			mTexturesSizeTotal -= entry.mBodySize;
-			mTexturesSizeTotal += new_body_size;
-		}
-		entry.mTime = time(NULL);
-		entry.mImageSize = new_image_size; 
-		entry.mBodySize = new_body_size;
-		
-		writeEntryToHeaderImmediately(idx, entry, update_header);
+	LLFile::mkdir(mTexturesDirName);
 	
-		if (mTexturesSizeTotal > sCacheMaxTexturesSize)
-		{
-			purge = true;
-		}
-		
-		unlockHeaders();
-
-		if (purge)
-		{
-			mDoPurge = TRUE;
-		}
-	}
-
-	return false;
-}
-
-U32 LLTextureCache::openAndReadEntries(std::vector<Entry>& entries)
-{
-	U32 num_entries = mHeaderEntriesInfo.mEntries;
-
-	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
-	mFreeList.clear();
-	mTexturesSizeTotal = 0;
-
-	LLAPRFile* aprfile = NULL; 
-	if(mUpdatedEntryMap.empty())
+	const char* subdirs = "0123456789abcdef";
+	for (S32 i=0; i<16; i++)
 	{
-		aprfile = openHeaderEntriesFile(true, (S32)sizeof(EntriesInfo));
+		std::string dirname = mTexturesDirName + gDirUtilp->getDirDelimiter() + subdirs[i];
+		LLFile::mkdir(dirname);
 	}
-	else //update the header file first.
-	{
-		aprfile = openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile();
-		if(!aprfile)
-		{
-			return 0;
-		}
-		aprfile->seek(APR_SET, (S32)sizeof(EntriesInfo));
-	}
-	for (U32 idx=0; idx<num_entries; idx++)
-	{
-		Entry entry;
-		S32 bytes_read = aprfile->read((void*)(&entry), (S32)sizeof(Entry));
-		if (bytes_read < sizeof(Entry))
-		{
-			llwarns << "Corrupted header entries, failed at " << idx << " / " << num_entries << llendl;
-			closeHeaderEntriesFile();
-			purgeAllTextures(false);
-			return 0;
-		}
-		entries.push_back(entry);
-// 		llinfos << "ENTRY: " << entry.mTime << " TEX: " << entry.mID << " IDX: " << idx << " Size: " << entry.mImageSize << llendl;
-		if(entry.mImageSize > entry.mBodySize)
-		{
-			mHeaderIDMap[entry.mID] = idx;
-				mTexturesSizeMap[entry.mID] = entry.mBodySize;
-				mTexturesSizeTotal += entry.mBodySize;
-			}
-		else
-		{
-			mFreeList.insert(idx);
-		}
-	}
-	closeHeaderEntriesFile();
-	return num_entries;
 }
 
-void LLTextureCache::writeEntriesAndClose(const std::vector<Entry>& entries)
+void LLTextureCache::openIndex()
 {
-	S32 num_entries = entries.size();
-	llassert_always(num_entries == mHeaderEntriesInfo.mEntries);
-	
-	if (!mReadOnly)
+	LLTimer timer;
+	if (!mIndex.open(mHeaderIndexFileName, sCacheMaxEntries, mReadOnly))
 	{
-		LLAPRFile* aprfile = openHeaderEntriesFile(false, (S32)sizeof(EntriesInfo));
-		for (S32 idx=0; idx<num_entries; idx++)
-		{
-			S32 bytes_written = aprfile->write((void*)(&entries[idx]), (S32)sizeof(Entry));
-			if(bytes_written != sizeof(Entry))
-			{
-				clearCorruptedCache(); //clear the cache.
-				return;
-			}
-		}
-		closeHeaderEntriesFile();
+		llwarns << "Unable to open texture cache index " << mHeaderIndexFileName << ", texture cache disabled." << llendl;
+		return;
 	}
-}
-
-void LLTextureCache::writeUpdatedEntries()
-{
-	lockHeaders();
-	if (!mReadOnly && !mUpdatedEntryMap.empty())
+	if (mIndex.wasReset())
 	{
-		openHeaderEntriesFile(false, 0);
-		updatedHeaderEntriesFile();
-		closeHeaderEntriesFile();
+		// Any headers and bodies we still have belong to an older index.
+		purgeAllTextures(false);
+		LLFile::remove(mTexturesDirName + gDirUtilp->getDirDelimiter() + entries_filename);
 	}
-	unlockHeaders();
+	LL_INFOS("TextureCache") << "TEXTURE CACHE: Opened index with " << mIndex.getCount() << " entries, "
+			<< mIndex.getBodySize() / (1024 * 1024) << " MB of bodies in "
+			<< timer.getElapsedTimeF32() * 1000.f << " ms" << LL_ENDL;
 }
 
-//mHeaderMutex is locked and mHeaderAPRFile is created before calling this.
-void LLTextureCache::updatedHeaderEntriesFile()
-{
-	if (!mReadOnly && !mUpdatedEntryMap.empty() && mHeaderAPRFile)
-	{
-		//entriesInfo
-		mHeaderAPRFile->seek(APR_SET, 0);
-		S32 bytes_written = mHeaderAPRFile->write((U8*)&mHeaderEntriesInfo, sizeof(EntriesInfo));
-		if(bytes_written != sizeof(EntriesInfo))
-		{
-			clearCorruptedCache(); //clear the cache.
-			return;
-		}
-		
-		//write each updated entry
-		S32 entry_size = (S32)sizeof(Entry);
-		S32 prev_idx = -1;
-		S32 delta_idx;
-		for (idx_entry_map_t::iterator iter = mUpdatedEntryMap.begin(); iter != mUpdatedEntryMap.end(); ++iter)
-		{
-			delta_idx = iter->first - prev_idx - 1;
-			prev_idx = iter->first;
-			if(delta_idx)
-			{
-				mHeaderAPRFile->seek(APR_CUR, delta_idx * entry_size);
-			}
-			
-			bytes_written = mHeaderAPRFile->write((void*)(&iter->second), entry_size);
-			if(bytes_written != entry_size)
-			{
-				clearCorruptedCache(); //clear the cache.
-				return;
-			}
-		}
-		mUpdatedEntryMap.clear();
-	}
-}
 //----------------------------------------------------------------------------
 
-// Called from either the main thread or the worker thread
-void LLTextureCache::readHeaderCache()
+void LLTextureCache::purgeAllTextures(bool purge_directories)
 {
-	mHeaderMutex.lock();
-
-	mLRU.clear(); // always clear the LRU
-
-	readEntriesHeader();
-	
-	if (mHeaderEntriesInfo.mVersion != sHeaderCacheVersion)
+	if (purge_directories)
 	{
-		if (!mReadOnly)
-		{
-			purgeAllTextures(false);
-		}
+		// The index file is in there too.
+		mIndex.close();
 	}
 	else
 	{
-		std::vector<Entry> entries;
-		U32 num_entries = openAndReadEntries(entries);
-		if (num_entries)
-		{
-			U32 empty_entries = 0;
-			typedef std::pair<U32, S32> lru_data_t;
-			std::set<lru_data_t> lru;
-			std::set<U32> purge_list;
-			for (U32 i=0; i<num_entries; i++)
-			{
-				Entry& entry = entries[i];
-				if (entry.mImageSize <= 0)
-				{
-					// This will be in the Free List, don't put it in the LRU
-					++empty_entries;
-				}
-				else
-				{
-					lru.insert(std::make_pair(entry.mTime, i));
-					if (entry.mBodySize > 0)
-					{
-						if (entry.mBodySize > entry.mImageSize)
-						{
-							// Shouldn't happen, failsafe only
-							llwarns << "Bad entry: " << i << ": " << entry.mID << ": BodySize: " << entry.mBodySize << llendl;
-							purge_list.insert(i);
-						}
-					}
-				}
-			}
-			if (num_entries - empty_entries > sCacheMaxEntries)
-			{
-				// Special case: cache size was reduced, need to remove entries
-				// Note: After we prune entries, we will call this again and create the LRU
-				U32 entries_to_purge = (num_entries - empty_entries) - sCacheMaxEntries;
-				llinfos << "Texture Cache Entries: " << num_entries << " Max: " << sCacheMaxEntries << " Empty: " << empty_entries << " Purging: " << entries_to_purge << llendl;
-				// We can exit the following loop with the given condition, since if we'd reach the end of the lru set we'd have:
-				// purge_list.size() = lru.size() = num_entries - empty_entries = entries_to_purge + sCacheMaxEntries >= entries_to_purge
-				// So, it's certain that iter will never reach lru.end() first.
-				std::set<lru_data_t>::iterator iter = lru.begin();
-				while (purge_list.size() < entries_to_purge)
-				{
-					purge_list.insert(iter->second);
-					++iter;
-				}
-			}
-			else
-			{
-				S32 lru_entries = (S32)((F32)sCacheMaxEntries * TEXTURE_CACHE_LRU_SIZE);
-				for (std::set<lru_data_t>::iterator iter = lru.begin(); iter != lru.end(); ++iter)
-				{
-					mLRU.insert(entries[iter->second].mID);
-// 					llinfos << "LRU: " << iter->first << " : " << iter->second << llendl;
-					if (--lru_entries <= 0)
-						break;
-				}
-			}
-			
-			if (purge_list.size() > 0)
-			{
-				for (std::set<U32>::iterator iter = purge_list.begin(); iter != purge_list.end(); ++iter)
-				{
-					std::string tex_filename = getTextureFileName(entries[*iter].mID);
-					removeEntry((S32)*iter, entries[*iter], tex_filename);
-				}
-				// If we removed any entries, we need to rebuild the entries list,
-				// write the header, and call this again
-				std::vector<Entry> new_entries;
-				for (U32 i=0; i<num_entries; i++)
-				{
-					const Entry& entry = entries[i];
-					if (entry.mImageSize > 0)
-					{
-						new_entries.push_back(entry);
-					}
-				}
-				llassert_always(new_entries.size() <= sCacheMaxEntries);
-				mHeaderEntriesInfo.mEntries = new_entries.size();
-				writeEntriesHeader();
-				writeEntriesAndClose(new_entries);
-				mHeaderMutex.unlock(); // unlock the mutex before calling again
-				readHeaderCache(); // repeat with new entries file
-				mHeaderMutex.lock();
-			}
-			else
-			{
-				//entries are not changed, nothing here.
-			}
-		}
-	}
-	mHeaderMutex.unlock();
-}
-
-//////////////////////////////////////////////////////////////////////////////
-
-//the header mutex is locked before calling this.
-void LLTextureCache::clearCorruptedCache()
-{
-	llwarns << "the texture cache is corrupted, need to be cleared." << llendl;
-
-	closeHeaderEntriesFile();//close possible file handler
-	purgeAllTextures(false); //clear the cache.
-	
-	if (!mReadOnly) //regenerate the directory tree if not exists.
-	{
-		LLFile::mkdir(mTexturesDirName);
-		
-		const char* subdirs = "0123456789abcdef";
-		for (S32 i=0; i<16; i++)
-		{
-			std::string dirname = mTexturesDirName + gDirUtilp->getDirDelimiter() + subdirs[i];
-			LLFile::mkdir(dirname);
-		}
+		mIndex.clear();
 	}
 
-	return;
-}
-
-void LLTextureCache::purgeAllTextures(bool purge_directories)
-{
 	if (!mReadOnly)
 	{
 		const char* subdirs = "0123456789abcdef";
@@ -1526,135 +1027,100 @@ void LLTextureCache::purgeAllTextures(bool purge_directories)
 			LLFile::rmdir(mTexturesDirName);
 		}
 	}
-	mHeaderIDMap.clear();
-	mTexturesSizeMap.clear();
-	mTexturesSizeTotal = 0;
-	mFreeList.clear();
-	mTexturesSizeTotal = 0;
-	mUpdatedEntryMap.clear();
-
-	// Info with 0 entries
-	mHeaderEntriesInfo.mVersion = sHeaderCacheVersion;
-	mHeaderEntriesInfo.mEntries = 0;
-	writeEntriesHeader();
 
 	llinfos << "The entire texture cache is cleared." << llendl;
 }
 
 void LLTextureCache::purgeTextures(bool validate)
 {
-	if (mReadOnly)
+	if (mReadOnly || !mIndex.isOpen())
 	{
 		return;
 	}
 
-	if (!mThreaded)
-	{
-		// *FIX:Mani - watchdog off.
-		LLAppViewer::instance()->pauseMainloopTimeout();
-	}
-	
-	LLMutexLock lock(&mHeaderMutex);
-
-	llinfos << "TEXTURE CACHE: Purging." << llendl;
+	S32 purge_count = 0;
 
-	// Read the entries list
-	std::vector<Entry> entries;
-	U32 num_entries = openAndReadEntries(entries);
-	if (!num_entries)
-	{
-		return; // nothing to purge
-	}
-	
-	// Use mTexturesSizeMap to collect UUIDs of textures with bodies
-	typedef std::set<std::pair<U32,S32> > time_idx_set_t;
-	std::set<std::pair<U32,S32> > time_idx_set;
-	for (size_map_t::iterator iter1 = mTexturesSizeMap.begin();
-		 iter1 != mTexturesSizeMap.end(); ++iter1)
-	{
-		if (iter1->second > 0)
-		{
-			id_map_t::iterator iter2 = mHeaderIDMap.find(iter1->first);
-			if (iter2 != mHeaderIDMap.end())
-			{
-				S32 idx = iter2->second;
-				time_idx_set.insert(std::make_pair(entries[idx].mTime, idx));
-// 				llinfos << "TIME: " << entries[idx].mTime << " TEX: " << entries[idx].mID << " IDX: " << idx << " Size: " << entries[idx].mImageSize << llendl;
-			}
-			else
-			{
-				llerrs << "mTexturesSizeMap / mHeaderIDMap corrupted." << llendl ;
-			}
-		}
-	}
-	
 	// Validate 1/256th of the files on startup
-	U32 validate_idx = 0;
 	if (validate)
 	{
-		validate_idx = gSavedSettings.getU32("CacheValidateCounter");
+		U32 validate_idx = gSavedSettings.getU32("CacheValidateCounter");
 		U32 next_idx = (validate_idx + 1) % 256;
 		gSavedSettings.setU32("CacheValidateCounter", next_idx);
 		LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Validating: " << validate_idx << LL_ENDL;
-	}
 
-	S64 cache_size = mTexturesSizeTotal;
-	S64 purged_cache_size = (sCacheMaxTexturesSize * (S64)((1.f-TEXTURE_CACHE_PURGE_AMOUNT)*100)) / 100;
-	S32 purge_count = 0;
-	for (time_idx_set_t::iterator iter = time_idx_set.begin();
-		 iter != time_idx_set.end(); ++iter)
-	{
-		S32 idx = iter->second;
-		bool purge_entry = false;
-		std::string filename = getTextureFileName(entries[idx].mID);
-		if (cache_size >= purged_cache_size)
-		{
-			purge_entry = true;
-		}
-		else if (validate)
+		std::vector<std::pair<S32, Entry> > entries;
+		mIndex.getEntries(entries);
+		for (std::vector<std::pair<S32, Entry> >::iterator iter = entries.begin(); iter != entries.end(); ++iter)
 		{
+			const Entry& entry = iter->second;
+			if (entry.mBodySize <= 0 || entry.mID.mData[0] != validate_idx)
+			{
+				continue;
+			}
 			// make sure file exists and is the correct size
-			U32 uuididx = entries[idx].mID.mData[0];
-			if (uuididx == validate_idx)
+			std::string filename = getTextureFileName(entry.mID);
+			LL_DEBUGS("TextureCache") << "Validating: " << filename << "Size: " << entry.mBodySize << LL_ENDL;
+			S32 bodysize = LLAPRFile::size(filename);
+			if (bodysize != entry.mBodySize)
 			{
- 				LL_DEBUGS("TextureCache") << "Validating: " << filename << "Size: " << entries[idx].mBodySize << LL_ENDL;
-				S32 bodysize = LLAPRFile::size(filename);
-				if (bodysize != entries[idx].mBodySize)
-				{
-					LL_WARNS("TextureCache") << "TEXTURE CACHE BODY HAS BAD SIZE: " << bodysize << " != " << entries[idx].mBodySize
-							<< filename << LL_ENDL;
-					purge_entry = true;
-				}
+				LL_WARNS("TextureCache") << "TEXTURE CACHE BODY HAS BAD SIZE: " << bodysize << " != " << entry.mBodySize
+						<< filename << LL_ENDL;
+				removeFromCache(entry.mID);
+				purge_count++;
 			}
 		}
-		else
-		{
-			break;
-		}
-		
-		if (purge_entry)
-		{
-			purge_count++;
-	 		LL_DEBUGS("TextureCache") << "PURGING: " << filename << LL_ENDL;
-			cache_size -= entries[idx].mBodySize;
-			removeEntry(idx, entries[idx], filename) ;			
-		}
 	}
 
-	LL_DEBUGS("TextureCache") << "TEXTURE CACHE: Writing Entries: " << num_entries << LL_ENDL;
+	purge_count += evictTextures();
 
-	writeEntriesAndClose(entries);
-	
-	// *FIX:Mani - watchdog back on.
-	LLAppViewer::instance()->resumeMainloopTimeout();
-	
 	LL_INFOS("TextureCache") << "TEXTURE CACHE:"
 			<< " PURGED: " << purge_count
-			<< " ENTRIES: " << num_entries
-			<< " CACHE SIZE: " << mTexturesSizeTotal / (1024 * 1024) << " MB"
+			<< " ENTRIES: " << mIndex.getCount()
+			<< " CACHE SIZE: " << mIndex.getBodySize() / (1024 * 1024) << " MB"
 			<< llendl;
 }
 
+// Removes the least recently used bodies until they fit in sCacheMaxTexturesSize again.
+// Cheap when there is nothing to do, so it's called after every write that grows the cache.
+S32 LLTextureCache::evictTextures()
+{
+	std::vector<Entry> evicted;
+	mIndex.evict(sCacheMaxTexturesSize, evicted);
+	for (std::vector<Entry>::iterator iter = evicted.begin(); iter != evicted.end(); ++iter)
+	{
+		LL_DEBUGS("TextureCache") << "PURGING: " << iter->mID << LL_ENDL;
+		LLAPRFile::remove(getTextureFileName(iter->mID));
+	}
+	return evicted.size();
+}
+
+//update an existing entry.
+bool LLTextureCache::updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size)
+{
+	S32 new_body_size = llmax(0, new_data_size - TEXTURE_CACHE_ENTRY_SIZE);
+	
+	if(new_image_size == entry.mImageSize && new_body_size == entry.mBodySize)
+	{
+		return true; //nothing changed.
+	}
+
+	bool grew = new_body_size > entry.mBodySize;
+	entry.mTime = time(NULL);
+	entry.mImageSize = new_image_size; 
+	entry.mBodySize = new_body_size;
+	if (!mIndex.update(idx, entry))
+	{
+		// The slot was reused while we weren't looking, start over.
+		idx = setHeaderCacheEntry(entry.mID, entry, new_image_size, new_data_size);
+	}
+	else if (grew)
+	{
+		evictTextures();
+	}
+
+	return false;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 
 // call lockWorkers() first!
@@ -1686,36 +1152,23 @@ LLTextureCacheWorker* LLTextureCache::getWriter(handle_t handle)
 // Reads imagesize from the header, updates timestamp
 S32 LLTextureCache::getHeaderCacheEntry(const LLUUID& id, Entry& entry)
 {
-	LLMutexLock lock(&mHeaderMutex);
-	S32 idx = openAndReadEntry(id, entry, false);
-	if (idx >= 0)
-	{
-		updateEntryTimeStamp(idx, entry); // updates time
-	}
-	return idx;
+	return mIndex.find(id, entry);
 }
 
 // Writes imagesize to the header, updates timestamp
 S32 LLTextureCache::setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize)
 {
-	mHeaderMutex.lock();
-	S32 idx = openAndReadEntry(id, entry, true);
-	mHeaderMutex.unlock();
-
-	if (idx >= 0)
+	entry = Entry(id, imagesize, llmax(0, datasize - TEXTURE_CACHE_ENTRY_SIZE), time(NULL));
+	Entry evicted;
+	S32 idx = mIndex.insert(entry, evicted);
+	if (evicted.mID.notNull())
 	{
-		updateEntry(idx, entry, imagesize, datasize);				
+		// Took the slot of the least recently used texture of a full bucket.
+		LLAPRFile::remove(getTextureFileName(evicted.mID));
 	}
-
-	if(idx < 0) // retry
+	if (idx >= 0 && entry.mBodySize > 0)
 	{
-		readHeaderCache(); // We couldn't write an entry, so refresh the LRU
-	
-		mHeaderMutex.lock();
-		llassert_always(!mLRU.empty() || mHeaderEntriesInfo.mEntries < sCacheMaxEntries);
-		mHeaderMutex.unlock();
-
-		idx = setHeaderCacheEntry(id, entry, imagesize, datasize); // assert above ensures no inf. recursion
+		evictTextures();
 	}
 	return idx;
 }
@@ -1791,14 +1244,6 @@ LLTextureCache::handle_t LLTextureCache::writeToCache(const LLUUID& id, U32 prio
 		delete responder;
 		return LLWorkerThread::nullHandle();
 	}
-	if (mDoPurge)
-	{
-		// NOTE: This may cause an occasional hiccup,
-		//  but it really needs to be done on the control thread
-		//  (i.e. here)		
-		purgeTextures(false);
-		mDoPurge = FALSE;
-	}
 	LLMutexLock lock(&mWorkersMutex);
 	LLTextureCacheWorker* worker = new LLTextureCacheRemoteWorker(this, priority, id,
 																  data, datasize, 0,
@@ -1844,70 +1289,19 @@ void LLTextureCache::addCompleted(Responder* responder, bool success)
 
 //////////////////////////////////////////////////////////////////////////////
 
-//called after mHeaderMutex is locked.
-void LLTextureCache::removeCachedTexture(const LLUUID& id)
-{
-	if (mTexturesSizeMap.find(id) != mTexturesSizeMap.end())
-	{
-		mTexturesSizeTotal -= mTexturesSizeMap[id];
-		mTexturesSizeMap.erase(id);
-	}
-	mHeaderIDMap.erase(id);
-	LLAPRFile::remove(getTextureFileName(id));		
-}
-
-//called after mHeaderMutex is locked.
-void LLTextureCache::removeEntry(S32 idx, Entry& entry, std::string& filename)
-{
- 	bool file_maybe_exists = true;	// Always attempt to remove when idx is invalid.
-
-	if(idx >= 0) //valid entry
-	{
-		if (entry.mBodySize == 0)	// Always attempt to remove when mBodySize > 0.
-		{
-		  if (LLAPRFile::isExist(filename))		// Sanity check. Shouldn't exist when body size is 0.
-		  {
-			  LL_WARNS("TextureCache") << "Entry has body size of zero but file " << filename << " exists. Deleting this file, too." << LL_ENDL;
-		  }
-		  else
-		  {
-			  file_maybe_exists = false;
-		  }
-		}
-		mTexturesSizeTotal -= entry.mBodySize;
-
-		entry.mImageSize = -1;
-		entry.mBodySize = 0;
-		mHeaderIDMap.erase(entry.mID);
-		mTexturesSizeMap.erase(entry.mID);		
-		mFreeList.insert(idx);	
-	}
-
-	if (file_maybe_exists)
-	{
-		LLAPRFile::remove(filename);
-	}
-}
-
 bool LLTextureCache::removeFromCache(const LLUUID& id)
 {
 	//llwarns << "Removing texture from cache: " << id << llendl;
 	bool ret = false;
 	if (!mReadOnly)
 	{
-		lockHeaders();
-
 		Entry entry;
-		S32 idx = openAndReadEntry(id, entry, false);
-		std::string tex_filename = getTextureFileName(id);
-		removeEntry(idx, entry, tex_filename);
-		if (idx >= 0)
-		{			
-			writeEntryToHeaderImmediately(idx, entry);					
-			ret = true;
+		ret = mIndex.remove(id, entry);
+		// Always attempt to remove the body when the entry is unknown.
+		if (!ret || entry.mBodySize > 0)
+		{
+			LLAPRFile::remove(getTextureFileName(id));
 		}
-
-		unlockHeaders();
 	}
 	return ret;
 }
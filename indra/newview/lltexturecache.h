@@ -33,6 +33,7 @@
 #include "lluuid.h"
 
 #include "llworkerthread.h"
+#include "lltexturecacheindex.h"
 
 class LLImageFormatted;
 class LLTextureCacheWorker;
@@ -44,31 +45,7 @@ class LLTextureCache : public LLWorkerThread
 	friend class LLTextureCacheLocalFileWorker;
 
 private:
-	// Entries
-	struct EntriesInfo
-	{
-		EntriesInfo() : mVersion(0.f), mEntries(0) {}
-		F32 mVersion;
-		U32 mEntries;
-	};
-	struct Entry
-	{
-        	Entry() :
-		        mBodySize(0),
-			mImageSize(0),
-			mTime(0)
-		{
-		}
-		Entry(const LLUUID& id, S32 imagesize, S32 bodysize, U32 time) :
-			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time) {}
-		void init(const LLUUID& id, U32 time) { mID = id, mImageSize = 0; mBodySize = 0; mTime = time; }
-		Entry& operator=(const Entry& entry) { mID = entry.mID, mImageSize = entry.mImageSize; mBodySize = entry.mBodySize; mTime = entry.mTime; return *this; }
-		LLUUID mID; // 16 bytes
-		S32 mImageSize; // total size of image if known
-		S32 mBodySize; // size of body file in body cache
-		U32 mTime; // seconds since 1/1/1970
-	};
-
+	typedef LLTextureCacheIndex::Entry Entry;
 	
 public:
 
@@ -129,9 +106,9 @@ public:
 	// debug
 	S32 getNumReads() { return mReaders.size(); }
 	S32 getNumWrites() { return mWriters.size(); }
-	S64 getUsage() { return mTexturesSizeTotal; }
+	S64 getUsage() { return mIndex.getBodySize(); }
 	S64 getMaxUsage() { return sCacheMaxTexturesSize; }
-	U32 getEntries() { return mHeaderEntriesInfo.mEntries; }
+	U32 getEntries() { return mIndex.getCount(); }
 	U32 getMaxEntries() { return sCacheMaxEntries; };
 	BOOL isInCache(const LLUUID& id) ;
 	BOOL isInLocal(const LLUUID& id) ;
@@ -144,36 +121,19 @@ protected:
 	
 private:
 	void setDirNames(ELLPath location);
-	void readHeaderCache();
-	void clearCorruptedCache();
+	void createDirectories();
+	void openIndex();
 	void purgeAllTextures(bool purge_directories);
 	void purgeTextures(bool validate);
-	LLAPRFile* openHeaderEntriesFile(bool readonly, S32 offset);
-	void closeHeaderEntriesFile();
-	void readEntriesHeader();
-	void writeEntriesHeader();
-	S32 openAndReadEntry(const LLUUID& id, Entry& entry, bool create);
-	bool updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_body_size);
-	void updateEntryTimeStamp(S32 idx, Entry& entry) ;
-	U32 openAndReadEntries(std::vector<Entry>& entries);
-	void writeEntriesAndClose(const std::vector<Entry>& entries);
-	void readEntryFromHeaderImmediately(S32& idx, Entry& entry) ;
-	void writeEntryToHeaderImmediately(S32& idx, Entry& entry, bool write_header = false) ;
-	void removeEntry(S32 idx, Entry& entry, std::string& filename);
-	void removeCachedTexture(const LLUUID& id) ;
+	S32 evictTextures();
+	bool updateEntry(S32& idx, Entry& entry, S32 new_image_size, S32 new_data_size);
 	S32 getHeaderCacheEntry(const LLUUID& id, Entry& entry);
 	S32 setHeaderCacheEntry(const LLUUID& id, Entry& entry, S32 imagesize, S32 datasize);
-	void writeUpdatedEntries() ;
-	void updatedHeaderEntriesFile() ;
-	void lockHeaders() { mHeaderMutex.lock(); }
-	void unlockHeaders() { mHeaderMutex.unlock(); }
 	
 private:
 	// Internal
 	LLMutex mWorkersMutex;
-	LLMutex mHeaderMutex;
 	LLMutex mListMutex;
-	LLAPRFile* mHeaderAPRFile;
 	
 	typedef std::map<handle_t, LLTextureCacheWorker*> handle_map_t;
 	handle_map_t mReaders;
@@ -188,26 +148,14 @@ private:
 	BOOL mReadOnly;
 	
 	// HEADERS (Include first mip)
-	std::string mHeaderEntriesFileName;
+	std::string mHeaderIndexFileName;
 	std::string mHeaderDataFileName;
-	EntriesInfo mHeaderEntriesInfo;
-	std::set<S32> mFreeList; // deleted entries
-	std::set<LLUUID> mLRU;
-	typedef std::map<LLUUID,S32> id_map_t;
-	id_map_t mHeaderIDMap;
+	LLTextureCacheIndex mIndex;
 
 	// BODIES (TEXTURES minus headers)
 	std::string mTexturesDirName;
-	typedef std::map<LLUUID,S32> size_map_t;
-	size_map_t mTexturesSizeMap;
-	S64 mTexturesSizeTotal;
-	LLAtomic32<BOOL> mDoPurge;
-
-	typedef std::map<S32, Entry> idx_entry_map_t;
-	idx_entry_map_t mUpdatedEntryMap;
 
 	// Statics
-	static F32 sHeaderCacheVersion;
 	static U32 sCacheMaxEntries;
 	static S64 sCacheMaxTexturesSize;
 };
@@ -0,0 +1,577 @@
+/**
+ * @file lltexturecacheindex.cpp
+ * @brief Memory mapped, lock striped index of the texture cache entries
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "llviewerprecompiledheaders.h"
+
+#include "lltexturecacheindex.h"
+
+#include <cstddef>
+
+#include "llcrc.h"
+#include "llfile.h"
+#include "llvfs.h"
+
+static const U32 INDEX_MAGIC = 0x58494354;	// "TCIX"
+static const U32 INDEX_VERSION = 1;
+
+// Number of buckets evict() looks at to find one entry to remove.
+static const U32 EVICT_SAMPLE_BUCKETS = 8;
+
+LLTextureCacheIndex::LLTextureCacheIndex()
+:	mFP(NULL),
+	mSlots(NULL),
+	mBucketCount(0),
+	mReadOnly(true),
+	mWasReset(false),
+	mJournalFP(NULL),
+	mJournalRecords(0),
+	mCount(0),
+	mBodySize(0),
+	mEvictHand(0)
+{
+}
+
+LLTextureCacheIndex::~LLTextureCacheIndex()
+{
+	close();
+}
+
+bool LLTextureCacheIndex::open(const std::string& filename, U32 max_entries, bool read_only)
+{
+	close();
+	mReadOnly = read_only;
+	mWasReset = false;
+	mJournalFileName = getJournalFileName(filename);
+
+	U32 bucket_count = llmax((max_entries + SLOTS_PER_BUCKET - 1) / SLOTS_PER_BUCKET, (U32)1);
+
+	LLFILE* fp = LLFile::fopen(filename, read_only ? "rb" : "r+b");
+	if (fp)
+	{
+		FileHeader header;
+		bool valid = fread(&header, sizeof(header), 1, fp) == 1 &&
+					 header.mMagic == INDEX_MAGIC &&
+					 header.mVersion == INDEX_VERSION &&
+					 header.mSlotSize == sizeof(Slot) &&
+					 header.mBucketCount > 0;
+		// A read-only viewer uses whatever size the writing viewer picked.
+		if (valid && !read_only && header.mBucketCount != bucket_count)
+		{
+			llinfos << "Texture cache index size changed from " << header.mBucketCount * SLOTS_PER_BUCKET
+					<< " to " << bucket_count * SLOTS_PER_BUCKET << " entries" << llendl;
+			valid = false;
+		}
+		if (valid)
+		{
+			size_t size = HEADER_SIZE + (size_t)header.mBucketCount * SLOTS_PER_BUCKET * sizeof(Slot);
+			fseek(fp, 0, SEEK_END);
+			valid = (size_t)ftell(fp) >= size;
+			if (valid)
+			{
+				mBucketCount = header.mBucketCount;
+				valid = map(fp, size);
+			}
+		}
+		if (valid)
+		{
+			if (!mReadOnly)
+			{
+				replayJournal();
+			}
+			scanSlots();
+			return true;
+		}
+		mBucketCount = 0;
+		fclose(fp);
+		llwarns << "Replacing texture cache index " << filename << llendl;
+	}
+	if (read_only)
+	{
+		return false;
+	}
+
+	mWasReset = true;
+	LLFile::remove(mJournalFileName);
+	if (!create(filename, bucket_count))
+	{
+		llwarns << "Unable to create texture cache index " << filename << llendl;
+		return false;
+	}
+	mJournalFP = LLFile::fopen(mJournalFileName, "wb");
+	return true;
+}
+
+bool LLTextureCacheIndex::create(const std::string& filename, U32 bucket_count)
+{
+	LLFILE* fp = LLFile::fopen(filename, "w+b");
+	if (!fp)
+	{
+		return false;
+	}
+	std::vector<U8> page(HEADER_SIZE, 0);
+	FileHeader header;
+	header.mMagic = INDEX_MAGIC;
+	header.mVersion = INDEX_VERSION;
+	header.mBucketCount = bucket_count;
+	header.mSlotSize = sizeof(Slot);
+	memcpy(&page[0], &header, sizeof(header));
+
+	// Empty slots are all zeroes, which is what the file grows with.
+	size_t size = HEADER_SIZE + (size_t)bucket_count * SLOTS_PER_BUCKET * sizeof(Slot);
+	if (fwrite(&page[0], HEADER_SIZE, 1, fp) != 1 ||
+		fseek(fp, size - 1, SEEK_SET) != 0 ||
+		fputc(0, fp) == EOF ||
+		fflush(fp) != 0)
+	{
+		fclose(fp);
+		LLFile::remove(filename);
+		return false;
+	}
+	mBucketCount = bucket_count;
+	if (!map(fp, size))
+	{
+		mBucketCount = 0;
+		fclose(fp);
+		return false;
+	}
+	return true;
+}
+
+bool LLTextureCacheIndex::map(LLFILE* fp, size_t size)
+{
+	mMapping = new LLVFSMapping(fp, size, !mReadOnly);
+	if (!mMapping->isValid())
+	{
+		mMapping = NULL;
+		return false;
+	}
+	mFP = fp;
+	mSlots = (Slot*)(mMapping->getAddress() + HEADER_SIZE);
+	return true;
+}
+
+void LLTextureCacheIndex::close()
+{
+	if (!mSlots)
+	{
+		return;
+	}
+	if (!mReadOnly)
+	{
+		checkpoint();
+	}
+	if (mJournalFP)
+	{
+		fclose(mJournalFP);
+		mJournalFP = NULL;
+	}
+	mSlots = NULL;
+	mMapping = NULL;
+	fclose(mFP);
+	mFP = NULL;
+	mBucketCount = 0;
+	mCount = 0;
+	mBodySize = 0;
+	mEvictHand = 0;
+}
+
+void LLTextureCacheIndex::replayJournal()
+{
+	LLFILE* fp = LLFile::fopen(mJournalFileName, "rb");
+	if (fp)
+	{
+		U32 replayed = 0;
+		JournalRecord record;
+		while (fread(&record, sizeof(record), 1, fp) == 1)
+		{
+			if (record.mSlot >= getCapacity() || record.mCRC != getCRC(record))
+			{
+				// A record that was being written when we went down.
+				llwarns << "Ignoring the rest of the texture cache journal after " << replayed << " records" << llendl;
+				break;
+			}
+			mSlots[record.mSlot].mEntry = record.mEntry;
+			++replayed;
+		}
+		fclose(fp);
+		if (replayed)
+		{
+			llinfos << "Replayed " << replayed << " texture cache journal records" << llendl;
+			mMapping->flush();
+		}
+	}
+	mJournalFP = LLFile::fopen(mJournalFileName, "wb");
+	mJournalRecords = 0;
+}
+
+void LLTextureCacheIndex::scanSlots()
+{
+	U32 count = 0;
+	S64 body_size = 0;
+	U32 corrupted = 0;
+	U32 capacity = getCapacity();
+	for (U32 slot = 0; slot < capacity; ++slot)
+	{
+		const Entry& entry = mSlots[slot].mEntry;
+		if (entry.mID.isNull())
+		{
+			continue;
+		}
+		if (entry.mImageSize <= entry.mBodySize || entry.mBodySize < 0)
+		{
+			++corrupted;
+			if (!mReadOnly)
+			{
+				storeSlot(slot, Entry());
+			}
+			continue;
+		}
+		++count;
+		body_size += entry.mBodySize;
+	}
+	if (corrupted)
+	{
+		llwarns << "Dropped " << corrupted << " corrupted texture cache entries" << llendl;
+	}
+	LLMutexLock lock(&mStatsMutex);
+	mCount = count;
+	mBodySize = body_size;
+}
+
+void LLTextureCacheIndex::clear()
+{
+	if (!mSlots || mReadOnly)
+	{
+		return;
+	}
+	for (S32 i = 0; i < LOCK_STRIPES; ++i)
+	{
+		mLocks[i].lock();
+	}
+	memset((void*)mSlots, 0, getCapacity() * sizeof(Slot));
+	{
+		LLMutexLock lock(&mStatsMutex);
+		mCount = 0;
+		mBodySize = 0;
+	}
+	// Not journalled, so write it back before emptying the journal.
+	checkpoint();
+	for (S32 i = LOCK_STRIPES - 1; i >= 0; --i)
+	{
+		mLocks[i].unlock();
+	}
+}
+
+void LLTextureCacheIndex::checkpoint()
+{
+	if (!mSlots || mReadOnly)
+	{
+		return;
+	}
+	LLMutexLock lock(&mJournalMutex);
+	checkpointLocked();
+}
+
+void LLTextureCacheIndex::checkpointLocked()
+{
+	// Slots are changed before their record is appended, so everything that is
+	// not in the journal after this is in the flushed mapping.
+	if (!mMapping->flush())
+	{
+		llwarns << "Failed to write back the texture cache index, keeping the journal" << llendl;
+		return;
+	}
+	if (mJournalFP)
+	{
+		fclose(mJournalFP);
+	}
+	mJournalFP = LLFile::fopen(mJournalFileName, "wb");
+	mJournalRecords = 0;
+}
+
+//static
+U32 LLTextureCacheIndex::getCRC(const JournalRecord& record)
+{
+	LLCRC crc;
+	crc.update((const U8*)&record, offsetof(JournalRecord, mCRC));
+	return crc.getCRC();
+}
+
+U32 LLTextureCacheIndex::getBucket(const LLUUID& id) const
+{
+	return id.getCRC32() % mBucketCount;
+}
+
+void LLTextureCacheIndex::storeSlot(U32 slot, const Entry& entry)
+{
+	mSlots[slot].mEntry = entry;
+
+	JournalRecord record;
+	record.mSlot = slot;
+	record.mEntry = entry;
+	record.mCRC = getCRC(record);
+
+	LLMutexLock lock(&mJournalMutex);
+	if (!mJournalFP)
+	{
+		return;
+	}
+	// Flushed to the OS right away, so that it survives us crashing.
+	if (fwrite(&record, sizeof(record), 1, mJournalFP) != 1 || fflush(mJournalFP) != 0)
+	{
+		llwarns << "Failed to write the texture cache journal" << llendl;
+	}
+	if (++mJournalRecords >= CHECKPOINT_RECORDS)
+	{
+		checkpointLocked();
+	}
+}
+
+void LLTextureCacheIndex::addStats(S32 count, S64 body_size)
+{
+	LLMutexLock lock(&mStatsMutex);
+	mCount += count;
+	mBodySize += body_size;
+}
+
+U32 LLTextureCacheIndex::getCount() const
+{
+	LLMutexLock lock(&mStatsMutex);
+	return mCount;
+}
+
+S64 LLTextureCacheIndex::getBodySize() const
+{
+	LLMutexLock lock(&mStatsMutex);
+	return mBodySize;
+}
+
+S32 LLTextureCacheIndex::find(const LLUUID& id, Entry& entry, bool touch)
+{
+	if (!mSlots || id.isNull())
+	{
+		return -1;
+	}
+	U32 bucket = getBucket(id);
+	U32 first = bucket * SLOTS_PER_BUCKET;
+	LLMutexLock lock(&getLock(bucket));
+	for (U32 slot = first; slot < first + SLOTS_PER_BUCKET; ++slot)
+	{
+		Entry& cur = mSlots[slot].mEntry;
+		if (cur.mID == id)
+		{
+			// The time stamp only matters for eviction, so it isn't journalled.
+			U32 now = time(NULL);
+			if (touch && !mReadOnly && cur.mTime != now)
+			{
+				cur.mTime = now;
+			}
+			entry = cur;
+			return slot;
+		}
+	}
+	return -1;
+}
+
+S32 LLTextureCacheIndex::insert(const Entry& entry, Entry& evicted)
+{
+	evicted = Entry();
+	if (!mSlots || mReadOnly || entry.mID.isNull())
+	{
+		return -1;
+	}
+	U32 bucket = getBucket(entry.mID);
+	U32 first = bucket * SLOTS_PER_BUCKET;
+	S32 count = 1;
+	S64 body_size = entry.mBodySize;
+	U32 slot;
+	{
+		LLMutexLock lock(&getLock(bucket));
+		S32 found = -1;
+		S32 free_slot = -1;
+		S32 lru_slot = -1;
+		for (U32 i = first; i < first + SLOTS_PER_BUCKET; ++i)
+		{
+			const Entry& cur = mSlots[i].mEntry;
+			if (cur.mID == entry.mID)
+			{
+				found = i;
+				break;
+			}
+			if (cur.mID.isNull())
+			{
+				if (free_slot < 0)
+				{
+					free_slot = i;
+				}
+			}
+			else if (lru_slot < 0 || cur.mTime < mSlots[lru_slot].mEntry.mTime)
+			{
+				lru_slot = i;
+			}
+		}
+		slot = found >= 0 ? found : (free_slot >= 0 ? free_slot : lru_slot);
+		const Entry& old = mSlots[slot].mEntry;
+		if (found >= 0 || free_slot < 0)
+		{
+			count = 0;
+			body_size -= old.mBodySize;
+			if (found < 0)
+			{
+				evicted = old;
+			}
+		}
+		storeSlot(slot, entry);
+	}
+	addStats(count, body_size);
+	return slot;
+}
+
+bool LLTextureCacheIndex::update(S32 idx, const Entry& entry)
+{
+	if (!mSlots || mReadOnly || idx < 0 || (U32)idx >= getCapacity())
+	{
+		return false;
+	}
+	S64 body_size;
+	{
+		LLMutexLock lock(&getLock(idx / SLOTS_PER_BUCKET));
+		const Entry& old = mSlots[idx].mEntry;
+		if (old.mID != entry.mID)
+		{
+			return false;
+		}
+		body_size = entry.mBodySize - old.mBodySize;
+		storeSlot(idx, entry);
+	}
+	addStats(0, body_size);
+	return true;
+}
+
+bool LLTextureCacheIndex::remove(const LLUUID& id, Entry& entry)
+{
+	if (!mSlots || mReadOnly || id.isNull())
+	{
+		return false;
+	}
+	U32 bucket = getBucket(id);
+	U32 first = bucket * SLOTS_PER_BUCKET;
+	{
+		LLMutexLock lock(&getLock(bucket));
+		U32 slot = first;
+		while (slot < first + SLOTS_PER_BUCKET && mSlots[slot].mEntry.mID != id)
+		{
+			++slot;
+		}
+		if (slot == first + SLOTS_PER_BUCKET)
+		{
+			return false;
+		}
+		entry = mSlots[slot].mEntry;
+		storeSlot(slot, Entry());
+	}
+	addStats(-1, -(S64)entry.mBodySize);
+	return true;
+}
+
+void LLTextureCacheIndex::evict(S64 max_body_size, std::vector<Entry>& evicted)
+{
+	if (!mSlots || mReadOnly)
+	{
+		return;
+	}
+	// One thread at a time is enough, it makes room for everyone.
+	if (!mEvictMutex.tryLock())
+	{
+		return;
+	}
+	// Give up after going once around the table without finding anything.
+	U32 max_misses = mBucketCount / EVICT_SAMPLE_BUCKETS + 1;
+	U32 misses = 0;
+	while (misses < max_misses && getBodySize() > max_body_size)
+	{
+		// Pick the least recently used entry with a body in the next few buckets.
+		S32 best = -1;
+		Entry best_entry;
+		for (U32 n = 0; n < EVICT_SAMPLE_BUCKETS; ++n)
+		{
+			U32 bucket = mEvictHand;
+			mEvictHand = (mEvictHand + 1) % mBucketCount;
+			U32 first = bucket * SLOTS_PER_BUCKET;
+			LLMutexLock lock(&getLock(bucket));
+			for (U32 slot = first; slot < first + SLOTS_PER_BUCKET; ++slot)
+			{
+				const Entry& cur = mSlots[slot].mEntry;
+				if (cur.mID.notNull() && cur.mBodySize > 0 && (best < 0 || cur.mTime < best_entry.mTime))
+				{
+					best = slot;
+					best_entry = cur;
+				}
+			}
+		}
+		if (best < 0)
+		{
+			++misses;
+			continue;
+		}
+		{
+			LLMutexLock lock(&getLock(best / SLOTS_PER_BUCKET));
+			if (mSlots[best].mEntry.mID != best_entry.mID)
+			{
+				// Replaced while we weren't holding the lock.
+				continue;
+			}
+			best_entry = mSlots[best].mEntry;
+			storeSlot(best, Entry());
+		}
+		addStats(-1, -(S64)best_entry.mBodySize);
+		evicted.push_back(best_entry);
+		misses = 0;
+	}
+	mEvictMutex.unlock();
+}
+
+void LLTextureCacheIndex::getEntries(std::vector<std::pair<S32, Entry> >& entries)
+{
+	for (U32 bucket = 0; bucket < mBucketCount; ++bucket)
+	{
+		U32 first = bucket * SLOTS_PER_BUCKET;
+		LLMutexLock lock(&getLock(bucket));
+		for (U32 slot = first; slot < first + SLOTS_PER_BUCKET; ++slot)
+		{
+			if (mSlots[slot].mEntry.mID.notNull())
+			{
+				entries.push_back(std::make_pair((S32)slot, mSlots[slot].mEntry));
+			}
+		}
+	}
+}
@@ -0,0 +1,191 @@
+/**
+ * @file lltexturecacheindex.h
+ * @brief Memory mapped, lock striped index of the texture cache entries
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLTEXTURECACHEINDEX_H
+#define LL_LLTEXTURECACHEINDEX_H
+
+#include <string>
+#include <vector>
+
+#include "llpointer.h"
+#include "llthread.h"
+#include "lluuid.h"
+
+class LLVFSMapping;
+
+// Index of the texture cache: which textures are cached, how big they are and
+// when they were last used.
+//
+// The index is a hash table that lives in a memory mapped file, so opening it
+// costs one mmap() and a linear scan instead of reading and sorting every entry.
+// The table is set associative: an id can only be stored in one of the
+// SLOTS_PER_BUCKET slots of the bucket it hashes to. The slot number is stable
+// for as long as the entry exists and doubles as the record number of the
+// texture header in texture.cache.
+//
+// Buckets are protected by LOCK_STRIPES mutexes (bucket % LOCK_STRIPES), so
+// lookups of different textures hardly ever wait on each other.
+//
+// Every change to a slot is also appended to a journal. A non-empty journal on
+// open means we didn't shut down cleanly and the changes are replayed, in case
+// the kernel didn't get to write back all of the mapped pages. checkpoint()
+// writes the mapping back and empties the journal.
+//
+// Eviction is incremental: inserting into a full bucket reuses its least
+// recently used slot, and evict() removes the least recently used of a small
+// sample of buckets at a time, instead of sorting the whole cache.
+class LLTextureCacheIndex
+{
+public:
+	struct Entry
+	{
+		Entry() : mImageSize(0), mBodySize(0), mTime(0) { }
+		Entry(const LLUUID& id, S32 imagesize, S32 bodysize, U32 time) :
+			mID(id), mImageSize(imagesize), mBodySize(bodysize), mTime(time) { }
+
+		LLUUID mID;			// 16 bytes, null for an empty slot
+		S32 mImageSize;		// total size of image if known
+		S32 mBodySize;		// size of body file in body cache
+		U32 mTime;			// seconds since 1/1/1970
+	};
+
+	enum
+	{
+		SLOTS_PER_BUCKET = 16,
+		LOCK_STRIPES = 64,
+		HEADER_SIZE = 4096,				// The slots start at the second page.
+		CHECKPOINT_RECORDS = 8192		// Journal records before an automatic checkpoint.
+	};
+
+	LLTextureCacheIndex();
+	~LLTextureCacheIndex();
+
+	// Opens the index in filename (and its journal, filename + ".journal"), creating
+	// it with room for at least max_entries if needed. If the existing index has a
+	// different size or format it is replaced with an empty one, see wasReset().
+	// Returns false if no index could be opened; the cache is then disabled.
+	bool open(const std::string& filename, U32 max_entries, bool read_only);
+	// Checkpoints and unmaps.
+	void close();
+	bool isOpen() const					{ return mSlots != NULL; }
+	// True if open() didn't find a usable index; any texture headers and bodies are orphans.
+	bool wasReset() const				{ return mWasReset; }
+
+	// Removes all entries.
+	void clear();
+	// Writes back the mapping and empties the journal.
+	void checkpoint();
+
+	// Returns the slot of id and copies its entry, or returns -1.
+	// With touch the entry becomes the most recently used.
+	S32 find(const LLUUID& id, Entry& entry, bool touch = true);
+	// Stores entry, in the slot it already has or a new one. If this reused the slot of
+	// another entry, that entry is copied to evicted (its mID is null otherwise).
+	// Returns the slot or -1.
+	S32 insert(const Entry& entry, Entry& evicted);
+	// Replaces the entry in slot idx. Returns false if idx doesn't hold entry.mID anymore.
+	bool update(S32 idx, const Entry& entry);
+	// Removes id. Returns false if it isn't in the index, otherwise copies the removed entry.
+	bool remove(const LLUUID& id, Entry& entry);
+	// Removes approximately least recently used entries that have a body until
+	// the bodies take at most max_body_size bytes. Appends the removed entries.
+	void evict(S64 max_body_size, std::vector<Entry>& evicted);
+
+	// Copies all entries, together with their slot.
+	void getEntries(std::vector<std::pair<S32, Entry> >& entries);
+
+	U32 getCapacity() const				{ return mBucketCount * SLOTS_PER_BUCKET; }
+	U32 getCount() const;
+	S64 getBodySize() const;
+
+	static std::string getJournalFileName(const std::string& filename) { return filename + ".journal"; }
+
+private:
+	struct FileHeader
+	{
+		U32 mMagic;
+		U32 mVersion;
+		U32 mBucketCount;
+		U32 mSlotSize;
+	};
+
+	struct Slot
+	{
+		Entry mEntry;
+		U32 mReserved;
+	};
+
+	struct JournalRecord
+	{
+		U32 mSlot;
+		Entry mEntry;
+		U32 mCRC;
+	};
+
+	static U32 getCRC(const JournalRecord& record);
+
+	U32 getBucket(const LLUUID& id) const;
+	LLMutex& getLock(U32 bucket)		{ return mLocks[bucket % LOCK_STRIPES]; }
+	bool create(const std::string& filename, U32 bucket_count);
+	bool map(LLFILE* fp, size_t size);
+	void replayJournal();
+	void scanSlots();
+	// Call with mJournalMutex held.
+	void checkpointLocked();
+	// Call with the lock of the bucket of slot held.
+	void storeSlot(U32 slot, const Entry& entry);
+	void addStats(S32 count, S64 body_size);
+
+private:
+	LLPointer<LLVFSMapping> mMapping;
+	LLFILE* mFP;
+	Slot* mSlots;
+	U32 mBucketCount;
+	bool mReadOnly;
+	bool mWasReset;
+	std::string mJournalFileName;
+
+	LLMutex mLocks[LOCK_STRIPES];
+
+	LLMutex mJournalMutex;
+	LLFILE* mJournalFP;
+	U32 mJournalRecords;
+
+	mutable LLMutex mStatsMutex;
+	U32 mCount;
+	S64 mBodySize;
+
+	LLMutex mEvictMutex;
+	U32 mEvictHand;
+};
+
+#endif // LL_LLTEXTURECACHEINDEX_H
@@ -42,6 +42,7 @@
 #include "llhttpstatuscodes.h"
 #include "llimage.h"
 #include "llimagej2c.h"
+#include "llimagerawcache.h"
 #include "llimageworker.h"
 #include "llworkerthread.h"
 #include "message.h"
@@ -260,6 +261,8 @@ private:
 	S32 mCachedSize;	
 	e_request_state mSentRequest;
 	handle_t mDecodeHandle;
+	S32 mDecodeDataSize;		// Codestream bytes of the current decode, for the raw cache.
+	bool mDecodedFromRawCache;
 	BOOL mLoaded;
 	BOOL mDecoded;
 	BOOL mWritten;
@@ -793,6 +796,8 @@ LLTextureFetchWorker::LLTextureFetchWorker(LLTextureFetch* fetcher,
 	  mLoaded(FALSE),
 	  mSentRequest(UNSENT),
 	  mDecodeHandle(0),
+	  mDecodeDataSize(0),
+	  mDecodedFromRawCache(false),
 	  mDecoded(FALSE),
 	  mWritten(FALSE),
 	  mNeedsAux(FALSE),
@@ -1611,10 +1616,28 @@ bool LLTextureFetchWorker::doWork(S32 param)
 		U32 image_priority = LLWorkerThread::PRIORITY_NORMAL | mWorkPriority;
 		mDecoded  = FALSE;
 		mState = DECODE_IMAGE_UPDATE;
-		LL_DEBUGS("Texture") << mID << ": Decoding. Bytes: " << mFormattedImage->getDataSize() << " Discard: " << discard
-				<< " All Data: " << mHaveAllData << LL_ENDL;
-		mDecodeHandle = mFetcher->mImageDecodeThread->decodeImage(mFormattedImage, image_priority, discard, mNeedsAux,
-																  new DecodeResponder(mFetcher, mID, this));
+		mDecodeDataSize = mFormattedImage->getDataSize();
+		mDecodedFromRawCache = false;
+		if (mFetcher->mRawCache && !mNeedsAux && !mInLocalCache)
+		{
+			// Decoded before from the same data?
+			mRawImage = mFetcher->mRawCache->read(mID, discard, mDecodeDataSize);
+			if (mRawImage.notNull())
+			{
+				LL_DEBUGS("Texture") << mID << ": Decoded image cache hit. Discard: " << discard << LL_ENDL;
+				mFormattedImage->setDiscardLevel(discard);
+				mDecodedDiscard = discard;
+				mDecodedFromRawCache = true;
+				mDecoded = TRUE;
+			}
+		}
+		if (!mDecoded)
+		{
+			LL_DEBUGS("Texture") << mID << ": Decoding. Bytes: " << mDecodeDataSize << " Discard: " << discard
+					<< " All Data: " << mHaveAllData << LL_ENDL;
+			mDecodeHandle = mFetcher->mImageDecodeThread->decodeImage(mFormattedImage, image_priority, discard, mNeedsAux,
+																	  new DecodeResponder(mFetcher, mID, this));
+		}
 		// fall though
 	}
 	
@@ -1647,6 +1670,12 @@ bool LLTextureFetchWorker::doWork(S32 param)
 				llassert_always(mRawImage.notNull());
 				LL_DEBUGS("Texture") << mID << ": Decoded. Discard: " << mDecodedDiscard
 						<< " Raw Image: " << llformat("%dx%d",mRawImage->getWidth(),mRawImage->getHeight()) << LL_ENDL;
+				if (mFetcher->mRawCache && !mDecodedFromRawCache && !mNeedsAux && !mInLocalCache &&
+					mDesiredDiscard >= mDecodedDiscard)
+				{
+					// Only keep decodes that satisfy the request, not the intermediate ones.
+					mFetcher->mRawCache->write(mID, mDecodedDiscard, mDecodeDataSize, mRawImage);
+				}
 				setPriority(LLWorkerThread::PRIORITY_HIGH | mWorkPriority);
 				mState = WRITE_TO_CACHE;
 			}
@@ -1802,6 +1831,10 @@ void LLTextureFetchWorker::removeFromCache()
 	if (!mInLocalCache)
 	{
 		mFetcher->mTextureCache->removeFromCache(mID);
+		if (mFetcher->mRawCache)
+		{
+			mFetcher->mRawCache->remove(mID);
+		}
 	}
 }
 
@@ -2043,13 +2076,14 @@ bool LLTextureFetchWorker::writeToCacheComplete()
 //////////////////////////////////////////////////////////////////////////////
 // public
 
-LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded, bool qa_mode)
+LLTextureFetch::LLTextureFetch(LLTextureCache* cache, LLImageRawCache* rawcache, LLImageDecodeThread* imagedecodethread, bool threaded, bool qa_mode)
 	: LLWorkerThread("TextureFetch", threaded, true),
 	  mDebugCount(0),
 	  mDebugPause(FALSE),
 	  mPacketCount(0),
 	  mBadPacketCount(0),
 	  mTextureCache(cache),
+	  mRawCache(rawcache),
 	  mImageDecodeThread(imagedecodethread),
 	  mTextureBandwidth(0),
 	  mHTTPTextureBits(0),
@@ -2389,7 +2423,7 @@ S32 LLTextureFetch::getPending()
     {
         LLMutexLock lock(&mQueueMutex);
         
-        res = mRequestQueue.size();
+        res = getQueuedCount();
 #if HTTP_METRICS
         res += mCurlPOSTRequestCount;
         res += mCommands.size();
@@ -2423,9 +2457,9 @@ bool LLTextureFetch::runCondition()
 	
 	return ! (have_no_commands
 			  && have_no_curl_requests
-			  && (mRequestQueue.empty() && mIdleThread));		// From base class
+			  && (getQueuedCount() == 0 && mIdleThread));		// From base class
 #else
-	return !(mRequestQueue.empty() && mIdleThread);
+	return !(getQueuedCount() == 0 && mIdleThread);
 #endif
 }
 
@@ -2948,8 +2982,10 @@ S32 LLTextureFetch::getFetchState(const LLUUID& id, F32& data_progress_p, F32& r
 void LLTextureFetch::dump()
 {
 	llinfos << "LLTextureFetch REQUESTS:" << llendl;
-	for (request_queue_t::iterator iter = mRequestQueue.begin();
-		 iter != mRequestQueue.end(); ++iter)
+	std::vector<LLQueuedThread::QueuedRequest*> requests;
+	getQueuedRequests(requests);
+	for (std::vector<LLQueuedThread::QueuedRequest*>::iterator iter = requests.begin();
+		 iter != requests.end(); ++iter)
 	{
 		LLQueuedThread::QueuedRequest* qreq = *iter;
 		LLWorkerThread::WorkRequest* wreq = (LLWorkerThread::WorkRequest*)qreq;
@@ -44,6 +44,7 @@ class LLViewerTexture;
 class LLTextureFetchWorker;
 class HTTPGetResponder;
 class LLTextureCache;
+class LLImageRawCache;
 class LLImageDecodeThread;
 class LLHost;
 #if HTTP_METRICS
@@ -57,7 +58,7 @@ class LLTextureFetch : public LLWorkerThread
 	friend class HTTPGetResponder;
 	
 public:
-	LLTextureFetch(LLTextureCache* cache, LLImageDecodeThread* imagedecodethread, bool threaded, bool qa_mode = false);
+	LLTextureFetch(LLTextureCache* cache, LLImageRawCache* rawcache, LLImageDecodeThread* imagedecodethread, bool threaded, bool qa_mode = false);
 	~LLTextureFetch();
 
 	class TFRequest;
@@ -173,6 +174,7 @@ private:
 	LLMutex mNetworkQueueMutex; //to protect mNetworkQueue, mHTTPTextureQueue and mCancelQueue.
 
 	LLTextureCache* mTextureCache;
+	LLImageRawCache* mRawCache;
 	LLImageDecodeThread* mImageDecodeThread;
 	
 	// Map of all requests by UUID
@@ -34,6 +34,7 @@
 #include "llerror.h"
 #include "lllfsthread.h"
 #include "llui.h"
+#include "llimagerawcache.h"
 #include "llimageworker.h"
 #include "llrender.h"
 
@@ -526,6 +527,15 @@ void LLGLTexMemBar::draw()
 					global_raw_memory >> 20,	discard_bias,
 					cache_usage, cache_max_usage, total_texture_downloaded, total_object_downloaded, total_http_requests);
 	//, cache_entries, cache_max_entries
+	LLImageRawCache* raw_cache = LLAppViewer::getTextureRawCache();
+	if (raw_cache->isEnabled())
+	{
+		U32 hits = raw_cache->getHits();
+		U32 lookups = hits + raw_cache->getMisses();
+		text += llformat(" Decoded Cache: %d/%d hits (%.0f%%) %.1f/%.1f MB",
+						 hits, lookups, lookups ? 100.f * hits / lookups : 0.f,
+						 (F32)BYTES_TO_MEGA_BYTES(raw_cache->getUsage()), (F32)BYTES_TO_MEGA_BYTES(raw_cache->getMaxUsage()));
+	}
 
 	LLFontGL::getFontMonospace()->renderUTF8(text, 0, 0, v_offset + line_height*3,
 											 text_color, LLFontGL::LEFT, LLFontGL::TOP);
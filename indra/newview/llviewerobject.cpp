@@ -2252,6 +2252,45 @@ void LLViewerObject::idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time)
 }
 
 
+BOOL LLViewerObject::isIdleMotionless() const
+{
+	return !isChanged(MOVED) &&
+		getAngularVelocity().isExactlyZero() &&
+		getVelocity().isExactlyZero() &&
+		getAcceleration().isExactlyZero();
+}
+
+// Must stay in step with idleUpdate(), applyAngularVelocity() and
+// interpolateLinearMotion() for objects that don't move.
+void LLViewerObject::idleUpdateClocks(const F64 &time)
+{
+	if (mDead)
+	{
+		return;
+	}
+
+	if (!mStatic && sVelocityInterpolate && !isSelected())
+	{
+		F32 dt = mTimeDilation * (F32)(time - mLastInterpUpdateSecs);
+		mRotTime += dt;
+
+		if (isAttachment())
+		{
+			// idleUpdate() returns here without calling updateDrawable().
+			mLastInterpUpdateSecs = time;
+			return;
+		}
+		if (time - mLastMessageUpdateSecs > 0.0 && dt > 0.f)
+		{
+			mLastInterpUpdateSecs = time;
+		}
+	}
+
+	// All updateDrawable(FALSE) does when the object hasn't moved; the
+	// pipeline sets SHIFTED when the region shifts.
+	clearChanged(SHIFTED);
+}
+
 // Move an object due to idle-time viewer side updates by iterpolating motion
 void LLViewerObject::interpolateLinearMotion(const F64 & time, const F32 & dt)
 {
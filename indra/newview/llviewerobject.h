@@ -151,6 +151,11 @@ public:
 
 	// Object create and update functions
 	virtual void	idleUpdate(LLAgent &agent, LLWorld &world, const F64 &time);
+	// TRUE when the base idleUpdate() has nothing to rotate, interpolate or
+	// move, so that it would only advance the interpolation clocks.
+	BOOL			isIdleMotionless() const;
+	// What the base idleUpdate() does for a motionless object.
+	void			idleUpdateClocks(const F64 &time);
 
 	// Types of media we can associate
 	enum { MEDIA_NONE = 0, MEDIA_SET = 1 };
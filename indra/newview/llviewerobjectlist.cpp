@@ -111,8 +111,8 @@ extern LLPipeline	gPipeline;
 
 // Statics for object lookup tables.
 U32						LLViewerObjectList::sSimulatorMachineIndex = 1; // Not zero deliberately, to speed up index check.
-std::map<U64, U32>			LLViewerObjectList::sIPAndPortToIndex;
-std::map<U64, LLUUID>	LLViewerObjectList::sIndexAndLocalIDToUUID;
+LLOpenHashMap<U64, U32>		LLViewerObjectList::sIPAndPortToIndex;
+LLOpenHashMap<U64, LLUUID>	LLViewerObjectList::sIndexAndLocalIDToUUID;
 
 LLViewerObjectList::LLViewerObjectList()
 {
@@ -165,7 +165,8 @@ void LLViewerObjectList::getUUIDFromLocal(LLUUID &id,
 
 	U64	indexid = (((U64)index) << 32) | (U64)local_id;
 
-	id = get_if_there(sIndexAndLocalIDToUUID, indexid, LLUUID::null);
+	LLOpenHashMap<U64, LLUUID>::const_iterator iter = sIndexAndLocalIDToUUID.find(indexid);
+	id = iter != sIndexAndLocalIDToUUID.end() ? iter->second : LLUUID::null;
 }
 
 U64 LLViewerObjectList::getIndex(const U32 local_id,
@@ -198,7 +199,7 @@ BOOL LLViewerObjectList::removeFromLocalIDTable(const LLViewerObject* objectp)
 		
 		U64	indexid = (((U64)index) << 32) | (U64)local_id;
 		
-		std::map<U64, LLUUID>::iterator iter = sIndexAndLocalIDToUUID.find(indexid);
+		LLOpenHashMap<U64, LLUUID>::iterator iter = sIndexAndLocalIDToUUID.find(indexid);
 		if (iter == sIndexAndLocalIDToUUID.end())
 		{
 			return FALSE;
@@ -375,6 +376,14 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		return;
 	}
 
+	// Decode the texture entries and volumes of full updates on the worker pool
+	// first; LLVOVolume::processUpdateMessage() picks them up.
+	mUpdateDecoder.clear();
+	if (!cached && (compressed ? update_type != OUT_TERSE_IMPROVED : update_type == OUT_FULL))
+	{
+		mUpdateDecoder.decode(mesgsys, compressed);
+	}
+
 	U8 compressed_dpbuffer[2048];
 	LLDataPackerBinaryBuffer compressed_dp(compressed_dpbuffer, 2048);
 	LLDataPacker *cached_dpp = NULL;
@@ -590,6 +599,7 @@ void LLViewerObjectList::processObjectUpdate(LLMessageSystem *mesgsys,
 		objectp->setLastUpdateType(update_type);
 		objectp->setLastUpdateCached(bCached);
 	}
+	mUpdateDecoder.clear();
 
 	LLVOAvatar::cullAvatarsByPixelArea();
 }
@@ -879,6 +889,11 @@ private:
 	LLSD mObjectIDs;
 };
 
+static LLFastTimer::DeclareTimer FTM_IDLE_SORT("Idle Sort");
+static LLFastTimer::DeclareTimer FTM_IDLE_AVATARS("Idle Avatars");
+static LLFastTimer::DeclareTimer FTM_IDLE_VOLUMES("Idle Volumes");
+static LLFastTimer::DeclareTimer FTM_IDLE_OTHERS("Idle Others");
+
 void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 {
 	LLMemType mt(LLMemType::MTYPE_OBJECT);
@@ -987,13 +1002,78 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 	}
 	else
 	{
-		for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
-			idle_iter != idle_end; idle_iter++)
+		// Group the objects by what their idleUpdate() does, so that every
+		// pass calls the same code and shows up as its own timer.
+		static std::vector<LLViewerObject*> idle_avatars;
+		static std::vector<LLViewerObject*> idle_volumes;
+		static std::vector<LLViewerObject*> idle_others;
+		static std::vector<U8> volume_moving;
+		idle_avatars.clear();
+		idle_volumes.clear();
+		idle_others.clear();
+
+		{
+			LLFastTimer t(FTM_IDLE_SORT);
+			for (std::vector<LLViewerObject*>::iterator idle_iter = idle_list.begin();
+				idle_iter != idle_end; idle_iter++)
+			{
+				objectp = *idle_iter;
+				llassert(objectp->isActive());
+				if (objectp->isAvatar())
+				{
+					idle_avatars.push_back(objectp);
+				}
+				else if (objectp->getPCode() == LL_PCODE_VOLUME)
+				{	// LLVOVolume uses the base idleUpdate()
+					idle_volumes.push_back(objectp);
+				}
+				else
+				{
+					idle_others.push_back(objectp);
+				}
+			}
+		}
+
+		{
+			LLFastTimer t(FTM_IDLE_AVATARS);
+			for (std::vector<LLViewerObject*>::iterator iter = idle_avatars.begin();
+				iter != idle_avatars.end(); ++iter)
+			{
+				(*iter)->idleUpdate(agent, world, frame_time);
+			}
+		}
+
 		{
-			objectp = *idle_iter;
-			llassert(objectp->isActive());
-			objectp->idleUpdate(agent, world, frame_time);
+			LLFastTimer t(FTM_IDLE_VOLUMES);
+			// Flag the volumes that have something to interpolate or move
+			// (the avatars may just have moved their attachments) in one pass
+			// over the flags before updating any of them.
+			volume_moving.resize(idle_volumes.size());
+			for (U32 i = 0; i < idle_volumes.size(); ++i)
+			{
+				volume_moving[i] = !idle_volumes[i]->isIdleMotionless();
+			}
+			for (U32 i = 0; i < idle_volumes.size(); ++i)
+			{
+				objectp = idle_volumes[i];
+				if (volume_moving[i])
+				{
+					objectp->idleUpdate(agent, world, frame_time);
+				}
+				else
+				{
+					objectp->idleUpdateClocks(frame_time);
+				}
+			}
+		}
 
+		{
+			LLFastTimer t(FTM_IDLE_OTHERS);
+			for (std::vector<LLViewerObject*>::iterator iter = idle_others.begin();
+				iter != idle_others.end(); ++iter)
+			{
+				(*iter)->idleUpdate(agent, world, frame_time);
+			}
 		}
 
 		//update flexible objects
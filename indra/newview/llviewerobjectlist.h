@@ -37,6 +37,8 @@
 #include <set>
 
 // common includes
+#include "llobjectupdatedecoder.h"
+#include "llopenhashmap.h"
 #include "llstat.h"
 #include "llstring.h"
 
@@ -92,6 +94,8 @@ public:
 	void processObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type, bool cached=false, bool compressed=false);
 	void processCompressedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
 	void processCachedObjectUpdate(LLMessageSystem *mesgsys, void **user_data, EObjectUpdateType update_type);
+	// While a full update is processed: what the worker pool decoded of block, or NULL.
+	const LLDecodedObjectUpdate* getDecodedUpdate(S32 block) const { return mUpdateDecoder.getBlock(block); }
 	void updateApparentAngles(LLAgent &agent);
 	void update(LLAgent &agent, LLWorld &world);
 
@@ -214,8 +218,10 @@ public:
 
 	std::set<LLUUID> mDeadObjects;	
 
-	std::map<LLUUID, LLPointer<LLViewerObject> > mUUIDObjectMap;
-	std::map<LLUUID, LLPointer<LLVOAvatar> > mUUIDAvatarMap;
+	typedef LLOpenHashMap<LLUUID, LLPointer<LLViewerObject> > uuid_object_map_t;
+	typedef LLOpenHashMap<LLUUID, LLPointer<LLVOAvatar> > uuid_avatar_map_t;
+	uuid_object_map_t mUUIDObjectMap;
+	uuid_avatar_map_t mUUIDAvatarMap;
 
 	//set of objects that need to update their cost
 	std::set<LLUUID> mStaleObjectCost;
@@ -230,12 +236,14 @@ public:
 	S32 mCurLazyUpdateIndex;
 
 	static U32 sSimulatorMachineIndex;
-	static std::map<U64, U32> sIPAndPortToIndex;
+	static LLOpenHashMap<U64, U32> sIPAndPortToIndex;
 
-	static std::map<U64, LLUUID> sIndexAndLocalIDToUUID;
+	static LLOpenHashMap<U64, LLUUID> sIndexAndLocalIDToUUID;
 
 	std::set<LLViewerObject *> mSelectPickList;
 
+	LLObjectUpdateDecoder mUpdateDecoder;
+
 	friend class LLViewerObject;
 };
 
@@ -267,7 +275,7 @@ extern LLViewerObjectList gObjectList;
 // Inlines
 inline LLViewerObject *LLViewerObjectList::findObject(const LLUUID &id) const
 {
-	std::map<LLUUID, LLPointer<LLViewerObject> >::const_iterator iter = mUUIDObjectMap.find(id);
+	uuid_object_map_t::const_iterator iter = mUUIDObjectMap.find(id);
 	if(iter != mUUIDObjectMap.end())
 	{
 		return iter->second;
@@ -280,7 +288,7 @@ inline LLViewerObject *LLViewerObjectList::findObject(const LLUUID &id) const
 
 inline LLVOAvatar *LLViewerObjectList::findAvatar(const LLUUID &id) const
 {
-	std::map<LLUUID, LLPointer<LLVOAvatar> >::const_iterator iter = mUUIDAvatarMap.find(id);
+	uuid_avatar_map_t::const_iterator iter = mUUIDAvatarMap.find(id);
 	return (iter != mUUIDAvatarMap.end()) ? iter->second.get() : NULL;
 }
 
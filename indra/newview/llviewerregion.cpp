@@ -349,6 +349,12 @@ LLViewerRegion::LLViewerRegion(const U64 &handle,
 	mImpl->mObjectPartition.push_back(new LLBridgePartition());	//PARTITION_BRIDGE
 	mImpl->mObjectPartition.push_back(new LLHUDParticlePartition());//PARTITION_HUD_PARTICLE
 	mImpl->mObjectPartition.push_back(NULL);						//PARTITION_NONE
+
+	// Have the object cache file read by the time the handshake comes in.
+	if(LLVOCache::hasInstance())
+	{
+		LLVOCache::getInstance()->prefetch(mHandle) ;
+	}
 }
 
 
@@ -441,6 +447,10 @@ void LLViewerRegion::saveObjectCache()
 {
 	if (!mCacheLoaded)
 	{
+		if(LLVOCache::hasInstance())
+		{
+			LLVOCache::getInstance()->cancelPrefetch(mHandle) ;
+		}
 		return;
 	}
 
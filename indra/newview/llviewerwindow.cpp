@@ -647,9 +647,27 @@ public:
 				addText(xpos, ypos, llformat("%d/%d Mesh LOD Pending/Processing", LLMeshRepository::sLODPending, LLMeshRepository::sLODProcessing));
 				ypos += y_inc;
 
+				U32 fetches = llmax(LLMeshRepository::sLODFetchCount, (U32)1);
+				addText(xpos, ypos, llformat("%d/%.1f ms Mesh LOD Fetches/Latency", LLMeshRepository::sLODFetchCount,
+					LLMeshRepository::sLODFetchTime/(1000.f*fetches)));
+				ypos += y_inc;
+
+				U32 decodes = llmax(LLMeshRepository::sDecodeCount, (U32)1);
+				addText(xpos, ypos, llformat("%d/%d Mesh Decode Queued/Done, %.1f/%.1f ms Wait/Decode", (S32)LLMeshDecodeTask::sQueued,
+					LLMeshRepository::sDecodeCount, LLMeshRepository::sDecodeWaitTime/(1000.f*decodes), LLMeshRepository::sDecodeTime/(1000.f*decodes)));
+				ypos += y_inc;
+
 				addText(xpos, ypos, llformat("%.3f/%.3f MB Mesh Cache Read/Write ", LLMeshRepository::sCacheBytesRead/(1024.f*1024.f), LLMeshRepository::sCacheBytesWritten/(1024.f*1024.f)));
 
 				ypos += y_inc;
+
+				LLMeshCache* cache = gMeshRepo.mThread ? &gMeshRepo.mThread->mCache : NULL;
+				if (cache && cache->isEnabled())
+				{
+					addText(xpos, ypos, llformat("%d/%d Mesh Cache Hits/Misses, %d assets, %.1f/%.1f MB", (U32)cache->getHits(), (U32)cache->getMisses(),
+						cache->getEntries(), cache->getUsage()/(1024.f*1024.f), cache->getMaxUsage()/(1024.f*1024.f)));
+					ypos += y_inc;
+				}
 			}
 
 			LLVertexBuffer::sBindCount = LLImageGL::sBindCount = 
@@ -1018,6 +1018,7 @@ LLVOAvatar::LLVOAvatar(const LLUUID& id,
 	mBelowWater(FALSE),
 	mLastAppearanceBlendTime(0.f),
 	mAppearanceAnimating(FALSE),
+	mDeferringMorphs(FALSE),
 	mNameString(),
 	mTitle(),
 	mNameAway(false),
@@ -3237,12 +3238,14 @@ void LLVOAvatar::idleUpdateAppearanceAnimation()
 			}
 
 			// apply all params
+			deferMorphs();
 			for (param = getFirstVisualParam();
 				 param;
 				 param = getNextVisualParam())
 			{
 				param->apply(avatar_sex);
 			}
+			applyMorphs();
 
 			mLastAppearanceBlendTime = appearance_anim_time;
 		}
@@ -6592,7 +6595,9 @@ void LLVOAvatar::updateVisualParams()
 
 	setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
 
+	deferMorphs();
 	LLCharacter::updateVisualParams();
+	applyMorphs();
 
 	if (mLastSkeletonSerialNum != mSkeletonSerialNum)
 	{
@@ -6605,6 +6610,32 @@ void LLVOAvatar::updateVisualParams()
 	updateHeadOffset();
 }
 
+//-----------------------------------------------------------------------------
+// applyMorphs()
+//-----------------------------------------------------------------------------
+static LLFastTimer::DeclareTimer FTM_APPLY_MORPHS("Apply Morphs");
+
+void LLVOAvatar::applyMorphs()
+{
+	mDeferringMorphs = FALSE;
+
+	std::vector<LLMorphEngine*> engines;
+	for (polymesh_map_t::iterator i = mMeshes.begin(); i != mMeshes.end(); ++i)
+	{
+		// LODs share the engine of their reference mesh.
+		LLPolyMesh* mesh = i->second;
+		if (!mesh->isLOD() && !mesh->getMorphEngine()->isEmpty())
+		{
+			engines.push_back(mesh->getMorphEngine());
+		}
+	}
+	if (!engines.empty())
+	{
+		LLFastTimer t(FTM_APPLY_MORPHS);
+		LLMorphEngine::applyAll(&engines[0], (S32)engines.size());
+	}
+}
+
 //-----------------------------------------------------------------------------
 // isActive()
 //-----------------------------------------------------------------------------
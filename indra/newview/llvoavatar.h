@@ -733,8 +733,14 @@ public:
 	//--------------------------------------------------------------------
 public:
 	BOOL			getIsAppearanceAnimating() const { return mAppearanceAnimating; }
+	// Morph targets applied after deferMorphs() are queued on their mesh and
+	// applied together by applyMorphs(), the meshes on the worker pool.
+	void			deferMorphs() { mDeferringMorphs = TRUE; }
+	void			applyMorphs();
+	BOOL			isDeferringMorphs() const { return mDeferringMorphs; }
 private:
 	BOOL			mAppearanceAnimating;
+	BOOL			mDeferringMorphs;
 	LLFrameTimer	mAppearanceMorphTimer;
 	F32				mLastAppearanceBlendTime;
 
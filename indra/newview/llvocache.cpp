@@ -37,6 +37,7 @@
 #include "llerror.h"
 #include "llregionhandle.h"
 #include "llviewercontrol.h"
+#include "llworkerpool.h"
 
 BOOL check_read(LLAPRFile* apr_file, void* src, S32 n_bytes) 
 {
@@ -76,69 +77,17 @@ LLVOCacheEntry::LLVOCacheEntry()
 	mDP.assignBuffer(mBuffer, 0);
 }
 
-LLVOCacheEntry::LLVOCacheEntry(LLAPRFile* apr_file)
-	: mBuffer(NULL)
+LLVOCacheEntry::LLVOCacheEntry(const LLObjectCacheFile::Entry& file_entry)
+	:
+	mLocalID(file_entry.mLocalID),
+	mCRC(file_entry.mCRC),
+	mHitCount(file_entry.mHitCount),
+	mDupeCount(file_entry.mDupeCount),
+	mCRCChangeCount(file_entry.mCRCChangeCount)
 {
-	S32 size = -1;
-	BOOL success;
-
-	mDP.assignBuffer(mBuffer, 0);
-	success = check_read(apr_file, &mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_read(apr_file, &mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_read(apr_file, &size, sizeof(S32));
-
-	// Corruption in the cache entries
-	if ((size > 10000) || (size < 1))
-	{
-		// We've got a bogus size, skip reading it.
-		// We won't bother seeking, because the rest of this file
-		// is likely bogus, and will be tossed anyway.
-			llwarns << "Bogus cache entry, size " << size << ", aborting!" << llendl;
-			success = FALSE;
-		}
-	}
-	if(success && size > 0)
-	{
-		mBuffer = new U8[size];
-		success = check_read(apr_file, mBuffer, size);
-
-		if(success)
-		{
-			mDP.assignBuffer(mBuffer, size);
-		}
-		else
-		{
-			delete[] mBuffer ;
-			mBuffer = NULL ;
-		}
-	}
-
-	if(!success)
-	{
-		mLocalID = 0;
-		mCRC = 0;
-		mHitCount = 0;
-		mDupeCount = 0;
-		mCRCChangeCount = 0;
-		mBuffer = NULL;
-	}
+	mBuffer = new U8[file_entry.mSize];
+	memcpy(mBuffer, file_entry.mData, file_entry.mSize);
+	mDP.assignBuffer(mBuffer, file_entry.mSize);
 }
 
 LLVOCacheEntry::~LLVOCacheEntry()
@@ -193,38 +142,18 @@ void LLVOCacheEntry::dump() const
 		<< llendl;
 }
 
-BOOL LLVOCacheEntry::writeToFile(LLAPRFile* apr_file) const
+BOOL LLVOCacheEntry::writeToFile(LLObjectCacheFile& file) const
 {
-	BOOL success;
-	success = check_write(apr_file, (void*)&mLocalID, sizeof(U32));
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mCRC, sizeof(U32));
-	}
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mHitCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mDupeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		success = check_write(apr_file, (void*)&mCRCChangeCount, sizeof(S32));
-	}
-	if(success)
-	{
-		S32 size = mDP.getBufferSize();
-		success = check_write(apr_file, (void*)&size, sizeof(S32));
-	
-		if(success)
-		{
-			success = check_write(apr_file, (void*)mBuffer, size);
-		}
-	}
-
-	return success ;
+	LLObjectCacheFile::Entry entry;
+	entry.mLocalID = mLocalID;
+	entry.mCRC = mCRC;
+	entry.mHitCount = mHitCount;
+	entry.mDupeCount = mDupeCount;
+	entry.mCRCChangeCount = mCRCChangeCount;
+	entry.mSize = mDP.getBufferSize();
+	entry.mData = mBuffer;
+
+	return file.addEntry(entry) ;
 }
 
 //-------------------------------------------------------------------
@@ -241,6 +170,68 @@ const char* header_filename = "object.cache";
 
 LLVOCache* LLVOCache::sInstance = NULL;
 
+// The file of one region, read ahead on the worker pool. Shared by LLVOCache
+// and the task that reads it; whichever lets go of it last deletes it.
+class LLVOCacheLoad
+{
+public:
+	LLVOCacheLoad(const std::string& filename)
+	:	mFilename(filename), mSuccess(false)
+	{
+		mClaims = 0;
+		mDone = 0;
+		mRefs = 1;
+	}
+
+	// Only the first caller gets to read the file: the task, or LLVOCache
+	// when it can't wait for the task to start, or cancels the read.
+	bool claim()				{ return mClaims++ == 0; }
+	void read()
+	{
+		mSuccess = mFile.read(mFilename);
+		mDone = 1;
+	}
+	bool isDone() const			{ return mDone; }
+
+	void ref()					{ mRefs++; }
+	void unref()				{ if (!--mRefs) delete this; }
+
+	const std::string mFilename;
+	LLObjectCacheFile mFile;
+	bool mSuccess;
+
+private:
+	LLAtomicS32 mClaims;
+	LLAtomicS32 mDone;
+	LLAtomicS32 mRefs;
+};
+
+class LLVOCacheLoadTask : public LLWorkerPool::Task
+{
+public:
+	LLVOCacheLoadTask(LLWorkerPool::Subsystem* subsystem, LLVOCacheLoad* load)
+	:	LLWorkerPool::Task(subsystem), mLoad(load)
+	{
+		mLoad->ref();
+	}
+	/*virtual*/ ~LLVOCacheLoadTask()
+	{
+		mLoad->unref();
+	}
+
+	/*virtual*/ bool run()
+	{
+		if (mLoad->claim())
+		{
+			mLoad->read();
+		}
+		return false;
+	}
+
+private:
+	LLVOCacheLoad* mLoad;
+};
+
 //static 
 LLVOCache* LLVOCache::getInstance() 
 {	
@@ -271,7 +262,9 @@ LLVOCache::LLVOCache():
 	mInitialized(FALSE),
 	mReadOnly(TRUE),
 	mNumEntries(0),
-	mCacheSize(1)
+	mCacheSize(1),
+	mCacheBytes(0),
+	mMaxCacheBytes(0)
 {
 	mEnabled = gSavedSettings.getBOOL("ObjectCacheEnabled");
 }
@@ -291,7 +284,7 @@ void LLVOCache::setDirNames(ELLPath location)
 	mObjectCacheDirName = gDirUtilp->getExpandedFilename(location, object_cache_dirname);
 }
 
-void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version)
+void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version, U32 max_bytes)
 {
 	if(!mEnabled)
 	{
@@ -312,6 +305,7 @@ void LLVOCache::initCache(ELLPath location, U32 size, U32 cache_version)
 		LLFile::mkdir(mObjectCacheDirName);
 	}
 	mCacheSize = llclamp(size, MIN_ENTRIES_TO_PURGE, MAX_NUM_OBJECT_ENTRIES);
+	mMaxCacheBytes = max_bytes;
 	mMetaInfo.mVersion = cache_version;
 	readCacheHeader();	
 
@@ -405,6 +399,11 @@ void LLVOCache::removeEntry(U64 handle)
 
 void LLVOCache::clearCacheInMemory()
 {
+	while (!mPendingLoads.empty())
+	{
+		cancelPrefetch(mPendingLoads.begin()->first);
+	}
+
 	if(!mHeaderEntryQueue.empty()) 
 	{
 		for(header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin(); iter != mHeaderEntryQueue.end(); ++iter)
@@ -414,6 +413,7 @@ void LLVOCache::clearCacheInMemory()
 		mHeaderEntryQueue.clear();
 		mHandleEntryMap.clear();
 		mNumEntries = 0 ;
+		mCacheBytes = 0 ;
 	}
 
 }
@@ -437,9 +437,12 @@ void LLVOCache::removeFromCache(HeaderEntryInfo* entry)
 		return ;
 	}
 
+	cancelPrefetch(entry->mHandle);
+
 	std::string filename;
 	getObjectCacheFilename(entry->mHandle, filename);
 	LLAPRFile::remove(filename);
+	mCacheBytes -= llmin((U64)entry->mSize, mCacheBytes);
 	entry->mTime = INVALID_TIME ;
 	updateEntry(entry) ; //update the head file.
 }
@@ -489,6 +492,7 @@ void LLVOCache::readCacheHeader()
 				}
 
 				entry->mIndex = mNumEntries++ ;
+				mCacheBytes += entry->mSize ;
 				mHeaderEntryQueue.insert(entry) ;
 				mHandleEntryMap[entry->mHandle] = entry ;
 				entry = NULL ;
@@ -519,9 +523,13 @@ void LLVOCache::readCacheHeader()
 	{
 		removeCache() ; //failed to read header, clear the cache
 	}
-	else if(mNumEntries >= mCacheSize)
+	else
 	{
-		purgeEntries(mCacheSize) ;
+		if(mNumEntries >= mCacheSize)
+		{
+			purgeEntries(mCacheSize) ;
+		}
+		purgeBytes(NULL) ;
 	}
 
 	return ;
@@ -603,45 +611,44 @@ void LLVOCache::readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::voca
 		return ;
 	}
 
-	bool success = true ;
+	LLObjectCacheFile file_local ;
+	LLObjectCacheFile* file = &file_local ;
+	bool success ;
+	LLVOCacheLoad* load = takeLoad(handle) ;
+	if(load)
+	{
+		file = &load->mFile ;
+		success = load->mSuccess ;
+	}
+	else
 	{
 		std::string filename;
 		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_READ|APR_BINARY);
-	
-		LLUUID cache_id ;
-		success = check_read(&apr_file, cache_id.mData, UUID_BYTES) ;
-	
-		if(success)
-		{		
-			if(cache_id != id)
-			{
-				llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
-				success = false ;
-			}
+		success = file_local.read(filename) ;
+	}
 
-			if(success)
-			{
-				S32 num_entries;
-				success = check_read(&apr_file, &num_entries, sizeof(S32)) ;
-	
-				if(success)
-				{
-					for (S32 i = 0; i < num_entries; i++)
-					{
-						LLVOCacheEntry* entry = new LLVOCacheEntry(&apr_file);
-						if (!entry->getLocalID())
-						{
-							llwarns << "Aborting cache file load for " << filename << ", cache file corruption!" << llendl;
-							delete entry ;
-							success = false ;
-							break ;
-						}
-						cache_entry_map[entry->getLocalID()] = entry;
-					}
-				}
-			}
-		}		
+	if(success && file->getRegionID() != id)
+	{
+		llinfos << "Cache ID doesn't match for this region, discarding"<< llendl;
+		success = false ;
+	}
+
+	if(success)
+	{
+		S32 offset = 0 ;
+		LLObjectCacheFile::Entry file_entry ;
+		while(file->nextEntry(offset, file_entry))
+		{
+			LLVOCacheEntry* entry = new LLVOCacheEntry(file_entry);
+			LLVOCacheEntry*& slot = cache_entry_map[entry->getLocalID()] ;
+			delete slot ;
+			slot = entry ;
+		}
+	}
+
+	if(load)
+	{
+		load->unref() ;
 	}
 	
 	if(!success)
@@ -669,6 +676,102 @@ void LLVOCache::purgeEntries(U32 size)
 	mNumEntries = mHandleEntryMap.size() ;
 }
 
+// Drops the least recently used regions until their files fit in
+// mMaxCacheBytes (0 for no limit), but never keep.
+void LLVOCache::purgeBytes(const HeaderEntryInfo* keep)
+{
+	if(!mMaxCacheBytes || mReadOnly)
+	{
+		return ;
+	}
+
+	header_entry_queue_t::iterator iter = mHeaderEntryQueue.begin() ;
+	while(mCacheBytes > mMaxCacheBytes && iter != mHeaderEntryQueue.end())
+	{
+		HeaderEntryInfo* entry = *iter ;
+		if(entry == keep)
+		{
+			++iter ;
+			continue ;
+		}
+		mHeaderEntryQueue.erase(iter++) ;
+		mHandleEntryMap.erase(entry->mHandle);
+		removeFromCache(entry) ;
+		delete entry;
+	}
+	mNumEntries = mHandleEntryMap.size() ;
+}
+
+void LLVOCache::prefetch(U64 handle)
+{
+	if(!mEnabled || !mInitialized)
+	{
+		return ;
+	}
+	if(mPendingLoads.count(handle) || !mHandleEntryMap.count(handle)) //already reading, or no cache
+	{
+		return ;
+	}
+
+	// Without the pool, readFromCache() reads the file itself.
+	LLWorkerPool* pool = LLWorkerPool::getInstance();
+	LLWorkerPool::Subsystem* subsystem = pool ? pool->getSubsystem("objectcache") : NULL;
+	if(!subsystem)
+	{
+		return ;
+	}
+
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	LLVOCacheLoad* load = new LLVOCacheLoad(filename) ;
+	LLVOCacheLoadTask* task = new LLVOCacheLoadTask(subsystem, load) ;
+	if(!pool->submit(task))
+	{
+		delete task ;
+		load->unref() ;
+		return ;
+	}
+	mPendingLoads[handle] = load ;
+}
+
+void LLVOCache::cancelPrefetch(U64 handle)
+{
+	handle_load_map_t::iterator iter = mPendingLoads.find(handle) ;
+	if(iter == mPendingLoads.end())
+	{
+		return ;
+	}
+	LLVOCacheLoad* load = iter->second ;
+	mPendingLoads.erase(iter) ;
+
+	// Keeps the task from reading it if it didn't start yet. One that did
+	// drops the file when it is done.
+	load->claim() ;
+	load->unref() ;
+}
+
+LLVOCacheLoad* LLVOCache::takeLoad(U64 handle)
+{
+	handle_load_map_t::iterator iter = mPendingLoads.find(handle) ;
+	if(iter == mPendingLoads.end())
+	{
+		return NULL ;
+	}
+	LLVOCacheLoad* load = iter->second ;
+	mPendingLoads.erase(iter) ;
+
+	if(load->claim())
+	{
+		// Still queued behind other work: faster to read it here.
+		load->read() ;
+	}
+	while(!load->isDone())
+	{
+		ms_sleep(1) ;
+	}
+	return load ;
+}
+
 void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) 
 {
 	if(!mEnabled)
@@ -725,26 +828,28 @@ void LLVOCache::writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry:
 		return ; //nothing changed, no need to update.
 	}
 
+	//whatever was read ahead is stale now.
+	cancelPrefetch(handle) ;
+
 	//write to cache file
-	bool success = true ;
+	LLObjectCacheFile file ;
+	file.clear(id) ;
+	for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); iter != cache_entry_map.end(); ++iter)
 	{
-		std::string filename;
-		getObjectCacheFilename(handle, filename);
-		LLAPRFile apr_file(filename, APR_CREATE|APR_WRITE|APR_BINARY);
-	
-		success = check_write(&apr_file, (void*)id.mData, UUID_BYTES) ;
+		iter->second->writeToFile(file) ; //empty entries are not worth keeping.
+	}
 
-	
-		if(success)
-		{
-			S32 num_entries = cache_entry_map.size() ;
-			success = check_write(&apr_file, &num_entries, sizeof(S32));
-	
-			for (LLVOCacheEntry::vocache_entry_map_t::const_iterator iter = cache_entry_map.begin(); success && iter != cache_entry_map.end(); ++iter)
-			{
-				success = iter->second->writeToFile(&apr_file) ;
-			}
-		}
+	std::string filename;
+	getObjectCacheFilename(handle, filename);
+	U32 size = (U32)file.write(filename) ;
+	bool success = size > 0 ;
+	if(success)
+	{
+		mCacheBytes -= llmin((U64)entry->mSize, mCacheBytes) ;
+		mCacheBytes += size ;
+		entry->mSize = size ;
+		success = updateEntry(entry) ;
+		purgeBytes(entry) ;
 	}
 
 	if(!success)
@@ -37,6 +37,7 @@
 #include "lldatapacker.h"
 #include "lldlinked.h"
 #include "lldir.h"
+#include "llobjectcachefile.h"
 
 
 //---------------------------------------------------------------------------
@@ -47,7 +48,7 @@ class LLVOCacheEntry
 {
 public:
 	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLAPRFile* apr_file);
+	LLVOCacheEntry(const LLObjectCacheFile::Entry& file_entry);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
@@ -57,7 +58,7 @@ public:
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
 
 	void dump() const;
-	BOOL writeToFile(LLAPRFile* apr_file) const;
+	BOOL writeToFile(LLObjectCacheFile& file) const;
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
@@ -76,18 +77,22 @@ protected:
 	U8							*mBuffer;
 };
 
+class LLVOCacheLoad;
+
 //
-//Note: LLVOCache is not thread-safe
+//Note: LLVOCache is not thread-safe, only the region files it prefetches are
+//read on the worker pool ("objectcache" subsystem).
 //
 class LLVOCache
 {
 private:
 	struct HeaderEntryInfo
 	{
-		HeaderEntryInfo() : mIndex(0), mHandle(0), mTime(0) {}
+		HeaderEntryInfo() : mIndex(0), mHandle(0), mTime(0), mSize(0) {}
 		S32 mIndex;
 		U64 mHandle ;
 		U32 mTime ;
+		U32 mSize ;		// Size of the region file in bytes.
 	};
 
 	struct HeaderMetaInfo
@@ -111,15 +116,23 @@ private:
 	};
 	typedef std::set<HeaderEntryInfo*, header_entry_less> header_entry_queue_t;
 	typedef std::map<U64, HeaderEntryInfo*> handle_entry_map_t;
+	typedef std::map<U64, LLVOCacheLoad*> handle_load_map_t;
 private:
 	LLVOCache() ;
 
 public:
 	~LLVOCache() ;
 
-	void initCache(ELLPath location, U32 size, U32 cache_version) ;
+	// size is the number of regions, max_bytes what their files may add up to.
+	void initCache(ELLPath location, U32 size, U32 cache_version, U32 max_bytes) ;
 	void removeCache(ELLPath location) ;
 
+	// Starts reading the file of a region in the background, as soon as the
+	// region is known, so that readFromCache() finds it ready at handshake.
+	void prefetch(U64 handle) ;
+	// Drops the prefetched file of a region whose cache was never read.
+	void cancelPrefetch(U64 handle) ;
+
 	void readFromCache(U64 handle, const LLUUID& id, LLVOCacheEntry::vocache_entry_map_t& cache_entry_map) ;
 	void writeToCache(U64 handle, const LLUUID& id, const LLVOCacheEntry::vocache_entry_map_t& cache_entry_map, BOOL dirty_cache) ;
 	void removeEntry(U64 handle) ;
@@ -137,6 +150,9 @@ private:
 	void removeCache() ;
 	void removeEntry(HeaderEntryInfo* entry) ;
 	void purgeEntries(U32 size);
+	void purgeBytes(const HeaderEntryInfo* keep);
+	// Returns the prefetch of handle once it is done, NULL if there was none.
+	LLVOCacheLoad* takeLoad(U64 handle);
 	BOOL updateEntry(const HeaderEntryInfo* entry);
 	
 private:
@@ -146,10 +162,13 @@ private:
 	HeaderMetaInfo       mMetaInfo;
 	U32                  mCacheSize;
 	U32                  mNumEntries;
+	U64                  mCacheBytes;
+	U64                  mMaxCacheBytes;
 	std::string          mHeaderFileName ;
 	std::string          mObjectCacheDirName;
 	header_entry_queue_t mHeaderEntryQueue;
 	handle_entry_map_t   mHandleEntryMap;	
+	handle_load_map_t    mPendingLoads;
 
 	static LLVOCache* sInstance ;
 public:
@@ -225,7 +225,17 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 		//
 		// Unpack texture entry data
 		//
-		if (unpackTEMessage(mesgsys, _PREHASH_ObjectData, block_num) & (TEM_CHANGE_TEXTURE|TEM_CHANGE_COLOR))
+		const LLDecodedObjectUpdate* decoded = update_type == OUT_FULL ? gObjectList.getDecodedUpdate(block_num) : NULL;
+		S32 te_result;
+		if (decoded && decoded->mHasTEs && decoded->mID == getID())
+		{
+			te_result = applyParsedTEMessage(decoded->mTEs);
+		}
+		else
+		{
+			te_result = unpackTEMessage(mesgsys, _PREHASH_ObjectData, block_num);
+		}
+		if (te_result & (TEM_CHANGE_TEXTURE|TEM_CHANGE_COLOR))
 		{
 			updateTEData();
 		}
@@ -235,8 +245,25 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 		// CORY TO DO: Figure out how to get the value here
 		if (update_type != OUT_TERSE_IMPROVED)
 		{
+			// Use what the worker pool decoded when it read the data up to where we are.
+			const LLDecodedObjectUpdate* decoded = gObjectList.getDecodedUpdate(block_num);
+			LLDataPackerBinaryBuffer* binary_dp = dynamic_cast<LLDataPackerBinaryBuffer*>(dp);
+			if (decoded && (!decoded->mHasTEs || decoded->mID != getID() ||
+							!binary_dp || binary_dp->getCurrentSize() != decoded->mVolumeOffset))
+			{
+				decoded = NULL;
+			}
+
 			LLVolumeParams volume_params;
-			BOOL res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
+			BOOL res = TRUE;
+			if (decoded)
+			{
+				volume_params = decoded->mVolumeParams;
+			}
+			else
+			{
+				res = LLVolumeMessage::unpackVolumeParams(&volume_params, *dp);
+			}
 			if (!res)
 			{
 				llwarns << "Bogus volume parameters in object " << getID() << llendl;
@@ -249,7 +276,16 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 			{
 				markForUpdate(TRUE);
 			}
-			S32 res2 = unpackTEMessage(*dp);
+			S32 res2;
+			if (decoded)
+			{
+				res2 = applyParsedTEMessage(decoded->mTEs);
+				binary_dp->seek(decoded->mEndOffset);
+			}
+			else
+			{
+				res2 = unpackTEMessage(*dp);
+			}
 			if (TEM_INVALID == res2)
 			{
 				// Well, crap, there's something bogus in the data that we're unpacking.
@@ -2503,7 +2539,8 @@ F32 LLVOVolume::getStreamingCost(S32* bytes, S32* visible_bytes, F32* unscaled_v
 
 	if (isMesh())
 	{	
-		LLSD& header = gMeshRepo.getMeshHeader(getVolume()->getParams().getSculptID());
+		LLMeshHeader header;
+		gMeshRepo.getMeshHeader(getVolume()->getParams().getSculptID(), header);
 
 		return LLMeshRepository::getStreamingCost(header, radius, bytes, visible_bytes, mLOD, unscaled_value);
 	}
@@ -2513,11 +2550,11 @@ F32 LLVOVolume::getStreamingCost(S32* bytes, S32* visible_bytes, F32* unscaled_v
 		S32 counts[4];
 		LLVolume::getLoDTriangleCounts(volume->getParams(), counts);
 
-		LLSD header;
-		header["lowest_lod"]["size"] = counts[0] * 10;
-		header["low_lod"]["size"] = counts[1] * 10;
-		header["medium_lod"]["size"] = counts[2] * 10;
-		header["high_lod"]["size"] = counts[3] * 10;
+		LLMeshHeader header;
+		for (S32 i = 0; i < 4; ++i)
+		{
+			header.mSize[i] = counts[i] * 10;
+		}
 
 		return LLMeshRepository::getStreamingCost(header, radius, NULL, NULL, -1, unscaled_value);
 	}	
@@ -0,0 +1,190 @@
+/**
+ * @file llmeshdecodetask_test.cpp
+ * @brief LLMeshDecodeTask tests
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+// Class to test
+#include "../llmeshdecodetask.h"
+// Dependencies
+#include "lltimer.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	// Records what the decode workers call back. Blobs whose first byte is 0
+	// don't decode; a blob whose first byte is 2 waits for mRelease.
+	class TestDecoder : public LLMeshDecoder
+	{
+	public:
+		TestDecoder() :
+			mDecoded(0), mFailed(0), mCached(0), mDone(0), mRelease(false),
+			mFailedType(DECODE_SKIN), mFailedLOD(-1), mCacheOffset(-1), mCacheSize(-1)
+		{
+		}
+
+		/*virtual*/ bool decode(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod, U8* data, S32 data_size)
+		{
+			while (data[0] == 2 && !mRelease)
+			{
+				ms_sleep(1);
+			}
+			mDecoded++;
+			return data[0] != 0;
+		}
+
+		/*virtual*/ void decodeFailed(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod)
+		{
+			mFailedType = type;
+			mFailedLOD = lod;
+			mFailed++;
+		}
+
+		/*virtual*/ S32 cacheDecoded(EDecodeType type, const LLVolumeParams& mesh_params, S32 lod,
+									 S32 cache_offset, const U8* data, S32 cache_size)
+		{
+			mCacheOffset = cache_offset;
+			mCacheSize = cache_size;
+			mCached++;
+			return cache_size;
+		}
+
+		/*virtual*/ void addDecodeStats(S32 cache_bytes_written, U64 wait_time, U64 decode_time)
+		{
+			mDone++;
+		}
+
+		// Waits until done blobs went through addDecodeStats() and the tasks are gone.
+		bool waitDone(S32 done)
+		{
+			LLTimer timer;
+			while ((mDone < done || LLMeshDecodeTask::sQueued > 0) && timer.getElapsedTimeF32() < 10.f)
+			{
+				ms_sleep(1);
+			}
+			return mDone == done && LLMeshDecodeTask::sQueued == 0;
+		}
+
+		LLAtomicS32 mDecoded;
+		LLAtomicS32 mFailed;
+		LLAtomicS32 mCached;
+		LLAtomicS32 mDone;
+		volatile bool mRelease;
+		EDecodeType mFailedType;
+		S32 mFailedLOD;
+		S32 mCacheOffset;
+		S32 mCacheSize;
+	};
+
+	U8* make_blob(U8 first)
+	{
+		U8* data = new U8[16];
+		memset(data, first, 16);
+		return data;
+	}
+}
+
+namespace tut
+{
+	struct meshdecodetask_test
+	{
+		meshdecodetask_test()
+		{
+			LLWorkerPool::initClass(2);
+		}
+
+		~meshdecodetask_test()
+		{
+			LLWorkerPool::cleanupClass();
+		}
+
+		LLVolumeParams mParams;
+	};
+
+	typedef test_group<meshdecodetask_test> meshdecodetask_t;
+	typedef meshdecodetask_t::object meshdecodetask_object_t;
+	tut::meshdecodetask_t tut_meshdecodetask("LLMeshDecodeTask");
+
+	// A cached blob that doesn't decode is passed to decodeFailed() and not
+	// cached again; one from the sim that doesn't decode is just dropped.
+	template<> template<>
+	void meshdecodetask_object_t::test<1>()
+	{
+		LLWorkerPool::getInstance()->addSubsystem("meshdecode", LLWorkerPool::PRIORITY_CLASS_NORMAL, 2);
+		TestDecoder decoder;
+		ensure("cached queued", LLMeshDecodeTask::queue(&decoder, LLMeshDecoder::DECODE_LOD, mParams, 3, make_blob(0), 16, -1, 0));
+		ensure("cached done", decoder.waitDone(1));
+		ensure_equals("decodeFailed called", (S32)decoder.mFailed, 1);
+		ensure_equals("failed type", decoder.mFailedType, LLMeshDecoder::DECODE_LOD);
+		ensure_equals("failed lod", decoder.mFailedLOD, 3);
+		ensure_equals("not cached", (S32)decoder.mCached, 0);
+
+		ensure("sim queued", LLMeshDecodeTask::queue(&decoder, LLMeshDecoder::DECODE_SKIN, mParams, 0, make_blob(0), 16, 100, 16));
+		ensure("sim done", decoder.waitDone(2));
+		ensure_equals("no decodeFailed for sim data", (S32)decoder.mFailed, 1);
+		ensure_equals("failed sim data not cached", (S32)decoder.mCached, 0);
+	}
+
+	// A blob from the sim that decodes is cached where it was requested from.
+	template<> template<>
+	void meshdecodetask_object_t::test<2>()
+	{
+		LLWorkerPool::getInstance()->addSubsystem("meshdecode", LLWorkerPool::PRIORITY_CLASS_NORMAL, 2);
+		TestDecoder decoder;
+		ensure("queued", LLMeshDecodeTask::queue(&decoder, LLMeshDecoder::DECODE_PHYSICS_SHAPE, mParams, 0, make_blob(1), 16, 100, 16));
+		ensure("done", decoder.waitDone(1));
+		ensure_equals("cached", (S32)decoder.mCached, 1);
+		ensure_equals("cache offset", decoder.mCacheOffset, 100);
+		ensure_equals("cache size", decoder.mCacheSize, 16);
+		ensure_equals("no decodeFailed", (S32)decoder.mFailed, 0);
+	}
+
+	// Without the subsystem, or when it is full, the caller keeps the blob.
+	template<> template<>
+	void meshdecodetask_object_t::test<3>()
+	{
+		TestDecoder decoder;
+		U8* data = make_blob(1);
+		ensure("no subsystem", !LLMeshDecodeTask::queue(&decoder, LLMeshDecoder::DECODE_LOD, mParams, 0, data, 16, -1, 0));
+		ensure_equals("no task", (S32)LLMeshDecodeTask::sQueued, 0);
+
+		LLWorkerPool::getInstance()->addSubsystem("meshdecode", LLWorkerPool::PRIORITY_CLASS_NORMAL, 1);
+		ensure("blocking blob queued", LLMeshDecodeTask::queue(&decoder, LLMeshDecoder::DECODE_LOD, mParams, 0, make_blob(2), 16, -1, 0));
+		ensure("subsystem full", !LLMeshDecodeTask::queue(&decoder, LLMeshDecoder::DECODE_LOD, mParams, 0, data, 16, -1, 0));
+		ensure_equals("data kept", data[0], (U8)1);
+		delete [] data;
+		decoder.mRelease = true;
+		ensure("blocking blob done", decoder.waitDone(1));
+		ensure_equals("decoded once", (S32)decoder.mDecoded, 1);
+	}
+}
@@ -0,0 +1,277 @@
+/**
+ * @file lltexturecacheindex_test.cpp
+ * @brief LLTextureCacheIndex tests
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Precompiled header: almost always required for newview cpp files
+#include "../llviewerprecompiledheaders.h"
+#include <vector>
+// Class to test
+#include "../lltexturecacheindex.h"
+// Dependencies
+#include "llfile.h"
+// Tut header
+#include "../test/lltut.h"
+
+namespace
+{
+	typedef LLTextureCacheIndex::Entry Entry;
+
+	bool copy_file(const std::string& from, const std::string& to)
+	{
+		LLFILE* in = LLFile::fopen(from, "rb");
+		if (!in)
+		{
+			return false;
+		}
+		LLFILE* out = LLFile::fopen(to, "wb");
+		if (!out)
+		{
+			fclose(in);
+			return false;
+		}
+		char buffer[4096];
+		size_t size;
+		while ((size = fread(buffer, 1, sizeof(buffer), in)) > 0)
+		{
+			fwrite(buffer, 1, size, out);
+		}
+		fclose(in);
+		fclose(out);
+		return true;
+	}
+
+	// Empties all slots of a closed index, as if none of its pages made it to disk.
+	void wipe_slots(const std::string& filename)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "r+b");
+		fseek(fp, 0, SEEK_END);
+		std::vector<U8> zeroes((size_t)ftell(fp) - LLTextureCacheIndex::HEADER_SIZE, 0);
+		fseek(fp, LLTextureCacheIndex::HEADER_SIZE, SEEK_SET);
+		fwrite(&zeroes[0], 1, zeroes.size(), fp);
+		fclose(fp);
+	}
+}
+
+namespace tut
+{
+	struct texturecacheindex_test
+	{
+		texturecacheindex_test()
+		{
+			mFileName = std::string(LLFile::tmpdir()) + "lltexturecacheindex_test.index";
+			removeFiles();
+		}
+		~texturecacheindex_test()
+		{
+			removeFiles();
+		}
+		void removeFiles()
+		{
+			LLFile::remove(mFileName);
+			LLFile::remove(LLTextureCacheIndex::getJournalFileName(mFileName));
+		}
+		std::string mFileName;
+	};
+
+	typedef test_group<texturecacheindex_test> texturecacheindex_t;
+	typedef texturecacheindex_t::object texturecacheindex_object_t;
+	tut::texturecacheindex_t tut_texturecacheindex("LLTextureCacheIndex");
+
+	// Insert, find, update and remove.
+	template<> template<>
+	void texturecacheindex_object_t::test<1>()
+	{
+		LLTextureCacheIndex index;
+		ensure("open", index.open(mFileName, 1000, false));
+		ensure("new index", index.wasReset());
+		ensure("capacity", index.getCapacity() >= 1000);
+
+		LLUUID id;
+		id.generate();
+		Entry entry;
+		ensure_equals("find in empty index", index.find(id, entry), -1);
+
+		Entry evicted;
+		S32 idx = index.insert(Entry(id, 5000, 1000, 1), evicted);
+		ensure("insert", idx >= 0);
+		ensure("nothing evicted", evicted.mID.isNull());
+		ensure_equals("count", index.getCount(), 1U);
+		ensure_equals("body size", index.getBodySize(), 1000);
+
+		ensure_equals("find", index.find(id, entry), idx);
+		ensure_equals("image size", entry.mImageSize, 5000);
+		ensure("touched", entry.mTime > 1);
+
+		ensure("update", index.update(idx, Entry(id, 5000, 3000, 2)));
+		ensure_equals("updated body size", index.getBodySize(), 3000);
+		ensure_equals("insert again keeps the slot", index.insert(Entry(id, 5000, 4000, 3), evicted), idx);
+		ensure_equals("count after insert again", index.getCount(), 1U);
+		ensure_equals("body size after insert again", index.getBodySize(), 4000);
+
+		ensure("remove", index.remove(id, entry));
+		ensure_equals("removed body size", entry.mBodySize, 4000);
+		ensure("remove twice", !index.remove(id, entry));
+		ensure_equals("find removed", index.find(id, entry), -1);
+		ensure_equals("empty count", index.getCount(), 0U);
+		ensure_equals("empty body size", index.getBodySize(), 0);
+
+		LLUUID other;
+		other.generate();
+		ensure("update of another id", !index.update(idx, Entry(other, 5000, 1000, 4)));
+	}
+
+	// A full bucket reuses its least recently used slot.
+	template<> template<>
+	void texturecacheindex_object_t::test<2>()
+	{
+		LLTextureCacheIndex index;
+		ensure("open", index.open(mFileName, LLTextureCacheIndex::SLOTS_PER_BUCKET, false));
+		ensure_equals("one bucket", index.getCapacity(), (U32)LLTextureCacheIndex::SLOTS_PER_BUCKET);
+
+		std::vector<LLUUID> ids(LLTextureCacheIndex::SLOTS_PER_BUCKET + 1);
+		Entry evicted;
+		for (U32 i = 0; i < ids.size(); ++i)
+		{
+			ids[i].generate();
+			// The second one is the oldest.
+			U32 time = (i == 1) ? 1 : 100 + i;
+			ensure("insert", index.insert(Entry(ids[i], 5000, 100, time), evicted) >= 0);
+			if (i < LLTextureCacheIndex::SLOTS_PER_BUCKET)
+			{
+				ensure("nothing evicted yet", evicted.mID.isNull());
+			}
+		}
+		ensure_equals("least recently used evicted", evicted.mID, ids[1]);
+		ensure_equals("count", index.getCount(), (U32)LLTextureCacheIndex::SLOTS_PER_BUCKET);
+		ensure_equals("body size", index.getBodySize(), 100 * LLTextureCacheIndex::SLOTS_PER_BUCKET);
+		Entry entry;
+		ensure("evicted is gone", index.find(ids[1], entry) < 0);
+		ensure("newest is there", index.find(ids.back(), entry) >= 0);
+	}
+
+	// evict() removes old bodies until the budget is met.
+	template<> template<>
+	void texturecacheindex_object_t::test<3>()
+	{
+		LLTextureCacheIndex index;
+		ensure("open", index.open(mFileName, 4096, false));
+
+		const U32 count = 1000;
+		std::vector<LLUUID> ids(count);
+		Entry evicted;
+		for (U32 i = 0; i < count; ++i)
+		{
+			ids[i].generate();
+			index.insert(Entry(ids[i], 20000, 10000, 1000 + i), evicted);
+		}
+		ensure_equals("body size", index.getBodySize(), (S64)count * 10000);
+
+		std::vector<Entry> removed;
+		index.evict((S64)count * 10000 / 2, removed);
+		ensure("under budget", index.getBodySize() <= (S64)count * 10000 / 2);
+		ensure_equals("evicted half", removed.size(), (size_t)count / 2);
+		ensure_equals("count", index.getCount(), count - count / 2);
+
+		// Sampled LRU: what was removed should mostly be older than what was kept.
+		U32 old_removed = 0;
+		for (std::vector<Entry>::iterator iter = removed.begin(); iter != removed.end(); ++iter)
+		{
+			if (iter->mTime < 1000 + count / 2)
+			{
+				++old_removed;
+			}
+		}
+		ensure("mostly old entries evicted", old_removed > removed.size() * 3 / 4);
+	}
+
+	// Entries survive a reopen, and the journal brings back what didn't make it to disk.
+	template<> template<>
+	void texturecacheindex_object_t::test<4>()
+	{
+		const U32 count = 500;
+		std::vector<LLUUID> ids(count);
+		std::string journal = LLTextureCacheIndex::getJournalFileName(mFileName);
+		std::string saved_journal = mFileName + ".saved";
+		{
+			LLTextureCacheIndex index;
+			ensure("open", index.open(mFileName, 4096, false));
+			Entry evicted;
+			for (U32 i = 0; i < count; ++i)
+			{
+				ids[i].generate();
+				index.insert(Entry(ids[i], 2000 + i, i, 1000), evicted);
+			}
+			Entry entry;
+			for (U32 i = 0; i < count; i += 5)
+			{
+				index.remove(ids[i], entry);
+			}
+			ensure("journal copied", copy_file(journal, saved_journal));
+		}
+
+		{
+			LLTextureCacheIndex index;
+			ensure("reopen", index.open(mFileName, 4096, false));
+			ensure("kept", !index.wasReset());
+			ensure_equals("reopened count", index.getCount(), count - count / 5);
+		}
+
+		// Crash: lose all slots, keep the journal.
+		wipe_slots(mFileName);
+		ensure("journal restored", copy_file(saved_journal, journal));
+		LLFile::remove(saved_journal);
+
+		LLTextureCacheIndex index;
+		ensure("open after crash", index.open(mFileName, 4096, false));
+		ensure("not reset after crash", !index.wasReset());
+		ensure_equals("replayed count", index.getCount(), count - count / 5);
+		for (U32 i = 0; i < count; ++i)
+		{
+			Entry entry;
+			S32 idx = index.find(ids[i], entry, false);
+			if (i % 5 == 0)
+			{
+				ensure("removed stays removed", idx < 0);
+			}
+			else
+			{
+				ensure("replayed", idx >= 0);
+				ensure_equals("replayed image size", entry.mImageSize, (S32)(2000 + i));
+			}
+		}
+		index.close();
+
+		// A different size starts over.
+		ensure("open with another size", index.open(mFileName, 8192, false));
+		ensure("reset", index.wasReset());
+		ensure_equals("empty", index.getCount(), 0U);
+	}
+}
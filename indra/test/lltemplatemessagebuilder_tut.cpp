@@ -970,5 +970,41 @@ namespace tut
 		ensure_equals("Ensure unchanged buffer ", strlen(outBuffer), 0);
 		delete reader;
 	}
+
+	template<> template<>
+	void LLTemplateMessageBuilderTestObject::test<46>()
+		// many repeated blocks with variable data, read after the packet is gone
+	{
+		LLMessageTemplate messageTemplate = defaultTemplate();
+		LLMessageBlock* block = createBlock(const_cast<char*>(_PREHASH_Test0), MVT_U32, 4);
+		block->addVariable(const_cast<char*>(_PREHASH_Test1), MVT_VARIABLE, 1);
+		messageTemplate.addBlock(block);
+		LLTemplateMessageBuilder* builder = defaultBuilder(messageTemplate);
+		const S32 blockCount = 40;
+		U8 data[blockCount];
+		for (S32 i = 0; i < blockCount; ++i)
+		{
+			data[i] = (U8)i;
+			if (i > 0)
+			{
+				builder->nextBlock(_PREHASH_Test0);
+			}
+			builder->addU32(_PREHASH_Test0, 0xdead0000 + i);
+			builder->addBinaryData(_PREHASH_Test1, data, i);
+		}
+		LLTemplateMessageReader* reader = setReader(messageTemplate, builder);
+		ensure_equals("Ensure block count", reader->getNumberOfBlocks(_PREHASH_Test0), blockCount);
+		for (S32 i = 0; i < blockCount; ++i)
+		{
+			U32 outValue;
+			U8 outData[blockCount];
+			reader->getU32(_PREHASH_Test0, _PREHASH_Test0, outValue, i);
+			ensure_equals("Ensure U32", outValue, 0xdead0000 + i);
+			ensure_equals("Ensure size", reader->getSize(_PREHASH_Test0, i, _PREHASH_Test1), i);
+			reader->getBinaryData(_PREHASH_Test0, _PREHASH_Test1, outData, i, i);
+			ensure("Ensure binary data", memcmp(outData, data, i) == 0);
+		}
+		delete reader;
+	}
 }
 
@@ -0,0 +1,547 @@
+/**
+ * @file aicurlpollbench.cpp
+ * @brief Compares select() and epoll() for driving a curl multi handle with many connections
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Usage: aicurlpollbench [connections] [requests per connection] [response size]
+//
+// Starts a minimal HTTP/1.1 keep-alive server on the loopback interface and
+// fetches from it over <connections> persistent connections, driving a curl
+// multi handle with curl_multi_socket_action, like AICurlThread does: once
+// waiting for the sockets with select() and once with epoll().
+//
+// select() can't handle filedescriptors of FD_SETSIZE and up, so the select()
+// pass is limited to what fits; the epoll() pass is run with that many
+// connections too, and then with all of them. Reports requests per second
+// and the CPU time used by the client thread per request.
+//
+// Linux only.
+
+#include "linden_common.h"
+
+#include <cerrno>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+
+#include <curl/curl.h>
+
+#include "llerrorcontrol.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+namespace
+{
+	// CPU time used by the calling thread, in seconds.
+	F64 thread_cpu_time()
+	{
+		struct rusage usage;
+		getrusage(RUSAGE_THREAD, &usage);
+		return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+	}
+
+	//-------------------------------------------------------------------------
+	// The HTTP stand-in: answers every request that ends with an empty line
+	// with a fixed size body and keeps the connection open.
+
+	class LoopbackServer : public LLThread
+	{
+	public:
+		LoopbackServer(S32 response_size) : LLThread("LoopbackServer"), mListenFd(-1), mEPollFd(-1), mPort(0)
+		{
+			std::string body(response_size, 'x');
+			mResponse = llformat("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: %d\r\n\r\n", response_size) + body;
+		}
+
+		~LoopbackServer()
+		{
+			for (std::map<int, std::string>::iterator iter = mPending.begin(); iter != mPending.end(); ++iter)
+			{
+				close(iter->first);
+			}
+			if (mListenFd != -1)
+			{
+				close(mListenFd);
+			}
+			if (mEPollFd != -1)
+			{
+				close(mEPollFd);
+			}
+		}
+
+		// Returns false if the server could not be set up.
+		bool listen()
+		{
+			mListenFd = socket(AF_INET, SOCK_STREAM, 0);
+			if (mListenFd == -1)
+			{
+				return false;
+			}
+			int on = 1;
+			setsockopt(mListenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+			struct sockaddr_in addr;
+			memset(&addr, 0, sizeof(addr));
+			addr.sin_family = AF_INET;
+			addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			addr.sin_port = 0;
+			socklen_t len = sizeof(addr);
+			if (bind(mListenFd, (struct sockaddr*)&addr, sizeof(addr)) == -1 ||
+				::listen(mListenFd, SOMAXCONN) == -1 ||
+				getsockname(mListenFd, (struct sockaddr*)&addr, &len) == -1)
+			{
+				llwarns << "Can't set up listen socket: " << strerror(errno) << llendl;
+				return false;
+			}
+			fcntl(mListenFd, F_SETFL, fcntl(mListenFd, F_GETFL) | O_NONBLOCK);
+			mPort = ntohs(addr.sin_port);
+			mEPollFd = epoll_create(256);
+			if (mEPollFd == -1)
+			{
+				return false;
+			}
+			struct epoll_event event;
+			memset(&event, 0, sizeof(event));
+			event.events = EPOLLIN;
+			event.data.fd = mListenFd;
+			return epoll_ctl(mEPollFd, EPOLL_CTL_ADD, mListenFd, &event) == 0;
+		}
+
+		U16 getPort() const { return mPort; }
+
+		/*virtual*/ void run()
+		{
+			std::vector<struct epoll_event> events(256);
+			while (!isQuitting())
+			{
+				int ready = epoll_wait(mEPollFd, &events[0], events.size(), 100);
+				for (int i = 0; i < ready; ++i)
+				{
+					int fd = events[i].data.fd;
+					if (fd == mListenFd)
+					{
+						accept_all();
+					}
+					else
+					{
+						serve(fd);
+					}
+				}
+			}
+		}
+
+	private:
+		void accept_all()
+		{
+			int fd;
+			while ((fd = accept(mListenFd, NULL, NULL)) != -1)
+			{
+				int on = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+				fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+				struct epoll_event event;
+				memset(&event, 0, sizeof(event));
+				event.events = EPOLLIN;
+				event.data.fd = fd;
+				epoll_ctl(mEPollFd, EPOLL_CTL_ADD, fd, &event);
+				mPending[fd].clear();
+			}
+		}
+
+		void serve(int fd)
+		{
+			std::string& pending = mPending[fd];
+			char buf[4096];
+			ssize_t len;
+			while ((len = read(fd, buf, sizeof(buf))) > 0)
+			{
+				pending.append(buf, len);
+			}
+			if (len == 0 || (len == -1 && errno != EAGAIN && errno != EWOULDBLOCK))
+			{
+				// Closed by curl (or broken).
+				close(fd);
+				mPending.erase(fd);
+				return;
+			}
+			std::string::size_type end;
+			while ((end = pending.find("\r\n\r\n")) != std::string::npos)
+			{
+				pending.erase(0, end + 4);
+				// The responses are small enough to fit in the socket buffer, and curl
+				// only sends the next request after reading this one.
+				size_t written = 0;
+				while (written < mResponse.size())
+				{
+					ssize_t res = write(fd, mResponse.data() + written, mResponse.size() - written);
+					if (res == -1)
+					{
+						if (errno != EAGAIN && errno != EWOULDBLOCK)
+						{
+							break;
+						}
+						ms_sleep(0);
+						continue;
+					}
+					written += res;
+				}
+			}
+		}
+
+		int mListenFd;
+		int mEPollFd;
+		U16 mPort;
+		std::string mResponse;
+		std::map<int, std::string> mPending;			// Partially received requests per connection.
+	};
+
+	//-------------------------------------------------------------------------
+	// The client.
+
+	size_t discard_callback(char* ptr, size_t size, size_t nmemb, void* userdata)
+	{
+		return size * nmemb;
+	}
+
+	// Socket administration shared by both backends.
+	class Poller
+	{
+	public:
+		Poller() : mTimeout(-1) { }
+		virtual ~Poller() { }
+
+		// The curl socket callback; action is one of the CURL_POLL_* values.
+		virtual void set(curl_socket_t s, int action) = 0;
+		// Wait for events and pass them to curl_multi_socket_action. Returns false on error.
+		virtual bool wait(CURLM* multi, int& running) = 0;
+
+		long mTimeout;									// As set by curl's timer callback.
+
+		static int socket_callback(CURL* easy, curl_socket_t s, int action, void* userp, void* socketp)
+		{
+			static_cast<Poller*>(userp)->set(s, action);
+			return 0;
+		}
+
+		static int timer_callback(CURLM* multi, long timeout_ms, void* userp)
+		{
+			static_cast<Poller*>(userp)->mTimeout = timeout_ms;
+			return 0;
+		}
+
+	protected:
+		long timeout_ms() const { return mTimeout < 0 ? 100 : mTimeout; }
+	};
+
+	class SelectPoller : public Poller
+	{
+	public:
+		/*virtual*/ void set(curl_socket_t s, int action)
+		{
+			if (action == CURL_POLL_REMOVE)
+			{
+				mActions.erase(s);
+			}
+			else
+			{
+				mActions[s] = action;
+			}
+		}
+
+		/*virtual*/ bool wait(CURLM* multi, int& running)
+		{
+			// Like the PollSet's, we have to rebuild the fd_set's every time.
+			fd_set read_fd_set;
+			fd_set write_fd_set;
+			FD_ZERO(&read_fd_set);
+			FD_ZERO(&write_fd_set);
+			int nfds = 0;
+			for (std::map<curl_socket_t, int>::iterator iter = mActions.begin(); iter != mActions.end(); ++iter)
+			{
+				if ((iter->second & CURL_POLL_IN))
+				{
+					FD_SET(iter->first, &read_fd_set);
+				}
+				if ((iter->second & CURL_POLL_OUT))
+				{
+					FD_SET(iter->first, &write_fd_set);
+				}
+				nfds = iter->first + 1;
+			}
+			struct timeval timeout;
+			timeout.tv_sec = timeout_ms() / 1000;
+			timeout.tv_usec = (timeout_ms() % 1000) * 1000;
+			int ready = select(nfds, &read_fd_set, &write_fd_set, NULL, &timeout);
+			if (ready == -1)
+			{
+				return errno == EINTR;
+			}
+			if (ready == 0)
+			{
+				curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+				return true;
+			}
+			// Copy the ready fds first, because curl changes mActions from the socket callback.
+			std::vector<std::pair<curl_socket_t, int> > ready_fds;
+			for (curl_socket_t fd = 0; fd < nfds; ++fd)
+			{
+				int ev_bitmask = (FD_ISSET(fd, &read_fd_set) ? CURL_CSELECT_IN : 0) | (FD_ISSET(fd, &write_fd_set) ? CURL_CSELECT_OUT : 0);
+				if (ev_bitmask)
+				{
+					ready_fds.push_back(std::make_pair(fd, ev_bitmask));
+				}
+			}
+			for (std::vector<std::pair<curl_socket_t, int> >::iterator iter = ready_fds.begin(); iter != ready_fds.end(); ++iter)
+			{
+				curl_multi_socket_action(multi, iter->first, iter->second, &running);
+			}
+			return true;
+		}
+
+	private:
+		std::map<curl_socket_t, int> mActions;
+	};
+
+	class EPollPoller : public Poller
+	{
+	public:
+		EPollPoller() : mEvents(256)
+		{
+			mEPollFd = epoll_create(256);
+		}
+
+		~EPollPoller()
+		{
+			close(mEPollFd);
+		}
+
+		/*virtual*/ void set(curl_socket_t s, int action)
+		{
+			if ((size_t)s >= mActions.size())
+			{
+				mActions.resize(s + 1, CURL_POLL_NONE);
+			}
+			int old_action = mActions[s];
+			mActions[s] = action == CURL_POLL_REMOVE ? CURL_POLL_NONE : action;
+			struct epoll_event event;
+			memset(&event, 0, sizeof(event));
+			event.events = ((action & CURL_POLL_IN) ? EPOLLIN : 0) | ((action & CURL_POLL_OUT) ? EPOLLOUT : 0);
+			event.data.fd = s;
+			if (action == CURL_POLL_REMOVE)
+			{
+				epoll_ctl(mEPollFd, EPOLL_CTL_DEL, s, &event);
+			}
+			else
+			{
+				epoll_ctl(mEPollFd, old_action == CURL_POLL_NONE ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, s, &event);
+			}
+		}
+
+		/*virtual*/ bool wait(CURLM* multi, int& running)
+		{
+			int ready = epoll_wait(mEPollFd, &mEvents[0], mEvents.size(), timeout_ms());
+			if (ready == -1)
+			{
+				return errno == EINTR;
+			}
+			if (ready == 0)
+			{
+				curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+				return true;
+			}
+			for (int i = 0; i < ready; ++i)
+			{
+				int ev_bitmask = 0;
+				if ((mEvents[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+				{
+					ev_bitmask |= CURL_CSELECT_IN;
+				}
+				if ((mEvents[i].events & EPOLLOUT))
+				{
+					ev_bitmask |= CURL_CSELECT_OUT;
+				}
+				if ((mEvents[i].events & EPOLLERR))
+				{
+					ev_bitmask |= CURL_CSELECT_ERR;
+				}
+				curl_multi_socket_action(multi, mEvents[i].data.fd, ev_bitmask, &running);
+			}
+			return true;
+		}
+
+	private:
+		int mEPollFd;
+		std::vector<int> mActions;						// Indexed by filedescriptor.
+		std::vector<struct epoll_event> mEvents;
+	};
+
+	// Fetches connections * requests responses over connections persistent connections.
+	void run_pass(Poller& poller, const char* name, U16 port, S32 connections, S32 requests)
+	{
+		CURLM* multi = curl_multi_init();
+		curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION, &Poller::socket_callback);
+		curl_multi_setopt(multi, CURLMOPT_SOCKETDATA, &poller);
+		curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, &Poller::timer_callback);
+		curl_multi_setopt(multi, CURLMOPT_TIMERDATA, &poller);
+		// Keep every connection in the connection cache between requests.
+		curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)connections);
+
+		std::string url = llformat("http://127.0.0.1:%u/", port);
+		std::vector<CURL*> easy_handles(connections);
+		for (S32 i = 0; i < connections; ++i)
+		{
+			CURL* easy = curl_easy_init();
+			curl_easy_setopt(easy, CURLOPT_URL, url.c_str());
+			curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, &discard_callback);
+			curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+			curl_easy_setopt(easy, CURLOPT_TCP_NODELAY, 1L);
+			curl_multi_add_handle(multi, easy);
+			easy_handles[i] = easy;
+		}
+
+		S32 const total = connections * requests;
+		S32 started = connections;
+		S32 done = 0;
+		S32 failed = 0;
+		int running = 0;
+		LLTimer timer;
+		F64 cpu_start = thread_cpu_time();
+		curl_multi_socket_action(multi, CURL_SOCKET_TIMEOUT, 0, &running);
+		while (done < total)
+		{
+			if (!poller.wait(multi, running))
+			{
+				llwarns << name << " failed: " << strerror(errno) << llendl;
+				break;
+			}
+			CURLMsg* msg;
+			int queued;
+			while ((msg = curl_multi_info_read(multi, &queued)))
+			{
+				if (msg->msg != CURLMSG_DONE)
+				{
+					continue;
+				}
+				CURL* easy = msg->easy_handle;
+				if (msg->data.result != CURLE_OK)
+				{
+					++failed;
+				}
+				++done;
+				curl_multi_remove_handle(multi, easy);
+				if (started < total)
+				{
+					// Next request on the same (cached) connection.
+					curl_multi_add_handle(multi, easy);
+					++started;
+				}
+			}
+		}
+		F64 cpu = thread_cpu_time() - cpu_start;
+		F32 elapsed = llmax(timer.getElapsedTimeF32(), 0.001f);
+
+		for (S32 i = 0; i < connections; ++i)
+		{
+			curl_multi_remove_handle(multi, easy_handles[i]);
+			curl_easy_cleanup(easy_handles[i]);
+		}
+		curl_multi_cleanup(multi);
+
+		std::cout << llformat("%-8s %5d connections: %9.1f requests/s, %6.2f us CPU/request (%d failed)",
+							  name, connections, done / elapsed, cpu * 1000000.0 / llmax(done, 1), failed)
+				  << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 connections = argc > 1 ? llmax(atoi(argv[1]), 1) : 1024;
+	S32 requests = argc > 2 ? llmax(atoi(argv[2]), 1) : 20;
+	S32 response_size = argc > 3 ? llmax(atoi(argv[3]), 0) : 1024;
+
+	// Both ends of every connection are in this process.
+	struct rlimit limit;
+	getrlimit(RLIMIT_NOFILE, &limit);
+	rlim_t needed = 2 * connections + 64;
+	if (limit.rlim_cur < needed)
+	{
+		limit.rlim_cur = llmin(needed, limit.rlim_max);
+		setrlimit(RLIMIT_NOFILE, &limit);
+		if (limit.rlim_cur < needed)
+		{
+			connections = (limit.rlim_cur - 64) / 2;
+			std::cout << "Open file limit is " << limit.rlim_cur << ", using " << connections << " connections." << std::endl;
+		}
+	}
+
+	curl_global_init(CURL_GLOBAL_ALL);
+	LoopbackServer* server = new LoopbackServer(response_size);
+	if (!server->listen())
+	{
+		std::cerr << "Can't start the loopback server." << std::endl;
+		return 1;
+	}
+	server->start();
+
+	// All client and server filedescriptors of the select() pass must be less than FD_SETSIZE.
+	S32 select_connections = llmin(connections, (FD_SETSIZE - 64) / 2);
+	{
+		SelectPoller poller;
+		run_pass(poller, "select()", server->getPort(), select_connections, requests);
+	}
+	{
+		EPollPoller poller;
+		run_pass(poller, "epoll()", server->getPort(), select_connections, requests);
+	}
+	if (connections > select_connections)
+	{
+		EPollPoller poller;
+		run_pass(poller, "epoll()", server->getPort(), connections, requests);
+	}
+
+	server->shutdown();
+	delete server;
+	curl_global_cleanup();
+	return 0;
+}
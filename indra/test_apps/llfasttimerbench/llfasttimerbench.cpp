@@ -0,0 +1,108 @@
+/**
+ * @file llfasttimerbench.cpp
+ * @brief Overhead of fast timers in the main thread and in others
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+// Usage: llfasttimerbench [iterations]
+//
+// Times an empty LLFastTimer scope the given number of times (1000000 by
+// default) in the main thread and in another thread, and a tenth of that
+// while a trace is being recorded. Reports nanoseconds per timer.
+
+#include "linden_common.h"
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llfasttimer.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+namespace
+{
+	LLFastTimer::DeclareTimer FTM_BENCHMARK("Fast timer benchmark");
+
+	// Returns nanoseconds per timer.
+	F64 time_timers(S32 iterations)
+	{
+		LLTimer timer;
+		for (S32 i = 0; i < iterations; ++i)
+		{
+			LLFastTimer t(FTM_BENCHMARK);
+		}
+		return timer.getElapsedTimeF64() * 1000000000.0 / iterations;
+	}
+
+	class TimerThread : public LLThread
+	{
+	public:
+		TimerThread(S32 iterations) :
+			LLThread("FastTimerBenchmark"), mIterations(iterations), mResult(0)
+		{
+		}
+
+		/*virtual*/ void run()
+		{
+			mResult = time_timers(mIterations);
+		}
+
+		S32 mIterations;
+		F64 mResult;
+	};
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 iterations = argc > 1 ? llmax(atoi(argv[1]), 10) : 1000000;
+
+	F64 main_thread = time_timers(iterations);
+	TimerThread thread(iterations);
+	thread.start();
+	while (!thread.isStopped())
+	{
+		ms_sleep(1);
+	}
+	LLFastTimer::nextFrame();
+
+	LLFastTimer::startTrace(1, "");
+	F64 main_thread_tracing = time_timers(iterations / 10);
+	LLFastTimer::nextFrame();
+
+	std::cout << "Fast timer overhead: " << main_thread << " ns in the main thread, " << thread.mResult
+			  << " ns in another thread, " << main_thread_tracing << " ns while tracing" << std::endl;
+	std::cout << "ok" << std::endl;
+	return 0;
+}
@@ -0,0 +1,276 @@
+/**
+ * @file llimagedecodebench.cpp
+ * @brief Measures JPEG2000 decode throughput of LLImageDecodeThread per worker pool size
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Usage: llimagedecodebench <directory with .j2c files> [max threads] [passes]
+//
+// Decodes every .j2c file in the directory, <passes> times, through
+// LLImageDecodeThread: first with its own thread, then on a worker pool of
+// 1, 2, 4 ... max threads. The own thread pass is also run with the scalar
+// OpenJPEG kernels. Reports images and megapixels per second.
+//
+// Then compares the CPU time of loading all the files with a cold and with a
+// warm decoded image cache (LLImageRawCache), with and without compression.
+
+#include "linden_common.h"
+
+#include <ctime>
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+#include "llimage.h"
+#include "llimagej2c.h"
+#include "llimagerawcache.h"
+#include "llimageworker.h"
+#include "llmemory.h"
+#include "lltimer.h"
+#include "llworkerpool.h"
+#include "openjpeg.h"
+
+namespace
+{
+	struct SourceFile
+	{
+		std::string mName;
+		std::vector<U8> mData;
+	};
+
+	class CountingResponder : public LLImageDecodeThread::Responder
+	{
+	public:
+		CountingResponder() : mDone(0), mFailed(0), mPixels(0) { }
+
+		/*virtual*/ void completed(bool success, LLImageRaw* raw, LLImageRaw* aux)
+		{
+			if (success && raw)
+			{
+				mPixels += (U32)raw->getWidth() * raw->getHeight();
+			}
+			else
+			{
+				mFailed++;
+			}
+			mDone++;
+		}
+
+		LLAtomicS32 mDone;
+		LLAtomicS32 mFailed;
+		LLAtomicU32 mPixels;	// Wraps after 4 gigapixels; keep passes * data set below that.
+	};
+
+	bool load_files(const std::string& dirname, std::vector<SourceFile>& files)
+	{
+		LLDirIterator iter(dirname, "*.j2c");
+		std::string name;
+		while (iter.next(name))
+		{
+			std::string path = dirname + gDirUtilp->getDirDelimiter() + name;
+			llifstream file(path, std::ios::binary);
+			if (!file.is_open())
+			{
+				llwarns << "Can't open " << path << llendl;
+				continue;
+			}
+			file.seekg(0, std::ios::end);
+			S32 size = (S32)file.tellg();
+			file.seekg(0, std::ios::beg);
+			if (size <= 0)
+			{
+				continue;
+			}
+			files.push_back(SourceFile());
+			files.back().mName = name;
+			files.back().mData.resize(size);
+			file.read((char*)&files.back().mData[0], size);
+		}
+		return !files.empty();
+	}
+
+	// Decodes all files passes times. threads == 0 means without the pool.
+	// With split_decodes, each decode is split in tile jobs that run on the pool too.
+	void run_pass(const std::vector<SourceFile>& files, S32 threads, S32 passes, bool split_decodes)
+	{
+		LLWorkerPool::initClass(threads);
+		if (LLWorkerPool* pool = LLWorkerPool::getInstance())
+		{
+			pool->addSubsystem("imagedecode", LLWorkerPool::PRIORITY_CLASS_NORMAL, threads);
+			if (split_decodes)
+			{
+				pool->addSubsystem("j2cdecode", LLWorkerPool::PRIORITY_CLASS_HIGH, threads * 2);
+			}
+		}
+		LLImageDecodeThread* decoder = new LLImageDecodeThread(true);
+		LLPointer<CountingResponder> responder = new CountingResponder;
+
+		LLTimer timer;
+		S32 total = 0;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (std::vector<SourceFile>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+			{
+				LLPointer<LLImageJ2C> image = new LLImageJ2C;
+				U8* data = image->allocateData(iter->mData.size());
+				memcpy(data, &iter->mData[0], iter->mData.size());
+				decoder->decodeImage(image, LLQueuedThread::PRIORITY_NORMAL, 0, FALSE, responder);
+				++total;
+			}
+		}
+		while (responder->mDone < total)
+		{
+			decoder->update(1);
+			ms_sleep(1);
+		}
+		F32 elapsed = llmax(timer.getElapsedTimeF32(), 0.001f);
+
+		decoder->shutdown();
+		delete decoder;
+		LLWorkerPool::cleanupClass();
+
+		std::cout << (threads ? llformat("pool %2d threads", threads) : std::string("own thread     "))
+				  << (split_decodes ? " + tile jobs" : "            ")
+				  << llformat(": %8.1f images/s %8.2f Mpixels/s (%d failed)",
+							  total / elapsed, (U32)responder->mPixels / elapsed / 1000000.f, (S32)responder->mFailed)
+				  << std::endl;
+	}
+
+	// Like a region load: decode everything and store it in the decoded image
+	// cache, then load everything again from the cache.
+	void run_raw_cache(const std::vector<SourceFile>& files, bool compress)
+	{
+		std::string dirname = std::string(LLFile::tmpdir()) + "llimagedecodebench_raw";
+		LLImageRawCache* cache = new LLImageRawCache(true);
+		cache->purgeCache(dirname);
+		cache->initCache(dirname, 4096ll * 1024 * 1024, compress);
+
+		typedef std::pair<LLUUID, std::pair<S32, S32> > stored_t;	// id, discard, data size
+		std::vector<stored_t> stored;
+		std::clock_t start = std::clock();
+		for (std::vector<SourceFile>::const_iterator iter = files.begin(); iter != files.end(); ++iter)
+		{
+			LLPointer<LLImageJ2C> image = new LLImageJ2C;
+			U8* data = image->allocateData(iter->mData.size());
+			memcpy(data, &iter->mData[0], iter->mData.size());
+			if (!image->updateData())
+			{
+				continue;
+			}
+			LLPointer<LLImageRaw> raw = new LLImageRaw(image->getWidth(), image->getHeight(), image->getComponents());
+			if (image->decode(raw, 0.f))
+			{
+				stored.push_back(stored_t(LLUUID::generateNewID(), std::make_pair((S32)image->getDiscardLevel(), image->getDataSize())));
+				cache->write(stored.back().first, stored.back().second.first, stored.back().second.second, raw);
+			}
+		}
+		while (cache->update(1))
+		{
+			ms_sleep(1);
+		}
+		F32 cold = (F32)(std::clock() - start) / CLOCKS_PER_SEC;
+
+		start = std::clock();
+		S32 hits = 0;
+		for (std::vector<stored_t>::iterator iter = stored.begin(); iter != stored.end(); ++iter)
+		{
+			if (cache->read(iter->first, iter->second.first, iter->second.second).notNull())
+			{
+				++hits;
+			}
+		}
+		F32 warm = (F32)(std::clock() - start) / CLOCKS_PER_SEC;
+
+		std::cout << llformat("Decoded cache%s: cold %8.3f s, warm %8.3f s CPU, %d/%d hits, %.1f MB",
+							  compress ? " (zlib)" : "       ", cold, warm, hits, (S32)stored.size(),
+							  cache->getUsage() / (1024.f * 1024.f))
+				  << std::endl;
+
+		cache->purgeCache(dirname);
+		cache->shutdown();
+		delete cache;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <directory with .j2c files> [max threads] [passes]" << std::endl;
+		return 1;
+	}
+	std::string dirname = argv[1];
+	S32 max_threads = argc > 2 ? atoi(argv[2]) : LLWorkerPool::getDefaultThreadCount() + 1;
+	S32 passes = argc > 3 ? llmax(atoi(argv[3]), 1) : 1;
+
+	LLPrivateMemoryPoolManager::initClass(FALSE, 0);
+	LLImage::initClass();
+
+	std::vector<SourceFile> files;
+	if (!load_files(dirname, files))
+	{
+		std::cerr << "No .j2c files found in " << dirname << std::endl;
+		return 1;
+	}
+	std::cout << "Decoding " << files.size() << " files, " << passes << " passes" << std::endl;
+
+	// Without the SIMD kernels first, if there are any to compare with.
+	S32 cpu_features = opj_get_cpu_features();
+	if (cpu_features)
+	{
+		std::cout << "Scalar kernels:" << std::endl;
+		opj_set_cpu_features(0);
+		run_pass(files, 0, passes, false);
+		opj_set_cpu_features(cpu_features);
+		std::cout << "SIMD kernels:" << std::endl;
+	}
+	run_pass(files, 0, passes, false);
+	S32 threads = 1;
+	for ( ; threads < max_threads; threads *= 2)
+	{
+		run_pass(files, threads, passes, false);
+		run_pass(files, threads, passes, true);
+	}
+	run_pass(files, max_threads, passes, false);
+	run_pass(files, max_threads, passes, true);
+
+	run_raw_cache(files, false);
+	run_raw_cache(files, true);
+
+	LLImage::cleanupClass();
+	LLPrivateMemoryPoolManager::destroyClass();
+	return 0;
+}
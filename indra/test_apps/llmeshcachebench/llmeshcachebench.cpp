@@ -0,0 +1,379 @@
+/**
+ * @file llmeshcachebench.cpp
+ * @brief Loads cached .mesh assets from the VFS and from the mesh cache
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+// Usage: llmeshcachebench <directory with .mesh files> <work directory> [passes]
+//
+// Stores every .mesh asset in the directory in a VFS and in an LLMeshCache in
+// the work directory, unless they are already there, and then loads all of
+// them from both as LLMeshRepoThread does: the header, and then every blob
+// the header lists. From the VFS, every header costs a read of the first 4KB
+// of the asset and a parse of the LLSD header and every blob a read of the
+// VFS file; the mesh cache answers headers from its index and reads a blob
+// with a single positioned read.
+//
+// The cold pass is the first after opening the VFS, or loading the cache
+// index, and includes the time that takes; the warm passes follow. Run it a
+// second time, after dropping the file cache of the OS, for numbers of a cold
+// disk. Reports headers and blobs per second and MB/s and checks that both
+// return the same bytes.
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+#include "llmeshcache.h"
+#include "llsd.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
+#include "llvfile.h"
+#include "llvfs.h"
+#include "llvfsthread.h"
+
+namespace
+{
+	struct Asset
+	{
+		LLUUID mID;
+		std::vector<U8> mData;
+	};
+
+	struct PassStats
+	{
+		PassStats() : mHeaders(0), mBlobs(0), mBytes(0), mChecksum(0) { }
+
+		S32 mHeaders;
+		S32 mBlobs;
+		U64 mBytes;
+		U32 mChecksum;
+	};
+
+	bool load_files(const std::string& dirname, std::vector<Asset>& assets)
+	{
+		LLDirIterator iter(dirname, "*.mesh");
+		std::string name;
+		while (iter.next(name))
+		{
+			std::string path = dirname + gDirUtilp->getDirDelimiter() + name;
+			llifstream file(path, std::ios::binary);
+			if (!file.is_open())
+			{
+				llwarns << "Can't open " << path << llendl;
+				continue;
+			}
+			file.seekg(0, std::ios::end);
+			S32 size = (S32)file.tellg();
+			file.seekg(0, std::ios::beg);
+			if (size <= 0)
+			{
+				continue;
+			}
+			assets.push_back(Asset());
+			// Assets exported from the cache are named after their id.
+			if (!assets.back().mID.set(name.substr(0, name.find('.')), FALSE))
+			{
+				assets.back().mID.generate();
+			}
+			assets.back().mData.resize(size);
+			file.read((char*)&assets.back().mData[0], size);
+		}
+		return !assets.empty();
+	}
+
+	// What LLMeshRepoThread::headerReceived() does with the first bytes of an asset.
+	bool parse_header(const U8* data, S32 data_size, LLSD& header, S32& header_size)
+	{
+		static const std::string deprecated_header("<? LLSD/Binary ?>");
+		header_size = 0;
+		if ((U32)data_size > deprecated_header.size() &&
+			!memcmp(data, deprecated_header.data(), deprecated_header.size()))
+		{
+			header_size = deprecated_header.size() + 1;
+		}
+		LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+		parser->setCompact(true);
+		S32 bytes_read = 0;
+		if (parser->parse(data + header_size, data_size - header_size, header, &bytes_read) <= 0)
+		{
+			return false;
+		}
+		header_size += bytes_read;
+		return true;
+	}
+
+	void add_blob(PassStats& stats, const U8* data, S32 size)
+	{
+		stats.mBlobs++;
+		stats.mBytes += size;
+		for (S32 i = 0; i < size; ++i)
+		{
+			stats.mChecksum = stats.mChecksum * 31 + data[i];
+		}
+	}
+
+	void store(const std::vector<Asset>& assets, LLVFS* vfs, LLMeshCache& cache)
+	{
+		for (size_t i = 0; i < assets.size(); ++i)
+		{
+			const Asset& asset = assets[i];
+			LLSD header;
+			S32 header_size;
+			S32 size = (S32)asset.mData.size();
+			if (!parse_header(&asset.mData[0], llmin(size, 4096), header, header_size))
+			{
+				llwarns << "Not a mesh asset: " << asset.mID << llendl;
+				continue;
+			}
+
+			// As the responders leave it once every blob was fetched.
+			LLVFile file(vfs, asset.mID, LLAssetType::AT_MESH, LLVFile::WRITE);
+			if (file.setMaxSize(size))
+			{
+				file.write(&asset.mData[0], size);
+			}
+
+			LLMeshCache::Header cache_header;
+			cache_header.fromLLSD(header, header_size);
+			cache.writeHeader(asset.mID, cache_header, &asset.mData[0], size);
+		}
+		cache.saveIndex();
+	}
+
+	// LLMeshRepoThread::fetchMeshHeader() and the fetch*() functions, from the VFS.
+	void load_vfs(const std::vector<Asset>& assets, LLVFS* vfs, PassStats& stats)
+	{
+		for (size_t i = 0; i < assets.size(); ++i)
+		{
+			const LLUUID& id = assets[i].mID;
+			LLSD header;
+			S32 header_size;
+			{
+				LLVFile file(vfs, id, LLAssetType::AT_MESH);
+				S32 size = file.getSize();
+				if (size <= 0)
+				{
+					continue;
+				}
+				U8 buffer[4096];
+				S32 bytes = llmin(size, 4096);
+				file.read(buffer, bytes);
+				if (!parse_header(buffer, bytes, header, header_size))
+				{
+					continue;
+				}
+				stats.mHeaders++;
+			}
+
+			for (S32 blob = 0; blob < LLMeshCache::BLOB_COUNT; ++blob)
+			{
+				const LLSD& entry = header[LLMeshCache::getBlobName((LLMeshCache::EBlob)blob)];
+				S32 offset = header_size + entry["offset"].asInteger();
+				S32 size = entry["size"].asInteger();
+				if (size <= 0)
+				{
+					continue;
+				}
+				LLVFile file(vfs, id, LLAssetType::AT_MESH);
+				if (file.getSize() >= offset + size)
+				{
+					U8* buffer = new U8[size];
+					file.seek(offset);
+					file.read(buffer, size);
+					// The zero check of the fetch*() functions.
+					bool zero = true;
+					for (S32 j = 0; j < llmin(size, 1024) && zero; ++j)
+					{
+						zero = buffer[j] == 0;
+					}
+					if (!zero)
+					{
+						add_blob(stats, buffer, size);
+					}
+					delete [] buffer;
+				}
+			}
+		}
+	}
+
+	// The same with the mesh cache.
+	void load_cache(const std::vector<Asset>& assets, LLMeshCache& cache, PassStats& stats)
+	{
+		for (size_t i = 0; i < assets.size(); ++i)
+		{
+			const LLUUID& id = assets[i].mID;
+			LLMeshCache::Header header;
+			if (!cache.getHeader(id, header))
+			{
+				continue;
+			}
+			// What LLMeshRepoThread::setMeshHeader() gets.
+			LLSD sd = header.asLLSD();
+			stats.mHeaders++;
+
+			for (S32 blob = 0; blob < LLMeshCache::BLOB_COUNT; ++blob)
+			{
+				if (header.mSize[blob] <= 0)
+				{
+					continue;
+				}
+				S32 size = 0;
+				U8* buffer = cache.readBlob(id, (LLMeshCache::EBlob)blob, size);
+				if (buffer)
+				{
+					add_blob(stats, buffer, size);
+					delete [] buffer;
+				}
+			}
+		}
+	}
+
+	void report(const char* name, F32 open_time, F32 elapsed, const PassStats& stats)
+	{
+		elapsed = llmax(elapsed, 0.000001f);
+		std::cout << llformat("%-12s open %8.3f ms, %9.1f headers/s %9.1f blobs/s %8.2f MB/s",
+							  name, open_time * 1000.f, stats.mHeaders / elapsed, stats.mBlobs / elapsed,
+							  stats.mBytes / elapsed / (1024.f * 1024.f))
+				  << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc < 3)
+	{
+		std::cerr << "usage: " << argv[0] << " <directory with .mesh files> <work directory> [passes]" << std::endl;
+		return 1;
+	}
+	std::string dirname = argv[1];
+	std::string workdir = argv[2];
+	S32 passes = argc > 3 ? llmax(atoi(argv[3]), 1) : 3;
+
+	std::vector<Asset> assets;
+	if (!load_files(dirname, assets))
+	{
+		std::cerr << "No .mesh files found in " << dirname << std::endl;
+		return 1;
+	}
+	U64 total_size = 0;
+	for (size_t i = 0; i < assets.size(); ++i)
+	{
+		total_size += assets[i].mData.size();
+	}
+	LLFile::mkdir(workdir);
+	std::string delim = gDirUtilp->getDirDelimiter();
+	std::string index_name = workdir + delim + "mesh.vfs_index";
+	std::string data_name = workdir + delim + "mesh.vfs_data";
+	std::string cache_dir = workdir + delim + "meshes";
+	// Room for the VFS blocks and the cache to never evict.
+	U32 vfs_size = (U32)llmin(total_size * 2 + (16 << 20), (U64)0x7fffffff);
+	S64 cache_size = (S64)total_size * 2 + (16 << 20);
+
+	// As the viewer sets them up.
+	LLVFSThread::initClass(false);
+	LLVFile::initClass();
+
+	bool stored = false;
+	{
+		LLVFS* vfs = LLVFS::createLLVFS(index_name, data_name, FALSE, vfs_size, FALSE);
+		LLMeshCache cache;
+		cache.initCache(cache_dir, cache_size);
+		if (!vfs)
+		{
+			std::cerr << "Can't create the VFS in " << workdir << std::endl;
+			return 1;
+		}
+		if (cache.getEntries() < assets.size())
+		{
+			std::cout << "Storing " << assets.size() << " meshes, " << (total_size >> 10) << " KB in " << workdir << std::endl;
+			store(assets, vfs, cache);
+			stored = true;
+		}
+		delete vfs;
+	}
+	std::cout << "Loading " << assets.size() << " meshes, " << passes << " passes"
+			  << (stored ? " (the OS still has the files cached)" : "") << std::endl;
+
+	PassStats vfs_stats;
+	PassStats cache_stats;
+	{
+		LLTimer timer;
+		LLVFS* vfs = LLVFS::createLLVFS(index_name, data_name, FALSE, vfs_size, FALSE);
+		F32 open_time = timer.getElapsedTimeF32();
+		timer.reset();
+		load_vfs(assets, vfs, vfs_stats);
+		report("VFS cold", open_time, timer.getElapsedTimeF32(), vfs_stats);
+
+		for (S32 pass = 1; pass < passes; ++pass)
+		{
+			PassStats stats;
+			timer.reset();
+			load_vfs(assets, vfs, stats);
+			report("VFS warm", 0.f, timer.getElapsedTimeF32(), stats);
+		}
+		delete vfs;
+	}
+	{
+		LLTimer timer;
+		LLMeshCache cache;
+		cache.initCache(cache_dir, cache_size);
+		F32 open_time = timer.getElapsedTimeF32();
+		timer.reset();
+		load_cache(assets, cache, cache_stats);
+		report("cache cold", open_time, timer.getElapsedTimeF32(), cache_stats);
+
+		for (S32 pass = 1; pass < passes; ++pass)
+		{
+			PassStats stats;
+			timer.reset();
+			load_cache(assets, cache, stats);
+			report("cache warm", 0.f, timer.getElapsedTimeF32(), stats);
+		}
+	}
+
+	LLVFile::cleanupClass();
+	LLVFSThread::cleanupClass();
+
+	bool ok = vfs_stats.mHeaders == cache_stats.mHeaders && vfs_stats.mBlobs == cache_stats.mBlobs &&
+			  vfs_stats.mChecksum == cache_stats.mChecksum;
+	std::cout << (ok ? "ok" : "MISMATCH between the VFS and the cache") << std::endl;
+	return ok ? 0 : 1;
+}
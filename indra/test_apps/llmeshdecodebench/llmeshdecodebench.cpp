@@ -0,0 +1,368 @@
+/**
+ * @file llmeshdecodebench.cpp
+ * @brief Feeds cached .mesh assets through the mesh decode stage
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+// Usage: llmeshdecodebench <directory with .mesh files> [max threads] [passes]
+//
+// Splits every .mesh asset in the directory in the blobs the mesh repository
+// fetches (the four LODs, the skin, the convex decomposition and the physics
+// shape) and decodes all of them, <passes> times, like the "meshdecode"
+// workers do: first on the feeding thread, then on a worker pool of 1, 2,
+// 4 ... max threads. As in LLMeshRepoThread::queueDecode(), a blob that the
+// pool doesn't take is decoded on the feeding thread. Reports blobs and MB
+// per second and the average time a blob waited for a worker and decoded,
+// and checks that every pass decoded the same vertices.
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "lldir.h"
+#include "lldiriterator.h"
+#include "llfile.h"
+#include "llsd.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
+#include "llvolume.h"
+#include "llvolumemgr.h"
+#include "llworkerpool.h"
+
+// Set by the viewer (llgl.cpp, llspatialpartition.cpp); llvolume uses them.
+BOOL gDebugGL = FALSE;
+U32 gOctreeMaxCapacity = 128;
+U32 gOctreeReserveCapacity = 4;
+
+namespace
+{
+	enum EBlobType { BLOB_LOD, BLOB_SKIN, BLOB_DECOMPOSITION, BLOB_PHYSICS_SHAPE };
+
+	struct SourceFile
+	{
+		LLUUID mID;
+		std::vector<U8> mData;
+	};
+
+	struct Blob
+	{
+		S32 mFile;
+		EBlobType mType;
+		S32 mLOD;
+		S32 mOffset;
+		S32 mSize;
+	};
+
+	const char* LOD_NAMES[] = { "lowest_lod", "low_lod", "medium_lod", "high_lod" };
+
+	bool load_files(const std::string& dirname, std::vector<SourceFile>& files)
+	{
+		LLDirIterator iter(dirname, "*.mesh");
+		std::string name;
+		while (iter.next(name))
+		{
+			std::string path = dirname + gDirUtilp->getDirDelimiter() + name;
+			llifstream file(path, std::ios::binary);
+			if (!file.is_open())
+			{
+				llwarns << "Can't open " << path << llendl;
+				continue;
+			}
+			file.seekg(0, std::ios::end);
+			S32 size = (S32)file.tellg();
+			file.seekg(0, std::ios::beg);
+			if (size <= 0)
+			{
+				continue;
+			}
+			files.push_back(SourceFile());
+			// Assets exported from the cache are named after their id.
+			if (!files.back().mID.set(name.substr(0, name.find('.')), FALSE))
+			{
+				files.back().mID.generate();
+			}
+			files.back().mData.resize(size);
+			file.read((char*)&files.back().mData[0], size);
+		}
+		return !files.empty();
+	}
+
+	void add_blob(std::vector<Blob>& blobs, const SourceFile& file, S32 index, const LLSD& header, S32 header_size,
+				  const std::string& name, EBlobType type, S32 lod)
+	{
+		if (!header.has(name))
+		{
+			return;
+		}
+		Blob blob;
+		blob.mFile = index;
+		blob.mType = type;
+		blob.mLOD = lod;
+		blob.mOffset = header_size + header[name]["offset"].asInteger();
+		blob.mSize = header[name]["size"].asInteger();
+		if (blob.mOffset >= header_size && blob.mSize > 0 && blob.mOffset + blob.mSize <= (S32)file.mData.size())
+		{
+			blobs.push_back(blob);
+		}
+	}
+
+	// What LLMeshRepoThread::headerReceived() reads of the header.
+	void split_files(const std::vector<SourceFile>& files, std::vector<Blob>& blobs)
+	{
+		static const std::string deprecated_header("<? LLSD/Binary ?>");
+		for (S32 i = 0; i < (S32)files.size(); ++i)
+		{
+			const std::vector<U8>& data = files[i].mData;
+			S32 header_size = 0;
+			if (data.size() > deprecated_header.size() &&
+				!memcmp(&data[0], deprecated_header.data(), deprecated_header.size()))
+			{
+				header_size = deprecated_header.size() + 1;
+			}
+			LLSD header;
+			LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+			S32 bytes_read = 0;
+			if (parser->parse(&data[0] + header_size, (S32)data.size() - header_size, header, &bytes_read) <= 0)
+			{
+				llwarns << "Not a mesh asset: " << files[i].mID << llendl;
+				continue;
+			}
+			header_size += bytes_read;
+
+			for (S32 lod = 0; lod < 4; ++lod)
+			{
+				add_blob(blobs, files[i], i, header, header_size, LOD_NAMES[lod], BLOB_LOD, lod);
+			}
+			add_blob(blobs, files[i], i, header, header_size, "skin", BLOB_SKIN, 0);
+			add_blob(blobs, files[i], i, header, header_size, "physics_convex", BLOB_DECOMPOSITION, 0);
+			add_blob(blobs, files[i], i, header, header_size, "physics_mesh", BLOB_PHYSICS_SHAPE, 0);
+		}
+	}
+
+	// What the *Received() functions of LLMeshRepoThread decode. Returns the
+	// number of vertices, 0 for the LLSD blobs and -1 on failure.
+	S32 decode_blob(const LLUUID& mesh_id, const Blob& blob, const U8* data)
+	{
+		if (blob.mType == BLOB_SKIN || blob.mType == BLOB_DECOMPOSITION)
+		{
+			LLSD sd;
+			return unzip_llsd(sd, data, blob.mSize) ? 0 : -1;
+		}
+
+		LLVolumeParams params;
+		params.setType(LL_PCODE_PROFILE_SQUARE, LL_PCODE_PATH_LINE);
+		params.setSculptID(mesh_id, LL_SCULPT_TYPE_MESH);
+		F32 detail = blob.mType == BLOB_LOD ? LLVolumeLODGroup::getVolumeScaleFromDetail(blob.mLOD) : 0.f;
+		LLPointer<LLVolume> volume = new LLVolume(params, detail);
+		if (!volume->unpackVolumeFaces(data, blob.mSize))
+		{
+			return -1;
+		}
+		S32 vertices = 0;
+		for (S32 i = 0; i < volume->getNumVolumeFaces(); ++i)
+		{
+			vertices += volume->getVolumeFace(i).mNumVertices;
+		}
+		return vertices;
+	}
+
+	// Wait and decode times of a pass, in microseconds.
+	struct PassStats
+	{
+		PassStats() : mWaitTime(0), mDecodeTime(0), mOnFeeder(0) { }
+
+		LLMutex mMutex;
+		U64 mWaitTime;
+		U64 mDecodeTime;
+		S32 mOnFeeder;
+		LLAtomicS32 mDone;
+	};
+
+	void decode(const std::vector<SourceFile>& files, const Blob& blob, U8* data, S32& result,
+				PassStats& stats, U64 queued_time)
+	{
+		U64 start = totalTime();
+		result = decode_blob(files[blob.mFile].mID, blob, data);
+		U64 end = totalTime();
+
+		LLMutexLock lock(&stats.mMutex);
+		stats.mWaitTime += start - queued_time;
+		stats.mDecodeTime += end - start;
+	}
+
+	// Like LLMeshDecodeTask: owns a copy of the blob.
+	class DecodeTask : public LLWorkerPool::Task
+	{
+	public:
+		DecodeTask(LLWorkerPool::Subsystem* subsystem, const std::vector<SourceFile>& files, const Blob& blob,
+				   U8* data, S32& result, PassStats& stats)
+		:	LLWorkerPool::Task(subsystem), mFiles(files), mBlob(blob), mData(data), mResult(result),
+			mStats(stats), mQueuedTime(totalTime())
+		{
+		}
+		/*virtual*/ ~DecodeTask()
+		{
+			delete [] mData;
+		}
+
+		void detachData()			{ mData = NULL; }
+
+		/*virtual*/ bool run()
+		{
+			decode(mFiles, mBlob, mData, mResult, mStats, mQueuedTime);
+			mStats.mDone++;
+			return false;
+		}
+
+	private:
+		const std::vector<SourceFile>& mFiles;
+		const Blob& mBlob;
+		U8* mData;
+		S32& mResult;
+		PassStats& mStats;
+		U64 mQueuedTime;
+	};
+
+	// Decodes all blobs passes times; threads == 0 means without the pool.
+	// Returns false if the vertices differ from expected (filled if empty).
+	bool run_pass(const std::vector<SourceFile>& files, const std::vector<Blob>& blobs, S32 threads, S32 passes,
+				  std::vector<S32>& expected)
+	{
+		LLWorkerPool::initClass(threads);
+		LLWorkerPool* pool = LLWorkerPool::getInstance();
+		LLWorkerPool::Subsystem* subsystem = NULL;
+		if (pool)
+		{
+			// As registered by the viewer.
+			subsystem = pool->addSubsystem("meshdecode", LLWorkerPool::PRIORITY_CLASS_NORMAL, pool->getThreadCount());
+		}
+
+		std::vector<S32> results(blobs.size());
+		PassStats stats;
+		stats.mDone = 0;
+		S32 total = 0;
+		U64 bytes = 0;
+		bool ok = true;
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (size_t i = 0; i < blobs.size(); ++i)
+			{
+				const Blob& blob = blobs[i];
+				U8* data = new U8[blob.mSize];
+				memcpy(data, &files[blob.mFile].mData[blob.mOffset], blob.mSize);
+				bytes += blob.mSize;
+				++total;
+
+				if (subsystem)
+				{
+					DecodeTask* task = new DecodeTask(subsystem, files, blob, data, results[i], stats);
+					if (pool->submit(task))
+					{
+						continue;
+					}
+					task->detachData();
+					delete task;
+					stats.mOnFeeder++;
+				}
+				decode(files, blob, data, results[i], stats, totalTime());
+				delete [] data;
+				stats.mDone++;
+			}
+			while (stats.mDone < total)
+			{
+				ms_sleep(1);
+			}
+
+			if (expected.empty())
+			{
+				expected = results;
+			}
+			ok = ok && results == expected;
+		}
+		F32 elapsed = llmax(timer.getElapsedTimeF32(), 0.001f);
+		LLWorkerPool::cleanupClass();
+
+		S32 failed = 0;
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			failed += results[i] < 0;
+		}
+		std::cout << (threads ? llformat("pool %2d threads", threads) : std::string("feeding thread "))
+				  << llformat(": %8.1f blobs/s %7.2f MB/s, %6.3f/%6.3f ms wait/decode, %d on feeder, %d failed %s",
+							  total / elapsed, bytes / elapsed / (1024.f * 1024.f),
+							  stats.mWaitTime / (1000.f * total), stats.mDecodeTime / (1000.f * total),
+							  stats.mOnFeeder, failed, ok ? "ok" : "MISMATCH")
+				  << std::endl;
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <directory with .mesh files> [max threads] [passes]" << std::endl;
+		return 1;
+	}
+	std::string dirname = argv[1];
+	S32 max_threads = argc > 2 ? atoi(argv[2]) : LLWorkerPool::getDefaultThreadCount() + 1;
+	S32 passes = argc > 3 ? llmax(atoi(argv[3]), 1) : 1;
+
+	std::vector<SourceFile> files;
+	std::vector<Blob> blobs;
+	if (load_files(dirname, files))
+	{
+		split_files(files, blobs);
+	}
+	if (blobs.empty())
+	{
+		std::cerr << "No .mesh files found in " << dirname << std::endl;
+		return 1;
+	}
+	std::cout << "Decoding " << blobs.size() << " blobs of " << files.size() << " meshes, " << passes << " passes" << std::endl;
+
+	std::vector<S32> expected;
+	bool ok = run_pass(files, blobs, 0, passes, expected);
+	S32 threads = 1;
+	for ( ; threads < max_threads; threads *= 2)
+	{
+		ok = run_pass(files, blobs, threads, passes, expected) && ok;
+	}
+	ok = run_pass(files, blobs, max_threads, passes, expected) && ok;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,346 @@
+/**
+ * @file llmeshheaderbench.cpp
+ * @brief Memory and lookup cost of mesh headers kept as LLSD and as LLMeshHeader
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Usage: llmeshheaderbench [headers] [lookups]
+//
+// Keeps <headers> (default 50000) synthetic mesh headers, laid out as the
+// uploader writes them and the asset server stamps them (creator, date,
+// version and the offset and size of every blob), the way LLMeshRepoThread
+// used to: the compactly parsed LLSD in a std::map with a second map of
+// header sizes, and the way it does now: an LLMeshHeader per mesh in an
+// LLOpenHashMap. For both it reports the time to parse and store them all,
+// the heap bytes and blocks they hold on to and the time per lookup of
+// <lookups> (default 1000000) random ones as the main thread does them for
+// LLMeshRepository::getActualMeshLOD() and getStreamingCost().
+//
+// Heap use is measured by replacing operator new, which only sees the
+// allocations of the shared llcommon library on platforms that resolve it
+// globally (not on Windows).
+
+#include "linden_common.h"
+
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <sstream>
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llmeshcache.h"
+#include "llopenhashmap.h"
+#include "llrand.h"
+#include "llsd.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
+
+namespace
+{
+	S64 sLiveBlocks = 0;
+	S64 sLiveBytes = 0;
+
+	// Every block starts with its size, padded to keep the alignment of malloc().
+	const size_t BLOCK_HEADER = 16;
+
+	void* counted_alloc(size_t size)
+	{
+		char* block = (char*)malloc(size + BLOCK_HEADER);
+		if (!block)
+		{
+			throw std::bad_alloc();
+		}
+		++sLiveBlocks;
+		sLiveBytes += size;
+		*(size_t*)block = size;
+		return block + BLOCK_HEADER;
+	}
+
+	void counted_free(void* ptr)
+	{
+		if (ptr)
+		{
+			char* block = (char*)ptr - BLOCK_HEADER;
+			--sLiveBlocks;
+			sLiveBytes -= *(size_t*)block;
+			free(block);
+		}
+	}
+}
+
+#if __cplusplus >= 201103L
+# define BENCH_THROW_BAD_ALLOC
+#else
+# define BENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#endif
+
+void* operator new(size_t size) BENCH_THROW_BAD_ALLOC
+{
+	return counted_alloc(size);
+}
+
+void* operator new[](size_t size) BENCH_THROW_BAD_ALLOC
+{
+	return counted_alloc(size);
+}
+
+void operator delete(void* ptr) throw()
+{
+	counted_free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+	counted_free(ptr);
+}
+
+namespace
+{
+	// The LLMeshHeader of newview.
+	struct MeshHeader : public LLMeshCache::Header
+	{
+		MeshHeader() : m404(false) { }
+
+		bool m404;
+	};
+
+	const S32 MAX_MESH_VERSION = 999;
+
+	const char* const LOD_NAMES[] = { "lowest_lod", "low_lod", "medium_lod", "high_lod" };
+
+	std::vector<U8> make_asset_header(const LLUUID& creator, S32 seed)
+	{
+		LLSD header;
+		header["creator"] = creator;
+		header["date"] = LLDate(1.3e9 + seed);
+		header["version"] = 1;
+		S32 offset = 0;
+		for (S32 i = 0; i < LLMeshCache::BLOB_COUNT; ++i)
+		{
+			// A third is rigged, most have a physics shape, few their own physics mesh.
+			if ((i == LLMeshCache::BLOB_SKIN && seed % 3) ||
+				(i == LLMeshCache::BLOB_PHYSICS_CONVEX && seed % 5 == 0) ||
+				(i == LLMeshCache::BLOB_PHYSICS_MESH && seed % 4))
+			{
+				continue;
+			}
+			S32 size = 200 + ll_rand(i < LLMeshCache::BLOB_SKIN ? 40000 << i : 20000);
+			const char* name = LLMeshCache::getBlobName((LLMeshCache::EBlob)i);
+			header[name]["offset"] = offset;
+			header[name]["size"] = size;
+			offset += size;
+		}
+
+		std::ostringstream str;
+		LLSDSerialize::toBinary(header, str);
+		const std::string& bytes = str.str();
+		return std::vector<U8>(bytes.begin(), bytes.end());
+	}
+
+	// What LLMeshRepoThread::headerReceived() does with it.
+	bool parse_header(const std::vector<U8>& data, LLSD& header, U32& header_size)
+	{
+		LLPointer<LLSDBinaryParser> parser = new LLSDBinaryParser;
+		parser->setCompact(true);
+		S32 bytes_read = 0;
+		if (parser->parse(&data[0], (S32)data.size(), header, &bytes_read) <= 0)
+		{
+			return false;
+		}
+		header_size = bytes_read;
+		return true;
+	}
+
+	// LLMeshRepository::getActualMeshLOD() and the sizes getStreamingCost() reads, before ...
+	S32 lookup_llsd(LLSD& header, S32 lod)
+	{
+		S32 version = header["version"];
+		if (header.has("404") || version > MAX_MESH_VERSION)
+		{
+			return -1;
+		}
+		S32 bytes = 0;
+		for (S32 i = 0; i < 4; ++i)
+		{
+			bytes += header[LOD_NAMES[i]]["size"].asInteger();
+		}
+		for (S32 i = lod; i >= 0; --i)
+		{
+			if (header[LOD_NAMES[i]]["size"].asInteger() > 0)
+			{
+				return bytes + i;
+			}
+		}
+		return bytes;
+	}
+
+	// ... and after.
+	S32 lookup_struct(MeshHeader& header, S32 lod)
+	{
+		if (header.m404 || header.mVersion > MAX_MESH_VERSION)
+		{
+			return -1;
+		}
+		S32 bytes = 0;
+		for (S32 i = 0; i < 4; ++i)
+		{
+			bytes += header.mSize[i];
+		}
+		for (S32 i = lod; i >= 0; --i)
+		{
+			if (header.mSize[i] > 0)
+			{
+				return bytes + i;
+			}
+		}
+		return bytes;
+	}
+
+	struct Result
+	{
+		Result() : mStoreTime(0.f), mLookupTime(0.f), mBytes(0), mBlocks(0), mChecksum(0) { }
+
+		F32 mStoreTime;
+		F32 mLookupTime;
+		S64 mBytes;
+		S64 mBlocks;
+		U32 mChecksum;
+	};
+
+	void report(const char* name, S32 headers, S32 lookups, const Result& result)
+	{
+		std::cout << llformat("%-8s store %7.3f us/header, %9.1f bytes/header in %5.2f blocks, lookup %7.1f ns",
+							  name, result.mStoreTime * 1.e6f / headers, (F32)result.mBytes / headers,
+							  (F32)result.mBlocks / headers, result.mLookupTime * 1.e9f / lookups)
+				  << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 count = argc > 1 ? llmax(atoi(argv[1]), 1) : 50000;
+	S32 lookups = argc > 2 ? llmax(atoi(argv[2]), 1) : 1000000;
+
+	LLUUID creator;
+	creator.generate();
+	std::vector<LLUUID> ids(count);
+	std::vector<std::vector<U8> > assets(count);
+	for (S32 i = 0; i < count; ++i)
+	{
+		ids[i].generate();
+		assets[i] = make_asset_header(creator, i);
+	}
+	std::vector<S32> order(lookups);
+	for (S32 i = 0; i < lookups; ++i)
+	{
+		order[i] = ll_rand(count);
+	}
+	std::cout << count << " mesh headers, " << lookups << " lookups" << std::endl;
+
+	Result llsd_result;
+	{
+		S64 bytes = sLiveBytes;
+		S64 blocks = sLiveBlocks;
+		LLTimer timer;
+		std::map<LLUUID, LLSD> headers;
+		std::map<LLUUID, U32> header_sizes;
+		for (S32 i = 0; i < count; ++i)
+		{
+			LLSD header;
+			U32 header_size;
+			if (parse_header(assets[i], header, header_size))
+			{
+				header_sizes[ids[i]] = header_size;
+				headers[ids[i]] = header;
+			}
+		}
+		llsd_result.mStoreTime = timer.getElapsedTimeF32();
+		llsd_result.mBytes = sLiveBytes - bytes;
+		llsd_result.mBlocks = sLiveBlocks - blocks;
+
+		timer.reset();
+		for (S32 i = 0; i < lookups; ++i)
+		{
+			std::map<LLUUID, LLSD>::iterator iter = headers.find(ids[order[i]]);
+			if (iter != headers.end())
+			{
+				llsd_result.mChecksum = llsd_result.mChecksum * 31 + lookup_llsd(iter->second, i & 3);
+			}
+		}
+		llsd_result.mLookupTime = timer.getElapsedTimeF32();
+	}
+
+	Result struct_result;
+	{
+		S64 bytes = sLiveBytes;
+		S64 blocks = sLiveBlocks;
+		LLTimer timer;
+		LLOpenHashMap<LLUUID, MeshHeader> headers;
+		for (S32 i = 0; i < count; ++i)
+		{
+			LLSD header;
+			U32 header_size;
+			if (parse_header(assets[i], header, header_size))
+			{
+				MeshHeader mesh_header;
+				mesh_header.fromLLSD(header, header_size);
+				mesh_header.m404 = header.has("404");
+				headers[ids[i]] = mesh_header;
+			}
+		}
+		struct_result.mStoreTime = timer.getElapsedTimeF32();
+		struct_result.mBytes = sLiveBytes - bytes;
+		struct_result.mBlocks = sLiveBlocks - blocks;
+
+		timer.reset();
+		for (S32 i = 0; i < lookups; ++i)
+		{
+			LLOpenHashMap<LLUUID, MeshHeader>::iterator iter = headers.find(ids[order[i]]);
+			if (iter != headers.end())
+			{
+				struct_result.mChecksum = struct_result.mChecksum * 31 + lookup_struct(iter->second, i & 3);
+			}
+		}
+		struct_result.mLookupTime = timer.getElapsedTimeF32();
+	}
+
+	report("LLSD", count, lookups, llsd_result);
+	report("struct", count, lookups, struct_result);
+
+	bool ok = llsd_result.mChecksum == struct_result.mChecksum;
+	std::cout << (ok ? "ok" : "MISMATCH between the LLSD and the struct lookups") << std::endl;
+	return ok ? 0 : 1;
+}
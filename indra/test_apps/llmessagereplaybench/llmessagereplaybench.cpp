@@ -0,0 +1,527 @@
+/**
+ * @file llmessagereplaybench.cpp
+ * @brief Replays captured UDP traffic through LLMessageSystem and measures the decoding
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Usage: llmessagereplaybench <message_template.msg> <capture file> [passes]
+//
+// Replays a capture file, written by the viewer with LogMessagesCapture set,
+// <passes> times through LLMessageSystem::checkMessages() as if the packets
+// came off the socket: ack stripping, zero code expansion, circuit lookup,
+// template decoding and the handler. The handlers of object updates, terse
+// updates, image packets and layer data read their messages the way the
+// viewer does; every other message goes to null_message_callback. Nothing
+// is sent, acks are collected but never flushed.
+//
+// Reports packets per second and per message the count, the time spent in
+// checkMessages() and the number of heap allocations. Allocations are counted
+// by replacing operator new, which only sees those of the shared llcommon
+// library on platforms that resolve it globally (not on Windows). Then the
+// packets per second without LLMessageSystem::setDecodeInPlace(), the
+// throughput of zero code expansion alone, byte by byte and with SSE2, and
+// the full object updates (ObjectUpdate and ObjectUpdateCompressed blocks)
+// per second that LLObjectUpdateDecoder decodes, on the calling thread and
+// on the worker pool. A capture of a dense region makes the last meaningful.
+
+#include "linden_common.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <set>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llmemory.h"
+#include "llstl.h"
+#include "lltimer.h"
+#include "message.h"
+#include "llmessagelog.h"
+#include "llmessagetemplate.h"
+#include "llmessagetemplateparser.h"
+#include "llobjectupdatedecoder.h"
+#include "llpacketring.h"
+#include "llworkerpool.h"
+#include "llzerocode.h"
+#include "lluuid.h"
+#include "v3math.h"
+
+namespace
+{
+	U64 sAllocations = 0;
+}
+
+#if __cplusplus >= 201103L
+# define BENCH_THROW_BAD_ALLOC
+#else
+# define BENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#endif
+
+void* operator new(size_t size) BENCH_THROW_BAD_ALLOC
+{
+	++sAllocations;
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void* operator new[](size_t size) BENCH_THROW_BAD_ALLOC
+{
+	++sAllocations;
+	void* ptr = malloc(size ? size : 1);
+	if (!ptr)
+	{
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void* ptr) throw()
+{
+	free(ptr);
+}
+
+void operator delete[](void* ptr) throw()
+{
+	free(ptr);
+}
+
+namespace
+{
+	// What the viewer does between two calls to LLMessageSystem::resetReceiveCounts().
+	const S32 PACKETS_PER_FRAME = 64;
+
+	struct MessageStats
+	{
+		MessageStats() : mCount(0), mBytes(0), mClocks(0), mAllocations(0) { }
+
+		U32 mCount;
+		U64 mBytes;
+		U64 mClocks;
+		U64 mAllocations;
+	};
+	typedef std::map<std::string, MessageStats> stats_map_t;
+
+	// Keeps the compiler from dropping what the handlers read.
+	U32 sChecksum = 0;
+	U8 sScratch[NET_BUFFER_SIZE];
+
+	// When set, the object update handlers also run the decoder of LLViewerObjectList.
+	LLObjectUpdateDecoder* sDecoder = NULL;
+	U64 sDecodedBlocks = 0;
+	U64 sDecodeClocks = 0;
+
+	void decode_object_update(LLMessageSystem* msg, bool compressed)
+	{
+		if (!sDecoder)
+		{
+			return;
+		}
+		U64 start = get_clock_count();
+		sDecoder->decode(msg, compressed);
+		sDecodeClocks += get_clock_count() - start;
+		sDecodedBlocks += sDecoder->getBlockCount();
+		for (S32 i = 0; i < sDecoder->getBlockCount(); ++i)
+		{
+			const LLDecodedObjectUpdate* block = sDecoder->getBlock(i);
+			sChecksum += block->mTEs.face_count + block->mVolumeOffset;
+		}
+	}
+
+	void read_variable(LLMessageSystem* msg, const char* block, const char* var, S32 blocknum)
+	{
+		S32 size = msg->getSizeFast(block, blocknum, var);
+		if (size > 0)
+		{
+			msg->getBinaryDataFast(block, var, sScratch, size, blocknum, sizeof(sScratch));
+			sChecksum += size + sScratch[0];
+		}
+	}
+
+	void read_region_data(LLMessageSystem* msg)
+	{
+		U64 region_handle;
+		U16 time_dilation;
+		msg->getU64Fast(_PREHASH_RegionData, _PREHASH_RegionHandle, region_handle);
+		msg->getU16Fast(_PREHASH_RegionData, _PREHASH_TimeDilation, time_dilation);
+		sChecksum += (U32)region_handle + time_dilation;
+	}
+
+	// LLViewerObjectList::processObjectUpdate() and LLVOVolume::processUpdateMessage().
+	void process_object_update(LLMessageSystem* msg, void**)
+	{
+		read_region_data(msg);
+		S32 count = msg->getNumberOfBlocksFast(_PREHASH_ObjectData);
+		for (S32 i = 0; i < count; ++i)
+		{
+			U32 local_id, crc, parent_id, flags;
+			LLUUID full_id;
+			U8 pcode, material;
+			LLVector3 scale;
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			msg->getUUIDFast(_PREHASH_ObjectData, _PREHASH_FullID, full_id, i);
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_CRC, crc, i);
+			msg->getU8Fast(_PREHASH_ObjectData, _PREHASH_PCode, pcode, i);
+			msg->getU8Fast(_PREHASH_ObjectData, _PREHASH_Material, material, i);
+			msg->getVector3Fast(_PREHASH_ObjectData, _PREHASH_Scale, scale, i);
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_ParentID, parent_id, i);
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_ObjectData, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_TextureEntry, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_NameValue, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_Data, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_Text, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_ExtraParams, i);
+			sChecksum += local_id + crc + parent_id + flags + pcode + material + full_id.mData[0] + (U32)scale.mV[VX];
+		}
+		decode_object_update(msg, false);
+	}
+
+	void process_terse_object_update(LLMessageSystem* msg, void**)
+	{
+		read_region_data(msg);
+		S32 count = msg->getNumberOfBlocksFast(_PREHASH_ObjectData);
+		for (S32 i = 0; i < count; ++i)
+		{
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_Data, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_TextureEntry, i);
+		}
+	}
+
+	void process_compressed_object_update(LLMessageSystem* msg, void**)
+	{
+		read_region_data(msg);
+		S32 count = msg->getNumberOfBlocksFast(_PREHASH_ObjectData);
+		for (S32 i = 0; i < count; ++i)
+		{
+			U32 flags;
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
+			read_variable(msg, _PREHASH_ObjectData, _PREHASH_Data, i);
+			sChecksum += flags;
+		}
+		decode_object_update(msg, true);
+	}
+
+	void process_cached_object_update(LLMessageSystem* msg, void**)
+	{
+		read_region_data(msg);
+		S32 count = msg->getNumberOfBlocksFast(_PREHASH_ObjectData);
+		for (S32 i = 0; i < count; ++i)
+		{
+			U32 local_id, crc, flags;
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_CRC, crc, i);
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_UpdateFlags, flags, i);
+			sChecksum += local_id + crc + flags;
+		}
+	}
+
+	void process_kill_object(LLMessageSystem* msg, void**)
+	{
+		S32 count = msg->getNumberOfBlocksFast(_PREHASH_ObjectData);
+		for (S32 i = 0; i < count; ++i)
+		{
+			U32 local_id;
+			msg->getU32Fast(_PREHASH_ObjectData, _PREHASH_ID, local_id, i);
+			sChecksum += local_id;
+		}
+	}
+
+	// LLViewerTextureList::receiveImageHeader() and receiveImagePacket().
+	void process_image_data(LLMessageSystem* msg, void**)
+	{
+		LLUUID id;
+		U8 codec;
+		U32 size;
+		U16 packets;
+		msg->getUUIDFast(_PREHASH_ImageID, _PREHASH_ID, id);
+		msg->getU8Fast(_PREHASH_ImageID, _PREHASH_Codec, codec);
+		msg->getU32Fast(_PREHASH_ImageID, _PREHASH_Size, size);
+		msg->getU16Fast(_PREHASH_ImageID, _PREHASH_Packets, packets);
+		read_variable(msg, _PREHASH_ImageData, _PREHASH_Data, 0);
+		sChecksum += id.mData[0] + codec + size + packets;
+	}
+
+	void process_image_packet(LLMessageSystem* msg, void**)
+	{
+		LLUUID id;
+		U16 packet;
+		msg->getUUIDFast(_PREHASH_ImageID, _PREHASH_ID, id);
+		msg->getU16Fast(_PREHASH_ImageID, _PREHASH_Packet, packet);
+		read_variable(msg, _PREHASH_ImageData, _PREHASH_Data, 0);
+		sChecksum += id.mData[0] + packet;
+	}
+
+	// process_layer_data() without the patch decompression.
+	void process_layer_data(LLMessageSystem* msg, void**)
+	{
+		U8 type;
+		msg->getU8Fast(_PREHASH_LayerID, _PREHASH_Type, type);
+		read_variable(msg, _PREHASH_LayerData, _PREHASH_Data, 0);
+		sChecksum += type;
+	}
+
+	// Every message of the template needs a handler, or the reader warns about each one.
+	bool register_handlers(const std::string& template_name)
+	{
+		std::string template_body;
+		if (!_read_file_into_string(template_body, template_name))
+		{
+			return false;
+		}
+		LLTemplateTokenizer tokens(template_body);
+		LLTemplateParser parsed(tokens);
+		for (LLTemplateParser::message_iterator iter = parsed.getMessagesBegin(); iter != parsed.getMessagesEnd(); ++iter)
+		{
+			gMessageSystem->setHandlerFuncFast((*iter)->mName, null_message_callback);
+			delete *iter;
+		}
+
+		gMessageSystem->setHandlerFuncFast(_PREHASH_ObjectUpdate, process_object_update);
+		gMessageSystem->setHandlerFuncFast(_PREHASH_ImprovedTerseObjectUpdate, process_terse_object_update);
+		gMessageSystem->setHandlerFuncFast(_PREHASH_ObjectUpdateCompressed, process_compressed_object_update);
+		gMessageSystem->setHandlerFuncFast(_PREHASH_ObjectUpdateCached, process_cached_object_update);
+		gMessageSystem->setHandlerFuncFast(_PREHASH_KillObject, process_kill_object);
+		gMessageSystem->setHandlerFuncFast(_PREHASH_ImageData, process_image_data);
+		gMessageSystem->setHandlerFuncFast(_PREHASH_ImagePacket, process_image_packet);
+		gMessageSystem->setHandlerFuncFast(_PREHASH_LayerData, process_layer_data);
+		return true;
+	}
+
+	// Fresh trusted circuits to every sender, so that each pass sees the same packet ids.
+	void reset_circuits(const std::deque<LLMessageLogEntry>& packets)
+	{
+		std::set<LLHost> hosts;
+		for (std::deque<LLMessageLogEntry>::const_iterator iter = packets.begin(); iter != packets.end(); ++iter)
+		{
+			hosts.insert(iter->mFromHost);
+		}
+		for (std::set<LLHost>::iterator iter = hosts.begin(); iter != hosts.end(); ++iter)
+		{
+			if (gMessageSystem->mCircuitInfo.findCircuit(*iter))
+			{
+				gMessageSystem->mCircuitInfo.removeCircuitData(*iter);
+			}
+			gMessageSystem->enableCircuit(*iter, TRUE);
+		}
+	}
+
+	// Returns the number of packets that decoded.
+	U32 run_pass(const std::deque<LLMessageLogEntry>& packets, stats_map_t& stats)
+	{
+		reset_circuits(packets);
+		U32 valid = 0;
+		S32 frame_packets = 0;
+		for (std::deque<LLMessageLogEntry>::const_iterator iter = packets.begin(); iter != packets.end(); ++iter)
+		{
+			if (++frame_packets == PACKETS_PER_FRAME)
+			{
+				gMessageSystem->resetReceiveCounts();
+				frame_packets = 0;
+			}
+			gMessageSystem->mPacketRing->injectPacket(iter->mFromHost, (const char*)&iter->mData[0], iter->mDataSize);
+			U64 allocations = sAllocations;
+			U64 start = get_clock_count();
+			BOOL decoded = gMessageSystem->checkMessages();
+			U64 clocks = get_clock_count() - start;
+			allocations = sAllocations - allocations;
+
+			MessageStats& message = stats[decoded ? std::string(gMessageSystem->getMessageName()) : std::string("(invalid)")];
+			message.mCount++;
+			message.mBytes += iter->mDataSize;
+			message.mClocks += clocks;
+			message.mAllocations += allocations;
+			if (decoded)
+			{
+				++valid;
+			}
+		}
+		return valid;
+	}
+
+	// Returns the time in seconds of expanding every zero coded packet passes times.
+	F64 time_zero_code(const std::deque<LLMessageLogEntry>& packets, S32 passes, U64& bytes)
+	{
+		bytes = 0;
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (std::deque<LLMessageLogEntry>::const_iterator iter = packets.begin(); iter != packets.end(); ++iter)
+			{
+				if (iter->mDataSize > LL_PACKET_ID_SIZE && (iter->mData[0] & LL_ZERO_CODE_FLAG))
+				{
+					S32 size = zero_code_expand(&iter->mData[LL_PACKET_ID_SIZE], iter->mDataSize - LL_PACKET_ID_SIZE,
+												sScratch, sizeof(sScratch));
+					sChecksum += size;
+					bytes += iter->mDataSize;
+				}
+			}
+		}
+		return timer.getElapsedTimeF64();
+	}
+
+	// Returns the object updates decoded per second.
+	F64 time_object_decode(const std::deque<LLMessageLogEntry>& packets, S32 passes, bool use_pool)
+	{
+		LLObjectUpdateDecoder decoder;
+		decoder.setUseWorkerPool(use_pool);
+		sDecoder = &decoder;
+		sDecodedBlocks = 0;
+		sDecodeClocks = 0;
+		stats_map_t stats;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			run_pass(packets, stats);
+		}
+		sDecoder = NULL;
+		return sDecodedBlocks * calc_clock_frequency() / llmax((F64)sDecodeClocks, 1.0);
+	}
+
+	bool by_clocks(const stats_map_t::value_type* a, const stats_map_t::value_type* b)
+	{
+		return a->second.mClocks > b->second.mClocks;
+	}
+
+	void report(const stats_map_t& stats, U32 total, F64 seconds)
+	{
+		F64 us_per_clock = 1000000.0 / calc_clock_frequency();
+		std::vector<const stats_map_t::value_type*> sorted;
+		for (stats_map_t::const_iterator iter = stats.begin(); iter != stats.end(); ++iter)
+		{
+			sorted.push_back(&*iter);
+		}
+		std::sort(sorted.begin(), sorted.end(), by_clocks);
+
+		std::cout << llformat("%-32s %9s %9s %10s %9s %10s", "message", "count", "avg bytes", "total ms", "us/msg", "allocs/msg") << std::endl;
+		for (std::vector<const stats_map_t::value_type*>::iterator iter = sorted.begin(); iter != sorted.end(); ++iter)
+		{
+			const MessageStats& message = (*iter)->second;
+			std::cout << llformat("%-32s %9u %9.1f %10.2f %9.3f %10.2f", (*iter)->first.c_str(), message.mCount,
+								  (F64)message.mBytes / message.mCount, message.mClocks * us_per_clock / 1000.0,
+								  message.mClocks * us_per_clock / message.mCount, (F64)message.mAllocations / message.mCount)
+					  << std::endl;
+		}
+		std::cout << llformat("%u packets in %.3f s: %.0f packets/s", total, seconds, total / llmax(seconds, 0.000001)) << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc < 3)
+	{
+		std::cerr << "usage: " << argv[0] << " <message_template.msg> <capture file> [passes]" << std::endl;
+		return 1;
+	}
+	std::string template_name = argv[1];
+	S32 passes = argc > 3 ? llmax(atoi(argv[3]), 1) : 1;
+
+	LLPrivateMemoryPoolManager::initClass(FALSE, 0);
+
+	std::deque<LLMessageLogEntry> packets;
+	if (!LLMessageLog::loadCapture(argv[2], packets) || packets.empty())
+	{
+		std::cerr << "No packets in " << argv[2] << std::endl;
+		return 1;
+	}
+
+	if (!start_messaging_system(template_name, NET_USE_OS_ASSIGNED_PORT, 1, 0, 0, false, std::string(), NULL, false, 5.f, 100.f) ||
+		!register_handlers(template_name))
+	{
+		std::cerr << "Can't start the message system with " << template_name << std::endl;
+		return 1;
+	}
+
+	// Once to warm up: the string table, the circuits and the reader's buffers.
+	stats_map_t stats;
+	U32 valid = run_pass(packets, stats);
+	std::cout << "Replaying " << packets.size() << " packets (" << valid << " valid), " << passes << " passes" << std::endl;
+
+	stats.clear();
+	LLTimer timer;
+	for (S32 pass = 0; pass < passes; ++pass)
+	{
+		run_pass(packets, stats);
+	}
+	F64 seconds = timer.getElapsedTimeF64();
+	report(stats, packets.size() * passes, seconds);
+
+	// The same without expanding zero coded packets straight into the reader.
+	gMessageSystem->setDecodeInPlace(false);
+	timer.reset();
+	for (S32 pass = 0; pass < passes; ++pass)
+	{
+		run_pass(packets, stats);
+	}
+	seconds = timer.getElapsedTimeF64();
+	gMessageSystem->setDecodeInPlace(true);
+	std::cout << llformat("Without decoding in place: %.0f packets/s", packets.size() * passes / llmax(seconds, 0.000001)) << std::endl;
+
+	// Zero code expansion by itself, the byte loop against SSE2.
+	for (S32 vectorized = 0; vectorized < 2; ++vectorized)
+	{
+		zero_code_set_vectorized(vectorized != 0);
+		if (vectorized && !zero_code_is_vectorized())
+		{
+			break;
+		}
+		U64 bytes;
+		seconds = time_zero_code(packets, passes, bytes);
+		std::cout << llformat("Zero code expansion (%s): %.1f MB/s", vectorized ? "SSE2" : "bytes",
+							  bytes / llmax(seconds, 0.000001) / 1000000.0) << std::endl;
+	}
+
+	// Object update decoding, alone and with the workers helping.
+	LLWorkerPool::initClass(LLWorkerPool::getDefaultThreadCount());
+	LLWorkerPool* pool = LLWorkerPool::getInstance();
+	if (pool)
+	{
+		pool->addSubsystem("objectupdate", LLWorkerPool::PRIORITY_CLASS_HIGH, pool->getThreadCount());
+	}
+	std::cout << llformat("Object update decoding (main thread): %.0f updates/s", time_object_decode(packets, passes, false)) << std::endl;
+	if (pool)
+	{
+		std::cout << llformat("Object update decoding (%d workers): %.0f updates/s", pool->getThreadCount(),
+							  time_object_decode(packets, passes, true)) << std::endl;
+	}
+	LLWorkerPool::cleanupClass();
+	std::cout << "checksum " << sChecksum << std::endl;
+
+	end_messaging_system(false);
+	LLPrivateMemoryPoolManager::destroyClass();
+	return 0;
+}
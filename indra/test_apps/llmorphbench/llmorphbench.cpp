@@ -0,0 +1,426 @@
+/**
+ * @file llmorphbench.cpp
+ * @brief Applying a full appearance to the default avatar body, morph by morph versus LLMorphEngine
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Usage: llmorphbench <character directory> [max threads] [passes]
+//
+// Loads the meshes of the default avatar body and their morph targets from
+// the .llm files in the character directory (indra/newview/character) and
+// applies <passes> full appearances to them, every morph with a new weight,
+// switching between two made up appearances: first one morph at a time, as
+// LLPolyMorphTarget::apply() did, then with an LLMorphEngine per mesh on the
+// calling thread, then with a worker pool of 1, 2, 4 ... max threads, as
+// LLVOAvatar::applyMorphs() does. Reports appearances per second and checks
+// that every way leaves the meshes the same, to the bit.
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llfile.h"
+#include "llmath.h"
+#include "llmemory.h"
+#include "llmorphengine.h"
+#include "lltimer.h"
+#include "llworkerpool.h"
+
+namespace
+{
+	// The meshes that have morph targets, without their LODs.
+	const char* MESH_NAMES[] =
+	{
+		"avatar_head.llm", "avatar_upper_body.llm", "avatar_lower_body.llm", "avatar_eye.llm",
+		"avatar_eyelashes.llm", "avatar_hair.llm", "avatar_skirt.llm"
+	};
+	const S32 MESH_COUNT = LL_ARRAY_SIZE(MESH_NAMES);
+
+	struct Morph
+	{
+		std::vector<U32> mVertexIndices;
+		LLVector4a* mCoords;
+		LLVector4a* mNormals;
+		LLVector4a* mBinormals;
+		std::vector<LLVector2> mTexCoords;
+
+		LLMorphEngine::Morph getMorph() const
+		{
+			LLMorphEngine::Morph morph;
+			morph.mVertexIndices = &mVertexIndices[0];
+			morph.mCoords = mCoords;
+			morph.mNormals = mNormals;
+			morph.mBinormals = mBinormals;
+			morph.mTexCoords = &mTexCoords[0];
+			morph.mNumIndices = (U32)mVertexIndices.size();
+			return morph;
+		}
+	};
+
+	struct Mesh
+	{
+		std::string mName;
+		U32 mNumVertices;
+		LLVector4a* mBaseCoords;
+		LLVector4a* mBaseNormals;
+		std::vector<LLVector2> mBaseTexCoords;
+		std::vector<Morph> mMorphs;
+
+		// What the morphs move, as in LLPolyMesh.
+		LLVector4a* mData;
+		LLMorphEngine::Mesh mArrays;
+	};
+
+	LLVector4a* allocate_vectors(S32 count)
+	{
+		return (LLVector4a*)ll_aligned_malloc_16(llmax(count, 1) * sizeof(LLVector4a));
+	}
+
+	// Reads count vectors of 3 floats. The files are little endian, as the
+	// machines the viewer runs on.
+	bool read_vector3s(LLFILE* fp, LLVector4a* dst, U32 count)
+	{
+		for (U32 i = 0; i < count; ++i)
+		{
+			F32 v[3];
+			if (fread(v, sizeof(F32), 3, fp) != 3)
+			{
+				return false;
+			}
+			dst[i].set(v[0], v[1], v[2], 0.f);
+		}
+		return true;
+	}
+
+	bool read_morph(LLFILE* fp, Morph& morph)
+	{
+		S32 count;
+		if (fread(&count, sizeof(S32), 1, fp) != 1 || count < 0 || count > 65536)
+		{
+			return false;
+		}
+		morph.mVertexIndices.resize(count);
+		morph.mTexCoords.resize(count);
+		morph.mCoords = allocate_vectors(count);
+		morph.mNormals = allocate_vectors(count);
+		morph.mBinormals = allocate_vectors(count);
+		for (S32 i = 0; i < count; ++i)
+		{
+			if (fread(&morph.mVertexIndices[i], sizeof(U32), 1, fp) != 1 ||
+				!read_vector3s(fp, &morph.mCoords[i], 1) ||
+				!read_vector3s(fp, &morph.mNormals[i], 1) ||
+				!read_vector3s(fp, &morph.mBinormals[i], 1) ||
+				fread(morph.mTexCoords[i].mV, sizeof(F32), 2, fp) != 2)
+			{
+				return false;
+			}
+		}
+		return count > 0;
+	}
+
+	// What LLPolyMeshSharedData::loadMesh() reads of a mesh that isn't a LOD.
+	bool load_mesh(const std::string& filename, Mesh& mesh)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (!fp)
+		{
+			llwarns << "Can't open " << filename << llendl;
+			return false;
+		}
+		bool ok = false;
+		U8 has_weights = 0;
+		U8 has_detail_tex_coords = 0;
+		U16 num_vertices = 0;
+		// Header, then position, rotation angles, rotation order and scale.
+		if (fseek(fp, 24, SEEK_SET) == 0 &&
+			fread(&has_weights, 1, 1, fp) == 1 &&
+			fread(&has_detail_tex_coords, 1, 1, fp) == 1 &&
+			fseek(fp, 12 + 12 + 1 + 12, SEEK_CUR) == 0 &&
+			fread(&num_vertices, sizeof(U16), 1, fp) == 1)
+		{
+			mesh.mNumVertices = num_vertices;
+			mesh.mBaseCoords = allocate_vectors(num_vertices);
+			mesh.mBaseNormals = allocate_vectors(num_vertices);
+			mesh.mBaseTexCoords.resize(num_vertices);
+			LLVector4a* binormals = allocate_vectors(num_vertices);
+			ok = read_vector3s(fp, mesh.mBaseCoords, num_vertices) &&
+				 read_vector3s(fp, mesh.mBaseNormals, num_vertices) &&
+				 read_vector3s(fp, binormals, num_vertices) &&
+				 fread(&mesh.mBaseTexCoords[0], sizeof(F32) * 2, num_vertices, fp) == num_vertices;
+			ll_aligned_free_16(binormals);
+
+			// Detail texture coordinates, weights, faces and joint names.
+			U16 num_faces = 0;
+			U16 num_joints = 0;
+			ok = ok &&
+				 fseek(fp, (has_detail_tex_coords ? 8 : 0) * num_vertices + (has_weights ? 4 : 0) * num_vertices, SEEK_CUR) == 0 &&
+				 fread(&num_faces, sizeof(U16), 1, fp) == 1 &&
+				 fseek(fp, 6 * num_faces, SEEK_CUR) == 0 &&
+				 (!has_weights || fread(&num_joints, sizeof(U16), 1, fp) == 1) &&
+				 fseek(fp, 64 * num_joints, SEEK_CUR) == 0;
+
+			char name[65];
+			name[64] = '\0';
+			while (ok && fread(name, 1, 64, fp) == 64 && strcmp(name, "End Morphs"))
+			{
+				mesh.mMorphs.push_back(Morph());
+				ok = read_morph(fp, mesh.mMorphs.back());
+			}
+		}
+		LLFile::close(fp);
+		if (!ok)
+		{
+			llwarns << "Can't read " << filename << llendl;
+		}
+		return ok;
+	}
+
+	// As LLPolyMesh::initializeForMorph(), which starts the binormals from the normals too.
+	void reset_mesh(Mesh& mesh)
+	{
+		U32 count = mesh.mNumVertices;
+		LLVector4a::memcpyNonAliased16((F32*)mesh.mArrays.mCoords, (F32*)mesh.mBaseCoords, sizeof(LLVector4a) * count);
+		LLVector4a::memcpyNonAliased16((F32*)mesh.mArrays.mNormals, (F32*)mesh.mBaseNormals, sizeof(LLVector4a) * count);
+		LLVector4a::memcpyNonAliased16((F32*)mesh.mArrays.mScaledNormals, (F32*)mesh.mBaseNormals, sizeof(LLVector4a) * count);
+		LLVector4a::memcpyNonAliased16((F32*)mesh.mArrays.mBinormals, (F32*)mesh.mBaseNormals, sizeof(LLVector4a) * count);
+		LLVector4a::memcpyNonAliased16((F32*)mesh.mArrays.mScaledBinormals, (F32*)mesh.mBaseNormals, sizeof(LLVector4a) * count);
+		memcpy(mesh.mArrays.mTexCoords, &mesh.mBaseTexCoords[0], sizeof(LLVector2) * count);
+		for (U32 i = 0; i < count; ++i)
+		{
+			mesh.mArrays.mClothingWeights[i].clear();
+		}
+	}
+
+	void init_mesh(Mesh& mesh)
+	{
+		U32 count = mesh.mNumVertices;
+		// The texture coordinates take half a vector each.
+		mesh.mData = allocate_vectors(6 * count + (count + 1) / 2);
+		mesh.mArrays.mCoords = mesh.mData;
+		mesh.mArrays.mScaledNormals = mesh.mData + count;
+		mesh.mArrays.mNormals = mesh.mData + 2 * count;
+		mesh.mArrays.mScaledBinormals = mesh.mData + 3 * count;
+		mesh.mArrays.mBinormals = mesh.mData + 4 * count;
+		mesh.mArrays.mClothingWeights = mesh.mData + 5 * count;
+		mesh.mArrays.mTexCoords = (LLVector2*)(mesh.mData + 6 * count);
+		mesh.mArrays.mNumVertices = count;
+		reset_mesh(mesh);
+	}
+
+	void free_mesh(Mesh& mesh)
+	{
+		for (size_t i = 0; i < mesh.mMorphs.size(); ++i)
+		{
+			ll_aligned_free_16(mesh.mMorphs[i].mCoords);
+			ll_aligned_free_16(mesh.mMorphs[i].mNormals);
+			ll_aligned_free_16(mesh.mMorphs[i].mBinormals);
+		}
+		ll_aligned_free_16(mesh.mBaseCoords);
+		ll_aligned_free_16(mesh.mBaseNormals);
+		ll_aligned_free_16(mesh.mData);
+	}
+
+	// The weights of every morph of every mesh for two appearances; pass p
+	// changes from appearance (p + 1) % 2 to appearance p % 2, the first
+	// from the default body.
+	typedef std::vector<std::vector<F32> > appearance_t;
+
+	void make_appearance(const std::vector<Mesh>& meshes, U32 seed, appearance_t& appearance)
+	{
+		appearance.resize(meshes.size());
+		for (size_t m = 0; m < meshes.size(); ++m)
+		{
+			appearance[m].resize(meshes[m].mMorphs.size());
+			for (size_t i = 0; i < appearance[m].size(); ++i)
+			{
+				seed = seed * 1103515245 + 12345;
+				// Never 0, so that every morph changes.
+				appearance[m][i] = ((S32)((seed >> 8) & 0xffff) - 32768 + 0.5f) / 32768.f;
+			}
+		}
+	}
+
+	F32 delta_weight(const appearance_t* appearances, S32 pass, size_t m, size_t i)
+	{
+		F32 last = pass ? appearances[(pass + 1) % 2][m][i] : 0.f;
+		return appearances[pass % 2][m][i] - last;
+	}
+
+	void save_result(const std::vector<Mesh>& meshes, std::vector<U8>& result)
+	{
+		result.clear();
+		for (size_t m = 0; m < meshes.size(); ++m)
+		{
+			const U8* data = (const U8*)meshes[m].mData;
+			U32 count = meshes[m].mNumVertices;
+			result.insert(result.end(), data, data + (6 * count + (count + 1) / 2) * sizeof(LLVector4a));
+		}
+	}
+
+	void report(const std::string& name, F32 elapsed, S32 passes, S32 deltas, bool ok)
+	{
+		elapsed = llmax(elapsed, 0.000001f);
+		std::cout << llformat("%-24s: %8.1f appearances/s, %7.3f ms each, %6.1f Mdeltas/s %s", name.c_str(),
+							  passes / elapsed, elapsed * 1000.f / passes, deltas * (F32)passes / elapsed / 1.e6f,
+							  ok ? "ok" : "MISMATCH")
+				  << std::endl;
+	}
+
+	void run_reference(std::vector<Mesh>& meshes, const appearance_t* appearances, S32 passes, S32 deltas,
+					   std::vector<U8>& expected)
+	{
+		for (size_t m = 0; m < meshes.size(); ++m)
+		{
+			reset_mesh(meshes[m]);
+		}
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (size_t m = 0; m < meshes.size(); ++m)
+			{
+				Mesh& mesh = meshes[m];
+				for (size_t i = 0; i < mesh.mMorphs.size(); ++i)
+				{
+					LLMorphEngine::applyReference(mesh.mArrays, mesh.mMorphs[i].getMorph(),
+												  delta_weight(appearances, pass, m, i), NULL, false);
+				}
+			}
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		save_result(meshes, expected);
+		report("morph by morph", elapsed, passes, deltas, true);
+	}
+
+	// threads == 0 means on the calling thread.
+	bool run_engines(std::vector<Mesh>& meshes, const appearance_t* appearances, S32 passes, S32 deltas,
+					 S32 threads, const std::vector<U8>& expected)
+	{
+		LLWorkerPool::initClass(threads);
+		if (LLWorkerPool* pool = LLWorkerPool::getInstance())
+		{
+			// As registered by the viewer.
+			pool->addSubsystem("morph", LLWorkerPool::PRIORITY_CLASS_HIGH, pool->getThreadCount());
+		}
+
+		std::vector<LLMorphEngine*> engines;
+		for (size_t m = 0; m < meshes.size(); ++m)
+		{
+			reset_mesh(meshes[m]);
+			engines.push_back(new LLMorphEngine(meshes[m].mArrays));
+		}
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (size_t m = 0; m < meshes.size(); ++m)
+			{
+				Mesh& mesh = meshes[m];
+				for (size_t i = 0; i < mesh.mMorphs.size(); ++i)
+				{
+					engines[m]->add(mesh.mMorphs[i].getMorph(), delta_weight(appearances, pass, m, i), NULL, false);
+				}
+			}
+			LLMorphEngine::applyAll(&engines[0], (S32)engines.size());
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		LLWorkerPool::cleanupClass();
+		for (size_t m = 0; m < engines.size(); ++m)
+		{
+			delete engines[m];
+		}
+
+		std::vector<U8> result;
+		save_result(meshes, result);
+		bool ok = result == expected;
+		report(threads ? llformat("engines, pool %2d threads", threads) : std::string("engines, calling thread"),
+			   elapsed, passes, deltas, ok);
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <character directory> [max threads] [passes]" << std::endl;
+		return 1;
+	}
+	std::string dirname = argv[1];
+	S32 max_threads = argc > 2 ? atoi(argv[2]) : LLWorkerPool::getDefaultThreadCount() + 1;
+	S32 passes = argc > 3 ? llmax(atoi(argv[3]), 1) : 100;
+
+	std::vector<Mesh> meshes;
+	S32 morphs = 0;
+	S32 deltas = 0;
+	for (S32 m = 0; m < MESH_COUNT; ++m)
+	{
+		Mesh mesh;
+		mesh.mName = MESH_NAMES[m];
+		mesh.mData = NULL;
+		if (!load_mesh(dirname + "/" + mesh.mName, mesh))
+		{
+			return 1;
+		}
+		init_mesh(mesh);
+		meshes.push_back(mesh);
+		morphs += (S32)mesh.mMorphs.size();
+		for (size_t i = 0; i < mesh.mMorphs.size(); ++i)
+		{
+			deltas += (S32)mesh.mMorphs[i].mVertexIndices.size();
+		}
+	}
+	std::cout << "Applying " << morphs << " morphs (" << deltas << " vertex deltas) to " << meshes.size()
+			  << " meshes, " << passes << " passes" << std::endl;
+
+	appearance_t appearances[2];
+	make_appearance(meshes, 1, appearances[0]);
+	make_appearance(meshes, 2, appearances[1]);
+
+	std::vector<U8> expected;
+	run_reference(meshes, appearances, passes, deltas, expected);
+	bool ok = run_engines(meshes, appearances, passes, deltas, 0, expected);
+	S32 threads = 1;
+	for ( ; threads < max_threads; threads *= 2)
+	{
+		ok = run_engines(meshes, appearances, passes, deltas, threads, expected) && ok;
+	}
+	ok = run_engines(meshes, appearances, passes, deltas, max_threads, expected) && ok;
+
+	for (size_t m = 0; m < meshes.size(); ++m)
+	{
+		free_mesh(meshes[m]);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,316 @@
+/**
+ * @file llobjectcachebench.cpp
+ * @brief Measures region connect time with a warm object cache, old and new format
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Usage: llobjectcachebench [regions] [objects per region] [handshake ms]
+//
+// Writes the object cache of <regions> regions (default 8) of <objects>
+// cached objects each (default 15000) in a temporary directory, in the old
+// LLVOCacheEntry layout and in the LLObjectCacheFile one, and then times
+// what LLVOCache::readFromCache() costs the main thread per region connect,
+// with the files in the OS cache:
+//
+//   old:       one unbuffered read per field of every entry, as LLAPRFile does;
+//   new sync:  one read of the file, CRC check and a walk of the entries;
+//   new async: the read and check done on the worker pool between the region
+//              being created and its handshake, <handshake ms> later (default 50).
+
+#include "linden_common.h"
+
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llfile.h"
+#include "llobjectcachefile.h"
+#include "lltimer.h"
+#include "llworkerpool.h"
+
+namespace
+{
+	typedef std::map<U32, std::vector<U8> > entry_map_t;
+
+	std::string region_filename(S32 region, bool new_format)
+	{
+		return std::string(LLFile::tmpdir()) + llformat("llobjectcachebench_%d.%s", region, new_format ? "slc" : "old");
+	}
+
+	// Sizes like those of ObjectUpdateCompressed data.
+	void write_region(S32 region, S32 objects, const LLUUID& region_id)
+	{
+		U32 seed = region * 7919 + 1;
+		LLObjectCacheFile file;
+		file.clear(region_id);
+
+		LLFILE* fp = LLFile::fopen(region_filename(region, false), "wb");
+		fwrite(region_id.mData, 1, UUID_BYTES, fp);
+		fwrite(&objects, 1, sizeof(S32), fp);
+
+		std::vector<U8> data;
+		for (S32 i = 0; i < objects; ++i)
+		{
+			seed = seed * 1103515245 + 12345;
+			data.resize(80 + (seed >> 16) % 600);
+			for (size_t j = 0; j < data.size(); ++j)
+			{
+				data[j] = (U8)(seed + j * 31);
+			}
+			LLObjectCacheFile::Entry entry;
+			entry.mLocalID = i + 1;
+			entry.mCRC = seed;
+			entry.mHitCount = entry.mDupeCount = entry.mCRCChangeCount = 0;
+			entry.mSize = (S32)data.size();
+			entry.mData = &data[0];
+			file.addEntry(entry);
+
+			fwrite(&entry.mLocalID, 1, sizeof(U32), fp);
+			fwrite(&entry.mCRC, 1, sizeof(U32), fp);
+			fwrite(&entry.mHitCount, 1, sizeof(S32), fp);
+			fwrite(&entry.mDupeCount, 1, sizeof(S32), fp);
+			fwrite(&entry.mCRCChangeCount, 1, sizeof(S32), fp);
+			fwrite(&entry.mSize, 1, sizeof(S32), fp);
+			fwrite(&data[0], 1, data.size(), fp);
+		}
+		LLFile::close(fp);
+		file.write(region_filename(region, true));
+	}
+
+	// What LLVOCache::readFromCache() did with the old layout.
+	bool load_old(S32 region, const LLUUID& region_id, entry_map_t& entries)
+	{
+		LLFILE* fp = LLFile::fopen(region_filename(region, false), "rb");
+		if (!fp)
+		{
+			return false;
+		}
+		setvbuf(fp, NULL, _IONBF, 0);
+		LLUUID cache_id;
+		S32 count = 0;
+		bool success = fread(cache_id.mData, 1, UUID_BYTES, fp) == UUID_BYTES && cache_id == region_id &&
+					   fread(&count, 1, sizeof(S32), fp) == sizeof(S32);
+		for (S32 i = 0; success && i < count; ++i)
+		{
+			U32 fields[6];
+			for (S32 field = 0; success && field < 6; ++field)
+			{
+				success = fread(&fields[field], 1, sizeof(U32), fp) == sizeof(U32);
+			}
+			success = success && fields[5] > 0 && fields[5] <= LLObjectCacheFile::MAX_ENTRY_SIZE;
+			if (success)
+			{
+				std::vector<U8>& data = entries[fields[0]];
+				data.resize(fields[5]);
+				success = fread(&data[0], 1, data.size(), fp) == data.size();
+			}
+		}
+		LLFile::close(fp);
+		return success;
+	}
+
+	bool walk(const LLObjectCacheFile& file, const LLUUID& region_id, entry_map_t& entries)
+	{
+		if (file.getRegionID() != region_id)
+		{
+			return false;
+		}
+		S32 offset = 0;
+		LLObjectCacheFile::Entry entry;
+		while (file.nextEntry(offset, entry))
+		{
+			entries[entry.mLocalID].assign(entry.mData, entry.mData + entry.mSize);
+		}
+		return true;
+	}
+
+	// Like LLVOCacheLoad: the task and the main thread race for the read.
+	class RegionLoad
+	{
+	public:
+		RegionLoad(S32 region) : mRegion(region), mSuccess(false)
+		{
+			mClaims = 0;
+			mDone = 0;
+			mRefs = 1;
+		}
+
+		bool claim()		{ return mClaims++ == 0; }
+		void read()
+		{
+			mSuccess = mFile.read(region_filename(mRegion, true));
+			mDone = 1;
+		}
+		bool isDone() const	{ return mDone; }
+		void ref()			{ mRefs++; }
+		void unref()		{ if (!--mRefs) delete this; }
+
+		S32 mRegion;
+		LLObjectCacheFile mFile;
+		bool mSuccess;
+
+	private:
+		LLAtomicS32 mClaims;
+		LLAtomicS32 mDone;
+		LLAtomicS32 mRefs;
+	};
+
+	class RegionLoadTask : public LLWorkerPool::Task
+	{
+	public:
+		RegionLoadTask(LLWorkerPool::Subsystem* subsystem, RegionLoad* load)
+		:	LLWorkerPool::Task(subsystem), mLoad(load)
+		{
+			mLoad->ref();
+		}
+		/*virtual*/ ~RegionLoadTask()
+		{
+			mLoad->unref();
+		}
+
+		/*virtual*/ bool run()
+		{
+			if (mLoad->claim())
+			{
+				mLoad->read();
+			}
+			return false;
+		}
+
+	private:
+		RegionLoad* mLoad;
+	};
+
+	enum EMode { MODE_OLD, MODE_SYNC, MODE_ASYNC };
+
+	// Returns the main thread seconds spent per region connect.
+	F64 connect_regions(EMode mode, S32 regions, const std::vector<LLUUID>& region_ids, S32 handshake_ms, bool& ok)
+	{
+		LLWorkerPool* pool = LLWorkerPool::getInstance();
+		LLWorkerPool::Subsystem* subsystem = pool ? pool->getSubsystem("objectcache") : NULL;
+
+		F64 seconds = 0.0;
+		ok = true;
+		for (S32 region = 0; region < regions; ++region)
+		{
+			RegionLoad* load = NULL;
+			if (mode == MODE_ASYNC && subsystem)
+			{
+				// The region is created...
+				load = new RegionLoad(region);
+				RegionLoadTask* task = new RegionLoadTask(subsystem, load);
+				if (!pool->submit(task))
+				{
+					delete task;
+				}
+			}
+			// ...and its handshake arrives a round trip later.
+			ms_sleep(handshake_ms);
+
+			entry_map_t entries;
+			LLTimer timer;
+			if (mode == MODE_OLD)
+			{
+				ok = load_old(region, region_ids[region], entries) && ok;
+			}
+			else if (load)
+			{
+				if (load->claim())
+				{
+					load->read();
+				}
+				while (!load->isDone())
+				{
+					ms_sleep(1);
+				}
+				ok = load->mSuccess && walk(load->mFile, region_ids[region], entries) && ok;
+				load->unref();
+			}
+			else
+			{
+				LLObjectCacheFile file;
+				ok = file.read(region_filename(region, true)) && walk(file, region_ids[region], entries) && ok;
+			}
+			seconds += timer.getElapsedTimeF64();
+		}
+		return seconds / regions;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 regions = argc > 1 ? llmax(atoi(argv[1]), 1) : 8;
+	S32 objects = argc > 2 ? llmax(atoi(argv[2]), 1) : 15000;
+	S32 handshake_ms = argc > 3 ? llmax(atoi(argv[3]), 0) : 50;
+
+	std::vector<LLUUID> region_ids(regions);
+	for (S32 region = 0; region < regions; ++region)
+	{
+		region_ids[region].generate();
+		write_region(region, objects, region_ids[region]);
+	}
+
+	LLWorkerPool::initClass(LLWorkerPool::getDefaultThreadCount());
+	if (LLWorkerPool* pool = LLWorkerPool::getInstance())
+	{
+		pool->addSubsystem("objectcache", LLWorkerPool::PRIORITY_CLASS_HIGH, 2);
+	}
+
+	bool ok;
+	// Once to have the files in the OS cache.
+	connect_regions(MODE_OLD, regions, region_ids, 0, ok);
+	connect_regions(MODE_SYNC, regions, region_ids, 0, ok);
+
+	std::cout << regions << " regions of " << objects << " cached objects, handshake after " << handshake_ms << " ms" << std::endl;
+	std::cout << llformat("%-10s %14s %s", "mode", "ms per region", "") << std::endl;
+	F64 seconds = connect_regions(MODE_OLD, regions, region_ids, handshake_ms, ok);
+	std::cout << llformat("%-10s %14.3f %s", "old", seconds * 1000.0, ok ? "ok" : "FAILED") << std::endl;
+	seconds = connect_regions(MODE_SYNC, regions, region_ids, handshake_ms, ok);
+	std::cout << llformat("%-10s %14.3f %s", "new sync", seconds * 1000.0, ok ? "ok" : "FAILED") << std::endl;
+	if (LLWorkerPool::getInstance())
+	{
+		seconds = connect_regions(MODE_ASYNC, regions, region_ids, handshake_ms, ok);
+		std::cout << llformat("%-10s %14.3f %s", "new async", seconds * 1000.0, ok ? "ok" : "FAILED") << std::endl;
+	}
+	LLWorkerPool::cleanupClass();
+
+	for (S32 region = 0; region < regions; ++region)
+	{
+		LLFile::remove(region_filename(region, false));
+		LLFile::remove(region_filename(region, true));
+	}
+	return 0;
+}
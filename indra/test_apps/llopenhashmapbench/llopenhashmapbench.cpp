@@ -0,0 +1,166 @@
+/**
+ * @file llopenhashmapbench.cpp
+ * @brief Object list lookups with std::map and with LLOpenHashMap
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+// Usage: llopenhashmapbench [max entries]
+//
+// Does what LLViewerObjectList does with its maps, with 50000, 100000 ...
+// up to the given number of entries (200000 by default): every object is
+// inserted, looked up eight times, then half of them are killed and all are
+// looked up again, misses included. Both for LLUUID keys and for (region
+// index, local id) keys, with std::map and with LLOpenHashMap. Reports
+// nanoseconds per operation and checks that both find the same entries.
+
+#include "linden_common.h"
+
+#include <map>
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llopenhashmap.h"
+#include "llpointer.h"
+#include "llrefcount.h"
+#include "lltimer.h"
+#include "lluuid.h"
+
+namespace
+{
+	const S32 LOOKUPS = 8;
+
+	class BenchObject : public LLRefCount
+	{
+	};
+
+	typedef LLOpenHashMap<LLUUID, LLPointer<BenchObject> > uuid_hash_map_t;
+	typedef std::map<LLUUID, LLPointer<BenchObject> > uuid_map_t;
+	typedef LLOpenHashMap<U64, LLUUID> index_hash_map_t;
+	typedef std::map<U64, LLUUID> index_map_t;
+
+	// (region index, local id) keys like LLViewerObjectList::setUUIDAndLocal() makes.
+	U64 make_index_key(U32 region, U32 local_id)
+	{
+		return (((U64)region) << 32) | (U64)local_id;
+	}
+
+	struct BenchTimes
+	{
+		F64 mInsert;
+		F64 mFind;
+		F64 mErase;
+	};
+
+	template <typename MAP, typename KEY, typename VALUE>
+	BenchTimes run_benchmark(const std::vector<KEY>& keys, const VALUE& value, U32& found)
+	{
+		BenchTimes times;
+		MAP map;
+		LLTimer timer;
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			map[keys[i]] = value;
+		}
+		times.mInsert = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (S32 pass = 0; pass < LOOKUPS; ++pass)
+		{
+			for (size_t i = 0; i < keys.size(); ++i)
+			{
+				found += map.find(keys[i]) != map.end();
+			}
+		}
+		times.mFind = timer.getElapsedTimeF64();
+
+		timer.reset();
+		for (size_t i = 0; i < keys.size(); i += 2)
+		{
+			map.erase(keys[i]);
+		}
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			found += map.find(keys[i]) != map.end();
+		}
+		times.mErase = timer.getElapsedTimeF64();
+		return times;
+	}
+
+	void report(const char* name, size_t count, const BenchTimes& map_times, const BenchTimes& hash_times)
+	{
+		std::cout << name << ", " << count << " entries (ns per operation): insert std::map " << map_times.mInsert * 1e9 / count
+				  << " LLOpenHashMap " << hash_times.mInsert * 1e9 / count
+				  << ", find std::map " << map_times.mFind * 1e9 / (count * LOOKUPS)
+				  << " LLOpenHashMap " << hash_times.mFind * 1e9 / (count * LOOKUPS)
+				  << ", erase+find std::map " << map_times.mErase * 1e9 / count
+				  << " LLOpenHashMap " << hash_times.mErase * 1e9 / count << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 max_count = argc > 1 ? llmax(atoi(argv[1]), 1) : 200000;
+
+	LLPointer<BenchObject> object = new BenchObject;
+	bool ok = true;
+	for (S32 count = llmin(50000, max_count); count <= max_count; count *= 2)
+	{
+		std::vector<LLUUID> ids(count);
+		std::vector<U64> index_keys(count);
+		for (S32 i = 0; i < count; ++i)
+		{
+			ids[i].generate();
+			index_keys[i] = make_index_key(1 + i % 4, 1000 + i);
+		}
+
+		U32 map_found = 0;
+		U32 hash_found = 0;
+		BenchTimes map_times = run_benchmark<uuid_map_t>(ids, object, map_found);
+		BenchTimes hash_times = run_benchmark<uuid_hash_map_t>(ids, object, hash_found);
+		ok = ok && hash_found == map_found;
+		report("LLUUID keys", count, map_times, hash_times);
+
+		map_found = hash_found = 0;
+		map_times = run_benchmark<index_map_t>(index_keys, LLUUID::null, map_found);
+		hash_times = run_benchmark<index_hash_map_t>(index_keys, LLUUID::null, hash_found);
+		ok = ok && hash_found == map_found;
+		report("Local id keys", count, map_times, hash_times);
+	}
+
+	std::cout << (ok ? "ok" : "LOOKUPS DIFFER") << std::endl;
+	return ok ? 0 : 1;
+}
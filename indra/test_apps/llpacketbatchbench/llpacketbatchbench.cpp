@@ -0,0 +1,193 @@
+/**
+ * @file llpacketbatchbench.cpp
+ * @brief Measures sending and receiving UDP packets one at a time and in batches
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Usage: llpacketbatchbench [packets] [packet size]
+//
+// Sends <packets> datagrams of <packet size> bytes (default 200000 of 1200)
+// from one socket to another over loopback, in bursts of NET_MAX_BATCH like
+// the resends and acks of LLMessageSystem::processAcks(), and reads every
+// burst back through LLPacketRing::receivePacket() until it returns zero,
+// like LLMessageSystem::checkMessages() does. First a system call per packet,
+// then batched with recvmmsg() and sendmmsg() (LLPacketRing::setUseBatchedIO()).
+//
+// Reports the system calls per packet each way and the packets per second,
+// and checks that every packet arrived intact and in order.
+
+#include "linden_common.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llhost.h"
+#include "llpacketring.h"
+#include "lltimer.h"
+#include "net.h"
+
+namespace
+{
+	struct BenchResult
+	{
+		BenchResult() : mSent(0), mReceived(0), mSendCalls(0), mReceiveCalls(0), mSeconds(0.0), mIntact(true) { }
+
+		U32 mSent;
+		U32 mReceived;
+		U32 mSendCalls;
+		U32 mReceiveCalls;
+		F64 mSeconds;
+		bool mIntact;
+	};
+
+	void fill_packet(char* data, S32 size, U32 sequence)
+	{
+		memcpy(data, &sequence, sizeof(sequence));	/*Flawfinder: ignore*/
+		for (S32 i = sizeof(sequence); i < size; ++i)
+		{
+			data[i] = (char)(sequence + i);
+		}
+	}
+
+	bool check_packet(const char* data, S32 size, S32 expected_size, U32 sequence)
+	{
+		if (size != expected_size || memcmp(data, &sequence, sizeof(sequence)))
+		{
+			return false;
+		}
+		for (S32 i = sizeof(sequence); i < size; ++i)
+		{
+			if (data[i] != (char)(sequence + i))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	BenchResult run(S32 sender, U32 sender_port, S32 receiver, U32 receiver_port, S32 count, S32 size, bool batched)
+	{
+		LLPacketRing ring;
+		ring.setUseBatchedIO(batched);
+
+		U32 loopback = ip_string_to_u32(LOOPBACK_ADDRESS_STRING);
+		std::vector<char> burst_data(NET_MAX_BATCH * size);
+		LLNetDatagram datagrams[NET_MAX_BATCH];
+		for (S32 i = 0; i < NET_MAX_BATCH; ++i)
+		{
+			datagrams[i].mData = &burst_data[i * size];
+			datagrams[i].mSize = size;
+			datagrams[i].mAddress = loopback;
+			datagrams[i].mPort = receiver_port;
+		}
+		char buffer[NET_BUFFER_SIZE];
+
+		BenchResult result;
+		LLTimer timer;
+		for (S32 first = 0; first < count; first += NET_MAX_BATCH)
+		{
+			S32 burst = llmin(count - first, (S32)NET_MAX_BATCH);
+			for (S32 i = 0; i < burst; ++i)
+			{
+				fill_packet(datagrams[i].mData, size, first + i);
+			}
+
+			U32 calls = get_net_call_count();
+			if (batched)
+			{
+				result.mSent += send_packets(sender, datagrams, burst);
+			}
+			else
+			{
+				for (S32 i = 0; i < burst; ++i)
+				{
+					result.mSent += send_packet(sender, datagrams[i].mData, size, loopback, receiver_port) ? 1 : 0;
+				}
+			}
+			result.mSendCalls += get_net_call_count() - calls;
+
+			// Loopback delivers during the send, the whole burst is waiting now.
+			calls = get_net_call_count();
+			S32 received;
+			while ((received = ring.receivePacket(receiver, buffer)) > 0)
+			{
+				result.mIntact = result.mIntact &&
+								 ring.getLastSender().getPort() == sender_port &&
+								 check_packet(buffer, received, size, result.mReceived);
+				++result.mReceived;
+			}
+			result.mReceiveCalls += get_net_call_count() - calls;
+		}
+		result.mSeconds = timer.getElapsedTimeF64();
+		return result;
+	}
+
+	void report(const char* name, const BenchResult& result)
+	{
+		std::cout << llformat("%-8s %9u %9u %12.3f %12.3f %12.0f %s", name, result.mSent, result.mReceived,
+							  (F64)result.mSendCalls / llmax(result.mSent, 1U),
+							  (F64)result.mReceiveCalls / llmax(result.mReceived, 1U),
+							  result.mReceived / llmax(result.mSeconds, 0.000001),
+							  result.mIntact ? "ok" : "CORRUPT") << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 count = argc > 1 ? llmax(atoi(argv[1]), 1) : 200000;
+	S32 size = argc > 2 ? llclamp(atoi(argv[2]), 4, (S32)NET_BUFFER_SIZE) : MTUBYTES;
+
+	S32 sender = -1;
+	S32 receiver = -1;
+	int sender_port = NET_USE_OS_ASSIGNED_PORT;
+	int receiver_port = NET_USE_OS_ASSIGNED_PORT;
+	if (start_net(sender, sender_port) || start_net(receiver, receiver_port))
+	{
+		std::cerr << "Can't open the sockets" << std::endl;
+		return 1;
+	}
+
+	// Once to warm up.
+	run(sender, sender_port, receiver, receiver_port, llmin(count, 1000), size, true);
+
+	std::cout << count << " packets of " << size << " bytes over loopback" << std::endl;
+	std::cout << llformat("%-8s %9s %9s %12s %12s %12s", "mode", "sent", "received", "sends/pkt", "receives/pkt", "packets/s") << std::endl;
+	report("single", run(sender, sender_port, receiver, receiver_port, count, size, false));
+	report("batched", run(sender, sender_port, receiver, receiver_port, count, size, true));
+
+	end_net(sender);
+	end_net(receiver);
+	return 0;
+}
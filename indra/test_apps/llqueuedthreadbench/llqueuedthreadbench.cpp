@@ -0,0 +1,187 @@
+/**
+ * @file llqueuedthreadbench.cpp
+ * @brief Request throughput of LLQueuedThread per queue type and number of producers
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+// Usage: llqueuedthreadbench [producers] [requests per producer] [pool threads]
+//
+// Adds requests to an LLQueuedThread from 1, 2, 4 ... up to the given number
+// of producer threads (8 by default) as fast as they can, bumping the priority
+// of every fourth one like LLTextureFetch does, and reports how many requests
+// per second get processed with QUEUE_SORTED and with QUEUE_LOCKFREE.
+// With pool threads, the requests are processed by an LLWorkerPool subsystem
+// of that many threads instead of by the thread of the queue.
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "llerrorcontrol.h"
+#include "llqueuedthread.h"
+#include "llthread.h"
+#include "lltimer.h"
+#include "llworkerpool.h"
+
+namespace
+{
+	class BenchQueuedThread : public LLQueuedThread
+	{
+	public:
+		class BenchRequest : public QueuedRequest
+		{
+		public:
+			BenchRequest(handle_t handle, U32 priority, BenchQueuedThread* thread) :
+				QueuedRequest(handle, priority, FLAG_AUTO_COMPLETE),
+				mThread(thread)
+			{
+			}
+
+			/*virtual*/ bool processRequest()
+			{
+				mThread->mProcessed++;
+				return true;
+			}
+
+			BenchQueuedThread* mThread;
+		};
+
+		BenchQueuedThread(queue_t queue_type) :
+			LLQueuedThread("QueuedThreadBench", true, false, queue_type),
+			mProcessed(0)
+		{
+		}
+
+		handle_t add(U32 priority)
+		{
+			handle_t handle = generateHandle();
+			addRequest(new BenchRequest(handle, priority, this));
+			return handle;
+		}
+
+		LLAtomicS32 mProcessed;
+	};
+
+	class ProducerThread : public LLThread
+	{
+	public:
+		ProducerThread(BenchQueuedThread* queue, S32 seed, S32 requests) :
+			LLThread("QueuedThreadProducer"), mQueue(queue), mSeed(seed), mRequests(requests)
+		{
+		}
+
+		/*virtual*/ void run()
+		{
+			U32 rand = mSeed;
+			for (S32 i = 0; i < mRequests; ++i)
+			{
+				rand = rand * 1103515245 + 12345;
+				LLQueuedThread::handle_t handle = mQueue->add(LLQueuedThread::PRIORITY_LOW + (rand >> 8) % LLQueuedThread::PRIORITY_HIGH);
+				if ((i & 3) == 0)
+				{
+					mQueue->setPriority(handle, LLQueuedThread::PRIORITY_HIGH | (rand & LLQueuedThread::PRIORITY_LOWBITS));
+				}
+			}
+		}
+
+		BenchQueuedThread* mQueue;
+		S32 mSeed;
+		S32 mRequests;
+	};
+
+	// Returns the number of requests per second.
+	F32 run_producers(LLQueuedThread::queue_t queue_type, S32 producers, S32 requests, bool& ok)
+	{
+		BenchQueuedThread queue(queue_type);
+		std::vector<ProducerThread*> threads;
+		for (S32 i = 0; i < producers; ++i)
+		{
+			threads.push_back(new ProducerThread(&queue, i + 1, requests));
+		}
+		LLTimer timer;
+		for (S32 i = 0; i < producers; ++i)
+		{
+			threads[i]->start();
+		}
+		S32 total = producers * requests;
+		while (queue.mProcessed < total && timer.getElapsedTimeF32() < 60.f)
+		{
+			queue.update(0);
+			ms_sleep(1);
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		for (S32 i = 0; i < producers; ++i)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+		ok = ok && queue.mProcessed == total;
+		return (F32)queue.mProcessed / llmax(elapsed, 0.001f);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 max_producers = argc > 1 ? llmax(atoi(argv[1]), 1) : 8;
+	S32 requests = argc > 2 ? llmax(atoi(argv[2]), 1) : 20000;
+	S32 pool_threads = argc > 3 ? llmax(atoi(argv[3]), 0) : 0;
+
+	if (pool_threads)
+	{
+		LLWorkerPool::initClass(pool_threads);
+		LLWorkerPool::getInstance()->addSubsystem("QueuedThreadBench", LLWorkerPool::PRIORITY_CLASS_NORMAL, pool_threads);
+		std::cout << "On a worker pool of " << pool_threads << " threads" << std::endl;
+	}
+
+	bool ok = true;
+	for (S32 producers = 1; producers <= max_producers; producers *= 2)
+	{
+		F32 sorted_rate = run_producers(LLQueuedThread::QUEUE_SORTED, producers, requests, ok);
+		F32 lockfree_rate = run_producers(LLQueuedThread::QUEUE_LOCKFREE, producers, requests, ok);
+		std::cout << producers << " producers: sorted " << sorted_rate << " requests/s, lock-free "
+				  << lockfree_rate << " requests/s" << std::endl;
+	}
+
+	if (pool_threads)
+	{
+		LLWorkerPool::cleanupClass();
+	}
+
+	std::cout << (ok ? "ok" : "LOST REQUESTS") << std::endl;
+	return ok ? 0 : 1;
+}
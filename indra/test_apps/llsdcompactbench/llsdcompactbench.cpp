@@ -0,0 +1,216 @@
+/**
+ * @file llsdcompactbench.cpp
+ * @brief Parses LLSD documents normally and compactly
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+// Usage: llsdcompactbench [iterations] [inventory items]
+//
+// Parses a mesh header (binary) and a FetchInventoryDescendents2 response
+// with the given number of items (XML and binary) the given number of times
+// (2000 by default), does the lookups the viewer does on them and destroys
+// them again, with a normal and with a compact parser. Reports microseconds
+// per document and checks that both give the same results.
+
+#include "linden_common.h"
+
+#include <sstream>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llsd.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
+#include "lluuid.h"
+
+namespace
+{
+	const char* const MESH_LODS[] = { "lowest_lod", "low_lod", "medium_lod", "high_lod", "physics_convex", "physics_mesh", "skin" };
+	const S32 MESH_LOD_COUNT = LL_ARRAY_SIZE(MESH_LODS);
+
+	// What LLMeshRepoThread::headerReceived() gets.
+	LLSD make_mesh_header()
+	{
+		LLSD header;
+		S32 offset = 0;
+		for (S32 i = 0; i < MESH_LOD_COUNT; ++i)
+		{
+			header[MESH_LODS[i]]["offset"] = offset;
+			header[MESH_LODS[i]]["size"] = 1000 + i * 517;
+			offset += 1000 + i * 517;
+		}
+		header["version"] = 1;
+		header["creator"] = LLUUID::generateNewID();
+		header["date"] = LLDate(1325376000.0);
+		return header;
+	}
+
+	// What a FetchInventoryDescendents2 capability returns for one folder.
+	LLSD make_inventory_response(S32 items)
+	{
+		LLSD folder;
+		folder["folder_id"] = LLUUID::generateNewID();
+		folder["owner_id"] = LLUUID::generateNewID();
+		folder["agent_id"] = folder["owner_id"];
+		folder["version"] = 42;
+		folder["descendents"] = items;
+		folder["categories"] = LLSD::emptyArray();
+		for (S32 i = 0; i < items; ++i)
+		{
+			LLSD item;
+			item["item_id"] = LLUUID::generateNewID();
+			item["parent_id"] = folder["folder_id"];
+			item["asset_id"] = LLUUID::generateNewID();
+			item["name"] = llformat("Inventory item %d", i);
+			item["desc"] = "(No Description)";
+			item["type"] = 6;
+			item["inv_type"] = 6;
+			item["flags"] = 0;
+			item["created_at"] = 1325376000 + i;
+			item["sale_info"]["sale_price"] = 10;
+			item["sale_info"]["sale_type"] = 0;
+			LLSD& permissions = item["permissions"];
+			permissions["creator_id"] = folder["owner_id"];
+			permissions["owner_id"] = folder["owner_id"];
+			permissions["last_owner_id"] = folder["owner_id"];
+			permissions["group_id"] = LLUUID::null;
+			permissions["is_owner_group"] = false;
+			permissions["base_mask"] = (S32)0x7fffffff;
+			permissions["owner_mask"] = (S32)0x7fffffff;
+			permissions["group_mask"] = 0;
+			permissions["everyone_mask"] = 0;
+			permissions["next_owner_mask"] = (S32)0x82000;
+			folder["items"].append(item);
+		}
+		LLSD response;
+		response["folders"].append(folder);
+		return response;
+	}
+
+	LLSD parse(const std::string& data, bool xml, bool compact)
+	{
+		std::istringstream stream(data);
+		LLPointer<LLSDParser> parser;
+		if (xml)
+		{
+			parser = new LLSDXMLParser;
+		}
+		else
+		{
+			parser = new LLSDBinaryParser;
+		}
+		parser->setCompact(compact);
+		LLSD result;
+		parser->parse(stream, result, data.size());
+		return result;
+	}
+
+	// The lookups LLMeshRepoThread does on a header.
+	S32 read_mesh_header(const LLSD& header)
+	{
+		S32 total = header["version"].asInteger();
+		for (S32 i = 0; i < MESH_LOD_COUNT; ++i)
+		{
+			const LLSD& lod = header[MESH_LODS[i]];
+			total += lod["offset"].asInteger() + lod["size"].asInteger();
+		}
+		return total;
+	}
+
+	// The lookups LLInventoryModelFetchDescendentsResponder does on a response.
+	S32 read_inventory_response(const LLSD& response)
+	{
+		S32 total = 0;
+		const LLSD& folder = response["folders"][0];
+		total += folder["version"].asInteger();
+		const LLSD& items = folder["items"];
+		for (LLSD::array_const_iterator iter = items.beginArray(); iter != items.endArray(); ++iter)
+		{
+			const LLSD& item = *iter;
+			total += item["item_id"].asUUID().isNull() ? 0 : 1;
+			total += item["name"].asString().size();
+			total += item["type"].asInteger() + item["inv_type"].asInteger() + item["flags"].asInteger();
+			total += item["sale_info"]["sale_price"].asInteger();
+			total += item["permissions"]["owner_mask"].asInteger() & 0xff;
+		}
+		return total;
+	}
+
+	// Returns the time of parse + lookup + destroy, in microseconds per document.
+	F64 run_benchmark(const std::string& data, bool xml, bool compact, S32 (*read)(const LLSD&), S32 iterations, S32& check)
+	{
+		LLTimer timer;
+		check = 0;
+		for (S32 i = 0; i < iterations; ++i)
+		{
+			LLSD document = parse(data, xml, compact);
+			check += read(document);
+		}
+		return timer.getElapsedTimeF64() * 1000000.0 / iterations;
+	}
+
+	// Prints normal against compact for one document; false when their lookups differ.
+	bool compare(const char* name, const std::string& data, bool xml, S32 (*read)(const LLSD&), S32 iterations)
+	{
+		S32 normal_check, compact_check;
+		F64 normal = run_benchmark(data, xml, false, read, iterations, normal_check);
+		F64 compact = run_benchmark(data, xml, true, read, iterations, compact_check);
+		std::cout << name << ": " << normal << " us normal, " << compact << " us compact" << std::endl;
+		return compact_check == normal_check;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 iterations = argc > 1 ? llmax(atoi(argv[1]), 1) : 2000;
+	S32 items = argc > 2 ? llmax(atoi(argv[2]), 1) : 100;
+
+	std::ostringstream binary;
+	LLSDSerialize::toBinary(make_mesh_header(), binary);
+	LLSD response = make_inventory_response(items);
+	std::ostringstream xml;
+	LLSDSerialize::toXML(response, xml);
+	std::ostringstream inventory_binary;
+	LLSDSerialize::toBinary(response, inventory_binary);
+
+	bool ok = compare("Mesh header (binary)", binary.str(), false, read_mesh_header, iterations);
+	std::string name = llformat("FetchInventoryDescendents, %d items", items);
+	ok = compare((name + " (XML)").c_str(), xml.str(), true, read_inventory_response, iterations) && ok;
+	ok = compare((name + " (binary)").c_str(), inventory_binary.str(), false, read_inventory_response, iterations) && ok;
+
+	std::cout << (ok ? "ok" : "RESULTS DIFFER") << std::endl;
+	return ok ? 0 : 1;
+}
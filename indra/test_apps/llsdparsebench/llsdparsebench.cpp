@@ -0,0 +1,210 @@
+/**
+ * @file llsdparsebench.cpp
+ * @brief Parses LLSD out of streams and straight out of buffers
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+// Usage: llsdparsebench [iterations]
+//
+// Parses a FetchInventoryDescendents2 like document with 100 items as binary
+// and as XML, and unzips a mesh LOD block with 8 faces, the given number of
+// times each (500 by default). Once the way callers used to, copying the
+// data into an istringstream, and once straight out of the buffer. Reports
+// microseconds per parse and checks that both give the same result.
+
+#include "linden_common.h"
+
+#include <sstream>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llsd.h"
+#include "llsdserialize.h"
+#include "lltimer.h"
+#include "lluuid.h"
+
+namespace
+{
+	enum EFormat
+	{
+		FORMAT_BINARY,
+		FORMAT_XML,
+		FORMAT_ZIPPED
+	};
+
+	const char* const FORMAT_NAMES[] = { "Binary", "XML", "Zipped mesh LOD" };
+
+	// A FetchInventoryDescendents2 like response with every LLSD type in it.
+	LLSD make_document(S32 items)
+	{
+		LLSD folder;
+		folder["folder_id"] = LLUUID::generateNewID();
+		folder["version"] = 42;
+		folder["date"] = LLDate(1325376000.0);
+		folder["uri"] = LLURI("http://example.com/cap/0123");
+		folder["undefined"] = LLSD();
+		folder["real"] = 3.25;
+		for (S32 i = 0; i < items; ++i)
+		{
+			LLSD item;
+			item["item_id"] = LLUUID::generateNewID();
+			item["name"] = llformat("Item %d with an \"escaped\"\tname", i);
+			item["type"] = i % 24;
+			item["is_owner_group"] = (i & 1) != 0;
+			item["permissions"]["owner_mask"] = (S32)0x7fffffff;
+			item["permissions"]["group_mask"] = 0;
+			folder["items"].append(item);
+		}
+		return folder;
+	}
+
+	// What a mesh LOD block holds: faces with binary vertex data.
+	LLSD make_mesh_lod(S32 faces)
+	{
+		LLSD lod;
+		for (S32 i = 0; i < faces; ++i)
+		{
+			LLSD face;
+			// Quantized positions compress about as badly as noise does.
+			std::vector<U8> positions(6 * 1024);
+			U32 rand = i + 1;
+			for (U32 j = 0; j < positions.size(); ++j)
+			{
+				rand = rand * 1103515245 + 12345;
+				positions[j] = (U8)(rand >> 16);
+			}
+			face["Position"] = positions;
+			face["PositionDomain"]["Min"].append(-0.5);
+			face["PositionDomain"]["Max"].append(0.5);
+			std::vector<U8> triangles(3 * 1024);
+			for (U32 j = 0; j < triangles.size(); ++j)
+			{
+				triangles[j] = (U8)(j / 3 + j % 3);
+			}
+			face["TriangleList"] = triangles;
+			lod.append(face);
+		}
+		return lod;
+	}
+
+	std::string to_notation(const LLSD& sd)
+	{
+		std::ostringstream stream;
+		LLSDSerialize::toNotation(sd, stream);
+		return stream.str();
+	}
+
+	// What callers did before: copy the data into a string and parse an istringstream.
+	bool parse_stream(EFormat format, const std::string& data, LLSD& sd)
+	{
+		std::string copy(data);
+		std::istringstream stream(copy);
+		switch (format)
+		{
+		case FORMAT_BINARY:
+			return LLSDSerialize::fromBinary(sd, stream, copy.size()) > 0;
+		case FORMAT_XML:
+			return LLSDSerialize::fromXML(sd, stream) > 0;
+		default:
+			return unzip_llsd(sd, stream, copy.size());
+		}
+	}
+
+	bool parse_buffer(EFormat format, const std::string& data, LLSD& sd)
+	{
+		const U8* bytes = (const U8*)data.data();
+		switch (format)
+		{
+		case FORMAT_BINARY:
+			return LLSDSerialize::fromBinary(sd, bytes, data.size()) > 0;
+		case FORMAT_XML:
+			return LLSDSerialize::fromXML(sd, bytes, data.size()) > 0;
+		default:
+			return unzip_llsd(sd, bytes, data.size());
+		}
+	}
+
+	// Returns microseconds per parse.
+	F64 run_benchmark(EFormat format, const std::string& data, bool buffer, S32 iterations)
+	{
+		LLTimer timer;
+		for (S32 i = 0; i < iterations; ++i)
+		{
+			LLSD sd;
+			if (buffer)
+			{
+				parse_buffer(format, data, sd);
+			}
+			else
+			{
+				parse_stream(format, data, sd);
+			}
+		}
+		return timer.getElapsedTimeF64() * 1000000.0 / iterations;
+	}
+
+	// Prints stream against buffer for one document; false when their results differ.
+	bool compare(EFormat format, const std::string& data, S32 iterations)
+	{
+		F64 stream = run_benchmark(format, data, false, iterations);
+		F64 buffer = run_benchmark(format, data, true, iterations);
+		std::cout << FORMAT_NAMES[format] << ", " << data.size() << " bytes: " << stream << " us stream, "
+				  << buffer << " us buffer" << std::endl;
+		LLSD stream_sd;
+		LLSD buffer_sd;
+		return parse_stream(format, data, stream_sd) && parse_buffer(format, data, buffer_sd) &&
+			   to_notation(stream_sd) == to_notation(buffer_sd);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 iterations = argc > 1 ? llmax(atoi(argv[1]), 1) : 500;
+
+	LLSD document = make_document(100);
+	std::ostringstream binary;
+	LLSDSerialize::toBinary(document, binary);
+	std::ostringstream xml;
+	LLSDSerialize::toXML(document, xml);
+
+	bool ok = compare(FORMAT_BINARY, binary.str(), iterations);
+	ok = compare(FORMAT_XML, xml.str(), iterations) && ok;
+	LLSD lod = make_mesh_lod(8);
+	ok = compare(FORMAT_ZIPPED, zip_llsd(lod), iterations) && ok;
+
+	std::cout << (ok ? "ok" : "RESULTS DIFFER") << std::endl;
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,243 @@
+/**
+ * @file llshardedvfsbench.cpp
+ * @brief Concurrent store/read/remove throughput of LLShardedVFS and LLVFS
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+// Usage: llshardedvfsbench <work directory> [threads] [operations per thread]
+//
+// Runs the same random mix of stores, reads and removes on a sharded VFS and
+// on the monolithic LLVFS, from 1, 2, 4 ... up to the given number of threads
+// (8 by default). Each thread works on its own 64 files, like the VFS thread
+// and the main thread do in the viewer, and checks everything it reads back.
+// Reports operations per second for both.
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "llerrorcontrol.h"
+#include "lldir.h"
+#include "llfile.h"
+#include "llshardedvfs.h"
+#include "llthread.h"
+#include "lltimer.h"
+#include "llvfs.h"
+
+namespace
+{
+	const U32 VFS_SIZE = 64 * 1024 * 1024;
+	const U32 SHARDS = 16;
+	const S32 FILES_PER_THREAD = 64;
+
+	// Fill buffer with a pattern derived from the file id, so readers can verify what they get.
+	void fill_pattern(const LLUUID& id, std::vector<U8>& buffer)
+	{
+		for (size_t i = 0; i < buffer.size(); ++i)
+		{
+			buffer[i] = (U8)(id.mData[i % UUID_BYTES] + i);
+		}
+	}
+
+	bool check_pattern(const LLUUID& id, const U8* data, S32 size)
+	{
+		for (S32 i = 0; i < size; ++i)
+		{
+			if (data[i] != (U8)(id.mData[i % UUID_BYTES] + i))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	class StressThread : public LLThread
+	{
+	public:
+		StressThread(LLVFS* vfs, S32 seed, S32 ops)
+		:	LLThread("VFS stress"), mVFS(vfs), mSeed(seed), mOps(ops), mErrors(0), mDone(false)
+		{
+			for (S32 i = 0; i < FILES_PER_THREAD; ++i)
+			{
+				mFiles.push_back(LLUUID::generateNewID());
+			}
+		}
+
+		/*virtual*/ void run()
+		{
+			U32 rand = mSeed;
+			std::vector<U8> buffer;
+			for (S32 op = 0; op < mOps; ++op)
+			{
+				rand = rand * 1103515245 + 12345;
+				const LLUUID& id = mFiles[(rand >> 8) % mFiles.size()];
+				S32 size = 1024 + (S32)((rand >> 4) % (64 * 1024));
+				switch ((rand >> 24) % 4)
+				{
+				case 0:
+				{
+					buffer.resize(size);
+					fill_pattern(id, buffer);
+					if (mVFS->setMaxSize(id, LLAssetType::AT_SOUND, size))
+					{
+						mVFS->storeData(id, LLAssetType::AT_SOUND, &buffer[0], 0, size);
+					}
+					break;
+				}
+				case 3:
+					if (mVFS->getExists(id, LLAssetType::AT_SOUND))
+					{
+						mVFS->removeFile(id, LLAssetType::AT_SOUND);
+					}
+					break;
+				default:
+				{
+					S32 file_size = mVFS->getSize(id, LLAssetType::AT_SOUND);
+					if (file_size > 0)
+					{
+						buffer.resize(file_size);
+						S32 read = mVFS->getData(id, LLAssetType::AT_SOUND, &buffer[0], 0, file_size);
+						if (read != file_size || !check_pattern(id, &buffer[0], read))
+						{
+							mErrors++;
+						}
+					}
+					break;
+				}
+				}
+			}
+			mDone = true;
+		}
+
+		LLVFS* mVFS;
+		S32 mSeed;
+		S32 mOps;
+		std::vector<LLUUID> mFiles;
+		S32 mErrors;
+		volatile bool mDone;
+	};
+
+	// Runs the threads and returns the number of operations per second.
+	F32 run_stress(LLVFS* vfs, S32 threads, S32 ops, S32& errors)
+	{
+		std::vector<StressThread*> stress;
+		for (S32 i = 0; i < threads; ++i)
+		{
+			stress.push_back(new StressThread(vfs, i + 1, ops));
+		}
+		LLTimer timer;
+		for (S32 i = 0; i < threads; ++i)
+		{
+			stress[i]->start();
+		}
+		for (S32 i = 0; i < threads; ++i)
+		{
+			while (!stress[i]->mDone)
+			{
+				ms_sleep(1);
+			}
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		for (S32 i = 0; i < threads; ++i)
+		{
+			while (!stress[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			errors += stress[i]->mErrors;
+			delete stress[i];
+		}
+		return (F32)(threads * ops) / llmax(elapsed, 0.001f);
+	}
+
+	void remove_files(const std::string& base, const std::string& index, const std::string& data)
+	{
+		for (U32 i = 0; i < SHARDS; ++i)
+		{
+			LLFile::remove(base + llformat(".%02u", i));
+			LLFile::remove(base + llformat(".%02u.tmp", i));
+		}
+		LLFile::remove(index);
+		LLFile::remove(data);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <work directory> [threads] [operations per thread]" << std::endl;
+		return 1;
+	}
+	std::string workdir = argv[1];
+	S32 max_threads = argc > 2 ? llmax(atoi(argv[2]), 1) : 8;
+	S32 ops = argc > 3 ? llmax(atoi(argv[3]), 1) : 4000;
+
+	LLFile::mkdir(workdir);
+	std::string delim = gDirUtilp->getDirDelimiter();
+	std::string base = workdir + delim + "bench.db2";
+	std::string index = workdir + delim + "bench_index.db2";
+	std::string data = workdir + delim + "bench_data.db2";
+
+	S32 errors = 0;
+	for (S32 threads = 1; threads <= max_threads; threads *= 2)
+	{
+		remove_files(base, index, data);
+		LLVFS* vfs = LLShardedVFS::createShardedVFS(base, VFS_SIZE, SHARDS);
+		if (!vfs)
+		{
+			std::cerr << "Can't create the sharded VFS in " << workdir << std::endl;
+			return 1;
+		}
+		F32 sharded_rate = run_stress(vfs, threads, ops, errors);
+		delete vfs;
+
+		vfs = LLVFS::createLLVFS(index, data, FALSE, VFS_SIZE, FALSE);
+		if (!vfs)
+		{
+			std::cerr << "Can't create the VFS in " << workdir << std::endl;
+			return 1;
+		}
+		F32 monolithic_rate = run_stress(vfs, threads, ops, errors);
+		delete vfs;
+
+		std::cout << threads << " threads: sharded " << sharded_rate << " ops/s, monolithic "
+				  << monolithic_rate << " ops/s" << std::endl;
+	}
+	remove_files(base, index, data);
+
+	std::cout << (errors ? "CORRUPT READS" : "ok") << std::endl;
+	return errors ? 1 : 0;
+}
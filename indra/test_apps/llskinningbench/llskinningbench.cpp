@@ -0,0 +1,354 @@
+/**
+ * @file llskinningbench.cpp
+ * @brief Software skinning of rigged faces, old loop versus LLSkinning kernels and batches
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Usage: llskinningbench [avatars] [vertices per avatar] [max threads] [passes]
+//
+// Makes up avatars with a palette of 64 joints, a bind shape matrix and
+// rigged faces of 1 to 4 influences per vertex, and skins all of them
+// <passes> times the way LLDrawPoolAvatar::updateRiggedVertexBuffers() does
+// when the vertex shaders don't: first with the loop it had before
+// LLSkinning, then with each kernel the processor supports on the calling
+// thread, then with a worker pool of 1, 2, 4 ... max threads, one batch per
+// avatar. Reports millions of vertices per second and the largest difference
+// from the old loop, which isn't zero because the palettes have the bind
+// shape folded in, and checks that the kernels agree with each other.
+
+#include "linden_common.h"
+
+#include <vector>
+
+#include "llaprpool.h"
+#include "llerrorcontrol.h"
+#include "llmath.h"
+#include "llmemory.h"
+#include "llquaternion.h"
+#include "llskinning.h"
+#include "lltimer.h"
+#include "llworkerpool.h"
+#include "m3math.h"
+#include "m4math.h"
+
+namespace
+{
+	// Relative to the size of the vertex; both the old loop and the kernels
+	// round at every step.
+	const F32 TOLERANCE = 1.e-4f;
+
+	struct Face
+	{
+		S32 mCount;
+		LLVector4a* mWeights;
+		LLVector4a* mPositions;
+		LLVector4a* mNormals;
+		LLVector4a* mOutPositions;
+		LLVector4a* mOutNormals;
+	};
+
+	struct Avatar
+	{
+		LLMatrix4a mBindShape;
+		LLMatrix4a* mJoints;
+		std::vector<Face> mFaces;
+	};
+
+	U32 sSeed = 1;
+
+	F32 frand()
+	{
+		sSeed = sSeed * 1103515245 + 12345;
+		return (F32)((sSeed >> 8) & 0xffff) / 65536.f;
+	}
+
+	F32 frand(F32 low, F32 high)
+	{
+		return low + (high - low) * frand();
+	}
+
+	LLVector4a* allocate_vectors(S32 count)
+	{
+		return (LLVector4a*)ll_aligned_malloc_16(count * sizeof(LLVector4a));
+	}
+
+	LLMatrix4a make_matrix(F32 scale, F32 offset)
+	{
+		LLVector3 axis(frand(-1.f, 1.f), frand(-1.f, 1.f), frand(-1.f, 1.f) + 2.f);
+		axis.normalize();
+		LLMatrix4 mat(LLQuaternion(frand(0.f, F_TWO_PI), axis).getMatrix4());
+		for (S32 i = 0; i < 3; ++i)
+		{
+			for (S32 j = 0; j < 3; ++j)
+			{
+				mat.mMatrix[i][j] *= scale;
+			}
+			mat.mMatrix[3][i] = frand(-offset, offset);
+		}
+		LLMatrix4a result;
+		result.loadu(mat);
+		return result;
+	}
+
+	void make_face(Face& face, S32 count)
+	{
+		face.mCount = count;
+		face.mWeights = allocate_vectors(count);
+		face.mPositions = allocate_vectors(count);
+		face.mNormals = allocate_vectors(count);
+		face.mOutPositions = allocate_vectors(count);
+		face.mOutNormals = allocate_vectors(count);
+		for (S32 i = 0; i < count; ++i)
+		{
+			face.mPositions[i].set(frand(-1.f, 1.f), frand(-1.f, 1.f), frand(-1.f, 1.f), 1.f);
+			face.mNormals[i].set(frand(-1.f, 1.f), frand(-1.f, 1.f), 1.f, 0.f);
+			face.mNormals[i].normalize3fast();
+
+			// As LLVolume unpacks them: joint index plus weight, unused
+			// influences are joint 0 with no weight.
+			F32 w[4] = { 0.f, 0.f, 0.f, 0.f };
+			S32 influences = 1 + (S32)(frand() * 4.f);
+			for (S32 k = 0; k < influences; ++k)
+			{
+				w[k] = (F32)(S32)(frand() * LLSkinning::MAX_JOINTS) + frand(0.05f, 0.95f);
+			}
+			face.mWeights[i].loadua(w);
+		}
+	}
+
+	void make_avatars(std::vector<Avatar>& avatars, S32 count, S32 vertices)
+	{
+		avatars.resize(count);
+		for (S32 i = 0; i < count; ++i)
+		{
+			Avatar& avatar = avatars[i];
+			avatar.mBindShape = make_matrix(frand(0.5f, 2.f), 1.f);
+			avatar.mJoints = (LLMatrix4a*)ll_aligned_malloc_16(LLSkinning::MAX_JOINTS * sizeof(LLMatrix4a));
+			for (S32 j = 0; j < LLSkinning::MAX_JOINTS; ++j)
+			{
+				avatar.mJoints[j] = make_matrix(1.f, 128.f);
+			}
+			// Faces the size of rigged clothing and bodies.
+			for (S32 left = vertices; left > 0; )
+			{
+				S32 size = llmin(left, 500 + (S32)(frand() * 12000.f));
+				avatar.mFaces.push_back(Face());
+				make_face(avatar.mFaces.back(), size);
+				left -= size;
+			}
+		}
+	}
+
+	void free_avatars(std::vector<Avatar>& avatars)
+	{
+		for (size_t i = 0; i < avatars.size(); ++i)
+		{
+			for (size_t f = 0; f < avatars[i].mFaces.size(); ++f)
+			{
+				Face& face = avatars[i].mFaces[f];
+				ll_aligned_free_16(face.mWeights);
+				ll_aligned_free_16(face.mPositions);
+				ll_aligned_free_16(face.mNormals);
+				ll_aligned_free_16(face.mOutPositions);
+				ll_aligned_free_16(face.mOutNormals);
+			}
+			ll_aligned_free_16(avatars[i].mJoints);
+		}
+		avatars.clear();
+	}
+
+	// The output of a pass: positions then normals of every face.
+	typedef std::vector<LLVector4a> result_t;
+
+	void save_result(const std::vector<Avatar>& avatars, result_t& result)
+	{
+		result.clear();
+		for (size_t i = 0; i < avatars.size(); ++i)
+		{
+			for (size_t f = 0; f < avatars[i].mFaces.size(); ++f)
+			{
+				const Face& face = avatars[i].mFaces[f];
+				result.insert(result.end(), face.mOutPositions, face.mOutPositions + face.mCount);
+				result.insert(result.end(), face.mOutNormals, face.mOutNormals + face.mCount);
+			}
+		}
+	}
+
+	F32 max_error(const result_t& result, const result_t& reference)
+	{
+		F32 error = 0.f;
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			LLVector4a diff;
+			diff.setSub(result[i], reference[i]);
+			F32 size = llmax(reference[i].getLength3().getF32(), 1.f);
+			error = llmax(error, diff.getLength3().getF32() / size);
+		}
+		return error;
+	}
+
+	void clear_output(std::vector<Avatar>& avatars)
+	{
+		for (size_t i = 0; i < avatars.size(); ++i)
+		{
+			for (size_t f = 0; f < avatars[i].mFaces.size(); ++f)
+			{
+				Face& face = avatars[i].mFaces[f];
+				memset(face.mOutPositions, 0, face.mCount * sizeof(LLVector4a));
+				memset(face.mOutNormals, 0, face.mCount * sizeof(LLVector4a));
+			}
+		}
+	}
+
+	void report(const std::string& name, F32 elapsed, S32 vertices, S32 passes, F32 error, bool ok)
+	{
+		std::cout << llformat("%-22s: %8.2f Mvertices/s, max error %.2e %s", name.c_str(),
+							  vertices * (F32)passes / llmax(elapsed, 0.001f) / 1.e6f, error, ok ? "ok" : "MISMATCH")
+				  << std::endl;
+	}
+
+	void run_reference(std::vector<Avatar>& avatars, S32 vertices, S32 passes, result_t& reference)
+	{
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (size_t i = 0; i < avatars.size(); ++i)
+			{
+				Avatar& avatar = avatars[i];
+				for (size_t f = 0; f < avatar.mFaces.size(); ++f)
+				{
+					Face& face = avatar.mFaces[f];
+					LLSkinning::skinReference(avatar.mJoints, avatar.mBindShape, face.mWeights, face.mPositions,
+											  face.mNormals, face.mCount, face.mOutPositions, face.mOutNormals);
+				}
+			}
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		save_result(avatars, reference);
+		report("old loop", elapsed, vertices, passes, 0.f, true);
+	}
+
+	// threads == 0 means on the calling thread. The first result of a
+	// kernel is kept to check that the others match it exactly.
+	bool run_batches(std::vector<Avatar>& avatars, S32 vertices, S32 passes, S32 threads,
+					 const result_t& reference, result_t& expected)
+	{
+		LLWorkerPool::initClass(threads);
+		LLWorkerPool* pool = LLWorkerPool::getInstance();
+		if (pool)
+		{
+			// As registered by the viewer.
+			pool->addSubsystem("skinning", LLWorkerPool::PRIORITY_CLASS_HIGH, pool->getThreadCount());
+		}
+
+		clear_output(avatars);
+		// LLDrawPoolAvatar has a batch per avatar, run as each avatar is done.
+		LLSkinningBatch batch;
+		batch.setUseWorkerPool(pool != NULL);
+		LLTimer timer;
+		for (S32 pass = 0; pass < passes; ++pass)
+		{
+			for (size_t i = 0; i < avatars.size(); ++i)
+			{
+				Avatar& avatar = avatars[i];
+				const LLMatrix4a* palette = batch.addPalette(avatar.mBindShape, avatar.mJoints, LLSkinning::MAX_JOINTS);
+				for (size_t f = 0; f < avatar.mFaces.size(); ++f)
+				{
+					Face& face = avatar.mFaces[f];
+					batch.add(palette, face.mWeights, face.mPositions, face.mNormals, face.mCount,
+							  face.mOutPositions, face.mOutNormals);
+				}
+				batch.run();
+			}
+		}
+		F32 elapsed = timer.getElapsedTimeF32();
+		LLWorkerPool::cleanupClass();
+
+		result_t result;
+		save_result(avatars, result);
+		F32 error = max_error(result, reference);
+		bool ok = error < TOLERANCE;
+		if (expected.empty())
+		{
+			expected = result;
+		}
+		ok = ok && !memcmp(&result[0], &expected[0], result.size() * sizeof(LLVector4a));
+
+		std::string name = LLSkinning::getKernelName(LLSkinning::getKernel());
+		name += threads ? llformat(", pool %2d threads", threads) : std::string(", calling thread");
+		report(name, elapsed, vertices, passes, error, ok);
+		return ok;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 avatar_count = argc > 1 ? llmax(atoi(argv[1]), 1) : 20;
+	S32 vertices = argc > 2 ? llmax(atoi(argv[2]), 1) : 50000;
+	S32 max_threads = argc > 3 ? atoi(argv[3]) : LLWorkerPool::getDefaultThreadCount() + 1;
+	S32 passes = argc > 4 ? llmax(atoi(argv[4]), 1) : 10;
+
+	LLSkinning::initClass();
+	std::vector<Avatar> avatars;
+	make_avatars(avatars, avatar_count, vertices);
+	std::cout << "Skinning " << avatar_count << " avatars of " << vertices << " vertices, " << passes << " passes"
+			  << std::endl;
+	S32 total = avatar_count * vertices;
+
+	result_t reference;
+	run_reference(avatars, total, passes, reference);
+
+	bool ok = true;
+	result_t expected;
+	for (S32 kernel = 0; kernel < LLSkinning::KERNEL_COUNT; ++kernel)
+	{
+		if (LLSkinning::hasKernel((LLSkinning::EKernel)kernel))
+		{
+			LLSkinning::setKernel((LLSkinning::EKernel)kernel);
+			ok = run_batches(avatars, total, passes, 0, reference, expected) && ok;
+		}
+	}
+
+	// The pool with the best kernel, as the viewer picks it.
+	LLSkinning::initClass();
+	S32 threads = 1;
+	for ( ; threads < max_threads; threads *= 2)
+	{
+		ok = run_batches(avatars, total, passes, threads, reference, expected) && ok;
+	}
+	ok = run_batches(avatars, total, passes, max_threads, reference, expected) && ok;
+
+	free_avatars(avatars);
+	return ok ? 0 : 1;
+}
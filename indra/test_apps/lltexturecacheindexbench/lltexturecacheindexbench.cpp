@@ -0,0 +1,152 @@
+/**
+ * @file lltexturecacheindexbench.cpp
+ * @brief Texture cache startup time, index versus the old entries file
+ *
+ * $LicenseInfo:firstyear=2012&license=viewergpl$
+ *
+ * Copyright (c) 2012, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+// Usage: lltexturecacheindexbench <work directory> [entries]
+//
+// Fills an LLTextureCacheIndex with the given number of synthetic entries
+// (200000 by default) and times opening it again, which is what the texture
+// cache does at startup. Then writes the same entries as a texture.entries
+// style array and times loading that into the id, size and LRU maps the way
+// the cache did before it had the index.
+
+#include "linden_common.h"
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "lldir.h"
+#include "llerrorcontrol.h"
+#include "llfile.h"
+#include "lltexturecacheindex.h"
+#include "lltimer.h"
+
+namespace
+{
+	typedef LLTextureCacheIndex::Entry Entry;
+
+	// Returns the number of entries found when loading the old entries file.
+	size_t load_entries(const std::string& filename)
+	{
+		std::map<LLUUID, S32> id_map;
+		std::map<LLUUID, S32> size_map;
+		std::set<std::pair<U32, S32> > lru;
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (!fp)
+		{
+			return 0;
+		}
+		Entry entry;
+		for (S32 idx = 0; fread(&entry, sizeof(Entry), 1, fp) == 1; ++idx)
+		{
+			id_map[entry.mID] = idx;
+			size_map[entry.mID] = entry.mBodySize;
+			lru.insert(std::make_pair(entry.mTime, idx));
+		}
+		fclose(fp);
+		return id_map.size();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	ll_init_apr();
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	if (argc < 2)
+	{
+		std::cerr << "usage: " << argv[0] << " <work directory> [entries]" << std::endl;
+		return 1;
+	}
+	std::string workdir = argv[1];
+	U32 count = argc > 2 ? (U32)llmax(atoi(argv[2]), 1) : 200000;
+
+	LLFile::mkdir(workdir);
+	std::string delim = gDirUtilp->getDirDelimiter();
+	std::string filename = workdir + delim + "bench.index";
+	std::string legacy = workdir + delim + "bench.entries";
+	LLFile::remove(filename);
+	LLFile::remove(LLTextureCacheIndex::getJournalFileName(filename));
+
+	std::vector<Entry> entries(count);
+	{
+		LLTextureCacheIndex index;
+		if (!index.open(filename, count, false))
+		{
+			std::cout << "CANNOT CREATE " << filename << std::endl;
+			return 1;
+		}
+		Entry evicted;
+		for (U32 i = 0; i < count; ++i)
+		{
+			entries[i].mID.generate();
+			entries[i].mImageSize = 100000;
+			entries[i].mBodySize = 50000;
+			entries[i].mTime = 1000 + i;
+			index.insert(entries[i], evicted);
+		}
+	}
+
+	LLTimer timer;
+	LLTextureCacheIndex index;
+	bool ok = index.open(filename, count, false);
+	F32 index_time = timer.getElapsedTimeF32();
+	U32 kept = index.getCount();
+	index.close();
+	// Full buckets evict, so not quite all of them fit.
+	ok = ok && kept > count * 9 / 10;
+
+	LLFILE* fp = LLFile::fopen(legacy, "wb");
+	if (fp)
+	{
+		fwrite(&entries[0], sizeof(Entry), entries.size(), fp);
+		fclose(fp);
+	}
+	timer.reset();
+	size_t loaded = load_entries(legacy);
+	F32 legacy_time = timer.getElapsedTimeF32();
+	ok = ok && loaded == count;
+
+	std::cout << count << " entries: index " << index_time * 1000.f << " ms (" << kept << " kept), entries file "
+			  << legacy_time * 1000.f << " ms (" << loaded << " loaded)" << std::endl;
+
+	LLFile::remove(legacy);
+	LLFile::remove(filename);
+	LLFile::remove(LLTextureCacheIndex::getJournalFileName(filename));
+
+	std::cout << (ok ? "ok" : "ENTRIES LOST") << std::endl;
+	return ok ? 0 : 1;
+}